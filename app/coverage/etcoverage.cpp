@@ -2,15 +2,24 @@
 #include <functional>
 #include <string>
 #include <cstring>  // for std::strcmp
+#include <cstdlib>  // for std::strtoul
 #include "etcoverage.h"
 #include "conductor/interface.h"
 #include "pass/aflcoverage.h"
+#include "pass/aflpersistent.h"
 #include "pass/ldsorefs.h"
 #include "pass/ifuncplts.h"
 #include "log/registry.h"
 #include "log/temp.h"
 
-static void parse(const std::string& filename, const std::string& output, bool quiet) {
+struct PersistentOptions {
+    std::string target;     // empty if not looping
+    unsigned long iterations = 1000;
+};
+
+static void parse(const std::string& filename, const std::string& output,
+    bool quiet, AFLCoveragePass::Mode mode,
+    const PersistentOptions &persistent) {
     std::cout << "Instrumenting file [" << filename << "]\n";
 
     // Set logging levels according to quiet and EGALITO_DEBUG env var.
@@ -37,9 +46,17 @@ static void parse(const std::string& filename, const std::string& output, bool q
         // Apply transformations.
         auto program = egalito.getProgram();
         std::cout << "Adding coverage calls...\n";
-        AFLCoveragePass aflCoverage;
+        AFLCoveragePass aflCoverage(mode);
         program->accept(&aflCoverage);
 
+        if(!persistent.target.empty()) {
+            std::cout << "Looping [" << persistent.target << "] up to "
+                << persistent.iterations << " times per process...\n";
+            AFLPersistentPass aflPersistent(persistent.target,
+                persistent.iterations);
+            program->accept(&aflPersistent);
+        }
+
         // Generate output, mirrorgen or uniongen. If only one argument is
         // given to generate(), automatically guess based on whether multiple
         // Modules are present.
@@ -54,11 +71,16 @@ static void parse(const std::string& filename, const std::string& output, bool q
 static void printUsage(const char *program) {
     std::cout << "Usage: " << program << " [options] input-file output-file\n"
         "    Transforms an executable by adding block coverage logging.\n"
-        "    Use in conjunction with AFL, set __AFL_SHM_ID env var.\n"
+        "    Use in conjunction with AFL, set __AFL_SHM_ID env var. Under\n"
+        "    afl-fuzz, outputs run as a fork server from the start of main.\n"
         "\n"
         "Options:\n"
         "    -v     Verbose mode, print logging messages\n"
         "    -q     Quiet mode (default), suppress logging messages\n"
+        "    -c     Use inline 8-bit block counters instead of the AFL map\n"
+        "    -p function  Fuzz in persistent mode, rerunning function\n"
+        "    -n count     Runs of the persistent function per process\n"
+        "                 (default 1000)\n"
         "Note: the EGALITO_DEBUG variable is also honoured.\n";
 }
 
@@ -74,6 +96,8 @@ int main(int argc, char *argv[]) {
     }
 
     bool quiet = true;
+    auto mode = AFLCoveragePass::MODE_AFL;
+    PersistentOptions persistent;
 
     struct {
         const char *str;
@@ -82,11 +106,20 @@ int main(int argc, char *argv[]) {
         // should we show debugging log messages?
         {"-v", [&quiet] () { quiet = false; }},
         {"-q", [&quiet] () { quiet = true; }},
+
+        // per-block counters, for libFuzzer-style edge coverage
+        {"-c", [&mode] () { mode = AFLCoveragePass::MODE_COUNTERS; }},
     };
 
     for(int a = 1; a < argc; a ++) {
         const char *arg = argv[a];
-        if(arg[0] == '-') {
+        if(std::strcmp(arg, "-p") == 0 && a + 1 < argc) {
+            persistent.target = argv[++ a];
+        }
+        else if(std::strcmp(arg, "-n") == 0 && a + 1 < argc) {
+            persistent.iterations = std::strtoul(argv[++ a], nullptr, 0);
+        }
+        else if(arg[0] == '-') {
             bool found = false;
             for(auto action : actions) {
                 if(std::strcmp(arg, action.str) == 0) {
@@ -100,7 +133,7 @@ int main(int argc, char *argv[]) {
             }
         }
         else if(argv[a] && argv[a + 1]) {
-            parse(argv[a], argv[a + 1], quiet);
+            parse(argv[a], argv[a + 1], quiet, mode, persistent);
             break;
         }
         else {
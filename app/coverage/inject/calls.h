@@ -8,6 +8,13 @@ void *shmat(int shmid, const void *shmaddr, int shmflg);
 int shmdt(const void *shmaddr);
 ssize_t write(int fd, const void *buf, size_t count);
 void *__mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset);
+ssize_t read(int fd, void *buf, size_t count);
+int close(int fd);
+pid_t fork(void);
+struct rusage;
+pid_t wait4(pid_t pid, int *status, int options, struct rusage *rusage);
+pid_t getpid(void);
+int kill(pid_t pid, int sig);
 
 #define stdout 1
 #define stderr 2
@@ -3,11 +3,23 @@
 .global exit
 .global write
 .global __mmap
+.global read
+.global close
+.global fork
+.global wait4
+.global getpid
+.global kill
 .hidden shmat
 .hidden shmdt
 .hidden exit
 .hidden write
 .hidden __mmap
+.hidden read
+.hidden close
+.hidden fork
+.hidden wait4
+.hidden getpid
+.hidden kill
 
 .section .text
 
@@ -55,3 +67,59 @@ __mmap:
     pop     %rcx
     retq
 .size __mmap, .-__mmap
+
+read:
+    push    %rcx
+    push    %r11
+    mov     $0, %rax    # read
+    syscall             # other args in %rdi, %rsi, %rdx
+    pop     %r11
+    pop     %rcx
+    retq
+
+close:
+    push    %rcx
+    push    %r11
+    mov     $3, %rax    # close
+    syscall             # other arg in %rdi
+    pop     %r11
+    pop     %rcx
+    retq
+
+fork:
+    push    %rcx
+    push    %r11
+    mov     $57, %rax   # fork
+    syscall
+    pop     %r11
+    pop     %rcx
+    retq
+
+wait4:
+    push    %rcx
+    push    %r11
+    mov     %rcx, %r10
+    mov     $61, %rax   # wait4
+    syscall             # other args in %rdi, %rsi, %rdx, %r10
+    pop     %r11
+    pop     %rcx
+    retq
+.size wait4, .-wait4
+
+getpid:
+    push    %rcx
+    push    %r11
+    mov     $39, %rax   # getpid
+    syscall
+    pop     %r11
+    pop     %rcx
+    retq
+
+kill:
+    push    %rcx
+    push    %r11
+    mov     $62, %rax   # kill
+    syscall             # other args in %rdi, %rsi
+    pop     %r11
+    pop     %rcx
+    retq
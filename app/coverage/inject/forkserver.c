@@ -0,0 +1,63 @@
+#include <signal.h>
+#include <sys/wait.h>
+#include "calls.h"
+
+/* The AFL fork server protocol: afl-fuzz passes a control pipe on fd 198
+ * and a status pipe on fd 199. Each test case is requested with 4 bytes on
+ * the control pipe; the server forks, reports the child's pid, waits for
+ * it, and reports its wait status. The child returns from here and runs
+ * the program, with all earlier initialization already done.
+ *
+ * In persistent mode (see persistent.c), a child stops itself after each
+ * input instead of exiting; the next request then resumes it rather than
+ * forking, unless afl-fuzz says it killed the child in the meantime.
+ */
+
+#define FORKSRV_FD      198
+#define EGALITO_MAP_BASE 0x50000000
+
+__attribute__((visibility("hidden")))
+int egalito_afl_forkserver_active;
+
+void egalito_afl_forkserver(void) {
+    int message = 0;
+
+    // not started by afl-fuzz (or it has no fork server): run normally
+    if(write(FORKSRV_FD + 1, &message, 4) != 4) return;
+    egalito_afl_forkserver_active = 1;
+
+    pid_t child = 0;
+    int childStopped = 0;
+    for(;;) {
+        int wasKilled = 0;
+        if(read(FORKSRV_FD, &wasKilled, 4) != 4) exit(1);
+
+        int status = 0;
+        if(childStopped && wasKilled) {
+            childStopped = 0;
+            if(wait4(child, &status, 0, 0) < 0) exit(1);
+        }
+
+        if(childStopped) {
+            kill(child, SIGCONT);
+            childStopped = 0;
+        }
+        else {
+            child = fork();
+            if(child < 0) exit(1);
+            if(child == 0) {
+                close(FORKSRV_FD);
+                close(FORKSRV_FD + 1);
+
+                // previous block location, kept in the control page
+                *(unsigned long *)(EGALITO_MAP_BASE - 0x1000) = 0;
+                return;
+            }
+        }
+
+        if(write(FORKSRV_FD + 1, &child, 4) != 4) exit(1);
+        if(wait4(child, &status, WUNTRACED, 0) < 0) exit(1);
+        if(WIFSTOPPED(status)) childStopped = 1;
+        if(write(FORKSRV_FD + 1, &status, 4) != 4) exit(1);
+    }
+}
@@ -0,0 +1,144 @@
+#include <signal.h>
+#include <sys/mman.h>
+#include "calls.h"
+
+/* Runtime side of AFLPersistentPass: calls to the target function go to
+ * egalito_afl_persistent_wrapper, which reruns the target for each input
+ * while the fork server keeps the process alive. Only the first call
+ * loops; later calls, or any call when not under afl-fuzz, run it once.
+ */
+
+#define TABLE_ADDRESS       0x34000000
+#define SIGNATURE_SIZE      32
+#define EGALITO_MAP_BASE    0x50000000
+
+struct region {
+    unsigned long address;
+    unsigned long size;
+};
+
+struct table {
+    char signature[SIGNATURE_SIZE];
+    unsigned long target;
+    unsigned long iterations;
+    unsigned long regionCount;
+    struct region regions[];
+};
+
+__attribute__((visibility("hidden")))
+extern int egalito_afl_forkserver_active;
+
+static char *snapshot;  // the regions' initial contents, back to back
+static unsigned long iteration;
+
+// no memcpy: libc is instrumented
+static void copy_bytes(char *to, const char *from, unsigned long size) {
+    volatile char *p = to;
+    for(unsigned long i = 0; i < size; i ++) p[i] = from[i];
+}
+
+__attribute__((visibility("hidden")))
+unsigned long persistent_start(void) {
+    static int started;
+    if(started) return 0;
+    started = 1;
+
+    struct table *table = (struct table *)TABLE_ADDRESS;
+    if(!egalito_afl_forkserver_active || table->iterations <= 1) return 0;
+
+    unsigned long total = 0;
+    for(unsigned long r = 0; r < table->regionCount; r ++) {
+        total += table->regions[r].size;
+    }
+    if(total) {
+        char *buffer = __mmap(0, total, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if((unsigned long)buffer > -4096UL) return 0;
+
+        char *p = buffer;
+        for(unsigned long r = 0; r < table->regionCount; r ++) {
+            copy_bytes(p, (char *)table->regions[r].address,
+                table->regions[r].size);
+            p += table->regions[r].size;
+        }
+        snapshot = buffer;
+    }
+    return 1;
+}
+
+__attribute__((visibility("hidden")))
+unsigned long persistent_next(void) {
+    struct table *table = (struct table *)TABLE_ADDRESS;
+    if(++ iteration >= table->iterations) return 0;
+
+    // afl-fuzz resumes us once the next input is in place
+    kill(getpid(), SIGSTOP);
+
+    char *p = snapshot;
+    for(unsigned long r = 0; r < table->regionCount; r ++) {
+        copy_bytes((char *)table->regions[r].address, p,
+            table->regions[r].size);
+        p += table->regions[r].size;
+    }
+
+    // previous block location, kept in the control page
+    *(unsigned long *)(EGALITO_MAP_BASE - 0x1000) = 0;
+    return 1;
+}
+
+/* Saves the integer argument registers and %rax (the vector register
+ * count of variadic calls), calls the target, and loops while
+ * persistent_next() asks for another run. The target's return value,
+ * including %xmm0 and %xmm1, is preserved across persistent_next().
+ * Stack-passed arguments are not supported.
+ *
+ *  -8..-56(%rbp)   rdi, rsi, rdx, rcx, r8, r9, rax
+ *  -64(%rbp)       nonzero if looping
+ *  -72, -80        return rax, rdx
+ *  -96, -112       return xmm0, xmm1
+ */
+__asm__ (
+    ".text\n"
+    ".global egalito_afl_persistent_wrapper\n"
+    ".type egalito_afl_persistent_wrapper, @function\n"
+    "egalito_afl_persistent_wrapper:\n"
+    "    push %rbp\n"
+    "    mov %rsp, %rbp\n"
+    "    push %rdi\n"
+    "    push %rsi\n"
+    "    push %rdx\n"
+    "    push %rcx\n"
+    "    push %r8\n"
+    "    push %r9\n"
+    "    push %rax\n"
+    "    sub $56, %rsp\n"
+    "    call persistent_start\n"
+    "    mov %rax, -64(%rbp)\n"
+    "1:\n"
+    "    mov -8(%rbp), %rdi\n"
+    "    mov -16(%rbp), %rsi\n"
+    "    mov -24(%rbp), %rdx\n"
+    "    mov -32(%rbp), %rcx\n"
+    "    mov -40(%rbp), %r8\n"
+    "    mov -48(%rbp), %r9\n"
+    "    mov -56(%rbp), %rax\n"
+    "    movabs $0x34000020, %r11\n"    // &table->target
+    "    call *(%r11)\n"
+    "    mov %rax, -72(%rbp)\n"
+    "    mov %rdx, -80(%rbp)\n"
+    "    movdqu %xmm0, -96(%rbp)\n"
+    "    movdqu %xmm1, -112(%rbp)\n"
+    "    cmpq $0, -64(%rbp)\n"
+    "    je 2f\n"
+    "    call persistent_next\n"
+    "    test %rax, %rax\n"
+    "    jnz 1b\n"
+    "2:\n"
+    "    mov -72(%rbp), %rax\n"
+    "    mov -80(%rbp), %rdx\n"
+    "    movdqu -96(%rbp), %xmm0\n"
+    "    movdqu -112(%rbp), %xmm1\n"
+    "    leave\n"
+    "    ret\n"
+    ".size egalito_afl_persistent_wrapper, .-egalito_afl_persistent_wrapper\n"
+);
@@ -1,12 +1,44 @@
 #include <iostream>
 #include <string>
 #include <functional>
+#include <vector>
 #include <cstring>  // for std::strcmp
+#include <unistd.h>  // for environ
 #include "etelf.h"
+#include "server.h"
 #include "conductor/interface.h"
+#include "pass/debloat.h"
+#include "pass/foldidentical.h"
+#include "pass/devirtualize.h"
+#include "util/memfile.h"
+
+/** Runs the output from a memory file, with args as its arguments. */
+static void execute(EgalitoInterface &egalito, const std::string &filename,
+    char *args[], bool oneToOne) {
+
+    std::cout << "Performing code generation into memory...\n";
+    std::string image;
+    if(!egalito.generateImage(image, !oneToOne)) {
+        std::cout << "Error: code generation failed\n";
+        return;
+    }
+
+    MemoryFile file;
+    if(!file.write(image)) return;
+    std::string().swap(image);
+
+    std::vector<char *> argv{const_cast<char *>(filename.c_str())};
+    for(char **arg = args; *arg; arg ++) argv.push_back(*arg);
+    argv.push_back(nullptr);
+
+    std::cout.flush();
+    file.exec(argv.data(), environ);
+    std::cout << "Error: can't execute the output\n";
+}
 
 static void parse(const std::string &filename, const std::string &output,
-    bool oneToOne, bool quiet) {
+    bool oneToOne, bool quiet, bool strip, bool fold, bool devirtualize,
+    char *execArgs[] = nullptr) {
 
     std::cout << "Transforming file [" << filename << "]\n";
 
@@ -26,7 +58,37 @@ static void parse(const std::string &filename, const std::string &output,
         egalito.parse(filename, !oneToOne);
 
         // This is where transformations, if any, should be applied to program.
-        //auto program = egalito.getProgram();
+        auto program = egalito.getProgram();
+
+        if(strip) {
+            std::cout << "Removing unreachable functions...\n";
+            DebloatPass debloat(program);
+            program->accept(&debloat);
+            std::cout << "Removed " << debloat.getRemovedBytes()
+                << " bytes of unreachable code\n";
+        }
+
+        if(fold) {
+            std::cout << "Folding identical functions...\n";
+            FoldIdenticalPass foldIdentical;
+            program->accept(&foldIdentical);
+            std::cout << "Folded " << foldIdentical.getFoldedCount()
+                << " functions, " << foldIdentical.getFoldedBytes()
+                << " bytes of code\n";
+        }
+
+        if(devirtualize) {
+            std::cout << "Guarding virtual calls with direct calls...\n";
+            DevirtualizePass devirtualizePass;
+            program->accept(&devirtualizePass);
+            std::cout << "Guarded " << devirtualizePass.getGuardedCount()
+                << " virtual calls\n";
+        }
+
+        if(execArgs) {
+            execute(egalito, filename, execArgs, oneToOne);
+            return;
+        }
 
         // Generate output, mirrorgen or uniongen. If only one argument is
         // given to generate(), automatically guess based on whether multiple
@@ -34,12 +96,37 @@ static void parse(const std::string &filename, const std::string &output,
         std::cout << "Performing code generation into [" << output << "]...\n";
         egalito.generate(output, !oneToOne);
 
+        // Everything is written; optionally skip freeing the Program.
+        egalito.exitWithoutTeardown();
     }
     catch(const char *message) {
         std::cout << "Exception: " << message << std::endl;
     }
 }
 
+static int shard(int count, char *libraries[]) {
+    EgalitoInterface egalito(/*verboseLogging=*/ false, /*useLoggingEnvVar=*/ true);
+
+    int status = 0;
+    try {
+        egalito.initializeParsing();
+        for(int i = 0; i < count; i ++) {
+            std::cout << "Analyzing [" << libraries[i]
+                << "] into the parse cache...\n";
+            if(!egalito.getConductor()->parseIntoCache(libraries[i])) {
+                std::cout << "Error: [" << libraries[i]
+                    << "] can't be cached\n";
+                status = 1;
+            }
+        }
+    }
+    catch(const char *message) {
+        std::cout << "Exception: " << message << std::endl;
+        status = 1;
+    }
+    return status;
+}
+
 static void printUsage(const char *program) {
     std::cout << "Usage: " << program << " [options] input-file output-file\n"
         "    Transforms an executable to a new ELF file.\n"
@@ -47,12 +134,47 @@ static void printUsage(const char *program) {
         "Options:\n"
         "    -m     Perform mirror elf generation (1-1 output)\n"
         "    -u     Perform union elf generation (merged output)\n"
+        "    -s     Strip functions and PLT entries that are unreachable\n"
+        "    -f     Fold functions whose code is identical into one copy\n"
+        "    -d     Call the possible targets of virtual calls directly,\n"
+        "           guarded by a compare, when there are at most two\n"
         "    -v     Verbose mode, print logging messages\n"
         "    -q     Quiet mode (default), suppress logging messages\n"
-        "Note: the EGALITO_DEBUG variable is also honoured.\n";
+        "    -x     Run the output from memory instead of writing it; the\n"
+        "           arguments after input-file are passed to it\n"
+        "Note: the EGALITO_DEBUG variable is also honoured.\n"
+        "\n"
+        "Server mode:\n"
+        "    " << program << " --server socket [library...]\n"
+        "        Run jobs sent to the Unix socket, keeping the parse cache\n"
+        "        entries of the given libraries in memory. Requires\n"
+        "        EGALITO_PARSE_CACHE; jobs use the server's environment.\n"
+        "    " << program << " --client socket [options] input output\n"
+        "        Run one transformation on the server.\n"
+        "    " << program << " --shard library...\n"
+        "        Only analyze the given libraries into EGALITO_PARSE_CACHE.\n"
+        "        Shards can run on several machines sharing the cache\n"
+        "        directory; a later -u run merges their entries.\n"
+        "\n"
+        "Set EGALITO_PASS_PROFILE or EGALITO_PASS_TRACE to a filename to\n"
+        "    record per-pass JSON statistics or a Chrome trace.\n"
+        "Set EGALITO_TRACE to a filename to record a Chrome trace of the\n"
+        "    startup phases and passes, with nesting and thread ids.\n"
+        "Set EGALITO_INCREMENTAL=1 to patch only changed functions into an\n"
+        "    existing mirror output when its layout is unchanged.\n"
+        "Set EGALITO_HUGE_PAGE_TEXT=1 to align the code segment to 2MB\n"
+        "    so that it can be backed by huge pages.\n"
+        "Set EGALITO_PRELINK=1 to apply relative relocations in -m output\n"
+        "    at generation time, leaving only a compact RELR table.\n"
+        "    RELR is used by default when the output's libc supports it;\n"
+        "    EGALITO_RELR=0 or 1 overrides this.\n"
+        "Set EGALITO_PATCH_IN_PLACE=1 to copy the input for -m output and move\n"
+        "    only changed functions to a new segment, when possible.\n"
+        "Set EGALITO_FAST_EXIT=1 to exit as soon as the output is written,\n"
+        "    without freeing the parsed program.\n";
 }
 
-int main(int argc, char *argv[]) {
+static int run(int argc, char *argv[]) {
     if(argc < 3) {
         printUsage(argv[0] ? argv[0] : "etelf");
         return 0;
@@ -60,6 +182,10 @@ int main(int argc, char *argv[]) {
 
     bool oneToOne = true;
     bool quiet = true;
+    bool strip = false;
+    bool fold = false;
+    bool devirtualize = false;
+    bool exec = false;
 
     struct {
         const char *str;
@@ -72,6 +198,18 @@ int main(int argc, char *argv[]) {
         // should we show debugging log messages?
         {"-v", [&quiet] () { quiet = false; }},
         {"-q", [&quiet] () { quiet = true; }},
+
+        // should unreachable code be left out of the output?
+        {"-s", [&strip] () { strip = true; }},
+
+        // should identical functions share one copy?
+        {"-f", [&fold] () { fold = true; }},
+
+        // should virtual calls with few targets call them directly?
+        {"-d", [&devirtualize] () { devirtualize = true; }},
+
+        // should the output run right away, without a file?
+        {"-x", [&exec] () { exec = true; }},
     };
 
     for(int a = 1; a < argc; a ++) {
@@ -90,8 +228,14 @@ int main(int argc, char *argv[]) {
                 std::cout << "Warning: unrecognized option \"" << arg << "\"\n";
             }
         }
+        else if(exec) {
+            parse(argv[a], "", oneToOne, quiet, strip, fold, devirtualize,
+                argv + a + 1);
+            break;
+        }
         else if(argv[a] && argv[a + 1]) {
-            parse(argv[a], argv[a + 1], oneToOne, quiet);
+            parse(argv[a], argv[a + 1], oneToOne, quiet, strip, fold,
+                devirtualize);
             break;
         }
         else {
@@ -101,3 +245,19 @@ int main(int argc, char *argv[]) {
     }
     return 0;
 }
+
+int main(int argc, char *argv[]) {
+    if(argc >= 3 && std::strcmp(argv[1], "--server") == 0) {
+        ElfServer server(argv[2], run);
+        for(int a = 3; a < argc; a ++) server.addLibrary(argv[a]);
+        return server.serve();
+    }
+    if(argc >= 3 && std::strcmp(argv[1], "--client") == 0) {
+        return ElfServer::sendJob(argv[2], argc - 3, argv + 3);
+    }
+    if(argc >= 3 && std::strcmp(argv[1], "--shard") == 0) {
+        return shard(argc - 2, argv + 2);
+    }
+
+    return run(argc, argv);
+}
@@ -0,0 +1,219 @@
+#include <iostream>
+#include <vector>
+#include <cstdio>  // for std::perror, std::fflush
+#include <cstring>
+#include <cstdint>
+#include <climits>  // for PATH_MAX
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "server.h"
+#include "conductor/parsecache.h"
+
+// the working directory and all arguments of one job
+static const size_t MESSAGE_LIMIT = 64 * 1024;
+
+static bool makeAddress(const char *path, struct sockaddr_un *address) {
+    std::memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    if(std::strlen(path) >= sizeof(address->sun_path)) {
+        std::cerr << "Error: socket path [" << path << "] is too long\n";
+        return false;
+    }
+    std::strcpy(address->sun_path, path);
+    return true;
+}
+
+int ElfServer::serve() {
+    struct sockaddr_un address;
+    if(!makeAddress(socketPath.c_str(), &address)) return 1;
+
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if(fd < 0) {
+        std::perror("socket");
+        return 1;
+    }
+    unlink(socketPath.c_str());
+    if(bind(fd, reinterpret_cast<struct sockaddr *>(&address),
+        sizeof(address)) < 0 || listen(fd, 16) < 0) {
+
+        std::perror("bind");
+        close(fd);
+        return 1;
+    }
+
+    // children send their status to the client, so nobody waits for them
+    std::signal(SIGCHLD, SIG_IGN);
+
+    std::cout << "Serving etelf jobs on [" << socketPath << "]\n";
+    retainLibraries();
+    for(;;) {
+        int connection = accept4(fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if(connection < 0) {
+            if(errno != EINTR) std::perror("accept");
+            continue;
+        }
+
+        // earlier jobs may have added entries to the parse cache
+        retainLibraries();
+        std::cout.flush();
+
+        pid_t pid = fork();
+        if(pid == 0) {
+            close(fd);
+            runJob(connection);  // does not return
+        }
+        if(pid < 0) std::perror("fork");
+        close(connection);
+    }
+}
+
+void ElfServer::retainLibraries() {
+    ParseCache cache;
+    if(!cache.isEnabled()) {
+        if(!pendingList.empty()) {
+            std::cout << "Warning: EGALITO_PARSE_CACHE is not set, "
+                "no libraries are kept resident\n";
+            pendingList.clear();
+        }
+        return;
+    }
+
+    for(auto it = pendingList.begin(); it != pendingList.end(); ) {
+        bool retained = false;
+        try {
+            retained = cache.retain(*it);
+        }
+        catch(const char *message) {
+            std::cout << "Warning: can't retain [" << *it << "]: "
+                << message << std::endl;
+            it = pendingList.erase(it);
+            continue;
+        }
+
+        if(retained) {
+            std::cout << "Keeping [" << *it << "] resident\n";
+            it = pendingList.erase(it);
+        }
+        else ++ it;
+    }
+}
+
+void ElfServer::runJob(int connection) {
+    std::vector<char> buffer(MESSAGE_LIMIT);
+    union {
+        char data[CMSG_SPACE(2 * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct iovec iov = {buffer.data(), buffer.size()};
+    struct msghdr message;
+    std::memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control.data;
+    message.msg_controllen = sizeof(control.data);
+
+    ssize_t size = recvmsg(connection, &message, MSG_CMSG_CLOEXEC);
+    auto cmsg = CMSG_FIRSTHDR(&message);
+    if(size <= 0 || buffer[size - 1] != '\0'
+        || (message.msg_flags & (MSG_TRUNC | MSG_CTRUNC))
+        || !cmsg || cmsg->cmsg_level != SOL_SOCKET
+        || cmsg->cmsg_type != SCM_RIGHTS
+        || cmsg->cmsg_len != CMSG_LEN(2 * sizeof(int))) {
+
+        _exit(1);
+    }
+
+    int fds[2];
+    std::memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+    dup2(fds[0], STDOUT_FILENO);
+    dup2(fds[1], STDERR_FILENO);
+    close(fds[0]);
+    close(fds[1]);
+
+    std::vector<char *> words;
+    for(ssize_t i = 0; i < size; i += std::strlen(&buffer[i]) + 1) {
+        words.push_back(&buffer[i]);
+    }
+
+    int32_t status = 1;
+    if(chdir(words[0]) == 0) {
+        // the working directory's slot becomes argv[0]
+        static char name[] = "etelf";
+        words[0] = name;
+        words.push_back(nullptr);
+        status = job(words.size() - 1, words.data());
+    }
+    else {
+        std::cerr << "Error: can't change to [" << words[0] << "]\n";
+    }
+
+    std::cout.flush();
+    std::cerr.flush();
+    std::fflush(nullptr);
+    (void)write(connection, &status, sizeof(status));
+    _exit(status);
+}
+
+int ElfServer::sendJob(const char *socketPath, int argc, char *argv[]) {
+    struct sockaddr_un address;
+    if(!makeAddress(socketPath, &address)) return 1;
+
+    char cwd[PATH_MAX];
+    if(!getcwd(cwd, sizeof(cwd))) {
+        std::perror("getcwd");
+        return 1;
+    }
+    std::string text(cwd, std::strlen(cwd) + 1);
+    for(int i = 0; i < argc; i ++) {
+        text.append(argv[i], std::strlen(argv[i]) + 1);
+    }
+    if(text.length() > MESSAGE_LIMIT) {
+        std::cerr << "Error: arguments are too long for the etelf server\n";
+        return 1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if(fd < 0 || connect(fd, reinterpret_cast<struct sockaddr *>(&address),
+        sizeof(address)) < 0) {
+
+        std::perror("connect");
+        return 1;
+    }
+
+    union {
+        char data[CMSG_SPACE(2 * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct iovec iov = {&text[0], text.length()};
+    struct msghdr message;
+    std::memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control.data;
+    message.msg_controllen = sizeof(control.data);
+
+    auto cmsg = CMSG_FIRSTHDR(&message);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(2 * sizeof(int));
+    int fds[2] = {STDOUT_FILENO, STDERR_FILENO};
+    std::memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    std::cout.flush();
+    if(sendmsg(fd, &message, 0) < 0) {
+        std::perror("sendmsg");
+        close(fd);
+        return 1;
+    }
+
+    int32_t status;
+    if(read(fd, &status, sizeof(status)) != sizeof(status)) {
+        std::cerr << "Error: etelf server closed the connection\n";
+        status = 1;
+    }
+    close(fd);
+    return status;
+}
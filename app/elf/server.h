@@ -0,0 +1,45 @@
+#ifndef EGALITO_APP_ELF_SERVER_H
+#define EGALITO_APP_ELF_SERVER_H
+
+#include <string>
+#include <vector>
+#include <functional>
+
+/** Keeps analyzed libraries resident and runs etelf jobs sent over a Unix
+    socket, so that a job doesn't pay for parsing libc and friends again.
+
+    The libraries must have parse cache entries (EGALITO_PARSE_CACHE); the
+    server retains them in memory and forks a child for every job, which
+    picks up its own copy-on-write copy of each retained Module. Libraries
+    with no entry yet are retried before each job, since the jobs
+    themselves fill the cache.
+
+    A job is the client's working directory and arguments, sent in one
+    packet together with the client's stdout and stderr descriptors; the
+    child writes straight to those and replies with its exit status.
+*/
+class ElfServer {
+public:
+    typedef std::function<int (int argc, char *argv[])> JobFunction;
+private:
+    std::string socketPath;
+    JobFunction job;
+    std::vector<std::string> pendingList;
+public:
+    ElfServer(const std::string &socketPath, JobFunction job)
+        : socketPath(socketPath), job(job) {}
+
+    void addLibrary(const std::string &path) { pendingList.push_back(path); }
+
+    /** Only returns if the socket can't be set up. */
+    int serve();
+
+    /** Runs argv on the server listening at socketPath, returning the
+        job's exit status. */
+    static int sendJob(const char *socketPath, int argc, char *argv[]);
+private:
+    void retainLibraries();
+    void runJob(int connection);
+};
+
+#endif
@@ -1,8 +1,16 @@
 #include <iostream>
 #include <functional>
 #include <string>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <thread>
 #include <cstring>  // for std::strcmp
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/wait.h>
 #include "etharden.h"
+#include "analysis/dataprofile.h"
 #include "pass/chunkpass.h"
 #include "pass/stackxor.h"
 #include "pass/endbradd.h"
@@ -11,8 +19,12 @@
 #include "pass/permutedata.h"
 #include "pass/profileinstrument.h"
 #include "pass/profilesave.h"
+#include "pass/perfcount.h"
+#include "pass/inlinecalls.h"
 #include "pass/condwatchpoint.h"
 #include "pass/retpoline.h"
+#include "pass/cancelpush.h"
+#include "pass/hardencleanup.h"
 #include "log/registry.h"
 #include "log/temp.h"
 
@@ -59,23 +71,45 @@ void HardenApp::doShadowStack(bool gsMode) {
 
     std::cout << "Adding shadow stack...\n";
     ShadowStackPass shadowStack(gsMode
-        ? ShadowStackPass::MODE_GS : ShadowStackPass::MODE_CONST);
+        ? ShadowStackPass::MODE_GS : ShadowStackPass::MODE_CONST, elideLeaves);
     program->accept(&shadowStack);
 }
 
-void HardenApp::doPermuteData() {
-    std::cout << "Permuting data section...\n";
+void HardenApp::doPermuteData(const std::string &dataProfile) {
     auto program = getProgram();
-    RUN_PASS(PermuteDataPass(), program);
+    if(dataProfile.empty()) {
+        std::cout << "Permuting data section...\n";
+        RUN_PASS(PermuteDataPass(), program);
+        return;
+    }
+
+    std::cout << "Laying out data section by profile...\n";
+    DataProfile samples;
+    if(!samples.read(dataProfile)) throw "can't read data profile";
+    RUN_PASS(PermuteDataPass(&samples), program);
 }
 
-void HardenApp::doProfiling() {
+void HardenApp::doProfiling(ProfileInstrumentPass::Mode mode) {
     std::cout << "Adding function profiling...\n";
     auto program = getProgram();
-    RUN_PASS(ProfileInstrumentPass(), program);
+    RUN_PASS(ProfileInstrumentPass(mode), program);
     RUN_PASS(ProfileSavePass(), program);
 }
 
+void HardenApp::doPerfCounting() {
+    egalito->parse("libperfcount.so");
+    auto program = getProgram();
+
+    std::cout << "Adding hardware performance counters...\n";
+    RUN_PASS(PerfCountPass(), program);
+}
+
+void HardenApp::doInlining(bool crossModule) {
+    std::cout << "Inlining calls to small leaf functions...\n";
+    auto program = getProgram();
+    RUN_PASS(InlineCallsPass(32, crossModule), program);
+}
+
 void HardenApp::doWatching() {
     std::cout << "Adding conditional watchpoint...\n";
     auto program = getProgram();
@@ -100,6 +134,13 @@ static void printUsage(const char *program) {
         "    -q     Quiet mode (default), suppress logging messages\n"
         "    -m     Perform mirror elf generation (1-1 output)\n"
         "    -u     Perform union elf generation (merged output)\n"
+        "    -l     Shadow stack: skip leaves that can't overwrite their\n"
+        "           own return address\n"
+        "    -b manifest    Batch mode: transform every \"input output\n"
+        "           [options...]\" line of manifest, each on top of the\n"
+        "           command line options; messages go to output.log\n"
+        "    -j n   Batch mode: run up to n jobs at once (default: one\n"
+        "           per CPU); shared libraries are only analyzed once\n"
         "\n"
         "Modes:\n"
         "    --nop          No transformation (default)\n"
@@ -113,14 +154,25 @@ static void printUsage(const char *program) {
         "        --cet-gs        GS shadow stack implementation\n"
         "        --cet-const     Constant offset shadow stack implementation\n"
         "    --permute-data Randomize order of global variables in .data\n"
+        "    --layout-data=profile  Group the hot global variables of .data\n"
+        "                   by sampled accesses (address [count] [load|store]\n"
+        "                   lines, or perf script -F event,addr output)\n"
         "    --profile      Add profiling counters to each function\n"
+        "        --profile-tree  Leave out counters etprofile can derive\n"
+        "        --profile-sample    Sample the PC on a SIGPROF timer instead\n"
+        "        --profile-perf      Read perf counters around every call\n"
         "    --cond-watchpoint   Add conditional watchpoints for GDB\n"
+        "    --inline       Inline calls to small leaf functions (across\n"
+        "                   modules with -u)\n"
+        "    --cancel-push  Remove callee-saved register pushes that no\n"
+        "                   caller needs\n"
+        "    Modes can be combined; redundant save/restore code between\n"
+        "    them is cleaned up afterwards.\n"
         "Note: the EGALITO_DEBUG variable is also honoured.\n";
 }
 
-void HardenApp::run(int argc, char **argv) {
-    bool oneToOne = true;
-    std::vector<std::string> ops;
+void HardenApp::parseOptions(const std::vector<std::string> &args,
+    Job &job, std::vector<std::string> &files) {
 
     const struct {
         const char *str;
@@ -131,65 +183,204 @@ void HardenApp::run(int argc, char **argv) {
         {"-q", [this] () { quiet = true; }},
 
         // which elf gen should we perform?
-        {"-m", [&oneToOne] () { oneToOne = true; }},
-        {"-u", [&oneToOne] () { oneToOne = false; }},
-
-        {"--nop",           [&ops] () { }},
-        {"--retpolines",    [&ops] () { ops.push_back("retpolines"); }},
-        {"--cfi",           [&ops] () { ops.push_back("cfi"); }},
-        {"--ss",            [&ops] () { ops.push_back("ss-const"); }},
-        {"--ss-xor",        [&ops] () { ops.push_back("ss-xor"); }},
-        {"--ss-gs",         [&ops] () { ops.push_back("ss-gs"); }},
-        {"--ss-const",      [&ops] () { ops.push_back("ss-const"); }},
-        {"--cet",           [&ops] () { ops.push_back("cet-const"); }},
-        {"--cet-gs",        [&ops] () { ops.push_back("cet-gs"); }},
-        {"--cet-const",     [&ops] () { ops.push_back("cet-const"); }},
-        {"--permute-data",  [&ops] () { ops.push_back("permute-data"); }},
-        {"--profile",       [&ops] () { ops.push_back("profile"); }},
-        {"--cond-watchpoint", [&ops] () { ops.push_back("cond-watchpoint"); }},
+        {"-m", [&job] () { job.oneToOne = true; }},
+        {"-u", [&job] () { job.oneToOne = false; }},
+        {"-l", [this] () { elideLeaves = true; }},
+
+        {"--nop",           [] () { }},
+        {"--retpolines",    [&job] () { job.ops.push_back("retpolines"); }},
+        {"--cfi",           [&job] () { job.ops.push_back("cfi"); }},
+        {"--ss",            [&job] () { job.ops.push_back("ss-const"); }},
+        {"--ss-xor",        [&job] () { job.ops.push_back("ss-xor"); }},
+        {"--ss-gs",         [&job] () { job.ops.push_back("ss-gs"); }},
+        {"--ss-const",      [&job] () { job.ops.push_back("ss-const"); }},
+        {"--cet",           [&job] () { job.ops.push_back("cet-const"); }},
+        {"--cet-gs",        [&job] () { job.ops.push_back("cet-gs"); }},
+        {"--cet-const",     [&job] () { job.ops.push_back("cet-const"); }},
+        {"--permute-data",  [&job] () { job.ops.push_back("permute-data"); }},
+        {"--profile",       [&job] () { job.ops.push_back("profile"); }},
+        {"--profile-tree",  [&job] () { job.ops.push_back("profile-tree"); }},
+        {"--profile-sample", [&job] () { job.ops.push_back("profile-sample"); }},
+        {"--profile-perf",  [&job] () { job.ops.push_back("profile-perf"); }},
+        {"--cond-watchpoint", [&job] () { job.ops.push_back("cond-watchpoint"); }},
+        {"--inline",        [&job] () { job.ops.push_back("inline"); }},
+        {"--cancel-push",   [&job] () { job.ops.push_back("cancel-push"); }},
     };
 
+    const std::string layoutData = "--layout-data=";
+    for(const auto &arg : args) {
+        if(arg.compare(0, layoutData.length(), layoutData) == 0) {
+            job.dataProfile = arg.substr(layoutData.length());
+            job.ops.push_back("layout-data");
+        }
+        else if(arg[0] == '-') {
+            bool found = false;
+            for(auto action : actions) {
+                if(arg == action.str) {
+                    action.action();
+                    found = true;
+                    break;
+                }
+            }
+            if(!found) {
+                std::cout << "Warning: unrecognized option \"" << arg << "\"\n";
+            }
+        }
+        else files.push_back(arg);
+    }
+}
+
+bool HardenApp::runJob(const Job &job) {
     std::map<std::string, std::function<void ()>> techniques = {
         {"cfi",             [this] () { doCFI(); }},
-        {"ss-xor",          [this] () { RUN_PASS(StackXOR(0x28), getProgram()); }},
+        {"ss-xor",          [this] () {
+            RUN_PASS(StackXOR(0x28, elideLeaves), getProgram()); }},
         {"ss-gs",           [this] () { doShadowStack(true); }},
         {"ss-const",        [this] () { doShadowStack(false); }},
         {"cet-gs",          [this] () { doShadowStack(true); doCFI(); }},
         {"cet-const",       [this] () { doShadowStack(false); doCFI(); }},
         {"permute-data",    [this] () { doPermuteData(); }},
-        {"profile",         [this] () { doProfiling(); }},
+        {"layout-data",     [this, &job] () { doPermuteData(job.dataProfile); }},
+        {"profile",         [this] () {
+            doProfiling(ProfileInstrumentPass::MODE_COUNT); }},
+        {"profile-tree",    [this] () {
+            doProfiling(ProfileInstrumentPass::MODE_COUNT_TREE); }},
+        {"profile-sample",  [this] () {
+            doProfiling(ProfileInstrumentPass::MODE_SAMPLE); }},
+        {"profile-perf",    [this] () { doPerfCounting(); }},
         {"cond-watchpoint", [this] () { doWatching(); }},
         {"retpolines",      [this] () { doRetpolines(); }},
+        {"inline",          [this, &job] () { doInlining(!job.oneToOne); }},
+        {"cancel-push",     [this] () {
+            RUN_PASS(CancelPushPass(getProgram()), getProgram()); }},
     };
 
+    parse(job.input, job.oneToOne);
+    try {
+        for(auto op : job.ops) {
+            techniques[op]();
+        }
+        if(job.ops.size() > 1) {
+            // modes add code at the same points, each saving registers
+            RUN_PASS(HardenCleanupPass(), getProgram());
+        }
+    }
+    catch(const char *message) {
+        std::cout << "Exception: " << message << std::endl;
+        return false;
+    }
+    generate(job.output, job.oneToOne);
+    return std::ifstream(job.output.c_str()).good();
+}
+
+void HardenApp::run(int argc, char **argv) {
+    Job job;
+    std::vector<std::string> args, files;
+    std::string manifest;
+    unsigned parallel = std::thread::hardware_concurrency();
     for(int a = 1; a < argc; a ++) {
-        const char *arg = argv[a];
-        if(arg[0] == '-') {
-            bool found = false;
-            for(auto action : actions) {
-                if(std::strcmp(arg, action.str) == 0) {
-                    action.action();
-                    found = true;
-                    break;
-                }
-            }
-            if(!found) {
-                std::cout << "Warning: unrecognized option \"" << arg << "\"\n";
-            }
+        if(!std::strcmp(argv[a], "-b") && a + 1 < argc) manifest = argv[++ a];
+        else if(!std::strcmp(argv[a], "-j") && a + 1 < argc) {
+            parallel = std::strtoul(argv[++ a], nullptr, 0);
         }
-        else if(argv[a] && argv[a + 1]) {
-            parse(argv[a], oneToOne);
-            for(auto op : ops) {
-                techniques[op]();
-            }
-            generate(argv[a + 1], oneToOne);
-            break;
+        else args.push_back(argv[a]);
+    }
+    parseOptions(args, job, files);
+
+    if(!manifest.empty()) {
+        runBatch(manifest, job, parallel ? parallel : 1);
+    }
+    else if(files.size() >= 2) {
+        job.input = files[0];
+        job.output = files[1];
+        runJob(job);
+    }
+    else {
+        std::cout << "Error: no output filename given!\n";
+    }
+}
+
+void HardenApp::runBatch(const std::string &manifest, const Job &defaults,
+    unsigned parallel) {
+
+    // each line: input output [options...], on top of the command line's
+    std::vector<Job> jobList;
+    std::ifstream file(manifest.c_str());
+    std::string line;
+    while(std::getline(file, line)) {
+        if(line.empty() || line[0] == '#') continue;
+
+        std::istringstream stream(line);
+        std::vector<std::string> args, files;
+        std::string arg;
+        while(stream >> arg) args.push_back(arg);
+
+        Job job = defaults;
+        parseOptions(args, job, files);
+        if(files.size() < 2) {
+            std::cout << "Warning: skipping manifest line \"" << line << "\"\n";
+            continue;
         }
-        else {
-            std::cout << "Error: no output filename given!\n";
-            break;
+        job.input = files[0];
+        job.output = files[1];
+        jobList.push_back(job);
+    }
+
+    // Shared libraries are analyzed once and then loaded from the parse
+    // cache by every other job. Jobs that run in the same process would
+    // share global state (the Conductor, log settings), so each one is a
+    // forked child instead.
+    if(!getenv("EGALITO_PARSE_CACHE")) {
+        char directory[] = "/tmp/egalito-batch-XXXXXX";
+        if(mkdtemp(directory)) {
+            setenv("EGALITO_PARSE_CACHE", directory, 1);
+            std::cout << "Using parse cache [" << directory << "]\n";
         }
     }
+
+    std::map<pid_t, size_t> running;
+    size_t next = 0, failures = 0;
+    auto reap = [&] () {
+        int status = 0;
+        pid_t pid = wait(&status);
+        if(pid < 0) return;
+        auto &job = jobList[running[pid]];
+        bool ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        std::cout << (ok ? "[ok]     " : "[failed] ") << job.input
+            << " -> " << job.output << (ok ? "" : " (see .log)") << "\n";
+        if(!ok) failures ++;
+        running.erase(pid);
+    };
+
+    while(next < jobList.size() || !running.empty()) {
+        // the first job runs alone, so that its libraries (libc at least)
+        // are in the cache before any other job needs them
+        size_t limit = (next <= 1 ? 1 : parallel);
+        if(next < jobList.size() && running.size() < limit) {
+            const auto &job = jobList[next];
+            std::cout.flush();
+            pid_t pid = fork();
+            if(pid == 0) {
+                // keep each job's messages out of the summary
+                auto log = job.output + ".log";
+                if(!freopen(log.c_str(), "w", stdout)) _exit(2);
+                dup2(fileno(stdout), fileno(stderr));
+                bool ok = runJob(job);
+                std::cout.flush();
+                _exit(ok ? 0 : 1);
+            }
+            else if(pid > 0) running[pid] = next ++;
+            else {
+                std::cout << "Error: fork failed\n";
+                break;
+            }
+        }
+        else reap();
+    }
+    while(!running.empty()) reap();
+
+    std::cout << jobList.size() - failures << " of " << jobList.size()
+        << " binaries transformed\n";
 }
 
 int main(int argc, char *argv[]) {
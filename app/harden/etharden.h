@@ -1,23 +1,42 @@
 #ifndef EGALITO_APP_HARDEN_H
 #define EGALITO_APP_HARDEN_H
 
+#include <string>
+#include <vector>
 #include "conductor/interface.h"
+#include "pass/profileinstrument.h"
 
 class HardenApp {
+public:
+    struct Job {
+        std::string input, output;
+        bool oneToOne;
+        std::vector<std::string> ops;
+        std::string dataProfile;    // for layout-data
+        Job() : oneToOne(true) {}
+    };
 private:
     bool quiet;
+    bool elideLeaves;
     EgalitoInterface *egalito;
 public:
-    HardenApp() : quiet(true) {}
+    HardenApp() : quiet(true), elideLeaves(false) {}
     void run(int argc, char **argv);
+    bool runJob(const Job &job);
+    void runBatch(const std::string &manifest, const Job &defaults,
+        unsigned parallel);
     void parse(const std::string &filename, bool oneToOne);
     void generate(const std::string &filename, bool oneToOne);
     Program *getProgram() const { return egalito->getProgram(); }
 private:
+    void parseOptions(const std::vector<std::string> &args, Job &job,
+        std::vector<std::string> &files);
     void doCFI();
     void doShadowStack(bool gsMode);
-    void doPermuteData();
-    void doProfiling();
+    void doPermuteData(const std::string &dataProfile = "");
+    void doProfiling(ProfileInstrumentPass::Mode mode);
+    void doPerfCounting();
+    void doInlining(bool crossModule);
     void doWatching();
     void doRetpolines();
 };
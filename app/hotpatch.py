@@ -0,0 +1,35 @@
+#!/usr/bin/env python3
+# Applies a registered pass to functions of a program running under the
+# egalito loader with EGALITO_HOTPATCH_SOCKET set.
+#
+# usage: hotpatch.py socket pass function...
+#   e.g. hotpatch.py /tmp/nginx.sock nop ngx_http_process_request
+
+import socket
+import sys
+import time
+
+RETRIES = 50
+
+def main():
+    if len(sys.argv) < 4:
+        print("usage: %s socket pass function..." % sys.argv[0])
+        return 1
+
+    s = socket.socket(socket.AF_UNIX, socket.SOCK_SEQPACKET)
+    s.connect(sys.argv[1])
+    message = " ".join(sys.argv[2:]).encode()
+
+    # a function that is running can't be patched; wait for it to return
+    for _ in range(RETRIES):
+        s.send(message)
+        reply = s.recv(4096).decode()
+        if not reply.startswith("error: busy"):
+            break
+        time.sleep(0.1)
+
+    print(reply)
+    return 0 if reply.startswith("ok") else 1
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <ostream>
+#include <vector>
+#include <cstdio>  // for snprintf
+#include <cstdlib>  // for getenv
+#include <climits>
+#include "fastdump.h"
+#include "chunk/concrete.h"
+#include "chunk/chunkiter.h"
+#include "chunk/link.h"
+#include "chunk/plt.h"
+#include "disasm/handle.h"
+#include "instr/concrete.h"
+#include "instr/writer.h"
+#include "util/threadpool.h"
+
+// functions formatted per parallelFor(), to bound buffered output
+#define FUNCTIONS_PER_BATCH 4096
+
+void FastDump::dump(Program *program, std::ostream &stream) {
+    for(auto module : CIter::modules(program)) {
+        dump(module, stream);
+    }
+}
+
+void FastDump::dump(Module *module, std::ostream &stream) {
+    std::vector<Function *> functionList;
+    for(auto function : CIter::functions(module)) {
+        functionList.push_back(function);
+    }
+    std::sort(functionList.begin(), functionList.end(),
+        [] (Function *a, Function *b) {
+            return a->getAddress() < b->getAddress();
+        });
+
+    stream << "=== [" << module->getName() << "] with "
+        << functionList.size() << " functions ===\n";
+
+    // the listing is the whole point here, so use every core by default
+    size_t threads = ThreadPool::getDefaultThreadCount();
+    if(threads == 1 && !getenv("EGALITO_THREADS")) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    ThreadPool pool(threads);
+
+    std::vector<std::string> buffers;
+    for(size_t start = 0; start < functionList.size();
+        start += FUNCTIONS_PER_BATCH) {
+
+        size_t count = std::min<size_t>(FUNCTIONS_PER_BATCH,
+            functionList.size() - start);
+        buffers.assign(count, std::string());
+        pool.parallelFor(count, [&] (size_t i) {
+            formatFunction(functionList[start + i], buffers[i]);
+        });
+        for(const auto &buffer : buffers) stream << buffer;
+    }
+}
+
+void FastDump::formatFunction(Function *function, std::string &output) {
+    DisasmHandle handle(false);
+    cs_insn *insn = cs_malloc(handle.raw());
+
+    output += "---[" + function->getName() + "]---\n";
+    for(auto block : CIter::children(function)) {
+        if(showBasicBlocks) output += block->getName() + ":\n";
+        address_t base = showBasicBlocks
+            ? block->getAddress() : function->getAddress();
+        for(auto instr : CIter::children(block)) {
+            formatInstruction(instr, instr->getAddress() - base, insn, output);
+        }
+    }
+
+    cs_free(insn, 1);
+}
+
+static std::string getTargetName(Link *link) {
+    if(!link) return "";
+    if(auto v = dynamic_cast<ImmAndDispLink *>(link)) link = v->getDispLink();
+    if(auto v = dynamic_cast<PLTLink *>(link)) {
+        return v->getPLTTrampoline()->getName();
+    }
+    if(auto v = dynamic_cast<SymbolOnlyLink *>(link)) {
+        return std::string(v->getSymbol()->getName()) + "@symonly";
+    }
+    auto target = link->getTarget();
+    if(target && target->getName() != "???") return target->getName();
+    return "";
+}
+
+#define APPEND(...) \
+    pos += std::snprintf(buffer + pos, sizeof buffer - pos, __VA_ARGS__)
+void FastDump::formatInstruction(Instruction *instruction, int offset,
+    cs_insn *insn, std::string &output) {
+
+    // never getAssembly() here: it decodes lazily into the shared storage
+    auto semantic = instruction->getSemantic();
+    std::string code;
+#ifdef ARCH_X86_64
+    if(auto cf = dynamic_cast<ControlFlowInstruction *>(semantic)) {
+        InstrWriterCppString writer(code);
+        cf->accept(&writer);
+    }
+    else
+#endif
+    code = semantic->getData();
+
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(code.data());
+    size_t size = code.size();
+    uint64_t address = instruction->getAddress();
+    DisasmHandle handle(false);
+    bool decoded = cs_disasm_iter(handle.raw(), &bytes, &size, &address, insn);
+
+    char buffer[1024];
+    size_t pos = 0;
+    APPEND("    ");
+    if(showBytes) {
+        char hex[10 * 3 + 1];
+        size_t hexPos = 0;
+        for(size_t i = 0; i < code.size() && i < 10; i ++) {
+            hexPos += std::snprintf(hex + hexPos, sizeof hex - hexPos,
+                "%02x ", (unsigned)code[i] & 0xff);
+        }
+        APPEND("%-*s ", 10 * 3, hexPos ? hex : "---");
+    }
+    APPEND("0x%08lx <+%3d>:  %-12s %-26s", instruction->getAddress(), offset,
+        decoded ? insn->mnemonic : "(bad)", decoded ? insn->op_str : "");
+
+    auto name = getTargetName(semantic->getLink());
+    if(!name.empty()) APPEND("<%s>", name.c_str());
+
+    output.append(buffer, std::min(pos, sizeof buffer - 1));
+    output += '\n';
+}
+#undef APPEND
@@ -0,0 +1,36 @@
+#ifndef EGALITO_APP_FASTDUMP_H
+#define EGALITO_APP_FASTDUMP_H
+
+#include <string>
+#include <iosfwd>
+
+class Program;
+class Module;
+class Function;
+class Instruction;
+struct cs_insn;
+
+/** Disassembly listing for large batches of binaries. Unlike ChunkDumper,
+    which formats one instruction at a time through the log, functions are
+    formatted in parallel into their own buffers and written out in address
+    order. Instructions are decoded straight from their bytes with the
+    thread's capstone handle, so no Assembly objects are created (or cached
+    in the shared chunk tree). Only functions are listed.
+*/
+class FastDump {
+private:
+    bool showBasicBlocks;
+    bool showBytes;
+public:
+    FastDump(bool showBasicBlocks, bool showBytes)
+        : showBasicBlocks(showBasicBlocks), showBytes(showBytes) {}
+
+    void dump(Program *program, std::ostream &stream);
+    void dump(Module *module, std::ostream &stream);
+private:
+    void formatFunction(Function *function, std::string &output);
+    void formatInstruction(Instruction *instruction, int offset,
+        cs_insn *insn, std::string &output);
+};
+
+#endif
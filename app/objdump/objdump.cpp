@@ -2,6 +2,7 @@
 #include <functional>
 #include <cstring>  // for std::strcmp
 #include "objdump.h"
+#include "fastdump.h"
 #include "conductor/conductor.h"
 #include "chunk/dump.h"
 #include "log/registry.h"
@@ -27,6 +28,13 @@ void ObjDump::parse(const char *filename) {
             setup.parseEgalitoArchive(filename);
         }
 
+        if(options.getFast()) {
+            FastDump dumper(options.getShowBasicBlocks(),
+                options.getShowBytes());
+            dumper.dump(setup.getConductor()->getProgram(), std::cout);
+            return;
+        }
+
         const int logLevel = options.getShowBytes() ? 20 : 9;
         TemporaryLogLevel enableDisassemblyOutput1("chunk", logLevel);
         TemporaryLogLevel enableDisassemblyOutput2("disasm", logLevel);
@@ -52,6 +60,8 @@ void printUsage(const char *program) {
         "    --no-basic-blocks  Don't split functions into blocks in output\n"
         "    --bytes         Show disassembled instruction bytes\n"
         "    --no-bytes      Don't show instruction bytes (default)\n"
+        "    --fast          Format functions in parallel, without the log\n"
+        "    --no-fast       Dump everything through ChunkDumper (default)\n"
         "\n"
         "Note: the EGALITO_DEBUG variable is also honoured.\n";
 }
@@ -106,6 +116,14 @@ int main(int argc, char *argv[]) {
         {"--no-bytes", [] (ObjDumpOptions &options) {
             options.setShowBytes(false);
         }},
+
+        // should functions be formatted in parallel (see FastDump)?
+        {"--fast", [] (ObjDumpOptions &options) {
+            options.setFast(true);
+        }},
+        {"--no-fast", [] (ObjDumpOptions &options) {
+            options.setFast(false);
+        }},
     };
 
     ObjDump objdump;
@@ -9,16 +9,19 @@ private:
     bool recursive = false;
     bool showBasicBlocks = false;
     bool showBytes = false;
+    bool fast = false;
 public:
     bool getDebugMessages() const { return debugMessages; }
     bool getRecursive() const { return recursive; }
     bool getShowBasicBlocks() const { return showBasicBlocks; }
     bool getShowBytes() const { return showBytes; }
+    bool getFast() const { return fast; }
 
     void setDebugMessages(bool d) { debugMessages = d; }
     void setRecursive(bool r) { recursive = r; }
     void setShowBasicBlocks(bool s) { showBasicBlocks = s; }
     void setShowBytes(bool s) { showBytes = s; }
+    void setFast(bool f) { fast = f; }
 };
 
 class ObjDump {
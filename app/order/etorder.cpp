@@ -7,82 +7,46 @@
 #include <utility>
 #include <cmath>
 #include <functional>
+#include <map>
 #include <cstring>  // for std::strcmp
 #include "etorder.h"
 #include "conductor/interface.h"
+#include "analysis/functionlayout.h"
+#include "analysis/branchprofile.h"
 #include "chunk/function.h"
-#include "operation/find2.h"
+#include "pass/reorderblocks.h"
 
 #undef DEBUG_GROUP
 #define DEBUG_GROUP load
 #include "log/log.h"
 
-static unsigned long getBucket(unsigned long count) {
-    return count;
-    if(!count) return 0;
-    unsigned long value = std::log2l(count);
-    return value <= 3 ? 0 : value;
-}
-
-static std::vector<Function *> parseOrder(Conductor *conductor, Module *module,
-    const std::string &orderFile) {
-
-    std::ifstream file(orderFile.c_str());
-    std::string line;
-    std::map<Function *, unsigned long> data;
-    while(std::getline(file, line)) {
-        std::istringstream stream(line);
-
-        unsigned long count = 0;
-        std::string nameToken;
-        if(stream >> count >> nameToken
-            && nameToken[0] == '[' && nameToken[nameToken.length() - 1] == ']') {
-            
-            nameToken = nameToken.substr(1, nameToken.length() - 2);
-            auto f = ChunkFind2(conductor).findFunctionInModule(nameToken.c_str(), module);
-            if(f) {
-                data.insert(std::make_pair(f, getBucket(count)));
-                LOG(0, "count " << f->getName() << " = " << getBucket(count));
-            }
-        }
+static std::vector<Function *> parseOrder(Module *module,
+    const std::string &orderFile, bool reorderBlocks,
+    std::map<Block *, uint64_t> &blockCount) {
+
+    FunctionLayout layout(module);
+    layout.readProfile(orderFile);
+    auto order = layout.computeOrder();
+
+    if(reorderBlocks) {
+        BranchProfile profile;
+        profile.read(orderFile);
+        ReorderBlocksPass reorder(&profile);
+        module->accept(&reorder);
+        for(auto cold : reorder.getColdList()) order.push_back(cold);
+        blockCount = reorder.getBlockCounts();
     }
 
-    std::map<Function *, unsigned long> input;
-    unsigned long index = 0;
-    for(auto func : CIter::functions(module)) {
-        input.insert(std::make_pair(func, index ++));
-    }
-
-    std::vector<Function *> order;
-    for(auto func : CIter::functions(module)) order.push_back(func);
-
-    std::sort(order.begin(), order.end(), [&data, &input] (Function *a, Function *b) {
-        //return input[a] < input[b];
-        auto ad = data.find(a);
-        auto bd = data.find(b);
-        if(ad != data.end() && bd != data.end()) {
-            if((*ad).second < (*bd).second) return false;
-            else if((*ad).second > (*bd).second) return true;
-        }
-        else if(ad != data.end() && (*ad).second) {
-            return true;
-        }
-        else if(bd != data.end() && (*bd).second) {
-            return false;
-        }
-        return input[a] < input[b];
-    });
     for(auto f : order) {
-        unsigned long count = 0;
-        if(data.find(f) != data.end()) count = data[f];
-        LOG(1, "    [" << f->getName() << "] index " << std::dec << input[f] << " count " << count);
+        LOG(1, "    [" << f->getName() << "]");
     }
-
+    LOG(0, "hot code is " << std::dec << layout.getHotSize() << " bytes");
     return order;
 }
 
 static void parse(const std::string &filename, const std::string &orderFile,
-    const std::string &output, bool oneToOne, bool quiet) {
+    const std::string &output, bool oneToOne, bool quiet,
+    bool reorderBlocks, bool alignLoops) {
 
     std::cout << "Transforming file [" << filename << "]\n";
 
@@ -110,7 +74,12 @@ static void parse(const std::string &filename, const std::string &orderFile,
         std::cout << "Performing code generation into [" << output << "]...\n";
         assert(oneToOne);
 
-        auto order = parseOrder(egalito.getConductor(), module, orderFile);
+        std::map<Block *, uint64_t> blockCount;
+        auto order = parseOrder(module, orderFile, reorderBlocks, blockCount);
+        if(alignLoops) {
+            // with a block layout, the samples say which loops are hot
+            egalito.setAlignLoops(reorderBlocks ? &blockCount : nullptr);
+        }
 
         egalito.generate(output, order);
 
@@ -129,6 +98,10 @@ static void printUsage(const char *program) {
         "    -u     Perform union elf generation (merged output)\n"
         "    -v     Verbose mode, print logging messages\n"
         "    -q     Quiet mode (default), suppress logging messages\n"
+        "    -b     Also reorder basic blocks and split off cold blocks\n"
+        "    -a     Align loop heads (the sampled ones, with -b)\n"
+        "The function-ordering file holds \"count [function]\" lines, or\n"
+        "    branch samples as \"from to [count]\" or perf brstack entries.\n"
         "Note: the EGALITO_DEBUG variable is also honoured.\n";
 }
 
@@ -140,6 +113,8 @@ int main(int argc, char *argv[]) {
 
     bool oneToOne = true;
     bool quiet = true;
+    bool reorderBlocks = false;
+    bool alignLoops = false;
 
     struct {
         const char *str;
@@ -152,6 +127,12 @@ int main(int argc, char *argv[]) {
         // should we show debugging log messages?
         {"-v", [&quiet] () { quiet = false; }},
         {"-q", [&quiet] () { quiet = true; }},
+
+        // should basic blocks be laid out by the profile too?
+        {"-b", [&reorderBlocks] () { reorderBlocks = true; }},
+
+        // should hot loops start on a 32-byte boundary?
+        {"-a", [&alignLoops] () { alignLoops = true; }},
     };
 
     for(int a = 1; a < argc; a ++) {
@@ -171,7 +152,8 @@ int main(int argc, char *argv[]) {
             }
         }
         else if(argv[a] && argv[a + 1] && argv[a + 2]) {
-            parse(argv[a], argv[a + 1], argv[a + 2], oneToOne, quiet);
+            parse(argv[a], argv[a + 1], argv[a + 2], oneToOne, quiet,
+                reorderBlocks, alignLoops);
             break;
         }
         else {
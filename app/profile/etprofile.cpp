@@ -1,24 +1,35 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
 #include <cstring>  // for std::strlen
+#include <cstdint>
 #include <cstdio>
 #include "elf/elfmap.h"
+#include "elf/symbol.h"
+#include "runtime/calltrace.h"
 
 static void printUsage(const char *program) {
     std::cout << "Usage: " << program << " [options] executable\n"
+        "       " << program << " --calls tracefile\n"
         "    Summarizes profiling information from profile.data, like gprof.\n"
+        "    For etharden --profile-perf output, reads perfcount.data.\n"
+        "    With --calls, prints an EGALITO_LOG_CALL_TRACE file.\n"
         "\n"
         "Note: the EGALITO_DEBUG variable is also honoured.\n";
 }
 
-int main(int argc, char *argv[]) {
-    if(argc < 2) {
-        printUsage(argv[0] ? argv[0] : "etprofile");
-        return 0;
+static uint32_t readUint32(const char *p) {
+    uint32_t value = 0;
+    for(int i = 0; i < 4; i ++) {
+        value |= static_cast<uint32_t>(static_cast<unsigned char>(p[i])) << (i*8);
     }
+    return value;
+}
 
-    ElfMap *elf = new ElfMap(argv[1]);
+static void summarizeCounts(ElfMap *elf) {
     auto section = elf->findSection(".profiling");
     auto nameSection = elf->findSection(".profiling.names");
 
@@ -39,5 +50,205 @@ int main(int argc, char *argv[]) {
         p += std::strlen(p) + 1;
     }
 
+    // functions without a counter of their own: a name, then the index of
+    // the counter and the multiplier it is derived with
+    if(auto derivedSection = elf->findSection(".profiling.derived")) {
+        const char *d = reinterpret_cast<char *>(
+            derivedSection->getReadAddress());
+        const char *end = d + derivedSection->getSize();
+        while(d < end) {
+            const char *name = d;
+            d += std::strlen(d) + 1;
+            auto index = readUint32(d);
+            auto multiplier = readUint32(d + 4);
+            d += 8;
+            if(index >= count.size()) continue;
+            std::printf("%5ld [%s] (derived)\n", count[index] * multiplier, name);
+        }
+    }
+}
+
+static void summarizeSamples(ElfMap *elf, ElfSection *section) {
+    const size_t HEADER_SIZE = 16;
+    size_t size = section->getSize();
+    size_t ringSize = (size - HEADER_SIZE) / sizeof(uint64_t);
+
+    // function symbols by address, to look up each sampled PC
+    std::map<address_t, Symbol *> functionMap;
+    auto symbolList = SymbolList::buildSymbolList(elf);
+    if(symbolList) {
+        for(auto symbol : *symbolList) {
+            if(symbol->getType() == Symbol::TYPE_FUNC && symbol->getSize()) {
+                functionMap[symbol->getAddress()] = symbol;
+            }
+        }
+    }
+
+    std::map<std::string, unsigned long> count;
+    unsigned long total = 0;
+    char *data = new char [size];
+    std::ifstream file("profile.data");
+    while(file.read(data, size)) {
+        auto header = reinterpret_cast<uint64_t *>(data);
+        auto ring = reinterpret_cast<uint64_t *>(data + HEADER_SIZE);
+        // the section's address at runtime, vs. in the ELF
+        auto bias = header[1] - section->getHeader()->sh_addr;
+        size_t n = std::min(static_cast<size_t>(header[0]), ringSize);
+        for(size_t i = 0; i < n; i ++) {
+            address_t pc = ring[i] - bias;
+            std::string name = "(unknown)";
+            auto it = functionMap.upper_bound(pc);
+            if(it != functionMap.begin()) {
+                --it;
+                if(pc < it->first + it->second->getSize()) {
+                    name = it->second->getName();
+                }
+            }
+            count[name] ++;
+            total ++;
+        }
+    }
+
+    std::vector<std::pair<unsigned long, std::string>> sorted;
+    for(auto &kv : count) sorted.emplace_back(kv.second, kv.first);
+    std::sort(sorted.rbegin(), sorted.rend());
+
+    std::printf("%lu samples\n", total);
+    for(auto &entry : sorted) {
+        std::printf("%5.1f%% %5ld [%s]\n",
+            100.0 * entry.first / total, entry.first, entry.second.c_str());
+    }
+}
+
+static void summarizePerfCounts(ElfMap *elf, ElfSection *nameSection) {
+    // per function: calls, then cycles, iTLB, L1i and branch misses
+    const size_t FIELDS = 5;
+    const char *eventNames[] = {
+        "calls", "cycles", "itlb-miss", "l1i-miss", "br-miss"
+    };
+
+    std::vector<std::string> names;
+    const char *p = reinterpret_cast<char *>(nameSection->getReadAddress());
+    const char *end = p + nameSection->getSize();
+    while(p < end) {
+        names.push_back(p);
+        p += std::strlen(p) + 1;
+    }
+
+    // one block per run: the function count, then the records
+    std::vector<uint64_t> total(names.size() * FIELDS);
+    std::ifstream file("perfcount.data");
+    uint64_t count;
+    size_t runs = 0;
+    while(file.read(reinterpret_cast<char *>(&count), sizeof(count))) {
+        std::vector<uint64_t> record(count * FIELDS);
+        if(!file.read(reinterpret_cast<char *>(record.data()),
+            record.size() * sizeof(uint64_t))) break;
+
+        for(size_t i = 0; i < record.size() && i < total.size(); i ++) {
+            total[i] += record[i];
+        }
+        runs ++;
+    }
+
+    std::vector<size_t> order;
+    for(size_t i = 0; i < names.size(); i ++) {
+        if(total[i * FIELDS]) order.push_back(i);
+    }
+    std::sort(order.begin(), order.end(), [&total] (size_t a, size_t b) {
+        return total[a * FIELDS + 1] > total[b * FIELDS + 1];
+    });
+
+    std::printf("%lu runs; counts include callees\n", runs);
+    for(size_t f = 0; f < FIELDS; f ++) std::printf("%14s ", eventNames[f]);
+    std::printf("function\n");
+    for(auto i : order) {
+        for(size_t f = 0; f < FIELDS; f ++) {
+            std::printf("%14lu ", total[i * FIELDS + f]);
+        }
+        std::printf("[%s]\n", names[i].c_str());
+    }
+}
+
+static void printCallTrace(const char *filename) {
+    std::ifstream file(filename, std::ios::binary);
+    CallTracer::FileHeader header;
+    if(!file.read(reinterpret_cast<char *>(&header), sizeof(header))
+        || std::memcmp(header.magic, "ECTR", 4) != 0 || header.version != 1) {
+
+        std::cerr << "not a call trace: " << filename << "\n";
+        return;
+    }
+
+    std::vector<CallTracer::FunctionRecord> table(header.functionCount);
+    std::vector<char> names(header.namesSize + 1);
+    file.read(reinterpret_cast<char *>(table.data()),
+        table.size() * sizeof(CallTracer::FunctionRecord));
+    file.read(names.data(), header.namesSize);
+
+    // one call depth and starting timestamp per ring
+    std::map<uint32_t, int> depth;
+    std::map<uint32_t, uint64_t> first;
+    CallTracer::BlockHeader block;
+    while(file.read(reinterpret_cast<char *>(&block), sizeof(block))) {
+        if(std::memcmp(block.magic, "ECTB", 4) != 0) {
+            std::cerr << "corrupt block in " << filename << "\n";
+            return;
+        }
+        if(block.dropped) {
+            std::printf("[thread %u] %u records dropped\n",
+                block.thread, block.dropped);
+        }
+
+        std::vector<CallTracer::Record> records(block.count);
+        if(!file.read(reinterpret_cast<char *>(records.data()),
+            records.size() * sizeof(CallTracer::Record))) break;
+
+        for(const auto &record : records) {
+            if(!first.count(block.thread)) {
+                first[block.thread] = record.timestamp;
+            }
+            bool entry = (record.direction == CallTracer::DIRECTION_ENTRY);
+            int &d = depth[block.thread];
+            if(entry) d ++;
+
+            const char *name = "(unknown)";
+            if(record.id < table.size()
+                && table[record.id].nameOffset < header.namesSize) {
+
+                name = &names[table[record.id].nameOffset];
+            }
+            std::printf("[thread %u] %14lu %4d %s %s\n", block.thread,
+                static_cast<unsigned long>(
+                    record.timestamp - first[block.thread]),
+                d, entry ? "->" : "<-", name);
+
+            if(!entry) d --;
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    if(argc < 2) {
+        printUsage(argv[0] ? argv[0] : "etprofile");
+        return 0;
+    }
+    if(std::strcmp(argv[1], "--calls") == 0) {
+        if(argc < 3) printUsage(argv[0]);
+        else printCallTrace(argv[2]);
+        return 0;
+    }
+
+    ElfMap *elf = new ElfMap(argv[1]);
+    if(auto section = elf->findSection(".profiling.samples")) {
+        summarizeSamples(elf, section);
+    }
+    else if(auto section = elf->findSection(".perfcount.names")) {
+        summarizePerfCounts(elf, section);
+    }
+    else {
+        summarizeCounts(elf);
+    }
+
     return 0;
 }
@@ -0,0 +1,279 @@
+#include <linux/perf_event.h>
+#include <asm/unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+/* Advice for PerfCountPass. Each thread opens one group of perf events
+ * (whichever of EVENT_COUNT the CPU supports), and every instrumented
+ * function reads the group on entry and exit; the difference is added to
+ * that function's totals, so counts include callees and the advice of
+ * their own calls.
+ *
+ * libc is instrumented too, so nothing here may call into it: syscalls
+ * are made directly, and the library is built with -mgeneral-regs-only so
+ * that the advice only has to preserve general-purpose registers.
+ */
+
+#define MAX_FUNCTIONS   0x10000
+#define MAX_THREADS     256
+#define MAX_DEPTH       512
+#define EVENT_COUNT     4
+#define MATCH_DEPTH     8   // frames searched for a matching entry
+
+struct record {
+    unsigned long calls;
+    unsigned long events[EVENT_COUNT];
+};
+
+struct frame {
+    unsigned long index;
+    unsigned long start[EVENT_COUNT];
+};
+
+struct thread {
+    int tid;        // 0 if the slot is free; slots are never recycled
+    int fd;         // group leader, or -1 if no event could be opened
+    int busy;       // set while in the advice, e.g. for signal handlers
+    int eventCount;
+    int eventMap[EVENT_COUNT];  // position in the group -> event
+    unsigned long depth;
+    unsigned long overflow;     // entries past MAX_DEPTH
+    struct frame stack[MAX_DEPTH];
+};
+
+struct state {
+    unsigned long functionCount;    // highest index seen, plus one
+    struct record records[MAX_FUNCTIONS];
+    struct thread threads[MAX_THREADS];
+};
+
+static struct state *state;
+
+static const struct {
+    unsigned int type;
+    unsigned long config;
+} eventList[EVENT_COUNT] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_ITLB
+        | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+        | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1I
+        | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+        | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+static long perfcount_syscall(long number, long a, long b, long c, long d,
+    long e, long f) {
+
+    long result;
+    register long r10 __asm__("r10") = d;
+    register long r8 __asm__("r8") = e;
+    register long r9 __asm__("r9") = f;
+    __asm__ __volatile__ (
+        "syscall"
+        : "=a"(result)
+        : "a"(number), "D"(a), "S"(b), "d"(c), "r"(r10), "r"(r8), "r"(r9)
+        : "rcx", "r11", "memory"
+    );
+    return result;
+}
+
+static struct state *get_state(void) {
+    struct state *s = __atomic_load_n(&state, __ATOMIC_ACQUIRE);
+    if(s) return s;
+
+    s = (struct state *)perfcount_syscall(__NR_mmap, 0, sizeof(struct state),
+        PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if((unsigned long)s > -4096UL) return 0;
+
+    struct state *expected = 0;
+    if(!__atomic_compare_exchange_n(&state, &expected, s, 0,
+        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+
+        // another thread got there first
+        perfcount_syscall(__NR_munmap, (long)s, sizeof(struct state),
+            0, 0, 0, 0);
+        s = expected;
+    }
+    return s;
+}
+
+static void open_events(struct thread *t) {
+    struct perf_event_attr attr;
+    volatile char *p = (volatile char *)&attr;
+    for(unsigned long i = 0; i < sizeof(attr); i ++) p[i] = 0;
+
+    t->fd = -1;
+    t->eventCount = 0;
+    for(int e = 0; e < EVENT_COUNT; e ++) {
+        attr.type = eventList[e].type;
+        attr.size = sizeof(attr);
+        attr.config = eventList[e].config;
+        attr.read_format = PERF_FORMAT_GROUP;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        // this thread, any cpu
+        long fd = perfcount_syscall(__NR_perf_event_open, (long)&attr, 0, -1,
+            t->fd, PERF_FLAG_FD_CLOEXEC, 0);
+        if(fd < 0) continue;  // not supported here, or not permitted
+
+        if(t->fd < 0) t->fd = fd;
+        t->eventMap[t->eventCount ++] = e;
+    }
+}
+
+static struct thread *get_thread(struct state *s) {
+    int tid = perfcount_syscall(__NR_gettid, 0, 0, 0, 0, 0, 0);
+    for(int i = 0; i < MAX_THREADS; i ++) {
+        struct thread *t = &s->threads[(tid + i) % MAX_THREADS];
+        int owner = __atomic_load_n(&t->tid, __ATOMIC_ACQUIRE);
+        if(owner == tid) return t;
+        if(owner) continue;
+
+        int expected = 0;
+        if(__atomic_compare_exchange_n(&t->tid, &expected, tid, 0,
+            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+
+            t->busy = 1;
+            open_events(t);
+            t->busy = 0;
+            return t;
+        }
+    }
+    return 0;
+}
+
+static void read_events(struct thread *t, unsigned long *values) {
+    unsigned long buffer[1 + EVENT_COUNT];  // nr, then one value per event
+
+    for(int e = 0; e < EVENT_COUNT; e ++) values[e] = 0;
+    if(t->fd < 0) return;
+    if(perfcount_syscall(__NR_read, t->fd, (long)buffer, sizeof(buffer),
+        0, 0, 0) <= 0) return;
+
+    for(int i = 0; i < t->eventCount && i < (int)buffer[0]; i ++) {
+        values[t->eventMap[i]] = buffer[1 + i];
+    }
+}
+
+__attribute__((visibility("hidden")))
+void perfcount_enter(unsigned long index) {
+    struct state *s = get_state();
+    if(!s || index >= MAX_FUNCTIONS) return;
+    struct thread *t = get_thread(s);
+    if(!t || t->busy) return;
+    t->busy = 1;
+
+    unsigned long count = __atomic_load_n(&s->functionCount, __ATOMIC_RELAXED);
+    while(count <= index && !__atomic_compare_exchange_n(&s->functionCount,
+        &count, index + 1, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+
+    if(t->depth < MAX_DEPTH) {
+        struct frame *frame = &t->stack[t->depth ++];
+        frame->index = index;
+        read_events(t, frame->start);
+    }
+    else t->overflow ++;
+
+    t->busy = 0;
+}
+
+__attribute__((visibility("hidden")))
+void perfcount_exit(unsigned long index) {
+    struct state *s = __atomic_load_n(&state, __ATOMIC_ACQUIRE);
+    if(!s || index >= MAX_FUNCTIONS) return;
+    struct thread *t = get_thread(s);
+    if(!t || t->busy) return;
+    t->busy = 1;
+
+    if(t->overflow) {
+        t->overflow --;
+        t->busy = 0;
+        return;
+    }
+
+    // frames above a match belong to calls that left without returning,
+    // e.g. by longjmp; an unmatched exit (a tail call) is ignored
+    unsigned long end[EVENT_COUNT];
+    read_events(t, end);
+    for(unsigned long d = t->depth; d > 0 && t->depth - d < MATCH_DEPTH; d --) {
+        struct frame *frame = &t->stack[d - 1];
+        if(frame->index != index) continue;
+
+        struct record *record = &s->records[index];
+        __atomic_fetch_add(&record->calls, 1, __ATOMIC_RELAXED);
+        for(int e = 0; e < EVENT_COUNT; e ++) {
+            __atomic_fetch_add(&record->events[e], end[e] - frame->start[e],
+                __ATOMIC_RELAXED);
+        }
+        t->depth = d - 1;
+        break;
+    }
+
+    t->busy = 0;
+}
+
+/* Appends the function count, then one struct record per function, to
+ * perfcount.data (the same way profile.data collects one run after
+ * another). Called as a fini function.
+ */
+void egalito_perfcount_save(void) {
+    struct state *s = __atomic_load_n(&state, __ATOMIC_ACQUIRE);
+    if(!s) return;
+
+    long fd = perfcount_syscall(__NR_open, (long)"perfcount.data",
+        O_WRONLY | O_CREAT | O_APPEND, 0644, 0, 0, 0);
+    if(fd < 0) return;
+
+    unsigned long count = s->functionCount;
+    perfcount_syscall(__NR_write, fd, (long)&count, sizeof(count), 0, 0, 0);
+    perfcount_syscall(__NR_write, fd, (long)s->records,
+        count * sizeof(struct record), 0, 0, 0);
+    perfcount_syscall(__NR_close, fd, 0, 0, 0, 0, 0);
+}
+
+/* The advice itself. The function's index is in %r11; the stack may be
+ * misaligned before an epilogue, so it is realigned for the C code. Flags
+ * are saved in case a call is instrumented in hand-written assembly.
+ */
+#define PERFCOUNT_ADVICE(name, body) \
+    __asm__ ( \
+        ".text\n" \
+        ".global " #name "\n" \
+        ".type " #name ", @function\n" \
+        #name ":\n" \
+        "    pushfq\n" \
+        "    push %rax\n" \
+        "    push %rcx\n" \
+        "    push %rdx\n" \
+        "    push %rsi\n" \
+        "    push %rdi\n" \
+        "    push %r8\n" \
+        "    push %r9\n" \
+        "    push %r10\n" \
+        "    push %r11\n" \
+        "    push %rbp\n" \
+        "    mov %rsp, %rbp\n" \
+        "    and $-16, %rsp\n" \
+        "    mov %r11, %rdi\n" \
+        "    call " #body "\n" \
+        "    mov %rbp, %rsp\n" \
+        "    pop %rbp\n" \
+        "    pop %r11\n" \
+        "    pop %r10\n" \
+        "    pop %r9\n" \
+        "    pop %r8\n" \
+        "    pop %rdi\n" \
+        "    pop %rsi\n" \
+        "    pop %rdx\n" \
+        "    pop %rcx\n" \
+        "    pop %rax\n" \
+        "    popfq\n" \
+        "    ret\n" \
+        ".size " #name ", .-" #name "\n" \
+    )
+
+PERFCOUNT_ADVICE(egalito_perfcount_enter, perfcount_enter);
+PERFCOUNT_ADVICE(egalito_perfcount_exit, perfcount_exit);
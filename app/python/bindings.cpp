@@ -2,14 +2,29 @@
 #include "conductor/setup.h"
 #include "operation/find2.h"
 #include "conductor/conductor.h"
+#include "transform/sandbox.h"
 #include "elf/symbol.h"
 #include "chunk/chunkfwd.h"
 #include "chunk/dump.h"
 #include "chunk/visitor.h"
 #include "types.h"
+#include "bulk.h"
 
 using namespace boost::python;
 
+/** Returns the generated ELF as bytes, without writing a file. */
+static object generateImage(ConductorSetup &setup, bool isUnion) {
+    bool ok = isUnion ? setup.generateStaticExecutable(nullptr)
+        : setup.generateMirrorELF(nullptr);
+    if(!ok) throw "code generation failed";
+
+    auto &image = setup.getGeneratedImage();
+    object bytes(handle<>(PyBytes_FromStringAndSize(image.data(),
+        image.length())));
+    std::string().swap(image);
+    return bytes;
+}
+
 BOOST_PYTHON_MODULE(python_egalito) {
     register_exception_translator<const char *>([] (const char *s) {
         PyErr_SetString(PyExc_RuntimeError, s);
@@ -41,13 +56,37 @@ BOOST_PYTHON_MODULE(python_egalito) {
 		.def("get_name", &Function::getName)
 		.def("accept",  &Function::accept);
 
-	class_<Conductor>("Conductor");
+	class_<Module, boost::noncopyable>("Module", no_init)
+		.def("get_name", &Module::getName);
+
+	class_<Program, boost::noncopyable>("Program", no_init)
+		.def("get_main", &Program::getMain, return_internal_reference<>())
+		.def("get_libc", &Program::getLibc, return_internal_reference<>());
+
+	class_<Conductor>("Conductor")
+		.def("get_program", &Conductor::getProgram, return_internal_reference<>());
+
+	class_<InstructionTable, boost::noncopyable>("InstructionTable", init<Function *>())
+		.def(init<Module *>())
+		.def(init<Program *>())
+		.def("function_count",    &InstructionTable::getFunctionCount)
+		.def("instruction_count", &InstructionTable::getInstructionCount)
+		.def("function_names",    &InstructionTable::getFunctionNames)
+		.def("function_starts",   &InstructionTable::getFunctionStarts)
+		.def("block_starts",      &InstructionTable::getBlockStarts)
+		.def("addresses",         &InstructionTable::getAddresses)
+		.def("sizes",             &InstructionTable::getSizes)
+		.def("link_targets",      &InstructionTable::getLinkTargets)
+		.def("raw_bytes",         &InstructionTable::getRawBytes);
+
+	class_<Sandbox, boost::noncopyable>("Sandbox", no_init);
 
-	class_<ConductorSetup>("ConductorSetup")
-		.def("parse_elf_files",            &ConductorSetup::parseElfFiles)
+	class_<ConductorSetup, boost::noncopyable>("ConductorSetup")
+		.def("parse_elf_files",            &ConductorSetup::parseElfFiles, return_internal_reference<>())
 		.def("get_conductor",              &ConductorSetup::getConductor, return_internal_reference<>())
-		.def("make_loader_sandbox",        &ConductorSetup::makeLoaderSandbox)
-		.def("move_code_assign_addresses", &ConductorSetup::moveCodeAssignAddresses);
+		.def("make_loader_sandbox",        &ConductorSetup::makeLoaderSandbox, return_internal_reference<>())
+		.def("move_code_assign_addresses", &ConductorSetup::moveCodeAssignAddresses)
+		.def("generate_image",             &generateImage, arg("is_union")=false);
 
 	class_<ChunkVisitor, boost::noncopyable>("ChunkVisitor", no_init);
 
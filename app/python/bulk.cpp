@@ -0,0 +1,144 @@
+#include <cstdint>
+#include "bulk.h"
+#include "chunk/concrete.h"
+#include "chunk/chunkiter.h"
+#include "chunk/link.h"
+#include "instr/instr.h"
+#include "instr/semantic.h"
+#include "instr/writer.h"
+
+using namespace boost::python;
+
+/** A bytes object of the given size, to be filled in place. */
+static object makeStorage(size_t size) {
+    PyObject *bytes = PyBytes_FromStringAndSize(nullptr, size);
+    if(!bytes) throw_error_already_set();
+    return object(handle<>(bytes));
+}
+
+template <typename T>
+static T *storageOf(object &storage) {
+    return reinterpret_cast<T *>(PyBytes_AS_STRING(storage.ptr()));
+}
+
+/** Zero-copy view of a storage object; it keeps the bytes alive. */
+static object viewOf(const object &storage, const char *format) {
+    object view(handle<>(PyMemoryView_FromObject(storage.ptr())));
+    return view.attr("cast")(format);
+}
+
+static address_t linkTarget(Link *link) {
+    if(!link) return 0;
+    // the displacement is what instructions with two links dereference
+    if(auto both = dynamic_cast<ImmAndDispLink *>(link)) {
+        link = both->getDispLink();
+    }
+    return link->getTargetAddress();
+}
+
+InstructionTable::InstructionTable(Function *function)
+    : instructionCount(0) {
+
+    build({function});
+}
+
+InstructionTable::InstructionTable(Module *module) : instructionCount(0) {
+    std::vector<Function *> functionList;
+    for(auto function : CIter::functions(module)) {
+        functionList.push_back(function);
+    }
+    build(functionList);
+}
+
+InstructionTable::InstructionTable(Program *program) : instructionCount(0) {
+    std::vector<Function *> functionList;
+    for(auto module : CIter::modules(program)) {
+        for(auto function : CIter::functions(module)) {
+            functionList.push_back(function);
+        }
+    }
+    build(functionList);
+}
+
+void InstructionTable::build(const std::vector<Function *> &functionList) {
+    // size everything first, so that each array is allocated exactly once
+    size_t blockCount = 0, byteCount = 0;
+    for(auto function : functionList) {
+        for(auto block : CIter::children(function)) {
+            blockCount ++;
+            for(auto instr : CIter::children(block)) {
+                instructionCount ++;
+                byteCount += instr->getSize();
+            }
+        }
+    }
+
+    functionStarts = makeStorage((functionList.size() + 1) * sizeof(uint64_t));
+    blockStarts = makeStorage((blockCount + 1) * sizeof(uint64_t));
+    addressArray = makeStorage(instructionCount * sizeof(uint64_t));
+    sizeArray = makeStorage(instructionCount * sizeof(uint32_t));
+    linkArray = makeStorage(instructionCount * sizeof(uint64_t));
+    byteArray = makeStorage(byteCount);
+
+    auto functionOut = storageOf<uint64_t>(functionStarts);
+    auto blockOut = storageOf<uint64_t>(blockStarts);
+    auto addressOut = storageOf<uint64_t>(addressArray);
+    auto sizeOut = storageOf<uint32_t>(sizeArray);
+    auto linkOut = storageOf<uint64_t>(linkArray);
+    auto byteOut = storageOf<char>(byteArray);
+
+    size_t index = 0;
+    names.reserve(functionList.size());
+    for(auto function : functionList) {
+        names.push_back(function->getName());
+        *functionOut++ = index;
+        for(auto block : CIter::children(function)) {
+            *blockOut++ = index;
+            for(auto instr : CIter::children(block)) {
+                // control-flow semantics have no stored bytes, so encode
+                // each instruction the way code generation would
+                auto semantic = instr->getSemantic();
+                InstrWriterCString writer(byteOut);
+                semantic->accept(&writer);
+                byteOut += instr->getSize();
+
+                addressOut[index] = instr->getAddress();
+                sizeOut[index] = instr->getSize();
+                linkOut[index] = linkTarget(semantic->getLink());
+                index ++;
+            }
+        }
+    }
+    *functionOut = index;
+    *blockOut = index;
+}
+
+list InstructionTable::getFunctionNames() const {
+    list result;
+    for(const auto &name : names) result.append(name);
+    return result;
+}
+
+object InstructionTable::getFunctionStarts() const {
+    return viewOf(functionStarts, "Q");
+}
+
+object InstructionTable::getBlockStarts() const {
+    return viewOf(blockStarts, "Q");
+}
+
+object InstructionTable::getAddresses() const {
+    return viewOf(addressArray, "Q");
+}
+
+object InstructionTable::getSizes() const {
+    return viewOf(sizeArray, "I");
+}
+
+object InstructionTable::getLinkTargets() const {
+    return viewOf(linkArray, "Q");
+}
+
+object InstructionTable::getRawBytes() const {
+    return viewOf(byteArray, "B");
+}
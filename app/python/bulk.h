@@ -0,0 +1,58 @@
+#ifndef EGALITO_PYTHON_BULK_H
+#define EGALITO_PYTHON_BULK_H
+
+#include <string>
+#include <vector>
+#include <boost/python.hpp>
+
+class Chunk;
+class Function;
+class Module;
+class Program;
+
+/** Flattens every instruction under a Function, Module or Program into
+    parallel arrays, so that scripts can analyze whole libraries without
+    crossing into C++ once per instruction.
+
+    Each array is filled in place inside a Python bytes object and handed
+    out as a read-only memoryview of it, e.g.
+
+        addrs = numpy.frombuffer(table.addresses(), dtype=numpy.uint64)
+
+    so neither the table nor numpy copies the data, and the buffers stay
+    valid after the table (or the chunks it was built from) goes away.
+
+    Instructions are indexed in layout order: function i owns instructions
+    function_starts[i] to function_starts[i+1], and likewise for
+    block_starts. Byte offsets into raw_bytes are the running sum of sizes.
+*/
+class InstructionTable {
+private:
+    std::vector<std::string> names;
+    boost::python::object functionStarts;   // uint64, one per function + 1
+    boost::python::object blockStarts;      // uint64, one per block + 1
+    boost::python::object addressArray;     // uint64, one per instruction
+    boost::python::object sizeArray;        // uint32, one per instruction
+    boost::python::object linkArray;        // uint64 target, 0 if none
+    boost::python::object byteArray;        // all instructions' bytes
+    size_t instructionCount;
+public:
+    InstructionTable(Function *function);
+    InstructionTable(Module *module);
+    InstructionTable(Program *program);
+
+    size_t getFunctionCount() const { return names.size(); }
+    size_t getInstructionCount() const { return instructionCount; }
+    boost::python::list getFunctionNames() const;
+
+    boost::python::object getFunctionStarts() const;
+    boost::python::object getBlockStarts() const;
+    boost::python::object getAddresses() const;
+    boost::python::object getSizes() const;
+    boost::python::object getLinkTargets() const;
+    boost::python::object getRawBytes() const;
+private:
+    void build(const std::vector<Function *> &functionList);
+};
+
+#endif
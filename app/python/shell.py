@@ -72,6 +72,23 @@ class EgalitoShell(cmd.Cmd):
         else:
             print("%s not found" % (line))
 
+    def do_stats(self, line):
+        """
+        Summarizes the instructions of the whole program. The arrays of an
+        InstructionTable also work with numpy.frombuffer, without copying.
+        """
+        program = self.__conductor_setup.get_conductor().get_program()
+        table = eg.InstructionTable(program)
+        sizes = table.sizes()
+        links = table.link_targets()
+        linked = sum(1 for target in links if target)
+        print("%d functions, %d blocks, %d instructions (%d bytes)" % (
+            table.function_count(), len(table.block_starts()) - 1,
+            table.instruction_count(), len(table.raw_bytes())))
+        if table.instruction_count():
+            print("average size %.2f, %d with links" % (
+                sum(sizes) / len(sizes), linked))
+
     def do_reassign(self, line):
         """
         Allocates a sandbox and assigns functions new addresses
@@ -7,6 +7,7 @@
 #include "conductor/conductor.h"
 #include "conductor/passes.h"
 #include "chunk/dump.h"
+#include "chunk/dumpfile.h"
 #include "chunk/concrete.h"
 #include "chunk/serializer.h"
 #include "chunk/gstable.h"  // for testing
@@ -318,6 +319,18 @@ void DisassCommands::registerCommands(CompositeCommand *topLevel) {
         }
     }, "shows a list of all loaded modules");
 
+    topLevel->add("dumpfiles", [&] (Arguments args) {
+        args.shouldHaveAtLeast(1);
+        auto format = ChunkDumpFile::FORMAT_TEXT;
+        if(args.get(1) == "jsonl") format = ChunkDumpFile::FORMAT_JSONL;
+        else if(args.size() > 1 && args.get(1) != "text") {
+            std::cout << "unknown format \"" << args.get(1) << "\"\n";
+            return;
+        }
+        ChunkDumpFile(format).dumpProgram(
+            setup->getConductor()->getProgram(), args.front());
+    }, "dumps every module into its own file in a directory, as text or jsonl");
+
     topLevel->add("jumptables", [&] (Arguments args) {
         args.shouldHave(0);
         for(auto module : CIter::children(setup->getConductor()->getProgram())) {
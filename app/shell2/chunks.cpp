@@ -1,5 +1,6 @@
 #include <iostream>
 #include <typeinfo>
+#include <memory>
 #include "chunks.h"
 #include "chunk/chunk.h"
 #include "chunk/dump.h"
@@ -15,12 +16,26 @@ void ChunkCommands::construct(EgalitoInterface *egalito) {
         return true;
     }, "clears all loaded ELF files"));
     fullList->add(new FunctionCommand("parse", ArgumentSpecList({
-        {"-r", ArgumentSpec({"-r"}, ArgumentSpec::TYPE_FLAG)}
+        {"-r", ArgumentSpec({"-r"}, ArgumentSpec::TYPE_FLAG)},
+        {"-b", ArgumentSpec({"-b"}, ArgumentSpec::TYPE_FLAG)}
     }, {
         ArgumentSpec(ArgumentSpec::TYPE_FILENAME)
     }, 0), [egalito] (ShellState &state, ArgumentValueList &args) {
         auto isRecursive = args.getBool("-r", false);
-        if(args.getIndexedCount() > 0) {
+        if(args.getIndexedCount() > 0 && args.getBool("-b", false)) {
+            // the prompt stays usable; see SessionCommands::isBackgroundSafe
+            auto filename = args.getIndexed(0).getString();
+            auto module = std::make_shared<Module *>(nullptr);
+            state.startBackground("parse " + filename,
+                [egalito, filename, isRecursive, module] () {
+                    *module = egalito->parse(filename, isRecursive);
+                },
+                [&state, module] () {
+                    if(*module) state.setChunk(*module);
+                });
+            return true;
+        }
+        else if(args.getIndexedCount() > 0) {
             auto filename = args.getIndexed(0).getString();
             auto module = egalito->parse(filename, isRecursive);
 
@@ -35,7 +50,7 @@ void ChunkCommands::construct(EgalitoInterface *egalito) {
             (*args.getOutStream()) << "nothing to do?\n";
             return false;
         }
-    }, "parses input ELF files"));
+    }, "parses input ELF files (-b = in the background)"));
     fullList->add(new FunctionCommand("ls", ArgumentSpecList({
         {"-l", ArgumentSpec({"-l"}, ArgumentSpec::TYPE_FLAG)}
     }, {}),
@@ -223,6 +223,7 @@ bool PassCommands::runPassCommand(EgalitoInterface *egalito, ShellState &state,
         }
 
         delete pass;
+        state.addPassHistory(passName + " " + chunk->getName());
     }
     else {
         LOG(0, "ERROR: unsupported chunk type " << typeid(*chunk).name()
@@ -0,0 +1,101 @@
+#include <iostream>
+#include <fstream>
+#include "session.h"
+#include "chunk/serializer.h"
+
+#undef DEBUG_GROUP
+#define DEBUG_GROUP shell
+#define D_shell 9
+#include "log/log.h"
+
+// the pass history is kept next to the archive, one pass per line
+static std::string getHistoryFilename(const std::string &filename) {
+    return filename + ".passes";
+}
+
+void SessionCommands::construct(EgalitoInterface *egalito) {
+    fullList->add(new FunctionCommand("save", ArgumentSpecList({}, {
+        ArgumentSpec(ArgumentSpec::TYPE_FILENAME)
+    }, 1), [egalito] (ShellState &state, ArgumentValueList &args) {
+        return saveSession(egalito, state,
+            args.getIndexed(0).getString());
+    }, "saves the Program and pass history to an archive"));
+    fullList->add(new FunctionCommand("load", ArgumentSpecList({}, {
+        ArgumentSpec(ArgumentSpec::TYPE_FILENAME)
+    }, 1), [egalito] (ShellState &state, ArgumentValueList &args) {
+        return loadSession(egalito, state, args.getIndexed(0).getString());
+    }, "restores a saved session in the background"));
+    fullList->add(new FunctionCommand("wait", ArgumentSpecList({}, {}),
+        [] (ShellState &state, ArgumentValueList &args) {
+
+        state.waitForBackground();
+        return true;
+    }, "waits for a background parse or load to finish"));
+    fullList->add(new FunctionCommand("history", ArgumentSpecList({}, {}),
+        [] (ShellState &state, ArgumentValueList &args) {
+
+        auto out = args.getOutStream();
+        for(const auto &pass : state.getPassHistory()) {
+            (*out) << pass << std::endl;
+        }
+        return true;
+    }, "lists the passes run in this session"));
+}
+
+bool SessionCommands::saveSession(EgalitoInterface *egalito,
+    ShellState &state, const std::string &filename) {
+
+    auto program = egalito->getProgram();
+    if(!program) {
+        LOG(0, "nothing to save, parse a file first");
+        return false;
+    }
+
+    ChunkSerializer serializer;
+    serializer.serialize(program, filename, true);
+
+    std::ofstream history(getHistoryFilename(filename).c_str());
+    for(const auto &pass : state.getPassHistory()) {
+        history << pass << std::endl;
+    }
+    LOG(0, "saved session to [" << filename << "]");
+    return true;
+}
+
+bool SessionCommands::loadSession(EgalitoInterface *egalito,
+    ShellState &state, const std::string &filename) {
+
+    if(!std::ifstream(filename.c_str())) {
+        LOG(0, "no such session archive [" << filename << "]");
+        return false;
+    }
+
+    std::vector<std::string> passHistory;
+    std::ifstream history(getHistoryFilename(filename).c_str());
+    std::string line;
+    while(std::getline(history, line)) {
+        if(!line.empty()) passHistory.push_back(line);
+    }
+
+    state.startBackground("load " + filename,
+        [egalito, filename] () {
+            egalito->getSetup()->parseEgalitoArchive(filename.c_str());
+        },
+        [egalito, &state, passHistory] () {
+            state.clearReflog();
+            state.setChunk(egalito->getProgram());
+            state.setPassHistory(passHistory);
+        });
+    return true;
+}
+
+bool SessionCommands::isBackgroundSafe(const std::string &command) {
+    static const char *safeList[] = {
+        "quit", "help", "lspass", "history", "wc", "head", "grep", "awk",
+        "perl", "sh", "exec"
+    };
+    for(auto safe : safeList) {
+        if(command == safe) return true;
+    }
+    return false;
+}
@@ -0,0 +1,30 @@
+#ifndef EGALITO_SHELL2_SESSION_H
+#define EGALITO_SHELL2_SESSION_H
+
+#include <string>
+#include "code.h"
+#include "command.h"
+#include "conductor/interface.h"
+
+/** Saves the parsed Program to an Egalito archive, along with the list of
+    passes run on it, and restores it in the background so that the prompt
+    is usable right away. Commands that need the Program wait for it.
+*/
+class SessionCommands {
+private:
+    FullCommandList *fullList;
+public:
+    SessionCommands(FullCommandList *fullList) : fullList(fullList) {}
+    void construct(EgalitoInterface *egalito);
+
+    /** Starts loading an archive written by "save". */
+    static bool loadSession(EgalitoInterface *egalito, ShellState &state,
+        const std::string &filename);
+    /** True for commands that can run while a background job is active. */
+    static bool isBackgroundSafe(const std::string &command);
+private:
+    static bool saveSession(EgalitoInterface *egalito, ShellState &state,
+        const std::string &filename);
+};
+
+#endif
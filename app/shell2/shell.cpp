@@ -4,6 +4,7 @@
 #include "readline.h"
 #include "chunks.h"
 #include "passes.h"
+#include "session.h"
 #include "log/registry.h"
 
 #ifdef __GNUG__
@@ -24,12 +25,24 @@ Shell2App::Shell2App() : fullCommandList(&egalito) {
 
     passCommands = new PassCommands(&fullCommandList);
     passCommands->construct(&egalito);
+
+    SessionCommands sessionCommands(&fullCommandList);
+    sessionCommands.construct(&egalito);
+}
+
+void Shell2App::loadSession(const std::string &filename) {
+    SessionCommands::loadSession(&egalito, state, filename);
 }
 
 void Shell2App::mainLoop() {
     Readline readline(this, &fullCommandList);
     while(!state.isExiting()) {
+        state.pollBackground();
+
         std::ostringstream prompt;
+        if(state.hasBackground()) {
+            prompt << "(" << state.getBackgroundName() << ") ";
+        }
         if(!state.getChunk()) prompt << "egalito> ";
         else {
             prompt << "egalito:[" << state.getChunk()->getName() << "]> ";
@@ -242,6 +255,16 @@ void Shell2App::parseLine(const std::string &line) {
         commandList.push_back(std::make_pair(command, argList));
     }
 
+    for(auto &entry : commandList) {
+        if(state.hasBackground()
+            && !SessionCommands::isBackgroundSafe(entry.first->getName())) {
+
+            std::cout << "waiting for " << state.getBackgroundName()
+                << "...\n";
+            state.waitForBackground();
+        }
+    }
+
     for(size_t i = 1; i < commandList.size(); i ++) {
         Command *command = commandList[i].first;
         if(!command->getSpec().getSupportsInStream()) {
@@ -402,6 +425,10 @@ int main(int argc, char *argv[]) {
     std::cout << "Welcome to the egalito shell2 version "
         << _STRINGIZE2(GIT_VERSION) << ". Type \"help\" for usage.\n";
     Shell2App app;
+    if(argc > 1) {
+        // etshell2 session.cache: restore a session saved with "save"
+        app.loadSession(argv[1]);
+    }
     app.mainLoop();
 
     return 0;
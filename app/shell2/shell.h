@@ -16,6 +16,7 @@ private:
     PassCommands *passCommands;
 public:
     Shell2App();
+    void loadSession(const std::string &filename);
     void mainLoop();
 
     enum GlobalParseMode {
@@ -1,3 +1,4 @@
+#include <iostream>
 #include "state.h"
 
 void ShellState::setChunk(Chunk *chunk) {
@@ -13,3 +14,36 @@ Chunk *ShellState::popReflog() {
     reflog.pop_back();
     return last;
 }
+
+void ShellState::startBackground(const std::string &name,
+    std::function<void ()> job, std::function<void ()> finish) {
+
+    waitForBackground();
+    backgroundName = name;
+    backgroundDone = false;
+    backgroundFinish = finish;
+    background = new std::thread([this, name, job] () {
+        try {
+            job();
+        }
+        catch(const char *message) {
+            std::cerr << "Exception in background " << name << ": "
+                << message << std::endl;
+        }
+        backgroundDone = true;
+    });
+}
+
+void ShellState::pollBackground() {
+    if(background && backgroundDone) waitForBackground();
+}
+
+void ShellState::waitForBackground() {
+    if(!background) return;
+
+    background->join();
+    delete background;
+    background = nullptr;
+    if(backgroundFinish) backgroundFinish();
+    backgroundFinish = nullptr;
+}
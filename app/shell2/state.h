@@ -3,6 +3,10 @@
 
 #include <string>
 #include <map>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <functional>
 #include "chunk/chunk.h"
 
 class ShellEnvironment {
@@ -27,8 +31,17 @@ private:
     ShellEnvironment environment;
     std::vector<Chunk *> reflog;
     Chunk *chunk;
+    std::vector<std::string> passHistory;
+
+    // at most one background job (parse or load) at a time
+    std::thread *background;
+    std::string backgroundName;
+    std::atomic<bool> backgroundDone;
+    std::function<void ()> backgroundFinish;
 public:
-    ShellState() : exiting(false), color(COL_WHITE), chunk(nullptr) {}
+    ShellState() : exiting(false), color(COL_WHITE), chunk(nullptr),
+        background(nullptr), backgroundDone(false) {}
+    ~ShellState() { waitForBackground(); }
 
     bool isExiting() const { return exiting; }
     Color getColor() const { return color; }
@@ -40,6 +53,23 @@ public:
     void setChunk(Chunk *chunk);
     void clearReflog() { reflog.clear(); }
     Chunk *popReflog();
+
+    const std::vector<std::string> &getPassHistory() const
+        { return passHistory; }
+    void addPassHistory(const std::string &pass)
+        { passHistory.push_back(pass); }
+    void setPassHistory(const std::vector<std::string> &history)
+        { passHistory = history; }
+
+    /** Runs job on another thread; finish runs on the shell's thread once
+        the job is done, from pollBackground() or waitForBackground().
+    */
+    void startBackground(const std::string &name, std::function<void ()> job,
+        std::function<void ()> finish);
+    bool hasBackground() const { return background != nullptr; }
+    const std::string &getBackgroundName() const { return backgroundName; }
+    void pollBackground();
+    void waitForBackground();
 };
 
 #endif
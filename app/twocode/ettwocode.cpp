@@ -4,6 +4,8 @@
 #include <cstring>  // for std::strcmp
 #include "ettwocode.h"
 #include "chunk/concrete.h"
+#include "elf/elfspace.h"
+#include "elf/symbol.h"
 #include "pass/chunkpass.h"
 #include "pass/condwatchpoint.h"
 #include "pass/twocodevars.h"
@@ -45,7 +47,23 @@ void TwocodeApp::generate(const std::string &output, bool oneToOne) {
 void TwocodeApp::doWatching() {
     std::cout << "Adding conditional watchpoint...\n";
     auto program = getProgram();
-    RUN_PASS(CondWatchpointPass(), program);
+
+    CondWatchpointPass watchpoint;
+    auto elfSpace = program->getMain()->getElfSpace();
+    for(const auto &name : watchNames) {
+        auto symbol = elfSpace && elfSpace->getSymbolList()
+            ? elfSpace->getSymbolList()->find(name.c_str()) : nullptr;
+        if(!symbol || !symbol->getSize()) {
+            std::cout << "Warning: can't watch unknown variable \""
+                << name << "\"\n";
+            continue;
+        }
+        watchpoint.addWatch(symbol->getAddress(), symbol->getSize());
+    }
+    if(watchRanges) {
+        watchpoint.setWatchMode(CondWatchpointPass::WATCH_RANGE_CHECKS);
+    }
+    RUN_PASS(watchpoint, program);
     //RUN_PASS(ProfileSavePass(), program);
 }
 
@@ -64,6 +82,7 @@ void TwocodeApp::doTwocode() {
     RUN_PASS(TwocodeGSPass(egalito->getConductor(), gsTable, ifuncList), module);
 
     TwocodeVarsPass varsPass(gsTable, extraModule);
+    varsPass.setOtherFunctions(merge.getOtherFunctions());
     module->accept(&varsPass);  // after UseGSTablePass
 
     RUN_PASS(TwocodeAllocPass(gsTable, varsPass.getGSSection()), program);
@@ -92,6 +111,10 @@ static void printUsage(const char *program) {
         "\n"
         "Modes:\n"
         "    --twocode          Insert two copies of code\n"
+        "    --watch var        Call egalito_cond_watchpoint_hit before writes\n"
+        "                       to a global variable (may be repeated)\n"
+        "    --watch-ranges     Check watched writes inline even if they fit\n"
+        "                       in the debug registers\n"
         "Note: the EGALITO_DEBUG variable is also honoured.\n";
 }
 
@@ -113,15 +136,21 @@ void TwocodeApp::run(int argc, char **argv) {
 
         {"--nop",           [&ops] () { }},
         {"--twocode",       [&ops] () { ops.push_back("twocode"); }},
+        {"--watch-ranges",  [this] () { watchRanges = true; }},
     };
 
     std::map<std::string, std::function<void ()>> techniques = {
         {"twocode", [this] () { doTwocode(); }},
+        {"watch", [this] () { doWatching(); }},
     };
 
     for(int a = 1; a < argc; a ++) {
         const char *arg = argv[a];
-        if(arg[0] == '-') {
+        if(std::strcmp(arg, "--watch") == 0 && a + 1 < argc) {
+            if(watchNames.empty()) ops.push_back("watch");
+            watchNames.push_back(argv[++ a]);
+        }
+        else if(arg[0] == '-') {
             bool found = false;
             for(auto action : actions) {
                 if(std::strcmp(arg, action.str) == 0) {
@@ -1,6 +1,8 @@
 #ifndef EGALITO_APP_TWOCODE_H
 #define EGALITO_APP_TWOCODE_H
 
+#include <string>
+#include <vector>
 #include "conductor/interface.h"
 
 class TwocodeApp {
@@ -8,8 +10,10 @@ private:
     bool quiet;
     EgalitoInterface *egalito;
     Module *extraModule;
+    std::vector<std::string> watchNames;
+    bool watchRanges;
 public:
-    TwocodeApp() : quiet(true), extraModule(nullptr) {}
+    TwocodeApp() : quiet(true), extraModule(nullptr), watchRanges(false) {}
     void run(int argc, char **argv);
     void parse(const std::string &filename, const std::string &extra, bool oneToOne);
     void generate(const std::string &filename, bool oneToOne);
@@ -7,6 +7,9 @@
 #include <wchar.h>
 #include <locale.h>
 #include <math.h>
+#include "../../src/util/cpusig.h"
+
+unsigned long long signature;   // read by determine.py
 
 void nop() {}
 void breakpoint() {}
@@ -132,6 +135,7 @@ int main(int argc, char **argv)
     if(expf(d) > 0.1) nop();
     if(log(d) > 0.1) nop();
     if(logf(d) > 0.1) nop();
+    signature = egalito_cpu_signature();
     breakpoint();
 
     return 0;
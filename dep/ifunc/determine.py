@@ -13,6 +13,8 @@ class DetermineIFuncTarget (gdb.Command):
         # ifuncs = ["cos", "memchr", "memcmp", "memcpy", "memmove", "mempcpy", "memset", "newlocale", "rawmemchr", "stpcpy", "strcasecmp", "strcasecmp_l", "strcat", "strchr", "strchrnul", "strcmp", "strcpy", "strcspn", "strlen", "strncasecmp", "strncmp", "strncpy", "strnlen", "strrchr", "strspn", "wcslen", "wcsnlen", "wmemset"]
         ifuncs = [ "atan", "atanf", "ceil", "ceilf", "cos", "cosf", "exp", "expf", "floor", "floorf", "log", "logf", "memchr", "memcmp", "memcpy","__memcpy_chk", "memmove", "mempcpy", "memrchr", "memset", "newlocale", "rawmemchr", "rint", "rintf", "sin", "sincos", "sincosf", "sinf", "stpcpy", "stpncpy", "strcasecmp", "strcasecmp_l", "strcat", "strchr", "strchrnul", "strcmp", "strcpy", "strcspn", "strlen", "strncasecmp", "strncmp", "strncpy", "strnlen", "strpbrk", "strrchr", "strspn", "strstr", "tan", "tanf", "trunc", "truncf", "wcslen", "wcsnlen", "wmemchr", "wmemcmp", "wmemset" ]
         with open('ifunc.h', 'w') as f:
+            signature = int(gdb.parse_and_eval('signature'))
+            f.write("KNOWN_IFUNC_SIGNATURE(0x%xull)\n" % signature)
             for ifunc in ifuncs:
                 target = self.determine("'%s@plt'" % ifunc)
                 f.write("KNOWN_IFUNC_ENTRY(%s, %s)\n" % (ifunc, target))
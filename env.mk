@@ -93,6 +93,21 @@ ifdef PROFILE  # set PROFILE=1 to enable gprof profiling
 	CLDFLAGS += -no-pie -pg
 endif
 
+ifdef COUNTERS  # set COUNTERS=1 to compile in analysis counters (EGALITO_COUNTERS)
+	CFLAGS += -D EGALITO_COUNTERS
+	CXXFLAGS += -D EGALITO_COUNTERS
+endif
+
+ifdef ALLOC_TRACKING  # set ALLOC_TRACKING=1 to count allocations by pass
+	CFLAGS += -D EGALITO_ALLOC_TRACKING
+	CXXFLAGS += -D EGALITO_ALLOC_TRACKING
+endif
+
+ifdef LOG_CEILING  # set LOG_CEILING=n to compile out log messages above level n
+	CFLAGS += -D LOG_CEILING=$(LOG_CEILING)
+	CXXFLAGS += -D LOG_CEILING=$(LOG_CEILING)
+endif
+
 ifdef STACK_PROTECTOR  # set STACK_PROTECTOR=1 to enable -fstack-protector flag
 	CFLAGS += -fstack-protector-all -D EGALITO_STACK_PROTECTOR
 	CXXFLAGS += -fstack-protector-all -D EGALITO_STACK_PROTECTOR
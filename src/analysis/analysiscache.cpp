@@ -0,0 +1,100 @@
+#include <cstdlib>  // for getenv, strtoul
+#include "analysiscache.h"
+#include "walker.h"
+#include "budget.h"
+#include "chunk/function.h"
+#include "log/log.h"
+
+AnalysisCache AnalysisCache::instance;
+
+FunctionAnalysis::FunctionAnalysis(Function *function)
+    : function(function), modification(function->getModificationCount()),
+    truncated(false),
+    address(function->getAddress()), size(function->getSize()),
+    cfg(function) {}
+
+UDRegMemWorkingSet *FunctionAnalysis::getWorkingSet() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(!usedef) {
+        config.reset(new UDConfiguration(&cfg));
+        working.reset(new UDRegMemWorkingSet(function, &cfg));
+        usedef.reset(new UseDef(config.get(), working.get()));
+
+        SccOrder order(&cfg);
+        order.genFull(0);
+        usedef->analyze(order.get());
+        truncated = AnalysisBudget::isExceeded();
+    }
+    return working.get();
+}
+
+Dominance *FunctionAnalysis::getDominance() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(!dominance) dominance.reset(new Dominance(&cfg));
+    return dominance.get();
+}
+
+const FrameType *FunctionAnalysis::getFrameType() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(!frameType) frameType.reset(new FrameType(function));
+    return frameType.get();
+}
+
+bool FunctionAnalysis::isCurrent() const {
+    return !truncated
+        && function->getModificationCount() == modification
+        && function->getAddress() == address && function->getSize() == size;
+}
+
+AnalysisCache::AnalysisCache() : capacity(256) {
+    const char *variable = getenv("EGALITO_ANALYSIS_CACHE");
+    if(variable && *variable) {
+        capacity = std::strtoul(variable, nullptr, 0);
+    }
+}
+
+AnalysisCache::EntryType AnalysisCache::get(Function *function) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = cache.find(function);
+        if(it != cache.end()) {
+            auto &entry = it->second;
+            if(entry.first->isCurrent()) {
+                useList.splice(useList.begin(), useList, entry.second);
+                return entry.first;
+            }
+            useList.erase(entry.second);
+            cache.erase(it);
+        }
+    }
+
+    // analyze without holding the lock, so other functions can proceed
+    EntryType analysis(new FunctionAnalysis(function));
+    LOG(10, "computed analysis for " << function->getName());
+    if(capacity == 0) return analysis;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if(cache.count(function)) return analysis;  // another thread was faster
+    useList.push_front(function);
+    cache[function] = std::make_pair(analysis, useList.begin());
+    while(cache.size() > capacity) {
+        cache.erase(useList.back());
+        useList.pop_back();
+    }
+    return analysis;
+}
+
+void AnalysisCache::invalidate(Function *function) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = cache.find(function);
+    if(it != cache.end()) {
+        useList.erase(it->second.second);
+        cache.erase(it);
+    }
+}
+
+void AnalysisCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    cache.clear();
+    useList.clear();
+}
@@ -0,0 +1,86 @@
+#ifndef EGALITO_ANALYSIS_ANALYSIS_CACHE_H
+#define EGALITO_ANALYSIS_ANALYSIS_CACHE_H
+
+#include <map>
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include "controlflow.h"
+#include "dominance.h"
+#include "usedef.h"
+#include "frametype.h"
+
+class Function;
+
+/** The ControlFlowGraph of one Function, plus its full use-def analysis,
+    Dominance and FrameType, which are computed on first request. These
+    results are shared, so users must not modify them (e.g. with
+    cancelUseDefReg()).
+*/
+class FunctionAnalysis {
+private:
+    Function *function;
+    unsigned long modification;
+    std::atomic<bool> truncated;
+    address_t address;
+    size_t size;
+    ControlFlowGraph cfg;
+    std::mutex mutex;  // for computing the parts below
+    std::unique_ptr<UDConfiguration> config;
+    std::unique_ptr<UDRegMemWorkingSet> working;
+    std::unique_ptr<UseDef> usedef;
+    std::unique_ptr<Dominance> dominance;
+    std::unique_ptr<FrameType> frameType;
+public:
+    FunctionAnalysis(Function *function);
+
+    Function *getFunction() const { return function; }
+    ControlFlowGraph *getCFG() { return &cfg; }
+    UDRegMemWorkingSet *getWorkingSet();
+    Dominance *getDominance();
+    /** Passes that edit the frame (e.g. with fixEpilogue()) should work
+        on their own copy. */
+    const FrameType *getFrameType();
+
+    /** False once the function changed or moved since the analysis was
+        done. Use-def trees hold absolute addresses of RIP-relative
+        operands, so moving a function invalidates its analysis too.
+        Also false if use-def ran out of its AnalysisBudget, so that
+        partial results are only seen by the pass that was limited. */
+    bool isCurrent() const;
+};
+
+/** Hands out FunctionAnalysis results, so that passes looking at the same
+    Function in turn (jump table detection, syscall search, non-returning
+    call detection, ...) compute them only once.
+
+    An entry is recomputed after the Function's modification count or
+    address changes. ChunkMutator bumps it on every structural change; code that
+    edits semantics in place must call Function::markModified() itself.
+    The most recently used EGALITO_ANALYSIS_CACHE entries (default 256) are
+    kept, and 0 disables caching. Entries are reference counted, so one
+    stays valid for as long as its user holds on to it.
+*/
+class AnalysisCache {
+private:
+    typedef std::shared_ptr<FunctionAnalysis> EntryType;
+    typedef std::list<Function *> UseListType;
+
+    static AnalysisCache instance;
+public:
+    static AnalysisCache *getInstance() { return &instance; }
+private:
+    std::mutex mutex;
+    size_t capacity;
+    UseListType useList;  // most recently used first
+    std::map<Function *, std::pair<EntryType, UseListType::iterator>> cache;
+public:
+    AnalysisCache();
+
+    EntryType get(Function *function);
+    void invalidate(Function *function);
+    void clear();
+};
+
+#endif
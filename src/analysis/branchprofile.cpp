@@ -0,0 +1,47 @@
+#include <fstream>
+#include <sstream>
+#include <cstdlib>  // for strtoull
+#include "branchprofile.h"
+#include "log/log.h"
+
+bool BranchProfile::read(const std::string &filename) {
+    std::ifstream file(filename.c_str());
+    if(!file) {
+        LOG(0, "Cannot open profile [" << filename << "]");
+        return false;
+    }
+
+    std::string line;
+    while(std::getline(file, line)) {
+        std::istringstream stream(line);
+        if(line.find('[') != std::string::npos) {
+            uint64_t count = 0;
+            std::string name;
+            if(stream >> count >> name && name.length() > 2
+                && name.front() == '[' && name.back() == ']') {
+
+                name = name.substr(1, name.length() - 2);
+                functionCountList.push_back(FunctionCount(name, count));
+            }
+        }
+        else if(line.find('/') != std::string::npos) {
+            std::string token;
+            while(stream >> token) {
+                char *end = nullptr;
+                address_t from = std::strtoull(token.c_str(), &end, 16);
+                if(!end || *end != '/') continue;
+                address_t to = std::strtoull(end + 1, nullptr, 16);
+                branchList.push_back(Branch{from, to, 1});
+            }
+        }
+        else {
+            address_t from = 0, to = 0;
+            uint64_t count = 1;
+            if(stream >> std::hex >> from >> to) {
+                stream >> std::dec >> count;
+                branchList.push_back(Branch{from, to, count});
+            }
+        }
+    }
+    return true;
+}
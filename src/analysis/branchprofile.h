@@ -0,0 +1,36 @@
+#ifndef EGALITO_ANALYSIS_BRANCH_PROFILE_H
+#define EGALITO_ANALYSIS_BRANCH_PROFILE_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include "types.h"
+
+/** Samples from a profile file. Each line is in one of these formats:
+        count [function]        (function counts, as used by etorder)
+        from to [count]         (aggregated branch records, hex)
+        0xfrom/0xto/...         (perf script -F brstack entries)
+    Branch addresses refer to the original, untransformed code.
+*/
+class BranchProfile {
+public:
+    struct Branch {
+        address_t from;
+        address_t to;
+        uint64_t count;
+    };
+    typedef std::pair<std::string, uint64_t> FunctionCount;
+private:
+    std::vector<Branch> branchList;
+    std::vector<FunctionCount> functionCountList;
+public:
+    /** Returns false if the file could not be read. */
+    bool read(const std::string &filename);
+
+    const std::vector<Branch> &getBranchList() const { return branchList; }
+    const std::vector<FunctionCount> &getFunctionCountList() const
+        { return functionCountList; }
+};
+
+#endif
@@ -0,0 +1,80 @@
+#include <cstdlib>  // for getenv, strtoul
+#include "budget.h"
+#include "chunk/function.h"
+#include "log/log.h"
+
+static thread_local AnalysisBudget *currentBudget = nullptr;
+
+std::mutex AnalysisBudget::exceededMutex;
+std::vector<std::string> AnalysisBudget::exceededList;
+
+AnalysisBudget::Limits::Limits() : steps(0), milliseconds(0) {
+    if(const char *value = getenv("EGALITO_ANALYSIS_STEPS")) {
+        steps = std::strtoul(value, nullptr, 0);
+    }
+    if(const char *value = getenv("EGALITO_ANALYSIS_MS")) {
+        milliseconds = std::strtoul(value, nullptr, 0);
+    }
+}
+
+const AnalysisBudget::Limits &AnalysisBudget::getLimits() {
+    static Limits limits;
+    return limits;
+}
+
+AnalysisBudget::AnalysisBudget(Function *function)
+    : function(nullptr), steps(0), exceeded(false) {
+
+    const auto &limits = getLimits();
+    if(currentBudget || (!limits.steps && !limits.milliseconds)) return;
+
+    this->function = function;
+    start = std::chrono::steady_clock::now();
+    currentBudget = this;
+}
+
+AnalysisBudget::~AnalysisBudget() {
+    if(currentBudget != this) return;
+    currentBudget = nullptr;
+
+    if(exceeded) {
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        LOG(1, "analysis budget exceeded in [" << function->getName()
+            << "] after " << std::dec << steps << " steps, " << ms
+            << " ms; using conservative results");
+
+        std::lock_guard<std::mutex> lock(exceededMutex);
+        exceededList.push_back(function->getName());
+    }
+}
+
+bool AnalysisBudget::spend(unsigned long steps) {
+    auto budget = currentBudget;
+    if(!budget) return true;
+    if(budget->exceeded) return false;
+
+    const auto &limits = getLimits();
+    auto before = budget->steps;
+    budget->steps += steps;
+    if(limits.steps && budget->steps > limits.steps) {
+        budget->exceeded = true;
+    }
+    // reading the clock is comparatively slow, so only do it now and then
+    else if(limits.milliseconds && (before >> 8) != (budget->steps >> 8)) {
+        auto elapsed = std::chrono::steady_clock::now() - budget->start;
+        if(elapsed > std::chrono::milliseconds(limits.milliseconds)) {
+            budget->exceeded = true;
+        }
+    }
+    return !budget->exceeded;
+}
+
+bool AnalysisBudget::isExceeded() {
+    return currentBudget && currentBudget->exceeded;
+}
+
+std::vector<std::string> AnalysisBudget::getExceededList() {
+    std::lock_guard<std::mutex> lock(exceededMutex);
+    return exceededList;
+}
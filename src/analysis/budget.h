@@ -0,0 +1,54 @@
+#ifndef EGALITO_ANALYSIS_BUDGET_H
+#define EGALITO_ANALYSIS_BUDGET_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+
+class Function;
+
+/** Limits how much work the expensive analyses (use-def, jump table
+    search) may do for one Function, so that a huge generated switch or
+    obfuscated code can't stall the whole pipeline.
+
+    The budget is EGALITO_ANALYSIS_STEPS steps (UDStates visited, jump
+    table candidates and bounds tried) and EGALITO_ANALYSIS_MS of wall
+    time per function; unset or 0 means unlimited. An AnalysisBudget
+    covers the analysis of one Function by the current thread; nested
+    budgets share the outermost one. Once it runs out, spend() returns
+    false and analyses stop early with partial results: use-def leaves
+    the remaining states unfilled (and the analysis is not cached), and
+    jump tables whose bound wasn't found yet are left with unknown entries
+    for JumpTableOverestimate.
+*/
+class AnalysisBudget {
+private:
+    struct Limits {
+        unsigned long steps;
+        unsigned long milliseconds;
+        Limits();
+    };
+    static const Limits &getLimits();
+
+    static std::mutex exceededMutex;
+    static std::vector<std::string> exceededList;
+
+    Function *function;
+    unsigned long steps;
+    bool exceeded;
+    std::chrono::steady_clock::time_point start;
+public:
+    AnalysisBudget(Function *function);
+    ~AnalysisBudget();
+
+    /** Charges steps to the current budget; false once it is exceeded.
+        Always true outside of an AnalysisBudget. */
+    static bool spend(unsigned long steps = 1);
+    static bool isExceeded();
+
+    /** Names of the functions that ran out of budget so far. */
+    static std::vector<std::string> getExceededList();
+};
+
+#endif
@@ -3,7 +3,9 @@
 #include "analysis/reguse.h"
 #include "chunk/concrete.h"
 #include "chunk/link.h"
+#include "chunk/plt.h"
 #include "instr/semantic.h"
+#include "util/threadpool.h"
 #ifdef ARCH_X86_64
 #include "instr/linked-x86_64.h"
 #endif
@@ -26,18 +28,26 @@ void CallGraphNode::addUpLink(int targetId) {
 }
 
 CallGraph::CallGraph(Program *program) {
-    int count = 0;
+    std::vector<Function *> functionList;
     for(auto module : CIter::children(program)) {
         for(auto function : CIter::functions(module)) {
-            mapping[function] = count;
-            nodeList.push_back(CallGraphNode(count, function));
-            count++;
+            int id = static_cast<int>(functionList.size());
+            mapping[function] = id;
+            nodeList.push_back(CallGraphNode(id, function));
+            functionList.push_back(function);
         }
     }
 
-    for(auto module : CIter::children(program)) {
-        for(auto function : CIter::functions(module)) {
-            makeDirectEdges(function);
+    // only reads the program and mapping, so functions are independent
+    std::vector<std::vector<int>> calleeList(functionList.size());
+    ThreadPool pool;
+    pool.parallelFor(functionList.size(), [&] (size_t i) {
+        calleeList[i] = findCallees(functionList[i]);
+    });
+
+    for(size_t i = 0; i < calleeList.size(); i ++) {
+        for(auto callee : calleeList[i]) {
+            makeLinks(static_cast<int>(i), callee);
         }
     }
 }
@@ -55,7 +65,8 @@ CallGraph::~CallGraph() {
     }
 }
 
-void CallGraph::makeDirectEdges(Function *function) {
+std::vector<int> CallGraph::findCallees(Function *function) {
+    std::vector<int> callees;
     for(auto block : CIter::children(function)) {
         for(auto instr : CIter::children(block)) {
             auto semantic = instr->getSemantic();
@@ -63,25 +74,114 @@ void CallGraph::makeDirectEdges(Function *function) {
             auto link = semantic->getLink();
             if(!link) continue;
 
-            if(auto target = dynamic_cast<Function *>(&*link->getTarget())) {
-                makeLinks(function, target);
-                continue;
+            if(auto target = getCallee(link)) {
+                auto it = mapping.find(target);
+                if(it != mapping.end()) callees.push_back(it->second);
             }
-            if(auto pltLink = dynamic_cast<PLTLink *>(link)) {
-                if(auto target = pltLink->getPLTTrampoline()->getTarget()) {
-                    makeLinks(function, static_cast<Function *>(target));
+        }
+    }
+    return callees;
+}
+
+Function *CallGraph::getCallee(Link *link) {
+    // a PLTLink or NormalLink to a trampoline, or an ExternalSymbolLink,
+    // reaches another module only after its symbol has been resolved
+    auto target = &*link->getTarget();
+    if(auto trampoline = dynamic_cast<PLTTrampoline *>(target)) {
+        target = trampoline->getTarget();
+    }
+    return dynamic_cast<Function *>(target);
+}
+
+void CallGraph::makeLinks(int caller, int callee) {
+    LOG(10, "    " << getFunction(caller)->getName()
+        << " -> " << getFunction(callee)->getName());
+    nodeList[caller].addDownLink(callee);
+    nodeList[callee].addUpLink(caller);
+}
+
+const std::vector<CallGraph::SCC> &CallGraph::getSCCList() {
+    if(sccList.empty() && !nodeList.empty()) makeSCCs();
+    return sccList;
+}
+
+const std::vector<std::vector<size_t>> &CallGraph::getSCCLevels() {
+    if(sccList.empty() && !nodeList.empty()) makeSCCs();
+    return sccLevelList;
+}
+
+void CallGraph::makeSCCs() {
+    const size_t count = nodeList.size();
+    std::vector<std::vector<int>> callees(count);
+    for(size_t id = 0; id < count; id ++) {
+        for(auto link : nodeList[id].downwardLinks()) {
+            callees[id].push_back(link->getTargetID());
+        }
+    }
+
+    // Tarjan's algorithm, iterative since call chains can be very deep;
+    // it completes an SCC only after all SCCs reachable from it
+    std::vector<int> index(count, -1), lowlink(count), sccOf(count, -1);
+    std::vector<int> stack;
+    std::vector<std::pair<int, size_t>> dfs;
+    int clock = 0;
+    for(size_t root = 0; root < count; root ++) {
+        if(index[root] >= 0) continue;
+        dfs.emplace_back(static_cast<int>(root), 0);
+        index[root] = lowlink[root] = clock ++;
+        stack.push_back(static_cast<int>(root));
+
+        while(!dfs.empty()) {
+            auto id = dfs.back().first;
+            auto &next = dfs.back().second;
+            if(next < callees[id].size()) {
+                auto callee = callees[id][next ++];
+                if(index[callee] < 0) {
+                    index[callee] = lowlink[callee] = clock ++;
+                    stack.push_back(callee);
+                    dfs.emplace_back(callee, 0);
+                }
+                else if(sccOf[callee] < 0) {
+                    lowlink[id] = std::min(lowlink[id], index[callee]);
                 }
+                continue;
+            }
+
+            dfs.pop_back();
+            if(!dfs.empty()) {
+                auto parent = dfs.back().first;
+                lowlink[parent] = std::min(lowlink[parent], lowlink[id]);
+            }
+            if(lowlink[id] == index[id]) {
+                SCC scc;
+                int member;
+                do {
+                    member = stack.back();
+                    stack.pop_back();
+                    sccOf[member] = static_cast<int>(sccList.size());
+                    scc.push_back(getFunction(member));
+                } while(member != id);
+                std::reverse(scc.begin(), scc.end());
+                sccList.push_back(std::move(scc));
             }
         }
     }
-}
 
-void CallGraph::makeLinks(Function *caller, Function *callee) {
-    LOG(10, "    " << caller->getName() << " -> " << callee->getName());
-    auto node = getNode(caller);
-    auto targetNode = getNode(callee);
-    node->addDownLink(targetNode->getID());
-    targetNode->addUpLink(node->getID());
+    // callee SCCs always come earlier, so one forward sweep finds heights
+    std::vector<size_t> level(sccList.size(), 0);
+    for(size_t i = 0; i < sccList.size(); i ++) {
+        for(auto function : sccList[i]) {
+            for(auto callee : callees[mapping[function]]) {
+                size_t other = static_cast<size_t>(sccOf[callee]);
+                if(other != i) level[i] = std::max(level[i], level[other] + 1);
+            }
+        }
+        if(level[i] >= sccLevelList.size()) sccLevelList.resize(level[i] + 1);
+        sccLevelList[level[i]].push_back(i);
+    }
+
+    LOG(10, "call graph: " << std::dec << count << " functions in "
+        << sccList.size() << " SCCs, " << sccLevelList.size() << " levels");
 }
 
 
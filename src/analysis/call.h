@@ -11,6 +11,7 @@
 class Module;
 class Program;
 class Function;
+class Link;
 
 class CallGraphLink : public GraphLinkBase {
 private:
@@ -48,10 +49,24 @@ public:
         { return (direction > 0) ? downwardLinks() : upwardLinks(); }
 };
 
+/** Whole-program call graph over every module of a Program.
+
+    Direct call and tail-call edges are found one function at a time on the
+    default ThreadPool, then linked in function order, so the graph is the
+    same as a serial build. Calls through a PLTTrampoline or ExternalSymbol
+    cross into the module that defines the target once it is resolved.
+
+    The strongly connected components are computed on first use and listed
+    bottom-up, so interprocedural passes can see callees before callers.
+*/
 class CallGraph : public GraphBase {
+public:
+    typedef std::vector<Function *> SCC;
 private:
     std::vector<CallGraphNode> nodeList;
     std::map<Function *, int> mapping;
+    std::vector<SCC> sccList;
+    std::vector<std::vector<size_t>> sccLevelList;
 public:
     CallGraph(Program *program);
     virtual ~CallGraph();
@@ -61,9 +76,21 @@ public:
     int getIDFor(Function *function) { return mapping[function]; }
     virtual CallGraphNode *get(int id) { return &nodeList[id]; }
     virtual size_t getCount() const { return nodeList.size(); }
+
+    /** SCCs in bottom-up order: each one comes after every SCC it calls.
+        The functions of an SCC (mutual recursion) call each other.
+    */
+    const std::vector<SCC> &getSCCList();
+    /** Indices into getSCCList(), grouped by height in the condensed
+        graph. An SCC only calls SCCs of earlier levels or itself, so the
+        SCCs within one level can be processed in parallel.
+    */
+    const std::vector<std::vector<size_t>> &getSCCLevels();
 private:
-    void makeDirectEdges(Function *function);
-    void makeLinks(Function *caller, Function *callee);
+    std::vector<int> findCallees(Function *function);
+    Function *getCallee(Link *link);
+    void makeLinks(int caller, int callee);
+    void makeSCCs();
 };
 
 class IndirectCalleeList {
@@ -12,14 +12,6 @@
 #include "log/log.h"
 #include "chunk/dump.h"
 
-void ControlFlowNode::addLink(const ControlFlowLink &link) {
-    links.emplace_back(new ControlFlowLink(link));
-}
-
-void ControlFlowNode::addReverseLink(const ControlFlowLink &rlink) {
-    reverseLinks.emplace_back(new ControlFlowLink(rlink));
-}
-
 std::string ControlFlowNode::getDescription() {
     std::ostringstream stream;
     stream << "node " << getID()
@@ -32,36 +24,80 @@ ControlFlowGraph::ControlFlowGraph(Function *function) {
     construct(function);
 }
 
-ControlFlowGraph::~ControlFlowGraph() {
-    // link should not be deleted everytime node is deleted because node
-    // can be copied
-    for(auto& node : graph) {
-        for(auto link : node.forwardLinks()) {
-            delete &*link;
-        }
-        for(auto link : node.backwardLinks()) {
-            delete &*link;
-        }
-    }
-}
-
 void ControlFlowGraph::construct(Function *function) {
     ControlFlowNode::id_t count = 0;
-    for(auto b : function->getChildren()->getIterable()->iterable()) {
+    auto blockList = function->getChildren()->getIterable();
+    graph.reserve(blockList->getCount());
+    blockMapping.reserve(blockList->getCount());
+    for(auto b : blockList->iterable()) {
         blockMapping[b] = count;
         graph.push_back(ControlFlowNode(count, b));
         count ++;
     }
 
-    for(auto b : function->getChildren()->getIterable()->iterable()) {
-        construct(b);
+    std::vector<Edge> edgeList;
+    for(auto b : blockList->iterable()) {
+        construct(b, edgeList);
+    }
+    layout(edgeList);
+}
+
+void ControlFlowGraph::layout(const std::vector<Edge> &edgeList) {
+    // stable counting sorts keep the links of each node in the order they
+    // were found
+    const size_t count = graph.size();
+    std::vector<size_t> forwardStart(count + 1), backwardStart(count + 1);
+    for(const auto &edge : edgeList) {
+        forwardStart[edge.source + 1] ++;
+        backwardStart[edge.target + 1] ++;
+    }
+    for(size_t i = 0; i < count; i ++) {
+        forwardStart[i + 1] += forwardStart[i];
+        backwardStart[i + 1] += backwardStart[i];
+    }
+
+    std::vector<const Edge *> forwardOrder(edgeList.size());
+    std::vector<const Edge *> backwardOrder(edgeList.size());
+    {
+        auto forwardNext = forwardStart;
+        auto backwardNext = backwardStart;
+        for(const auto &edge : edgeList) {
+            forwardOrder[forwardNext[edge.source] ++] = &edge;
+            backwardOrder[backwardNext[edge.target] ++] = &edge;
+        }
+    }
+
+    // linkList is never resized after this, so nodes can point into it
+    linkList.reserve(2 * edgeList.size());
+    successorList.reserve(edgeList.size());
+    predecessorList.reserve(edgeList.size());
+    for(auto edge : forwardOrder) {
+        linkList.emplace_back(edge->target, edge->targetOffset,
+            edge->followJump);
+        graph[edge->source].addLink(&linkList.back());
+        successorList.push_back(edge->target);
+    }
+    for(auto edge : backwardOrder) {
+        linkList.emplace_back(edge->source, edge->sourceOffset,
+            edge->followJump);
+        graph[edge->target].addReverseLink(&linkList.back());
+        predecessorList.push_back(edge->source);
+    }
+
+    for(size_t i = 0; i < count; i ++) {
+        graph[i].setAdjacency(
+            ControlFlowIDList(successorList.data() + forwardStart[i],
+                successorList.data() + forwardStart[i + 1]),
+            ControlFlowIDList(predecessorList.data() + backwardStart[i],
+                predecessorList.data() + backwardStart[i + 1]));
     }
 }
 
-void ControlFlowGraph::construct(Block *block) {
+void ControlFlowGraph::construct(Block *block, std::vector<Edge> &edgeList) {
     assert(blockMapping.count(block));
     auto id = blockMapping[block];
     auto i = block->getChildren()->getIterable()->getLast();
+    int branchOffset = i->getAddress() - block->getAddress();
     auto link = i->getSemantic()->getLink();
     bool fallThrough = false;
     if(auto cfi = dynamic_cast<ControlFlowInstruction *>(i->getSemantic())) {
@@ -107,10 +143,7 @@ void ControlFlowGraph::construct(Block *block) {
             if(auto v = dynamic_cast<Block *>(&*target)) {
                 assert(blockMapping.count(v));
                 auto other = blockMapping[v];
-                graph[id].addLink(ControlFlowLink(other));
-                graph[other].addReverseLink(
-                    ControlFlowLink(id,
-                        i->getAddress() - i->getParent()->getAddress()));
+                edgeList.push_back(Edge{id, other, 0, branchOffset, true});
 #ifdef ARCH_AARCH64
                 throw "this case breaks splitbasicblock pass";
 #endif
@@ -123,11 +156,9 @@ void ControlFlowGraph::construct(Block *block) {
                 // but it might be
                 if(blockMapping.count(parent) > 0) {
                     auto parentID = blockMapping[parent];
-                    auto offset = link->getTargetAddress() - parent->getAddress();
-                    graph[id].addLink(ControlFlowLink(parentID, offset));
-                    graph[parentID].addReverseLink(
-                        ControlFlowLink(id,
-                            i->getAddress() - i->getParent()->getAddress()));
+                    int offset = link->getTargetAddress() - parent->getAddress();
+                    edgeList.push_back(
+                        Edge{id, parentID, offset, branchOffset, true});
                 }
             }
         }
@@ -169,12 +200,10 @@ void ControlFlowGraph::construct(Block *block) {
                             }
                             assert(blockMapping.count(parent));
                             auto parentID = blockMapping[parent];
-                            auto offset = link->getTargetAddress()
+                            int offset = link->getTargetAddress()
                                 - parent->getAddress();
-                            graph[id].addLink(ControlFlowLink(parentID, offset));
-                            graph[parentID].addReverseLink(
-                                ControlFlowLink(id, i->getAddress()
-                                    - i->getParent()->getAddress()));
+                            edgeList.push_back(Edge{id, parentID, offset,
+                                branchOffset, true});
                         }
                     }
                 }
@@ -193,17 +222,9 @@ void ControlFlowGraph::construct(Block *block) {
     }
 
     if(fallThrough) {
-        auto list = dynamic_cast<Function *>(block->getParent())
-            ->getChildren()->getIterable();
-        auto index = list->indexOf(block);
-        if(index + 1 < list->getCount()) {
-            assert(blockMapping.count(list->get(index + 1)));
-            auto other = blockMapping[list->get(index + 1)];
-            graph[id].addLink(ControlFlowLink(other, 0, false));
-            graph[other].addReverseLink(
-                ControlFlowLink(id,
-                    i->getAddress() - i->getParent()->getAddress(),
-                    false));
+        // IDs follow the order of the blocks
+        if(static_cast<size_t>(id + 1) < graph.size()) {
+            edgeList.push_back(Edge{id, id + 1, 0, branchOffset, false});
         }
     }
 }
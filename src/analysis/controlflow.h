@@ -3,6 +3,8 @@
 
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <cstdint>
 #include "analysis/graph.h"
 #include "util/iter.h"
 
@@ -30,6 +32,23 @@ public:
     bool getFollowJump() const { return followJump; }
 };
 
+/** Neighbour IDs of one node: a slice of the graph's adjacency array. */
+class ControlFlowIDList {
+private:
+    const uint32_t *first;
+    const uint32_t *last;
+public:
+    ControlFlowIDList() : first(nullptr), last(nullptr) {}
+    ControlFlowIDList(const uint32_t *first, const uint32_t *last)
+        : first(first), last(last) {}
+
+    const uint32_t *begin() const { return first; }
+    const uint32_t *end() const { return last; }
+    size_t size() const { return last - first; }
+    bool empty() const { return first == last; }
+    uint32_t operator [] (size_t index) const { return first[index]; }
+};
+
 class ControlFlowNode : public GraphNodeBase {
 public:
     using id_t = ControlFlow::id_t;
@@ -40,6 +59,8 @@ private:
     using GraphNodeBase::ListType;
     ListType links;
     ListType reverseLinks;
+    ControlFlowIDList successors;
+    ControlFlowIDList predecessors;
 public:
     ControlFlowNode(id_t id, Block *block) : id(id), block(block) {}
     ~ControlFlowNode() {}
@@ -47,8 +68,18 @@ public:
     virtual id_t getID() const { return id; }
     Block *getBlock() const { return block; }
 
-    void addLink(const ControlFlowLink &link);
-    void addReverseLink(const ControlFlowLink &rlink);
+    /** Links are owned by the ControlFlowGraph. */
+    void addLink(ControlFlowLink *link) { links.emplace_back(link); }
+    void addReverseLink(ControlFlowLink *rlink)
+        { reverseLinks.emplace_back(rlink); }
+    void setAdjacency(ControlFlowIDList successors,
+        ControlFlowIDList predecessors)
+        { this->successors = successors; this->predecessors = predecessors; }
+
+    /** Same order as forwardLinks() and backwardLinks(), but only the IDs,
+        for traversals that don't need link offsets. */
+    ControlFlowIDList successorIDs() const { return successors; }
+    ControlFlowIDList predecessorIDs() const { return predecessors; }
 
     ConcreteIterable<ListType> forwardLinks()
         { return ConcreteIterable<ListType>(links); }
@@ -61,26 +92,56 @@ public:
     std::string getDescription();
 };
 
+/** Intra-function control flow between the Blocks of a Function.
+
+    Edges are collected first and then laid out once, in CSR form: every
+    link lives in one array grouped by source (forward) or target
+    (backward), with a parallel array of uint32 node IDs, so building a
+    graph makes no per-edge allocations and walking it stays in a few
+    contiguous arrays. FunctionAnalysis keeps graphs for reuse by later
+    analyses of an unmodified Function.
+*/
 class ControlFlowGraph : public GraphBase {
 public:
     using id_t = ControlFlow::id_t;
 private:
+    struct Edge {
+        id_t source;
+        id_t target;
+        int targetOffset;   // where in the target block control arrives
+        int sourceOffset;   // offset of the branch in the source block
+        bool followJump;
+    };
+
     std::vector<ControlFlowNode> graph;
-    std::map<Block *, id_t> blockMapping;
+    std::unordered_map<Block *, id_t> blockMapping;
+    std::vector<ControlFlowLink> linkList;  // forward links, then backward
+    std::vector<uint32_t> successorList;
+    std::vector<uint32_t> predecessorList;
 public:
     ControlFlowGraph(Function *function);
-    virtual ~ControlFlowGraph();
+    virtual ~ControlFlowGraph() {}
 
     virtual ControlFlowNode *get(id_t id) { return &graph[id]; }
     virtual size_t getCount() const { return graph.size(); }
 
     id_t getIDFor(Block *block) { return blockMapping[block]; }
 
+    ControlFlowIDList getSuccessors(id_t id) const
+        { return graph[id].successorIDs(); }
+    ControlFlowIDList getPredecessors(id_t id) const
+        { return graph[id].predecessorIDs(); }
+
     void dump();
     void dumpDot();
 private:
+    // nodes point into linkList and the ID arrays
+    ControlFlowGraph(const ControlFlowGraph &);
+    ControlFlowGraph &operator = (const ControlFlowGraph &);
+
     void construct(Function *function);
-    void construct(Block *block);
+    void construct(Block *block, std::vector<Edge> &edgeList);
+    void layout(const std::vector<Edge> &edgeList);
 };
 
 #endif
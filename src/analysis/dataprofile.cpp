@@ -0,0 +1,61 @@
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstdlib>  // for strtoull
+#include "dataprofile.h"
+#include "log/log.h"
+
+bool DataProfile::read(const std::string &filename) {
+    std::ifstream file(filename.c_str());
+    if(!file) {
+        LOG(0, "Cannot open data profile [" << filename << "]");
+        return false;
+    }
+
+    std::string line;
+    while(std::getline(file, line)) {
+        std::istringstream stream(line);
+        std::string token;
+        if(!(stream >> token)) continue;
+
+        Access access{0, 1, false};
+        if(token.back() == ':') {
+            access.store = (token.find("store") != std::string::npos);
+            if(!(stream >> token)) continue;
+        }
+        else {
+            std::string word;
+            while(stream >> word) {
+                if(word == "store") access.store = true;
+                else if(word != "load") {
+                    access.count = std::strtoull(word.c_str(), nullptr, 10);
+                }
+            }
+        }
+
+        char *end = nullptr;
+        access.address = std::strtoull(token.c_str(), &end, 16);
+        if(!end || *end) continue;
+        accessList.push_back(access);
+    }
+
+    std::stable_sort(accessList.begin(), accessList.end(),
+        [] (const Access &a, const Access &b)
+            { return a.address < b.address; });
+    LOG(1, "read " << std::dec << accessList.size()
+        << " data access samples from [" << filename << "]");
+    return true;
+}
+
+void DataProfile::count(address_t start, address_t end, uint64_t &loads,
+    uint64_t &stores) const {
+
+    loads = stores = 0;
+    auto it = std::lower_bound(accessList.begin(), accessList.end(), start,
+        [] (const Access &access, address_t address)
+            { return access.address < address; });
+    for( ; it != accessList.end() && (*it).address < end; ++ it) {
+        if((*it).store) stores += (*it).count;
+        else loads += (*it).count;
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef EGALITO_ANALYSIS_DATA_PROFILE_H
+#define EGALITO_ANALYSIS_DATA_PROFILE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "types.h"
+
+/** Sampled data accesses, e.g. from perf mem or PEBS. Each line is in one
+    of these formats:
+        address [count] [load|store]    (hex address, decimal count)
+        event: address                  (perf script -F event,addr)
+    A perf event whose name contains "store" counts as a store. Addresses
+    refer to the module's link-time layout, so samples of a PIE or shared
+    library need its load base subtracted first.
+*/
+class DataProfile {
+public:
+    struct Access {
+        address_t address;
+        uint64_t count;
+        bool store;
+    };
+private:
+    std::vector<Access> accessList;  // sorted by address
+public:
+    /** Returns false if the file could not be read. */
+    bool read(const std::string &filename);
+
+    const std::vector<Access> &getAccessList() const { return accessList; }
+
+    /** Adds up the loads and stores that fall into [start, end). */
+    void count(address_t start, address_t end, uint64_t &loads,
+        uint64_t &stores) const;
+};
+
+#endif
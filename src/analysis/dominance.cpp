@@ -1,160 +1,189 @@
-#include <iomanip>
+#include <utility>
 #include "dominance.h"
-#include "walker.h"
 
 #include "log/log.h"
 
-Dominance::Dominance(ControlFlowGraph *cfg)
-    : cfg(cfg), idoms(cfg->getCount(), -1), idMap(cfg->getCount(), -1) {
-
-    SccOrder scc(cfg);
-    scc.gen(0);
-    LOG(10, "SCC");
-    for(auto sub : scc.get()) {
-        for(auto n : sub) {
-            LOG0(10, " " << std::setw(3) << n);
+Dominance::Dominance(GraphBase *graph) : hasExit(false) {
+    const id_t count = static_cast<id_t>(graph->getCount());
+    if(count == 0) return;
+
+    std::vector<std::vector<id_t>> forward(count);
+    std::vector<std::vector<id_t>> backward(count);
+    for(id_t id = 0; id < count; id ++) {
+        for(auto link : graph->get(id)->getLinks(1)) {
+            auto target = link->getTargetID();
+            forward[id].push_back(target);
+            backward[target].push_back(id);
         }
-        LOG(10, "");
-    }
-
-    ReversePostorder rpo(cfg);
-    rpo.gen(0);
-    auto order = rpo.get()[0];
-    for(size_t i = 0; i < order.size(); i++) {
-        idMap[order[i]] = i;
-    }
-
-    LOG(10, "RPO");
-    for(auto n : order) {
-        LOG0(10, " " << std::setw(3) << n);
     }
-    LOG(10, "");
-
-    bool changed = true;
-    while(changed) {
-        changed = false;
-        for(auto id : order) {
-            LOG(10, "id = " << id);
-            if(id == 0) {
-                idoms[0] = 0;
-                continue;
-            }
-            auto node = cfg->get(id);
-            bool first = true;
-            ControlFlow::id_t idom = -1;
-            for(auto link : node->backwardLinks()) {
-                auto pred = link->getTargetID();
-                if(idoms[pred] != -1) {
-                    if(first) {
-                        idom = pred;
-                        first = false;
-                    }
-                    else {
-                        idom = intersect(pred, idom);
-                    }
-                }
-            }
-
-            if(idoms[id] != idom) {
-                idoms[id] = idom;
-                changed = true;
-                IF_LOG(10) dump();
-            }
+    build(dom, 0, forward, backward);
+
+    // every node without successors flows into a virtual exit
+    const id_t exit = count;
+    forward.emplace_back();
+    backward.emplace_back();
+    for(id_t id = 0; id < count; id ++) {
+        if(forward[id].empty()) {
+            forward[id].push_back(exit);
+            backward[exit].push_back(id);
+            hasExit = true;
         }
     }
+    build(postDom, exit, backward, forward);
 
     IF_LOG(10) dump();
 }
 
-ControlFlow::id_t Dominance::intersect(ControlFlow::id_t i1,
-    ControlFlow::id_t i2) {
+void Dominance::build(Tree &tree, id_t root,
+    const std::vector<std::vector<id_t>> &successors,
+    const std::vector<std::vector<id_t>> &predecessors) {
+
+    const size_t count = successors.size();
+    tree.idoms.assign(count, -1);
+    tree.children.assign(count, {});
+    tree.enter.assign(count, -1);
+    tree.leave.assign(count, -1);
+
+    // number the nodes in DFS preorder; this is iterative since functions
+    // may have thousands of blocks
+    std::vector<int> number(count, -1);
+    std::vector<id_t> vertex;   // by number
+    std::vector<int> parent;    // by number
+    std::vector<std::pair<id_t, size_t>> stack;
+    number[root] = 0;
+    vertex.push_back(root);
+    parent.push_back(-1);
+    stack.emplace_back(root, 0);
+    while(!stack.empty()) {
+        auto id = stack.back().first;
+        auto &index = stack.back().second;
+        if(index < successors[id].size()) {
+            auto next = successors[id][index ++];
+            if(number[next] < 0) {
+                number[next] = static_cast<int>(vertex.size());
+                vertex.push_back(next);
+                parent.push_back(number[id]);
+                stack.emplace_back(next, 0);
+            }
+        }
+        else stack.pop_back();
+    }
 
-    auto finger1 = i1;
-    auto finger2 = i2;
+    // Semi-NCA: semidominators by link-eval with path compression, then
+    // each idom is the nearest common ancestor of parent and semidominator
+    const int n = static_cast<int>(vertex.size());
+    std::vector<int> semi(n), label(n), ancestor(n, -1), idom(parent);
+    for(int i = 0; i < n; i ++) semi[i] = label[i] = i;
+
+    std::vector<int> path;
+    auto eval = [&] (int v) {
+        if(ancestor[v] < 0) return v;
+        path.clear();
+        for(int u = v; ancestor[ancestor[u]] >= 0; u = ancestor[u]) {
+            path.push_back(u);
+        }
+        for(auto it = path.rbegin(); it != path.rend(); ++it) {
+            int a = ancestor[*it];
+            if(semi[label[a]] < semi[label[*it]]) label[*it] = label[a];
+            ancestor[*it] = ancestor[a];
+        }
+        return label[v];
+    };
 
-    LOG(10, "intersect " << i1 << " " << i2);
+    for(int i = n - 1; i > 0; i --) {
+        for(auto pred : predecessors[vertex[i]]) {
+            if(number[pred] < 0) continue;  // unreachable
+            int u = eval(number[pred]);
+            if(semi[u] < semi[i]) semi[i] = semi[u];
+        }
+        ancestor[i] = parent[i];
+    }
+    for(int i = 1; i < n; i ++) {
+        while(idom[i] > semi[i]) idom[i] = idom[idom[i]];
 
-    while(finger1 != finger2) {
-        if(idoms[finger1] == -1) return finger2;
-        if(idoms[finger2] == -1) return finger1;
+        auto id = vertex[i];
+        auto d = vertex[idom[i]];
+        tree.idoms[id] = d;
+        tree.children[d].push_back(id);
+    }
 
-        while(idoms[finger1] != -1 && idMap[finger1] > idMap[finger2]) {
-            finger1 = idoms[finger1];
+    // preorder intervals, for constant-time dominates()
+    int clock = 0;
+    stack.clear();
+    tree.enter[root] = clock ++;
+    stack.emplace_back(root, 0);
+    while(!stack.empty()) {
+        auto id = stack.back().first;
+        auto &index = stack.back().second;
+        if(index < tree.children[id].size()) {
+            auto child = tree.children[id][index ++];
+            tree.enter[child] = clock ++;
+            stack.emplace_back(child, 0);
         }
-        while(idoms[finger2] != -1 && idMap[finger2] > idMap[finger1]) {
-            finger2 = idoms[finger2];
+        else {
+            tree.leave[id] = clock ++;
+            stack.pop_back();
         }
     }
-    return finger1;
+}
+
+bool Dominance::contains(const Tree &tree, id_t a, id_t b) {
+    return tree.enter[a] >= 0 && tree.enter[b] >= 0
+        && tree.enter[a] <= tree.enter[b] && tree.leave[b] <= tree.leave[a];
 }
 
 std::vector<ControlFlow::id_t> Dominance::getDominators(ControlFlow::id_t id) {
     std::vector<ControlFlow::id_t> doms;
-
-    while(id != 0) {
+    for(; id != -1; id = dom.idoms[id]) {
         doms.push_back(id);
-        id = idoms[id];
     }
-    doms.push_back(0);
     return doms;
 }
 
 std::vector<ControlFlow::id_t> Dominance::getPostDominators(
     ControlFlow::id_t id) {
 
-    Preorder po(cfg);
-    po.gen(0);
-    auto order = po.get()[0];
-    for(size_t i = 0; i < order.size(); i++) {
-        idMap[order[i]] = i;
-    }
+    // without an exit (e.g. non-returning calls are not known yet), every
+    // node would trivially post-dominate every other
+    std::vector<ControlFlow::id_t> pdoms;
+    if(!hasExit || postDom.enter[id] < 0) return pdoms;
 
-    std::vector<ControlFlowNode *> exitNodes;
-    for(auto nid : order) {
-        auto node = cfg->get(nid);
-        bool isExit = true;
-        for(auto link : node->forwardLinks()) {
-            (void)link;
-            isExit = false;
-            break;
-        }
-        if(isExit) {
-            exitNodes.push_back(node);
-        }
+    const id_t exit = static_cast<id_t>(postDom.idoms.size() - 1);
+    for(; id != exit; id = postDom.idoms[id]) {
+        pdoms.push_back(id);
     }
-    if(exitNodes.empty()) { // due to not knowing non-returing call yet
-        return {};
-    }
-
-    auto cap = [](std::vector<ControlFlow::id_t> v1,
-        std::vector<ControlFlow::id_t> v2) {
-
-        std::vector<ControlFlow::id_t> v;
-        std::set_intersection(v1.begin(), v1.end(), v2.begin(), v2.end(),
-            std::back_inserter(v));
+    return pdoms;
+}
 
-        return v;
-    };
+ControlFlow::id_t Dominance::getImmediateDominator(ControlFlow::id_t id) const {
+    return dom.idoms[id];
+}
 
-    auto pdom = getDominators(exitNodes[0]->getID());
-    //pdom.erase(std::remove(pdom.begin(), pdom.end(), 0), pdom.end());
+ControlFlow::id_t Dominance::getImmediatePostDominator(
+    ControlFlow::id_t id) const {
 
-    for(size_t i = 1; i <exitNodes.size(); i++) {
-        auto pdom2 = getDominators(exitNodes[i]->getID());
-        std::sort(pdom2.begin(), pdom2.end());
-        pdom = cap(pdom, pdom2);
-        if(pdom.empty()) break;
-    }
+    const id_t exit = static_cast<id_t>(postDom.idoms.size() - 1);
+    auto pdom = postDom.idoms[id];
+    return (pdom == exit) ? -1 : pdom;
+}
 
-    return pdom;
+bool Dominance::dominates(ControlFlow::id_t a, ControlFlow::id_t b) const {
+    return contains(dom, a, b);
 }
 
+bool Dominance::postDominates(ControlFlow::id_t a, ControlFlow::id_t b) const {
+    return contains(postDom, a, b);
+}
 
 void Dominance::dump() {
     LOG(1, "idoms");
-    for(auto i : idoms) {
+    for(auto i : dom.idoms) {
+        LOG0(1, " " << i);
+    }
+    LOG(1, "");
+    LOG(1, "post idoms");
+    for(auto i : postDom.idoms) {
         LOG0(1, " " << i);
     }
     LOG(1, "");
 }
-
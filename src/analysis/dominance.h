@@ -2,25 +2,60 @@
 #define EGALITO_ANALYSIS_DOMINANCE_H
 
 #include <vector>
-#include <set>
 #include "controlflow.h"
 
+/** Dominator and post-dominator trees of a graph whose entry is node 0,
+    computed with the Semi-NCA algorithm (a simpler relative of
+    Lengauer-Tarjan with the same near-linear cost in practice).
+
+    Post-dominance is computed on the reverse graph, from a virtual exit
+    node that every node without successors flows into. Nodes that are not
+    reachable from the entry (or can't reach an exit, for post-dominance)
+    have no immediate dominator.
+
+    The trees are a snapshot: a Function left unchanged can share one
+    through the AnalysisCache, and a modified one gets a fresh copy.
+*/
 class Dominance {
 public:
     using id_t = ControlFlow::id_t;
 
 private:
-    ControlFlowGraph *cfg;
-    std::vector<id_t> idoms;    // immediate dominator
-    std::vector<id_t> idMap;    // id_t => order ID
+    struct Tree {
+        std::vector<id_t> idoms;    // immediate dominator, -1 if none
+        std::vector<std::vector<id_t>> children;
+        std::vector<int> enter;     // preorder interval of the subtree
+        std::vector<int> leave;
+    };
+
+    Tree dom;
+    Tree postDom;   // last index is the virtual exit
+    bool hasExit;
 
 public:
-    Dominance(ControlFlowGraph *cfg);
+    Dominance(GraphBase *graph);
+
+    /** Returns id, then its dominators up to and including the entry. */
     std::vector<id_t> getDominators(id_t id);
+    /** Returns id, then the nodes that every path from id to an exit
+        must go through. Empty if there is no path to an exit. */
     std::vector<id_t> getPostDominators(id_t id);
 
+    id_t getImmediateDominator(id_t id) const;
+    id_t getImmediatePostDominator(id_t id) const;
+    const std::vector<id_t> &getDominatorTreeChildren(id_t id) const
+        { return dom.children[id]; }
+
+    /** True if every path from the entry to b goes through a. */
+    bool dominates(id_t a, id_t b) const;
+    /** True if every path from b to an exit goes through a. */
+    bool postDominates(id_t a, id_t b) const;
+
 private:
-    id_t intersect(id_t i1, id_t i2);
+    static void build(Tree &tree, id_t root,
+        const std::vector<std::vector<id_t>> &successors,
+        const std::vector<std::vector<id_t>> &predecessors);
+    static bool contains(const Tree &tree, id_t a, id_t b);
 
     void dump();
 };
@@ -1,3 +1,4 @@
+#include <set>
 #include <capstone/capstone.h>
 #include "frametype.h"
 #include "analysis/jumptable.h"
@@ -97,6 +98,10 @@ FrameType::FrameType(Function *function)
 
     // find epilogueInstrs, instructions that leave this function
     auto module = dynamic_cast<Module *>(function->getParent()->getParent());
+    std::set<Instruction *> tableJumps;
+    for(auto jt : CIter::children(module->getJumpTableList())) {
+        tableJumps.insert(jt->getDescriptor()->getInstruction());
+    }
     for(auto b : function->getChildren()->getIterable()->iterable()) {
         for(auto ins : b->getChildren()->getIterable()->iterable()) {
             if(dynamic_cast<ReturnInstruction *>(ins->getSemantic())) {
@@ -124,14 +129,7 @@ FrameType::FrameType(Function *function)
             else if(dynamic_cast<IndirectJumpInstruction *>(
                 ins->getSemantic())) {
 
-                bool tablejump = false;
-                for(auto jt : CIter::children(module->getJumpTableList())) {
-                    if(ins == jt->getDescriptor()->getInstruction()) {
-                        tablejump = true;
-                        break;
-                    }
-                }
-                if(!tablejump) epilogueInstrs.push_back(ins);
+                if(!tableJumps.count(ins)) epilogueInstrs.push_back(ins);
             }
         }
     }
@@ -172,16 +170,14 @@ FrameType::FrameType(Function *function)
     }
 
     // fill out jumpToEpilogueInstrs
+    std::set<Chunk *> epilogueSet(epilogueInstrs.begin(), epilogueInstrs.end());
     for(auto block : function->getChildren()->getIterable()->iterable()) {
         for(auto ins : block->getChildren()->getIterable()->iterable()) {
             if(auto cfi = dynamic_cast<ControlFlowInstruction *>(
                 ins->getSemantic())) {
 
-                for(auto ins : epilogueInstrs) {
-                    if(cfi->getLink()->getTarget() == ins) {
-                        jumpToEpilogueInstrs.push_back(cfi);
-                        break;
-                    }
+                if(epilogueSet.count(cfi->getLink()->getTarget())) {
+                    jumpToEpilogueInstrs.push_back(cfi);
                 }
             }
         }
@@ -235,6 +231,65 @@ bool FrameType::hasStackFrame(Function *function) {
 #endif
 }
 
+bool FrameType::isSafeLeaf(Function *function) {
+#ifdef ARCH_X86_64
+    if(hasStackFrame(function)) return false;
+
+    for(auto block : CIter::children(function)) {
+        for(auto instr : CIter::children(block)) {
+            auto semantic = instr->getSemantic();
+            if(auto cfi = dynamic_cast<ControlFlowInstruction *>(semantic)) {
+                if(cfi->getMnemonic() == "callq") return false;
+                continue;
+            }
+            if(dynamic_cast<IndirectCallInstruction *>(semantic)) return false;
+            if(auto v = dynamic_cast<IndirectJumpInstruction *>(semantic)) {
+                if(v->getMnemonic() == "callq") return false;
+            }
+            if(auto v = dynamic_cast<DataLinkedControlFlowInstruction *>(
+                semantic)) {
+
+                if(v->isCall()) return false;
+            }
+
+            auto assembly = semantic->getAssembly();
+            if(!assembly) return false;
+            if(assembly->getId() == X86_INS_CALL) return false;
+            if(assembly->getId() == X86_INS_PUSH
+                || assembly->getId() == X86_INS_POP) continue;  // below it
+
+            // in AT&T order a store's memory operand is last
+            auto id = assembly->getId();
+            auto operands = assembly->getAsmOperands();
+            auto op = operands->getOperands();
+            size_t count = operands->getOpCount();
+            for(size_t i = 0; i < count; i ++) {
+                if(op[i].type == X86_OP_REG) {
+                    // a copy of %rsp would let a later store reach the frame
+                    if(op[i].reg == X86_REG_RSP) return false;
+                    continue;
+                }
+                if(op[i].type != X86_OP_MEM) continue;
+
+                bool frameBased = (op[i].mem.base == X86_REG_RSP
+                    || op[i].mem.base == X86_REG_RBP
+                    || op[i].mem.index == X86_REG_RSP
+                    || op[i].mem.index == X86_REG_RBP);
+                if(!frameBased) continue;
+
+                bool load = (i + 1 < count) && (id == X86_INS_MOV
+                    || id == X86_INS_MOVZX || id == X86_INS_MOVSXD);
+                bool compare = (id == X86_INS_CMP || id == X86_INS_TEST);
+                if(!load && !compare) return false;  // including lea
+            }
+        }
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
 void FrameType::fixEpilogue(Instruction *oldInstr, Instruction *newInstr) {
     for(auto &ins : epilogueInstrs) {
         if(ins == oldInstr) {
@@ -252,7 +307,7 @@ void FrameType::fixEpilogue(Instruction *oldInstr, Instruction *newInstr) {
     }
 }
 
-void FrameType::dump() {
+void FrameType::dump() const {
     LOG(1, "SP set at " << (setSPInstr ? setSPInstr->getName() : ""));
     LOG(1, "BP set at " << (setBPInstr ? setBPInstr->getName() : ""));
     for(auto i : resetSPInstrs) {
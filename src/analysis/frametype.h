@@ -7,6 +7,10 @@ class Function;
 class Instruction;
 class ControlFlowInstruction;
 
+/** Where a Function sets up and tears down its stack frame. Passes that
+    only read this should get it from the AnalysisCache, which keeps it
+    until the Function changes.
+*/
 class FrameType {
 private:
     bool hasFrame;
@@ -18,7 +22,7 @@ private:
 
 public:
     FrameType(Function *function);
-    bool createsFrame() { return hasFrame; }
+    bool createsFrame() const { return hasFrame; }
     Instruction *getSetBPInstr() const { return setBPInstr; }
     Instruction *getSetSPInstr() const { return setSPInstr; }
     std::vector<Instruction *> getResetSPInstrs() const
@@ -27,9 +31,16 @@ public:
         { return epilogueInstrs; }
     void fixEpilogue(Instruction *oldInstr, Instruction *newInstr);
     void setSetBPInstr(Instruction *newInstr) { setBPInstr = newInstr; }
-    void dump();
+    void dump() const;
 
     static bool hasStackFrame(Function *function);
+
+    /** True for functions that can't overwrite their own return address:
+        leaves (no calls) without a stack frame that never store relative
+        to %rsp or %rbp. Their only stores go through pointers from their
+        caller, and any overflow from a caller's buffer reaches the
+        caller's return address first. */
+    static bool isSafeLeaf(Function *function);
 };
 
 
@@ -0,0 +1,380 @@
+#include <fstream>
+#include <map>
+#include <climits>
+#include <cstdio>  // for std::rename, std::remove
+#include <unistd.h>  // for getpid
+#include "functioncache.h"
+#include "analysis/jumptable.h"
+#include "analysis/jumptabledetection.h"
+#include "archive/filesystem.h"
+#include "chunk/concrete.h"
+#include "conductor/parsecache.h"
+#include "disasm/makesemantic.h"
+#include "instr/concrete.h"
+#include "operation/find.h"
+
+#undef DEBUG_GROUP
+#define DEBUG_GROUP djumptable
+#include "log/log.h"
+
+// bump when the key or the file format changes
+static const int FORMAT_VERSION = 1;
+
+FunctionAnalysisCache::FunctionAnalysisCache(Module *module)
+    : module(module), hitCount(0) {
+
+#ifdef ARCH_X86_64
+    ParseCache cache;
+    if(!cache.isEnabled()) return;
+
+    filename = cache.getDirectory() + "/functions/" + module->getName()
+        + "-v" + std::to_string(FORMAT_VERSION) + ".jt";
+    load();
+#endif
+}
+
+void FunctionAnalysisCache::restore(JumptableDetection &search) {
+    if(!isEnabled()) return;
+
+    for(auto function : CIter::functions(module)) {
+        if(!hasIndirectJump(function)) continue;
+
+        uint64_t key;
+        if(!makeKey(function, key)) continue;
+        keyMap[function] = key;
+
+        auto it = oldMap.find(key);
+        if(it == oldMap.end()) continue;
+        if(restore(function, (*it).second, search)) {
+            search.skipFunction(function);
+            newMap[key] = (*it).second;
+            hitCount ++;
+        }
+    }
+    LOG(1, "reusing jump table analysis of " << std::dec << hitCount
+        << " of " << keyMap.size() << " functions in ["
+        << module->getName() << "]");
+}
+
+bool FunctionAnalysisCache::restore(Function *function,
+    const TableList &list, JumptableDetection &search) {
+
+    struct Table {
+        Instruction *jump;
+        address_t tableBase;
+        address_t targetBase;
+    };
+    std::vector<Table> tables;
+
+    // check everything first, so that a function is never half restored
+    for(const auto &entry : list) {
+        Table table;
+        table.jump = findInstruction(function, entry.jumpOffset);
+        if(!table.jump || !dynamic_cast<IndirectJumpInstruction *>(
+            table.jump->getSemantic())) {
+
+            return false;
+        }
+
+        auto reference = findInstruction(function, entry.tableReference);
+        if(!reference || !getRIPTarget(reference, table.tableBase)) {
+            return false;
+        }
+        if(!module->getDataRegionList()->findDataSectionContaining(
+            table.tableBase)) {
+
+            return false;
+        }
+
+        switch(entry.targetKind) {
+        case TARGET_TABLE:
+            table.targetBase = table.tableBase;
+            break;
+        case TARGET_OFFSET:
+            table.targetBase = function->getAddress() + entry.targetValue;
+            break;
+        case TARGET_REFERENCE:
+            reference = findInstruction(function, entry.targetValue);
+            if(!reference || !getRIPTarget(reference, table.targetBase)) {
+                return false;
+            }
+            break;
+        default:
+            return false;
+        }
+
+        uint64_t hash;
+        if(!hashContents(table.tableBase, entry.scale, entry.bound, hash)
+            || hash != entry.contentHash) {
+
+            return false;
+        }
+        tables.push_back(table);
+    }
+
+    for(size_t i = 0; i < tables.size(); i ++) {
+        search.addDescriptor(function, tables[i].jump, tables[i].tableBase,
+            tables[i].targetBase, list[i].scale, list[i].bound);
+    }
+    return true;
+}
+
+void FunctionAnalysisCache::save(
+    const std::vector<JumpTableDescriptor *> &tableList) {
+
+    if(!isEnabled()) return;
+
+    std::map<Function *, std::vector<JumpTableDescriptor *>> tableMap;
+    for(auto descriptor : tableList) {
+        tableMap[descriptor->getFunction()].push_back(descriptor);
+    }
+
+    for(auto &pair : keyMap) {
+        auto function = pair.first;
+        if(newMap.find(pair.second) != newMap.end()) continue;  // restored
+
+        TableList list;
+        bool valid = true;
+        for(auto descriptor : tableMap[function]) {
+            TableEntry entry;
+            if(!makeEntry(descriptor, entry)) {
+                valid = false;
+                break;
+            }
+            list.push_back(entry);
+        }
+        if(valid) newMap[pair.second] = std::move(list);
+    }
+
+    ArchiveFileSystem().makeArchivePath(filename);
+
+    // write to a private name first, so concurrent readers never see a
+    // partial file
+    auto temporary = filename + ".tmp" + std::to_string(getpid());
+    {
+        std::ofstream file(temporary.c_str());
+        file << "egalito-functions " << FORMAT_VERSION << '\n';
+        for(const auto &pair : newMap) {
+            file << std::hex << pair.first << std::dec << ' '
+                << pair.second.size() << '\n';
+            for(const auto &entry : pair.second) {
+                file << entry.jumpOffset << ' ' << entry.tableReference
+                    << ' ' << entry.targetKind << ' ' << entry.targetValue
+                    << ' ' << entry.scale << ' ' << entry.bound
+                    << ' ' << std::hex << entry.contentHash << std::dec
+                    << '\n';
+            }
+        }
+        if(!file) {
+            std::remove(temporary.c_str());
+            return;
+        }
+    }
+    if(std::rename(temporary.c_str(), filename.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        LOG(1, "Could not write function cache [" << filename << "]");
+    }
+}
+
+void FunctionAnalysisCache::load() {
+    std::ifstream file(filename.c_str());
+    std::string magic;
+    int version = 0;
+    if(!(file >> magic >> version) || magic != "egalito-functions"
+        || version != FORMAT_VERSION) {
+
+        return;
+    }
+
+    uint64_t key;
+    size_t count;
+    while(file >> std::hex >> key >> std::dec >> count) {
+        TableList list(count);
+        for(auto &entry : list) {
+            file >> entry.jumpOffset >> entry.tableReference
+                >> entry.targetKind >> entry.targetValue >> entry.scale
+                >> entry.bound >> std::hex >> entry.contentHash >> std::dec;
+        }
+        if(!file) break;
+        oldMap[key] = std::move(list);
+    }
+}
+
+bool FunctionAnalysisCache::makeEntry(JumpTableDescriptor *descriptor,
+    TableEntry &entry) {
+
+    auto function = descriptor->getFunction();
+    auto functionStart = function->getAddress();
+    auto tableBase = descriptor->getAddress();
+    auto targetBase = descriptor->getTargetBaseLink()->getTargetAddress();
+
+    // the first instruction whose RIP-relative operand points at address
+    auto findReference = [function, functionStart] (address_t address,
+        address_t &offset) {
+
+        for(auto block : CIter::children(function)) {
+            for(auto instr : CIter::children(block)) {
+                address_t target;
+                if(getRIPTarget(instr, target) && target == address) {
+                    offset = instr->getAddress() - functionStart;
+                    return true;
+                }
+            }
+        }
+        return false;
+    };
+
+    entry.jumpOffset = descriptor->getInstruction()->getAddress()
+        - functionStart;
+    if(!findReference(tableBase, entry.tableReference)) return false;
+
+    if(targetBase == tableBase) {
+        entry.targetKind = TARGET_TABLE;
+        entry.targetValue = 0;
+    }
+    else if(targetBase >= functionStart
+        && targetBase < functionStart + function->getSize()) {
+
+        entry.targetKind = TARGET_OFFSET;
+        entry.targetValue = targetBase - functionStart;
+    }
+    else {
+        entry.targetKind = TARGET_REFERENCE;
+        if(!findReference(targetBase, entry.targetValue)) return false;
+    }
+
+    entry.scale = descriptor->getScale();
+    entry.bound = descriptor->getBound();
+    return hashContents(tableBase, entry.scale, entry.bound,
+        entry.contentHash);
+}
+
+bool FunctionAnalysisCache::makeKey(Function *function, uint64_t &key) {
+#ifdef ARCH_X86_64
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    auto addBytes = [&hash] (const void *data, size_t size) {
+        auto p = static_cast<const unsigned char *>(data);
+        for(size_t i = 0; i < size; i ++) {
+            hash = (hash ^ p[i]) * 1099511628211ull;
+        }
+    };
+    auto addValue = [&addBytes] (uint64_t value) {
+        addBytes(&value, sizeof(value));
+    };
+
+    auto functionStart = function->getAddress();
+    auto functionEnd = functionStart + function->getSize();
+    addValue(function->getSize());
+    for(auto block : CIter::children(function)) {
+        addValue(block->getSize());
+
+        for(auto instr : CIter::children(block)) {
+            auto semantic = instr->getSemantic();
+            if(auto cfi = dynamic_cast<ControlFlowInstruction *>(semantic)) {
+                const auto &opcode = cfi->getOpcode();
+                addValue(opcode.length());
+                addBytes(opcode.data(), opcode.length());
+                addValue(cfi->getDisplacementSize());
+
+                auto link = cfi->getLink();
+                auto target = link ? link->getTargetAddress() : 0;
+                addValue((target >= functionStart && target < functionEnd)
+                    ? target - functionStart : ~0ull);
+                continue;
+            }
+
+            std::string data;
+            try {
+                data = semantic->getData();
+            }
+            catch(const char *) {
+                return false;
+            }
+
+            if(auto assembly = semantic->getAssembly()) {
+                auto operands = assembly->getAsmOperands();
+                for(size_t i = 0; i < operands->getOpCount(); i ++) {
+                    if(!MakeSemantic::isRIPRelative(&*assembly, i)) continue;
+
+                    size_t offset = MakeSemantic::getDispOffset(&*assembly, i);
+                    size_t size = MakeSemantic::determineDisplacementSize(
+                        &*assembly, i);
+                    if(offset + size > data.length()) return false;
+                    data.replace(offset, size, size, '\0');
+                }
+            }
+            addValue(data.length());
+            addBytes(data.data(), data.length());
+        }
+    }
+
+    key = hash;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool FunctionAnalysisCache::hashContents(address_t address, int scale,
+    long bound, uint64_t &hash) {
+
+    hash = 14695981039346656037ull;
+    if(bound == LONG_MAX || bound < 0) return true;  // no entries are read
+
+    auto section = module->getDataRegionList()
+        ->findDataSectionContaining(address);
+    if(!section) return false;
+    auto region = static_cast<DataRegion *>(section->getParent());
+
+    size_t offset = address - region->getAddress();
+    size_t size = (bound + 1) * scale;
+    if(offset + size > region->getSizeOfInitializedData()) return false;
+
+    auto p = reinterpret_cast<const unsigned char *>(
+        region->getDataPointer()) + offset;
+    for(size_t i = 0; i < size; i ++) {
+        hash = (hash ^ p[i]) * 1099511628211ull;
+    }
+    return true;
+}
+
+bool FunctionAnalysisCache::getRIPTarget(Instruction *instruction,
+    address_t &target) {
+
+#ifdef ARCH_X86_64
+    auto assembly = instruction->getSemantic()->getAssembly();
+    if(!assembly) return false;
+
+    auto operands = assembly->getAsmOperands();
+    for(size_t i = 0; i < operands->getOpCount(); i ++) {
+        if(MakeSemantic::isRIPRelative(&*assembly, i)) {
+            target = instruction->getAddress() + instruction->getSize()
+                + operands->getOperands()[i].mem.disp;
+            return true;
+        }
+    }
+#endif
+    return false;
+}
+
+Instruction *FunctionAnalysisCache::findInstruction(Function *function,
+    address_t offset) {
+
+    auto address = function->getAddress() + offset;
+    auto instr = dynamic_cast<Instruction *>(
+        ChunkFind().findInnermostAt(function, address));
+    return (instr && instr->getAddress() == address) ? instr : nullptr;
+}
+
+bool FunctionAnalysisCache::hasIndirectJump(Function *function) {
+    for(auto block : CIter::children(function)) {
+        auto instr = block->getChildren()->getIterable()->getLast();
+        if(instr && dynamic_cast<IndirectJumpInstruction *>(
+            instr->getSemantic())) {
+
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,80 @@
+#ifndef EGALITO_ANALYSIS_FUNCTION_CACHE_H
+#define EGALITO_ANALYSIS_FUNCTION_CACHE_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include "types.h"
+
+class Module;
+class Function;
+class Instruction;
+class JumpTableDescriptor;
+class JumptableDetection;
+
+/** Caches jump table detection per function, so that a new version of a
+    library only has the functions that changed analyzed again. The parse
+    cache (keyed by build-id) misses on the whole library after any update.
+
+    Functions are keyed by a hash of their block layout and instruction
+    bytes. Direct branch displacements become offsets for targets inside
+    the function and are left out otherwise, and RIP-relative displacements
+    are left out. A cached table then names the instructions whose
+    RIP-relative operands give its address and target base. Each table's
+    contents are hashed too, and must still match before it is used.
+
+    Entries are kept per Module name in the EGALITO_PARSE_CACHE directory.
+    Only x86_64 is supported.
+*/
+class FunctionAnalysisCache {
+private:
+    enum TargetKind {
+        TARGET_TABLE,       // the targets are relative to the table
+        TARGET_OFFSET,      // value is an offset into the function
+        TARGET_REFERENCE,   // value is an instruction offset, as for tables
+    };
+    struct TableEntry {
+        address_t jumpOffset;
+        address_t tableReference;
+        int targetKind;
+        address_t targetValue;
+        int scale;
+        long bound;
+        uint64_t contentHash;
+    };
+    typedef std::vector<TableEntry> TableList;
+
+    Module *module;
+    std::string filename;
+    std::unordered_map<uint64_t, TableList> oldMap;
+    std::unordered_map<uint64_t, TableList> newMap;
+    std::unordered_map<Function *, uint64_t> keyMap;
+    size_t hitCount;
+public:
+    FunctionAnalysisCache(Module *module);
+
+    bool isEnabled() const { return !filename.empty(); }
+    size_t getHitCount() const { return hitCount; }
+
+    /** Adds the cached tables of every function that is unchanged, and
+        makes search skip those functions. */
+    void restore(JumptableDetection &search);
+
+    /** Records the tables of the functions search analyzed, and writes
+        the cache file. */
+    void save(const std::vector<JumpTableDescriptor *> &tableList);
+private:
+    void load();
+    bool restore(Function *function, const TableList &list,
+        JumptableDetection &search);
+    bool makeEntry(JumpTableDescriptor *descriptor, TableEntry &entry);
+    bool makeKey(Function *function, uint64_t &key);
+    bool hashContents(address_t address, int scale, long bound,
+        uint64_t &hash);
+    static bool getRIPTarget(Instruction *instruction, address_t &target);
+    static Instruction *findInstruction(Function *function, address_t offset);
+    static bool hasIndirectJump(Function *function);
+};
+
+#endif
@@ -0,0 +1,152 @@
+#include <algorithm>
+#include "functionlayout.h"
+#include "branchprofile.h"
+#include "call.h"
+#include "chunk/concrete.h"
+#include "operation/find2.h"
+#include "log/log.h"
+
+void FunctionLayout::addSamples(Function *function, uint64_t count) {
+    sampleMap[function] += count;
+}
+
+void FunctionLayout::addCalls(Function *caller, Function *callee,
+    uint64_t count) {
+
+    edgeMap[EdgeType(caller, callee)] += count;
+}
+
+bool FunctionLayout::readProfile(const std::string &filename) {
+    BranchProfile profile;
+    if(!profile.read(filename)) return false;
+
+    for(const auto &count : profile.getFunctionCountList()) {
+        if(auto f = ChunkFind2().findFunctionInModule(
+            count.first.c_str(), module)) {
+
+            addSamples(f, count.second);
+        }
+    }
+    for(const auto &branch : profile.getBranchList()) {
+        addBranch(branch.from, branch.to, branch.count);
+    }
+    return true;
+}
+
+void FunctionLayout::addBranch(address_t from, address_t to, uint64_t count) {
+    auto spatial = CIter::spatial(module->getFunctionList());
+    auto source = spatial->findContaining(from);
+    auto target = spatial->findContaining(to);
+    if(!target) return;
+
+    addSamples(target, count);
+    if(source && source != target && to == target->getAddress()) {
+        addCalls(source, target, count);
+    }
+}
+
+void FunctionLayout::addStaticEdges() {
+    auto program = dynamic_cast<Program *>(module->getParent());
+    if(!program) return;
+
+    CallGraph graph(program);
+    for(const auto &kv : sampleMap) {
+        auto callee = kv.first;
+        std::vector<Function *> callers;
+        for(auto link : graph.getNode(callee)->upwardLinks()) {
+            auto caller = graph.getFunction(link->getTargetID());
+            if(caller != callee && caller->getParent() == callee->getParent()) {
+                callers.push_back(caller);
+            }
+        }
+        for(auto caller : callers) {
+            addCalls(caller, callee,
+                std::max<uint64_t>(kv.second / callers.size(), 1));
+        }
+    }
+}
+
+std::vector<Function *> FunctionLayout::computeOrder() {
+    if(edgeMap.empty()) addStaticEdges();
+
+    std::vector<Function *> original;
+    std::vector<Function *> hot;
+    for(auto function : CIter::functions(module)) {
+        original.push_back(function);
+        auto it = sampleMap.find(function);
+        if(it != sampleMap.end() && it->second > 0) hot.push_back(function);
+    }
+    std::stable_sort(hot.begin(), hot.end(), [this] (Function *a, Function *b) {
+        return sampleMap[a] > sampleMap[b];
+    });
+
+    // heaviest caller of each function; the first one wins ties
+    std::map<Function *, std::pair<Function *, uint64_t>> bestCaller;
+    for(const auto &kv : edgeMap) {
+        auto caller = kv.first.first;
+        auto callee = kv.first.second;
+        auto it = bestCaller.find(callee);
+        if(it == bestCaller.end() || kv.second > it->second.second) {
+            bestCaller[callee] = std::make_pair(caller, kv.second);
+        }
+    }
+
+    struct Cluster {
+        std::vector<Function *> functionList;
+        size_t size;
+        uint64_t samples;
+
+        double getDensity() const
+            { return double(samples) / std::max<size_t>(size, 1); }
+    };
+    std::vector<Cluster> clusterList;
+    std::map<Function *, size_t> clusterOf;
+    for(auto function : hot) {
+        clusterOf[function] = clusterList.size();
+        clusterList.push_back(Cluster{{function}, function->getSize(),
+            sampleMap[function]});
+    }
+
+    for(auto function : hot) {
+        auto it = bestCaller.find(function);
+        if(it == bestCaller.end()) continue;
+        auto callerCluster = clusterOf.find(it->second.first);
+        if(callerCluster == clusterOf.end()) continue;  // caller is cold
+
+        auto &into = clusterList[callerCluster->second];
+        auto &from = clusterList[clusterOf[function]];
+        if(&into == &from) continue;
+        if(into.size + from.size > HUGE_PAGE_SIZE) continue;
+        // don't dilute a dense cluster with a much colder caller chain
+        if(into.getDensity() * 8 < from.getDensity()) continue;
+
+        for(auto f : from.functionList) {
+            clusterOf[f] = callerCluster->second;
+            into.functionList.push_back(f);
+        }
+        into.size += from.size;
+        into.samples += from.samples;
+        from.functionList.clear();
+        from.size = 0;
+        from.samples = 0;
+    }
+
+    std::stable_sort(clusterList.begin(), clusterList.end(),
+        [] (const Cluster &a, const Cluster &b) {
+            return a.getDensity() > b.getDensity();
+        });
+
+    std::vector<Function *> order;
+    hotSize = 0;
+    for(const auto &cluster : clusterList) {
+        for(auto f : cluster.functionList) order.push_back(f);
+        hotSize += cluster.size;
+    }
+    for(auto function : original) {
+        if(!clusterOf.count(function)) order.push_back(function);
+    }
+
+    LOG(1, "function layout: " << std::dec << hot.size() << " hot functions in "
+        << hotSize << " bytes, " << (original.size() - hot.size()) << " cold");
+    return order;
+}
@@ -0,0 +1,52 @@
+#ifndef EGALITO_ANALYSIS_FUNCTION_LAYOUT_H
+#define EGALITO_ANALYSIS_FUNCTION_LAYOUT_H
+
+#include <map>
+#include <vector>
+#include <string>
+#include <utility>
+#include <cstdint>
+#include "types.h"
+
+class Module;
+class Function;
+
+/** Profile-guided function ordering by call-chain clustering (C3).
+
+    Functions are weighted by their samples, and caller/callee pairs by the
+    number of calls between them. Without branch samples the edges come
+    from the static CallGraph, with each function's samples split evenly
+    among its callers. Going from the hottest function down, each one's
+    cluster is appended to the cluster of its heaviest caller, as long as
+    the result fits in a huge page. Clusters are then laid out by density.
+    Functions without samples go last, in their original order, so that
+    the hot code is packed together at the start of the code region.
+*/
+class FunctionLayout {
+public:
+    static const size_t HUGE_PAGE_SIZE = 0x200000;
+private:
+    typedef std::pair<Function *, Function *> EdgeType;  // caller, callee
+    Module *module;
+    std::map<Function *, uint64_t> sampleMap;
+    std::map<EdgeType, uint64_t> edgeMap;
+    size_t hotSize;
+public:
+    FunctionLayout(Module *module) : module(module), hotSize(0) {}
+
+    void addSamples(Function *function, uint64_t count);
+    void addCalls(Function *caller, Function *callee, uint64_t count);
+
+    /** Reads a BranchProfile. Returns false if the file can't be read. */
+    bool readProfile(const std::string &filename);
+
+    std::vector<Function *> computeOrder();
+
+    /** Total size of the functions with samples in the last order. */
+    size_t getHotSize() const { return hotSize; }
+private:
+    void addBranch(address_t from, address_t to, uint64_t count);
+    void addStaticEdges();
+};
+
+#endif
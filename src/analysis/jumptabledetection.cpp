@@ -1,5 +1,7 @@
 #include <cassert>
 #include "jumptabledetection.h"
+#include "analysis/analysiscache.h"
+#include "analysis/budget.h"
 #include "analysis/walker.h"
 #include "analysis/usedef.h"
 #include "analysis/usedefutil.h"
@@ -7,34 +9,81 @@
 #include "elf/elfspace.h"
 #include "instr/concrete.h"
 #include "operation/find.h"
+#include "util/threadpool.h"
+#include "util/counter.h"
 
 #include "log/log.h"
 #include "log/temp.h"
 
+// parseBaseAddress() matches these together with its own form
+typedef TreePatternUnary<TreeNodeDereference,
+    TreePatternCapture<TreePatternBinary<TreeNodeAddition,
+        TreePatternTerminal<TreeNodePhysicalRegister>,
+        TreePatternTerminal<TreeNodeConstant>>
+    >
+> SavedAddressForm;
+
+typedef TreePatternCapture<TreePatternTerminal<TreeNodePhysicalRegister>
+> MovedAddressForm;
+
 void JumptableDetection::detect(Module *module) {
     //TemporaryLogLevel tll("analysis", 11);
+    ThreadPool pool;
+    if(!pool.isParallel()) {
+        for(auto f : CIter::functions(module)) {
+            if(skipSet.count(f)) continue;
+            //TemporaryLogLevel tll2("analysis", 11, f->hasName("vfprintf"));
+            detect(f);
+            //IF_LOG(11) std::cout.flush();
+        }
+        return;
+    }
+
+    std::vector<Function *> functionList;
     for(auto f : CIter::functions(module)) {
-        //TemporaryLogLevel tll2("analysis", 11, f->hasName("vfprintf"));
-        detect(f);
-        //IF_LOG(11) std::cout.flush();
+        if(skipSet.count(f)) continue;
+        if(containsIndirectJump(f)) functionList.push_back(f);
+    }
+
+    // descriptors need links and markers in the module, so only the
+    // analysis itself runs in parallel
+    struct Result {
+        std::shared_ptr<FunctionAnalysis> analysis;  // referenced by info
+        std::vector<PendingDescriptor> pendingList;
+        std::map<address_t, IndextableInfo> indexTables;
+    };
+    std::vector<Result> resultList(functionList.size());
+    pool.parallelFor(functionList.size(), [&] (size_t i) {
+        auto &result = resultList[i];
+        JumptableDetection local(module);
+        local.pendingList = &result.pendingList;
+        local.indexTables = indexTables;
+
+        AnalysisBudget budget(functionList[i]);
+        result.analysis = AnalysisCache::getInstance()->get(functionList[i]);
+        local.detect(result.analysis->getWorkingSet());
+        result.indexTables = std::move(local.indexTables);
+    });
+
+    for(auto &result : resultList) {
+        for(const auto &pending : result.pendingList) {
+            makeDescriptor(pending.instruction, &pending.info);
+        }
+        indexTables.insert(result.indexTables.begin(),
+            result.indexTables.end());
     }
 }
 
 void JumptableDetection::detect(Function *function) {
+    COUNTER_SCOPE(function);
+    AnalysisBudget budget(function);
     if(containsIndirectJump(function)) {
-        ControlFlowGraph cfg(function);
-        UDConfiguration config(&cfg);
-        UDRegMemWorkingSet working(function, &cfg);
-        UseDef usedef(&config, &working);
+        auto analysis = AnalysisCache::getInstance()->get(function);
 
-        IF_LOG(10) cfg.dump();
-        IF_LOG(10) cfg.dumpDot();
+        IF_LOG(10) analysis->getCFG()->dump();
+        IF_LOG(10) analysis->getCFG()->dumpDot();
 
-        SccOrder order(&cfg);
-        order.genFull(0);
-        usedef.analyze(order.get());
-
-        detect(&working);
+        detect(analysis->getWorkingSet());
     }
 }
 
@@ -55,10 +104,14 @@ void JumptableDetection::detect(UDRegMemWorkingSet *working) {
         >
     > MakeJumpTargetForm2;
 
+    typedef TreePatternSet<MakeJumpTargetForm1, MakeJumpTargetForm2>
+        MakeJumpTargetForms;
+
     for(auto block : CIter::children(working->getFunction())) {
         auto instr = block->getChildren()->getIterable()->getLast();
         auto s = instr->getSemantic();
         if(auto ij = dynamic_cast<IndirectJumpInstruction *>(s)) {
+            COUNTER_INC("indirect jumps searched");
             auto mode = ij->getAssembly()->getAsmOperands()->getMode();
             if(mode != AssemblyOperands::MODE_REG) continue;
             LOG(10, "indirect jump at 0x" << std::hex << instr->getAddress());
@@ -67,20 +120,12 @@ void JumptableDetection::detect(UDRegMemWorkingSet *working) {
             int reg = X86Register::convertToPhysical(ij->getRegister());
 
             JumptableInfo info(working->getCFG(), working, state);
-            auto parser = [&](UDState *s, TreeCapture& cap) {
+            auto parser = [&](UDState *s, size_t form, TreeCapture& cap) {
+                LOG(10, "trying MakeJumpTargetForm" << (form + 1));
                 return parseJumptable(s, cap, &info);
             };
-            auto parser2 = parser;
-
-            LOG(10, "trying MakeJumpTargetForm1");
-            FlowUtil::searchUpDef<MakeJumpTargetForm1>(state, reg, parser);
-            if(info.valid) {
-                makeDescriptor(instr, &info);
-                continue;
-            }
 
-            LOG(10, "trying MakeJumpTargetForm2");
-            FlowUtil::searchUpDef<MakeJumpTargetForm2>(state, reg, parser2);
+            FlowUtil::searchUpDefAny<MakeJumpTargetForms>(state, reg, parser);
             if(info.valid) {
                 makeDescriptor(instr, &info);
                 continue;
@@ -105,31 +150,28 @@ void JumptableDetection::detect(UDRegMemWorkingSet *working) {
             >
     > MakeJumpTargetForm2;
 
+    typedef TreePatternSet<MakeJumpTargetForm1, MakeJumpTargetForm2>
+        MakeJumpTargetForms;
+
     for(auto block : CIter::children(working->getFunction())) {
         auto instr = block->getChildren()->getIterable()->getLast();
         auto s = instr->getSemantic();
         if(dynamic_cast<IndirectJumpInstruction *>(s)) {
+            COUNTER_INC("indirect jumps searched");
             LOG(10, "indirect jump at 0x" << std::hex << instr->getAddress());
             auto state = working->getState(instr);
             IF_LOG(10) state->dumpState();
 
             JumptableInfo info(working->getCFG(), working, state);
-            auto parser = [&](UDState *s, TreeCapture& cap) {
+            auto parser = [&](UDState *s, size_t form, TreeCapture& cap) {
+                LOG(10, "trying MakeJumpTargetForm" << (form + 1));
                 return parseJumptable(s, cap, &info);
             };
 
-            LOG(10, "trying MakeJumpTargetForm1");
             auto assembly = s->getAssembly();
             auto op0 = assembly->getAsmOperands()->getOperands()[0].reg;
             int reg = AARCH64GPRegister::convertToPhysical(op0);
-            FlowUtil::searchUpDef<MakeJumpTargetForm1>(state, reg, parser);
-            if(info.valid) {
-                makeDescriptor(instr, &info);
-                continue;
-            }
-
-            LOG(10, "trying MakeJumpTargetForm2");
-            FlowUtil::searchUpDef<MakeJumpTargetForm2>(state, reg, parser);
+            FlowUtil::searchUpDefAny<MakeJumpTargetForms>(state, reg, parser);
             if(info.valid) {
                 makeDescriptor(instr, &info);
                 continue;
@@ -183,6 +225,7 @@ void JumptableDetection::detect(UDRegMemWorkingSet *working) {
         auto instr = block->getChildren()->getIterable()->getLast();
         auto s = instr->getSemantic();
         if(auto ij = dynamic_cast<IndirectJumpInstruction *>(s)) {
+            COUNTER_INC("indirect jumps searched");
             LOG(10, "***** indirect jump at 0x" << std::hex << instr->getAddress());
             CLOG(10, "register: %d", ij->getRegister());
 
@@ -229,6 +272,9 @@ bool JumptableDetection::containsIndirectJump(Function *function) const {
 bool JumptableDetection::parseJumptable(UDState *state, TreeCapture& cap,
     JumptableInfo *info) {
 
+    COUNTER_INC("jump table candidates tried");
+    // out of budget: returning true stops searching this jump
+    if(!AnalysisBudget::spend()) return true;
 #ifdef ARCH_X86_64
     auto regTree1 = dynamic_cast<TreeNodePhysicalRegister *>(cap.get(0));
     auto regTree2 = dynamic_cast<TreeNodePhysicalRegister *>(cap.get(1));
@@ -395,37 +441,61 @@ bool JumptableDetection::parseJumptableWithIndexTable(UDState *state,
 void JumptableDetection::makeDescriptor(Instruction *instruction,
     const JumptableInfo *info) {
 
-    auto working = info->working;
+    if(pendingList) {
+        pendingList->emplace_back(instruction, *info);
+        return;
+    }
+
+    auto jtd = makeDescriptor(info->working->getFunction(), instruction,
+        info->tableBase, info->targetBase, info->scale);
+    if(!jtd) return;
+    jtd->setEntries(info->entries);
+
+    LOG(10, "jump table jump at "
+        << std::hex << info->jumpState->getInstruction()->getAddress());
+    LOG(10, "descriptor:" << jtd);
+    LOG(10, "baseAddress = " << std::hex << info->tableBase);
+    LOG(10, "targetBaseAddress = " << std::hex << info->targetBase);
+    LOG(10, "scale = " << std::dec << info->scale);
+    LOG(10, "entries = " << std::dec << info->entries);
+}
+
+void JumptableDetection::addDescriptor(Function *function,
+    Instruction *instruction, address_t tableBase, address_t targetBase,
+    int scale, long bound) {
+
+    auto jtd = makeDescriptor(function, instruction, tableBase, targetBase,
+        scale);
+    if(jtd) jtd->setBound(bound);
+}
+
+JumpTableDescriptor *JumptableDetection::makeDescriptor(Function *function,
+    Instruction *instruction, address_t tableBase, address_t targetBase,
+    size_t scale) {
+
     auto it = tableMap.find(instruction);
     if(it != tableMap.end()) {
-        bool exists = false;
         for(auto d : it->second) {
             if(d->getInstruction() == instruction
-                && d->getAddress() == info->tableBase
-                && d->getTargetBaseLink()->getTargetAddress()
-                    == info->targetBase
-                && d->getScale() == static_cast<int>(info->scale)
-                //&& d->getEntries() == info->entries
-                ) {
-                exists = true;
-                break;
+                && d->getAddress() == tableBase
+                && d->getTargetBaseLink()->getTargetAddress() == targetBase
+                && d->getScale() == static_cast<int>(scale)) {
+
+                return nullptr;
             }
         }
-        if(exists) return;
     }
 
-    auto jtd = new JumpTableDescriptor(working->getFunction(), instruction);
-    jtd->setAddress(info->tableBase);
+    auto jtd = new JumpTableDescriptor(function, instruction);
+    jtd->setAddress(tableBase);
     Link *link = nullptr;
-    if(info->tableBase == info->targetBase) {
-        link = LinkFactory::makeDataLink(module, info->targetBase, true);
+    if(tableBase == targetBase) {
+        link = LinkFactory::makeDataLink(module, targetBase, true);
     }
     else {
         // even for X86_64, jump table base != target base for hand-written
         // jump tables
-        auto function
-            = dynamic_cast<Function *>(instruction->getParent()->getParent());
-        auto target = ChunkFind().findInnermostAt(function, info->targetBase);
+        auto target = ChunkFind().findInnermostAt(function, targetBase);
         if(target) {
             link = LinkFactory::makeNormalLink(target, true, false);
         }
@@ -436,24 +506,15 @@ void JumptableDetection::makeDescriptor(Instruction *instruction,
     }
     assert(link);
     jtd->setTargetBaseLink(link);
-    jtd->setScale(info->scale);
-    jtd->setEntries(info->entries);
+    jtd->setScale(scale);
 
     auto contentSection =
-        module->getDataRegionList()->findDataSectionContaining(info->tableBase);
+        module->getDataRegionList()->findDataSectionContaining(tableBase);
     assert(contentSection);
     jtd->setContentSection(contentSection);
     tableList.push_back(jtd);
-
-    LOG(10, "jump table jump at "
-        << std::hex << info->jumpState->getInstruction()->getAddress());
-    LOG(10, "descriptor:" << jtd);
-    LOG(10, "baseAddress = " << std::hex << info->tableBase);
-    LOG(10, "targetBaseAddress = " << std::hex << info->targetBase);
-    LOG(10, "scale = " << std::dec << info->scale);
-    LOG(10, "entries = " << std::dec << info->entries);
-
     tableMap[instruction].push_back(jtd);
+    return jtd;
 }
 
 bool JumptableDetection::parseTableAccess(UDState *state, int reg,
@@ -521,22 +582,20 @@ bool JumptableDetection::parseTableAccess(UDState *state, int reg,
         return false;
     };
 
+    auto formParser = [&](UDState *s, size_t form, TreeCapture& cap) {
+        LOG(10, "    trying TableAccessForm" << (form + 1));
+        return parser(s, cap);
+    };
+
     LOG(10, "[TableAccess] looking for reference in 0x" << std::hex
         << state->getInstruction()->getAddress()
         << " register " << std::dec << reg);
     IF_LOG(10) state->dumpState();
 
-    LOG(10, "    trying TableAccessForm1");
-    FlowUtil::searchUpDef<TableAccessForm1>(state, reg, parser);
-    if(found) {
-        return true;
-    }
-    LOG(10, "    trying TableAccessForm2");
-    FlowUtil::searchUpDef<TableAccessForm2>(state, reg, parser);
-    if(found) {
-        return true;
-    }
-    return false;
+    typedef TreePatternSet<TableAccessForm1, TableAccessForm2>
+        TableAccessForms;
+    FlowUtil::searchUpDefAny<TableAccessForms>(state, reg, formParser);
+    return found;
 #elif defined(ARCH_AARCH64)
     typedef TreePatternCapture<TreePatternUnary<TreeNodeDereference,
         TreePatternBinary<TreeNodeAddition,
@@ -577,18 +636,19 @@ bool JumptableDetection::parseTableAccess(UDState *state, int reg,
         return false;
     };
 
+    auto formParser = [&](UDState *s, size_t form, TreeCapture& cap) {
+        LOG(10, "    trying TableAccessForm" << (form + 1));
+        return parser(s, cap);
+    };
+
     LOG(10, "[TableAccess] looking for reference in 0x" << std::hex
         << state->getInstruction()->getAddress()
         << " register " << std::dec << reg);
     IF_LOG(10) state->dumpState();
 
-    LOG(10, "    trying TableAccessForm1");
-    FlowUtil::searchUpDef<TableAccessForm1>(state, reg, parser);
-    if(found) {
-        return true;
-    }
-    LOG(10, "    trying TableAccessForm2");
-    FlowUtil::searchUpDef<TableAccessForm2>(state, reg, parser);
+    typedef TreePatternSet<TableAccessForm1, TableAccessForm2>
+        TableAccessForms;
+    FlowUtil::searchUpDefAny<TableAccessForms>(state, reg, formParser);
     if(found) {
         return true;
     }
@@ -730,26 +790,31 @@ auto JumptableDetection::parseBaseAddress(UDState *state, int reg)
         TreePatternCapture<TreePatternTerminal<TreeNodeConstant>>
     > BaseAddressForm;
 
+    // in this order, as if each were searched for separately
+    typedef TreePatternSet<BaseAddressForm, SavedAddressForm,
+        MovedAddressForm> BaseAddressForms;
+
     address_t addr = 0;
     bool found = false;
-    auto parser = [&](UDState *s, TreeCapture& cap) {
-        auto ripTree = dynamic_cast<TreeNodeRegisterRIP *>(cap.get(0));
-        auto dispTree = dynamic_cast<TreeNodeConstant *>(cap.get(1));
-        addr = dispTree->getValue() + ripTree->getValue();
-        found = true;
-        return true;
+    auto parser = [&](UDState *s, size_t form, TreeCapture& cap) {
+        switch(form) {
+        case 0: {
+            auto ripTree = dynamic_cast<TreeNodeRegisterRIP *>(cap.get(0));
+            auto dispTree = dynamic_cast<TreeNodeConstant *>(cap.get(1));
+            addr = dispTree->getValue() + ripTree->getValue();
+            found = true;
+            break;
+        }
+        case 1:
+            found = matchSavedAddress(s, reg, cap, addr);
+            break;
+        default:
+            found = matchMovedAddress(s, cap, addr);
+            break;
+        }
+        return found;
     };
-    FlowUtil::searchUpDef<BaseAddressForm>(state, reg, parser);
-    if(found) {
-        return std::make_tuple(true, addr);
-    }
-
-    std::tie(found, addr) = parseSavedAddress(state, reg);
-    if(found) {
-        return std::make_tuple(true, addr);
-    }
-
-    std::tie(found, addr) = parseMovedAddress(state, reg);
+    FlowUtil::searchUpDefAny<BaseAddressForms>(state, reg, parser);
     if(found) {
         return std::make_tuple(true, addr);
     }
@@ -824,55 +889,57 @@ auto JumptableDetection::parseBaseAddress(UDState *state, int reg)
 auto JumptableDetection::parseSavedAddress(UDState *state, int reg)
     -> std::tuple<bool, address_t> {
 
-    typedef TreePatternUnary<TreeNodeDereference,
-        TreePatternCapture<TreePatternBinary<TreeNodeAddition,
-            TreePatternTerminal<TreeNodePhysicalRegister>,
-            TreePatternTerminal<TreeNodeConstant>>
-        >
-    > LoadForm;
-
     address_t addr = 0;
     bool found = false;
     auto parser = [&](UDState *s, TreeCapture& cap) {
-        MemLocation loadLoc(cap.get(0));
-        for(auto& ss : s->getMemRef(reg)) {
-            for(const auto& mem : ss->getMemDefList()) {
-                MemLocation storeLoc(mem.second);
-                if(loadLoc == storeLoc) {
-                    address_t address;
-                    std::tie(found, address) = parseBaseAddress(ss, mem.first);
-                    if(found) {
-                        addr = address;
-                        return true;
-                    }
+        found = matchSavedAddress(s, reg, cap, addr);
+        return found;
+    };
+    FlowUtil::searchUpDef<SavedAddressForm>(state, reg, parser);
+    return std::make_tuple(found, addr);
+}
+
+bool JumptableDetection::matchSavedAddress(UDState *state, int reg,
+    TreeCapture& cap, address_t &addr) {
+
+    MemLocation loadLoc(cap.get(0));
+    for(auto& ss : state->getMemRef(reg)) {
+        for(const auto& mem : ss->getMemDefList()) {
+            MemLocation storeLoc(mem.second);
+            if(loadLoc == storeLoc) {
+                bool found;
+                address_t address;
+                std::tie(found, address) = parseBaseAddress(ss, mem.first);
+                if(found) {
+                    addr = address;
+                    return true;
                 }
             }
         }
-        return false;
-    };
-    FlowUtil::searchUpDef<LoadForm>(state, reg, parser);
-    return std::make_tuple(found, addr);
+    }
+    return false;
+}
+
+bool JumptableDetection::matchMovedAddress(UDState *state, TreeCapture& cap,
+    address_t &addr) {
+
+    auto regTree = dynamic_cast<TreeNodePhysicalRegister *>(cap.get(0));
+    bool found;
+    std::tie(found, addr) = parseBaseAddress(state, regTree->getRegister());
+    return found;
 }
 
 auto JumptableDetection::parseMovedAddress(UDState *state, int reg)
     -> std::tuple<bool, address_t> {
 
 #ifdef ARCH_X86_64
-    typedef TreePatternCapture<TreePatternTerminal<TreeNodePhysicalRegister>
-    > MoveForm;
-
     address_t addr = 0;
     bool found = false;
     auto parser = [&](UDState *s, TreeCapture& cap) {
-        auto regTree = dynamic_cast<TreeNodePhysicalRegister *>(cap.get(0));
-        std::tie(found, addr) = parseBaseAddress(s, regTree->getRegister());
-        if(found) {
-            found = true;
-            return true;
-        }
-        return false;
+        found = matchMovedAddress(s, cap, addr);
+        return found;
     };
-    FlowUtil::searchUpDef<MoveForm>(state, reg, parser);
+    FlowUtil::searchUpDef<MovedAddressForm>(state, reg, parser);
     return std::make_tuple(found, addr);
 #elif defined(ARCH_AARCH64)
     return std::make_tuple(false, 0);
@@ -936,6 +1003,9 @@ void JumptableDetection::collectJumpsTo(UDState *state, JumptableInfo *info,
 bool JumptableDetection::parseBound(UDState *state, int reg,
     JumptableInfo *info) {
 
+    // out of budget: the table keeps unknown entries, to be overestimated
+    if(!AnalysisBudget::spend()) return false;
+
 #ifdef ARCH_X86_64
     typedef TreePatternBinary<TreeNodeComparison,
         TreePatternCapture<TreePatternTerminal<TreeNodePhysicalRegister>>,
@@ -41,22 +41,44 @@ private:
             : scale(scale), entries(entries) {}
     };
 
+    // a table found while detecting in parallel, made in function order
+    struct PendingDescriptor {
+        Instruction *instruction;
+        JumptableInfo info;
+
+        PendingDescriptor(Instruction *instruction, const JumptableInfo &info)
+            : instruction(instruction), info(info) {}
+    };
+
     Module *module;
+    std::vector<PendingDescriptor> *pendingList;
     std::vector<JumpTableDescriptor *> tableList;
     std::map<Instruction *, std::vector<JumpTableDescriptor *>> tableMap;
+    std::set<Function *> skipSet;
 
     // keeps track of index table for performance and correct analysis
     // because the non-first use of index table requires complex analysis
     std::map<address_t /* index table base */, IndextableInfo> indexTables;
 
 public:
-    JumptableDetection(Module *module) : module(module) {}
+    JumptableDetection(Module *module) : module(module), pendingList(nullptr) {}
+
+    /** Functions are analyzed on a ThreadPool when EGALITO_THREADS is set.
+        The resulting descriptors are then created in function order, so
+        the output is the same as a serial run. Index tables found by one
+        function are only shared with the others on the next call. */
     void detect(Module *module);
     void detect(Function *function);
     void detect(UDRegMemWorkingSet *working);
     const std::vector<JumpTableDescriptor *> &getTableList() const
         { return tableList; }
 
+    /** Adds a table that is already known, e.g. from FunctionAnalysisCache. */
+    void addDescriptor(Function *function, Instruction *instruction,
+        address_t tableBase, address_t targetBase, int scale, long bound);
+    /** Leaves function out of detect(Module *), since its tables are known. */
+    void skipFunction(Function *function) { skipSet.insert(function); }
+
 private:
     bool containsIndirectJump(Function *function) const;
     bool parseJumptable(UDState *state, TreeCapture& cap, JumptableInfo *info);
@@ -64,11 +86,18 @@ private:
     bool parseJumptableWithIndexTable(UDState *state, int reg,
         JumptableInfo *info);
     void makeDescriptor(Instruction *instruction, const JumptableInfo *info);
+    JumpTableDescriptor *makeDescriptor(Function *function,
+        Instruction *instruction, address_t tableBase, address_t targetBase,
+        size_t scale);
 
     bool parseTableAccess(UDState *state, int reg, JumptableInfo *info);
     std::tuple<bool, address_t> parseBaseAddress(UDState *state, int reg);
     std::tuple<bool, address_t> parseSavedAddress(UDState *state, int reg);
     std::tuple<bool, address_t> parseMovedAddress(UDState *state, int reg);
+    bool matchSavedAddress(UDState *state, int reg, TreeCapture& cap,
+        address_t &addr);
+    bool matchMovedAddress(UDState *state, TreeCapture& cap,
+        address_t &addr);
     std::tuple<bool, address_t> parseComputedAddress(UDState *state, int reg);
 
     bool parseBound(UDState *state, int reg, JumptableInfo *info);
@@ -1,4 +1,5 @@
 #include "liveregister.h"
+#include "analysis/analysiscache.h"
 #include "analysis/usedef.h"
 #include "analysis/walker.h"
 #include "analysis/controlflow.h"
@@ -27,15 +28,8 @@ LiveInfo LiveRegister::getInfo(UDRegMemWorkingSet *working) {
 }
 
 void LiveRegister::detect(Function *function) {
-    ControlFlowGraph cfg(function);
-    UDConfiguration config(&cfg);
-    UDRegMemWorkingSet working(function, &cfg);
-    UseDef usedef(&config, &working);
-
-    SccOrder order(&cfg);
-    order.genFull(0);
-    usedef.analyze(order.get());
-    detect(&working);
+    auto analysis = AnalysisCache::getInstance()->get(function);
+    detect(analysis->getWorkingSet());
 }
 
 void LiveRegister::detect(UDRegMemWorkingSet *working) {
@@ -91,3 +85,288 @@ void LiveInfo::live(int reg) {
         regs[reg] = 1;
     }
 }
+
+#ifdef ARCH_X86_64
+#include "analysis/worklist.h"
+#include "instr/concrete.h"
+
+#define LIVE_REG(id)    (RegSet().set(X86Register::id))
+
+RegisterLiveness::RegisterLiveness(Function *function) {
+    ControlFlowGraph graph(function);
+    const size_t count = graph.getCount();
+    blockList.resize(count);
+    liveBefore.resize(count);
+    liveOut.resize(count);
+    exitLive.resize(count);
+
+    std::vector<std::vector<InstrFacts>> facts(count);
+    for(size_t id = 0; id < count; id ++) {
+        auto block = graph.get(id)->getBlock();
+        blockList[id] = block;
+        size_t index = 0;
+        for(auto instr : CIter::children(block)) {
+            facts[id].push_back(getFacts(instr));
+            position[instr] = std::make_pair(static_cast<int>(id), index ++);
+        }
+        liveBefore[id].resize(index);
+        exitLive[id] = getExitLive(function, block);
+    }
+
+    // a backward problem: visit blocks roughly from the end
+    std::vector<std::vector<int>> order{{}};
+    for(size_t id = count; id > 0; id --) {
+        order[0].push_back(static_cast<int>(id - 1));
+    }
+
+    // every set only grows, and there are 17 registers to add, so this
+    // bound is never what stops the solver
+    WorklistSolver<-1> solver(&graph, order, RegSet().size() + 2);
+    solver.solve([&] (int id) { return transfer(&graph, id, facts); });
+}
+
+bool RegisterLiveness::transfer(ControlFlowGraph *graph, int id,
+    const std::vector<std::vector<InstrFacts>> &facts) {
+
+    RegSet live = exitLive[id];
+    for(auto link : graph->get(id)->forwardLinks()) {
+        auto cflink = static_cast<ControlFlowLink *>(&*link);
+        live |= getLiveAtOffset(cflink->getTargetID(), cflink->getOffset());
+    }
+    bool changed = (liveOut[id] != live);
+    liveOut[id] = live;
+
+    auto &before = liveBefore[id];
+    for(size_t i = facts[id].size(); i > 0; i --) {
+        const auto &f = facts[id][i - 1];
+        live = f.use | (live & ~f.def);
+        if(before[i - 1] != live) {
+            before[i - 1] = live;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+auto RegisterLiveness::getLiveAtOffset(int id, int offset) const -> RegSet {
+    if(liveBefore[id].empty()) return liveOut[id];
+    if(offset == 0) return liveBefore[id][0];
+
+    auto block = blockList[id];
+    size_t index = 0;
+    for(auto instr : CIter::children(block)) {
+        if(static_cast<int>(instr->getAddress() - block->getAddress())
+            == offset) {
+
+            return liveBefore[id][index];
+        }
+        index ++;
+    }
+    return RegSet().set();
+}
+
+LiveInfo RegisterLiveness::getLiveBefore(Instruction *instruction) const {
+    auto it = position.find(instruction);
+    if(it == position.end()) return LiveInfo();
+
+    return LiveInfo(liveBefore[it->second.first][it->second.second]);
+}
+
+LiveInfo RegisterLiveness::getLiveAfter(Instruction *instruction) const {
+    auto it = position.find(instruction);
+    if(it == position.end()) return LiveInfo();
+
+    auto id = it->second.first;
+    auto next = it->second.second + 1;
+    if(next < liveBefore[id].size()) return LiveInfo(liveBefore[id][next]);
+    return LiveInfo(liveOut[id]);
+}
+
+int RegisterLiveness::getRegisterID(int capstoneReg) {
+    if(capstoneReg == X86_REG_EFLAGS) return X86Register::FLAGS;
+    return X86Register::convertToPhysical(capstoneReg);
+}
+
+auto RegisterLiveness::getFacts(Instruction *instruction) -> InstrFacts {
+    const RegSet everything = RegSet().set();
+    const RegSet args = LIVE_REG(R7) | LIVE_REG(R6) | LIVE_REG(R2) | LIVE_REG(R1) | LIVE_REG(R8)
+        | LIVE_REG(R9) | LIVE_REG(R0) | LIVE_REG(SP);  // with %al for varargs
+    const RegSet returned = LIVE_REG(R0) | LIVE_REG(R2) | LIVE_REG(R3) | LIVE_REG(BP)
+        | LIVE_REG(R12) | LIVE_REG(R13) | LIVE_REG(R14) | LIVE_REG(R15) | LIVE_REG(SP);
+
+    InstrFacts facts;
+    auto semantic = instruction->getSemantic();
+    if(auto cfi = dynamic_cast<ControlFlowInstructionBase *>(semantic)) {
+        // direct calls and jumps carry no assembly
+        if(cfi->getMnemonic() == "callq") facts.use = args;
+        else if(cfi->getMnemonic() != "jmp") {
+            facts.use = LIVE_REG(FLAGS) | LIVE_REG(R1);  // jcc, or jrcxz and loop
+        }
+        return facts;
+    }
+
+    auto assembly = semantic->getAssembly();
+    if(!assembly) {
+        facts.use = everything;
+        return facts;
+    }
+    if(dynamic_cast<ReturnInstruction *>(semantic)) {
+        facts.use = returned;
+        return facts;
+    }
+
+    auto id = assembly->getId();
+    auto operands = assembly->getAsmOperands();
+    auto op = operands->getOperands();
+    size_t opCount = operands->getOpCount();
+
+    auto addUse = [&] (int capstoneReg) {
+        auto reg = getRegisterID(capstoneReg);
+        if(reg != X86Register::INVALID) facts.use.set(reg);
+    };
+    for(size_t i = 0; i < opCount; i ++) {
+        if(op[i].type == X86_OP_REG) addUse(op[i].reg);
+        else if(op[i].type == X86_OP_MEM) {
+            addUse(op[i].mem.base);
+            addUse(op[i].mem.index);
+        }
+    }
+    for(size_t i = 0; i < assembly->getImplicitRegsReadCount(); i ++) {
+        addUse(assembly->getImplicitRegsRead()[i]);
+    }
+
+    switch(id) {
+    case X86_INS_CALL:
+        facts.use |= args;
+        break;
+    case X86_INS_SYSCALL:
+        facts.use |= LIVE_REG(R0) | LIVE_REG(R7) | LIVE_REG(R6) | LIVE_REG(R2) | LIVE_REG(R10)
+            | LIVE_REG(R8) | LIVE_REG(R9);
+        facts.def = LIVE_REG(R1) | LIVE_REG(R11);
+        facts.use &= ~facts.def;
+        break;
+    default:
+        break;
+    }
+
+    // in AT&T order the destination is the last operand
+    const auto &last = op[opCount ? opCount - 1 : 0];
+    int dest = X86Register::INVALID;
+    if(opCount && last.type == X86_OP_REG) {
+        auto reg = getRegisterID(last.reg);
+        // 32-bit writes zero the upper half, narrower ones merge
+        if(X86Register::isInteger(reg)
+            && X86Register::getWidth(reg, last.reg) >= 4) {
+
+            dest = reg;
+        }
+    }
+
+    switch(id) {
+    case X86_INS_MOV:
+    case X86_INS_MOVABS:
+    case X86_INS_MOVZX:
+    case X86_INS_MOVSX:
+    case X86_INS_MOVSXD:
+    case X86_INS_LEA:
+        if(dest != X86Register::INVALID) {
+            bool reads = false;
+            for(size_t i = 0; i + 1 < opCount; i ++) {
+                if(op[i].type == X86_OP_REG
+                    && getRegisterID(op[i].reg) == dest) reads = true;
+                if(op[i].type == X86_OP_MEM
+                    && (getRegisterID(op[i].mem.base) == dest
+                        || getRegisterID(op[i].mem.index) == dest)) {
+
+                    reads = true;
+                }
+            }
+            if(!reads) {
+                facts.use.reset(dest);
+                facts.def.set(dest);
+            }
+        }
+        break;
+    case X86_INS_XOR:
+    case X86_INS_SUB:
+        // zeroing idiom: xor %eax, %eax
+        if(dest != X86Register::INVALID && opCount == 2
+            && op[0].type == X86_OP_REG && op[0].reg == last.reg) {
+
+            facts.use.reset(dest);
+            facts.def.set(dest);
+        }
+        break;
+    default:
+        break;
+    }
+
+    switch(id) {
+    case X86_INS_ADD:
+    case X86_INS_SUB:
+    case X86_INS_AND:
+    case X86_INS_OR:
+    case X86_INS_XOR:
+    case X86_INS_CMP:
+    case X86_INS_TEST:
+    case X86_INS_NEG:
+        facts.def.set(X86Register::FLAGS);
+        break;
+    case X86_INS_ADC:
+    case X86_INS_SBB:
+        facts.use.set(X86Register::FLAGS);
+        facts.def.set(X86Register::FLAGS);
+        break;
+    default:
+        // capstone lists EFLAGS for jcc, setcc, cmovcc and pushf; this
+        // catches any it misses
+        if(assembly->getMnemonic()[0] == 'j'
+            || !assembly->getMnemonic().compare(0, 3, "set")
+            || !assembly->getMnemonic().compare(0, 4, "cmov")
+            || !assembly->getMnemonic().compare(0, 5, "pushf")
+            || assembly->getMnemonic() == "lahf") {
+
+            facts.use.set(X86Register::FLAGS);
+        }
+        break;
+    }
+    return facts;
+}
+
+auto RegisterLiveness::getExitLive(Function *function, Block *block)
+    -> RegSet {
+
+    auto last = block->getChildren()->getIterable()->getLast();
+    if(!last) return RegSet().set();
+
+    auto semantic = last->getSemantic();
+    if(dynamic_cast<ReturnInstruction *>(semantic)) return RegSet();
+
+    if(auto cfi = dynamic_cast<ControlFlowInstruction *>(semantic)) {
+        if(cfi->getMnemonic() == "callq") {
+            // a non-returning call has no fall-through edge
+            return cfi->returns() ? RegSet() : RegSet().set();
+        }
+
+        // a tail call or a jump to a chunk outside this function
+        auto link = cfi->getLink();
+        auto target = link ? link->getTarget() : nullptr;
+        Chunk *parent = nullptr;
+        if(dynamic_cast<Block *>(target)) parent = target;
+        else if(target && dynamic_cast<Instruction *>(target)) {
+            parent = target->getParent();
+        }
+        if(!parent || parent->getParent() != function) {
+            return RegSet().set();
+        }
+        return RegSet();
+    }
+    if(auto ij = dynamic_cast<IndirectJumpInstruction *>(semantic)) {
+        if(ij->getMnemonic() == "callq") return RegSet();
+        return ij->isForJumpTable() ? RegSet() : RegSet().set();
+    }
+
+    // falls through; the edge is in the graph, unless this is the end
+    return block->getNextSibling() ? RegSet() : RegSet().set();
+}
+#endif
@@ -6,6 +6,9 @@
 #include "analysis/usedef.h"
 
 class Function;
+class Block;
+class ControlFlowGraph;
+class Instruction;
 class UDState;
 
 class LiveInfo {
@@ -14,6 +17,7 @@ private:
 
 public:
     LiveInfo() : regs(0xFFFFFFFF) {}
+    LiveInfo(const std::bitset<32> &regs) : regs(regs) {}
     void kill(int reg);
     void live(int reg);
     bool get(int reg) { return regs[reg]; }
@@ -32,4 +36,50 @@ public:
     void detect(UDRegMemWorkingSet *working);
 };
 
+#ifdef ARCH_X86_64
+#include <vector>
+#include <unordered_map>
+
+/** Registers live at each instruction of a Function, for code inserted
+    between instructions. Bits are X86Register IDs, with FLAGS for the
+    status flags.
+
+    This errs on the side of liveness. Every register an instruction
+    mentions is treated as read; only full-width writes by moves, lea and
+    the zeroing idioms end a live range (and flag writes by the arithmetic
+    instructions that set all status flags). Calls kill nothing, since
+    with interprocedural register allocation a caller may keep values in
+    caller-saved registers across a call to a known callee. Everything is
+    live where control leaves the function other than by a return, and
+    at instructions the analysis has not seen.
+*/
+class RegisterLiveness {
+private:
+    typedef std::bitset<32> RegSet;
+    struct InstrFacts {
+        RegSet use;
+        RegSet def;
+    };
+
+    std::vector<Block *> blockList;             // by node ID
+    std::vector<std::vector<RegSet>> liveBefore;  // by node, instruction
+    std::vector<RegSet> liveOut;                // by node
+    std::vector<RegSet> exitLive;               // by node
+    std::unordered_map<Instruction *, std::pair<int, size_t>> position;
+public:
+    RegisterLiveness(Function *function);
+
+    LiveInfo getLiveBefore(Instruction *instruction) const;
+    LiveInfo getLiveAfter(Instruction *instruction) const;
+
+    static int getRegisterID(int capstoneReg);
+private:
+    static InstrFacts getFacts(Instruction *instruction);
+    static RegSet getExitLive(Function *function, Block *block);
+    RegSet getLiveAtOffset(int id, int offset) const;
+    bool transfer(ControlFlowGraph *graph, int id,
+        const std::vector<std::vector<InstrFacts>> &facts);
+};
+#endif
+
 #endif
@@ -1,19 +1,23 @@
 #include <stdint.h>
 #include <cassert>
+#include <cstring>
 #include "pointerdetection.h"
 #include "analysis/slicingtree.h"
 #include "analysis/usedef.h"
 #include "analysis/walker.h"
 #include "chunk/concrete.h"
 #include "instr/isolated.h"
+#include "instr/register.h"
 #include "instr/linked-aarch64.h"
 #include "disasm/riscv-disas.h"
+#include "util/counter.h"
 
 #include "log/log.h"
 #include "log/temp.h"
 
 #if defined(ARCH_AARCH64) || defined(ARCH_RISCV)
 void PointerDetection::detect(Function *function, ControlFlowGraph *cfg) {
+    COUNTER_SCOPE(function);
     UDConfiguration config(cfg);
     UDRegMemWorkingSet working(function, cfg);
     UseDef usedef(&config, &working);
@@ -32,35 +36,35 @@ void PointerDetection::detect(UDRegMemWorkingSet *working) {
     IF_LOG(10) working->getCFG()->dumpDot();
 
     try {
-        for(auto block : CIter::children(working->getFunction())) {
-            for(auto instr : CIter::children(block)) {
-                auto semantic = instr->getSemantic();
-                if(dynamic_cast<LinkedInstruction *>(semantic)) continue;
-                if(dynamic_cast<LiteralInstruction *>(semantic)) continue;
-
-                auto link = semantic->getLink();
-                if(link && !dynamic_cast<UnresolvedLink *>(link)) continue;
-                auto assembly = semantic->getAssembly();
-                if(!assembly) continue;
+        CIter::forEachInstruction(working->getFunction(),
+            [&] (Instruction *instr) {
+
+            // the assembly checks are cheaper than the dynamic_casts
+            auto semantic = instr->getSemantic();
+            auto assembly = semantic->getAssembly();
+            if(!assembly) return;
+            auto link = semantic->getLink();
+            if(link && !dynamic_cast<UnresolvedLink *>(link)) return;
+            if(dynamic_cast<LinkedInstruction *>(semantic)) return;
+            if(dynamic_cast<LiteralInstruction *>(semantic)) return;
 #ifdef ARCH_AARCH64
-                if(assembly->getId() == ARM64_INS_LDR) {
-                    if((assembly->getBytes()[3] & 0xBF) == 0x18) {
-                        detectAtLDR(working->getState(instr));
-                    }
-                }
-                else if(assembly->getId() == ARM64_INS_ADR) {
-                    detectAtADR(working->getState(instr));
-                }
-                else if(assembly->getId() == ARM64_INS_ADRP) {
-                    detectAtADRP(working->getState(instr));
+            if(assembly->getId() == ARM64_INS_LDR) {
+                if((assembly->getBytes()[3] & 0xBF) == 0x18) {
+                    detectAtLDR(working->getState(instr));
                 }
+            }
+            else if(assembly->getId() == ARM64_INS_ADR) {
+                detectAtADR(working->getState(instr));
+            }
+            else if(assembly->getId() == ARM64_INS_ADRP) {
+                detectAtADRP(working->getState(instr));
+            }
 #elif defined(ARCH_RISCV)
-                if(assembly->getId() == rv_op_auipc) {
-                    detectAtAUIPC(working->getState(instr));
-                }
-#endif
+            if(assembly->getId() == rv_op_auipc) {
+                detectAtAUIPC(working->getState(instr));
             }
-        }
+#endif
+        });
     }
     catch(const char *s) {
         working->getCFG()->dumpDot();
@@ -70,6 +74,146 @@ void PointerDetection::detect(UDRegMemWorkingSet *working) {
 }
 
 #ifdef ARCH_AARCH64
+bool PointerDetection::detectLocal(Function *function) {
+    std::vector<std::pair<Instruction *, address_t>> found;
+    for(auto block : CIter::children(function)) {
+        if(!detectLocal(block, found)) return false;
+    }
+    pointerList.insert(pointerList.end(), found.begin(), found.end());
+    return true;
+}
+
+bool PointerDetection::detectLocal(Block *block,
+    std::vector<std::pair<Instruction *, address_t>> &found) {
+
+    // pages loaded by ADRP that are still live, keyed by register
+    struct PendingPage {
+        Instruction *adrp;
+        address_t page;
+        bool hasOffset;
+        int64_t offset;
+        std::vector<Instruction *> userList;
+    };
+    const int REGISTERS = AARCH64GPRegister::R31 + 1;
+    PendingPage table[REGISTERS];
+    bool valid[REGISTERS] = {};
+
+    auto finish = [&] (int reg) {
+        if(!valid[reg]) return;
+        valid[reg] = false;
+        auto &pending = table[reg];
+        if(pending.userList.empty()) return;
+        for(auto user : pending.userList) {
+            found.emplace_back(user, pending.page + pending.offset);
+        }
+        found.emplace_back(pending.adrp, pending.page + pending.offset);
+    };
+    auto addUse = [&] (int reg, Instruction *instr, int64_t offset) {
+        auto &pending = table[reg];
+        if(pending.hasOffset && pending.offset != offset) return false;
+        pending.hasOffset = true;
+        pending.offset = offset;
+        pending.userList.push_back(instr);
+        return true;
+    };
+    auto isPending = [&] (int capstoneReg) {
+        int reg = AARCH64GPRegister::convertToPhysical(capstoneReg);
+        return 0 <= reg && reg < REGISTERS && valid[reg];
+    };
+    auto anyPending = [&] () {
+        for(int reg = 0; reg < REGISTERS; reg ++) {
+            if(valid[reg]) return true;
+        }
+        return false;
+    };
+
+    for(auto instr : CIter::children(block)) {
+        auto semantic = instr->getSemantic();
+        auto assembly = semantic->getAssembly();
+        if(!assembly) continue;
+
+        // same conditions as detect() for instructions that make pointers
+        auto link = semantic->getLink();
+        bool isSource = !(link && !dynamic_cast<UnresolvedLink *>(link))
+            && !dynamic_cast<LinkedInstruction *>(semantic)
+            && !dynamic_cast<LiteralInstruction *>(semantic);
+
+        uint32_t bits;
+        std::memcpy(&bits, assembly->getBytes(), sizeof(bits));
+        auto ops = assembly->getAsmOperands()->getOperands();
+        int rd = bits & 0x1f;
+        int rn = (bits >> 5) & 0x1f;
+
+        if(assembly->getId() == ARM64_INS_ADRP) {
+            finish(rd);
+            if(isSource && rd != AARCH64GPRegister::R31) {
+                table[rd] = PendingPage{instr,
+                    static_cast<address_t>(ops[1].imm), false, 0, {}};
+                valid[rd] = true;
+            }
+            continue;
+        }
+        if(assembly->getId() == ARM64_INS_ADR
+            || (assembly->getId() == ARM64_INS_LDR
+                && (assembly->getBytes()[3] & 0xBF) == 0x18)) {
+
+            finish(rd);
+            if(isSource) {
+                found.emplace_back(instr, static_cast<address_t>(ops[1].imm));
+            }
+            continue;
+        }
+        if((bits & 0xFFC00000) == 0x91000000) {
+            // add xd, xn, #imm (unshifted)
+            if(valid[rn] && !addUse(rn, instr, (bits >> 10) & 0xfff)) {
+                return false;
+            }
+            finish(rd);
+            continue;
+        }
+        if((bits & 0xBFC00000) == 0xB9400000
+            || (bits & 0xBFC00000) == 0xB9000000) {
+
+            // ldr/str wt or xt, [xn, #imm] (unsigned offset)
+            bool isLoad = (bits & 0x00400000);
+            int64_t offset = static_cast<int64_t>((bits >> 10) & 0xfff)
+                << ((bits >> 30) & 0x3);
+            if(!isLoad && valid[rd]) return false;  // page stored to memory
+            if(valid[rn] && !addUse(rn, instr, offset)) return false;
+            if(isLoad) finish(rd);
+            continue;
+        }
+
+        // any other reference to a pending page needs use-def
+        auto asmOps = assembly->getAsmOperands();
+        for(size_t i = 0; i < asmOps->getOpCount(); i ++) {
+            if(ops[i].type == ARM64_OP_REG && isPending(ops[i].reg)) {
+                return false;
+            }
+            if(ops[i].type == ARM64_OP_MEM && (isPending(ops[i].mem.base)
+                || isPending(ops[i].mem.index))) {
+
+                return false;
+            }
+        }
+        for(size_t i = 0; i < assembly->getImplicitRegsReadCount(); i ++) {
+            if(isPending(assembly->getImplicitRegsRead()[i])) return false;
+        }
+        for(size_t i = 0; i < assembly->getImplicitRegsWriteCount(); i ++) {
+            if(isPending(assembly->getImplicitRegsWrite()[i])) return false;
+        }
+        // calls take their arguments implicitly
+        if(dynamic_cast<ControlFlowInstruction *>(semantic)
+            || dynamic_cast<IndirectCallInstruction *>(semantic)) {
+
+            if(anyPending()) return false;
+        }
+    }
+
+    // a page still live here may be used in another block
+    return !anyPending();
+}
+
 void PointerDetection::detectAtLDR(UDState *state) {
     for(auto& def : state->getRegDefList()) {
         if(auto tree = dynamic_cast<TreeNodeAddress *>(def.second)) {
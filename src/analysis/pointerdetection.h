@@ -7,6 +7,7 @@
 #include "analysis/controlflow.h"
 #include "analysis/slicingmatch.h"
 
+class Block;
 class Function;
 class Instruction;
 class UDState;
@@ -20,12 +21,22 @@ public:
     PointerDetection() {}
     void detect(Function *function, ControlFlowGraph *cfg);
     void detect(UDRegMemWorkingSet *working);
+#ifdef ARCH_AARCH64
+    /** Finds pointers without use-def analysis, for functions where every
+        ADRP is consumed by ADD or LDR/STR offsets within its own block
+        before the register is overwritten. Returns false, adding nothing,
+        if any pair may span blocks; detect() is needed then.
+    */
+    bool detectLocal(Function *function);
+#endif
 
     const std::vector<std::pair<Instruction *, address_t>> getList() const
         { return pointerList; }
 
 private:
     #ifdef ARCH_AARCH64
+    bool detectLocal(Block *block,
+        std::vector<std::pair<Instruction *, address_t>> &found);
     void detectAtLDR(UDState *state);
     void detectAtADR(UDState *state);
     void detectAtADRP(UDState *state);
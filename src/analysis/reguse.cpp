@@ -12,95 +12,78 @@
 #include "log/log.h"
 
 #ifdef ARCH_AARCH64
-AARCH64RegisterUsageX::AARCH64RegisterUsageX(Function *function,
-    AARCH64GPRegister::ID id) : function(function), regX(id, true) {
+AARCH64RegisterMasks::AARCH64RegisterMasks(Function *function) {
+    auto toBit = [] (unsigned int reg) -> uint64_t {
+        int id = PhysicalRegister<AARCH64GPRegister>(reg, false).id();
+        if(id < 0 || id >= AARCH64GPRegister::REGISTER_NUMBER) return 0;
+        return bit(id);
+    };
 
     for(auto block : function->getChildren()->getIterable()->iterable()) {
         for(auto ins : block->getChildren()->getIterable()->iterable()) {
-            if(auto assembly = ins->getSemantic()->getAssembly()) {
-                auto asmOps = assembly->getAsmOperands();
-                for(size_t i = 0; i < asmOps->getOpCount(); ++i) {
-                    auto& op = asmOps->getOperands()[i];
-                    if(op.type == ARM64_OP_REG) {
-                        if(AARCH64GPRegister(op.mem.base, false).id() == id) {
-                            xList.push_back(ins);
-                            break;
-                        }
-                    }
-                    if(op.type == ARM64_OP_MEM) {
-                        if(AARCH64GPRegister(op.mem.base, false).id() == id) {
-                            xList.push_back(ins);
-                            break;
-                        }
-                        if(AARCH64GPRegister(op.mem.index, false).id() == id) {
-                            xList.push_back(ins);
-                            break;
-                        }
-                    }
+            auto assembly = ins->getSemantic()->getAssembly();
+            if(!assembly) continue;
+
+            Masks masks{ins, 0, 0};
+            auto asmOps = assembly->getAsmOperands();
+            for(size_t i = 0; i < asmOps->getOpCount(); ++i) {
+                auto& op = asmOps->getOperands()[i];
+                if(op.type == ARM64_OP_REG) {
+                    masks.regMask |= toBit(op.reg);
+                }
+                else if(op.type == ARM64_OP_MEM) {
+                    masks.memMask |= toBit(op.mem.base) | toBit(op.mem.index);
                 }
             }
+            maskList.push_back(masks);
         }
     }
 }
 
-std::vector<bool> AARCH64RegisterUsageX::getUnusableRegister() {
-    bool unusable[AARCH64GPRegister::REGISTER_NUMBER];
-    for(size_t i = 0; i < AARCH64GPRegister::REGISTER_NUMBER; ++i) {
-        unusable[i] = false;
-    }
-    for(auto ins : xList) {
-        if(auto assembly = ins->getSemantic()->getAssembly()) {
-            auto asmOps = assembly->getAsmOperands();
-            bool withX = false;
-            std::vector<int> regOperands;
-            for(size_t i = 0; i < asmOps->getOpCount(); ++i) {
-                if(asmOps->getOperands()[i].type == ARM64_OP_REG) {
-                    int id = PhysicalRegister<AARCH64GPRegister>(
-                        asmOps->getOperands()[i].reg, false).id();
+AARCH64RegisterUsageX::AARCH64RegisterUsageX(Function *function,
+    AARCH64GPRegister::ID id) : function(function), regX(id, true) {
 
-                    if(id == AARCH64GPRegister::INVALID) continue;
-                    if(id == regX.id()) {
-                        withX = true;
-                    }
-                    regOperands.push_back(id);
-                }
+    build(AARCH64RegisterMasks(function));
+}
 
-                if(withX) {
-                    for(auto rid : regOperands) {
-                        unusable[rid] = true;
-                    }
-                }
-            }
-        }
+AARCH64RegisterUsageX::AARCH64RegisterUsageX(Function *function,
+    AARCH64GPRegister::ID id, const AARCH64RegisterMasks &masks)
+    : function(function), regX(id, true) {
+
+    build(masks);
+}
+
+void AARCH64RegisterUsageX::build(const AARCH64RegisterMasks &masks) {
+    // registers named next to X in the same instruction can't stand in for X
+    auto x = AARCH64RegisterMasks::bit(regX.id());
+    unusable = 0;
+    for(const auto &m : masks.getList()) {
+        if((m.regMask | m.memMask) & x) xList.push_back(m.instruction);
+        if(m.regMask & x) unusable |= m.regMask;
     }
+}
 
-    return std::vector<bool>(unusable,
-                             unusable + AARCH64GPRegister::REGISTER_NUMBER);
+std::vector<bool> AARCH64RegisterUsageX::getUnusableRegister() {
+    std::vector<bool> list(AARCH64GPRegister::REGISTER_NUMBER);
+    for(size_t i = 0; i < list.size(); ++i) {
+        list[i] = (unusable & AARCH64RegisterMasks::bit(i)) != 0;
+    }
+    return list;
 }
 
 std::vector<int> AARCH64RegisterUsage::getAllUseCounts(Function *function) {
-    int use_count[AARCH64GPRegister::REGISTER_NUMBER];
-    for(size_t i = 0; i < AARCH64GPRegister::REGISTER_NUMBER; ++i) {
-        use_count[i] = 0;
-    }
+    return getAllUseCounts(AARCH64RegisterMasks(function));
+}
 
-    for(auto block : function->getChildren()->getIterable()->iterable()) {
-        for(auto ins : block->getChildren()->getIterable()->iterable()) {
-            if(auto assembly = ins->getSemantic()->getAssembly()) {
-                auto asmOps = assembly->getAsmOperands();
-                for(size_t i = 0; i < asmOps->getOpCount(); ++i) {
-                    if(asmOps->getOperands()[i].type == ARM64_OP_REG) {
-                        int id = PhysicalRegister<AARCH64GPRegister>(
-                            asmOps->getOperands()[i].reg, false).id();
+std::vector<int> AARCH64RegisterUsage::getAllUseCounts(
+    const AARCH64RegisterMasks &masks) {
 
-                        if(id == AARCH64GPRegister::INVALID) continue;
-                        ++use_count[id];
-                    }
-                }
-            }
+    std::vector<int> count(AARCH64GPRegister::REGISTER_NUMBER);
+    for(const auto &m : masks.getList()) {
+        for(uint64_t bits = m.regMask; bits; bits &= bits - 1) {
+            ++count[__builtin_ctzll(bits)];
         }
     }
-    return std::vector<int>(use_count,
-                            use_count + AARCH64GPRegister::REGISTER_NUMBER);
+    return count;
 }
 #endif
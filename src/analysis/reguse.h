@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <bitset>
+#include <cstdint>
 
 #include "instr/register.h"
 
@@ -10,25 +11,52 @@ class Function;
 class Instruction;
 
 #ifdef ARCH_AARCH64
+/** The registers each instruction of a function names in its operands,
+    one bit per AARCH64GPRegister ID. Computed with a single walk over the
+    operands, so several usage queries can share it.
+*/
+class AARCH64RegisterMasks {
+public:
+    struct Masks {
+        Instruction *instruction;
+        uint64_t regMask;   // register operands
+        uint64_t memMask;   // base and index registers of memory operands
+    };
+private:
+    std::vector<Masks> maskList;
+public:
+    AARCH64RegisterMasks(Function *function);
+
+    const std::vector<Masks> &getList() const { return maskList; }
+    static uint64_t bit(int id) { return 1ull << id; }
+};
+
 class AARCH64RegisterUsageX {
 private:
     Function *function;
     PhysicalRegister<AARCH64GPRegister> regX;
 
     std::vector<Instruction *> xList;
+    uint64_t unusable;
 
 public:
     AARCH64RegisterUsageX(Function *function, AARCH64GPRegister::ID id);
+    AARCH64RegisterUsageX(Function *function, AARCH64GPRegister::ID id,
+        const AARCH64RegisterMasks &masks);
 
     std::vector<Instruction *> getInstructionList() const { return xList; }
     std::vector<bool> getUnusableRegister();
+private:
+    void build(const AARCH64RegisterMasks &masks);
 };
 
 class AARCH64RegisterUsage {
 public:
     AARCH64RegisterUsage() {}
 
+    /** Number of instructions naming each register as an operand. */
     std::vector<int> getAllUseCounts(Function *function);
+    std::vector<int> getAllUseCounts(const AARCH64RegisterMasks &masks);
 };
 #endif
 
@@ -1,4 +1,5 @@
 #include "savedregister.h"
+#include "analysis/analysiscache.h"
 #include "analysis/usedef.h"
 #include "analysis/walker.h"
 #include "analysis/controlflow.h"
@@ -14,16 +15,8 @@
 #ifdef ARCH_AARCH64
 
 std::vector<int> SavedRegister::getList(Function *function) {
-    ControlFlowGraph cfg(function);
-    UDConfiguration config(&cfg);
-    UDRegMemWorkingSet working(function, &cfg);
-    UseDef usedef(&config, &working);
-
-    SccOrder order(&cfg);
-    order.genFull(0);
-    usedef.analyze(order.get());
-
-    return getList(&working);
+    auto analysis = AnalysisCache::getInstance()->get(function);
+    return getList(analysis->getWorkingSet());
 }
 
 std::vector<int> SavedRegister::getList(UDRegMemWorkingSet *working) {
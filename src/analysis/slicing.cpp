@@ -8,6 +8,7 @@
 #include "instr/memory.h"
 #include "disasm/dump.h"
 #include "util/timing.h"
+#include "util/counter.h"
 #include "log/log.h"
 
 //#define ENABLE_SLICING_DEBUG
@@ -493,16 +494,16 @@ TreeNode *SlicingUtilities::makeMemTree(SearchState *state,
     if(mem->index != X86_REG_INVALID) {
         tree = getParentRegTree(state, mem->index);
         if(mem->scale != 1) {
-            tree = TreeFactory::instance().make<TreeNodeMultiplication>(
+            tree = TreeFactory::instance().makeShared<TreeNodeMultiplication>(
                 tree,
-                TreeFactory::instance().make<TreeNodeConstant>(mem->scale));
+                TreeFactory::instance().makeShared<TreeNodeConstant>(mem->scale));
         }
     }
 
     TreeNode *baseTree = getParentRegTree(state, mem->base);
     if(mem->base != X86_REG_INVALID) {
         if(tree) {
-            tree = TreeFactory::instance().make<TreeNodeAddition>(baseTree, tree);
+            tree = TreeFactory::instance().makeShared<TreeNodeAddition>(baseTree, tree);
         }
         else {
             tree = baseTree;
@@ -511,11 +512,11 @@ TreeNode *SlicingUtilities::makeMemTree(SearchState *state,
 
     if(mem->disp) {
         if(tree) {
-            tree = TreeFactory::instance().make<TreeNodeAddition>(
-                TreeFactory::instance().make<TreeNodeAddress>(mem->disp), tree);
+            tree = TreeFactory::instance().makeShared<TreeNodeAddition>(
+                TreeFactory::instance().makeShared<TreeNodeAddress>(mem->disp), tree);
         }
         else {
-            tree = TreeFactory::instance().make<TreeNodeAddress>(mem->disp);
+            tree = TreeFactory::instance().makeShared<TreeNodeAddress>(mem->disp);
         }
     }
 
@@ -533,9 +534,9 @@ TreeNode *SlicingUtilities::makeMemTree(SearchState *state,
         tree = getParentRegTree(state, mem->index);
         if(sft_type != ARM64_SFT_INVALID) {
             if(sft_type  == ARM64_SFT_LSL) {
-                tree = TreeFactory::instance().make<TreeNodeLogicalShiftLeft>(
+                tree = TreeFactory::instance().makeShared<TreeNodeLogicalShiftLeft>(
                     tree,
-                    TreeFactory::instance().make<TreeNodeConstant>(sft_value));
+                    TreeFactory::instance().makeShared<TreeNodeConstant>(sft_value));
             }
         }
     }
@@ -543,22 +544,22 @@ TreeNode *SlicingUtilities::makeMemTree(SearchState *state,
     TreeNode *baseTree = getParentRegTree(state, mem->base);
     if(mem->base != ARM64_REG_INVALID) {    // should be there always
         if(tree) {
-            tree = TreeFactory::instance().make<TreeNodeAddition>(baseTree, tree);
+            tree = TreeFactory::instance().makeShared<TreeNodeAddition>(baseTree, tree);
         }
         else {
             tree = baseTree;
         }
     }
     if(tree) {
-        tree = TreeFactory::instance().make<TreeNodeAddition>(
+        tree = TreeFactory::instance().makeShared<TreeNodeAddition>(
             tree,
-            TreeFactory::instance().make<TreeNodeConstant>(mem->disp));
+            TreeFactory::instance().makeShared<TreeNodeConstant>(mem->disp));
     }
     else {
-        tree = TreeFactory::instance().make<TreeNodeConstant>(mem->disp);
+        tree = TreeFactory::instance().makeShared<TreeNodeConstant>(mem->disp);
     }
 
-    tree = TreeFactory::instance().make<TreeNodeDereference>(tree, width);
+    tree = TreeFactory::instance().makeShared<TreeNodeDereference>(tree, width);
     state->getIState()->setMemTree(tree);
 
     return tree;
@@ -569,7 +570,7 @@ TreeNode *SlicingUtilities::getParentRegTree(SearchState *state, int reg) {
     if(reg == X86_REG_RIP) {
         // evaluate the instruction pointer in-place
         auto i = state->getInstruction();
-        return TreeFactory::instance().make<TreeNodeRegisterRIP>(
+        return TreeFactory::instance().makeShared<TreeNodeRegisterRIP>(
             i->getAddress() + i->getSize());
     }
 #endif
@@ -658,6 +659,15 @@ void SlicingUtilities::copyParentMemTrees(SearchState *state) {
 }
 
 void SlicingSearch::sliceAt(Instruction *instruction, int reg) {
+    auto key = SliceKey(instruction, reg);
+    auto it = sliceMap.find(key);
+    if(it != sliceMap.end()) {
+        LOG(11, "reusing slice at " << instruction->getName());
+        initialState = it->second.initialState;
+        conditions = it->second.conditions;
+        return;
+    }
+
     auto block = dynamic_cast<Block *>(instruction->getParent());
     auto node = cfg->get(cfg->getIDFor(block));
     LOG(11, "begin slicing at " << instruction->getName());
@@ -665,8 +675,14 @@ void SlicingSearch::sliceAt(Instruction *instruction, int reg) {
     SearchState *startState = makeSearchState(node, instruction);
     startState->addReg(reg);
 
+    // states from earlier slices are kept, but not revisited
+    size_t first = stateList.size();
+    conditions.clear();
     buildStatePass(startState);
-    buildRegTreePass();
+    buildRegTreePass(first);
+
+    initialState = startState;
+    sliceMap[key] = SliceResult{startState, conditions};
 }
 
 void SlicingSearch::buildStatePass(SearchState *startState) {
@@ -742,11 +758,13 @@ void SlicingSearch::buildStatePass(SearchState *startState) {
     }
 }
 
-void SlicingSearch::buildRegTreePass() {
+void SlicingSearch::buildRegTreePass(size_t first) {
     //EgalitoTiming ttt("SlicingSearch::buildRegTreePass");
     LOG(11, "second pass iteration");
-    int index = (getStep() < 0 ? stateList.size() - 1 : 0);
-    for(; isIndexValid(stateList, index); index += getStep()) {
+    int index = (getStep() < 0 ? stateList.size() - 1 : first);
+    for(; isIndexValid(stateList, index) && index >= static_cast<int>(first);
+        index += getStep()) {
+
         auto state = stateList[index];
 
         IF_LOG(11) {
@@ -803,6 +821,7 @@ void SlicingSearch::debugPrintRegAccesses(Instruction *i) {
 }
 
 void SlicingSearch::buildStateFor(SearchState *state) {
+    COUNTER_INC("slice steps");
     auto assembly = state->getInstruction()->getSemantic()->getAssembly();
 
     debugPrintRegAccesses(state->getInstruction());
@@ -882,7 +901,7 @@ void SlicingSearch::detectInstruction(SearchState *state, bool firstPass) {
                 auto source = iState->get1()->reg;
                 auto target = iState->get2()->reg;
 
-                auto tree = TreeFactory::instance().make<TreeNodeAddition>(
+                auto tree = TreeFactory::instance().makeShared<TreeNodeAddition>(
                     u.getParentRegTree(state, source),
                     u.getParentRegTree(state, target));
                 state->setRegTree(target, tree);
@@ -985,8 +1004,8 @@ void SlicingSearch::detectInstruction(SearchState *state, bool firstPass) {
                 state->addReg(reg);
             }
             else {
-                auto tree = TreeFactory::instance().make<TreeNodeComparison>(
-                    TreeFactory::instance().make<TreeNodeConstant>(imm),
+                auto tree = TreeFactory::instance().makeShared<TreeNodeComparison>(
+                    TreeFactory::instance().makeShared<TreeNodeConstant>(imm),
                     u.getParentRegTree(state, reg));
                 state->setRegTree(X86_REG_EFLAGS, tree);
             }
@@ -1020,7 +1039,7 @@ void SlicingSearch::detectInstruction(SearchState *state, bool firstPass) {
                 auto imm = iState->get2()->imm;
 
                 state->setRegTree(reg,
-                    TreeFactory::instance().make<TreeNodeAddress>(imm));
+                    TreeFactory::instance().makeShared<TreeNodeAddress>(imm));
             }
         }
         else {
@@ -1038,7 +1057,7 @@ void SlicingSearch::detectInstruction(SearchState *state, bool firstPass) {
                 auto imm = iState->get2()->imm; //cs adds PC internally
 
                 state->setRegTree(reg,
-                    TreeFactory::instance().make<TreeNodeAddress>(imm));
+                    TreeFactory::instance().makeShared<TreeNodeAddress>(imm));
             }
         }
         else {
@@ -1060,14 +1079,14 @@ void SlicingSearch::detectInstruction(SearchState *state, bool firstPass) {
                 TreeNode *tree = u.getParentRegTree(state, source2);
                 if(extreg->shift.type != ARM64_SFT_INVALID) {
                     if(extreg->shift.type == ARM64_SFT_LSL) {
-                        auto c = TreeFactory::instance().make<TreeNodeConstant>(
+                        auto c = TreeFactory::instance().makeShared<TreeNodeConstant>(
                             extreg->shift.value);
-                        tree = TreeFactory::instance().make<
+                        tree = TreeFactory::instance().makeShared<
                             TreeNodeLogicalShiftLeft>(tree, c);
                     }
                 }
 
-                tree = TreeFactory::instance().make<TreeNodeAddition>(
+                tree = TreeFactory::instance().makeShared<TreeNodeAddition>(
                     u.getParentRegTree(state, source1),
                     tree);
                 state->setRegTree(target, tree);
@@ -1090,8 +1109,8 @@ void SlicingSearch::detectInstruction(SearchState *state, bool firstPass) {
                     }
                 }
 
-                tree = TreeFactory::instance().make<TreeNodeConstant>(extimm.imm);
-                tree = TreeFactory::instance().make<TreeNodeAddition>(
+                tree = TreeFactory::instance().makeShared<TreeNodeConstant>(extimm.imm);
+                tree = TreeFactory::instance().makeShared<TreeNodeAddition>(
                     u.getParentRegTree(state, source),
                     tree);
                 state->setRegTree(target, tree);
@@ -1112,18 +1131,18 @@ void SlicingSearch::detectInstruction(SearchState *state, bool firstPass) {
                 auto source = iState->get2()->reg;
                 auto extimm = iState->get3()->extimm;
 
-                TreeNode *tree = TreeFactory::instance().make<TreeNodeConstant>(
+                TreeNode *tree = TreeFactory::instance().makeShared<TreeNodeConstant>(
                     extimm.imm);
                 if(extimm.shift.type != ARM64_SFT_INVALID) {
                     if(extimm.shift.type == ARM64_SFT_LSL) {
-                        auto c = TreeFactory::instance().make<TreeNodeConstant>(
+                        auto c = TreeFactory::instance().makeShared<TreeNodeConstant>(
                             extimm.shift.value);
-                        tree = TreeFactory::instance().make<
+                        tree = TreeFactory::instance().makeShared<
                             TreeNodeLogicalShiftLeft>(tree, c);
                     }
                 }
 
-                tree = TreeFactory::instance().make<TreeNodeSubtraction>(
+                tree = TreeFactory::instance().makeShared<TreeNodeSubtraction>(
                     u.getParentRegTree(state, source),
                     tree);
                 state->setRegTree(target, tree);
@@ -1142,14 +1161,14 @@ void SlicingSearch::detectInstruction(SearchState *state, bool firstPass) {
                 TreeNode *tree = u.getParentRegTree(state, source2);
                 if(extreg->shift.type != ARM64_SFT_INVALID) {
                     if(extreg->shift.type == ARM64_SFT_LSL) {
-                        auto c = TreeFactory::instance().make<TreeNodeConstant>(
+                        auto c = TreeFactory::instance().makeShared<TreeNodeConstant>(
                             extreg->shift.value);
-                        tree = TreeFactory::instance().make<
+                        tree = TreeFactory::instance().makeShared<
                             TreeNodeLogicalShiftLeft>(tree, c);
                     }
                 }
 
-                tree = TreeFactory::instance().make<TreeNodeSubtraction>(
+                tree = TreeFactory::instance().makeShared<TreeNodeSubtraction>(
                     u.getParentRegTree(state, source1),
                     tree);
                 state->setRegTree(target, tree);
@@ -1292,9 +1311,9 @@ void SlicingSearch::detectInstruction(SearchState *state, bool firstPass) {
             else {
                 auto reg = iState->get1()->reg;
                 auto imm = iState->get2()->imm;
-                auto tree = TreeFactory::instance().make<TreeNodeComparison>(
+                auto tree = TreeFactory::instance().makeShared<TreeNodeComparison>(
                     u.getParentRegTree(state, reg),
-                    TreeFactory::instance().make<TreeNodeConstant>(imm));
+                    TreeFactory::instance().makeShared<TreeNodeConstant>(imm));
                 state->setRegTree(ARM64_REG_NZCV, tree);
             }
         }
@@ -1305,7 +1324,7 @@ void SlicingSearch::detectInstruction(SearchState *state, bool firstPass) {
             else {
                 auto reg1 = iState->get1()->reg;
                 auto reg2 = iState->get2()->reg;
-                auto tree = TreeFactory::instance().make<TreeNodeComparison>(
+                auto tree = TreeFactory::instance().makeShared<TreeNodeComparison>(
                     u.getParentRegTree(state, reg1),
                     u.getParentRegTree(state, reg2));
                 state->setRegTree(ARM64_REG_NZCV, tree);
@@ -170,26 +170,38 @@ public:
 
 class SlicingSearch {
 private:
+    struct SliceResult {
+        SearchState *initialState;
+        std::vector<SearchState *> conditions;
+    };
+    typedef std::pair<Instruction *, int> SliceKey;
+
     ControlFlowGraph *cfg;
     std::vector<SearchState *> stateList;  // history of states
     std::vector<SearchState *> conditions;  // conditional jumps
+    SearchState *initialState;
+    std::map<SliceKey, SliceResult> sliceMap;
     SlicingHalt *halt;
 
 public:
     SlicingSearch(ControlFlowGraph *cfg, SlicingHalt *halt = nullptr)
-        : cfg(cfg), halt(halt) {}
+        : cfg(cfg), initialState(nullptr), halt(halt) {}
     virtual ~SlicingSearch();
 
-    /** Run search beginning at this instruction. */
+    /** Run search beginning at this instruction. Each (instruction, reg)
+        pair is sliced once per search object; asking again just makes the
+        earlier result current. The trees of all slices stay valid until
+        the search is destroyed, and identical subtrees are shared.
+    */
     void sliceAt(Instruction *instruction, int reg);
 
-    SearchState *getInitialState() const { return stateList.front(); }
+    SearchState *getInitialState() const { return initialState; }
     const std::vector<SearchState *> &getConditionList() const
         { return conditions; }
 
 private:
     void buildStatePass(SearchState *startState);
-    void buildRegTreePass();
+    void buildRegTreePass(size_t first);
 
     void debugPrintRegAccesses(Instruction *i);
     void buildStateFor(SearchState *state);
@@ -2,6 +2,7 @@
 #define EGALITO_ANALYSIS_SLICING_MATCH_H
 
 #include <vector>
+#include <typeinfo>
 #include "slicingtree.h"
 
 class TreeCapture {
@@ -17,6 +18,7 @@ public:
 
 class TreePatternAny {
 public:
+    typedef TreeNode RootType;
     static bool matches(TreeNode *node, TreeCapture &capture)
         { return true; }
 };
@@ -24,6 +26,7 @@ public:
 template <typename Type>
 class TreePatternTerminal {
 public:
+    typedef Type RootType;
     static bool matches(TreeNode *node, TreeCapture &capture)
         { return dynamic_cast<Type *>(node) != nullptr; }
 };
@@ -31,6 +34,7 @@ public:
 template <typename Type>
 class TreePatternAtLeastOneParent {
 public:
+    typedef TreeNodeMultipleParents RootType;
     static bool matches(TreeNode *node, TreeCapture &capture);
 };
 template <typename Type>
@@ -50,6 +54,7 @@ bool TreePatternAtLeastOneParent<Type>::matches(
 template <typename Type, typename SubType>
 class TreePatternUnary {
 public:
+    typedef Type RootType;
     static bool matches(TreeNode *node, TreeCapture &capture);
 };
 template <typename Type, typename SubType>
@@ -64,6 +69,7 @@ bool TreePatternUnary<Type, SubType>::matches(
 template <typename Type, typename LeftType, typename RightType>
 class TreePatternBinary {
 public:
+    typedef Type RootType;
     static bool matches(TreeNode *node, TreeCapture &capture);
 };
 template <typename Type, typename LeftType, typename RightType>
@@ -79,6 +85,7 @@ bool TreePatternBinary<Type, LeftType, RightType>::matches(
 template <typename Type, typename LeftType, typename RightType>
 class TreePatternBinaryAnyOrder {
 public:
+    typedef Type RootType;
     static bool matches(TreeNode *node, TreeCapture &capture);
 };
 template <typename Type, typename LeftType, typename RightType>
@@ -96,6 +103,7 @@ bool TreePatternBinaryAnyOrder<Type, LeftType, RightType>::matches(
 template <typename Type, typename LeftType, typename RightType>
 class TreePatternRecursiveBinary {
 public:
+    typedef Type RootType;
     static bool matches(TreeNode *node, TreeCapture &capture);
 };
 template <typename Type, typename LeftType, typename RightType>
@@ -113,6 +121,7 @@ bool TreePatternRecursiveBinary<Type, LeftType, RightType>::matches(
 template <typename Type = TreePatternAny>
 class TreePatternCapture {
 public:
+    typedef typename Type::RootType RootType;
     static bool matches(TreeNode *node, TreeCapture &capture);
 };
 template <typename Type>
@@ -131,6 +140,7 @@ bool TreePatternCapture<Type>::matches(
 template <int Wanted>
 class TreePatternRegisterIs {
 public:
+    typedef TreeNodeRegister RootType;
     static bool matches(TreeNode *node, TreeCapture &capture) {
         auto v = dynamic_cast<TreeNodeRegister *>(node);
         return v && v->getRegister() == Wanted;
@@ -140,6 +150,7 @@ public:
 template <int Wanted>
 class TreePatternPhysicalRegisterIs {
 public:
+    typedef TreeNodePhysicalRegister RootType;
     static bool matches(TreeNode *node, TreeCapture &capture) {
         auto v = dynamic_cast<TreeNodePhysicalRegister *>(node);
         return v && v->getRegister() == Wanted;
@@ -149,10 +160,84 @@ public:
 template <unsigned long Wanted>
 class TreePatternConstantIs {
 public:
+    typedef TreeNodeConstant RootType;
     static bool matches(TreeNode *node, TreeCapture &capture) {
         auto v = dynamic_cast<TreeNodeConstant *>(node);
         return v && v->getValue() == Wanted;
     }
 };
 
+/** Remembers which root node types a tree was already tested for, so
+    that the patterns of a TreePatternSet with the same RootType share one
+    dynamic_cast. Pattern sets are small, so a linear scan is enough.
+*/
+template <size_t Size>
+class TreePatternRootCache {
+private:
+    TreeNode *node;
+    const std::type_info *typeList[Size];
+    bool resultList[Size];
+    size_t count;
+public:
+    TreePatternRootCache(TreeNode *node) : node(node), count(0) {}
+
+    template <typename RootType>
+    bool isA() {
+        for(size_t i = 0; i < count; i ++) {
+            if(typeList[i] == &typeid(RootType)) return resultList[i];
+        }
+        bool result = dynamic_cast<RootType *>(node) != nullptr;
+        typeList[count] = &typeid(RootType);
+        resultList[count] = result;
+        count ++;
+        return result;
+    }
+};
+
+template <size_t Index, typename... Patterns>
+class TreePatternSetHelper {
+public:
+    template <typename CacheType>
+    static unsigned matches(TreeNode *node, TreeCapture *captureList,
+        CacheType &cache) { return 0; }
+};
+template <size_t Index, typename Pattern, typename... Rest>
+class TreePatternSetHelper<Index, Pattern, Rest...> {
+public:
+    template <typename CacheType>
+    static unsigned matches(TreeNode *node, TreeCapture *captureList,
+        CacheType &cache) {
+
+        unsigned mask = 0;
+        if(cache.template isA<typename Pattern::RootType>()) {
+            if(Pattern::matches(node, captureList[Index])) {
+                mask = 1u << Index;
+            }
+            else captureList[Index].clear();
+        }
+        return mask | TreePatternSetHelper<Index + 1, Rest...>
+            ::matches(node, captureList, cache);
+    }
+};
+
+/** Matches a tree against several patterns in one call, instead of one
+    search per pattern. The set is expanded at compile time; a root node
+    type shared by several patterns is only tested once, and a pattern
+    whose root type does not match is not entered at all.
+*/
+template <typename... Patterns>
+class TreePatternSet {
+public:
+    static const size_t COUNT = sizeof...(Patterns);
+    static_assert(COUNT <= 32, "too many patterns for one mask");
+
+    /** Returns a mask with bit i set if the i-th pattern matched; its
+        captures are then in captureList[i]. */
+    static unsigned matches(TreeNode *node, TreeCapture *captureList) {
+        TreePatternRootCache<COUNT> cache(node);
+        return TreePatternSetHelper<0, Patterns...>::matches(
+            node, captureList, cache);
+    }
+};
+
 #endif
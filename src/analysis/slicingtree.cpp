@@ -3,6 +3,7 @@
 #include <sstream>
 #include <string>
 #include <cstring>
+#include <cstddef>
 #include "slicingtree.h"
 #include "disasm/dump.h"
 
@@ -44,6 +45,7 @@ void TreeNodeUnary::print(const TreePrinter &p) const {
 }
 
 bool TreeNodeUnary::equal(TreeNode *tree) {
+    if(tree == this) return true;
     auto t = dynamic_cast<TreeNodeUnary *>(tree);
     return t && !strcmp(name, t->getName()) &&
         getChild()->equal(t->getChild());
@@ -69,6 +71,7 @@ void TreeNodeBinary::print(const TreePrinter &p) const {
 }
 
 bool TreeNodeBinary::equal(TreeNode *tree) {
+    if(tree == this) return true;
     auto t = dynamic_cast<TreeNodeBinary *>(tree);
     return t && !strcmp(op, t->getOperator()) && (
         (getLeft()->equal(t->getLeft()) &&
@@ -145,7 +148,9 @@ bool TreeNodeMultipleParents::equal(TreeNode *tree) {
 }
 
 TreeFactory& TreeFactory::instance() {
-    static TreeFactory factory;
+    // SlicingSearch cleans the whole factory when it finishes, so each
+    // thread needs a separate one to run searches concurrently
+    static thread_local TreeFactory factory;
     return factory;
 }
 
@@ -173,9 +178,26 @@ TreeNodePhysicalRegister *TreeFactory::makeTreeNodePhysicalRegister(
     return n;
 }
 
+void *TreeFactory::allocate(size_t size) {
+    const size_t align = alignof(std::max_align_t);
+    size = (size + align - 1) & ~(align - 1);
+    if(blockUsed + size > ARENA_BLOCK_SIZE) {
+        blockList.push_back(static_cast<char *>(
+            ::operator new(ARENA_BLOCK_SIZE)));
+        blockUsed = 0;
+    }
+    void *p = blockList.back() + blockUsed;
+    blockUsed += size;
+    return p;
+}
+
 void TreeFactory::clean() {
-    for(auto t : trees) { delete t; }
+    for(auto t : trees) { t->~TreeNode(); }
     trees.clear();
+    sharedTrees.clear();
+    for(auto block : blockList) { ::operator delete(block); }
+    blockList.clear();
+    blockUsed = ARENA_BLOCK_SIZE;
 }
 
 void TreeFactory::cleanAll() {
@@ -4,6 +4,10 @@
 #include <iosfwd>
 #include <vector>
 #include <map>
+#include <typeindex>
+#include <typeinfo>
+#include <cstdint>
+#include <new>
 #include "instr/register.h"
 #include "types.h"
 
@@ -104,7 +108,6 @@ private:
 public:
     TreeNodeUnary(TreeNode *node, const char *name)
         : node(node), name(name) {}
-    ~TreeNodeUnary() { if(node) delete node; }
     TreeNode *getChild() const { return node; }
     const char *getName() const { return name; }
     virtual void print(const TreePrinter &p) const;
@@ -158,7 +161,6 @@ private:
 public:
     TreeNodeBinary(TreeNode *left, TreeNode *right, const char *op)
         : left(left), right(right), op(op) {}
-    ~TreeNodeBinary() { if(left) delete left; if(right) delete right; }
     TreeNode *getLeft() const { return left; }
     TreeNode *getRight() const { return right; }
     const char *getOperator() const { return op; }
@@ -233,12 +235,12 @@ private:
 public:
     TreeNodeComparison(TreeNode *left, TreeNode *right)
         : left(left), right(right) {}
-    ~TreeNodeComparison() { if(left) delete left; if(right) delete right; }
     TreeNode *getLeft() const { return left; }
     TreeNode *getRight() const { return right; }
 
     virtual void print(const TreePrinter &p) const;
     virtual bool equal(TreeNode *tree) {
+        if(tree == this) return true;
         auto t = dynamic_cast<TreeNodeComparison *>(tree);
         return t && (
             (getLeft()->equal(t->getLeft()) &&
@@ -262,34 +264,79 @@ public:
     virtual bool equal(TreeNode *tree);
 };
 
+/** Owns tree nodes. Nodes are placed in an arena and released together
+    by clean(), so a node never owns (or deletes) its children, and one
+    subtree may be shared by many trees.
+
+    UseDef and SlicingSearch build all of their nodes through a factory;
+    each UDWorkingSet has its own, which lives as long as the states that
+    point into it.
+*/
 class TreeFactory {
 private:
+    typedef std::pair<std::type_index, std::vector<uint64_t>> SharedKey;
+    static const size_t ARENA_BLOCK_SIZE = 0x4000;
+
     std::vector<TreeNode *> trees;
+    std::vector<char *> blockList;
+    size_t blockUsed;
     std::map<int, TreeNodeRegister *> regTrees;
     std::map<Register, TreeNodePhysicalRegister *> regPhysicalTrees;
+    std::map<SharedKey, TreeNode *> sharedTrees;
 
 public:
+    TreeFactory() : blockUsed(ARENA_BLOCK_SIZE) {}
+    ~TreeFactory() { cleanAll(); }
+
+    /** Per-thread factory, for searches without a working set. */
     static TreeFactory& instance();
 
     template <typename TreeNodeType, typename... Args>
     TreeNodeType *make(Args... args) {
-        TreeNodeType *n = new TreeNodeType(args...);
+        static_assert(sizeof(TreeNodeType) <= ARENA_BLOCK_SIZE,
+            "tree node does not fit in an arena block");
+        TreeNodeType *n = new (allocate(sizeof(TreeNodeType)))
+            TreeNodeType(args...);
         trees.push_back(n);
         return n;
     }
 
+    /** Hash-consed make: asking twice for the same node type with the same
+        arguments (children are compared by pointer) returns the same node.
+        Only for nodes that are never modified after construction. Shared
+        nodes are owned by the factory and released by clean().
+    */
+    template <typename TreeNodeType, typename... Args>
+    TreeNodeType *makeShared(Args... args) {
+        SharedKey key(typeid(TreeNodeType), {getKey(args)...});
+        auto it = sharedTrees.find(key);
+        if(it != sharedTrees.end()) {
+            return static_cast<TreeNodeType *>(it->second);
+        }
+        auto n = make<TreeNodeType>(args...);
+        sharedTrees.emplace(std::move(key), n);
+        return n;
+    }
+
+    /** Releases every node made so far, except the register nodes. */
     void clean();
     void cleanAll();
 
 private:
-    TreeFactory() {}
-    ~TreeFactory() {}
     TreeFactory& operator=(const TreeFactory&);
     TreeFactory(const TreeFactory&);
 
+    void *allocate(size_t size);
+
     TreeNodeRegister *makeTreeNodeRegister(int reg);
     TreeNodePhysicalRegister *makeTreeNodePhysicalRegister(
         Register reg, int width);
+
+    template <typename T>
+    static uint64_t getKey(T *pointer)
+        { return reinterpret_cast<uintptr_t>(pointer); }
+    template <typename T>
+    static uint64_t getKey(T value) { return static_cast<uint64_t>(value); }
 };
 
 template <>
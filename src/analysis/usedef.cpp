@@ -1,4 +1,5 @@
 #include "usedef.h"
+#include "analysis/worklist.h"
 #include "analysis/jumptable.h"
 #include "analysis/slicingtree.h"
 #include "analysis/slicingmatch.h"
@@ -9,12 +10,10 @@
 
 #include <assert.h>
 #include "chunk/dump.h"
+#include "util/counter.h"
+#include "analysis/budget.h"
 #include "log/log.h"
 
-DefList::~DefList() {
-    for(auto tn : list) delete tn.second;
-}
-
 void DefList::set(int reg, TreeNode *tree) {
     list[reg] = tree;
 }
@@ -24,11 +23,8 @@ void DefList::del(int reg) {
 }
 
 TreeNode *DefList::get(int reg) const {
-    auto it = list.find(reg);
-    if(it != list.end()) {
-        return it->second;
-    }
-    return nullptr;
+    auto tree = list.find(reg);
+    return tree ? *tree : nullptr;
 }
 
 void DefList::dump() const {
@@ -59,17 +55,16 @@ void RefList::add(int reg, UDState *origin) {
 
 bool RefList::addIfExist(int reg, UDState *origin) {
     bool found = false;
-    auto it = list.find(reg);
-    if(it != list.end()) {
+    if(auto origins = list.find(reg)) {
         bool duplicate = false;
-        for(auto s : it->second) {
+        for(auto s : *origins) {
             if(s == origin) {
                 duplicate = true;
                 break;
             }
         }
         if(!duplicate) {
-            it->second.push_back(origin);
+            origins->push_back(origin);
         }
         found = true;
     }
@@ -85,14 +80,23 @@ void RefList::clear() {
 }
 
 const std::vector<UDState *>& RefList::get(int reg) const {
-    auto it = list.find(reg);
-    if(it != list.end()) {
-        return it->second;
+    if(auto origins = list.find(reg)) {
+        return *origins;
     }
     static std::vector<UDState *> emptyList;
     return emptyList;
 }
 
+bool RefList::equals(const RefList &other) const {
+    if(list.size() != other.list.size()) return false;
+    auto it = other.list.begin();
+    for(const auto &r : list) {
+        if(r.first != it->first || r.second != it->second) return false;
+        ++it;
+    }
+    return true;
+}
+
 void RefList::dump() const {
     for(const auto& r : list) {
 #ifdef ARCH_X86_64
@@ -109,9 +113,8 @@ void RefList::dump() const {
 
 void UseList::add(int reg, UDState *state) {
     bool duplicate = false;
-    auto it = list.find(reg);
-    if(it != list.end()) {
-        for(auto s : it->second) {
+    if(auto states = list.find(reg)) {
+        for(auto s : *states) {
             if(s == state) {
                 duplicate = true;
                 break;
@@ -124,21 +127,19 @@ void UseList::add(int reg, UDState *state) {
 }
 
 void UseList::del(int reg, UDState *state) {
-    auto it = list.find(reg);
-    if(it != list.end()) {
-        for(auto& s : it->second) {
+    if(auto states = list.find(reg)) {
+        for(auto& s : *states) {
             if(s == state) {
-                s = it->second.back();
-                it->second.pop_back();
+                s = states->back();
+                states->pop_back();
             }
         }
     }
 }
 
 const std::vector<UDState *>& UseList::get(int reg) const {
-    auto it = list.find(reg);
-    if(it != list.end()) {
-        return it->second;
+    if(auto states = list.find(reg)) {
+        return *states;
     }
     static std::vector<UDState *> emptyList;
     return emptyList;
@@ -204,6 +205,17 @@ void MemOriginList::addList(const MemOriginList& other) {
     }
 }
 
+bool MemOriginList::equals(const MemOriginList &other) const {
+    if(list.size() != other.list.size()) return false;
+    for(size_t i = 0; i < list.size(); i ++) {
+        if(list[i].origin != other.list[i].origin) return false;
+        if(MemLocation(list[i].place) != MemLocation(other.list[i].place)) {
+            return false;
+        }
+    }
+    return true;
+}
+
 void MemOriginList::del(TreeNode *tree) {
     MemLocation m1(tree);
     for(auto it = list.rbegin(); it != list.rend(); ++it) {
@@ -281,14 +293,14 @@ void UDWorkingSet::transitionTo(ControlFlowNode *node) {
     memSet = &nodeExposedMemSetList[node->getID()];
     regSet->clear();
     memSet->clear();
-    for(auto link : node->backwardLinks()) {
-        for(auto mr : nodeExposedRegSetList[link->getTargetID()]) {
+    for(auto pred : node->predecessorIDs()) {
+        for(auto mr : nodeExposedRegSetList[pred]) {
             for(auto o : mr.second) {
                 addToRegSet(mr.first, o);
             }
         }
 
-        memSet->addList(nodeExposedMemSetList[link->getTargetID()]);
+        memSet->addList(nodeExposedMemSetList[pred]);
     }
 }
 
@@ -484,46 +496,47 @@ void UseDef::analyze(const std::vector<std::vector<int>>& order) {
     }
     LOG(10, "");
 
-    for(auto o : order) {
-        analyzeGraph(o);
-        if(o.size() > 1) {
-            analyzeGraph(o);
-        }
-    }
+    // revisit nodes until the sets exposed at their ends stop changing
+    WorklistSolver<> solver(config->getCFG(), order);
+    auto visits = solver.solve([this] (int nodeId) {
+        return analyzeNode(nodeId); });
+    LOG(10, "use-def converged after " << std::dec << visits << " visits");
 }
 
-void UseDef::analyzeGraph(const std::vector<int>& order) {
-    LOG(10, "order:");
-    for(auto o : order) {
-        LOG0(10, " " << std::dec << o);
-    }
-    LOG(10, "");
+bool UseDef::analyzeNode(int nodeId) {
+    RefList regSet = working->getExposedRegSet(nodeId);
+    MemOriginList memSet = working->getExposedMemSet(nodeId);
 
-    for(auto nodeId : order) {
-        auto node = config->getCFG()->get(nodeId);
-        working->transitionTo(node);
+    auto node = config->getCFG()->get(nodeId);
+    working->transitionTo(node);
 
-        auto blockList = CIter::children(node->getBlock());
+    auto blockList = CIter::children(node->getBlock());
 
-        for(auto it = blockList.begin(); it != blockList.end(); ++it) {
-            auto state = working->getState(*it);
+    for(auto it = blockList.begin(); it != blockList.end(); ++it) {
+        // out of budget: leave the remaining states unfilled
+        if(!AnalysisBudget::spend()) return false;
 
-            LOG(10, "analyzing state @ 0x" << std::hex
-                << state->getInstruction()->getAddress());
+        auto state = working->getState(*it);
+        COUNTER_INC("UDState visits");
 
-            if(dynamic_cast<LiteralInstruction *>(
-                state->getInstruction()->getSemantic())) {
-                continue;
-            }
+        LOG(10, "analyzing state @ 0x" << std::hex
+            << state->getInstruction()->getAddress());
 
-            fillState(state);
+        if(dynamic_cast<LiteralInstruction *>(
+            state->getInstruction()->getSemantic())) {
+            continue;
         }
 
-        LOG(11, "");
-        LOG(11, "final set for node " << std::dec << nodeId);
-        IF_LOG(11) working->dumpSet();
-        LOG(11, "");
+        fillState(state);
     }
+
+    LOG(11, "");
+    LOG(11, "final set for node " << std::dec << nodeId);
+    IF_LOG(11) working->dumpSet();
+    LOG(11, "");
+
+    return !regSet.equals(working->getExposedRegSet(nodeId))
+        || !memSet.equals(working->getExposedMemSet(nodeId));
 }
 
 bool UseDef::callIfEnabled(UDState *state, Instruction *instruction) {
@@ -612,7 +625,7 @@ void UseDef::useReg(UDState *state, int reg) {
     if(working->getRegSet(reg).empty()
         && working->shouldTrackPartialUDChains()) {
 
-        defReg(state, reg, new TreeNodeRegister(reg));
+        defReg(state, reg, factory->makeShared<TreeNodeRegister>(reg));
     }
     else {
         for(auto o : working->getRegSet(reg)) {
@@ -662,23 +675,23 @@ TreeNode *UseDef::shiftExtend(TreeNode *tree, arm64_shifter type,
 
     switch(type) {
     case ARM64_SFT_LSL:
-        tree = TreeFactory::instance().make<TreeNodeLogicalShiftLeft>(tree,
-            TreeFactory::instance().make<TreeNodeConstant>(value));
+        tree = factory->makeShared<TreeNodeLogicalShiftLeft>(tree,
+            factory->makeShared<TreeNodeConstant>(value));
         break;
     case ARM64_SFT_MSL:
         throw "msl";
         break;
     case ARM64_SFT_LSR:
-        tree = TreeFactory::instance().make<TreeNodeLogicalShiftRight>(tree,
-            TreeFactory::instance().make<TreeNodeConstant>(value));
+        tree = factory->makeShared<TreeNodeLogicalShiftRight>(tree,
+            factory->makeShared<TreeNodeConstant>(value));
         break;
     case ARM64_SFT_ASR:
-        tree = TreeFactory::instance().make<TreeNodeArithmeticShiftRight>(tree,
-            TreeFactory::instance().make<TreeNodeConstant>(value));
+        tree = factory->makeShared<TreeNodeArithmeticShiftRight>(tree,
+            factory->makeShared<TreeNodeConstant>(value));
         break;
     case ARM64_SFT_ROR:
-        tree = TreeFactory::instance().make<TreeNodeRotateRight>(tree,
-            TreeFactory::instance().make<TreeNodeConstant>(value));
+        tree = factory->makeShared<TreeNodeRotateRight>(tree,
+            factory->makeShared<TreeNodeConstant>(value));
         break;
     case ARM64_SFT_INVALID:
     default:
@@ -714,41 +727,41 @@ void UseDef::fillRegToReg(UDState *state, AssemblyPtr assembly) {
     auto id = assembly->getId();
     if(id == X86_INS_ADD) {
         useReg(state, reg1);
-        auto reg0Tree = TreeFactory::instance().make<TreeNodePhysicalRegister>(
+        auto reg0Tree = factory->makeShared<TreeNodePhysicalRegister>(
             reg0, width0);
-        auto reg1Tree = TreeFactory::instance().make<TreeNodePhysicalRegister>(
+        auto reg1Tree = factory->makeShared<TreeNodePhysicalRegister>(
             reg1, width1);
-        tree = TreeFactory::instance().make<TreeNodeAddition>(
+        tree = factory->makeShared<TreeNodeAddition>(
             reg1Tree, reg0Tree);
     } else if(id == X86_INS_SUB) {
         useReg(state, reg1);
-        auto reg0Tree = TreeFactory::instance().make<TreeNodePhysicalRegister>(
+        auto reg0Tree = factory->makeShared<TreeNodePhysicalRegister>(
             reg0, width0);
-        auto reg1Tree = TreeFactory::instance().make<TreeNodePhysicalRegister>(
+        auto reg1Tree = factory->makeShared<TreeNodePhysicalRegister>(
             reg1, width1);
-        tree = TreeFactory::instance().make<TreeNodeSubtraction>(
+        tree = factory->makeShared<TreeNodeSubtraction>(
             reg1Tree, reg0Tree);
     } else if(id == X86_INS_SHL) {
         useReg(state, reg1);
-        auto reg0Tree = TreeFactory::instance().make<TreeNodePhysicalRegister>(
+        auto reg0Tree = factory->makeShared<TreeNodePhysicalRegister>(
             reg0, width0);
-        auto reg1Tree = TreeFactory::instance().make<TreeNodePhysicalRegister>(
+        auto reg1Tree = factory->makeShared<TreeNodePhysicalRegister>(
             reg1, width1);
-        tree = TreeFactory::instance().make<TreeNodeLogicalShiftLeft>(
+        tree = factory->makeShared<TreeNodeLogicalShiftLeft>(
             reg1Tree, reg0Tree);
     } else if(id == X86_INS_SHR) {
         useReg(state, reg1);
-        auto reg0Tree = TreeFactory::instance().make<TreeNodePhysicalRegister>(
+        auto reg0Tree = factory->makeShared<TreeNodePhysicalRegister>(
             reg0, width0);
-        auto reg1Tree = TreeFactory::instance().make<TreeNodePhysicalRegister>(
+        auto reg1Tree = factory->makeShared<TreeNodePhysicalRegister>(
             reg1, width1);
-        tree = TreeFactory::instance().make<TreeNodeLogicalShiftRight>(
+        tree = factory->makeShared<TreeNodeLogicalShiftRight>(
             reg1Tree, reg0Tree);
     } else if(id == X86_INS_MOV
         || id == X86_INS_MOVSXD
         || id == X86_INS_MOVZX) {
 
-        tree = TreeFactory::instance().make<TreeNodePhysicalRegister>(
+        tree = factory->makeShared<TreeNodePhysicalRegister>(
             reg0, width0);
     }
     defReg(state, reg1, tree);
@@ -760,7 +773,7 @@ void UseDef::fillRegToReg(UDState *state, AssemblyPtr assembly) {
     size_t width1 = AARCH64GPRegister::getWidth(reg1, op1);
 
     useReg(state, reg1);
-    auto tree = TreeFactory::instance().make<
+    auto tree = factory->makeShared<
         TreeNodePhysicalRegister>(reg1, width1);
 
     defReg(state, reg0, tree);
@@ -773,21 +786,21 @@ void UseDef::fillRegToReg(UDState *state, AssemblyPtr assembly) {
     TreeNode *tree = nullptr;
     switch(assembly->getId()) {
     case rv_op_mv:
-        tree = TreeFactory::instance().make<TreeNodePhysicalRegister>(rs, 8);
+        tree = factory->makeShared<TreeNodePhysicalRegister>(rs, 8);
         break;
     case rv_op_neg:
-        tree = TreeFactory::instance().make<TreeNodeSubtraction>(
-            TreeFactory::instance().make<TreeNodeConstant>(0),
-            TreeFactory::instance().make<TreeNodePhysicalRegister>(rs, 8));
+        tree = factory->makeShared<TreeNodeSubtraction>(
+            factory->makeShared<TreeNodeConstant>(0),
+            factory->makeShared<TreeNodePhysicalRegister>(rs, 8));
         break;
     case rv_op_negw:
-        tree = TreeFactory::instance().make<TreeNodeSubtraction>(
-            TreeFactory::instance().make<TreeNodeConstant>(0),
-            TreeFactory::instance().make<TreeNodePhysicalRegister>(rs, 4));
+        tree = factory->makeShared<TreeNodeSubtraction>(
+            factory->makeShared<TreeNodeConstant>(0),
+            factory->makeShared<TreeNodePhysicalRegister>(rs, 4));
         break;
     case rv_op_not:
-        tree = TreeFactory::instance().make<TreeNodeNot>(
-            TreeFactory::instance().make<TreeNodePhysicalRegister>(rs, 8));
+        tree = factory->makeShared<TreeNodeNot>(
+            factory->makeShared<TreeNodePhysicalRegister>(rs, 8));
         break;
     case rv_op_seqz:
         // XXX: conditional move, either 0 or 1
@@ -795,8 +808,8 @@ void UseDef::fillRegToReg(UDState *state, AssemblyPtr assembly) {
         break;
     case rv_op_sext_w:
         // XXX: sign extension
-        tree = TreeFactory::instance().make<TreeNodeSignExtendWord>(
-            TreeFactory::instance().make<TreeNodePhysicalRegister>(rs, 4));
+        tree = factory->makeShared<TreeNodeSignExtendWord>(
+            factory->makeShared<TreeNodePhysicalRegister>(rs, 4));
         break;
     case rv_op_sgtz:
         // XXX: conditional move, either 0 or 1
@@ -832,13 +845,13 @@ void UseDef::fillMemToReg(UDState *state, AssemblyPtr assembly, size_t width) {
     auto id = assembly->getId();
     if(id == X86_INS_ADD) {
         useMem(state, memTree, reg1);
-        tree = TreeFactory::instance().make<TreeNodeDereference>(
+        tree = factory->makeShared<TreeNodeDereference>(
             memTree, width);
 
         useReg(state, reg1);
-        auto reg1Tree = TreeFactory::instance().make<TreeNodePhysicalRegister>(
+        auto reg1Tree = factory->makeShared<TreeNodePhysicalRegister>(
             reg1, width1);
-        tree = TreeFactory::instance().make<TreeNodeAddition>(
+        tree = factory->makeShared<TreeNodeAddition>(
             reg1Tree, tree);
     }
     else if(id == X86_INS_LEA) {
@@ -846,13 +859,13 @@ void UseDef::fillMemToReg(UDState *state, AssemblyPtr assembly, size_t width) {
     }
     /*else if(id == X86_INS_ADD) {
         useMem(state, memTree, reg1);
-        tree = TreeFactory::instance().make<TreeNodeDereference>(
+        tree = factory->makeShared<TreeNodeDereference>(
             memTree, width);
 
         useReg(state, reg1);
-        auto reg1Tree = TreeFactory::instance().make<TreeNodePhysicalRegister>(
+        auto reg1Tree = factory->makeShared<TreeNodePhysicalRegister>(
             reg1, width1);
-        tree = TreeFactory::instance().make<TreeNodeAddition>(
+        tree = factory->makeShared<TreeNodeAddition>(
             reg1Tree, tree);
     }*/
     else if(id == X86_INS_MOV
@@ -861,11 +874,11 @@ void UseDef::fillMemToReg(UDState *state, AssemblyPtr assembly, size_t width) {
 
         if(memTree) {
             useMem(state, memTree, reg1);
-            tree = TreeFactory::instance().make<TreeNodeDereference>(
+            tree = factory->makeShared<TreeNodeDereference>(
                 memTree, width);
         }
         else {
-            tree = TreeFactory::instance().make<TreeNodeConstant>(0);
+            tree = factory->makeShared<TreeNodeConstant>(0);
         }
     }
     defReg(state, reg1, tree);
@@ -881,25 +894,25 @@ void UseDef::fillMemToReg(UDState *state, AssemblyPtr assembly, size_t width) {
     useReg(state, base);
 
     auto baseTree
-        = TreeFactory::instance().make<TreeNodePhysicalRegister>(base, widthB);
+        = factory->makeShared<TreeNodePhysicalRegister>(base, widthB);
     TreeNode *memTree = nullptr;
     if(mem.index != INVALID_REGISTER) {
         auto regI = AARCH64GPRegister::convertToPhysical(mem.index);
         size_t widthI = AARCH64GPRegister::getWidth(regI, mem.index);
         useReg(state, regI);
 
-        TreeNode *indexTree = TreeFactory::instance().make<
+        TreeNode *indexTree = factory->makeShared<
             TreeNodePhysicalRegister>(regI, widthI);
         auto shift = assembly->getAsmOperands()->getOperands()[1].shift;
         indexTree = shiftExtend(indexTree, shift.type, shift.value);
-        memTree = TreeFactory::instance().make<TreeNodeAddition>(
+        memTree = factory->makeShared<TreeNodeAddition>(
             baseTree,
             indexTree);
     }
     else {
-        memTree = TreeFactory::instance().make<TreeNodeAddition>(
+        memTree = factory->makeShared<TreeNodeAddition>(
             baseTree,
-            TreeFactory::instance().make<TreeNodeConstant>(mem.disp));
+            factory->makeShared<TreeNodeConstant>(mem.disp));
 
         if(assembly->isPreIndex()) {
             defReg(state, base, memTree);
@@ -908,7 +921,7 @@ void UseDef::fillMemToReg(UDState *state, AssemblyPtr assembly, size_t width) {
     useMem(state, memTree, reg0);
 
     auto derefTree
-        = TreeFactory::instance().make<TreeNodeDereference>(memTree, width);
+        = factory->makeShared<TreeNodeDereference>(memTree, width);
     defReg(state, reg0, derefTree);
 #elif defined(ARCH_RISCV)
     auto rd = assembly->getAsmOperands()->getOperands()[0].value.reg;
@@ -917,11 +930,11 @@ void UseDef::fillMemToReg(UDState *state, AssemblyPtr assembly, size_t width) {
     useReg(state, mem.basereg);
 
     auto rs1tree =
-        TreeFactory::instance().make<TreeNodePhysicalRegister>(mem.basereg, 8);
+        factory->makeShared<TreeNodePhysicalRegister>(mem.basereg, 8);
 
-    auto memTree = TreeFactory::instance().make<TreeNodeAddition>(
+    auto memTree = factory->makeShared<TreeNodeAddition>(
         rs1tree,
-        TreeFactory::instance().make<TreeNodeConstant>(mem.disp));
+        factory->makeShared<TreeNodeConstant>(mem.disp));
 
     // int width = 0;
     switch(assembly->getId()) {
@@ -946,7 +959,7 @@ void UseDef::fillMemToReg(UDState *state, AssemblyPtr assembly, size_t width) {
 
     useMem(state, memTree, width);
     defReg(state, rd,
-        TreeFactory::instance().make<TreeNodeDereference>(memTree, width));
+        factory->makeShared<TreeNodeDereference>(memTree, width));
 #endif
 }
 
@@ -958,30 +971,30 @@ void UseDef::fillImmToReg(UDState *state, AssemblyPtr assembly) {
     int reg1;
     size_t width1;
     std::tie(reg1, width1) = getPhysicalRegister(op1);
-    auto tree1 = TreeFactory::instance().make<TreeNodePhysicalRegister>(
+    auto tree1 = factory->makeShared<TreeNodePhysicalRegister>(
         reg1, width1);
-    auto tree0 = TreeFactory::instance().make<TreeNodeConstant>(op0);
+    auto tree0 = factory->makeShared<TreeNodeConstant>(op0);
     if(assembly->getId() == X86_INS_ADD) {
         auto destTree
-            = TreeFactory::instance().make<TreeNodeAddition>(tree1, tree0);
+            = factory->makeShared<TreeNodeAddition>(tree1, tree0);
         useReg(state, reg1);
         defReg(state, reg1, destTree);
     }
     else if(assembly->getId() == X86_INS_SUB) {
         auto destTree
-            = TreeFactory::instance().make<TreeNodeSubtraction>(tree1, tree0);
+            = factory->makeShared<TreeNodeSubtraction>(tree1, tree0);
         useReg(state, reg1);
         defReg(state, reg1, destTree);
     }
     else if(assembly->getId() == X86_INS_SHL) {
         auto destTree
-            = TreeFactory::instance().make<TreeNodeLogicalShiftLeft>(tree1, tree0);
+            = factory->makeShared<TreeNodeLogicalShiftLeft>(tree1, tree0);
         useReg(state, reg1);
         defReg(state, reg1, destTree);
     }
     else if(assembly->getId() == X86_INS_SHR) {
         auto destTree
-            = TreeFactory::instance().make<TreeNodeLogicalShiftRight>(tree1, tree0);
+            = factory->makeShared<TreeNodeLogicalShiftRight>(tree1, tree0);
         useReg(state, reg1);
         defReg(state, reg1, destTree);
     }
@@ -992,7 +1005,7 @@ void UseDef::fillImmToReg(UDState *state, AssemblyPtr assembly) {
         defReg(state, reg1, tree0);
     }
     else if(assembly->getId() == X86_INS_AND) {
-        auto destTree = TreeFactory::instance().make<TreeNodeAnd>(tree1, tree0);
+        auto destTree = factory->makeShared<TreeNodeAnd>(tree1, tree0);
         useReg(state, reg1);
         defReg(state, reg1, destTree);
     }
@@ -1009,10 +1022,10 @@ void UseDef::fillImmToReg(UDState *state, AssemblyPtr assembly) {
         || assembly->getId() == ARM64_INS_ADRP
         || assembly->getId() == ARM64_INS_LDR) {
 
-        tree1 = TreeFactory::instance().make<TreeNodeAddress>(op1);
+        tree1 = factory->makeShared<TreeNodeAddress>(op1);
     }
     else {
-        tree1 = TreeFactory::instance().make<TreeNodeConstant>(op1);
+        tree1 = factory->makeShared<TreeNodeConstant>(op1);
     }
     defReg(state, reg0, tree1);
 #elif defined(ARCH_RISCV)
@@ -1022,11 +1035,11 @@ void UseDef::fillImmToReg(UDState *state, AssemblyPtr assembly) {
     TreeNode *tree = nullptr;
     switch(assembly->getId()) {
     case rv_op_lui:
-        tree = TreeFactory::instance().make<TreeNodeConstant>(
+        tree = factory->makeShared<TreeNodeConstant>(
             (int64_t)(imm << 12));
       break;
     case rv_op_c_lui:
-        tree = TreeFactory::instance().make<TreeNodeConstant>(
+        tree = factory->makeShared<TreeNodeConstant>(
             (int64_t)(imm << 12));
         break;
     case rv_op_auipc:
@@ -1034,7 +1047,7 @@ void UseDef::fillImmToReg(UDState *state, AssemblyPtr assembly) {
         // but our riscv disas doesn't, so we need to add it manually
         // the disas does, however, pre-shift the imm by 12.
         uint64_t ip = state->getInstruction()->getAddress();
-        tree = TreeFactory::instance().make<TreeNodeAddress>(
+        tree = factory->makeShared<TreeNodeAddress>(
                 ip + (int64_t)(imm));
         break;
     }
@@ -1057,9 +1070,9 @@ void UseDef::fillRegRegToReg(UDState *state, AssemblyPtr assembly) {
     useReg(state, reg2);
 
     TreeNode *reg1tree
-        = TreeFactory::instance().make<TreeNodePhysicalRegister>(reg1, width1);
+        = factory->makeShared<TreeNodePhysicalRegister>(reg1, width1);
     TreeNode *reg2tree
-        = TreeFactory::instance().make<TreeNodePhysicalRegister>(reg2, width2);
+        = factory->makeShared<TreeNodePhysicalRegister>(reg2, width2);
 
     auto shift = assembly->getAsmOperands()->getOperands()[2].shift;
     reg2tree = shiftExtend(reg2tree, shift.type, shift.value);
@@ -1067,15 +1080,15 @@ void UseDef::fillRegRegToReg(UDState *state, AssemblyPtr assembly) {
     TreeNode *tree = nullptr;
     switch(assembly->getId()) {
     case ARM64_INS_ADD:
-        tree = TreeFactory::instance().make<
+        tree = factory->makeShared<
             TreeNodeAddition>(reg1tree, reg2tree);
         break;
     case ARM64_INS_AND:
-        tree = TreeFactory::instance().make<
+        tree = factory->makeShared<
             TreeNodeAnd>(reg1tree, reg2tree);
         break;
     case ARM64_INS_SUB:
-        tree = TreeFactory::instance().make<
+        tree = factory->makeShared<
             TreeNodeSubtraction>(reg1tree, reg2tree);
         break;
     default:
@@ -1094,9 +1107,9 @@ void UseDef::fillRegRegToReg(UDState *state, AssemblyPtr assembly) {
 
     TreeNode *reg1tree = nullptr, *reg2tree = nullptr;
     auto helper = [&](size_t width) {
-        reg1tree = TreeFactory::instance().make<TreeNodePhysicalRegister>(rs1,
+        reg1tree = factory->makeShared<TreeNodePhysicalRegister>(rs1,
             width);
-        reg2tree = TreeFactory::instance().make<TreeNodePhysicalRegister>(rs2,
+        reg2tree = factory->makeShared<TreeNodePhysicalRegister>(rs2,
             width);
     };
 
@@ -1104,32 +1117,32 @@ void UseDef::fillRegRegToReg(UDState *state, AssemblyPtr assembly) {
     switch(assembly->getId()) {
     case rv_op_add:
         helper(8);
-        tree = TreeFactory::instance().make<
+        tree = factory->makeShared<
             TreeNodeAddition>(reg1tree, reg2tree);
         break;
     case rv_op_and:
         helper(8);
-        tree = TreeFactory::instance().make<
+        tree = factory->makeShared<
             TreeNodeAnd>(reg1tree, reg2tree);
         break;
     case rv_op_or:
         helper(8);
-        tree = TreeFactory::instance().make<
+        tree = factory->makeShared<
             TreeNodeOr>(reg1tree, reg2tree);
         break;
     case rv_op_sub:
         helper(8);
-        tree = TreeFactory::instance().make<
+        tree = factory->makeShared<
             TreeNodeSubtraction>(reg1tree, reg2tree);
         break;
     case rv_op_subw:
         helper(4);
-        tree = TreeFactory::instance().make<
+        tree = factory->makeShared<
             TreeNodeSubtraction>(reg1tree, reg2tree);
         break;
     case rv_op_xor:
         helper(8);
-        tree = TreeFactory::instance().make<
+        tree = factory->makeShared<
             TreeNodeXor>(reg1tree, reg2tree);
         break;
     default:
@@ -1154,25 +1167,25 @@ void UseDef::fillMemImmToReg(UDState *state, AssemblyPtr assembly) {
     useReg(state, base);
 
     auto baseTree
-        = TreeFactory::instance().make<TreeNodePhysicalRegister>(base, widthB);
+        = factory->makeShared<TreeNodePhysicalRegister>(base, widthB);
 
     assert(mem.index == INVALID_REGISTER);
     assert(mem.disp == 0);
 
     size_t width = (assembly->getBytes()[3] & 0b01000000) ? 8 : 4;
-    auto memTree = TreeFactory::instance().make<TreeNodeAddition>(
+    auto memTree = factory->makeShared<TreeNodeAddition>(
         baseTree,
-        TreeFactory::instance().make<TreeNodeConstant>(0));
+        factory->makeShared<TreeNodeConstant>(0));
     useMem(state, memTree, reg0);
 
     auto derefTree
-        = TreeFactory::instance().make<TreeNodeDereference>(memTree, width);
+        = factory->makeShared<TreeNodeDereference>(memTree, width);
     defReg(state, reg0, derefTree);
 
     auto imm = assembly->getAsmOperands()->getOperands()[2].imm;
-    auto wbTree = TreeFactory::instance().make<TreeNodeAddition>(
+    auto wbTree = factory->makeShared<TreeNodeAddition>(
         baseTree,
-        TreeFactory::instance().make<TreeNodeConstant>(imm));
+        factory->makeShared<TreeNodeConstant>(imm));
     defReg(state, base, wbTree);
 #endif
 }
@@ -1189,25 +1202,25 @@ void UseDef::fillRegToMem(UDState *state, AssemblyPtr assembly, size_t width) {
         int rsp;
         size_t widthRsp;
         std::tie(rsp, widthRsp) = getPhysicalRegister(X86_REG_RSP);
-        auto rspTree = TreeFactory::instance().make<TreeNodePhysicalRegister>(
+        auto rspTree = factory->makeShared<TreeNodePhysicalRegister>(
             rsp, widthRsp);
         useReg(state, rsp);
-        auto memTree = TreeFactory::instance().make<TreeNodeSubtraction>(
-            rspTree, TreeFactory::instance().make<TreeNodeConstant>(8));
+        auto memTree = factory->makeShared<TreeNodeSubtraction>(
+            rspTree, factory->makeShared<TreeNodeConstant>(8));
         defReg(state, rsp, memTree);
 
         // create copy of memTree so we don't free it twice
-        rspTree = TreeFactory::instance().make<TreeNodePhysicalRegister>(
+        rspTree = factory->makeShared<TreeNodePhysicalRegister>(
             rsp, widthRsp);
-        memTree = TreeFactory::instance().make<TreeNodeSubtraction>(
-            rspTree, TreeFactory::instance().make<TreeNodeConstant>(8));
+        memTree = factory->makeShared<TreeNodeSubtraction>(
+            rspTree, factory->makeShared<TreeNodeConstant>(8));
         defMem(state, memTree, reg0);
     }
     else {  // movl
         auto memTree = makeMemTree(state,
             assembly->getAsmOperands()->getOperands()[1].mem);
         if(!memTree) {
-            memTree = TreeFactory::instance().make<TreeNodeConstant>(0);
+            memTree = factory->makeShared<TreeNodeConstant>(0);
         }
         defMem(state, memTree, reg0);
     }
@@ -1225,25 +1238,25 @@ void UseDef::fillRegToMem(UDState *state, AssemblyPtr assembly, size_t width) {
     useReg(state, base);
 
     auto baseTree
-        = TreeFactory::instance().make<TreeNodePhysicalRegister>(base, widthB);
+        = factory->makeShared<TreeNodePhysicalRegister>(base, widthB);
     TreeNode *memTree = nullptr;
     if(mem.index != INVALID_REGISTER) {
         auto regI = AARCH64GPRegister::convertToPhysical(mem.index);
         size_t widthI = AARCH64GPRegister::getWidth(regI, mem.index);
         useReg(state, regI);
 
-        TreeNode *indexTree = TreeFactory::instance().make<
+        TreeNode *indexTree = factory->makeShared<
             TreeNodePhysicalRegister>(regI, widthI);
         auto shift = assembly->getAsmOperands()->getOperands()[1].shift;
         indexTree = shiftExtend(indexTree, shift.type, shift.value);
-        memTree = TreeFactory::instance().make<TreeNodeAddition>(
+        memTree = factory->makeShared<TreeNodeAddition>(
             baseTree,
             indexTree);
     }
     else {
-        memTree = TreeFactory::instance().make<TreeNodeAddition>(
+        memTree = factory->makeShared<TreeNodeAddition>(
             baseTree,
-            TreeFactory::instance().make<TreeNodeConstant>(mem.disp));
+            factory->makeShared<TreeNodeConstant>(mem.disp));
 
         if(assembly->isPreIndex()) {
             defReg(state, base, memTree);
@@ -1259,13 +1272,13 @@ void UseDef::fillRegToMem(UDState *state, AssemblyPtr assembly, size_t width) {
     useReg(state, mem.basereg);
 
     auto rs1tree =
-        TreeFactory::instance().make<TreeNodePhysicalRegister>(mem.basereg, 8);
+        factory->makeShared<TreeNodePhysicalRegister>(mem.basereg, 8);
 
     TreeNode *memTree = rs1tree;
     if(mem.disp != 0) {
-        memTree = TreeFactory::instance().make<TreeNodeAddition>(
+        memTree = factory->makeShared<TreeNodeAddition>(
             rs1tree,
-            TreeFactory::instance().make<TreeNodeConstant>(mem.disp));
+            factory->makeShared<TreeNodeConstant>(mem.disp));
     }
 
     // int width = 0;
@@ -1303,27 +1316,27 @@ void UseDef::fillRegImmToReg(UDState *state, AssemblyPtr assembly) {
     useReg(state, reg1);
 
     auto regTree
-        = TreeFactory::instance().make<TreeNodePhysicalRegister>(reg1, width1);
+        = factory->makeShared<TreeNodePhysicalRegister>(reg1, width1);
 
     long int imm = assembly->getAsmOperands()->getOperands()[2].imm;
     auto shift = assembly->getAsmOperands()->getOperands()[2].shift;
     TreeNode *immTree
-        = TreeFactory::instance().make<TreeNodeConstant>(imm);
+        = factory->makeShared<TreeNodeConstant>(imm);
 
     immTree = shiftExtend(immTree, shift.type, shift.value);
 
     TreeNode *tree = nullptr;
     switch(assembly->getId()) {
     case ARM64_INS_ADD:
-        tree = TreeFactory::instance().make<
+        tree = factory->makeShared<
             TreeNodeAddition>(regTree, immTree);
         break;
     case ARM64_INS_AND:
-        tree = TreeFactory::instance().make<
+        tree = factory->makeShared<
             TreeNodeAnd>(regTree, immTree);
         break;
     case ARM64_INS_SUB:
-        tree = TreeFactory::instance().make<
+        tree = factory->makeShared<
             TreeNodeSubtraction>(regTree, immTree);
         break;
     default:
@@ -1341,9 +1354,9 @@ void UseDef::fillRegImmToReg(UDState *state, AssemblyPtr assembly) {
 
     TreeNode *reg1tree = nullptr, *immtree = nullptr;
     auto helper = [&](size_t width) {
-        reg1tree = TreeFactory::instance().make<TreeNodePhysicalRegister>(rs1,
+        reg1tree = factory->makeShared<TreeNodePhysicalRegister>(rs1,
             width);
-        immtree = TreeFactory::instance().make<TreeNodeConstant>(imm);
+        immtree = factory->makeShared<TreeNodeConstant>(imm);
     };
 
     TreeNode *tree = nullptr;
@@ -1351,7 +1364,7 @@ void UseDef::fillRegImmToReg(UDState *state, AssemblyPtr assembly) {
     case rv_op_addi:
         helper(8);
         if(rs1 != rv_ireg_zero) {
-            tree = TreeFactory::instance().make<TreeNodeAddition>(
+            tree = factory->makeShared<TreeNodeAddition>(
                 reg1tree, immtree);
         }
         else {
@@ -1361,10 +1374,10 @@ void UseDef::fillRegImmToReg(UDState *state, AssemblyPtr assembly) {
         break;
     case rv_op_addiw:
         helper(4);
-        tree = TreeFactory::instance().make<TreeNodeAddition>(
+        tree = factory->makeShared<TreeNodeAddition>(
             reg1tree, immtree);
         if(rs1 != rv_ireg_zero) {
-            tree = TreeFactory::instance().make<TreeNodeAddition>(
+            tree = factory->makeShared<TreeNodeAddition>(
                 reg1tree, immtree);
         }
         else {
@@ -1374,32 +1387,32 @@ void UseDef::fillRegImmToReg(UDState *state, AssemblyPtr assembly) {
         break;
     case rv_op_andi:
         helper(8);
-        tree = TreeFactory::instance().make<TreeNodeAnd>(
+        tree = factory->makeShared<TreeNodeAnd>(
             reg1tree, immtree);
         break;
     case rv_op_ori:
         helper(8);
-        tree = TreeFactory::instance().make<
+        tree = factory->makeShared<
             TreeNodeOr>(reg1tree, immtree);
         break;
     case rv_op_slli:
         helper(8);
-        tree = TreeFactory::instance().make<TreeNodeLogicalShiftLeft>(
+        tree = factory->makeShared<TreeNodeLogicalShiftLeft>(
             reg1tree, immtree);
         break;
     case rv_op_srai:
         helper(8);
-        tree = TreeFactory::instance().make<TreeNodeArithmeticShiftRight>(
+        tree = factory->makeShared<TreeNodeArithmeticShiftRight>(
             reg1tree, immtree);
         break;
     case rv_op_srli:
         helper(8);
-        tree = TreeFactory::instance().make<TreeNodeLogicalShiftRight>(
+        tree = factory->makeShared<TreeNodeLogicalShiftRight>(
             reg1tree, immtree);
         break;
     case rv_op_xori:
         helper(8);
-        tree = TreeFactory::instance().make<
+        tree = factory->makeShared<
             TreeNodeXor>(reg1tree, immtree);
         break;
     default:
@@ -1427,29 +1440,29 @@ void UseDef::fillMemToRegReg(UDState *state, AssemblyPtr assembly) {
 
     assert(mem.index == INVALID_REGISTER);
     auto disp = mem.disp;
-    auto dispTree = TreeFactory::instance().make<TreeNodeConstant>(disp);
+    auto dispTree = factory->makeShared<TreeNodeConstant>(disp);
 
-    auto memTree = TreeFactory::instance().make<TreeNodeAddition>(
-        TreeFactory::instance().make<TreeNodePhysicalRegister>(base, widthB),
+    auto memTree = factory->makeShared<TreeNodeAddition>(
+        factory->makeShared<TreeNodePhysicalRegister>(base, widthB),
         dispTree);
     if(assembly->isPreIndex()) {
         defReg(state, base, memTree);
     }
 
     size_t width = (assembly->getBytes()[3] & 0b10000000) ? 8 : 4;
-    auto memTree0 = TreeFactory::instance().make<TreeNodeAddition>(
+    auto memTree0 = factory->makeShared<TreeNodeAddition>(
         memTree,
-        TreeFactory::instance().make<TreeNodeConstant>(0));
-    auto memTree1 = TreeFactory::instance().make<TreeNodeAddition>(
+        factory->makeShared<TreeNodeConstant>(0));
+    auto memTree1 = factory->makeShared<TreeNodeAddition>(
         memTree,
-        TreeFactory::instance().make<TreeNodeConstant>(width));
+        factory->makeShared<TreeNodeConstant>(width));
     useMem(state, memTree0, reg0);
     useMem(state, memTree1, reg1);
 
     auto derefTree0
-        = TreeFactory::instance().make<TreeNodeDereference>(memTree0, width);
+        = factory->makeShared<TreeNodeDereference>(memTree0, width);
     auto derefTree1
-        = TreeFactory::instance().make<TreeNodeDereference>(memTree1, width);
+        = factory->makeShared<TreeNodeDereference>(memTree1, width);
     defReg(state, reg0, derefTree0);
     defReg(state, reg1, derefTree1);
 #endif
@@ -1473,22 +1486,22 @@ void UseDef::fillRegRegToMem(UDState *state, AssemblyPtr assembly) {
     useReg(state, base);
     assert(mem.index == INVALID_REGISTER);
     auto disp = mem.disp;
-    auto dispTree = TreeFactory::instance().make<TreeNodeConstant>(disp);
+    auto dispTree = factory->makeShared<TreeNodeConstant>(disp);
 
-    auto memTree = TreeFactory::instance().make<TreeNodeAddition>(
-        TreeFactory::instance().make<TreeNodePhysicalRegister>(base, widthB),
+    auto memTree = factory->makeShared<TreeNodeAddition>(
+        factory->makeShared<TreeNodePhysicalRegister>(base, widthB),
         dispTree);
     if(assembly->isPreIndex()) {
         defReg(state, base, memTree);
     }
 
     size_t width = (assembly->getBytes()[3] & 0b10000000) ? 8 : 4;
-    auto memTree0 = TreeFactory::instance().make<TreeNodeAddition>(
+    auto memTree0 = factory->makeShared<TreeNodeAddition>(
         memTree,
-        TreeFactory::instance().make<TreeNodeConstant>(0));
-    auto memTree1 = TreeFactory::instance().make<TreeNodeAddition>(
+        factory->makeShared<TreeNodeConstant>(0));
+    auto memTree1 = factory->makeShared<TreeNodeAddition>(
         memTree,
-        TreeFactory::instance().make<TreeNodeConstant>(width));
+        factory->makeShared<TreeNodeConstant>(width));
 
     defMem(state, memTree0, reg0);
     defMem(state, memTree1, reg1);
@@ -1512,25 +1525,25 @@ void UseDef::fillRegRegImmToMem(UDState *state, AssemblyPtr assembly) {
     useReg(state, base);
 
     auto baseTree
-        = TreeFactory::instance().make<TreeNodePhysicalRegister>(base, widthB);
+        = factory->makeShared<TreeNodePhysicalRegister>(base, widthB);
 
     assert(mem.index == INVALID_REGISTER);
     assert(mem.disp == 0);
 
     size_t width = (assembly->getBytes()[3] & 0b10000000) ? 8 : 4;
-    auto memTree0 = TreeFactory::instance().make<TreeNodeAddition>(
+    auto memTree0 = factory->makeShared<TreeNodeAddition>(
         baseTree,
-        TreeFactory::instance().make<TreeNodeConstant>(0));
-    auto memTree1 = TreeFactory::instance().make<TreeNodeAddition>(
+        factory->makeShared<TreeNodeConstant>(0));
+    auto memTree1 = factory->makeShared<TreeNodeAddition>(
         baseTree,
-        TreeFactory::instance().make<TreeNodeConstant>(width));
+        factory->makeShared<TreeNodeConstant>(width));
     defMem(state, memTree0, reg0);
     defMem(state, memTree1, reg1);
 
     auto imm = assembly->getAsmOperands()->getOperands()[3].imm;
-    auto wbTree = TreeFactory::instance().make<TreeNodeAddition>(
+    auto wbTree = factory->makeShared<TreeNodeAddition>(
         baseTree,
-        TreeFactory::instance().make<TreeNodeConstant>(imm));
+        factory->makeShared<TreeNodeConstant>(imm));
     defReg(state, base, wbTree);
 #endif
 }
@@ -1550,32 +1563,32 @@ void UseDef::fillMemImmToRegReg(UDState *state, AssemblyPtr assembly) {
     useReg(state, base);
 
     auto baseTree
-        = TreeFactory::instance().make<TreeNodePhysicalRegister>(base, widthB);
+        = factory->makeShared<TreeNodePhysicalRegister>(base, widthB);
 
     assert(mem.index == INVALID_REGISTER);
     assert(mem.disp == 0);
 
     size_t width = (assembly->getBytes()[3] & 0b10000000) ? 8 : 4;
-    auto memTree0 = TreeFactory::instance().make<TreeNodeAddition>(
+    auto memTree0 = factory->makeShared<TreeNodeAddition>(
         baseTree,
-        TreeFactory::instance().make<TreeNodeConstant>(0));
-    auto memTree1 = TreeFactory::instance().make<TreeNodeAddition>(
+        factory->makeShared<TreeNodeConstant>(0));
+    auto memTree1 = factory->makeShared<TreeNodeAddition>(
         baseTree,
-        TreeFactory::instance().make<TreeNodeConstant>(width));
+        factory->makeShared<TreeNodeConstant>(width));
     useMem(state, memTree0, reg0);
     useMem(state, memTree1, reg1);
 
     auto derefTree0
-        = TreeFactory::instance().make<TreeNodeDereference>(memTree0, width);
+        = factory->makeShared<TreeNodeDereference>(memTree0, width);
     auto derefTree1
-        = TreeFactory::instance().make<TreeNodeDereference>(memTree1, width);
+        = factory->makeShared<TreeNodeDereference>(memTree1, width);
     defReg(state, reg0, derefTree0);
     defReg(state, reg1, derefTree1);
 
     auto imm = assembly->getAsmOperands()->getOperands()[3].imm;
-    auto wbTree = TreeFactory::instance().make<TreeNodeAddition>(
+    auto wbTree = factory->makeShared<TreeNodeAddition>(
         baseTree,
-        TreeFactory::instance().make<TreeNodeConstant>(imm));
+        factory->makeShared<TreeNodeConstant>(imm));
     defReg(state, base, wbTree);
 #endif
 }
@@ -1599,18 +1612,18 @@ void UseDef::fillRegRegRegToReg(UDState *state, AssemblyPtr assembly) {
     useReg(state, reg3);
 
     TreeNode *reg1tree
-        = TreeFactory::instance().make<TreeNodePhysicalRegister>(reg1, width1);
+        = factory->makeShared<TreeNodePhysicalRegister>(reg1, width1);
     TreeNode *reg2tree
-        = TreeFactory::instance().make<TreeNodePhysicalRegister>(reg2, width2);
+        = factory->makeShared<TreeNodePhysicalRegister>(reg2, width2);
     TreeNode *reg3tree
-        = TreeFactory::instance().make<TreeNodePhysicalRegister>(reg3, width3);
+        = factory->makeShared<TreeNodePhysicalRegister>(reg3, width3);
 
     TreeNode *tree = nullptr;
     switch(assembly->getId()) {
     case ARM64_INS_MADD: {
-        auto subtree = TreeFactory::instance().make<
+        auto subtree = factory->makeShared<
             TreeNodeMultiplication>(reg1tree, reg2tree);
-        tree = TreeFactory::instance().make<
+        tree = factory->makeShared<
             TreeNodeAddition>(subtree, reg3tree);
         break;
     }
@@ -1644,22 +1657,22 @@ TreeNode *UseDef::makeMemTree(UDState *state, const x86_op_mem& mem) {
         && mem.base == INVALID_REGISTER)) {
 
         // use TreeNodeConstant because it can be mem.disp < 0
-        memTree = TreeFactory::instance().make<TreeNodeConstant>(mem.disp);
+        memTree = factory->makeShared<TreeNodeConstant>(mem.disp);
     }
     if(mem.index != INVALID_REGISTER) {
         int regI;
         size_t widthI;
         std::tie(regI, widthI) = getPhysicalRegister(mem.index);
         useReg(state, regI);
-        TreeNode *indexTree = TreeFactory::instance().make<
+        TreeNode *indexTree = factory->makeShared<
             TreeNodePhysicalRegister>(regI, widthI);
         //if(mem.scale != 1) {
-            indexTree = TreeFactory::instance().make<TreeNodeMultiplication>(
+            indexTree = factory->makeShared<TreeNodeMultiplication>(
                 indexTree,
-                TreeFactory::instance().make<TreeNodeConstant>(mem.scale));
+                factory->makeShared<TreeNodeConstant>(mem.scale));
         //}
         if(memTree) {
-            memTree = TreeFactory::instance().make<TreeNodeAddition>(
+            memTree = factory->makeShared<TreeNodeAddition>(
                 indexTree, memTree);
         }
         else {
@@ -1671,7 +1684,7 @@ TreeNode *UseDef::makeMemTree(UDState *state, const x86_op_mem& mem) {
         TreeNode *baseTree = nullptr;
         if(mem.base == X86_REG_RIP) {
             auto instr = state->getInstruction();
-            baseTree = TreeFactory::instance().make<TreeNodeRegisterRIP>(
+            baseTree = factory->makeShared<TreeNodeRegisterRIP>(
                 instr->getAddress() + instr->getSize());
         }
         else {
@@ -1679,11 +1692,11 @@ TreeNode *UseDef::makeMemTree(UDState *state, const x86_op_mem& mem) {
             size_t widthB;
             std::tie(regB, widthB) = getPhysicalRegister(mem.base);
             useReg(state, regB);
-            baseTree = TreeFactory::instance().make<TreeNodePhysicalRegister>(
+            baseTree = factory->makeShared<TreeNodePhysicalRegister>(
                 regB, widthB);
         }
         if(memTree) {
-            memTree = TreeFactory::instance().make<TreeNodeAddition>(
+            memTree = factory->makeShared<TreeNodeAddition>(
                 baseTree, memTree);
         }
         else {
@@ -1744,11 +1757,11 @@ void UseDef::fillBt(UDState *state, AssemblyPtr assembly) {
         std::tie(reg1, width1) = getPhysicalRegister(
             assembly->getAsmOperands()->getOperands()[1].reg);
         useReg(state, reg1);
-        auto tree0 = TreeFactory::instance().make<TreeNodePhysicalRegister>(
+        auto tree0 = factory->makeShared<TreeNodePhysicalRegister>(
             reg0, width0);
-        auto tree1 = TreeFactory::instance().make<TreeNodePhysicalRegister>(
+        auto tree1 = factory->makeShared<TreeNodePhysicalRegister>(
             reg1, width1);
-        auto tree = TreeFactory::instance().make<TreeNodeAnd>(tree0, tree1);
+        auto tree = factory->makeShared<TreeNodeAnd>(tree0, tree1);
         defReg(state, X86Register::FLAGS, tree);
     }
     else if(mode == AssemblyOperands::MODE_MEM_REG) {
@@ -1786,11 +1799,11 @@ void UseDef::fillCmp(UDState *state, AssemblyPtr assembly) {
             assembly->getAsmOperands()->getOperands()[1].reg);
         useReg(state, reg1);
 
-        auto tree0 = TreeFactory::instance().make<TreeNodePhysicalRegister>(
+        auto tree0 = factory->makeShared<TreeNodePhysicalRegister>(
             reg0, width0);
-        auto tree1 = TreeFactory::instance().make<TreeNodePhysicalRegister>(
+        auto tree1 = factory->makeShared<TreeNodePhysicalRegister>(
             reg1, width1);
-        auto tree = TreeFactory::instance().make<TreeNodeComparison>(
+        auto tree = factory->makeShared<TreeNodeComparison>(
             tree1, tree0);
         defReg(state, X86Register::FLAGS, tree);
     }
@@ -1800,21 +1813,21 @@ void UseDef::fillCmp(UDState *state, AssemblyPtr assembly) {
         std::tie(reg1, width1) = getPhysicalRegister(
             assembly->getAsmOperands()->getOperands()[1].reg);
         useReg(state, reg1);
-        auto tree0 = TreeFactory::instance().make<TreeNodeConstant>(imm);
-        auto tree1 = TreeFactory::instance().make<TreeNodePhysicalRegister>(
+        auto tree0 = factory->makeShared<TreeNodeConstant>(imm);
+        auto tree1 = factory->makeShared<TreeNodePhysicalRegister>(
             reg1, width1);
-        auto tree = TreeFactory::instance().make<TreeNodeComparison>(
+        auto tree = factory->makeShared<TreeNodeComparison>(
             tree1, tree0);
         defReg(state, X86Register::FLAGS, tree);
     }
     else if(mode == AssemblyOperands::MODE_IMM_MEM) {
         auto imm = assembly->getAsmOperands()->getOperands()[0].imm;
-        auto tree0 = TreeFactory::instance().make<TreeNodeConstant>(imm);
+        auto tree0 = factory->makeShared<TreeNodeConstant>(imm);
         auto memTree = makeMemTree(
             state, assembly->getAsmOperands()->getOperands()[1].mem);
-        auto tree1 = TreeFactory::instance().make<TreeNodeDereference>(
+        auto tree1 = factory->makeShared<TreeNodeDereference>(
             memTree, 8);    // !!!
-        auto tree = TreeFactory::instance().make<TreeNodeComparison>(
+        auto tree = factory->makeShared<TreeNodeComparison>(
             tree1, tree0);
         defReg(state, X86Register::FLAGS, tree);
     }
@@ -1832,10 +1845,10 @@ void UseDef::fillInc(UDState *state, AssemblyPtr assembly) {
             assembly->getAsmOperands()->getOperands()[0].reg);
         if(reg0 < 0) return;
         useReg(state, reg0);
-        auto reg0Tree = TreeFactory::instance().make<TreeNodePhysicalRegister>(
+        auto reg0Tree = factory->makeShared<TreeNodePhysicalRegister>(
             reg0, width0);
-        auto oneTree = TreeFactory::instance().make<TreeNodeConstant>(1);
-        auto tree = TreeFactory::instance().make<TreeNodeAddition>(
+        auto oneTree = factory->makeShared<TreeNodeConstant>(1);
+        auto tree = factory->makeShared<TreeNodeAddition>(
             reg0Tree, oneTree);
         defReg(state, reg0, tree);
     }
@@ -2002,7 +2015,7 @@ void UseDef::fillXor(UDState *state, AssemblyPtr assembly) {
             std::tie(reg0, std::ignore) = getPhysicalRegister(op0);
 
             defReg(state, reg0,
-                TreeFactory::instance().make<TreeNodeConstant>(0));
+                factory->makeShared<TreeNodeConstant>(0));
         }
     }
     LOG(10, "NYI (fully): " << assembly->getMnemonic());
@@ -2090,9 +2103,9 @@ void UseDef::fillCbz(UDState *state, AssemblyPtr assembly) {
     size_t width0 = AARCH64GPRegister::getWidth(reg0, op0);
     useReg(state, reg0);
 
-    auto tree = TreeFactory::instance().make<TreeNodeComparison>(
-        TreeFactory::instance().make<TreeNodePhysicalRegister>(reg0, width0),
-        TreeFactory::instance().make<TreeNodeConstant>(0));
+    auto tree = factory->makeShared<TreeNodeComparison>(
+        factory->makeShared<TreeNodePhysicalRegister>(reg0, width0),
+        factory->makeShared<TreeNodeConstant>(0));
     defReg(state, AARCH64GPRegister::ONETIME_NZCV, tree);
 }
 void UseDef::fillCbnz(UDState *state, AssemblyPtr assembly) {
@@ -2101,9 +2114,9 @@ void UseDef::fillCbnz(UDState *state, AssemblyPtr assembly) {
     size_t width0 = AARCH64GPRegister::getWidth(reg0, op0);
     useReg(state, reg0);
 
-    auto tree = TreeFactory::instance().make<TreeNodeComparison>(
-        TreeFactory::instance().make<TreeNodePhysicalRegister>(reg0, width0),
-        TreeFactory::instance().make<TreeNodeConstant>(0));
+    auto tree = factory->makeShared<TreeNodeComparison>(
+        factory->makeShared<TreeNodePhysicalRegister>(reg0, width0),
+        factory->makeShared<TreeNodeConstant>(0));
     defReg(state, AARCH64GPRegister::ONETIME_NZCV, tree);
 }
 void UseDef::fillCmp(UDState *state, AssemblyPtr assembly) {
@@ -2113,9 +2126,9 @@ void UseDef::fillCmp(UDState *state, AssemblyPtr assembly) {
     useReg(state, reg0);
 
     auto imm = assembly->getAsmOperands()->getOperands()[1].imm;
-    auto tree = TreeFactory::instance().make<TreeNodeComparison>(
-        TreeFactory::instance().make<TreeNodePhysicalRegister>(reg0, width0),
-        TreeFactory::instance().make<TreeNodeConstant>(imm));
+    auto tree = factory->makeShared<TreeNodeComparison>(
+        factory->makeShared<TreeNodePhysicalRegister>(reg0, width0),
+        factory->makeShared<TreeNodeConstant>(imm));
     defReg(state, AARCH64GPRegister::NZCV, tree);
 }
 void UseDef::fillCsel(UDState *state, AssemblyPtr assembly) {
@@ -2124,7 +2137,7 @@ void UseDef::fillCsel(UDState *state, AssemblyPtr assembly) {
     size_t width0 = AARCH64GPRegister::getWidth(reg0, op0);
     defReg(state,
         reg0,
-        TreeFactory::instance().make<TreeNodePhysicalRegister>(reg0, width0));
+        factory->makeShared<TreeNodePhysicalRegister>(reg0, width0));
     LOG(10, "NYI: " << assembly->getMnemonic());
 }
 void UseDef::fillCset(UDState *state, AssemblyPtr assembly) {
@@ -2133,7 +2146,7 @@ void UseDef::fillCset(UDState *state, AssemblyPtr assembly) {
     size_t width0 = AARCH64GPRegister::getWidth(reg0, op0);
     defReg(state,
         reg0,
-        TreeFactory::instance().make<TreeNodePhysicalRegister>(reg0, width0));
+        factory->makeShared<TreeNodePhysicalRegister>(reg0, width0));
     LOG(10, "NYI: " << assembly->getMnemonic());
 }
 void UseDef::fillEor(UDState *state, AssemblyPtr assembly) {
@@ -2142,7 +2155,7 @@ void UseDef::fillEor(UDState *state, AssemblyPtr assembly) {
     size_t width0 = AARCH64GPRegister::getWidth(reg0, op0);
     defReg(state,
         reg0,
-        TreeFactory::instance().make<TreeNodePhysicalRegister>(reg0, width0));
+        factory->makeShared<TreeNodePhysicalRegister>(reg0, width0));
     LOG(10, "NYI (fully): " << assembly->getMnemonic());
 }
 void UseDef::fillFmov(UDState *state, AssemblyPtr assembly) {
@@ -2274,7 +2287,7 @@ void UseDef::fillOrr(UDState *state, AssemblyPtr assembly) {
     size_t width0 = AARCH64GPRegister::getWidth(reg0, op0);
     defReg(state,
         reg0,
-        TreeFactory::instance().make<TreeNodePhysicalRegister>(reg0, width0));
+        factory->makeShared<TreeNodePhysicalRegister>(reg0, width0));
     LOG(10, "NYI (fully): " << assembly->getMnemonic());
 }
 void UseDef::fillMov(UDState *state, AssemblyPtr assembly) {
@@ -2295,7 +2308,7 @@ void UseDef::fillMrs(UDState *state, AssemblyPtr assembly) {
     size_t width0 = AARCH64GPRegister::getWidth(reg0, op0);
     defReg(state,
         reg0,
-        TreeFactory::instance().make<TreeNodePhysicalRegister>(reg0, width0));
+        factory->makeShared<TreeNodePhysicalRegister>(reg0, width0));
 }
 void UseDef::fillRet(UDState *state, AssemblyPtr assembly) {
     for(int i = 0; i < 8; i++) {
@@ -2417,7 +2430,7 @@ void UseDef::fillJal(UDState *state, AssemblyPtr assembly) {
 void UseDef::fillJalr(UDState *state, AssemblyPtr assembly) {
     useReg(state, assembly->getAsmOperands()->getOperands()[1].value.reg);
     defReg(state, assembly->getAsmOperands()->getOperands()[0].value.reg,
-        TreeFactory::instance().make<TreeNodeAddress>(
+        factory->makeShared<TreeNodeAddress>(
         state->getInstruction()->getAddress() + state->getInstruction()->getSize()
         ));
 }
@@ -3,6 +3,8 @@
 
 #include <vector>
 #include <map>
+#include <utility>
+#include <cstdint>
 #include "controlflow.h"
 #include "slicingmatch.h"
 #include "instr/register.h"
@@ -15,14 +17,89 @@ class TreeNode;
 
 class UDState;
 
+/** Map from register number to ValueType, for the small dense register
+    numbers used in use-def states. A bitmask records which registers are
+    present, and the entries are kept in one vector sorted by register, so
+    an entry's index is the number of present registers below it. Empty
+    maps allocate nothing, and iteration yields (register, value) pairs in
+    the same order as a std::map would.
+*/
+template <typename ValueType>
+class RegisterMap {
+public:
+    typedef std::pair<int, ValueType> EntryType;
+    typedef std::vector<EntryType> ListType;
+    typedef typename ListType::iterator iterator;
+    typedef typename ListType::const_iterator const_iterator;
+    enum { CAPACITY = 128 };
+private:
+    uint64_t present[CAPACITY / 64];
+    ListType list;
+public:
+    RegisterMap() : present() {}
+
+    bool contains(int reg) const
+        { return inRange(reg) && (present[reg / 64] & bit(reg)); }
+    ValueType *find(int reg)
+        { return contains(reg) ? &list[indexOf(reg)].second : nullptr; }
+    const ValueType *find(int reg) const
+        { return contains(reg) ? &list[indexOf(reg)].second : nullptr; }
+    ValueType &operator [] (int reg);
+    void erase(int reg);
+    void clear();
+
+    size_t size() const { return list.size(); }
+    iterator begin() { return list.begin(); }
+    iterator end() { return list.end(); }
+    const_iterator begin() const { return list.cbegin(); }
+    const_iterator end() const { return list.cend(); }
+    const_iterator cbegin() const { return list.cbegin(); }
+    const_iterator cend() const { return list.cend(); }
+private:
+    static bool inRange(int reg) { return reg >= 0 && reg < CAPACITY; }
+    static uint64_t bit(int reg) { return uint64_t(1) << (reg % 64); }
+    size_t indexOf(int reg) const;
+};
+
+template <typename ValueType>
+ValueType &RegisterMap<ValueType>::operator [] (int reg) {
+    if(!inRange(reg)) throw "register number out of range for RegisterMap";
+    auto index = indexOf(reg);
+    if(!contains(reg)) {
+        present[reg / 64] |= bit(reg);
+        list.insert(list.begin() + index, EntryType(reg, ValueType()));
+    }
+    return list[index].second;
+}
+
+template <typename ValueType>
+void RegisterMap<ValueType>::erase(int reg) {
+    if(!contains(reg)) return;
+    list.erase(list.begin() + indexOf(reg));
+    present[reg / 64] &= ~bit(reg);
+}
+
+template <typename ValueType>
+void RegisterMap<ValueType>::clear() {
+    list.clear();
+    for(auto &word : present) word = 0;
+}
+
+template <typename ValueType>
+size_t RegisterMap<ValueType>::indexOf(int reg) const {
+    size_t index = 0;
+    for(int w = 0; w < reg / 64; w ++) {
+        index += __builtin_popcountll(present[w]);
+    }
+    return index + __builtin_popcountll(present[reg / 64] & (bit(reg) - 1));
+}
 
 // Must
 class DefList {
 private:
-    typedef std::map<int, TreeNode *> ListType;
+    typedef RegisterMap<TreeNode *> ListType;
     ListType list;
 public:
-    ~DefList();
     void set(int reg, TreeNode *tree);
     void del(int reg);
     TreeNode *get(int reg) const;
@@ -40,7 +117,7 @@ public:
 // May: evaluation must be delayed until all use-defs are determined
 class RefList {
 private:
-    typedef std::map<int, std::vector<UDState *>> ListType;
+    typedef RegisterMap<std::vector<UDState *>> ListType;
     ListType list;
 public:
     void set(int reg, UDState *origin);
@@ -57,13 +134,14 @@ public:
     ListType::const_iterator cbegin() const { return list.cbegin(); }
     ListType::const_iterator cend() const { return list.cend(); }
     size_t getCount() const { return list.size(); }
+    bool equals(const RefList &other) const;
     void dump() const;
 };
 
 // May
 class UseList {
 private:
-    typedef std::map<int, std::vector<UDState *>> ListType;
+    typedef RegisterMap<std::vector<UDState *>> ListType;
     ListType list;
 public:
     void add(int reg, UDState *state);
@@ -98,6 +176,7 @@ public:
     void addList(const MemOriginList& other);
     void del(TreeNode *place);
     void clear();
+    bool equals(const MemOriginList &other) const;
 
     ListType::iterator begin() { return list.begin(); }
     ListType::iterator end() { return list.end(); }
@@ -264,6 +343,7 @@ private:
 
     RefList *regSet;
     MemOriginList *memSet;
+    TreeFactory treeFactory;
 
 public:
     UDWorkingSet(ControlFlowGraph *cfg, bool trackPartial = false)
@@ -295,6 +375,9 @@ public:
 
     void dumpSet() const;
 
+    /** Owns the trees of all states; they are released with this set. */
+    TreeFactory &getTreeFactory() { return treeFactory; }
+
     virtual UDState *getState(Instruction *instruction)
         { return nullptr; }
 };
@@ -324,13 +407,16 @@ public:
 private:
     UDConfiguration *config;
     UDWorkingSet *working;
+    TreeFactory *factory;
 
     const static std::map<int, HandlerType> handlers;
 
 public:
     UseDef(UDConfiguration *config, UDWorkingSet *working)
-        : config(config), working(working) {}
+        : config(config), working(working),
+          factory(&working->getTreeFactory()) {}
 
+    /** Runs to a fixed point with a WorklistSolver, in the given order. */
     void analyze(const std::vector<std::vector<int>>& order);
 
     template <typename ActualType>
@@ -340,7 +426,7 @@ public:
     void cancelUseDefReg(UDState *state, int reg);
 
 private:
-    void analyzeGraph(const std::vector<int>& order);
+    bool analyzeNode(int nodeId);
     void fillState(UDState *state);
     bool callIfEnabled(UDState *state, Instruction *instruction);
 
@@ -2,6 +2,7 @@
 #define EGALITO_ANALYSIS_USEDEFUTIL_H
 
 #include "usedef.h"
+#include "util/counter.h"
 #include <vector>
 
 class TreeNode;
@@ -48,6 +49,7 @@ public:
         for(auto& s : state->getRegRef(reg)) {
             if(auto def = s->getRegDef(reg)) {
                 TreeCapture cap;
+                COUNTER_INC("tree pattern match attempts");
                 if(PatternType::matches(def, cap)) {
                     if(fn(s, cap, args...)) break;
                 }
@@ -55,6 +57,41 @@ public:
         }
     }
 
+    /** Same result as calling searchUpDef() with each pattern of a
+        TreePatternSet in turn until fn succeeds, but each def is matched
+        once against the whole set. fn also gets the pattern's index.
+    */
+    template <
+        typename PatternSetType,
+        typename StateType,
+        typename ActionType
+    >
+    static void searchUpDefAny(StateType *state, int reg, ActionType& fn) {
+        struct Match {
+            StateType *state;
+            unsigned mask;
+            TreeCapture captureList[PatternSetType::COUNT];
+        };
+        std::vector<Match> matchList;
+        for(auto& s : state->getRegRef(reg)) {
+            if(auto def = s->getRegDef(reg)) {
+                matchList.emplace_back();
+                auto &match = matchList.back();
+                COUNTER_INC("tree pattern match attempts");
+                match.state = s;
+                match.mask = PatternSetType::matches(def, match.captureList);
+                if(!match.mask) matchList.pop_back();
+            }
+        }
+
+        for(size_t i = 0; i < PatternSetType::COUNT; i ++) {
+            for(auto& match : matchList) {
+                if(!(match.mask & (1u << i))) continue;
+                if(fn(match.state, i, match.captureList[i])) return;
+            }
+        }
+    }
+
     template <
         typename PatternType,
         typename StateType,
@@ -67,6 +104,7 @@ public:
         for(auto& s : state->getRegUse(reg)) {
             for(auto& def : s->getRegDefList()) {
                 TreeCapture cap;
+                COUNTER_INC("tree pattern match attempts");
                 if(PatternType::matches(def.second, cap)) {
                     if(fn(s, def.first, cap, args...)) return;
                 }
@@ -105,6 +143,7 @@ private:
 public:
     bool operator()(UDState *state, TreeNode *tree) {
         TreeCapture cap;
+        COUNTER_INC("tree pattern match attempts");
         if(PatternType::matches(tree, cap)) {
             return ActionType::action(state, cap, &result);
         }
@@ -6,11 +6,25 @@
 #include "analysis/graph.h"
 #include "util/iter.h"
 
+/** Depth-first walk that calls preVisit() when a node is entered,
+    postVisit() when all its links are done, and lateVisit() for links to
+    nodes that were already visited. The walk keeps its own stack, since
+    the CFGs of large functions can be deeper than the native one allows.
+*/
 template <typename DerivedType>
 class DFSWalkerBase {
 private:
+    typedef ConcreteIterable<GraphNodeBase::ListType>::IteratorType
+        LinkIterator;
+    struct Frame {
+        GraphNodeBase *node;
+        LinkIterator it;
+        LinkIterator end;
+    };
+
     GraphBase *graph;
-    std::vector<bool> visited;
+    std::vector<bool> visited;  // one bit per node
+    std::vector<Frame> stack;
 
 protected:
     DFSWalkerBase(GraphBase *graph) : graph(graph) {}
@@ -36,19 +50,34 @@ protected:
 
 private:
     void walkHelper(int id, int dir) {
-        visited[id] = true;
-        preVisit(graph->get(id));
-        for(auto link : graph->get(id)->getLinks(dir)) {
-            auto n = link->getTargetID();
-            if(!visited[n]) {
-                walkHelper(link->getTargetID(), dir);
+        enter(id, dir);
+        while(!stack.empty()) {
+            auto &frame = stack.back();
+            if(frame.it == frame.end) {
+                auto node = frame.node;
+                stack.pop_back();
+                postVisit(node);
+                continue;
+            }
+
+            auto link = *frame.it;
+            ++frame.it;
+            if(!visited[link->getTargetID()]) {
+                enter(link->getTargetID(), dir);  // frame may move
             }
             else {
-                lateVisit(graph->get(id), &*link);
+                lateVisit(frame.node, &*link);
             }
         }
-        postVisit(graph->get(id));
-    };
+    }
+
+    void enter(int id, int dir) {
+        visited[id] = true;
+        auto node = graph->get(id);
+        preVisit(node);
+        auto links = node->getLinks(dir);
+        stack.push_back(Frame{node, links.begin(), links.end()});
+    }
 
     DerivedType &derived() {
         return *static_cast<DerivedType *>(this);
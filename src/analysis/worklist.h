@@ -0,0 +1,79 @@
+#ifndef EGALITO_ANALYSIS_WORKLIST_H
+#define EGALITO_ANALYSIS_WORKLIST_H
+
+#include <vector>
+#include <set>
+#include "analysis/graph.h"
+
+/** Generic worklist solver for dataflow problems over a graph.
+
+    Each node's priority is its position in the given order, normally a
+    reverse postorder or the SccOrder of a ControlFlowGraph, flattened.
+    Nodes that are not in the order are never visited. The earliest
+    pending node is always visited next, so forward problems on acyclic
+    graphs need only one visit per node.
+
+    The lattice and transfer function for a node are supplied by the
+    caller as a callable `bool transfer(int id)`. It recomputes the facts
+    of the node from its neighbours and returns true if they changed, in
+    which case the node's neighbours in Direction are queued again. Each
+    node is visited at most maxVisits times, which bounds problems whose
+    transfer function is not strictly monotone.
+*/
+template <int Direction = 1>
+class WorklistSolver {
+private:
+    GraphBase *graph;
+    std::vector<int> rank;      // priority of each node, or -1
+    std::vector<int> nodeAt;    // node at each priority
+    size_t maxVisits;
+public:
+    WorklistSolver(GraphBase *graph,
+        const std::vector<std::vector<int>> &order, size_t maxVisits = 16);
+
+    /** Returns the number of times transfer was called. */
+    template <typename TransferType>
+    size_t solve(TransferType transfer);
+};
+
+template <int Direction>
+WorklistSolver<Direction>::WorklistSolver(GraphBase *graph,
+    const std::vector<std::vector<int>> &order, size_t maxVisits)
+    : graph(graph), rank(graph->getCount(), -1), maxVisits(maxVisits) {
+
+    for(const auto &group : order) {
+        for(auto id : group) {
+            if(rank[id] != -1) continue;
+            rank[id] = nodeAt.size();
+            nodeAt.push_back(id);
+        }
+    }
+}
+
+template <int Direction>
+template <typename TransferType>
+size_t WorklistSolver<Direction>::solve(TransferType transfer) {
+    std::set<int> worklist;
+    for(size_t r = 0; r < nodeAt.size(); r ++) worklist.insert(r);
+
+    std::vector<size_t> visits(graph->getCount());
+    size_t count = 0;
+    while(!worklist.empty()) {
+        int id = nodeAt[*worklist.begin()];
+        worklist.erase(worklist.begin());
+
+        visits[id] ++;
+        count ++;
+        if(!transfer(id)) continue;
+
+        for(auto link : graph->get(id)->getLinks(Direction)) {
+            auto next = link->getTargetID();
+            if(rank[next] != -1 && visits[next] < maxVisits) {
+                worklist.insert(rank[next]);
+            }
+        }
+    }
+    return count;
+}
+
+#endif
@@ -1,3 +1,8 @@
+#include <sys/mman.h>
 #include "archive.h"
 
 const char *EgalitoArchive::SIGNATURE = "egalito\xc4";
+
+EgalitoArchive::~EgalitoArchive() {
+    if(mapping) munmap(mapping, mappingSize);
+}
@@ -2,26 +2,66 @@
 #define EGALITO_ARCHIVE_ARCHIVE_H
 
 #include <cstdint>
+#include <vector>
 #include "flatchunk.h"
 #include "chunktypes.h"
 
+/** Version 25 and later store an index of all FlatChunks (type, id,
+    offset, size) right after the header, followed by their contents. This
+    lets the reader map the file and point each FlatChunk at its bytes
+    without copying. Version 24 interleaves each header with its contents.
+
+    From version 26, the contents form one logical stream cut into blocks
+    of BLOCK_SIZE bytes, each optionally compressed; a table of (raw size,
+    stored size) pairs follows the index, and FlatChunk offsets are
+    positions in the logical stream.
+
+    From version 27, each index entry also records the segment (Module)
+    its FlatChunk was serialized under, so that Modules can be loaded in
+    parallel; chunks outside any Module use FlatChunk::NoSegment.
+
+    From version 28, Chunk contents store IDs, counts, sizes and offsets
+    as varints, and the IDs of children as deltas (see
+    ArchiveStreamWriter).
+*/
 class EgalitoArchive {
 public:
     static const char *SIGNATURE;
-    static const uint32_t VERSION = 24;
+    static const uint32_t VERSION = 28;
+    static const uint32_t FIRST_INDEXED_VERSION = 25;
+    static const uint32_t FIRST_BLOCKED_VERSION = 26;
+    static const uint32_t FIRST_SEGMENTED_VERSION = 27;
+    static const uint32_t FIRST_COMPACT_VERSION = 28;
+    static const uint32_t BLOCK_SIZE = 64 * 1024;
 private:
     FlatChunkList flatList;
     std::string sourceFilename;
     int version;
+    void *mapping;  // file contents, if read from an indexed archive
+    size_t mappingSize;
+    std::vector<char> unpacked;  // decompressed contents, if any
+    size_t segmentCount;
 public:
-    EgalitoArchive() : sourceFilename("(in-memory)"), version(VERSION) {}
+    EgalitoArchive() : sourceFilename("(in-memory)"), version(VERSION),
+        mapping(nullptr), mappingSize(0), segmentCount(0) {}
     EgalitoArchive(std::string filename, int version)
-        : sourceFilename(filename), version(version) {}
+        : sourceFilename(filename), version(version),
+        mapping(nullptr), mappingSize(0), segmentCount(0) {}
+    ~EgalitoArchive();
+
+    /** Takes ownership of a region from mmap(). */
+    void setMapping(void *mapping, size_t size)
+        { this->mapping = mapping; this->mappingSize = size; }
 
     FlatChunkList &getFlatList() { return flatList; }
     const FlatChunkList &getFlatList() const { return flatList; }
 
     int getVersion() const { return version; }
+    std::vector<char> &getUnpackedData() { return unpacked; }
+
+    FlatChunk::SegmentType newSegment() { return segmentCount ++; }
+    size_t getSegmentCount() const { return segmentCount; }
+    void setSegmentCount(size_t count) { segmentCount = count; }
 };
 
 #endif
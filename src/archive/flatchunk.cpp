@@ -3,7 +3,8 @@
 #include "chunktypes.h"  // for TYPE_UNKNOWN
 #include "log/log.h"
 
-FlatChunk::FlatChunk() : type(TYPE_UNKNOWN), id(-1), offset(0), data() {
+FlatChunk::FlatChunk() : type(TYPE_UNKNOWN), id(-1), offset(0), data(),
+    view(nullptr), viewSize(0), segment(NoSegment), instance(nullptr) {
 }
 
 FlatChunk *FlatChunkList::newFlatChunk(uint16_t type) {
@@ -13,34 +13,51 @@ public:
     typedef uint16_t FlatType;
     typedef uint32_t IDType;
     typedef uint32_t OffsetType;
+    typedef uint16_t SegmentType;
 public:
     static const IDType NoneID = static_cast<IDType>(-1);
+    static const SegmentType NoSegment = static_cast<SegmentType>(-1);
 private:
     FlatType type;
     IDType id;
     OffsetType offset;
     std::string data;
+    const char *view;  // contents inside a mapped archive, if non-null
+    uint32_t viewSize;
+    SegmentType segment;  // which Module this belongs to, for parallel load
     Chunk *instance;
 public:
     FlatChunk();
     FlatChunk(FlatType type, IDType id, std::string data = "")
-        : type(type), id(id), offset(0), data(data), instance(nullptr) {}
+        : type(type), id(id), offset(0), data(data), view(nullptr),
+        viewSize(0), segment(NoSegment), instance(nullptr) {}
 
     FlatType getType() const { return type; }
     IDType getID() const { return id; }
     OffsetType getOffset() const { return offset; }
-    uint32_t getSize() const { return data.length(); }
-    std::string getData() const { return data; }
+    SegmentType getSegment() const { return segment; }
+    uint32_t getSize() const { return view ? viewSize : data.length(); }
+    std::string getData() const
+        { return view ? std::string(view, viewSize) : data; }
+    /** Avoids copying the contents; valid while the archive is alive. */
+    const char *getDataPointer() const { return view ? view : data.data(); }
 
     template <typename ChunkType>
     ChunkType *getInstance() const { return dynamic_cast<ChunkType *>(instance); }
 
-    void appendData(const std::string &newData) { data += newData; }
+    void appendData(const std::string &newData)
+        { materialize(); data += newData; }
     void appendData(const void *newData, size_t newSize)
-        { data.append(static_cast<const char *>(newData), newSize); }
+        { materialize(); data.append(static_cast<const char *>(newData), newSize); }
+    void setView(const char *view, uint32_t size)
+        { this->view = view; this->viewSize = size; data.clear(); }
 
     void setOffset(uint32_t offset) { this->offset = offset; }
+    void setSegment(SegmentType segment) { this->segment = segment; }
     void setInstance(Chunk *instance) { this->instance = instance; }
+private:
+    void materialize()
+        { if(view) { data.assign(view, viewSize); view = nullptr; } }
 };
 
 class FlatChunkList {
@@ -1,9 +1,17 @@
 #include <fstream>
-#include <cstring>  // for std::strlen
+#include <vector>
+#include <atomic>
+#include <cstring>  // for std::strlen, std::memcpy
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "reader.h"
 #include "archive.h"
 #include "flatchunk.h"
 #include "stream.h"
+#include "util/compress.h"
+#include "util/threadpool.h"
 #include "chunk/chunk.h"
 #include "chunk/library.h"
 #include "log/log.h"
@@ -48,6 +56,16 @@ EgalitoArchive *EgalitoArchiveReader::read(std::string filename) {
     uint32_t flatCount, version;
     if(!readHeader(file, flatCount, version)) return nullptr;
 
+    if(version >= EgalitoArchive::FIRST_INDEXED_VERSION) {
+        file.close();
+        return readIndexed(filename, flatCount, version);
+    }
+    return readSequential(file, filename, flatCount, version);
+}
+
+EgalitoArchive *EgalitoArchiveReader::readSequential(std::ifstream &file,
+    const std::string &filename, uint32_t flatCount, uint32_t version) {
+
     EgalitoArchive *archive = new EgalitoArchive(filename, version);
 
     for(uint32_t i = 0; i < flatCount; i ++) {
@@ -74,6 +92,155 @@ EgalitoArchive *EgalitoArchiveReader::read(std::string filename) {
     return archive;
 }
 
+/** Reads the block table at position and sets contents to the logical
+    stream, decompressing blocks in parallel into the archive if needed.
+*/
+static bool unpackBlocks(EgalitoArchive *archive, const char *base,
+    size_t fileSize, size_t position, uint32_t blockCount,
+    const char *&contents, size_t &contentsSize) {
+
+    const size_t entrySize = 2 * sizeof(uint32_t);
+    if(position + size_t(blockCount) * entrySize > fileSize) return false;
+
+    std::vector<uint32_t> rawSize(blockCount), storedSize(blockCount);
+    std::vector<size_t> fileOffset(blockCount), rawOffset(blockCount);
+    size_t dataPosition = position + size_t(blockCount) * entrySize;
+    size_t totalRaw = 0;
+    bool anyCompressed = false;
+    for(uint32_t i = 0; i < blockCount; i ++) {
+        std::memcpy(&rawSize[i], base + position, sizeof(uint32_t));
+        std::memcpy(&storedSize[i], base + position + 4, sizeof(uint32_t));
+        position += entrySize;
+
+        fileOffset[i] = dataPosition;
+        rawOffset[i] = totalRaw;
+        dataPosition += storedSize[i];
+        totalRaw += rawSize[i];
+        if(storedSize[i] != rawSize[i]) anyCompressed = true;
+    }
+    if(dataPosition > fileSize) return false;
+
+    if(!anyCompressed) {
+        // blocks are stored back to back, so just point into the mapping
+        contents = base + position;
+        contentsSize = totalRaw;
+        return true;
+    }
+
+    auto &unpacked = archive->getUnpackedData();
+    unpacked.resize(totalRaw);
+    std::atomic<bool> ok(true);
+    ThreadPool pool;
+    pool.parallelFor(blockCount, [&] (size_t i) {
+        if(storedSize[i] == rawSize[i]) {
+            std::memcpy(&unpacked[rawOffset[i]], base + fileOffset[i],
+                rawSize[i]);
+        }
+        else if(!BlockCompressor::decompress(base + fileOffset[i],
+            storedSize[i], &unpacked[rawOffset[i]], rawSize[i])) {
+
+            ok = false;
+        }
+    });
+
+    contents = unpacked.data();
+    contentsSize = totalRaw;
+    return ok;
+}
+
+EgalitoArchive *EgalitoArchiveReader::readIndexed(const std::string &filename,
+    uint32_t flatCount, uint32_t version) {
+
+    int fd = open(filename.c_str(), O_RDONLY);
+    if(fd < 0) return nullptr;
+    struct stat st;
+    if(fstat(fd, &st) != 0) {
+        close(fd);
+        return nullptr;
+    }
+    size_t fileSize = st.st_size;
+    void *mapping = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapping == MAP_FAILED) {
+        LOG(0, "Error: could not map archive [" << filename << "]");
+        return nullptr;
+    }
+
+    EgalitoArchive *archive = new EgalitoArchive(filename, version);
+    archive->setMapping(mapping, fileSize);
+
+    const char *base = static_cast<const char *>(mapping);
+    size_t position = std::strlen(EgalitoArchive::SIGNATURE)
+        + 2 * sizeof(uint32_t);
+    bool blocked = (version >= EgalitoArchive::FIRST_BLOCKED_VERSION);
+    uint32_t blockCount = 0;
+    if(blocked) {
+        if(position + sizeof(blockCount) > fileSize) {
+            LOG(0, "Error: truncated header in archive");
+            delete archive;
+            return nullptr;
+        }
+        std::memcpy(&blockCount, base + position, sizeof(blockCount));
+        position += sizeof(blockCount);
+    }
+
+    bool segmented = (version >= EgalitoArchive::FIRST_SEGMENTED_VERSION);
+    const size_t entrySize = sizeof(uint8_t) + 3 * sizeof(uint32_t)
+        + (segmented ? sizeof(FlatChunk::SegmentType) : 0);
+    if(position + size_t(flatCount) * entrySize > fileSize) {
+        LOG(0, "Error: truncated index in archive");
+        delete archive;
+        return nullptr;
+    }
+
+    // FlatChunk offsets are relative to contents
+    const char *contents = base;
+    size_t contentsSize = fileSize;
+    if(blocked && !unpackBlocks(archive, base, fileSize,
+        position + size_t(flatCount) * entrySize, blockCount,
+        contents, contentsSize)) {
+
+        LOG(0, "Error: corrupt data blocks in archive");
+        delete archive;
+        return nullptr;
+    }
+
+    for(uint32_t i = 0; i < flatCount; i ++) {
+        uint8_t typeCode;
+        uint32_t id, offset, size;
+        std::memcpy(&typeCode, base + position, sizeof(typeCode));
+        std::memcpy(&id, base + position + 1, sizeof(id));
+        std::memcpy(&offset, base + position + 5, sizeof(offset));
+        std::memcpy(&size, base + position + 9, sizeof(size));
+        FlatChunk::SegmentType segment = FlatChunk::NoSegment;
+        if(segmented) {
+            std::memcpy(&segment, base + position + 13, sizeof(segment));
+        }
+        position += entrySize;
+
+        if(size_t(offset) + size > contentsSize) {
+            LOG(0, "Error: FlatChunk " << id << " extends past end of archive");
+            delete archive;
+            return nullptr;
+        }
+        auto type = decodeChunkType(typeCode);
+        LOG(10, "map FlatChunk id=" << id << " type=" << type);
+
+        FlatChunk *flat = new FlatChunk(type, id);
+        flat->setOffset(offset);
+        flat->setView(contents + offset, size);
+        flat->setSegment(segment);
+        if(segment != FlatChunk::NoSegment
+            && segment >= archive->getSegmentCount()) {
+
+            archive->setSegmentCount(segment + 1);
+        }
+        archive->getFlatList().addFlatChunk(flat);
+    }
+
+    return archive;
+}
+
 EgalitoArchive *EgalitoArchiveReader::read(std::string filename,
     LibraryList *libraryList) {
 
@@ -13,6 +13,10 @@ public:
 private:
     bool readHeader(std::ifstream &file, uint32_t &flatCount,
         uint32_t &version);
+    EgalitoArchive *readSequential(std::ifstream &file,
+        const std::string &filename, uint32_t flatCount, uint32_t version);
+    EgalitoArchive *readIndexed(const std::string &filename,
+        uint32_t flatCount, uint32_t version);
 };
 
 #endif
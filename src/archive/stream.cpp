@@ -1,27 +1,41 @@
-#include <sstream>
+#include <istream>
+#include <ostream>
 #include <string>
-#include <cstring>  // for std::strlen
+#include <cstring>  // for std::strlen, std::memcpy, std::memchr
 #include "stream.h"
 #include "flatchunk.h"
 
+#define BUFFERED_WRITER_RESERVE 256
+
+bool ArchiveStreamReader::readRaw(void *value, size_t length) {
+    if(stream) {
+        stream->read(static_cast<char *>(value), length);
+        return stream->operator bool ();
+    }
+
+    if(!good || static_cast<size_t>(end - cursor) < length) {
+        good = false;
+        return false;
+    }
+    std::memcpy(value, cursor, length);
+    cursor += length;
+    return true;
+}
+
 bool ArchiveStreamReader::readInto(uint8_t &value) {
-    stream.read(reinterpret_cast<char *>(&value), sizeof(value));
-    return stream.operator bool ();
+    return readRaw(&value, sizeof(value));
 }
 
 bool ArchiveStreamReader::readInto(uint16_t &value) {
-    stream.read(reinterpret_cast<char *>(&value), sizeof(value));
-    return stream.operator bool ();
+    return readRaw(&value, sizeof(value));
 }
 
 bool ArchiveStreamReader::readInto(uint32_t &value) {
-    stream.read(reinterpret_cast<char *>(&value), sizeof(value));
-    return stream.operator bool ();
+    return readRaw(&value, sizeof(value));
 }
 
 bool ArchiveStreamReader::readInto(uint64_t &value) {
-    stream.read(reinterpret_cast<char *>(&value), sizeof(value));
-    return stream.operator bool ();
+    return readRaw(&value, sizeof(value));
 }
 
 bool ArchiveStreamReader::readInto(bool &flag) { 
@@ -33,71 +47,165 @@ bool ArchiveStreamReader::readInto(bool &flag) {
 
 std::string ArchiveStreamReader::readString() {
     std::string value;
-    std::getline(stream, value, '\0');
+    if(stream) {
+        std::getline(*stream, value, '\0');
+        return std::move(value);
+    }
+
+    if(!good) return value;
+    auto terminator = static_cast<const char *>(
+        std::memchr(cursor, '\0', end - cursor));
+    if(!terminator) {
+        // like getline: consume everything, then report end of input
+        value.assign(cursor, end);
+        cursor = end;
+        good = false;
+        return std::move(value);
+    }
+    value.assign(cursor, terminator);
+    cursor = terminator + 1;
     return std::move(value);
 }
 
 std::string ArchiveStreamReader::readFixedLengthBytes(size_t length) {
+    if(!stream) return readFixedLengthView(length).toString();
+
     std::string value;
     value.resize(length);
-    stream.read(&value[0], length);
+    stream->read(&value[0], length);
     return std::move(value);
 }
 
+ArchiveBytesView ArchiveStreamReader::readFixedLengthView(size_t length) {
+    if(stream) {
+        viewBuffer.resize(length);
+        stream->read(&viewBuffer[0], length);
+        return ArchiveBytesView(viewBuffer.data(), viewBuffer.length());
+    }
+
+    if(!good || static_cast<size_t>(end - cursor) < length) {
+        good = false;
+        return ArchiveBytesView();
+    }
+    ArchiveBytesView view(cursor, length);
+    cursor += length;
+    return view;
+}
+
+FlatChunk::IDType ArchiveStreamReader::readID() {
+    if(!compact) return read<FlatChunk::IDType>();
+    return static_cast<FlatChunk::IDType>(readLEB128() - 1);
+}
+
+FlatChunk::IDType ArchiveStreamReader::readID(FlatChunk::IDType previous) {
+    if(!compact) return read<FlatChunk::IDType>();
+
+    // zigzag: even values are non-negative deltas, odd ones negative
+    uint64_t encoded = readLEB128();
+    int64_t delta = (encoded & 1) ? -static_cast<int64_t>(encoded >> 1) - 1
+        : static_cast<int64_t>(encoded >> 1);
+    return static_cast<FlatChunk::IDType>(previous + delta);
+}
+
+uint64_t ArchiveStreamReader::readLEB128() {
+    uint64_t value = 0;
+    for(unsigned shift = 0; shift < 64; shift += 7) {
+        uint8_t byte;
+        if(!readInto(byte)) return 0;
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if(!(byte & 0x80)) return value;
+    }
+    // too long to be a 64-bit value
+    if(stream) stream->setstate(std::ios::failbit);
+    else good = false;
+    return 0;
+}
+
 bool ArchiveStreamReader::stillGood() {
-    return stream.good();
+    return stream ? stream->good() : good;
+}
+
+void ArchiveStreamWriter::writeRaw(const void *value, size_t length) {
+    if(stream) stream->write(static_cast<const char *>(value), length);
+    else buffer->append(static_cast<const char *>(value), length);
 }
 
 void ArchiveStreamWriter::writeValue(uint8_t value) {
-    stream.write(reinterpret_cast<const char *>(&value), sizeof(value));
+    writeRaw(&value, sizeof(value));
 }
 
 void ArchiveStreamWriter::writeValue(uint16_t value) {
-    stream.write(reinterpret_cast<const char *>(&value), sizeof(value));
+    writeRaw(&value, sizeof(value));
 }
 
 void ArchiveStreamWriter::writeValue(uint32_t value) {
-    stream.write(reinterpret_cast<const char *>(&value), sizeof(value));
+    writeRaw(&value, sizeof(value));
 }
 
 void ArchiveStreamWriter::writeValue(uint64_t value) {
-    stream.write(reinterpret_cast<const char *>(&value), sizeof(value));
+    writeRaw(&value, sizeof(value));
+}
+
+void ArchiveStreamWriter::writeID(FlatChunk::IDType id) {
+    // NoneID wraps around to 0
+    writeVarint(static_cast<FlatChunk::IDType>(id + 1));
+}
+
+void ArchiveStreamWriter::writeID(FlatChunk::IDType id,
+    FlatChunk::IDType previous) {
+
+    int64_t delta = static_cast<int64_t>(id) - static_cast<int64_t>(previous);
+    writeVarint(delta < 0 ? (static_cast<uint64_t>(-(delta + 1)) << 1) | 1
+        : static_cast<uint64_t>(delta) << 1);
+}
+
+void ArchiveStreamWriter::writeVarint(uint64_t value) {
+    unsigned char bytes[10];
+    size_t length = 0;
+    do {
+        bytes[length] = value & 0x7f;
+        value >>= 7;
+        if(value) bytes[length] |= 0x80;
+        length ++;
+    } while(value);
+    writeRaw(bytes, length);
 }
 
 void ArchiveStreamWriter::writeString(const char *value) {
-    stream.write(value, std::strlen(value) + 1);
+    writeRaw(value, std::strlen(value) + 1);
 }
 
 void ArchiveStreamWriter::writeString(const std::string &value) {
-    stream.write(value.c_str(), value.length() + 1);
+    writeRaw(value.c_str(), value.length() + 1);
 }
 
 void ArchiveStreamWriter::writeFixedLengthBytes(const char *value,
     size_t length) {
 
-    stream.write(value, length);
+    writeRaw(value, length);
 }
 
 void ArchiveStreamWriter::writeFixedLengthBytes(const char *value) {
-    stream.write(value, std::strlen(value));
+    writeRaw(value, std::strlen(value));
 }
 
 BufferedStreamWriter::BufferedStreamWriter(FlatChunk *flat)
-    : ArchiveStreamWriter(stream), flat(flat), stream(flat->getData()) {
+    : ArchiveStreamWriter(&buffer), flat(flat) {
+
+    buffer.reserve(BUFFERED_WRITER_RESERVE);
 }
 
 BufferedStreamWriter::~BufferedStreamWriter() {
-    std::string data = stream.str();
-    if(data.length() > 0) {
-        flat->appendData(stream.str());
+    if(buffer.length() > 0) {
+        flat->appendData(buffer);
     }
 }
 
 void BufferedStreamWriter::flush() {
-    flat->appendData(stream.str());
-    stream.str(std::string());
+    flat->appendData(buffer);
+    buffer.clear();
 }
 
 InMemoryStreamReader::InMemoryStreamReader(FlatChunk *flat)
-    : ArchiveStreamReader(stream), stream(flat->getData()) {
+    : ArchiveStreamReader(flat->getDataPointer(), flat->getSize()) {
 }
@@ -2,18 +2,52 @@
 #define EGALITO_ARCHIVE_STREAM_H
 
 #include <iosfwd>
-#include <sstream>
+#include <string>
 #include <cstdint>
 
 #include "flatchunk.h"  // for FlatChunk::IDType
 
+/** Points at bytes owned by someone else, e.g. a mapped archive. */
+class ArchiveBytesView {
+private:
+    const char *data;
+    size_t length;
+public:
+    ArchiveBytesView() : data(nullptr), length(0) {}
+    ArchiveBytesView(const char *data, size_t length)
+        : data(data), length(length) {}
+
+    const char *getData() const { return data; }
+    size_t getLength() const { return length; }
+    std::string toString() const { return std::string(data, length); }
+};
+
+/** Reads archive values either from a std::istream or, without copying,
+    from a span of memory. Reads past the end of a span fail and clear
+    stillGood(), just as for a stream.
+
+    Chunk contents written with the compact encoding (see
+    ArchiveStreamWriter::writeVarint()) need setCompact(); otherwise
+    readVarint() and the ID readers expect the older fixed-width values.
+*/
 class ArchiveStreamReader {
 private:
-    std::istream &stream;
+    std::istream *stream;
+    const char *cursor, *end;  // used when stream is null
+    bool good;
+    bool compact;
+    std::string viewBuffer;  // backs views when reading from a stream
 public:
-    ArchiveStreamReader(std::istream &stream) : stream(stream) {}
+    ArchiveStreamReader(std::istream &stream)
+        : stream(&stream), cursor(nullptr), end(nullptr), good(true),
+        compact(false) {}
+    ArchiveStreamReader(const char *data, size_t size)
+        : stream(nullptr), cursor(data), end(data + size), good(true),
+        compact(false) {}
     virtual ~ArchiveStreamReader() {}
 
+    void setCompact(bool compact) { this->compact = compact; }
+
     bool readInto(uint8_t &value);
     bool readInto(uint16_t &value);
     bool readInto(uint32_t &value);
@@ -27,21 +61,50 @@ public:
         readInto(value);  // ignore return value, can check stillGood() later
         return value;
     }
-    FlatChunk::IDType readID() { return read<FlatChunk::IDType>(); }
+    FlatChunk::IDType readID();
+    /** Reads an ID written by ArchiveStreamWriter::writeID(id, previous). */
+    FlatChunk::IDType readID(FlatChunk::IDType previous);
+
+    /** Reads a value written by ArchiveStreamWriter::writeVarint(), or a
+        fixed-width ValueType if this stream is not compact. */
+    template <typename ValueType>
+    ValueType readVarint()
+        { return compact ? ValueType(readLEB128()) : read<ValueType>(); }
 
     std::string readString();  // cannot contain NULLs
     template <typename SizeType = uint32_t>
     std::string readBytes() { return readFixedLengthBytes(read<SizeType>()); }
     std::string readFixedLengthBytes(size_t length);
 
+    /** Like readBytes(), but the result is only valid until the next read
+        for stream readers, or while the underlying span lives otherwise.
+    */
+    template <typename SizeType = uint32_t>
+    ArchiveBytesView readBytesView()
+        { return readFixedLengthView(read<SizeType>()); }
+    ArchiveBytesView readFixedLengthView(size_t length);
+
     bool stillGood();
+private:
+    bool readRaw(void *value, size_t length);
+    uint64_t readLEB128();
 };
 
+/** Writes archive values to a std::ostream, or appends them to a string
+    buffer which the owner drains (see BufferedStreamWriter).
+
+    IDs, counts, sizes and offsets within Chunk contents are written as
+    unsigned LEB128 varints, since most are small; a child's ID is stored
+    as the difference from its previous sibling's. IDs are stored plus
+    one, so that NoneID takes a single byte.
+*/
 class ArchiveStreamWriter {
 private:
-    std::ostream &stream;
+    std::ostream *stream;
+    std::string *buffer;
 public:
-    ArchiveStreamWriter(std::ostream &stream) : stream(stream) {}
+    ArchiveStreamWriter(std::ostream &stream)
+        : stream(&stream), buffer(nullptr) {}
     virtual ~ArchiveStreamWriter() {}
 
     void writeValue(uint8_t value);
@@ -54,7 +117,10 @@ public:
 
     template <typename ValueType>
     void write(ValueType value) { writeValue(value); }
-    void writeID(FlatChunk::IDType id) { writeValue(id); }
+    void writeID(FlatChunk::IDType id);
+    /** Writes id relative to previous, e.g. the ID of the last sibling. */
+    void writeID(FlatChunk::IDType id, FlatChunk::IDType previous);
+    void writeVarint(uint64_t value);
 
     void writeString(const char *value);
     void writeString(const std::string &value);
@@ -67,13 +133,18 @@ public:
     void writeFixedLengthBytes(const char *value);  // runs strlen
 
     virtual void flush() {}
+protected:
+    ArchiveStreamWriter(std::string *buffer)
+        : stream(nullptr), buffer(buffer) {}
+private:
+    void writeRaw(const void *value, size_t length);
 };
 
 class FlatChunk;
 class BufferedStreamWriter : public ArchiveStreamWriter {
 private:
     FlatChunk *flat;
-    std::ostringstream stream;
+    std::string buffer;
 public:
     BufferedStreamWriter(FlatChunk *flat);
     ~BufferedStreamWriter();
@@ -81,9 +152,8 @@ public:
     void flush();
 };
 
+/** Reads straight out of the FlatChunk's data, which must outlive this. */
 class InMemoryStreamReader : public ArchiveStreamReader {
-private:
-    std::istringstream stream;
 public:
     InMemoryStreamReader(FlatChunk *flat);
 };
@@ -1,7 +1,11 @@
 #include <cstring>  // for std::strlen
 #include <fstream>
+#include <vector>
+#include <algorithm>  // for std::min
 #include "writer.h"
 #include "stream.h"
+#include "util/compress.h"
+#include "util/threadpool.h"
 #include "log/log.h"
 
 void EgalitoArchiveWriter::write(std::string filename) {
@@ -10,39 +14,67 @@ void EgalitoArchiveWriter::write(std::string filename) {
 }
 
 void EgalitoArchiveWriter::assignOffsets() {
+    // offsets are positions in the logical contents stream
     uint32_t totalSize = 0;
-    totalSize += std::strlen(EgalitoArchive::SIGNATURE);
-    totalSize += sizeof(EgalitoArchive::VERSION);
-    totalSize += sizeof(uint32_t);  // chunk count
-
     for(auto flat : archive->getFlatList()) {
         if(!flat) {
             LOG(1, "ERROR: null FlatChunk in list! Will crash soon.");
         }
         flat->setOffset(totalSize);
-        totalSize += sizeof(uint16_t) + sizeof(uint32_t)*3 + flat->getSize();
+        totalSize += flat->getSize();
     }
 }
 
 void EgalitoArchiveWriter::writeData(std::string filename) {
+    std::string contents;
+    for(auto flat : archive->getFlatList()) {
+        contents.append(flat->getDataPointer(), flat->getSize());
+    }
+
+    const size_t blockSize = EgalitoArchive::BLOCK_SIZE;
+    size_t blockCount = (contents.length() + blockSize - 1) / blockSize;
+    std::vector<std::string> packed(blockCount);
+    if(compress) {
+        ThreadPool pool;
+        pool.parallelFor(blockCount, [&] (size_t i) {
+            size_t size = std::min(blockSize, contents.length() - i*blockSize);
+            packed[i] = BlockCompressor::compress(
+                contents.data() + i*blockSize, size);
+            if(packed[i].length() >= size) packed[i].clear();  // store raw
+        });
+    }
+
     std::ofstream file(filename, std::ios::out | std::ios::binary);
+    ArchiveStreamWriter writer(file);
 
     // write the file header
-    {
-        ArchiveStreamWriter writer(file);
-        writer.writeFixedLengthBytes(EgalitoArchive::SIGNATURE);
-        writer.write<uint32_t>(EgalitoArchive::VERSION);
-        writer.write<uint32_t>(archive->getFlatList().getCount());
-    }
+    writer.writeFixedLengthBytes(EgalitoArchive::SIGNATURE);
+    writer.write<uint32_t>(EgalitoArchive::VERSION);
+    writer.write<uint32_t>(archive->getFlatList().getCount());
+    writer.write<uint32_t>(blockCount);
 
     for(auto flat : archive->getFlatList()) {
         LOG(10, "write FlatChunk id=" << flat->getID() << " type=" << flat->getType());
-        ArchiveStreamWriter writer(file);
         writer.write<uint8_t>(encodeChunkType(EgalitoChunkType(flat->getType())));
         writer.write<uint32_t>(flat->getID());
         writer.write<uint32_t>(flat->getOffset());
         writer.write<uint32_t>(flat->getSize());
-        writer.writeFixedLengthBytes(flat->getData().c_str(), flat->getSize());
+        writer.write<FlatChunk::SegmentType>(flat->getSegment());
+    }
+
+    for(size_t i = 0; i < blockCount; i ++) {
+        size_t size = std::min(blockSize, contents.length() - i*blockSize);
+        writer.write<uint32_t>(size);
+        writer.write<uint32_t>(packed[i].empty() ? size : packed[i].length());
+    }
+    for(size_t i = 0; i < blockCount; i ++) {
+        if(packed[i].empty()) {
+            size_t size = std::min(blockSize, contents.length() - i*blockSize);
+            writer.writeFixedLengthBytes(contents.data() + i*blockSize, size);
+        }
+        else {
+            writer.writeFixedLengthBytes(packed[i].data(), packed[i].length());
+        }
     }
 
     file.close();
@@ -7,8 +7,10 @@
 class EgalitoArchiveWriter {
 private:
     EgalitoArchive *archive;
+    bool compress;
 public:
-    EgalitoArchiveWriter(EgalitoArchive *archive) : archive(archive) {}
+    EgalitoArchiveWriter(EgalitoArchive *archive, bool compress = false)
+        : archive(archive), compress(compress) {}
     void write(std::string filename);
 private:
     void assignOffsets();
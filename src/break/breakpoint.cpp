@@ -1,6 +1,11 @@
 #include <iostream>
 #include <sys/mman.h>
 #include "breakpoint.h"
+#include "chunk/concrete.h"
+#include "instr/concrete.h"
+#include "instr/register.h"
+#include "operation/addinline.h"
+#include "disasm/disassemble.h"
 
 static void aligned_mprotect(unsigned long dest, unsigned long size, int protection) {
     unsigned long dest_page = dest & ~0xFFF;
@@ -8,13 +13,50 @@ static void aligned_mprotect(unsigned long dest, unsigned long size, int protect
     mprotect((void *)dest_page, bytes_rounded, protection);
 }
 
-Breakpoint::Breakpoint(address_t address) : address(address) {
+Breakpoint::Breakpoint(address_t address) : address(address),
+    originalData(0), armed(false), inlineTrap(nullptr), hitCount(0) {
+
+    arm();
+}
+
+Breakpoint::Breakpoint(Instruction *inlineTrap) : address(0),
+    originalData(0), armed(true), inlineTrap(inlineTrap), hitCount(0) {}
+
+address_t Breakpoint::getAddress() const {
+    return inlineTrap ? inlineTrap->getAddress() : address;
+}
+
+void Breakpoint::hit(void *context) {
+    hitCount ++;
+    if(action) action(this, context);
+}
+
+void Breakpoint::arm() {
+    if(armed || inlineTrap) return;
     char *p = reinterpret_cast<char *>(address);
 
     aligned_mprotect(address, 1, PROT_READ | PROT_WRITE);
     originalData = *p;
-    *p = 0xf4;
+    *p = 0xcc;  // int3
     aligned_mprotect(address, 1, PROT_READ | PROT_EXEC);
+    armed = true;
+}
+
+void Breakpoint::disarm() {
+    if(!armed || inlineTrap) return;
+    char *p = reinterpret_cast<char *>(address);
+
+    aligned_mprotect(address, 1, PROT_READ | PROT_WRITE);
+    *p = originalData;
+    aligned_mprotect(address, 1, PROT_READ | PROT_EXEC);
+    armed = false;
+}
+
+BreakpointManager::~BreakpointManager() {
+    for(auto b : list) {
+        b->disarm();
+        delete b;
+    }
 }
 
 Breakpoint *BreakpointManager::set(address_t address) {
@@ -22,5 +64,89 @@ Breakpoint *BreakpointManager::set(address_t address) {
     Breakpoint *b = new Breakpoint(address);
 
     list.push_back(b);
+    breakpointMap[address] = b;
     return b;
 }
+
+Breakpoint *BreakpointManager::setInline(Instruction *instr,
+    const BreakpointCondition &condition) {
+
+#ifdef ARCH_X86_64
+    auto trap = Disassemble::instruction({0xcc});   // int3
+
+    ChunkAddInline ai({X86_REG_EFLAGS}, [trap, condition] (unsigned int) {
+        std::vector<Instruction *> list;
+        if(condition.reg == -1) {
+            list.push_back(trap);
+            return list;
+        }
+
+        /*
+            49 81 ff 2a 00 00 00    cmp    $0x2a,%r15
+            75 01                   jne    1f
+            cc                      int3
+        1:  90                      nop
+        */
+        int reg = X86Register::convertToPhysical(condition.reg);
+        auto cmp = Disassemble::instruction({
+            static_cast<unsigned char>(0x48 | (reg >= 8 ? 0x1 : 0)), 0x81,
+            static_cast<unsigned char>(0xf8 | (reg & 7)),
+            static_cast<unsigned char>(condition.value & 0xff),
+            static_cast<unsigned char>((condition.value >> 8) & 0xff),
+            static_cast<unsigned char>((condition.value >> 16) & 0xff),
+            static_cast<unsigned char>((condition.value >> 24) & 0xff)});
+        auto skip = Disassemble::instruction({0x90});
+
+        auto jne = new Instruction();
+        auto jneSem = new ControlFlowInstruction(
+            X86_INS_JNE, jne, "\x75", "jnz", 1);
+        jneSem->setLink(new NormalLink(skip, Link::SCOPE_INTERNAL_JUMP));
+        jne->setSemantic(jneSem);
+
+        list.push_back(cmp);
+        list.push_back(jne);
+        list.push_back(trap);
+        list.push_back(skip);
+        return list;
+    });
+    ai.insertBefore(instr, true);
+
+    Breakpoint *b = new Breakpoint(trap);
+    list.push_back(b);
+    return b;
+#else
+    return nullptr;
+#endif
+}
+
+void BreakpointManager::remove(Breakpoint *breakpoint) {
+    for(auto it = breakpointMap.begin(); it != breakpointMap.end(); ++it) {
+        if((*it).second == breakpoint) {
+            breakpointMap.erase(it);
+            break;
+        }
+    }
+    for(auto it = list.begin(); it != list.end(); ++it) {
+        if(*it == breakpoint) {
+            list.erase(it);
+            break;
+        }
+    }
+    breakpoint->disarm();
+    delete breakpoint;
+}
+
+void BreakpointManager::updateInline() {
+    for(auto it = breakpointMap.begin(); it != breakpointMap.end(); ) {
+        if((*it).second->isInline()) it = breakpointMap.erase(it);
+        else ++it;
+    }
+    for(auto b : list) {
+        if(b->isInline()) breakpointMap[b->getAddress()] = b;
+    }
+}
+
+Breakpoint *BreakpointManager::find(address_t address) const {
+    auto it = breakpointMap.find(address);
+    return (it != breakpointMap.end() ? (*it).second : nullptr);
+}
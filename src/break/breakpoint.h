@@ -2,21 +2,70 @@
 #define EGALITO_BREAK_BREAKPOINT_H
 
 #include <vector>
+#include <unordered_map>
+#include <functional>
 #include "types.h"
 
+class Instruction;
+class Breakpoint;
+
+/** Called from the signal handler, with the trap's ucontext_t. */
+typedef std::function<void (Breakpoint *, void *)> BreakpointAction;
+
+/** Stops only when a 64-bit register holds a value (if reg is not -1). */
+struct BreakpointCondition {
+    int reg;        // capstone register, or -1 to always stop
+    long value;     // must fit in 32 bits (sign-extended)
+};
+
 class Breakpoint {
 private:
     address_t address;
     char originalData;
+    bool armed;
+    Instruction *inlineTrap;    // for inline breakpoints, else nullptr
+    unsigned long hitCount;
+    BreakpointAction action;
 public:
+    /** Patches an int3 over the byte at address. */
     Breakpoint(address_t address);
+    /** An int3 already in generated code, guarded by an inline condition. */
+    Breakpoint(Instruction *inlineTrap);
+
+    address_t getAddress() const;
+    bool isInline() const { return inlineTrap != nullptr; }
+    unsigned long getHitCount() const { return hitCount; }
+    void setAction(const BreakpointAction &action) { this->action = action; }
+
+    void hit(void *context);
+    void arm();
+    void disarm();
 };
 
+/** Keeps the breakpoints by trap address, so the signal handler finds one
+    with a single hash lookup.
+*/
 class BreakpointManager {
 private:
     std::vector<Breakpoint *> list;
+    std::unordered_map<address_t, Breakpoint *> breakpointMap;
 public:
+    ~BreakpointManager();
+
     Breakpoint *set(address_t address);
+    /** Inserts "if(condition) int3" before instr, which avoids a trap (and
+        the single-step after it) each time the condition is false. The
+        breakpoint is found once updateInline() is called after the code
+        has been laid out.
+    */
+    Breakpoint *setInline(Instruction *instr,
+        const BreakpointCondition &condition);
+    void remove(Breakpoint *breakpoint);
+
+    /** Rekeys inline breakpoints by the current address of their int3. */
+    void updateInline();
+
+    Breakpoint *find(address_t address) const;
 };
 
 #endif
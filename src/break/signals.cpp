@@ -2,10 +2,17 @@
 #include <cstdio>
 #include <cstdlib>
 #include "signals.h"
+#include "breakpoint.h"
 
 static void sigsegv_handler(int sig, siginfo_t *info, void *context);
+static void sigtrap_handler(int sig, siginfo_t *info, void *context);
 
-void Signals::registerHandlers() {
+static BreakpointManager *breakpointManager = nullptr;
+
+// patched breakpoint being stepped over by this thread, to re-arm after
+static thread_local Breakpoint *steppingBreakpoint = nullptr;
+
+void Signals::registerHandlers(BreakpointManager *manager) {
     {
         struct sigaction act = {};
         act.sa_sigaction = sigsegv_handler;
@@ -14,6 +21,16 @@ void Signals::registerHandlers() {
 
         sigaction(SIGSEGV, &act, nullptr);
     }
+
+    breakpointManager = manager;
+    if(manager) {
+        struct sigaction act = {};
+        act.sa_sigaction = sigtrap_handler;
+        sigemptyset(&act.sa_mask);
+        act.sa_flags = SA_SIGINFO;
+
+        sigaction(SIGTRAP, &act, nullptr);
+    }
 }
 
 void sigsegv_handler(int sig, siginfo_t *info, void *context) {
@@ -30,3 +47,38 @@ void sigsegv_handler(int sig, siginfo_t *info, void *context) {
     std::printf("received SIGSEGV at 0x%lx\n", rip);
     std::exit(1);
 }
+
+void sigtrap_handler(int sig, siginfo_t *info, void *context) {
+#ifdef ARCH_X86_64
+    ucontext_t *uc = (ucontext_t *)context;
+    auto &gregs = uc->uc_mcontext.gregs;
+    const unsigned long TRAP_FLAG = 0x100;
+
+    // the single step over a patched breakpoint's original instruction
+    if(auto b = steppingBreakpoint) {
+        steppingBreakpoint = nullptr;
+        b->arm();
+        gregs[REG_EFL] &= ~TRAP_FLAG;
+        return;
+    }
+
+    // rip is past the int3
+    unsigned long rip = gregs[REG_RIP];
+    auto b = breakpointManager->find(rip - 1);
+    if(!b) {
+        std::printf("received SIGTRAP at 0x%lx, not a breakpoint\n", rip);
+        std::exit(1);
+    }
+
+    b->hit(context);
+    if(b->isInline()) return;   // the int3 is part of the code
+
+    b->disarm();
+    gregs[REG_RIP] = rip - 1;
+    gregs[REG_EFL] |= TRAP_FLAG;
+    steppingBreakpoint = b;
+#else
+    std::printf("received SIGTRAP\n");
+    std::exit(1);
+#endif
+}
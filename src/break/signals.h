@@ -1,9 +1,12 @@
 #ifndef EGALITO_BREAK_SIGNALS_H
 #define EGALITO_BREAK_SIGNALS_H
 
+class BreakpointManager;
+
 class Signals {
 public:
-    static void registerHandlers();
+    /** Breakpoints are looked up in manager, if one is given. */
+    static void registerHandlers(BreakpointManager *manager = nullptr);
 };
 
 #endif
@@ -2,7 +2,7 @@
 #define EGALITO_CHUNK_ALIAS_MAP_H
 
 #include <string>
-#include <map>
+#include <unordered_map>
 
 class Function;
 class Module;
@@ -13,7 +13,7 @@ class Module;
 */
 class FunctionAliasMap {
 private:
-    std::map<std::string, Function *> aliasMap;
+    std::unordered_map<std::string, Function *> aliasMap;
 public:
     FunctionAliasMap(Module *module);
 
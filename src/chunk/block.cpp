@@ -27,9 +27,9 @@ void Block::serialize(ChunkSerializerOperations &op,
 
     // not called for Functions, just for PLTTrampolines
     //writer.write(getAddress());
-    writer.write(op.assign(getPreviousSibling() ? getPreviousSibling() : getParent()));
-    writer.write<size_t>(getAddress() - getParent()->getAddress());
-    writer.write<size_t>(getSize());
+    writer.writeID(op.assign(getPreviousSibling() ? getPreviousSibling() : getParent()));
+    writer.writeVarint(getAddress() - getParent()->getAddress());
+    writer.writeVarint(getSize());
 
     /*LOG(1, "serialize Block at offset " << (getAddress() - getParent()->getAddress())
         << " of size " << getSize());*/
@@ -44,10 +44,10 @@ bool Block::deserialize(ChunkSerializerOperations &op,
     //auto address = reader.read<address_t>();
     //setPosition(new AbsolutePosition(address));
     auto afterThis = op.lookup(reader.readID());
-    auto offset = reader.read<size_t>();
+    auto offset = reader.readVarint<size_t>();
     setPosition(PositionFactory::getInstance()->makePosition(afterThis, this,
         offset));
-    size_t size = reader.read<size_t>();
+    size_t size = reader.readVarint<size_t>();
 
     //LOG(1, "deserialized Block at offset " << offset << " of size " << size);
 
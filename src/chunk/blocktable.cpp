@@ -0,0 +1,130 @@
+#include <algorithm>
+#include <numeric>
+#include "blocktable.h"
+#include "concrete.h"
+#include "log/log.h"
+
+Instruction *BlockTable::Handle::findInstruction(address_t address) const {
+    if(!getRange().contains(address)) return nullptr;
+
+    address_t offset = address - getAddress();
+    size_t end = table->instructionEnd(index);
+    for(size_t i = table->firstInstructionList[index]; i < end; i ++) {
+        size_t size = table->instructionSizeList[i];
+        if(offset < size) return table->instructionList[i];
+        offset -= size;
+    }
+    return nullptr;
+}
+
+BlockTable::BlockTable(Module *module) : sorted(true) {
+    for(auto function : CIter::functions(module)) {
+        add(function);
+    }
+    finish();
+    LOG(10, "block table for " << module->getName() << " has "
+        << std::dec << getCount() << " blocks in "
+        << getFunctionCount() << " functions");
+}
+
+void BlockTable::add(Function *function) {
+    uint32_t id = functionList.size();
+    functionList.push_back(function);
+
+    for(auto block : CIter::children(function)) {
+        address_t address = block->getAddress();
+        if(!startList.empty() && address < startList.back()) sorted = false;
+
+        startList.push_back(address);
+        sizeList.push_back(block->getSize());
+        functionIdList.push_back(id);
+        firstInstructionList.push_back(instructionList.size());
+        blockList.push_back(block);
+
+        for(auto instr : CIter::children(block)) {
+            instructionSizeList.push_back(instr->getSize());
+            instructionList.push_back(instr);
+        }
+    }
+}
+
+void BlockTable::finish() {
+    if(sorted) return;
+
+    std::vector<size_t> order(startList.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [this] (size_t a, size_t b) {
+        return startList[a] < startList[b];
+    });
+
+    // rebuild every array in address order, so that the instructions of
+    // consecutive blocks are also consecutive
+    std::vector<address_t> newStart;
+    std::vector<uint32_t> newSize, newFunctionId, newFirst;
+    std::vector<Block *> newBlock;
+    std::vector<uint32_t> newInstructionSize;
+    std::vector<Instruction *> newInstruction;
+    newStart.reserve(order.size());
+    newSize.reserve(order.size());
+    newFunctionId.reserve(order.size());
+    newFirst.reserve(order.size());
+    newBlock.reserve(order.size());
+    newInstructionSize.reserve(instructionList.size());
+    newInstruction.reserve(instructionList.size());
+
+    for(auto i : order) {
+        newStart.push_back(startList[i]);
+        newSize.push_back(sizeList[i]);
+        newFunctionId.push_back(functionIdList[i]);
+        newFirst.push_back(newInstruction.size());
+        newBlock.push_back(blockList[i]);
+
+        size_t end = instructionEnd(i);
+        for(size_t j = firstInstructionList[i]; j < end; j ++) {
+            newInstructionSize.push_back(instructionSizeList[j]);
+            newInstruction.push_back(instructionList[j]);
+        }
+    }
+
+    startList.swap(newStart);
+    sizeList.swap(newSize);
+    functionIdList.swap(newFunctionId);
+    firstInstructionList.swap(newFirst);
+    blockList.swap(newBlock);
+    instructionSizeList.swap(newInstructionSize);
+    instructionList.swap(newInstruction);
+    sorted = true;
+}
+
+BlockTable::Handle BlockTable::find(address_t address) const {
+    size_t i = upperBound(address);
+    if(i == 0 || startList[i - 1] != address) return Handle();
+    return Handle(this, i - 1);
+}
+
+BlockTable::Handle BlockTable::findContaining(address_t address) const {
+    size_t i = upperBound(address);
+    if(i == 0) return Handle();
+
+    // every block starting at the same address (e.g. an empty one) is a
+    // candidate
+    address_t start = startList[i - 1];
+    for(size_t j = i; j > 0 && startList[j - 1] == start; j --) {
+        if(address < start + sizeList[j - 1]) return Handle(this, j - 1);
+    }
+    return Handle();
+}
+
+size_t BlockTable::getTotalSize() const {
+    return std::accumulate(sizeList.begin(), sizeList.end(), size_t(0));
+}
+
+size_t BlockTable::instructionEnd(size_t index) const {
+    return index + 1 < firstInstructionList.size()
+        ? firstInstructionList[index + 1] : instructionList.size();
+}
+
+size_t BlockTable::upperBound(address_t address) const {
+    return std::upper_bound(startList.begin(), startList.end(), address)
+        - startList.begin();
+}
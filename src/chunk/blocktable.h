@@ -0,0 +1,91 @@
+#ifndef EGALITO_CHUNK_BLOCK_TABLE_H
+#define EGALITO_CHUNK_BLOCK_TABLE_H
+
+#include <vector>
+#include <cstdint>
+#include "util/range.h"
+#include "types.h"
+
+class Module;
+class Function;
+class Block;
+class Instruction;
+
+/** Struct-of-arrays snapshot of the Blocks of a Module, for analyses that
+    search or scan many blocks at once.
+
+    Block start addresses, sizes, owning function ids and instruction
+    ranges are kept in parallel arrays sorted by address, so a lookup is a
+    binary search over one contiguous array of addresses, and a scan never
+    touches the Chunks or their Positions. The snapshot is not updated by
+    ChunkMutator; build a new one after changing the code.
+*/
+class BlockTable {
+public:
+    /** Lightweight reference to one entry of the table. */
+    class Handle {
+    private:
+        const BlockTable *table;
+        size_t index;
+    public:
+        Handle() : table(nullptr), index(0) {}
+        Handle(const BlockTable *table, size_t index)
+            : table(table), index(index) {}
+
+        bool isValid() const { return table != nullptr; }
+        size_t getIndex() const { return index; }
+
+        address_t getAddress() const { return table->startList[index]; }
+        size_t getSize() const { return table->sizeList[index]; }
+        Range getRange() const { return Range(getAddress(), getSize()); }
+        Block *getBlock() const { return table->blockList[index]; }
+        uint32_t getFunctionId() const { return table->functionIdList[index]; }
+        Function *getFunction() const
+            { return table->functionList[getFunctionId()]; }
+
+        size_t getInstructionCount() const
+            { return table->instructionEnd(index)
+                - table->firstInstructionList[index]; }
+        /** Returns the instruction starting at or containing address. */
+        Instruction *findInstruction(address_t address) const;
+    };
+private:
+    // one entry per block, sorted by start address
+    std::vector<address_t> startList;
+    std::vector<uint32_t> sizeList;
+    std::vector<uint32_t> functionIdList;
+    std::vector<uint32_t> firstInstructionList;
+    std::vector<Block *> blockList;
+
+    // one entry per instruction, in block order
+    std::vector<uint32_t> instructionSizeList;
+    std::vector<Instruction *> instructionList;
+
+    std::vector<Function *> functionList;
+    bool sorted;
+public:
+    BlockTable() : sorted(true) {}
+    BlockTable(Module *module);
+
+    /** Appends the blocks of function; call finish() before lookups. */
+    void add(Function *function);
+    void finish();
+
+    size_t getCount() const { return startList.size(); }
+    Handle get(size_t index) const { return Handle(this, index); }
+    size_t getFunctionCount() const { return functionList.size(); }
+    Function *getFunction(uint32_t id) const { return functionList[id]; }
+
+    /** Returns the block starting exactly at address, if any. */
+    Handle find(address_t address) const;
+    /** Returns the block containing address, if any. */
+    Handle findContaining(address_t address) const;
+
+    /** Sum of all block sizes. */
+    size_t getTotalSize() const;
+private:
+    size_t instructionEnd(size_t index) const;
+    size_t upperBound(address_t address) const;
+};
+
+#endif
@@ -22,30 +22,80 @@ void ChunkCache::make(Chunk *chunk) {
         for(auto i : CIter::children(block)) {
             auto semantic = i->getSemantic();
             semantic->accept(&writer);
-            if(auto link = semantic->getLink()) {
-                if(dynamic_cast<DataOffsetLink *>(link)) {
-                    auto v = dynamic_cast<LinkedInstruction *>(semantic);
-                    assert(v);
-
-                    fixups.push_back(i->getAddress() + v->getDispOffset()
-                        - chunk->getAddress());
-                    IF_LOG(10) {
-                        ChunkDumper d;
-                        i->accept(&d);
-                    }
-                }
+            auto link = semantic->getLink();
+            if(!link) continue;
+
+            auto offset = i->getAddress() - chunk->getAddress();
+            if(auto v = dynamic_cast<LinkedInstructionBase *>(semantic)) {
+                addFixup(chunk, offset + v->getDispOffset(), link,
+                    v->getDispSize());
+            }
+            else if(auto v = dynamic_cast<ControlFlowInstructionBase *>(
+                semantic)) {
+
+                addFixup(chunk, offset + v->getDispOffset(), link,
+                    v->getDisplacementSize());
+            }
+            else {
+                LOG(10, "    no fixup kind for link at 0x"
+                    << std::hex << i->getAddress());
+                valid = false;
+            }
+            IF_LOG(10) {
+                ChunkDumper d;
+                i->accept(&d);
             }
         }
     }
+#else
+    valid = false;
 #endif
 }
 
+void ChunkCache::addFixup(Chunk *chunk, address_t offset, Link *link,
+    size_t dispSize) {
+
+    auto target = link->getTargetAddress();
+    bool inside = chunk->getAddress() <= target
+        && target < chunk->getAddress() + chunk->getSize();
+    bool relative = link->isRIPRelative();
+    if(relative == inside) return;  // unchanged by a move
+
+    if(relative && dispSize == 4) {
+        fixups.push_back(Fixup{static_cast<uint32_t>(offset), FIXUP_REL32});
+    }
+    else if(!relative && dispSize == 4) {
+        fixups.push_back(Fixup{static_cast<uint32_t>(offset), FIXUP_ABS32});
+    }
+    else if(!relative && dispSize == 8) {
+        fixups.push_back(Fixup{static_cast<uint32_t>(offset), FIXUP_ABS64});
+    }
+    else {
+        // e.g. a rel8 jump to a neighbouring chunk
+        LOG(10, "    unsupported fixup of size " << dispSize);
+        valid = false;
+    }
+}
+
 void ChunkCache::copyAndFix(char *output) {
     std::memcpy(output, data.c_str(), data.size());
-    for(auto offset : fixups) {
-        uint32_t *point = reinterpret_cast<uint32_t *>(output + offset);
-        int32_t delta = address - reinterpret_cast<address_t>(output);
-        *point = *reinterpret_cast<const uint32_t *>(data.c_str() + offset)
-            + delta;
+
+    // how far the chunk moved; two's complement makes the sums wrap
+    uint64_t delta = reinterpret_cast<address_t>(output) - address;
+    for(const auto &fixup : fixups) {
+        char *point = output + fixup.offset;
+        if(fixup.type == FIXUP_ABS64) {
+            uint64_t value;
+            std::memcpy(&value, point, sizeof(value));
+            value += delta;
+            std::memcpy(point, &value, sizeof(value));
+        }
+        else {
+            uint32_t value;
+            std::memcpy(&value, point, sizeof(value));
+            if(fixup.type == FIXUP_REL32) value -= static_cast<uint32_t>(delta);
+            else value += static_cast<uint32_t>(delta);
+            std::memcpy(point, &value, sizeof(value));
+        }
     }
 }
@@ -3,21 +3,50 @@
 
 #include <string>
 #include <vector>
+#include <cstdint>
 
 #include "instr/instr.h"
 
 class Chunk;
+class Link;
 
+/** Encoded bytes of a chunk, plus the fields that change when the chunk
+    is emitted at another address, so that re-emission (e.g. on every JIT
+    shuffle) is a memcpy and a short patch loop instead of re-encoding.
+
+    References inside the chunk that are PC-relative, and references
+    outside it that are absolute (including %gs offsets), don't change.
+    Only the other two combinations need a fixup, which assumes targets
+    outside the chunk stay put (data, or code reached through %gs in JIT
+    mode). A chunk whose links
+    can't all be described this way gets an invalid cache and is always
+    generated from its instructions.
+*/
 class ChunkCache {
+public:
+    enum FixupType {
+        FIXUP_REL32,    // PC-relative to outside the chunk
+        FIXUP_ABS32,    // absolute reference into the chunk
+        FIXUP_ABS64,
+    };
+    struct Fixup {
+        uint32_t offset;
+        FixupType type;
+    };
 private:
     address_t address;
     std::string data;
-    std::vector<address_t> fixups;
+    std::vector<Fixup> fixups;
+    bool valid;
 public:
-    ChunkCache(Chunk *chunk) { make(chunk); }
+    ChunkCache(Chunk *chunk) : address(0), valid(true) { make(chunk); }
+    bool isValid() const { return valid; }
+    /** Writes the chunk to output, which must be its new address. */
     void copyAndFix(char *output);
 private:
     void make(Chunk *chunk);
+    void addFixup(Chunk *chunk, address_t offset, Link *link,
+        size_t dispSize);
 };
 
 #endif
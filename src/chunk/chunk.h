@@ -34,6 +34,7 @@ public:
     enum PositionIndex {
         POSITION_OLD = 0,
         POSITION_JIT_GS,
+        POSITION_FROZEN,
     };
 public:
     virtual ~Chunk() {}
@@ -59,6 +60,8 @@ public:
 
     virtual PositionIndex getPositionIndex() const = 0;
     virtual void setPositionIndex(PositionIndex index) = 0;
+    virtual uint32_t getFrozenIndex() const = 0;
+    virtual void setFrozenIndex(uint32_t index) = 0;
     virtual address_t getAddress() const = 0;
     virtual Range getRange() const = 0;
 
@@ -79,10 +82,11 @@ class ChunkImpl : public Chunk {
 private:
     Chunk *parent, *prev, *next;
     PositionIndex positionIndex;
+    uint32_t frozenIndex;  // only meaningful for POSITION_FROZEN
 public:
     ChunkImpl(Chunk *parent = nullptr)
         : parent(parent), prev(nullptr), next(nullptr),
-        positionIndex(POSITION_OLD) {}
+        positionIndex(POSITION_OLD), frozenIndex(0) {}
 
     virtual std::string getName() const { return "???"; }
 
@@ -106,6 +110,8 @@ public:
     virtual PositionIndex getPositionIndex() const { return positionIndex; }
     virtual void setPositionIndex(PositionIndex index)
         { this->positionIndex = index; }
+    virtual uint32_t getFrozenIndex() const { return frozenIndex; }
+    virtual void setFrozenIndex(uint32_t index) { frozenIndex = index; }
     virtual address_t getAddress() const;
     virtual Range getRange() const;
 
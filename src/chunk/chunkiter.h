@@ -13,7 +13,8 @@ template <typename BaseType>
 class CIterChildren {
 private:
     typedef typename BaseType::ChunkChildType ChildType;
-    typedef std::vector<ChildType *> ChildListType;
+    typedef typename IterableChunkList<ChildType>::ChildListType
+        ChildListType;
     BaseType *base;
 public:
     CIterChildren(BaseType *base) : base(base) {}
@@ -30,7 +31,7 @@ private:
 public:
     CIterFunctions(Module *module) : module(module) {}
 
-    std::vector<Function *>::iterator begin()
+    IterableChunkList<Function>::ChildListType::iterator begin()
         { return module->getFunctionList()->getChildren()->getIterable()->iterable().begin(); }
 };
 
@@ -65,6 +66,26 @@ public:
         { return CIterChildren<Program>(program); }
     static CIterChildren<LibraryList> libraries(Program *program)
         { return CIterChildren<LibraryList>(program->getLibraryList()); }
+
+    /** Calls callback on every Instruction, walking the typed child vectors
+        directly. Unlike ChunkPass::recurse(), there is no accept()/visit()
+        double dispatch per Instruction, and the callback can be inlined.
+    */
+    template <typename Callback>
+    static void forEachInstruction(Function *function, Callback &&callback) {
+        for(auto block : children(function)) {
+            for(auto instr : children(block)) {
+                callback(instr);
+            }
+        }
+    }
+    template <typename Callback>
+    static void forEachInstruction(Module *module, Callback &&callback) {
+        for(auto function : functions(module)) {
+            forEachInstruction(function, callback);
+        }
+    }
+
 };
 
 #endif
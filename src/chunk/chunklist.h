@@ -3,10 +3,12 @@
 
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <string>
 #include <algorithm>
 #include "chunk.h"
 #include "util/iter.h"
+#include "util/smallvector.h"
 #include "types.h"
 
 // forward declarations
@@ -117,12 +119,22 @@ void ChunkListImpl<ChildType>::createNamed() {
     for(auto c : iterable.iterable()) named->add(c);
 }
 
+/** Ordered list of children. Short lists are stored inline (see
+    SmallVector). indexOf() first checks the neighbourhood of the last
+    index it returned or inserted at, so that mutators which walk forward
+    through a list while inserting (ChunkMutator::insertAfter, in a loop)
+    find their insertion point without a linear scan.
+*/
 template <typename ChildType>
 class IterableChunkList {
+public:
+    typedef SmallVector<ChildType *, 4> ChildListType;
 private:
-    typedef std::vector<ChildType *> ChildListType;
     ChildListType childList;
+    size_t hint;
 public:
+    IterableChunkList() : hint(0) {}
+
     ConcreteIterable<ChildListType> iterable()
         { return ConcreteIterable<ChildListType>(childList); }
     Iterable<Chunk *> genericIterable()
@@ -135,7 +147,7 @@ public:
     ChildType *get(size_t index) { return childList[index]; }
     ChildType *getLast() { return childList.size() ? childList[childList.size() - 1] : nullptr; }
     void insertAt(size_t index, ChildType *child)
-        { childList.insert(childList.begin() + index, child); }
+        { childList.insert(childList.begin() + index, child); hint = index; }
     size_t getCount() const { return childList.size(); }
     size_t indexOf(ChildType *child);
 };
@@ -155,44 +167,105 @@ void IterableChunkList<ChildType>::removeLast() {
 
 template <typename ChildType>
 size_t IterableChunkList<ChildType>::indexOf(ChildType *child) {
-    for(size_t i = 0; i < childList.size(); i ++) {
-        if(child == childList[i]) return i;
+    size_t size = childList.size();
+    for(size_t i = (hint ? hint - 1 : 0); i < size && i <= hint + 1; i ++) {
+        if(child == childList[i]) return hint = i;
+    }
+
+    for(size_t i = 0; i < size; i ++) {
+        if(child == childList[i]) return hint = i;
     }
 
     return static_cast<size_t>(-1);
 }
 
+/** Address index over a list of Chunks.
+
+    Insertions and removals go into a std::map. Lookups use a sorted array
+    snapshot of the map, built on the first lookup after a modification,
+    with a branch-free binary search over a contiguous array of addresses.
+    Like the map itself, the snapshot records addresses and sizes at the
+    time it was built, so run ClearSpatialPass after moving or resizing
+    children.
+*/
 template <typename ChildType>
 class SpatialChunkList {
 private:
     typedef std::map<address_t, ChildType *> SpaceMapType;
     SpaceMapType spaceMap;
+
+    bool sortedValid;
+    std::vector<address_t> sortedAddress;
+    std::vector<ChildType *> sortedChild;
+    std::vector<address_t> maxEnd;  // highest end among entries [0, i]
 public:
+    SpatialChunkList() : sortedValid(false) {}
+
     ConcreteIterable<SpaceMapType, std::pair<address_t, ChildType *>> iterable() { return spaceMap; }
     void add(ChildType *child)
-        { spaceMap[child->getAddress()] = child; }
+        { spaceMap[child->getAddress()] = child; sortedValid = false; }
     void remove(ChildType *child)
-        { spaceMap.erase(child->getAddress()); }
+        { spaceMap.erase(child->getAddress()); sortedValid = false; }
 
     ChildType *find(address_t address);
     ChildType *findContaining(address_t address);
     std::vector<ChildType *> findAllContaining(address_t address);
     std::vector<ChildType *> findAllWithin(Range range);
+private:
+    void buildSorted();
+    size_t upperBound(address_t address);
 };
 
+template <typename ChildType>
+void SpatialChunkList<ChildType>::buildSorted() {
+    sortedAddress.clear();
+    sortedChild.clear();
+    maxEnd.clear();
+    sortedAddress.reserve(spaceMap.size());
+    sortedChild.reserve(spaceMap.size());
+    maxEnd.reserve(spaceMap.size());
+
+    address_t highest = 0;
+    for(const auto &kv : spaceMap) {
+        sortedAddress.push_back(kv.first);
+        sortedChild.push_back(kv.second);
+        highest = std::max(highest, kv.second->getRange().getEnd());
+        maxEnd.push_back(highest);
+    }
+    sortedValid = true;
+}
+
+/** Returns the index of the first entry whose address is > address. */
+template <typename ChildType>
+size_t SpatialChunkList<ChildType>::upperBound(address_t address) {
+    if(!sortedValid) buildSorted();
+
+    size_t count = sortedAddress.size();
+    if(count == 0) return 0;
+
+    const address_t *base = sortedAddress.data();
+    while(count > 1) {
+        size_t half = count / 2;
+        base = (base[half] <= address) ? base + half : base;
+        count -= half;
+    }
+    return (base - sortedAddress.data()) + (*base <= address);
+}
+
 template <typename ChildType>
 ChildType *SpatialChunkList<ChildType>::find(address_t address) {
+    // exact lookups don't need the sorted arrays, so alternating adds and
+    // finds (as when creating DataVariables) doesn't rebuild them each time
     auto it = spaceMap.find(address);
-    return (it != spaceMap.end() ? (*it).second : nullptr);
+    return (it != spaceMap.end()) ? (*it).second : nullptr;
 }
 
 template <typename ChildType>
 ChildType *SpatialChunkList<ChildType>::findContaining(address_t address) {
-    auto it = spaceMap.upper_bound(address);
-    if(it == spaceMap.begin()) return nullptr;
+    size_t i = upperBound(address);
+    if(i == 0) return nullptr;
 
-    it --;
-    auto c = (*it).second;
+    auto c = sortedChild[i - 1];
     return (c->getRange().contains(address) ? c : nullptr);
 }
 
@@ -200,16 +273,13 @@ template <typename ChildType>
 std::vector<ChildType *> SpatialChunkList<ChildType>
     ::findAllContaining(address_t address) {
 
+    // walk backwards until no earlier entry can reach this address, which
+    // handles any amount of overlap (e.g. ORIG and ORIG_nocancel)
     std::vector<ChildType *> found;
-    auto it = spaceMap.upper_bound(address);
-    if(it == spaceMap.begin()) return std::move(found);
-
-    // This is a terrible hack to only look in a neighbourhood of 5 for
-    // overlapping entities. Should work since the typical case for this is
-    // to detect overlapping functions, which are 2: ORIG and ORIG_nocancel.
-    for(int i = 0; i < 5 && it != spaceMap.begin(); i ++) {
-        it --;
-        auto c = (*it).second;
+    for(size_t i = upperBound(address); i > 0 && maxEnd[i - 1] > address;
+        i --) {
+
+        auto c = sortedChild[i - 1];
         if(c->getRange().contains(address)) found.push_back(c);
     }
     return std::move(found);
@@ -220,9 +290,10 @@ std::vector<ChildType *> SpatialChunkList<ChildType>
     ::findAllWithin(Range range) {
 
     std::vector<ChildType *> found;
-    auto it = spaceMap.upper_bound(range.getStart());
-    for( ; it != spaceMap.end(); ++it) {
-        auto chunk = (*it).second;
+    for(size_t i = upperBound(range.getStart()); i < sortedChild.size();
+        i ++) {
+
+        auto chunk = sortedChild[i];
         if(range.contains(chunk->getRange())) {
             found.push_back(chunk);
         }
@@ -235,7 +306,7 @@ std::vector<ChildType *> SpatialChunkList<ChildType>
 template <typename ChildType>
 class NamedChunkList {
 private:
-    typedef std::map<std::string, ChildType *> NameMapType;
+    typedef std::unordered_map<std::string, ChildType *> NameMapType;
     NameMapType nameMap;
 public:
     void add(ChildType *child)
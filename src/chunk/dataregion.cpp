@@ -2,6 +2,7 @@
 #include <iomanip>
 #include "dataregion.h"
 #include "link.h"
+#include "linkindex.h"
 #include "position.h"
 #include "concrete.h"
 #include "serializer.h"
@@ -117,6 +118,17 @@ DataVariable::DataVariable(DataSection *section, address_t address, Link *dest)
 
     auto offset = address - section->getAddress();
     this->setPosition(new AbsoluteOffsetPosition(this, offset));
+
+    if(auto index = LinkIndex::getInstance()) index->update(this, dest);
+}
+
+DataVariable::~DataVariable() {
+    if(auto index = LinkIndex::getInstance()) index->remove(this);
+}
+
+void DataVariable::setDest(Link *dest) {
+    this->dest = dest;
+    if(auto index = LinkIndex::getInstance()) index->update(this, dest);
 }
 
 void DataVariable::serialize(ChunkSerializerOperations &op,
@@ -258,11 +270,20 @@ DataRegion::DataRegion(ElfMap *elfMap, ElfXX_Phdr *phdr) {
     permissions = phdr->p_flags;
     alignment = phdr->p_align;
 
-    auto readAddress = elfMap->getCharmap() + phdr->p_offset;
-    dataBytes.assign(readAddress, phdr->p_filesz);
+    // the ElfSpace keeps the ElfMap alive as long as the Module
+    mappedBytes = elfMap->getCharmap() + phdr->p_offset;
+    mappedSize = phdr->p_filesz;
     // note: dataBytes may store less than getSize(). Padded with zeros.
 }
 
+const std::string &DataRegion::getDataBytes() const {
+    if(mappedBytes) {
+        dataBytes.assign(mappedBytes, mappedSize);
+        mappedBytes = nullptr;
+    }
+    return dataBytes;
+}
+
 void DataRegion::saveDataBytes(bool captureUninitializedData) {
     const char *address = reinterpret_cast<const char *>(getAddress());
 
@@ -270,14 +291,17 @@ void DataRegion::saveDataBytes(bool captureUninitializedData) {
     // data bytes then we may want to capture any modifications that were
     // made e.g. by links or relocations. Essentially, we convert it to
     // initialized data.
-    size_t size = captureUninitializedData ? getSize() : dataBytes.size();
+    size_t size = captureUninitializedData
+        ? getSize() : getSizeOfInitializedData();
 
     dataBytes.assign(address, size);
+    mappedBytes = nullptr;
 }
 
 void DataRegion::saveDataBytes(const std::string &str) {
     assert(str.length() == size);
     dataBytes = str;
+    mappedBytes = nullptr;
 }
 
 std::string DataRegion::getName() const {
@@ -335,7 +359,7 @@ void DataRegion::serialize(ChunkSerializerOperations &op,
     writer.write(originalAddress);
     writer.write(permissions);
     writer.write(alignment);
-    writer.writeBytes<uint64_t>(dataBytes);
+    writer.writeBytes<uint64_t>(getDataBytes());
 
     op.serializeChildren(this, writer);
 }
@@ -351,6 +375,7 @@ bool DataRegion::deserialize(ChunkSerializerOperations &op,
     reader.readInto(this->permissions);
     reader.readInto(this->alignment);
     dataBytes = std::move(reader.readBytes<uint64_t>());
+    mappedBytes = nullptr;
 
     op.deserializeChildren(this, reader);
     return reader.stillGood();
@@ -72,12 +72,13 @@ public:
 
     // After constructing, manually append this DataVariable to its Section.
     DataVariable(DataSection *section, address_t address, Link *dest);
+    virtual ~DataVariable();
 
     std::string getName() const { return name; }
     void setName(const std::string &name) { this->name = name; }
 
     Link *getDest() const { return dest; }
-    void setDest(Link *dest) { this->dest = dest; }
+    void setDest(Link *dest);
 
     size_t getSize() const { return size; }
     void setSize(size_t size) { this->size = size; }
@@ -162,19 +163,28 @@ private:
     size_t size;
     uint32_t permissions;
     address_t alignment;
-    std::string dataBytes;
+    mutable std::string dataBytes;
+    mutable const char *mappedBytes;    // in the ElfMap, until copied
+    size_t mappedSize;
 public:
     DataRegion(address_t originalAddress = 0)
         : originalAddress(originalAddress), size(0), permissions(0),
-        alignment(0) {}
+        alignment(0), mappedBytes(nullptr), mappedSize(0) {}
     DataRegion(ElfMap *elfMap, ElfXX_Phdr *phdr);
     virtual ~DataRegion() {}
 
     virtual std::string getName() const;
     virtual size_t getSize() const { return size; }
     virtual void setSize(size_t sz) { size = sz; }
-    const std::string &getDataBytes() const { return dataBytes; }
-    size_t getSizeOfInitializedData() const { return dataBytes.length(); }
+    /** A region parsed from an ELF views the file's bytes until they are
+        first needed as a string. Like the spatial lists, that first copy
+        isn't thread-safe. */
+    const std::string &getDataBytes() const;
+    /** The initialized bytes, without making a copy. */
+    const char *getDataPointer() const
+        { return mappedBytes ? mappedBytes : dataBytes.data(); }
+    size_t getSizeOfInitializedData() const
+        { return mappedBytes ? mappedSize : dataBytes.length(); }
     void saveDataBytes(bool captureUninitializedData = true);
     void saveDataBytes(const std::string &str);
     virtual void addToSize(diff_t add) { /* ignored */ }
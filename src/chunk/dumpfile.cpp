@@ -0,0 +1,220 @@
+#include <atomic>
+#include <cstdio>
+#include <vector>
+#include "dumpfile.h"
+#include "dump.h"
+#include "concrete.h"
+#include "instr/writer.h"
+#include "pass/chunkpass.h"
+#include "util/bufferedfile.h"
+#include "util/threadpool.h"
+#include "log/log.h"
+
+namespace {
+    /** Emits one JSON object per line, formatting by hand into a reused
+        line buffer. */
+    class JsonLinesDumper : public ChunkPass {
+    private:
+        std::ostream &out;
+        bool showBasicBlocks;
+        std::string line;
+        Function *function;
+    public:
+        JsonLinesDumper(std::ostream &out, bool showBasicBlocks)
+            : out(out), showBasicBlocks(showBasicBlocks), function(nullptr) {}
+
+        virtual void visit(Module *module);
+        virtual void visit(Function *function);
+        virtual void visit(Block *block);
+        virtual void visit(Instruction *instruction);
+        virtual void visit(PLTTrampoline *trampoline);
+        virtual void visit(JumpTable *jumpTable);
+        virtual void visit(DataRegionList *dataRegionList) {}
+        virtual void visit(VTableList *vtableList) {}
+        virtual void visit(ExternalSymbolList *externalSymbolList) {}
+        virtual void visit(LibraryList *libraryList) {}
+    private:
+        void begin(const char *kind);
+        void end();
+        void addString(const char *key, const std::string &value);
+        void addAddress(const char *key, address_t value);
+        void addNumber(const char *key, long value);
+        void addBytes(const char *key, const std::string &bytes);
+    };
+
+    void JsonLinesDumper::visit(Module *module) {
+        begin("module");
+        addString("name", module->getName());
+        end();
+        recurse(module);
+    }
+
+    void JsonLinesDumper::visit(Function *function) {
+        this->function = function;
+        begin("function");
+        addString("name", function->getName());
+        addAddress("address", function->getAddress());
+        addNumber("size", function->getSize());
+        end();
+        recurse(function);
+        this->function = nullptr;
+    }
+
+    void JsonLinesDumper::visit(Block *block) {
+        if(showBasicBlocks) {
+            begin("block");
+            addString("name", block->getName());
+            addAddress("address", block->getAddress());
+            addNumber("size", block->getSize());
+            end();
+        }
+        recurse(block);
+    }
+
+    void JsonLinesDumper::visit(Instruction *instruction) {
+        auto semantic = instruction->getSemantic();
+        InstrWriterGetData writer;
+        semantic->accept(&writer);
+
+        begin("instruction");
+        addAddress("address", instruction->getAddress());
+        if(function) {
+            addNumber("offset",
+                instruction->getAddress() - function->getAddress());
+        }
+        addBytes("bytes", writer.get());
+        if(auto link = semantic->getLink()) {
+            addAddress("target", link->getTargetAddress());
+            if(auto target = link->getTarget()) {
+                addString("targetName", target->getName());
+            }
+        }
+        end();
+    }
+
+    void JsonLinesDumper::visit(PLTTrampoline *trampoline) {
+        begin("plt");
+        addString("name", trampoline->getName());
+        addAddress("address", trampoline->getAddress());
+        addNumber("size", trampoline->getSize());
+        end();
+    }
+
+    void JsonLinesDumper::visit(JumpTable *jumpTable) {
+        begin("jumptable");
+        if(auto owner = jumpTable->getFunction()) {
+            addString("function", owner->getName());
+        }
+        addAddress("address", jumpTable->getAddress());
+        addNumber("entries", jumpTable->getEntryCount());
+        end();
+    }
+
+    void JsonLinesDumper::begin(const char *kind) {
+        line = "{\"kind\":\"";
+        line += kind;
+        line += '"';
+    }
+
+    void JsonLinesDumper::end() {
+        line += "}\n";
+        out.write(line.data(), line.size());
+    }
+
+    void JsonLinesDumper::addString(const char *key,
+        const std::string &value) {
+
+        line += ",\"";
+        line += key;
+        line += "\":\"";
+        for(char c : value) {
+            if(c == '"' || c == '\\') {
+                line += '\\';
+                line += c;
+            }
+            else if(static_cast<unsigned char>(c) < 0x20) {
+                char escape[8];
+                std::snprintf(escape, sizeof escape, "\\u%04x", c);
+                line += escape;
+            }
+            else line += c;
+        }
+        line += '"';
+    }
+
+    void JsonLinesDumper::addAddress(const char *key, address_t value) {
+        char buffer[32];
+        std::snprintf(buffer, sizeof buffer, "\"0x%lx\"",
+            static_cast<unsigned long>(value));
+        line += ",\"";
+        line += key;
+        line += "\":";
+        line += buffer;
+    }
+
+    void JsonLinesDumper::addNumber(const char *key, long value) {
+        char buffer[32];
+        std::snprintf(buffer, sizeof buffer, "%ld", value);
+        line += ",\"";
+        line += key;
+        line += "\":";
+        line += buffer;
+    }
+
+    void JsonLinesDumper::addBytes(const char *key, const std::string &bytes) {
+        static const char hex[] = "0123456789abcdef";
+        line += ",\"";
+        line += key;
+        line += "\":\"";
+        for(unsigned char c : bytes) {
+            line += hex[c >> 4];
+            line += hex[c & 0xf];
+        }
+        line += '"';
+    }
+}
+
+bool ChunkDumpFile::dumpModule(Module *module, const std::string &filename) {
+    BufferedFileStream out;
+    if(!out.open(filename)) return false;
+
+    if(format == FORMAT_JSONL) {
+        JsonLinesDumper dumper(out, showBasicBlocks);
+        module->accept(&dumper);
+    }
+    else {
+        LogStream::overrideThreadStream(&out);
+        ChunkDumper dumper(showBasicBlocks);
+        module->accept(&dumper);
+        LogStream::overrideThreadStream(nullptr);
+    }
+
+    out.flush();
+    return static_cast<bool>(out);
+}
+
+size_t ChunkDumpFile::dumpProgram(Program *program,
+    const std::string &directory) {
+
+    std::vector<Module *> moduleList;
+    for(auto module : CIter::modules(program)) {
+        moduleList.push_back(module);
+    }
+
+    std::atomic<size_t> written(0);
+    ThreadPool pool;
+    pool.parallelFor(moduleList.size(), [&] (size_t i) {
+        auto module = moduleList[i];
+        std::string filename = directory + "/" + module->getName()
+            + "." + getExtension(format);
+        if(dumpModule(module, filename)) written ++;
+    });
+
+    LOG(1, "dumped " << written.load() << " of " << moduleList.size()
+        << " modules into [" << directory << "]");
+    return written.load();
+}
+
+const char *ChunkDumpFile::getExtension(Format format) {
+    return (format == FORMAT_JSONL) ? "jsonl" : "dump";
+}
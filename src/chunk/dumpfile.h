@@ -0,0 +1,44 @@
+#ifndef EGALITO_CHUNK_DUMP_FILE_H
+#define EGALITO_CHUNK_DUMP_FILE_H
+
+#include <string>
+
+class Program;
+class Module;
+
+/** Writes ChunkDumper-style listings of whole Modules to files, for
+    diffing large libraries.
+
+    Output goes through a BufferedFileStream, so it reaches the disk one
+    megabyte per write(2) rather than one line at a time. In FORMAT_TEXT
+    the ordinary ChunkDumper runs with this thread's log output redirected
+    to the file, so what appears depends on the chunk/disasm log levels
+    just as it does on the console. FORMAT_JSONL bypasses logging and
+    Assembly formatting entirely and writes one JSON object per function,
+    block, instruction, PLT entry and jump table, for scripts to consume.
+*/
+class ChunkDumpFile {
+public:
+    enum Format {
+        FORMAT_TEXT,
+        FORMAT_JSONL
+    };
+private:
+    Format format;
+    bool showBasicBlocks;
+public:
+    ChunkDumpFile(Format format = FORMAT_TEXT, bool showBasicBlocks = true)
+        : format(format), showBasicBlocks(showBasicBlocks) {}
+
+    bool dumpModule(Module *module, const std::string &filename);
+
+    /** Dumps each Module to directory/<module name>.<dump|jsonl>, with
+        Modules spread across a ThreadPool. Returns the number of files
+        written successfully.
+    */
+    size_t dumpProgram(Program *program, const std::string &directory);
+
+    static const char *getExtension(Format format);
+};
+
+#endif
@@ -19,12 +19,19 @@
 #include "log/temp.h"
 
 void Function::makeCache() {
+    delete cache;
     this->cache = new ChunkCache(this);
+    this->cacheModification = modification;
+    if(!cache->isValid()) {
+        delete cache;
+        this->cache = nullptr;
+    }
 }
 
 Function::Function(address_t originalAddress)
     : symbol(nullptr), dynamicSymbol(nullptr), nonreturn(false),
-    ifunc(false), cache(nullptr) {
+    ifunc(false), cache(nullptr), modification(0), cacheModification(0),
+    alignment(1) {
 
     std::ostringstream stream;
     stream << "fuzzyfunc-0x" << std::hex << originalAddress;
@@ -32,7 +39,8 @@ Function::Function(address_t originalAddress)
 }
 
 Function::Function(Symbol *symbol)
-    : symbol(symbol), dynamicSymbol(nullptr), nonreturn(false), cache(nullptr) {
+    : symbol(symbol), dynamicSymbol(nullptr), nonreturn(false), cache(nullptr),
+    modification(0), cacheModification(0), alignment(1) {
 
     name = symbol->getName();
     ifunc = (symbol->getType() == Symbol::TYPE_IFUNC);
@@ -56,7 +64,7 @@ void Function::serialize(ChunkSerializerOperations &op,
 
     LOG(10, "serialize function " << getName());
 
-    writer.write(getAddress());
+    writer.writeVarint(getAddress());
     writer.writeString(getName());
     writer.write<bool>(nonreturn);
     writer.write<bool>(ifunc);
@@ -70,11 +78,9 @@ void Function::serialize(ChunkSerializerOperations &op,
     //op.serializeChildren(this, writer);  // serialize empty children!
     op.serializeChildrenIDsOnly(this, writer, 2);
 
-    writer.write<uint32_t>(
-        this->getChildren()->getIterable()->getCount());
+    writer.writeVarint(this->getChildren()->getIterable()->getCount());
     for(auto block : CIter::children(this)) {
-        writer.write<uint32_t>(
-            block->getChildren()->getIterable()->getCount());
+        writer.writeVarint(block->getChildren()->getIterable()->getCount());
         for(auto instr : CIter::children(block)) {
 #if 1
             InstrSerializer(op).serialize(instr->getSemantic(), writer);
@@ -91,7 +97,7 @@ void Function::serialize(ChunkSerializerOperations &op,
 bool Function::deserialize(ChunkSerializerOperations &op,
     ArchiveStreamReader &reader) {
 
-    uint64_t address = reader.read<address_t>();
+    uint64_t address = reader.readVarint<address_t>();
     setPosition(new AbsolutePosition(address));
     setName(reader.readString());
     nonreturn = reader.read<bool>();
@@ -110,7 +116,7 @@ bool Function::deserialize(ChunkSerializerOperations &op,
         Chunk *prevChunk1 = this;
 
         size_t totalSize = 0;
-        uint64_t blockCount = reader.read<uint32_t>();
+        uint64_t blockCount = reader.readVarint<uint32_t>();
         for(uint64_t b = 0; b < blockCount; b ++) {
             Block *block = getChildren()->getIterable()->get(b);
             block->setPosition(positionFactory->makePosition(
@@ -123,7 +129,7 @@ bool Function::deserialize(ChunkSerializerOperations &op,
 
             Chunk *prevChunk2 = block;
 
-            uint64_t instrCount = reader.read<uint32_t>();
+            uint64_t instrCount = reader.readVarint<uint32_t>();
             for(uint64_t i = 0; i < instrCount; i ++) {
                 auto instr = block->getChildren()->getIterable()->get(i);
 
@@ -19,9 +19,13 @@ private:
     bool nonreturn;
     bool ifunc;
     ChunkCache *cache;
+    unsigned long modification;  // !!! not serialized
+    unsigned long cacheModification;  // when cache was made
+    size_t alignment;  // !!! not serialized
 public:
     Function() : symbol(nullptr), dynamicSymbol(nullptr), nonreturn(false),
-        ifunc(false), cache(nullptr) {}
+        ifunc(false), cache(nullptr), modification(0), cacheModification(0),
+        alignment(1) {}
 
     /** Create a fuzzy function named according to the original address. */
     Function(address_t originalAddress);
@@ -51,7 +55,19 @@ public:
     void setIsIFunc(bool yes) { ifunc = yes; }
 
     void makeCache();
-    ChunkCache *getCache() const { return cache; }
+    /** The encoded bytes, unless the function changed since makeCache(). */
+    ChunkCache *getCache() const
+        { return modification == cacheModification ? cache : nullptr; }
+
+    /** Bumped by ChunkMutator whenever this function's contents change;
+        call markModified() by hand after editing a semantic in place.
+    */
+    unsigned long getModificationCount() const { return modification; }
+    void markModified() { modification ++; }
+
+    /** Boundary the Generator places this function's start on. */
+    size_t getAlignment() const { return alignment; }
+    void setAlignment(size_t alignment) { this->alignment = alignment; }
 };
 
 class FunctionList : public ChunkSerializerImpl<TYPE_FunctionList,
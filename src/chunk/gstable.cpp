@@ -4,6 +4,7 @@
 
 
 #define ENTRY_SIZE 8
+#define MIN_SLOTS 64
 
 GSTableEntry::IndexType GSTableEntry::getOffset() const {
     return index * ENTRY_SIZE;
@@ -33,17 +34,38 @@ GSTableEntry *GSTable::makeEntryFor(Chunk *target) {
     if(!entry) {
         entry = new GSTableEntry(target, nextIndex());
         getChildren()->add(entry);
-        entryMap[target] = entry;
+        entryList.push_back(entry);
+        if(2 * entryList.size() > entryMap.size()) rehash();
+        else entryMap[findSlot(target)] = entry;
     }
     return entry;
 }
 
 GSTableEntry *GSTable::getEntryFor(Chunk *target) {
-    auto it = entryMap.find(target);
-    if(it != entryMap.end()) {
-        return (*it).second;
+    if(entryMap.empty()) return nullptr;
+    return entryMap[findSlot(target)];
+}
+
+// the slot holding target's entry, or the empty slot where it would go
+size_t GSTable::findSlot(Chunk *target) const {
+    const size_t mask = entryMap.size() - 1;
+    auto hash = reinterpret_cast<size_t>(target);
+    size_t slot = (hash ^ (hash >> 17)) * 0x9e3779b97f4a7c15ull;
+    for(slot &= mask; ; slot = (slot + 1) & mask) {
+        auto entry = entryMap[slot];
+        if(!entry || entry->getTarget() == target) return slot;
+    }
+}
+
+// keeps the load factor at or below one half, so probes stay short
+void GSTable::rehash() {
+    size_t size = MIN_SLOTS;
+    while(size < 4 * entryList.size()) size *= 2;
+
+    entryMap.assign(size, nullptr);
+    for(auto entry : entryList) {
+        entryMap[findSlot(entry->getTarget())] = entry;
     }
-    return nullptr;
 }
 
 GSTableEntry::IndexType GSTable::offsetToIndex(GSTableEntry::IndexType offset) {
@@ -51,12 +73,12 @@ GSTableEntry::IndexType GSTable::offsetToIndex(GSTableEntry::IndexType offset) {
 }
 
 GSTableEntry *GSTable::getAtIndex(GSTableEntry::IndexType index) {
-    if(index >= getChildren()->getIterable()->getCount()) {
+    if(index >= entryList.size()) {
         LOG(1, "table overflow?");
         return nullptr;
     }
 
-    return getChildren()->getIterable()->get(index);
+    return entryList[index];
 }
 
 void GSTable::accept(ChunkVisitor *visitor) {
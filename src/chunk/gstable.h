@@ -1,7 +1,7 @@
 #ifndef EGALITO_CHUNK_GS_TABLE_H
 #define EGALITO_CHUNK_GS_TABLE_H
 
-#include <map>
+#include <vector>
 #include "chunk.h"
 #include "chunklist.h"
 #include "types.h"
@@ -26,16 +26,30 @@ public:
     virtual void accept(ChunkVisitor *visitor);
 };
 
+/** Both lookups are on the lazy-JIT critical path: the resolver maps an
+    index to its entry, and PositionManager maps a JIT-positioned chunk to
+    its index. Entries are therefore kept in a dense array in index order
+    (the same order as the children), next to an open-addressed reverse
+    index. The probe loop is written out here rather than left to a
+    std:: container, whose out-of-line helpers would have no GS entries
+    of their own when called from the resolver.
+*/
 class GSTable : public CollectionChunkImpl<GSTableEntry> {
 private:
     //Chunk *escapeTarget;
-    std::map<Chunk *, GSTableEntry *> entryMap;
+    std::vector<GSTableEntry *> entryList;    // by index
+    std::vector<GSTableEntry *> entryMap;     // hashed by target
     void *tableAddress;
     void *signalTableAddress;
     size_t reserved;
+    size_t epoch;           // advanced by ManageGS when entries move
+    size_t quiescentEpoch;  // last epoch the owning thread was seen in
+    size_t patchGeneration; // HotPatchService generation of the entries
+    size_t generateDepth;   // nesting of HotPatchService::GenerateLock
 public:
     GSTable()
-        : /* escapeTarget(nullptr), */ tableAddress(nullptr), signalTableAddress(nullptr), reserved(0) {}
+        : /* escapeTarget(nullptr), */ tableAddress(nullptr), signalTableAddress(nullptr), reserved(0),
+        epoch(0), quiescentEpoch(0), patchGeneration(0), generateDepth(0) {}
 
     // no going back
     void finishReservation();
@@ -48,6 +62,9 @@ public:
 
     GSTableEntry::IndexType offsetToIndex(GSTableEntry::IndexType offset);
     GSTableEntry *getAtIndex(GSTableEntry::IndexType index);
+    /** Like getAtIndex, for an index known to be in the table. */
+    GSTableEntry *getAtValidIndex(GSTableEntry::IndexType index) const
+        { return entryList[index]; }
 
     void setTableAddress(void *address) { tableAddress = address; }
     void *getTableAddress() const { return tableAddress; }
@@ -55,10 +72,19 @@ public:
     void setSignalTableAddress(void *address) { signalTableAddress = address; }
     void *getSignalTableAddress() const { return signalTableAddress; }
 
+    size_t *getEpochAddress() { return &epoch; }
+    size_t *getQuiescentEpochAddress() { return &quiescentEpoch; }
+    size_t getPatchGeneration() const { return patchGeneration; }
+    void setPatchGeneration(size_t generation)
+        { patchGeneration = generation; }
+    size_t *getGenerateDepthAddress() { return &generateDepth; }
+
     virtual void accept(ChunkVisitor *visitor);
 private:
     GSTableEntry *makeEntryFor(Chunk *target);
-    GSTableEntry::IndexType nextIndex() const { return entryMap.size(); }
+    GSTableEntry::IndexType nextIndex() const { return entryList.size(); }
+    size_t findSlot(Chunk *target) const;
+    void rehash();
     bool reserving() const { return reserved == 0; }
 };
 
@@ -65,6 +65,9 @@ void JumpTable::addJumpInstruction(Instruction *instr) {
     assert(v != nullptr);
 
     v->addJumpTable(this);
+    if(auto function = getFunction()) {
+        function->markModified();  // new edges in its control flow graph
+    }
     LOG(10, "OK, instr " << instr->getName()
         << " knows about jump table: " << this);
 }
@@ -5,6 +5,7 @@
 #include <string>
 #include "chunkref.h"
 #include "util/iter.h"
+#include "util/slab.h"
 #include "types.h"
 
 /** Represents a reference from a Chunk that may need to be updated.
@@ -12,8 +13,9 @@
     Some Links refer to a target Chunk, and the offset may change if either
     the source or destination are moved. Others store a fixed target address,
     which again involves some recomputation if the source Chunk moves.
+    Links are slab-allocated, like the instruction semantics that own them.
 */
-class Link {
+class Link : public SlabAllocated {
 public:
     enum LinkScope {
         SCOPE_UNKNOWN           = 0,
@@ -0,0 +1,114 @@
+#include <algorithm>
+#include "linkindex.h"
+#include "concrete.h"
+#include "link.h"
+#include "instr/semantic.h"
+#include "log/log.h"
+
+LinkIndex *LinkIndex::instance = nullptr;
+
+Link *LinkReference::getLink() const {
+    return semantic ? semantic->getLink() : variable->getDest();
+}
+
+void LinkReference::setLink(Link *link) const {
+    if(semantic) semantic->setLink(link);
+    else variable->setDest(link);
+}
+
+void LinkIndex::enable(Program *program) {
+    if(instance) return;
+
+    auto index = new LinkIndex();
+    for(auto module : CIter::modules(program)) {
+        CIter::forEachInstruction(module, [index] (Instruction *instr) {
+            auto semantic = instr->getSemantic();
+            if(auto link = semantic->getLink()) {
+                index->update(LinkReference(semantic), link);
+            }
+        });
+
+        if(!module->getDataRegionList()) continue;
+        for(auto region : CIter::regions(module)) {
+            for(auto section : CIter::children(region)) {
+                for(auto var : CIter::children(section)) {
+                    if(auto link = var->getDest()) {
+                        index->update(LinkReference(var), link);
+                    }
+                }
+            }
+        }
+    }
+    LOG(10, "link index covers " << index->targetMap.size()
+        << " references to " << index->referenceMap.size() << " targets");
+
+    // only published once complete, so setLink() during the scan is a no-op
+    instance = index;
+}
+
+void LinkIndex::disable() {
+    delete instance;
+    instance = nullptr;
+}
+
+void LinkIndex::update(const LinkReference &reference, Link *link) {
+    std::lock_guard<std::mutex> lock(mutex);
+    unlink(reference);
+
+    std::vector<Chunk *> targets;
+    findTargets(link, targets);
+    if(targets.empty()) return;
+
+    for(auto target : targets) {
+        referenceMap[target].push_back(reference);
+    }
+    targetMap[reference.getKey()] = std::move(targets);
+}
+
+void LinkIndex::remove(const LinkReference &reference) {
+    std::lock_guard<std::mutex> lock(mutex);
+    unlink(reference);
+}
+
+std::vector<LinkReference> LinkIndex::getReferences(Chunk *target) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = referenceMap.find(target);
+    if(it == referenceMap.end()) return {};
+    return it->second;
+}
+
+size_t LinkIndex::getReferenceCount(Chunk *target) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = referenceMap.find(target);
+    return it == referenceMap.end() ? 0 : it->second.size();
+}
+
+void LinkIndex::unlink(const LinkReference &reference) {
+    // the old Link may already be deleted, so use the recorded targets
+    auto it = targetMap.find(reference.getKey());
+    if(it == targetMap.end()) return;
+
+    for(auto target : it->second) {
+        auto &list = referenceMap[target];
+        auto found = std::find(list.begin(), list.end(), reference);
+        if(found != list.end()) {
+            *found = list.back();
+            list.pop_back();
+        }
+        if(list.empty()) referenceMap.erase(target);
+    }
+    targetMap.erase(it);
+}
+
+void LinkIndex::findTargets(Link *link, std::vector<Chunk *> &targets) {
+    if(!link) return;
+
+    if(auto both = dynamic_cast<ImmAndDispLink *>(link)) {
+        findTargets(both->getImmLink(), targets);
+        findTargets(both->getDispLink(), targets);
+        return;
+    }
+    if(auto target = link->getTarget()) {
+        targets.push_back(target);
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef EGALITO_CHUNK_LINK_INDEX_H
+#define EGALITO_CHUNK_LINK_INDEX_H
+
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include "chunkref.h"
+
+class Link;
+class InstructionSemantic;
+class DataVariable;
+class Program;
+
+/** Something that holds a Link: an instruction's semantic, or a
+    DataVariable.
+*/
+class LinkReference {
+private:
+    InstructionSemantic *semantic;
+    DataVariable *variable;
+public:
+    LinkReference(InstructionSemantic *semantic)
+        : semantic(semantic), variable(nullptr) {}
+    LinkReference(DataVariable *variable)
+        : semantic(nullptr), variable(variable) {}
+
+    InstructionSemantic *getSemantic() const { return semantic; }
+    DataVariable *getVariable() const { return variable; }
+
+    Link *getLink() const;
+    void setLink(Link *link) const;
+
+    const void *getKey() const
+        { return semantic ? static_cast<const void *>(semantic) : variable; }
+    bool operator == (const LinkReference &other) const
+        { return getKey() == other.getKey(); }
+};
+
+/** Optional reverse index from a Link target to every LinkReference whose
+    Link points at it. While the index is enabled, LinkDecorator::setLink()
+    and DataVariable::setDest() keep it up to date, so redirecting all
+    references to a Chunk costs O(references) instead of a program scan.
+
+    A Link is indexed under its target at the time it is set; Links whose
+    target is computed lazily (e.g. ExternalSymbolLink before resolution)
+    must be set again to move in the index.
+*/
+class LinkIndex {
+private:
+    static LinkIndex *instance;
+private:
+    std::mutex mutex;
+    std::unordered_map<Chunk *, std::vector<LinkReference>> referenceMap;
+    std::unordered_map<const void *, std::vector<Chunk *>> targetMap;
+public:
+    static LinkIndex *getInstance() { return instance; }
+
+    /** Builds the index with one scan over program, then keeps it current. */
+    static void enable(Program *program);
+    static void disable();
+
+    /** Called whenever reference is given a new (possibly NULL) Link. */
+    void update(const LinkReference &reference, Link *link);
+    /** Called when reference is destroyed. */
+    void remove(const LinkReference &reference);
+
+    /** Returns a copy, so callers may change Links while iterating. */
+    std::vector<LinkReference> getReferences(Chunk *target);
+    size_t getReferenceCount(Chunk *target);
+private:
+    void unlink(const LinkReference &reference);
+    static void findTargets(Link *link, std::vector<Chunk *> &targets);
+};
+
+#endif
@@ -30,28 +30,28 @@ void Module::serialize(ChunkSerializerOperations &op,
     writer.writeID(op.assign(library));
 
     auto pltListID = op.serialize(getPLTList());
-    writer.write(pltListID);
+    writer.writeID(pltListID);
 
     auto functionListID = op.serialize(getFunctionList());
-    writer.write(functionListID);
+    writer.writeID(functionListID);
 
     auto jumpTableListID = op.serialize(getJumpTableList());
-    writer.write(jumpTableListID);
+    writer.writeID(jumpTableListID);
 
     auto dataRegionListID = op.serialize(getDataRegionList());
-    writer.write(dataRegionListID);
+    writer.writeID(dataRegionListID);
 
     auto vtableListID = getVTableList() ? op.serialize(getVTableList()) : FlatChunk::NoneID;
-    writer.write(vtableListID);
+    writer.writeID(vtableListID);
 
     auto initFunctionListID = getInitFunctionList() ? op.serialize(getInitFunctionList()) : FlatChunk::NoneID;
-    writer.write(initFunctionListID);
+    writer.writeID(initFunctionListID);
 
     auto finiFunctionListID = getFiniFunctionList() ? op.serialize(getFiniFunctionList()) : FlatChunk::NoneID;
-    writer.write(finiFunctionListID);
+    writer.writeID(finiFunctionListID);
 
     auto externalSymbolListID = op.serialize(getExternalSymbolList());
-    writer.write(externalSymbolListID);
+    writer.writeID(externalSymbolListID);
 
     if(op.isLocalModuleOnly() && library) {
         LOG(0, "serializing library [" << library->getName() << "]");
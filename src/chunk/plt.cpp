@@ -14,6 +14,7 @@
 #include "elf/symbol.h"
 #include "instr/writer.h"
 #include "disasm/disassemble.h"
+#include "util/bytescan.h"
 
 #undef DEBUG_GROUP
 #define DEBUG_GROUP dplt
@@ -188,7 +189,12 @@ void PLTTrampoline::accept(ChunkVisitor *visitor) {
 }
 
 void PLTTrampoline::makeCache() {
+    delete cache;
     this->cache = new ChunkCache(this);
+    if(!cache->isValid()) {
+        delete cache;
+        this->cache = nullptr;
+    }
 }
 
 size_t PLTList::getPLTTrampolineSize() {
@@ -274,13 +280,16 @@ PLTList *PLTList::parse(RelocList *relocList, ElfMap *elf, Module *module) {
          56b:   e9 e0 ff ff ff          jmpq   550 <.plt>
     */
 
-    // note: we skip the first PLT entry, which has a different format
-    for(size_t i = 1 * ENTRY_SIZE; i < header->sh_size; i += ENTRY_SIZE) {
+    // only entries that begin with jmpq *(%rip) are worth a closer look
+    auto jmpList = BytePattern("\xff\x25", 2).findAll(
+        reinterpret_cast<const char *>(section), header->sh_size, ENTRY_SIZE);
+    for(size_t i : jmpList) {
         auto entry = section + i;
 
         LOG(1, "CONSIDER PLT entry at " << entry);
 
-        if(*reinterpret_cast<const unsigned short *>(entry) == 0x25ff) {
+        // note: we skip the first PLT entry, which has a different format
+        if(i >= 1 * ENTRY_SIZE) {
             address_t pltAddress = header->sh_addr + i;
             address_t value = *reinterpret_cast<const unsigned int *>(entry + 2)
                 + (pltAddress + 2+4);  // target is RIP-relative
@@ -439,26 +448,26 @@ void PLTList::parsePLTGOT(RelocList *relocList, ElfMap *elf,
         0x00007ffff7a5b906:  66 90   xchg   %ax,%ax
     */
 
-    for(size_t i = 0; i < header->sh_size; i += ENTRY_SIZE) {
+    auto jmpList = BytePattern("\xff\x25", 2).findAll(
+        reinterpret_cast<const char *>(section), header->sh_size, ENTRY_SIZE);
+    for(size_t i : jmpList) {
         auto entry = section + i;
 
         LOG(1, "CONSIDER PLT.GOT entry at " << entry);
 
-        if(*reinterpret_cast<const unsigned short *>(entry) == 0x25ff) {
-            address_t pltAddress = header->sh_addr + i;
-            address_t value = *reinterpret_cast<const unsigned int *>(entry + 2)
-                + (pltAddress + 2+4);  // target is RIP-relative
-            LOG(1, "PLT.GOT value would be " << value);
-            Reloc *r = newRegistry->find(value);
-            if(r && r->getSymbol()) {
-                LOG(1, "Found PLT.GOT entry at " << pltAddress << " -> ["
-                    << r->getSymbol()->getName() << "]");
-                auto externalSymbol = ExternalSymbolFactory(module)
-                    .makeExternalSymbol(r->getSymbol());
-                pltList->getChildren()->add(
-                    new PLTTrampoline(pltList, pltAddress, externalSymbol, value,
-                        true));
-            }
+        address_t pltAddress = header->sh_addr + i;
+        address_t value = *reinterpret_cast<const unsigned int *>(entry + 2)
+            + (pltAddress + 2+4);  // target is RIP-relative
+        LOG(1, "PLT.GOT value would be " << value);
+        Reloc *r = newRegistry->find(value);
+        if(r && r->getSymbol()) {
+            LOG(1, "Found PLT.GOT entry at " << pltAddress << " -> ["
+                << r->getSymbol()->getName() << "]");
+            auto externalSymbol = ExternalSymbolFactory(module)
+                .makeExternalSymbol(r->getSymbol());
+            pltList->getChildren()->add(
+                new PLTTrampoline(pltList, pltAddress, externalSymbol, value,
+                    true));
         }
     }
 }
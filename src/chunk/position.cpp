@@ -206,8 +206,15 @@ bool PositionFactory::needsSpecialCaseFirst() const {
 
 #include "chunk/tls.h"
 
+std::vector<address_t> PositionManager::frozenAddresses;
+std::vector<Chunk *> PositionManager::frozenChunks;
+
 address_t PositionManager::getAddress(const Chunk *chunk) {
-    if(chunk->getPositionIndex() == Chunk::POSITION_OLD) {
+    auto index = chunk->getPositionIndex();
+    if(index == Chunk::POSITION_FROZEN) {
+        return frozenAddresses[chunk->getFrozenIndex()];
+    }
+    else if(index == Chunk::POSITION_OLD) {
         return chunk->getPosition()->get();
     }
     else {
@@ -220,6 +227,8 @@ address_t PositionManager::getAddress(const Chunk *chunk) {
 }
 
 void PositionManager::setAddress(Chunk *chunk, address_t address) {
+    if(chunk->getPositionIndex() == Chunk::POSITION_FROZEN) thaw();
+
     if(chunk->getPositionIndex() == Chunk::POSITION_OLD) {
         chunk->getPosition()->set(address);
     }
@@ -231,3 +240,39 @@ void PositionManager::setAddress(Chunk *chunk, address_t address) {
         addrTable[entry->getIndex()] = address;
     }
 }
+
+void PositionManager::freeze(Chunk *root) {
+    freezeChunk(root);
+    LOG(10, "froze addresses of " << std::dec << frozenChunks.size()
+        << " chunks");
+}
+
+void PositionManager::freezeChunk(Chunk *chunk) {
+    // parents are frozen before their children, so an OffsetPosition only
+    // has to load its parent's frozen address
+    if(chunk->getPosition()
+        && chunk->getPositionIndex() == Chunk::POSITION_OLD) {
+
+        address_t address = chunk->getPosition()->get();
+        chunk->setFrozenIndex(frozenAddresses.size());
+        chunk->setPositionIndex(Chunk::POSITION_FROZEN);
+        frozenAddresses.push_back(address);
+        frozenChunks.push_back(chunk);
+    }
+
+    if(auto children = chunk->getChildren()) {
+        for(auto child : children->genericIterable()) {
+            freezeChunk(child);
+        }
+    }
+}
+
+void PositionManager::thaw() {
+    for(auto chunk : frozenChunks) {
+        if(chunk->getPositionIndex() == Chunk::POSITION_FROZEN) {
+            chunk->setPositionIndex(Chunk::POSITION_OLD);
+        }
+    }
+    frozenChunks.clear();
+    frozenAddresses.clear();
+}
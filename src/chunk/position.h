@@ -1,6 +1,7 @@
 #ifndef EGALITO_CHUNK_POSITION_H
 #define EGALITO_CHUNK_POSITION_H
 
+#include <vector>
 #include "chunkref.h"
 #include "transform/slot.h"
 #include "types.h"
@@ -262,10 +263,28 @@ private:
 
 //-----------------------------------------------------------------------------
 
+/** Maps a Chunk to its address, wherever that address is stored.
+
+    freeze() switches to a frozen layout: one sweep over a Chunk tree
+    computes the address of every positioned Chunk into a flat array, and
+    until thaw() getAddress() on those Chunks is a single load instead of a
+    walk up the Position chain. Any mutation must thaw first; ChunkMutator
+    and setAddress() do this automatically, but Positions set directly
+    (e.g. assigning Slots) must happen before freezing.
+*/
 class PositionManager {
+private:
+    static std::vector<address_t> frozenAddresses;
+    static std::vector<Chunk *> frozenChunks;
 public:
     static address_t getAddress(const Chunk *chunk);
     static void setAddress(Chunk *chunk, address_t address);
+
+    static void freeze(Chunk *root);
+    static void thaw();
+    static bool isFrozen() { return !frozenChunks.empty(); }
+private:
+    static void freezeChunk(Chunk *chunk);
 };
 
 #endif
@@ -78,7 +78,7 @@ void Program::serialize(ChunkSerializerOperations &op,
     op.serializeChildren(this, writer);
 
     LOG(1, "entry point is " << entryPoint);
-    writer.write(op.assign(entryPoint));
+    writer.writeID(op.assign(entryPoint));
 
     LOG(1, "done serializing program");
 }
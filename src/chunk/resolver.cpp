@@ -398,25 +398,74 @@ Link *PerfectLinkResolver::resolveExternally(ExternalSymbol *externalSymbol,
         relative, afterMapping);
 }
 
+std::vector<Module *> ExportTable::getProviders(const char *name,
+    const SymbolVersion *version) {
+
+    std::string key(name);
+    if(version) {
+        key.push_back(' ');
+        key.append(version->getName());
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto count = program->getChildren()->getIterable()->getCount();
+    if(count != moduleCount) {
+        providers.clear();
+        moduleCount = count;
+    }
+
+    auto it = providers.find(key);
+    if(it == providers.end()) {
+        std::vector<Module *> list;
+        for(auto m : CIter::modules(program)) {
+            if(provides(m, name, version)) list.push_back(m);
+        }
+        it = providers.emplace(std::move(key), std::move(list)).first;
+    }
+    return it->second;
+}
+
+bool ExportTable::provides(Module *module, const char *name,
+    const SymbolVersion *version) {
+
+    // the same names that resolveNameAsLinkHelper() tries
+    auto list = module->getElfSpace()->getDynamicSymbolList();
+    if(!list) return false;
+    if(list->find(name)) return true;
+    if(!version) return false;
+
+    std::string versionedName1(name);
+    versionedName1.append("@");
+    versionedName1.append(version->getName());
+    if(list->find(versionedName1.c_str())) return true;
+    std::string versionedName2(name);
+    versionedName2.append("@@");
+    versionedName2.append(version->getName());
+    return list->find(versionedName2.c_str()) != nullptr;
+}
+
 Link *PerfectLinkResolver::resolveExternallyHelper(const char *name,
     const SymbolVersion *version, Conductor *conductor, Module *module,
     bool weak, bool relative, bool afterMapping) {
 
     LOG(10, "(resolveExternally) SEARCH for " << name << ", weak? " << weak);
 
-    if(auto func = LoaderEmulator::getInstance().findFunction(name)) {
+    auto emulator = conductor->getLoaderEmulator();
+    if(auto func = emulator->findFunction(name)) {
         LOG(10, "    link to emulated function!");
         return new NormalLink(func, Link::SCOPE_EXTERNAL_CODE);
     }
-    if(auto link = LoaderEmulator::getInstance().makeDataLink(name,
-        afterMapping)) {
+    if(auto link = emulator->makeDataLink(name, afterMapping)) {
 
         LOG(10, "    link to emulated data!");
         return link;
     }
 
+    // only modules that export this name can satisfy it
+    auto providers = conductor->getExportTable()->getProviders(name, version);
+
     auto dependencies = module->getLibrary()->getDependencies();
-    for(auto m : CIter::modules(conductor->getProgram())) {
+    for(auto m : providers) {
         if(dependencies.find(m->getLibrary()) == dependencies.end()) {
             continue;
         }
@@ -446,7 +495,7 @@ Link *PerfectLinkResolver::resolveExternallyHelper(const char *name,
     }
 
     // weak reference
-    for(auto m : CIter::modules(conductor->getProgram())) {
+    for(auto m : providers) {
         if(auto link = resolveNameAsLinkHelper(name, version,
             m, weak, relative, afterMapping)) {
 
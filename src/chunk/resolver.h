@@ -1,6 +1,10 @@
 #ifndef EGALITO_CHUNK_RESOLVER_H
 #define EGALITO_CHUNK_RESOLVER_H
 
+#include <string>
+#include <vector>
+#include <mutex>
+#include <unordered_map>
 #include "link.h"
 
 class Reloc;
@@ -10,6 +14,32 @@ class Module;
 class ExternalSymbol;
 class SymbolVersion;
 class SymbolList;
+class Program;
+
+/** Maps a symbol name to the Modules whose dynamic symbol lists have it
+    (plain or with its version appended), in load order. A name is looked
+    up in every Module only the first time it is asked for, so the many
+    PLT, data and TLS externals that share a name don't rescan all
+    libraries. Which of these Modules a reference may bind to depends on
+    the referencing Module's dependencies, so that is left to the caller.
+
+    Everything is forgotten when Modules are added to the Program.
+*/
+class ExportTable {
+private:
+    Program *program;
+    size_t moduleCount;
+    std::mutex mutex;
+    std::unordered_map<std::string, std::vector<Module *>> providers;
+public:
+    ExportTable(Program *program) : program(program), moduleCount(0) {}
+
+    std::vector<Module *> getProviders(const char *name,
+        const SymbolVersion *version);
+private:
+    static bool provides(Module *module, const char *name,
+        const SymbolVersion *version);
+};
 
 /** This resolver assumes that we have both relocations and symbols.
  */
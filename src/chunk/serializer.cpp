@@ -7,10 +7,15 @@
 #include "archive/stream.h"
 #include "archive/reader.h"
 #include "archive/writer.h"
+#include "util/threadpool.h"
 #include "util/timing.h"
 #include "util/streamasstring.h"
 #include "log/log.h"
 
+// segment whose flats the current thread is deserializing
+static thread_local FlatChunk::SegmentType deserializingSegment
+    = FlatChunk::NoSegment;
+
 FlatChunk::IDType ChunkSerializerOperations::assign(Chunk *object) {
     if(!object) {
         LOG(1, "Trying to assign serialization ID to null chunk, skipping");
@@ -44,26 +49,41 @@ FlatChunk::IDType ChunkSerializerOperations::serialize(Chunk *chunk) {
     }
 #endif
 
-    FlatChunk *flat = getArchive()->getFlatList().newFlatChunk(
-        chunk->getFlatType());
-    BufferedStreamWriter writer(flat);
-
-    chunk->serialize(*this, writer);
-    return flat->getID();
+    auto id = getArchive()->getFlatList().getNextID();
+    serialize(chunk, id);
+    return id;
 }
 
 void ChunkSerializerOperations::serialize(Chunk *chunk,
     FlatChunk::IDType id) {
 
+    auto oldSegment = currentSegment;
+    if(dynamic_cast<Module *>(chunk)) {
+        currentSegment = getArchive()->newSegment();
+    }
+
+    FlatChunk *flat = newFlatChunk(chunk, id);
+    {
+        BufferedStreamWriter writer(flat);
+        chunk->serialize(*this, writer);
+    }
+
+    currentSegment = oldSegment;
+}
+
+FlatChunk *ChunkSerializerOperations::newFlatChunk(Chunk *chunk,
+    FlatChunk::IDType id) {
+
     FlatChunk *flat = getArchive()->getFlatList().newFlatChunk(
         chunk->getFlatType(), id);
-    BufferedStreamWriter writer(flat);
-
-    chunk->serialize(*this, writer);
+    flat->setSegment(currentSegment);
+    return flat;
 }
 
 bool ChunkSerializerOperations::deserialize(FlatChunk *flat) {
     InMemoryStreamReader reader(flat);
+    reader.setCompact(getArchive()->getVersion()
+        >= static_cast<int>(EgalitoArchive::FIRST_COMPACT_VERSION));
     if(!flat->getInstance<Chunk>()) {
         LOG(1, "WARNING: did not instantiate Chunk for flat " << flat->getID());
         return false;
@@ -76,13 +96,14 @@ bool ChunkSerializerOperations::deserialize(FlatChunk *flat) {
 void ChunkSerializerOperations::serializeChildren(Chunk *chunk,
     ArchiveStreamWriter &writer) {
 
-    uint32_t count = chunk->getChildren()->genericGetSize();
-    writer.write(count);
+    writer.writeVarint(chunk->getChildren()->genericGetSize());
 
     std::vector<FlatChunk::IDType> idList;
+    FlatChunk::IDType previous = 0;
     for(auto child : chunk->getChildren()->genericIterable()) {
         idList.push_back(assign(child));
-        writer.write(idList.back());
+        writer.writeID(idList.back(), previous);
+        previous = idList.back();
     }
 
     writer.flush();
@@ -97,11 +118,13 @@ void ChunkSerializerOperations::serializeChildren(Chunk *chunk,
 void ChunkSerializerOperations::deserializeChildren(Chunk *chunk,
     ArchiveStreamReader &reader, bool addToChildList) {
 
-    auto count = reader.read<uint32_t>();
+    auto count = reader.readVarint<uint32_t>();
 
     std::vector<FlatChunk::IDType> idList;
+    FlatChunk::IDType previous = 0;
     for(uint32_t i = 0; i < count; i ++) {
-        auto id = reader.readID();
+        auto id = reader.readID(previous);
+        previous = id;
         idList.push_back(id);
         if(addToChildList) {
             Chunk *child = lookup(id);
@@ -122,15 +145,15 @@ void ChunkSerializerOperations::serializeChildrenIDsOnly(Chunk *chunk,
     if(level <= 0) return;
     assert(chunk->getChildren());
 
-    uint32_t count = chunk->getChildren()->genericGetSize();
-    writer.write(count);
+    writer.writeVarint(chunk->getChildren()->genericGetSize());
 
+    FlatChunk::IDType previous = 0;
     for(auto child : chunk->getChildren()->genericIterable()) {
         auto id = assign(child);
-        auto type = child->getFlatType();
-        getArchive()->getFlatList().newFlatChunk(type, id);  // unused ret val
+        newFlatChunk(child, id);  // contents are written by the parent
 
-        writer.writeID(id);
+        writer.writeID(id, previous);
+        previous = id;
     }
 
     if(level > 1) {
@@ -145,11 +168,13 @@ void ChunkSerializerOperations::deserializeChildrenIDsOnly(Chunk *chunk,
 
     if(level <= 0) return;
 
-    auto count = reader.read<uint32_t>();
+    auto count = reader.readVarint<uint32_t>();
 
     std::vector<FlatChunk::IDType> idList;
+    FlatChunk::IDType previous = 0;
     for(uint32_t i = 0; i < count; i ++) {
-        auto id = reader.readID();
+        auto id = reader.readID(previous);
+        previous = id;
         idList.push_back(id);
         if(addToChildList) {
             Chunk *child = lookup(id);
@@ -166,6 +191,40 @@ void ChunkSerializerOperations::deserializeChildrenIDsOnly(Chunk *chunk,
     }
 }
 
+void ChunkSerializerOperations::setPlaceholderPosition(FlatChunk::IDType id) {
+    Chunk *target = lookup(id);
+    if(!target || target->getPosition()) return;
+
+    auto segment = lookupFlat(id)->getSegment();
+    if(deserializingSegment != FlatChunk::NoSegment
+        && segment != deserializingSegment) {
+
+        std::unique_lock<std::mutex> lock(deferredMutex);
+        deferredPlaceholders.push_back(target);
+        return;
+    }
+
+    try {
+        target->setPosition(new AbsolutePosition(-1));
+    }
+    catch(const char *) {
+        // can't set position for this type
+    }
+}
+
+void ChunkSerializerOperations::applyDeferred() {
+    for(auto target : deferredPlaceholders) {
+        if(target->getPosition()) continue;
+        try {
+            target->setPosition(new AbsolutePosition(-1));
+        }
+        catch(const char *) {
+            // can't set position for this type
+        }
+    }
+    deferredPlaceholders.clear();
+}
+
 Chunk *ChunkSerializer::instantiate(FlatChunk *flat) {
     std::function<Chunk *()> constructor[] = {
         [] () -> Chunk* { return nullptr; },              // TYPE_UNKNOWN
@@ -203,7 +262,31 @@ Chunk *ChunkSerializer::instantiate(FlatChunk *flat) {
     return (constructor[type])();
 }
 
-void ChunkSerializer::serialize(Chunk *chunk, std::string filename) {
+void ChunkSerializer::serialize(Chunk *chunk, std::string filename,
+    bool compress) {
+
+    EgalitoArchive *archive = flatten(chunk);
+    if(archive) {
+        EgalitoArchiveWriter(archive, compress).write(filename);
+
+        LOG(1, "done with writing");
+    }
+
+    delete archive;
+}
+
+Chunk *ChunkSerializer::clone(Chunk *chunk) {
+    EgalitoTiming ttt("clone of Chunk tree");
+    EgalitoArchive *archive = flatten(chunk);
+    if(!archive) return nullptr;
+
+    // the flats written during serialization are read straight back
+    Chunk *root = rebuild(archive);
+    delete archive;
+    return root;
+}
+
+EgalitoArchive *ChunkSerializer::flatten(Chunk *chunk) {
     EgalitoArchive *archive = new EgalitoArchive();
     bool localModuleOnly = dynamic_cast<Module *>(chunk) != nullptr;
     ChunkSerializerOperations op(archive, localModuleOnly);
@@ -230,18 +313,23 @@ void ChunkSerializer::serialize(Chunk *chunk, std::string filename) {
 
     if(errors) {
         LOG(1, "Errors encountered during serialization, aborting");
-    }
-    else {
-        EgalitoArchiveWriter(archive).write(filename);
-
-        LOG(1, "done with writing");
+        delete archive;
+        return nullptr;
     }
 
-    delete archive;
+    return archive;
 }
 
 Chunk *ChunkSerializer::deserialize(std::string filename) {
     EgalitoArchive *archive = EgalitoArchiveReader().read(filename);
+    if(!archive) return nullptr;
+
+    auto root = rebuild(archive);
+    delete archive;
+    return root;
+}
+
+Chunk *ChunkSerializer::rebuild(EgalitoArchive *archive) {
     ChunkSerializerOperations op(archive, false);
 
     // First instantiate objects, with the correct type, so that memory
@@ -252,17 +340,47 @@ Chunk *ChunkSerializer::deserialize(std::string filename) {
 
     {
         EgalitoTiming ttt("total for all deserialize() calls");
-        // Deserialize in reverse order so that tree leaves will be fully
-        // initialized before their parents are constructed.
-        for(auto it = archive->getFlatList().rbegin();
-            it != archive->getFlatList().rend(); it ++) {
+        deserializeSegments(archive, op);
+    }
+
+    // We assume node 0 is the root.
+    return op.lookup(0);
+}
 
-            op.deserialize(*it);
+void ChunkSerializer::deserializeSegments(EgalitoArchive *archive,
+    ChunkSerializerOperations &op) {
+
+    // Deserialize in reverse order so that tree leaves will be fully
+    // initialized before their parents are constructed. Each Module is
+    // independent of the others, so segments can go in parallel; shared
+    // chunks (Program, LibraryList, ...) are done afterwards.
+    std::vector<std::vector<FlatChunk *>> segmentList(
+        archive->getSegmentCount());
+    std::vector<FlatChunk *> sharedList;
+    for(auto it = archive->getFlatList().rbegin();
+        it != archive->getFlatList().rend(); it ++) {
+
+        auto flat = *it;
+        if(flat->getSegment() < segmentList.size()) {
+            segmentList[flat->getSegment()].push_back(flat);
+        }
+        else {
+            sharedList.push_back(flat);
         }
     }
 
-    // We assume node 0 is the root.
-    auto root = op.lookup(0);
-    delete archive;
-    return root;
+    ThreadPool pool;
+    pool.parallelFor(segmentList.size(), [&] (size_t i) {
+        deserializingSegment = static_cast<FlatChunk::SegmentType>(i);
+        for(auto flat : segmentList[i]) {
+            op.deserialize(flat);
+        }
+        deserializingSegment = FlatChunk::NoSegment;
+    });
+
+    for(auto flat : sharedList) {
+        op.deserialize(flat);
+    }
+
+    op.applyDeferred();
 }
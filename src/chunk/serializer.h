@@ -2,6 +2,8 @@
 #define EGALITO_CHUNK_SERIALIZER_H
 
 #include <map>
+#include <vector>
+#include <mutex>
 #include "archive/archive.h"
 #include "archive/operations.h"
 #include "archive/flatchunk.h"
@@ -10,15 +12,24 @@
 class Chunk;
 
 /** Operations available to a Chunk's serialize/deserialize functions.
+
+    Every Module is serialized into its own segment, and the segments are
+    deserialized in parallel. A Chunk's deserialize() may freely read other
+    Chunks, but must only modify Chunks of its own segment; changes to
+    targets elsewhere (see setPlaceholderPosition) are applied at the end.
 */
 class ChunkSerializerOperations : public ArchiveIDOperations<Chunk> {
 private:
     EgalitoArchive *archive;
     bool localModuleOnly;
     std::vector<std::string> debugNames;
+    FlatChunk::SegmentType currentSegment;
+    std::mutex deferredMutex;
+    std::vector<Chunk *> deferredPlaceholders;
 public:
     ChunkSerializerOperations(EgalitoArchive *archive, bool localModuleOnly)
-        : ArchiveIDOperations(archive), localModuleOnly(localModuleOnly) {}
+        : ArchiveIDOperations(archive), localModuleOnly(localModuleOnly),
+        currentSegment(FlatChunk::NoSegment) {}
 
     virtual FlatChunk::IDType assign(Chunk *object);
     std::string getDebugName(FlatChunk::IDType id);
@@ -37,6 +48,14 @@ public:
         ArchiveStreamReader &reader, int level, bool addToChildList = true);
 
     bool isLocalModuleOnly() const { return localModuleOnly; }
+
+    /** Gives target a dummy position if it has none yet. If target belongs
+        to a different segment than the one being deserialized, this is
+        deferred until applyDeferred(). */
+    void setPlaceholderPosition(FlatChunk::IDType id);
+    void applyDeferred();
+private:
+    FlatChunk *newFlatChunk(Chunk *chunk, FlatChunk::IDType id);
 };
 
 /** Highest-level archive serialization/deserialization.
@@ -44,12 +63,24 @@ public:
 class ChunkSerializer {
 public:
     /** Here chunk is the root of the tree to serialize. */
-    void serialize(Chunk *chunk, std::string filename);
+    void serialize(Chunk *chunk, std::string filename,
+        bool compress = false);
 
     /** Returns the root of the deserialized tree. */
     Chunk *deserialize(std::string filename);
+
+    /** Returns an independent deep copy of the tree rooted at chunk, made
+        by serializing into memory and reading the result straight back.
+        Links inside the tree point into the copy; nothing is written to
+        disk. Returns nullptr if the tree could not be serialized.
+    */
+    Chunk *clone(Chunk *chunk);
 private:
+    EgalitoArchive *flatten(Chunk *chunk);
+    Chunk *rebuild(EgalitoArchive *archive);
     Chunk *instantiate(FlatChunk *flat);
+    void deserializeSegments(EgalitoArchive *archive,
+        ChunkSerializerOperations &op);
 };
 
 #endif
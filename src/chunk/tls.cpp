@@ -92,3 +92,13 @@ void EgalitoTLS::setJITResetCounter(size_t JIT_resetCounter) {
     SET_TO_TLS(JIT_resetCounter);
 }
 
+
+JitGenerationService *EgalitoTLS::getJITService() {
+    JitGenerationService *JIT_service = nullptr;
+    GET_FROM_TLS(JIT_service);
+    return JIT_service;
+}
+
+void EgalitoTLS::setJITService(JitGenerationService *JIT_service) {
+    SET_TO_TLS(JIT_service);
+}
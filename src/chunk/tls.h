@@ -24,10 +24,12 @@
 // operation for libegalito (e.g. __tls_get_addr)
 
 class GSTable;
+class JitGenerationService;
 
 // the list grows upward
 class EgalitoTLS {
 private:
+    JitGenerationService *JIT_service;
     size_t JIT_resetThreshold;
     size_t JIT_resetCounter;
     volatile size_t *barrier;
@@ -41,7 +43,7 @@ private:
 public:
     EgalitoTLS(volatile size_t *barrier, GSTable *gsTable,
         ShufflingSandbox *sandbox, void *JIT_addressTable, size_t JIT_resetThreshold=1)
-        :  JIT_resetThreshold(JIT_resetThreshold), JIT_resetCounter(0),
+        :  JIT_service(nullptr), JIT_resetThreshold(JIT_resetThreshold), JIT_resetCounter(0),
         barrier(barrier), child(nullptr), gsTable(gsTable), sandbox(sandbox),
         JIT_addressTable(JIT_addressTable), JIT_jitting(0) {}
 
@@ -59,6 +61,8 @@ public:
     static void setJITResetThreshold(size_t threshold);
     static size_t getJITResetCounter();
     static void setJITResetCounter(size_t counter);
+    static JitGenerationService *getJITService();
+    static void setJITService(JitGenerationService *service);
 };
 
 #endif
@@ -1,4 +1,6 @@
+#include <algorithm>
 #include "vtable.h"
+#include "concrete.h"
 #include "visitor.h"
 #include "serializer.h"
 #include "instr/serializer.h"
@@ -68,3 +70,60 @@ bool VTableList::deserialize(ChunkSerializerOperations &op,
 void VTableList::accept(ChunkVisitor *visitor) {
     visitor->visit(this);
 }
+
+void VTableIndex::add(Program *program) {
+    for(auto module : CIter::children(program)) {
+        if(auto vtableList = module->getVTableList()) add(vtableList, module);
+    }
+}
+
+void VTableIndex::add(VTableList *list, Module *module) {
+    for(auto vtable : CIter::children(list)) {
+        classMap[vtable->getClassName()].push_back(vtable);
+
+        for(auto entry : CIter::children(vtable)) {
+            if(auto target = getTarget(entry)) {
+                targetMap[target].push_back(Location{module, vtable, entry});
+            }
+        }
+    }
+}
+
+const std::vector<VTable *> &VTableIndex::getVTables(
+    const std::string &className) const {
+
+    static const std::vector<VTable *> none;
+    auto it = classMap.find(className);
+    return (it != classMap.end()) ? (*it).second : none;
+}
+
+const std::vector<VTableIndex::Location> &VTableIndex::getEntriesTargeting(
+    Chunk *target) const {
+
+    static const std::vector<Location> none;
+    auto it = targetMap.find(target);
+    return (it != targetMap.end()) ? (*it).second : none;
+}
+
+void VTableIndex::retarget(const Location &location, Link *link) {
+    // copied, since location may be an element of the list changed here
+    auto moved = location;
+    if(auto oldTarget = getTarget(moved.entry)) {
+        auto &list = targetMap[oldTarget];
+        list.erase(std::remove_if(list.begin(), list.end(),
+            [&moved] (const Location &l) { return l.entry == moved.entry; }),
+            list.end());
+        if(list.empty()) targetMap.erase(oldTarget);
+    }
+
+    delete moved.entry->getLink();
+    moved.entry->setLink(link);
+    if(auto target = getTarget(moved.entry)) {
+        targetMap[target].push_back(moved);
+    }
+}
+
+Chunk *VTableIndex::getTarget(VTableEntry *entry) {
+    auto link = entry->getLink();
+    return link ? &*link->getTarget() : nullptr;
+}
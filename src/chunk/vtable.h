@@ -2,10 +2,16 @@
 #define EGALITO_CHUNK_VTABLE_H
 
 #include <string>
+#include <vector>
+#include <unordered_map>
 #include "chunk.h"
 #include "chunklist.h"
 #include "archive/chunktypes.h"
 
+class Link;
+class Module;
+class Program;
+
 class VTableEntry : public ChunkSerializerImpl<TYPE_VTableEntry,
     AddressableChunkImpl> {
 private:
@@ -28,14 +34,21 @@ class VTable : public ChunkSerializerImpl<TYPE_VTable,
     CompositeChunkImpl<VTableEntry>> {
 private:
     std::string className;
+    address_t addressPoint;
 public:
-    VTable() : className("???") {}
+    VTable() : className("???"), addressPoint(0) {}
 
     virtual std::string getName() const;
     std::string getClassName() const { return className; }
 
     void setClassName(const std::string &name) { className = name; }
 
+    /** Where an object's vtable pointer points: the first entry after the
+        offset-to-top and typeinfo words. 0 if not known (e.g. the VTable
+        was read from an archive). */
+    address_t getAddressPoint() const { return addressPoint; }
+    void setAddressPoint(address_t address) { addressPoint = address; }
+
     virtual void serialize(ChunkSerializerOperations &op,
         ArchiveStreamWriter &writer);
     virtual bool deserialize(ChunkSerializerOperations &op,
@@ -59,4 +72,39 @@ public:
     virtual void accept(ChunkVisitor *visitor);
 };
 
+/** Looks up VTables by class name and VTable entries by the target of
+    their Link, over any number of VTableLists, after one scan. A class
+    may have a VTable in more than one Module. DisassembleVTables doesn't
+    read base class typeinfo, so this has no parent links.
+
+    VTableEntry::setLink() doesn't update the index: change indexed
+    entries with retarget(), or build a new index after other rewriting.
+*/
+class VTableIndex {
+public:
+    struct Location {
+        Module *module;
+        VTable *vtable;
+        VTableEntry *entry;
+    };
+private:
+    std::unordered_map<std::string, std::vector<VTable *>> classMap;
+    std::unordered_map<Chunk *, std::vector<Location>> targetMap;
+public:
+    void add(Program *program);
+    /** module may be NULL, e.g. for the loader's own vtables. */
+    void add(VTableList *list, Module *module);
+
+    const std::vector<VTable *> &getVTables(
+        const std::string &className) const;
+    const std::vector<Location> &getEntriesTargeting(Chunk *target) const;
+    size_t getClassCount() const { return classMap.size(); }
+
+    /** Gives the entry at location a new Link and reindexes it. The old
+        Link is deleted. */
+    void retarget(const Location &location, Link *link);
+private:
+    static Chunk *getTarget(VTableEntry *entry);
+};
+
 #endif
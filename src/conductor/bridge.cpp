@@ -1,35 +1,44 @@
 #include "bridge.h"
+#include "util/perfecthash.h"
 #include "log/log.h"
 
-LoaderBridge::LoaderBridge() {
+static constexpr const char *bridgeNames[] = {
     #define EGALITO_BRIDGE_ENTRY(type, name) \
-        valueMap[#name] = 0;
+        #name,
     #include "bridgeentries.h"
     #undef EGALITO_BRIDGE_ENTRY
+};
+
+static constexpr PerfectHash<BRIDGES> bridgeHash(bridgeNames);
+static_assert(bridgeHash.isValid(), "no perfect hash for the bridge entries");
+
+LoaderBridge::LoaderBridge() : valueList{} {
+
 }
 
 LoaderBridge LoaderBridge::instance;
 
 bool LoaderBridge::containsName(const std::string &name) {
-    return valueMap.find(name) != valueMap.end();
+    return bridgeHash.indexOf(name) >= 0;
 }
 
 void LoaderBridge::assignAddress(const std::string &name, address_t value) {
-    if(valueMap.find(name) == valueMap.end()) {
+    int index = bridgeHash.indexOf(name);
+    if(index < 0) {
         LOG(1, "ERROR: assigning value " << value << " to non-existent name \""
             << name << "\" in LoaderBridge");
         return;
     }
-    valueMap[name] = value;
+    valueList[index] = value;
 }
 
 address_t LoaderBridge::getAddress(const std::string &name) {
-    auto it = valueMap.find(name);
+    int index = bridgeHash.indexOf(name);
 
-    if(it == valueMap.end()) {
+    if(index < 0) {
         LOG(1, "ERROR: can't find \"" << name << "\" in LoaderBridge");
         throw "unknown LoaderBridge entry";
     }
 
-    return (*it).second;
+    return valueList[index];
 }
@@ -2,10 +2,8 @@
 #define EGALITO_CONDUCTOR_BRIDGE_H
 
 #include <string>
-#include <map>
 #include "types.h"
 
-#if 0
 enum BridgeEntryType {
     #define EGALITO_BRIDGE_ENTRY(type, name) \
         BRIDGE_ ## name,
@@ -13,8 +11,10 @@ enum BridgeEntryType {
     #undef EGALITO_BRIDGE_ENTRY
     BRIDGES
 };
-#endif
 
+/** Values of the variables in bridgeentries.h, which the loader shares
+    with the program. Names are looked up with a PerfectHash.
+*/
 class LoaderBridge {
 private:
     static LoaderBridge instance;
@@ -22,10 +22,12 @@ private:
 public:
     static LoaderBridge *getInstance() { return &instance; }
 private:
-    std::map<std::string, address_t> valueMap;
+    address_t valueList[BRIDGES];
 public:
     bool containsName(const std::string &name);
     void assignAddress(const std::string &name, address_t value);
+    void assignAddress(BridgeEntryType entry, address_t value)
+        { valueList[entry] = value; }
     address_t getAddress(const std::string &name);
 };
 
@@ -19,6 +19,7 @@ EGALITO_BRIDGE_ENTRY(address_t, egalito_init_array)
 EGALITO_BRIDGE_ENTRY(ConductorSetup *, egalito_conductor_setup)
 EGALITO_BRIDGE_ENTRY(Conductor *, egalito_conductor)
 EGALITO_BRIDGE_ENTRY(Chunk *, egalito_gsCallback)
+EGALITO_BRIDGE_ENTRY(bool, egalito_jit_async)
 EGALITO_BRIDGE_ENTRY(IFuncList *, egalito_ifuncList)
 EGALITO_BRIDGE_ENTRY(bool, egalito_init_done)
 EGALITO_BRIDGE_ENTRY(address_t, egalito_hook_function_entry_hook)
@@ -1,10 +1,14 @@
 #include <cassert>
+#include <map>
+#include <unistd.h>  // for access
 #include "config.h"
 #include "conductor.h"
 #include "parseoverride.h"
 #include "passes.h"
 #include "chunk/ifunc.h"
+#include "chunk/resolver.h"
 #include "chunk/tls.h"
+#include "chunk/vtable.h"
 #include "elf/elfmap.h"
 #include "elf/elfdynamic.h"
 #include "generate/debugelf.h"
@@ -16,6 +20,7 @@
 #include "chunk/serializer.h"
 #include "pass/internalcalls.h"
 #include "pass/resolveplt.h"
+#include "pass/nonreturn.h"
 #include "pass/resolvetls.h"
 #include "pass/fixjumptables.h"
 #include "pass/ifunclazy.h"
@@ -26,7 +31,11 @@
 #include "pass/encodingcheckpass.h"
 #include "pass/findinitfuncs.h"
 #include "disasm/objectoriented.h"
+#include "load/emulator.h"
 #include "transform/data.h"
+#include "util/threadpool.h"
+#include "util/timing.h"
+#include "parsecache.h"
 
 #include "parseoverride.h"
 
@@ -35,14 +44,21 @@
 
 IFuncList *egalito_ifuncList __attribute__((weak));
 
-Conductor::Conductor() : mainThreadPointer(0), ifuncList(nullptr) {
+Conductor::Conductor() : mainThreadPointer(0), ifuncList(nullptr),
+    vtableIndex(nullptr) {
+
     program = new Program();
     program->setLibraryList(new LibraryList());
+    exportTable = new ExportTable(program);
+    loaderEmulator = new LoaderEmulator();
 
     ParseOverride::getInstance()->parseFromEnvironmentVar();
 }
 
 Conductor::~Conductor() {
+    delete exportTable;
+    delete vtableIndex;
+    delete loaderEmulator;
     delete program;
 }
 
@@ -57,6 +73,29 @@ Module *Conductor::parseAnything(const std::string &fullPath, Library::Role role
     return parse(elf, library);
 }
 
+bool Conductor::parseIntoCache(const std::string &fullPath) {
+    ParseCache cache;
+    auto elf = new ElfMap(fullPath.c_str());
+    if(cache.getCachePath(elf).empty()) {
+        LOG(1, "can't cache [" << fullPath << "], no cache or build-id");
+        delete elf;
+        return false;
+    }
+
+    auto role = Library::guessRole(fullPath);
+    auto library = new Library(
+        Library::determineInternalName(fullPath, role), role);
+    library->setResolvedPath(fullPath);
+
+    auto space = parseElfSpace(elf, library);
+    if(!parseCachedModule(space, library, cache)) {
+        parseModule(space);
+        cache.store(elf, space->getModule());
+    }
+    addParsedModule(space);
+    return true;
+}
+
 Module *Conductor::parseExecutable(ElfMap *elf, const std::string &fullPath) {
     auto library = new Library("(executable)", Library::ROLE_MAIN);
     library->setResolvedPath(fullPath);
@@ -94,18 +133,164 @@ void Conductor::parseEgalitoElfSpaceOnly(ElfMap *elf, Module *module,
 }
 
 void Conductor::parseLibraries() {
+    EgalitoTraceSpan span("Conductor::parseLibraries");
     auto iterable = getLibraryList()->getChildren()->getIterable();
 
+    // Dependencies are discovered breadth-first: all libraries found so far
+    // are mapped in parallel, then their DT_NEEDED entries are read serially,
+    // which appends to the library list in the same order as a serial walk.
+    // The per-module passes then run in parallel. Modules are only
+    // independent until cross-module resolution (resolvePLTLinks,
+    // resolveData), which callers run afterwards.
+    //
+    // Only the ELF headers are needed to find dependencies, so the rest of
+    // each file, and its separate debug file, is read ahead in the
+    // background while the dependency walk and the other modules proceed.
+    std::vector<ElfSpace *> spaceList;
+    std::vector<Library *> libraryList;
+    ThreadPool pool;
+
     // we use an index here because the list can change as we iterate
-    for(size_t i = 0; i < iterable->getCount(); i ++) {
-        auto library = iterable->get(i);
-        if(library->getModule()) {
-            continue;  // already parsed
+    size_t i = 0;
+    while(i < iterable->getCount()) {
+        std::vector<Library *> frontier;
+        for( ; i < iterable->getCount(); i ++) {
+            auto library = iterable->get(i);
+            if(library->getModule()) {
+                continue;  // already parsed
+            }
+            frontier.push_back(library);
         }
 
-        ElfMap *elf = new ElfMap(library->getResolvedPathCStr());
-        parse(elf, library);
+        std::vector<ElfMap *> elfList(frontier.size());
+        pool.parallelFor(frontier.size(), [&] (size_t j) {
+            elfList[j] = new ElfMap(frontier[j]->getResolvedPathCStr());
+            elfList[j]->readAhead();
+        });
+
+        for(size_t j = 0; j < frontier.size(); j ++) {
+            spaceList.push_back(parseElfSpace(elfList[j], frontier[j]));
+            libraryList.push_back(frontier[j]);
+        }
+    }
+
+    deferUnusedLibraries(spaceList, libraryList);
+
+    ParseCache cache;
+    for(auto space : spaceList) {
+        // on a cache hit, the symbols come from the cache entry instead
+        auto cachePath = cache.getCachePath(space->getElfMap());
+        if(!cachePath.empty() && access(cachePath.c_str(), F_OK) == 0) {
+            continue;
+        }
+        if(!space->getSymbolFile().empty()) {
+            ElfMap::readAhead(space->getSymbolFile());
+        }
     }
+
+    pool.parallelFor(spaceList.size(), [&] (size_t i) {
+        auto space = spaceList[i];
+        if(parseCachedModule(space, libraryList[i], cache)) return;
+
+        parseModule(space);
+        if(cache.isEnabled()) {
+            cache.store(space->getElfMap(), space->getModule());
+        }
+    });
+
+    for(auto space : spaceList) {
+        addParsedModule(space);
+    }
+    EgalitoTracer::getInstance()->counter("modules",
+        program->getChildren()->getIterable()->getCount());
+}
+
+void Conductor::deferUnusedLibraries(std::vector<ElfSpace *> &spaceList,
+    std::vector<Library *> &libraryList) {
+
+    // EGALITO_LAZY_LIBS=libfoo.so:libbar.so names libraries that are only
+    // parsed if some other loaded object imports a symbol they define.
+    // Everything else is recorded in the LibraryList but never parsed,
+    // transformed or mapped, and its constructors do not run.
+    const char *lazy = getenv("EGALITO_LAZY_LIBS");
+    if(!lazy || !*lazy) return;
+
+    std::set<std::string> lazyNames;
+    std::string names(lazy);
+    for(size_t start = 0; start <= names.size(); ) {
+        size_t end = names.find(':', start);
+        if(end == std::string::npos) end = names.size();
+        if(end > start) lazyNames.insert(names.substr(start, end - start));
+        start = end + 1;
+    }
+
+    // only the dynamic symbol tables are read to decide
+    std::vector<SymbolList *> dynsymList(spaceList.size());
+    std::vector<bool> needed(spaceList.size());
+    std::vector<SymbolList *> neededImports;
+    std::vector<SymbolList *> ownedLists;
+    for(size_t i = 0; i < spaceList.size(); i ++) {
+        auto elf = spaceList[i]->getElfMap();
+        if(elf->isDynamic()) {
+            dynsymList[i] = SymbolList::buildDynamicSymbolList(elf);
+            ownedLists.push_back(dynsymList[i]);
+        }
+        needed[i] = !lazyNames.count(libraryList[i]->getName());
+        if(needed[i] && dynsymList[i]) neededImports.push_back(dynsymList[i]);
+    }
+    for(auto module : CIter::modules(program)) {
+        auto space = module->getElfSpace();
+        if(space && space->getDynamicSymbolList()) {
+            neededImports.push_back(space->getDynamicSymbolList());
+        }
+    }
+
+    auto importsFrom = [] (SymbolList *importer, SymbolList *exporter) {
+        for(auto sym : *importer) {
+            if(sym->getSectionIndex() != SHN_UNDEF) continue;
+            if(!*sym->getName()) continue;
+            auto def = exporter->find(sym->getName());
+            if(def && def->getSectionIndex() != SHN_UNDEF) return true;
+        }
+        return false;
+    };
+
+    // a library pulled in by the imports of another one may itself import
+    // from a third, so repeat until nothing changes
+    for(bool changed = true; changed; ) {
+        changed = false;
+        for(size_t i = 0; i < spaceList.size(); i ++) {
+            if(needed[i] || !dynsymList[i]) continue;
+            for(auto importer : neededImports) {
+                if(importsFrom(importer, dynsymList[i])) {
+                    LOG(1, "lazy library [" << libraryList[i]->getName()
+                        << "] is referenced, parsing it");
+                    needed[i] = true;
+                    neededImports.push_back(dynsymList[i]);
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    size_t kept = 0;
+    for(size_t i = 0; i < spaceList.size(); i ++) {
+        if(needed[i]) {
+            spaceList[kept] = spaceList[i];
+            libraryList[kept] = libraryList[i];
+            kept ++;
+        }
+        else {
+            LOG(1, "deferring unreferenced library ["
+                << libraryList[i]->getName() << "]");
+            delete spaceList[i];  // also frees the ElfMap
+        }
+    }
+    spaceList.resize(kept);
+    libraryList.resize(kept);
+
+    for(auto list : ownedLists) delete list;
 }
 
 Module *Conductor::parseAddOnLibrary(ElfMap *elf) {
@@ -122,28 +307,58 @@ Module *Conductor::parseExtraLibrary(ElfMap *elf, const std::string &name) {
 }
 
 Module *Conductor::parse(ElfMap *elf, Library *library) {
+    ElfSpace *space = parseElfSpace(elf, library);
+    parseModule(space);
+    return addParsedModule(space);
+}
+
+ElfSpace *Conductor::parseElfSpace(ElfMap *elf, Library *library) {
     program->add(library);  // add current lib before its dependencies
 
     ElfSpace *space = new ElfSpace(elf, library->getName(),
         library->getResolvedPath());
 
-    ParseOverride::getInstance()->setCurrentModule("module-" + library->getName());
+    ElfDynamic(getLibraryList()).parse(elf, library);
+
+    return space;
+}
+
+void Conductor::parseModule(ElfSpace *space) {
+    ParseOverride::getInstance()->setCurrentModule("module-" + space->getName());
 
     LOG(1, "\n=== BUILDING ELF DATA STRUCTURES for ["
         << space->getName() << "] ===");
     space->findSymbolsAndRelocs();
-    ElfDynamic(getLibraryList()).parse(elf, library);
 
     LOG(1, "--- RUNNING DEFAULT ELF PASSES for ["
         << space->getName() << "] ---");
     ConductorPasses(this).newElfPasses(space);
 
-    auto module = space->getModule();  // created in previous line
+    ParseOverride::getInstance()->clearCurrentModule();
+}
+
+bool Conductor::parseCachedModule(ElfSpace *space, Library *library,
+    ParseCache &cache) {
+
+    if(!cache.isEnabled()) return false;
+    auto module = cache.load(space->getElfMap(), library);
+    if(!module) return false;
+
+    LOG(1, "\n=== BUILDING ELF DATA STRUCTURES for ["
+        << space->getName() << "] (cached) ===");
+    space->findSymbolsAndRelocs();
+
+    space->setModule(module);
+    module->setElfSpace(space);
+    ConductorPasses(this).reloadedArchivePasses(module);
+    return true;
+}
+
+Module *Conductor::addParsedModule(ElfSpace *space) {
+    auto module = space->getModule();  // created in parseModule()
     program->add(module);
     module->setParent(program);
 
-    ParseOverride::getInstance()->clearCurrentModule();
-
     return module;
 }
 
@@ -158,6 +373,10 @@ void Conductor::parseEgalitoArchive(const char *archive) {
     else if(auto p = dynamic_cast<Program *>(newData)) {
         LOG(1, "Using full Chunk tree from archive [" << archive << "]");
         this->program = p;
+        delete exportTable;
+        exportTable = new ExportTable(program);
+        delete vtableIndex;
+        vtableIndex = nullptr;
     }
     /*else if(auto module = dynamic_cast<Module *>(newData)) {
         LOG(1, "Using Module \"" << module->getName()
@@ -172,9 +391,17 @@ void Conductor::parseEgalitoArchive(const char *archive) {
 }
 
 void Conductor::resolvePLTLinks() {
+    EgalitoTraceSpan span("Conductor::resolvePLTLinks");
     ResolvePLTPass resolvePLT(this);
     program->accept(&resolvePLT);
 
+    // each module was analyzed alone; now calls through the PLT can see
+    // which library functions never return
+    if(program->getChildren()->getIterable()->getCount() > 1) {
+        NonReturnFunction nonReturn;
+        program->accept(&nonReturn);
+    }
+
     if(program->getEgalito()) {
         PopulatePLTPass populatePLT(this);
         program->accept(&populatePLT);
@@ -189,6 +416,7 @@ void Conductor::resolveTLSLinks() {
 }
 
 void Conductor::resolveData(bool multipleElf, bool justBridge) {
+    EgalitoTraceSpan span("Conductor::resolveData");
     if(auto egalito = program->getEgalito()) {
         InjectBridgePass bridge(egalito->getElfSpace()->getRelocList());
         egalito->accept(&bridge);
@@ -242,9 +470,22 @@ void Conductor::resolveVTables() {
             module->getElfSpace()->getElfMap(),
             module->getElfSpace()->getSymbolList(),
             module->getElfSpace()->getRelocList(), module, program));
+
+        delete vtableIndex;
+        vtableIndex = nullptr;
     }
 }
 
+VTableIndex *Conductor::getVTableIndex() {
+    if(!vtableIndex) {
+        vtableIndex = new VTableIndex();
+        vtableIndex->add(program);
+        LOG(10, "indexed vtables of " << std::dec
+            << vtableIndex->getClassCount() << " classes");
+    }
+    return vtableIndex;
+}
+
 void Conductor::setupIFuncLazySelector() {
     this->ifuncList = new IFuncList();
     ::egalito_ifuncList = ifuncList;
@@ -256,6 +497,7 @@ void Conductor::setupIFuncLazySelector() {
 }
 
 void Conductor::fixDataSections(bool allocateTLS) {
+    EgalitoTraceSpan span("Conductor::fixDataSections");
     const static address_t base = 0x20000000;
     if(allocateTLS) {
         allocateTLSArea(base);
@@ -359,15 +601,7 @@ void Conductor::loadTLSDataFor(address_t tcb) {
 }
 
 void Conductor::writeDebugElf(const char *filename, const char *suffix) {
-    DebugElf debugElf;
-
-    for(auto module : CIter::modules(program)) {
-        for(auto func : CIter::functions(module)) {
-            debugElf.add(func, suffix);
-        }
-    }
-
-    debugElf.writeTo(filename);
+    DebugElfWriter::start(program, filename, suffix);
 }
 
 void Conductor::acceptInAllModules(ChunkVisitor *visitor, bool inEgalito) {
@@ -378,6 +612,25 @@ void Conductor::acceptInAllModules(ChunkVisitor *visitor, bool inEgalito) {
     }
 }
 
+Program *Conductor::cloneProgram() const {
+    auto clone = dynamic_cast<Program *>(ChunkSerializer().clone(program));
+    if(!clone) return nullptr;
+
+    // The clone shares the original's ElfSpaces (read-only ELF data and
+    // symbols), which remain owned by this Conductor's Modules.
+    std::map<std::string, ElfSpace *> spaceMap;
+    for(auto module : CIter::modules(program)) {
+        spaceMap[module->getName()] = module->getElfSpace();
+    }
+    for(auto module : CIter::modules(clone)) {
+        auto it = spaceMap.find(module->getName());
+        if(it != spaceMap.end() && it->second) {
+            module->setElfSpace(it->second);
+        }
+    }
+    return clone;
+}
+
 ElfSpace *Conductor::getMainSpace() const {
     return getProgram()->getFirst()->getElfSpace();
 }
@@ -3,16 +3,22 @@
 
 #include <string>
 #include <set>
+#include <vector>
 #include "types.h"
 #include "chunk/program.h"
 #include "chunk/module.h"
 #include "chunk/library.h"
 
 class ElfMap;
+class ElfSpace;
 class Module;
+class ParseCache;
 class ChunkVisitor;
 class IFuncList;
 struct EgalitoTLS;
+class ExportTable;
+class VTableIndex;
+class LoaderEmulator;
 
 class Conductor {
 private:
@@ -20,6 +26,9 @@ private:
     address_t mainThreadPointer;
     size_t TLSOffsetFromTCB;
     IFuncList *ifuncList;
+    ExportTable *exportTable;
+    VTableIndex *vtableIndex;
+    LoaderEmulator *loaderEmulator;
 
     std::set<Module *> resolveFinished;
 public:
@@ -37,6 +46,14 @@ public:
     Module *parseExtraLibrary(ElfMap *elf, const std::string &name = "");
     void parseEgalitoArchive(const char *archive);
 
+    /** Parses one library into the parse cache without its dependencies,
+        so that the per-module passes can be sharded across processes or
+        machines that share EGALITO_PARSE_CACHE. A later parseLibraries()
+        merges the entries and does the cross-module resolution. Returns
+        false if the library can't be cached.
+    */
+    bool parseIntoCache(const std::string &fullPath);
+
     void resolvePLTLinks();
     void resolveTLSLinks();
     void resolveData(bool multipleElf = false, bool justBridge = false);
@@ -45,23 +62,43 @@ public:
     void fixDataSections(bool allocateTLS = true);
     EgalitoTLS *getEgalitoTLS() const;
 
+    /** Writes the symbols of all functions on a background thread, from
+        a snapshot taken now; see DebugElfWriter. */
     void writeDebugElf(const char *filename, const char *suffix = "$new");
     void acceptInAllModules(ChunkVisitor *visitor, bool inEgalito = true);
 
     Program *getProgram() const { return program; }
     LibraryList *getLibraryList() const { return program->getLibraryList(); }
 
+    /** Deep-copies the Program so that speculative transformations can be
+        tried on the copy (e.g. one per thread) and simply discarded. The
+        copy shares this Conductor's ElfSpaces and must not outlive it.
+    */
+    Program *cloneProgram() const;
+
     // deprecated, please use getProgram()->getFirst()
     ElfSpace *getMainSpace() const;
 
     address_t getMainThreadPointer() const { return mainThreadPointer; }
     IFuncList *getIFuncList() const { return ifuncList; }
+    ExportTable *getExportTable() const { return exportTable; }
+    /** Emulated ld.so symbols, for this Conductor's Program only. */
+    LoaderEmulator *getLoaderEmulator() const { return loaderEmulator; }
+    /** Built on first use, and again after resolveVTables() adds some. */
+    VTableIndex *getVTableIndex();
 
     void loadTLSDataFor(address_t tcb);
 
     void check();
 private:
     Module *parse(ElfMap *elf, Library *library);
+    ElfSpace *parseElfSpace(ElfMap *elf, Library *library);
+    void parseModule(ElfSpace *space);
+    void deferUnusedLibraries(std::vector<ElfSpace *> &spaceList,
+        std::vector<Library *> &libraryList);
+    bool parseCachedModule(ElfSpace *space, Library *library,
+        ParseCache &cache);
+    Module *addParsedModule(ElfSpace *space);
     void allocateTLSArea(address_t base);
     void loadTLSData();
     void backupTLSData();
@@ -1,15 +1,23 @@
+#include <cstdlib>  // for std::exit
 #include "interface.h"
 
 #include "pass/fixenviron.h"
 #include "pass/collapseplt.h"
+#include "pass/directcalls.h"
+#include "pass/elidegot.h"
 #include "pass/promotejumps.h"
+#include "pass/shortenjumps.h"
+#include "pass/loopalign.h"
 #include "pass/ldsorefs.h"
 #include "pass/externalsymbollinks.h"
 #include "pass/ifuncplts.h"
+#include "util/feature.h"
 #include "log/registry.h"
 #include "log/log.h"
 
-EgalitoInterface::EgalitoInterface(bool verboseLogging, bool useLoggingEnvVar) {
+EgalitoInterface::EgalitoInterface(bool verboseLogging, bool useLoggingEnvVar)
+    : alignLoops(false), loopBlockCount(nullptr) {
+
     if(!verboseLogging) muteOutput();
 
     if(!parseLoggingEnvVar()) {
@@ -57,8 +65,25 @@ void EgalitoInterface::prepareForGeneration(bool isUnion) {
     CollapsePLTPass collapsePLT(setup.getConductor());
     getProgram()->accept(&collapsePLT);
 
+    if(isUnion) {
+        DirectCallsPass directCalls;
+        getProgram()->accept(&directCalls);
+
+        ElideGOTPass elideGOT;
+        getProgram()->accept(&elideGOT);
+    }
+
     PromoteJumpsPass promoteJumps;
     getProgram()->accept(&promoteJumps);
+
+    ShortenJumpsPass shortenJumps;
+    getProgram()->accept(&shortenJumps);
+
+    // padding depends on the final jump sizes, so this goes last
+    if(alignLoops || isFeatureEnabled("EGALITO_ALIGN_LOOPS")) {
+        LoopAlignPass loopAlign(32, loopBlockCount);
+        getProgram()->accept(&loopAlign);
+    }
 }
 
 void EgalitoInterface::generate(const std::string &outputName) {
@@ -67,7 +92,27 @@ void EgalitoInterface::generate(const std::string &outputName) {
 }
 
 void EgalitoInterface::generate(const std::string &outputName, bool isUnion) {
+    // before prepareForGeneration(), which would change most functions
+    if(!isUnion && isFeatureEnabled("EGALITO_PATCH_IN_PLACE")) {
+        LOG(0, "Patching 1-1 executable [" << outputName << "]...");
+        if(setup.generatePatchedELF(outputName.c_str())) return;
+        LOG(0, "Changes can't be patched in place, generating all code");
+    }
+
+    generateInto(outputName.c_str(), isUnion);
+}
+
+bool EgalitoInterface::generateImage(std::string &image, bool isUnion) {
+    if(!generateInto(nullptr, isUnion)) return false;
+    image.swap(setup.getGeneratedImage());
+    setup.getGeneratedImage().clear();
+    return true;
+}
+
+bool EgalitoInterface::generateInto(const char *outputFile, bool isUnion) {
     auto program = getProgram();
+    auto outputName = outputFile ? outputFile : "memory";
+
     prepareForGeneration(isUnion);
     if(!isUnion) {
         // generate mirror executable.
@@ -81,7 +126,7 @@ void EgalitoInterface::generate(const std::string &outputName, bool isUnion) {
         IFuncPLTs ifuncPLTs;
         program->accept(&ifuncPLTs);
 
-        setup.generateMirrorELF(outputName.c_str());
+        return setup.generateMirrorELF(outputFile);
     }
     else {
         // generate static executable.
@@ -91,7 +136,7 @@ void EgalitoInterface::generate(const std::string &outputName, bool isUnion) {
         IFuncPLTs ifuncPLTs;
         program->accept(&ifuncPLTs);
 
-        setup.generateStaticExecutable(outputName.c_str());
+        return setup.generateStaticExecutable(outputFile);
     }
 }
 
@@ -119,3 +164,11 @@ void EgalitoInterface::assignNewFunctionAddresses() {
     auto sandbox = setup.makeLoaderSandbox();
     setup.moveCodeAssignAddresses(sandbox, true);
 }
+
+void EgalitoInterface::exitWithoutTeardown(int status) {
+    if(!isFeatureEnabled("EGALITO_FAST_EXIT")) return;
+
+    // unlike _exit(), this flushes stdio and runs static destructors, but
+    // does not unwind the stack that owns this interface
+    std::exit(status);
+}
@@ -2,6 +2,8 @@
 #define EGALITO_CONDUCTOR_INTERFACE_H
 
 #include <string>
+#include <map>
+#include <cstdint>
 
 #include "setup.h"
 #include "conductor.h"
@@ -18,6 +20,8 @@
 class EgalitoInterface {
 private:
     ConductorSetup setup;
+    bool alignLoops;
+    const std::map<Block *, uint64_t> *loopBlockCount;
 public:
     /** Creates an EgalitoInterface. One EgalitoInterface can be reused,
         or multiple instances can be created (sequentially). Default arguments
@@ -80,6 +84,26 @@ public:
         uniongen, otherwise mirrorgen.
     */
     void generate(const std::string &outputName, bool isUnion);
+
+    /** Generates the output ELF into image instead of a file, e.g. to run
+        it with MemoryFile. Returns false if nothing was generated.
+    */
+    bool generateImage(std::string &image, bool isUnion);
+
+    /** Aligns hot loop heads while preparing for generation, as if
+        EGALITO_ALIGN_LOOPS were set. With blockCount, loops are hot if
+        their head was sampled; see LoopAlignPass.
+    */
+    void setAlignLoops(const std::map<Block *, uint64_t> *blockCount = nullptr)
+        { alignLoops = true; loopBlockCount = blockCount; }
+
+    /** Ends the process with status if EGALITO_FAST_EXIT is set, without
+        destroying the Program. Freeing a large Chunk tree one node at a
+        time can take seconds, which is wasted once the output is written.
+        Static destructors and atexit handlers still run, so logs, traces
+        and pass profiles are saved. Returns if the variable is not set.
+    */
+    void exitWithoutTeardown(int status = 0);
 public:
     // Public functions, but this interface could change.
     bool parseLoggingEnvVar(const char *envVar = "EGALITO_DEBUG");
@@ -87,6 +111,8 @@ public:
     bool setLogLevel(const char *logname, int level);
     void prepareForGeneration(bool isUnion);
     void assignNewFunctionAddresses();
+private:
+    bool generateInto(const char *outputFile, bool isUnion);
 };
 
 template <typename ChunkType>
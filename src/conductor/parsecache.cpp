@@ -0,0 +1,127 @@
+#include <sstream>
+#include <iomanip>
+#include <cstdlib>  // for getenv
+#include <cstdio>  // for std::rename, std::remove
+#include <unistd.h>  // for getpid
+#include "parsecache.h"
+#include "archive/archive.h"
+#include "archive/filesystem.h"
+#include "chunk/serializer.h"
+#include "chunk/module.h"
+#include "chunk/library.h"
+#include "elf/elfmap.h"
+#include "log/log.h"
+
+std::map<std::string, Module *> ParseCache::resident;
+std::mutex ParseCache::residentMutex;
+
+ParseCache::ParseCache() {
+    if(const char *variable = getenv("EGALITO_PARSE_CACHE")) {
+        directory = variable;
+    }
+}
+
+std::string ParseCache::getCachePath(ElfMap *elf) {
+    if(!isEnabled()) return "";
+
+    auto buildID = getBuildID(elf);
+    if(buildID.empty()) return "";
+
+    return directory + "/" + buildID + "-v"
+        + std::to_string(EgalitoArchive::VERSION) + ".ega";
+}
+
+Module *ParseCache::load(ElfMap *elf, Library *library) {
+    auto path = getCachePath(elf);
+    if(path.empty()) return nullptr;
+
+    Module *module = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(residentMutex);
+        auto it = resident.find(getBuildID(elf));
+        if(it != resident.end()) {
+            // a Module can only belong to one Program
+            module = (*it).second;
+            resident.erase(it);
+        }
+    }
+    if(!module) {
+        if(!ArchiveFileSystem().archivePathExists(path)) return nullptr;
+
+        Chunk *root = ChunkSerializer().deserialize(path);
+        module = dynamic_cast<Module *>(root);
+        if(!module) {
+            LOG(1, "Ignoring parse cache entry [" << path
+                << "], not a Module");
+            return nullptr;
+        }
+    }
+
+    // the archived Library describes the machine that wrote the entry
+    module->setLibrary(library);
+    library->setModule(module);
+    LOG(1, "Loaded [" << library->getName() << "] from parse cache "
+        << path);
+    return module;
+}
+
+void ParseCache::store(ElfMap *elf, Module *module) {
+    auto path = getCachePath(elf);
+    if(path.empty()) return;
+
+    ArchiveFileSystem().makeArchivePath(path);
+
+    // write to a private name first, so concurrent readers never see a
+    // partial entry
+    auto temporary = path + ".tmp" + std::to_string(getpid());
+    ChunkSerializer().serialize(module, temporary, /*compress=*/ true);
+    if(std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        LOG(1, "Could not add [" << path << "] to parse cache");
+        return;
+    }
+    LOG(1, "Stored [" << module->getName() << "] in parse cache " << path);
+}
+
+bool ParseCache::retain(const std::string &path) {
+    if(!isEnabled()) return false;
+
+    ElfMap elf(path.c_str());
+    auto buildID = getBuildID(&elf);
+    if(buildID.empty()) return false;
+
+    std::lock_guard<std::mutex> lock(residentMutex);
+    if(resident.find(buildID) != resident.end()) return true;
+
+    auto cachePath = getCachePath(&elf);
+    if(!ArchiveFileSystem().archivePathExists(cachePath)) return false;
+
+    auto module = dynamic_cast<Module *>(
+        ChunkSerializer().deserialize(cachePath));
+    if(!module) return false;
+
+    resident[buildID] = module;
+    LOG(1, "Retained [" << path << "] from parse cache " << cachePath);
+    return true;
+}
+
+std::string ParseCache::getBuildID(ElfMap *elf) {
+    auto section = elf->findSection(".note.gnu.build-id");
+    if(!section) return "";
+
+    // Elf_Nhdr is three 32-bit words: namesz, descsz, type
+    auto note = reinterpret_cast<const uint32_t *>(section->getReadAddress());
+    size_t size = section->getSize();
+    if(size < 3 * sizeof(uint32_t)) return "";
+
+    size_t nameSize = (note[0] + 3) & ~3;
+    size_t descSize = note[1];
+    if(3 * sizeof(uint32_t) + nameSize + descSize > size) return "";
+
+    auto desc = reinterpret_cast<const unsigned char *>(note + 3) + nameSize;
+    std::ostringstream id;
+    for(size_t i = 0; i < descSize; i ++) {
+        id << std::hex << std::setw(2) << std::setfill('0') << int(desc[i]);
+    }
+    return id.str();
+}
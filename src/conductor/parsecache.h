@@ -0,0 +1,51 @@
+#ifndef EGALITO_CONDUCTOR_PARSE_CACHE_H
+#define EGALITO_CONDUCTOR_PARSE_CACHE_H
+
+#include <map>
+#include <mutex>
+#include <string>
+
+class ElfMap;
+class Module;
+class Library;
+
+/** Content-addressed store of analyzed Modules, so that shared libraries
+    need to be parsed only once per machine.
+
+    Set EGALITO_PARSE_CACHE to a directory to enable it. Entries are keyed
+    by the ELF build-id and the archive version and hold the Module as it
+    is after ConductorPasses::newElfPasses(), before any cross-module
+    linking, and are written compressed. ELF files without a build-id are
+    never cached.
+
+    A long-running process can also retain() entries in memory. Processes
+    it forks afterwards take their own copy-on-write copy of the Module
+    instead of reading the entry again.
+*/
+class ParseCache {
+private:
+    std::string directory;
+    static std::map<std::string, Module *> resident;  // by build-id
+    static std::mutex residentMutex;  // load() runs in parallel
+public:
+    ParseCache();
+
+    bool isEnabled() const { return !directory.empty(); }
+    const std::string &getDirectory() const { return directory; }
+
+    /** Returns an empty string if elf cannot be cached. */
+    std::string getCachePath(ElfMap *elf);
+
+    /** Returns a Module attached to library, or nullptr on a miss. */
+    Module *load(ElfMap *elf, Library *library);
+    void store(ElfMap *elf, Module *module);
+
+    /** Loads the entry for the ELF file at path and keeps it in memory.
+        Returns false if there is no entry for it yet. The retained Module
+        must not be used by this process itself, only by its children. */
+    bool retain(const std::string &path);
+private:
+    std::string getBuildID(ElfMap *elf);
+};
+
+#endif
@@ -30,6 +30,7 @@ BlockBoundaryOverride *BlockBoundaryOverride::parse(std::istream &stream,
 }
 
 ParseOverride ParseOverride::instance;
+thread_local std::string ParseOverride::currentModule;
 
 void ParseOverride::parseFromEnvironmentVar() {
     const char *envp = getenv("EGALITO_PARSE_OVERRIDES");
@@ -122,7 +122,8 @@ private:
 public:
     static ParseOverride *getInstance() { return &instance; }
 private:
-    std::string currentModule;
+    // per-thread, since several modules may be parsed concurrently
+    static thread_local std::string currentModule;
 
     OverrideContainer<
         BlockBoundaryOverride, OverrideContext>::type blockOverrides;
@@ -1,3 +1,4 @@
+#include <set>
 #include "passes.h"
 #include "conductor.h"
 
@@ -28,10 +29,12 @@
 #include "pass/updatelink.h"
 #include "pass/collectglobals.h"
 #include "analysis/jumptable.h"
+#include "util/timing.h"
 #include "log/log.h"
 #include "log/temp.h"
 
 void ConductorPasses::newElfPasses(ElfSpace *space) {
+    EgalitoTraceSpan span("ConductorPasses::newElfPasses");
     ElfMap *elf = space->getElfMap();
     RelocList *relocList = space->getRelocList();
 
@@ -68,7 +71,7 @@ void ConductorPasses::newElfPasses(ElfSpace *space) {
     // be run multiple times
 
     // we need to run these before jump table passes, too
-    RUN_PASS(SplitBasicBlock(), module);
+    RUN_PASS_PARALLEL(SplitBasicBlock(), module);
     RUN_PASS(NonReturnFunction(), module);
 
     RUN_PASS(JumpTablePass(), module);
@@ -80,11 +83,32 @@ void ConductorPasses::newElfPasses(ElfSpace *space) {
     RUN_PASS(JumpTableOverestimate(), module);
 #endif
 
-    // run again with jump table information
-    RUN_PASS(SplitBasicBlock(), module);
+    // run again with jump table information. Internal links were already
+    // split at above, so only functions owning a jump table can change,
+    // and only those that did need their non-return status redone.
+    {
+        EgalitoTiming timing("SplitBasicBlock() on jump table functions");
+        std::vector<Function *> worklist = getJumpTableFunctions(module);
+        std::vector<unsigned long> before;
+        for(auto function : worklist) {
+            before.push_back(function->getModificationCount());
+        }
 
-    // need SplitBasicBlock()
-    RUN_PASS(NonReturnFunction(), module);
+        runParallelChunkPass<SplitBasicBlock>(worklist,
+            [] () { return SplitBasicBlock(); });
+
+        std::set<Function *> changed;
+        for(size_t i = 0; i < worklist.size(); i ++) {
+            if(worklist[i]->getModificationCount() != before[i]) {
+                changed.insert(worklist[i]);
+            }
+        }
+
+        // need SplitBasicBlock()
+        if(!changed.empty()) {
+            RUN_PASS(NonReturnFunction(changed), module);
+        }
+    }
 #ifdef ARCH_AARCH64
     if(!space->getSymbolList()) {
         RUN_PASS(SplitFunction(), module);
@@ -100,6 +124,23 @@ void ConductorPasses::newElfPasses(ElfSpace *space) {
     // DataVariables created later in Conductor::resolveData().
 }
 
+std::vector<Function *> ConductorPasses::getJumpTableFunctions(
+    Module *module) {
+
+    std::vector<Function *> functionList;
+    auto jumpTableList = module->getJumpTableList();
+    if(!jumpTableList) return functionList;
+
+    std::set<Function *> seen;
+    for(auto jumpTable : CIter::children(jumpTableList)) {
+        auto function = jumpTable->getFunction();
+        if(function && seen.insert(function).second) {
+            functionList.push_back(function);
+        }
+    }
+    return functionList;
+}
+
 void ConductorPasses::newArchivePasses(Program *program) {
     //RUN_PASS(ChunkDumper(), program);
 
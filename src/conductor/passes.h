@@ -1,9 +1,11 @@
 #ifndef EGALITO_CONDUCTOR_PASSES_H
 #define EGALITO_CONDUCTOR_PASSES_H
 
+#include <vector>
 #include "elf/elfspace.h"
 
 class Conductor;
+class Function;
 
 class ConductorPasses {
 private:
@@ -15,6 +17,8 @@ public:
     void newExecutablePasses(Program *program);
     void newMirrorPasses(Program *program);
     void reloadedArchivePasses(Module *module);
+private:
+    std::vector<Function *> getJumpTableFunctions(Module *module);
 };
 
 #endif
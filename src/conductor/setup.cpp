@@ -2,6 +2,7 @@
 #include <cstring>
 #include <climits>  // for PATH_MAX
 #include <unistd.h>  // for readlink
+#include <sys/stat.h>
 #include "config.h"
 #include "setup.h"
 #include "conductor.h"
@@ -13,10 +14,16 @@
 #include "operation/find2.h"
 #include "pass/clearspatial.h"
 #include "pass/dumplink.h"
+#include "pass/memoryfootprint.h"
 #include "util/feature.h"
+#include "util/timing.h"
 #include "generate/uniongen.h"
 #include "generate/mirrorgen.h"
 #include "generate/kernelgen.h"
+#include "generate/layoutmanifest.h"
+#include "generate/patchgen.h"
+#include "generate/section.h"
+#include "generate/sectionlist.h"
 #include "log/registry.h"
 #include "log/log.h"
 #include "log/temp.h"
@@ -50,7 +57,7 @@ void ConductorSetup::parseEgalito(bool fromArchive) {
         egalitoModule = conductor->parseEgalito(egalito, path);
     }
 
-    LoaderEmulator::getInstance().setup(conductor);
+    conductor->getLoaderEmulator()->setup(conductor);
 }
 
 void ConductorSetup::createNewProgram() {
@@ -63,6 +70,7 @@ void ConductorSetup::createNewProgram() {
 Module *ConductorSetup::parseElfFiles(const char *executable,
     bool withSharedLibs, bool injectEgalito) {
 
+    EgalitoTraceSpan span("ConductorSetup::parseElfFiles");
     createNewProgram();
     return injectElfFiles(executable, withSharedLibs, injectEgalito);
 }
@@ -90,7 +98,7 @@ Module *ConductorSetup::injectElfFiles(const char *executable, Library::Role rol
     }
     else {
         // !!! this should be done differently
-        LoaderEmulator::getInstance().setupForExecutableGen(conductor);
+        conductor->getLoaderEmulator()->setupForExecutableGen(conductor);
     }
 
     if(withSharedLibs) {
@@ -258,19 +266,30 @@ Sandbox *ConductorSetup::makeLoaderSandbox() {
 }
 
 ShufflingSandbox *ConductorSetup::makeShufflingSandbox() {
-    auto backing = MemoryBacking(sandboxBase, 1 * 0x1000 * 0x1000);
-    sandboxBase += 2 * 0x1000 * 0x1000;
+    auto backing = shufflingPool.acquire();
     auto sandbox1 = new SandboxImpl<MemoryBacking,
         WatermarkAllocator<MemoryBacking>>(backing);
 
-    auto backing2 = MemoryBacking(sandboxBase, 1 * 0x1000 * 0x1000);
-    sandboxBase += 2 * 0x1000 * 0x1000;
+    auto backing2 = shufflingPool.acquire();
     auto sandbox2 = new SandboxImpl<MemoryBacking,
         WatermarkAllocator<MemoryBacking>>(backing2);
     return new DualSandbox<SandboxImpl<MemoryBacking,
         WatermarkAllocator<MemoryBacking>>>(sandbox1, sandbox2);
 }
 
+void ConductorSetup::releaseShufflingSandbox(ShufflingSandbox *sandbox) {
+    for(size_t i = 0; i < 2; i ++) {
+        auto half = sandbox->getHalf(i);
+        shufflingPool.release(static_cast<MemoryBacking *>(half->getBacking()));
+        delete half;
+    }
+    delete sandbox;
+
+    auto stats = shufflingPool.getStats();
+    LOG(1, "shuffling sandbox regions: " << std::dec << stats.inUse
+        << " in use, " << stats.free << " free, peak " << stats.peak);
+}
+
 Sandbox *ConductorSetup::makeFileSandbox(const char *outputFile) {
     auto backing = MemoryBacking(SANDBOX_BASE_ADDRESS, MAX_SANDBOX_SIZE);
     return new SandboxImpl<MemoryBacking,
@@ -290,6 +309,7 @@ Sandbox *ConductorSetup::makeKernelSandbox(const char *outputFile) {
 }
 
 bool ConductorSetup::generateStaticExecutable(const char *outputFile) {
+    EgalitoTraceSpan span("ConductorSetup::generate");
     auto sandbox = makeStaticExecutableSandbox(outputFile);
     auto backing = static_cast<MemoryBufferBacking *>(sandbox->getBacking());
     auto program = conductor->getProgram();
@@ -312,11 +332,12 @@ bool ConductorSetup::generateStaticExecutable(const char *outputFile) {
     }
 
     //generator.generate(outputFile);
-    generator.generateContent(outputFile);
-    return true;
+    generator.generateContent(outputFile ? outputFile : "");
+    return keepImage(backing, outputFile);
 }
 
 bool ConductorSetup::generateMirrorELF(const char *outputFile) {
+    EgalitoTraceSpan span("ConductorSetup::generate");
     auto sandbox = makeStaticExecutableSandbox(outputFile);
     auto backing = static_cast<MemoryBufferBacking *>(sandbox->getBacking());
     auto program = conductor->getProgram();
@@ -338,13 +359,13 @@ bool ConductorSetup::generateMirrorELF(const char *outputFile) {
     }
 
     //generator.generate(outputFile);
-    generator.generateContent(outputFile);
-    return true;
+    return generateMirrorContent(generator, backing, outputFile);
 }
 
 bool ConductorSetup::generateMirrorELF(const char *outputFile,
     const std::vector<Function *> &order) {
 
+    EgalitoTraceSpan span("ConductorSetup::generate");
     auto sandbox = makeStaticExecutableSandbox(outputFile);
     auto backing = static_cast<MemoryBufferBacking *>(sandbox->getBacking());
     auto program = conductor->getProgram();
@@ -368,11 +389,66 @@ bool ConductorSetup::generateMirrorELF(const char *outputFile,
     }
 
     //generator.generate(outputFile);
+    return generateMirrorContent(generator, backing, outputFile);
+}
+
+bool ConductorSetup::generatePatchedELF(const char *outputFile) {
+    EgalitoTraceSpan span("ConductorSetup::generate");
+    PatchGen generator(conductor->getProgram()->getMain());
+    if(!generator.prepare()) return false;
+
+    return generator.generate(outputFile);
+}
+
+bool ConductorSetup::generateMirrorContent(MirrorGen &generator,
+    MemoryBufferBacking *backing, const char *outputFile) {
+
+    if(!outputFile) {
+        generator.generateContent("");
+        return keepImage(backing, outputFile);
+    }
+    if(!isFeatureEnabled("EGALITO_INCREMENTAL")) {
+        generator.generateContent(outputFile);
+        return true;
+    }
+
+    LayoutManifest manifest;
+    manifest.build(conductor->getProgram(), backing);
+
+    LayoutManifest previous;
+    auto manifestFile = LayoutManifest::getFilename(outputFile);
+    if(previous.load(manifestFile)
+        && manifest.patchOutput(outputFile, previous)) {
+
+        return true;
+    }
+
+    LOG(0, "Incremental output: regenerating all of " << outputFile);
     generator.generateContent(outputFile);
+
+    auto text = (*generator.getData()->getSectionList())[".text"];
+    struct stat st;
+    if(text && stat(outputFile, &st) == 0) {
+        manifest.setTextOffset(text->getOffset());
+        manifest.setFileSize(st.st_size);
+        manifest.save(manifestFile);
+    }
     return true;
 }
 
+bool ConductorSetup::keepImage(MemoryBufferBacking *backing,
+    const char *outputFile) {
+
+    if(outputFile) return true;
+
+    // the sandbox outlives this call, so don't leave a second copy in it
+    generatedImage.clear();
+    generatedImage.swap(backing->getImage());
+    return !generatedImage.empty();
+}
+
 bool ConductorSetup::generateKernel(const char *outputFile) {
+    EgalitoTraceSpan span("ConductorSetup::generate");
     auto sandbox = makeKernelSandbox(outputFile);
     auto backing = static_cast<MemoryBufferBacking *>(sandbox->getBacking());
     auto program = conductor->getProgram();
@@ -398,6 +474,7 @@ bool ConductorSetup::generateKernel(const char *outputFile) {
 }
 
 void ConductorSetup::moveCode(Sandbox *sandbox, bool useDisps) {
+    EgalitoTraceSpan span("ConductorSetup::moveCode");
     // 1. assign new addresses to all code
     moveCodeAssignAddresses(sandbox, useDisps);
 
@@ -409,7 +486,12 @@ void ConductorSetup::moveCode(Sandbox *sandbox, bool useDisps) {
 }
 
 void ConductorSetup::moveCodeAssignAddresses(Sandbox *sandbox, bool useDisps) {
-    Generator(sandbox, useDisps).assignAddresses(conductor->getProgram());
+    if(isFeatureEnabled("EGALITO_COMPACT")) compactMemory();
+    Generator generator(sandbox, useDisps);
+    generator.setPackHotPLTs(isFeatureEnabled("EGALITO_PACK_HOT_PLTS"));
+    generator.setShuffleFunctions(
+        isFeatureEnabled("EGALITO_SHUFFLE_FUNCTIONS"));
+    generator.assignAddresses(conductor->getProgram());
 }
 
 void ConductorSetup::copyCodeToNewAddresses(Sandbox *sandbox, bool useDisps) {
@@ -420,6 +502,19 @@ void ConductorSetup::moveCodeMakeExecutable(Sandbox *sandbox) {
     sandbox->finalize();
 }
 
+void ConductorSetup::compactMemory() {
+    auto program = conductor->getProgram();
+    IF_LOG(9) {
+        MemoryFootprintPass footprint;
+        program->accept(&footprint);
+        footprint.dump();
+    }
+
+    for(auto module : CIter::modules(program)) {
+        if(auto space = module->getElfSpace()) space->compact();
+    }
+}
+
 void ConductorSetup::dumpElfSpace(ElfSpace *space) {
     ChunkDumper dumper;
     space->getModule()->accept(&dumper);
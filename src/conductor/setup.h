@@ -11,6 +11,7 @@
 class Conductor;
 class Sandbox;
 class Symbol;
+class MirrorGen;
 
 /** Main setup class for Egalito.
 
@@ -28,9 +29,13 @@ private:
     ElfMap *egalito;
     Conductor *conductor;
     address_t sandboxBase;
+    SandboxRegionPool shufflingPool;
+    std::string generatedImage;
 public:
     ConductorSetup() : elf(nullptr), egalito(nullptr), conductor(nullptr),
-        sandboxBase(SANDBOX_BASE_ADDRESS) {}
+        sandboxBase(SANDBOX_BASE_ADDRESS),
+        shufflingPool(&sandboxBase, 1 * 0x1000 * 0x1000,
+            2 * 0x1000 * 0x1000) {}
     Module *parseElfFiles(const char *executable, bool withSharedLibs = true,
         bool injectEgalito = false);
     Module *injectElfFiles(const char *executable, bool withSharedLibs = true,
@@ -45,23 +50,40 @@ public:
     void createNewProgram();  // optional
     Sandbox *makeLoaderSandbox();
     ShufflingSandbox *makeShufflingSandbox();
+    /** Returns both halves to the pool; the sandbox must not be in use. */
+    void releaseShufflingSandbox(ShufflingSandbox *sandbox);
     Sandbox *makeFileSandbox(const char *outputFile);
     Sandbox *makeStaticExecutableSandbox(const char *outputFile);
     Sandbox *makeKernelSandbox(const char *outputFile);
+    /** With a null outputFile, these generate the ELF into memory, for
+        getGeneratedImage(), instead of writing a file. */
     bool generateStaticExecutable(const char *outputFile);
     bool generateMirrorELF(const char *outputFile);
     bool generateMirrorELF(const char *outputFile,
         const std::vector<Function *> &order);
+    /** Writes a copy of the main module's ELF with only the changed
+        functions moved (see PatchGen). Returns false, without changing
+        anything, if that can't express the changes. */
+    bool generatePatchedELF(const char *outputFile);
     bool generateKernel(const char *outputFile);
     void moveCode(Sandbox *sandbox, bool useDisps = true);
 public:
+    /** Setting EGALITO_PACK_HOT_PLTS places the most-called PLT entries
+        next to each other, and EGALITO_SHUFFLE_FUNCTIONS places functions
+        in a random order.
+    */
     void moveCodeAssignAddresses(Sandbox *sandbox, bool useDisps);
     void copyCodeToNewAddresses(Sandbox *sandbox, bool useDisps);
     void moveCodeMakeExecutable(Sandbox *sandbox);
+    /** Frees parse-time data that code generation no longer needs. Runs
+        automatically before address assignment if EGALITO_COMPACT is set.
+    */
+    void compactMemory();
 public:
     ElfMap *getElfMap() const { return elf; }
     ElfMap *getEgalitoElfMap() const { return egalito; }
     Conductor *getConductor() const { return conductor; }
+    std::string &getGeneratedImage() { return generatedImage; }
 public:
     void dumpElfSpace(ElfSpace *space);
     void dumpFunction(const char *function, ElfSpace *space = nullptr);
@@ -71,6 +93,9 @@ private:
     void findEntryPointFunction();
     void setBaseAddresses();
     bool setBaseAddress(Module *module, ElfMap *map, address_t base);
+    bool generateMirrorContent(MirrorGen &generator,
+        MemoryBufferBacking *backing, const char *outputFile);
+    bool keepImage(MemoryBufferBacking *backing, const char *outputFile);
 };
 
 #endif
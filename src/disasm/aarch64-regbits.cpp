@@ -9,7 +9,8 @@ void AARCH64RegBits::invalidateCache() {
 }
 
 void AARCH64RegBits::decode(const char *bytes) {
-    bin = bytes[3] << 24 | bytes[2] << 16 | bytes[1] << 8 | bytes[0];
+    auto b = reinterpret_cast<const unsigned char *>(bytes);
+    bin = uint32_t(b[3]) << 24 | b[2] << 16 | b[1] << 8 | b[0];
     invalidateCache();
 }
 
@@ -21,33 +22,34 @@ void AARCH64RegBits::encode(char *bytes) {
 }
 
 bool AARCH64RegBits::isReading(PhysicalRegister<AARCH64GPRegister>& reg) {
-    auto list = getRegPositionList();
-    for(auto rpos : list.first) {
-        uint32_t rr = bin >> rpos & regMask;
-        if(rr == reg.encoding()) {
-            return true;
-        }
-    }
-    return false;
+    return getReadMask() & (1ull << reg.encoding());
 }
 
 bool AARCH64RegBits::isWriting(PhysicalRegister<AARCH64GPRegister>& reg) {
-    auto list = getRegPositionList();
-    for(auto wpos : list.second) {
-        uint32_t wr = bin >> wpos & regMask;
-        if(wr == reg.encoding()) {
-            return true;
-        }
-    }
-    return false;
+    return getWriteMask() & (1ull << reg.encoding());
 }
 
+uint64_t AARCH64RegBits::getReadMask() {
+    return makeMask(getRegPositionList().first);
+}
+
+uint64_t AARCH64RegBits::getWriteMask() {
+    return makeMask(getRegPositionList().second);
+}
+
+uint64_t AARCH64RegBits::makeMask(const RegPositions &positions) const {
+    uint64_t mask = 0;
+    for(auto pos : positions) {
+        mask |= 1ull << (bin >> pos & regMask);
+    }
+    return mask;
+}
 
 void AARCH64RegBits::replaceRegister(
     PhysicalRegister<AARCH64GPRegister>& oldReg,
     PhysicalRegister<AARCH64GPRegister>& newReg) {
 
-    auto list = getRegPositionList();
+    const auto &list = getRegPositionList();
     for(auto rpos : list.first) {
         auto rr = bin >> rpos & regMask;
         if(rr == oldReg.encoding()) {
@@ -64,7 +66,7 @@ void AARCH64RegBits::replaceRegister(
     invalidateCache();
 }
 
-AARCH64RegBits::RegPositionsList AARCH64RegBits::getRegPositionList() {
+const AARCH64RegBits::RegPositionsList &AARCH64RegBits::getRegPositionList() {
     if(!cached) {
         //C4.1
         auto op0 = bin >> 25 & 0xF;
@@ -22,11 +22,15 @@ public:
     void encode(char *bytes);
     bool isReading(PhysicalRegister<AARCH64GPRegister> &reg);
     bool isWriting(PhysicalRegister<AARCH64GPRegister> &reg);
+    /** One bit per register encoding read (or written) by the instruction. */
+    uint64_t getReadMask();
+    uint64_t getWriteMask();
     void replaceRegister(PhysicalRegister<AARCH64GPRegister>& oldReg,
                          PhysicalRegister<AARCH64GPRegister>& newReg);
 
 private:
-    RegPositionsList getRegPositionList();
+    const RegPositionsList &getRegPositionList();
+    uint64_t makeMask(const RegPositions &positions) const;
     void makeDPImm_RegPositionList();
     void makeBranch_RegPositionList();
     void makeLDST_RegPositionList();
@@ -2,6 +2,8 @@
 #include <cstring>
 #include <cassert>
 #include <set>
+#include <algorithm>
+#include <iterator>
 #include <sstream>  // for debugging
 #include <capstone/x86.h>
 #include <capstone/arm64.h>
@@ -9,6 +11,7 @@
 #include "disassemble.h"
 #include "dump.h"
 #include "makesemantic.h"
+#include "quickdecode.h"
 #include "objectoriented.h"
 #include "elf/symbol.h"
 #include "chunk/chunk.h"
@@ -16,6 +19,7 @@
 #include "operation/mutator.h"
 #include "instr/concrete.h"
 #include "util/intervaltree.h"
+#include "util/threadpool.h"
 #include "instr/writer.h"  // for debugging
 #include "log/log.h"
 #include "log/temp.h"
@@ -46,8 +50,7 @@ Module *Disassemble::module(ElfMap *elfMap, SymbolList *symbolList,
 Instruction *Disassemble::instruction(const std::vector<unsigned char> &bytes,
     bool details, address_t address) {
 
-    DisasmHandle handle(true);
-    return instruction(handle, bytes, details, address);
+    return instruction(DisasmHandle::forThread(), bytes, details, address);
 }
 Instruction *Disassemble::instruction(DisasmHandle &handle,
     const std::vector<unsigned char> &bytes, bool details, address_t address) {
@@ -74,8 +77,8 @@ Instruction *Disassemble::instruction(rv_instr *ins, DisasmHandle &handle,
 Assembly Disassemble::makeAssembly(const std::vector<unsigned char> &str,
     address_t address) {
 
-    DisasmHandle handle(true);
-    return DisassembleInstruction(handle, true).makeAssembly(str, address);
+    return DisassembleInstruction(DisasmHandle::forThread(), true)
+        .makeAssembly(str, address);
 }
 
 Module *Disassemble::makeModuleFromSymbols(ElfMap *elfMap,
@@ -89,6 +92,14 @@ Module *Disassemble::makeModuleFromSymbols(ElfMap *elfMap,
 
     if(!symbolList) return module;
 
+    // functions are decoded in parallel and in no particular file order, so
+    // start paging in all the code up front
+    for(auto section : elfMap->getSectionList()) {
+        if(section->getHeader()->sh_flags & SHF_EXECINSTR) {
+            elfMap->prefetch(section->getReadAddress(), section->getSize());
+        }
+    }
+
 #ifdef ARCH_X86_64
     /* consider any space between start of .text and first function as
         potential crt function locations */
@@ -120,12 +131,23 @@ Module *Disassemble::makeModuleFromSymbols(ElfMap *elfMap,
     }
 #endif
 
+    // skip Symbols that we don't think represent functions
+    std::vector<Symbol *> functionSymbols;
     for(auto sym : *symbolList) {
-        // skip Symbols that we don't think represent functions
-        if(!sym->isFunction()) continue;
+        if(sym->isFunction()) functionSymbols.push_back(sym);
+    }
+
+    // Each function is disassembled independently (every thread has its
+    // own capstone handle), then added in symbol order so the output is
+    // identical to a serial run.
+    std::vector<Function *> functions(functionSymbols.size());
+    ThreadPool pool;
+    pool.parallelFor(functionSymbols.size(), [&] (size_t i) {
+        functions[i] = Disassemble::function(elfMap, functionSymbols[i],
+            symbolList, dynamicSymbolList);
+    });
 
-        Function *function = Disassemble::function(elfMap, sym, symbolList,
-            dynamicSymbolList);
+    for(auto function : functions) {
         functionList->getChildren()->add(function);
         function->setParent(functionList);
         LOG(10, "adding function " << function->getName()
@@ -422,18 +444,18 @@ rv_instr *DisassembleInstruction::runDisassembly(const uint8_t *bytes,
 
     assert(size == 2 || size == 4);
 
+    // decode in place, rather than through a one-element vector
     rv_instr *ins = new rv_instr;
-    auto buf = rv_disasm_buffer(rv64, address, bytes, size);
-    if(buf.size() == 0) {
+    if(rv_disasm_instr(ins, rv64, address, bytes, size) == 0) {
         LOG(1, "When disassembling at address " << address);
         LOG(1, "bytes: (len " << std::dec << size << ")");
         for(size_t i = 0; i < size; i ++) {
             CLOG(1, "    %x\n", bytes[i]);
         }
+        delete ins;
         throw "Invalid instruction provided\n";
     }
-    assert(buf.size() == 1);
-    *ins = buf[0];
+    assert(ins->len == size);
 
     return ins;
 }
@@ -515,68 +537,35 @@ Function *DisassembleX86Function::fuzzyFunction(const Range &range,
     return function;
 }
 
-void DisassembleX86Function::firstDisassemblyPass(ElfSection *section,
-    IntervalTree &splitRanges, IntervalTree &functionPadding) {
+void DisassembleX86Function::decodeRange(ElfSection *section,
+    DecodedRange &decoded) {
 
-    // Get address of region to disassemble
-    address_t virtualAddress = section->getVirtualAddress();
+    const Range &range = decoded.range;
     address_t readAddress = section->getReadAddress()
-        + section->convertVAToOffset(virtualAddress);
-    size_t readSize = section->getSize();
-
-    cs_insn *insn;
-    size_t count = cs_disasm(handle.raw(),
-        (const uint8_t *)readAddress, readSize, virtualAddress, 0, &insn);
+        + section->convertVAToOffset(range.getStart());
+    auto list = QuickDecode::instructions((const uint8_t *)readAddress,
+        range.getSize(), range.getStart());
 
     size_t nopBytes = 0;
-    //enum { PROLOGUE_NONE, PROLOGUE_PUSH } prologueState = PROLOGUE_NONE;
-    for(size_t j = 0; j < count; j++) {
-        auto ins = &insn[j];
-
-        address_t target = 0;
-        if(shouldSplitFunctionDueTo(ins, &target)) {
-            splitRanges.splitAt(target);
+    for(const auto &ins : list) {
+        if(ins.kind == QuickInstruction::KIND_CALL) {
+            decoded.callTargets.push_back(ins.target);
         }
 
-        if(ins->id == X86_INS_NOP) {
-            nopBytes += ins->size;
+        if(ins.kind == QuickInstruction::KIND_NOP) {
+            nopBytes += ins.size;
         }
         else if(nopBytes) {
-            functionPadding.add(Range(ins->address - nopBytes, nopBytes));
+            decoded.nopRuns.push_back(Range(ins.address - nopBytes, nopBytes));
             nopBytes = 0;
         }
-
-#if 0
-        switch(prologueState) {
-        case PROLOGUE_NONE:
-            if(ins->id == X86_INS_PUSH && ins->detail->x86.op_count == 1
-                && ins->detail->x86.operands[0].type == X86_OP_REG
-                && ins->detail->x86.operands[0].reg == X86_REG_RBP) {
-
-                prologueState = PROLOGUE_PUSH;
-            }
-            break;
-        case PROLOGUE_PUSH:
-            if(ins->id == X86_INS_MOV && ins->detail->x86.op_count == 2
-                && ins->detail->x86.operands[0].type == X86_OP_REG
-                && ins->detail->x86.operands[1].type == X86_OP_REG
-                && ins->detail->x86.operands[0].reg == X86_REG_RSP
-                && ins->detail->x86.operands[1].reg == X86_REG_RBP) {
-
-                splitRanges.splitAt(ins->address - 1);  // back before push
-            }
-            prologueState = PROLOGUE_NONE;
-            break;
-        }
-#endif
     }
 
     if(nopBytes) {
-        functionPadding.add(Range(virtualAddress + readSize - nopBytes,
-            nopBytes));
+        const auto &last = list.back();
+        decoded.nopRuns.push_back(
+            Range(last.address + last.size - nopBytes, nopBytes));
     }
-
-    if(count > 0) cs_free(insn, count);
 }
 
 // for deregister_tm_clones, register_tm_clones, __do_global_dtors_aux, and frame_dummy
@@ -585,11 +574,10 @@ void DisassembleX86Function::disassembleCrtBeginFunctions(ElfSection *section,
 
     LOG(1, "range: " << std::hex << crtbegin.getStart() << " " << crtbegin.getSize());
 
-    cs_insn *insn;
-    size_t count = cs_disasm(handle.raw(),
+    auto list = QuickDecode::instructions(
         (const uint8_t *)section->getReadAddress()
             + section->convertVAToOffset(crtbegin.getStart()),
-        crtbegin.getSize(), crtbegin.getStart(), 0, &insn);
+        crtbegin.getSize(), crtbegin.getStart());
 
     // We find the crtbegin functions by extrapolating from the ret statements
     // that are followed by nops. Because these functions are very strange, the
@@ -602,40 +590,39 @@ void DisassembleX86Function::disassembleCrtBeginFunctions(ElfSection *section,
         MODE_FOUND          // done, end the function!
     } mode = MODE_NONE;
 
-    for(size_t j = 0; j < count; j++) {
-        auto ins = &insn[j];
+    for(const auto &ins : list) {
+        bool isRet = (ins.kind == QuickInstruction::KIND_RET);
+        bool isNop = (ins.kind == QuickInstruction::KIND_NOP);
 
         bool redo;
         do {
             redo = false;
             switch(mode) {
             case MODE_NONE:
-                if(ins->id == X86_INS_RET) mode = MODE_RET;
+                if(isRet) mode = MODE_RET;
                 break;
             case MODE_RET:
-                if(ins->id == X86_INS_NOP) mode = MODE_NOP;
+                if(isNop) mode = MODE_NOP;
                 else mode = MODE_NONE, redo = true;
                 break;
             case MODE_NOP:
-                if(ins->id == X86_INS_NOP) mode = MODE_NOP;
+                if(isNop) mode = MODE_NOP;
                 else mode = MODE_MAYBE_FOUND, redo = true;
                 break;
             case MODE_MAYBE_FOUND:
                 // if we see ret+nop+ret sequence, wait until second ret
-                if(ins->id == X86_INS_RET) mode = MODE_RET;
+                if(isRet) mode = MODE_RET;
                 else mode = MODE_FOUND, redo = true;
                 break;
             case MODE_FOUND:
                 LOG(1, "splitting crtbegin function at 0x"
-                    << std::hex << ins->address);
-                splitRanges.splitAt(ins->address);
+                    << std::hex << ins.address);
+                splitRanges.splitAt(ins.address);
                 mode = MODE_NONE, redo = true;
                 break;
             }
         } while(redo);
     }
-
-    if(count > 0) cs_free(insn, count);
 }
 
 FunctionList *DisassembleX86Function::linearDisassembly(const char *sectionName,
@@ -644,6 +631,7 @@ FunctionList *DisassembleX86Function::linearDisassembly(const char *sectionName,
 
     auto section = elfMap->findSection(sectionName);
     if(!section) return nullptr;
+    elfMap->adviseSection(section, ElfMap::ACCESS_SEQUENTIAL);
 
     Range sectionRange(section->getVirtualAddress(), section->getSize());
 
@@ -685,43 +673,129 @@ FunctionList *DisassembleX86Function::linearDisassembly(const char *sectionName,
         }
     }
 
-    // Run first disassembly pass, to find obvious function boundaries
-    IntervalTree splitRanges(sectionRange);
-    splitRanges.add(sectionRange);
-    splitRanges.splitAt(elfMap->getEntryPoint());
-    if(auto s = elfMap->findSection(".init_array")) {
-        for(size_t i = 0; i < s->getSize(); i ++) {
-            splitRanges.splitAt(*reinterpret_cast<address_t *>(s->getReadAddress() + i));
+    // Seeds for recursive traversal: the entry point and init/fini entries
+    std::vector<address_t> seeds;
+    seeds.push_back(elfMap->getEntryPoint());
+    for(auto name : {".init_array", ".fini_array"}) {
+        if(auto s = elfMap->findSection(name)) {
+            for(size_t i = 0; i + sizeof(address_t) <= s->getSize();
+                i += sizeof(address_t)) {
+
+                seeds.push_back(*reinterpret_cast<address_t *>(
+                    s->getReadAddress() + i));
+            }
         }
     }
-    if(auto s = elfMap->findSection(".fini_array")) {
-        for(size_t i = 0; i < s->getSize(); i ++) {
-            splitRanges.splitAt(*reinterpret_cast<address_t *>(s->getReadAddress() + i));
+
+    // Known functions are decoded from their starts, merged into disjoint
+    // spans. Only the gaps between spans are swept linearly, and the sweep
+    // restarts at every seed or call target that lands in a gap, so it
+    // resynchronizes on real instruction boundaries. These sweeps only need
+    // lengths, calls and nops, so they use QuickDecode; capstone details
+    // are only decoded for the final functions, never for padding.
+    std::vector<Range> spanList;
+    for(const Range &func : knownFunctions.getAllData()) {
+        if(!spanList.empty() && func.getStart() < spanList.back().getEnd()) {
+            auto &last = spanList.back();
+            last = Range::fromEndpoints(last.getStart(),
+                std::max(last.getEnd(), func.getEnd()));
+        }
+        else {
+            spanList.push_back(func);
         }
     }
 
+    ThreadPool pool;
+    auto decodeAll = [&] (const std::vector<Range> &rangeList) {
+        std::vector<DecodedRange> decodedList(rangeList.begin(),
+            rangeList.end());
+        pool.parallelFor(decodedList.size(), [&] (size_t i) {
+            decodeRange(section, decodedList[i]);
+        });
+        return decodedList;
+    };
+    std::vector<DecodedRange> spanDecoded = decodeAll(spanList);
+
+    for(const auto &decoded : spanDecoded) {
+        seeds.insert(seeds.end(), decoded.callTargets.begin(),
+            decoded.callTargets.end());
+    }
+    std::sort(seeds.begin(), seeds.end());
+    seeds.erase(std::unique(seeds.begin(), seeds.end()), seeds.end());
+
+    std::vector<Range> gapList;
+    auto addGap = [&] (address_t start, address_t end) {
+        auto it = std::upper_bound(seeds.begin(), seeds.end(), start);
+        for( ; it != seeds.end() && *it < end; ++it) {
+            gapList.push_back(Range::fromEndpoints(start, *it));
+            start = *it;
+        }
+        if(start < end) gapList.push_back(Range::fromEndpoints(start, end));
+    };
+    address_t gapStart = sectionRange.getStart();
+    for(const Range &span : spanList) {
+        addGap(gapStart, span.getStart());
+        gapStart = span.getEnd();
+    }
+    addGap(gapStart, sectionRange.getEnd());
+    std::vector<DecodedRange> gapDecoded = decodeAll(gapList);
+
+    std::vector<DecodedRange> decodedList;
+    decodedList.reserve(spanDecoded.size() + gapDecoded.size());
+    std::merge(spanDecoded.begin(), spanDecoded.end(),
+        gapDecoded.begin(), gapDecoded.end(), std::back_inserter(decodedList),
+        [] (const DecodedRange &a, const DecodedRange &b) {
+            return a.range.getStart() < b.range.getStart(); });
+
+    // Split at every call target, to find obvious function boundaries
+    IntervalTree splitRanges(sectionRange);
+    splitRanges.add(sectionRange);
+    std::vector<address_t> splitPoints = seeds;
+    for(const auto &decoded : gapDecoded) {
+        splitPoints.insert(splitPoints.end(), decoded.callTargets.begin(),
+            decoded.callTargets.end());
+    }
+    splitRanges.splitAtAll(std::move(splitPoints));
+
+    // nop runs may continue from one decoded range into the next
     IntervalTree functionPadding(sectionRange);
-    firstDisassemblyPass(section, splitRanges, functionPadding);
+    std::vector<Range> paddingList;
+    for(const auto &decoded : decodedList) {
+        for(const Range &nops : decoded.nopRuns) {
+            if(!paddingList.empty()
+                && paddingList.back().getEnd() == nops.getStart()) {
+
+                paddingList.back() = Range::fromEndpoints(
+                    paddingList.back().getStart(), nops.getEnd());
+            }
+            else {
+                paddingList.push_back(nops);
+            }
+        }
+    }
+    functionPadding.addAll(std::move(paddingList));
 
     // Shrink functions, removing nop padding bytes
     IntervalTree functionsWithoutPadding(sectionRange);
-    splitRanges.getRoot()->inStartOrderTraversal([&] (Range func) {
+    std::vector<Range> shrunkList;
+    splitRanges.inStartOrderTraversal([&] (Range func) {
         Range bound;
         if(functionPadding.findLowerBoundOrOverlapping(func.getEnd(), &bound)) {
             LOG(10, "looks like function " << func << " may have some padding");
             if(func.getEnd() == bound.getEnd() || bound.contains(func.getEnd())) {
-                functionsWithoutPadding.add(Range::fromEndpoints(
+                shrunkList.push_back(Range::fromEndpoints(
                     func.getStart(), bound.getStart()));
             }
             else {
-                functionsWithoutPadding.add(func);
+                shrunkList.push_back(func);
             }
         }
     });
+    functionsWithoutPadding.addAll(std::move(shrunkList));
 
     // Remove nop padding byte ranges after all known functions
     // (achieved by removing all functions plus nops, then adding back in)
-    knownFunctions.getRoot()->inStartOrderTraversal([&] (Range func) {
+    knownFunctions.inStartOrderTraversal([&] (Range func) {
         Range bound;
         if(functionPadding.findLowerBoundOrOverlapping(func.getEnd(), &bound)) {
             LOG(10, "looks like function " << func << " may have some padding");
@@ -764,11 +838,19 @@ FunctionList *DisassembleX86Function::linearDisassembly(const char *sectionName,
     LOG(1, "Splitting code section into " << intervalList.size()
         << " fuzzy functions");
 
+    std::vector<Function *> functions(intervalList.size());
+    pool.parallelFor(intervalList.size(), [&] (size_t i) {
+        DisasmHandle workerHandle(true);
+        DisassembleX86Function worker(workerHandle, elfMap);
+        functions[i] = worker.fuzzyFunction(intervalList[i], section);
+    });
+
     FunctionList *functionList = new FunctionList();
-    for(const Range &range : intervalList) {
+    for(size_t i = 0; i < intervalList.size(); i ++) {
+        const Range &range = intervalList[i];
         LOG(11, "Split into function " << range << " at section offset "
             << section->convertVAToOffset(range.getStart()));
-        Function *function = fuzzyFunction(range, section);
+        Function *function = functions[i];
 
         if(auto dsym = dynamicSymbolList->find(range.getStart())) {
             LOG(12, "    renaming fuzzy function [" << function->getName()
@@ -820,12 +902,12 @@ Function *DisassembleAARCH64Function::function(Symbol *symbol,
 
     bool literal = false;
     size_t offset = 0;
-    Symbol *mapping = nullptr;
+    MappingCursor cursor;
     if(symbolList) {
-        mapping = symbolList->findMappingBelowOrAt(symbol);
+        cursor = symbolList->findMappings(symbol);
     }
 
-    if(mapping) {
+    if(Symbol *mapping = cursor.get()) {
         LOG(10, "mapping symbol below " << symbol->getName()
             << " at " << std::hex << symbol->getAddress()
             << " - " << (symbol->getAddress() + symbol->getSize())
@@ -834,7 +916,7 @@ Function *DisassembleAARCH64Function::function(Symbol *symbol,
 
         address_t end = symbol->getAddress() + symbol->getSize();
         literal = processMappingSymbol(mapping);
-        while((mapping = symbolList->findMappingAbove(mapping))) {
+        while((mapping = cursor.next())) {
             LOG(10, "    next mapping symbol is #"
                 << std::dec << mapping->getIndex());
             if(end <= mapping->getAddress()) {
@@ -876,6 +958,7 @@ FunctionList *DisassembleAARCH64Function::linearDisassembly(
 
     auto section = elfMap->findSection(sectionName);
     if(!section) return nullptr;
+    elfMap->adviseSection(section, ElfMap::ACCESS_SEQUENTIAL);
 
     //TemporaryLogLevel tll("disasm", 10);
 
@@ -906,10 +989,12 @@ FunctionList *DisassembleAARCH64Function::linearDisassembly(
     IntervalTree splitRanges(codeRange);
     splitRanges.add(codeRange);
 
+    std::vector<address_t> sectionBoundaries;
     for(auto s : sectionList) {
-        splitRanges.splitAt(s->getVirtualAddress());
-        splitRanges.splitAt(s->getVirtualAddress() + s->getSize());
+        sectionBoundaries.push_back(s->getVirtualAddress());
+        sectionBoundaries.push_back(s->getVirtualAddress() + s->getSize());
     }
+    splitRanges.splitAtAll(std::move(sectionBoundaries));
     LOG(10, "initial section boundaries");
     IF_LOG(10) dump(splitRanges);
 
@@ -991,36 +1076,29 @@ void DisassembleAARCH64Function::firstDisassemblyPass(ElfSection *section,
         + section->convertVAToOffset(virtualAddress);
     size_t readSize = section->getSize();
 
-    for(size_t size = 0; size < readSize; ) {
-        cs_insn *insn;
-        size_t count = cs_disasm(handle.raw(),
-            (const uint8_t *)readAddress + size,
-            readSize - size,
-            virtualAddress + size,
-            0, &insn);
-        for(size_t j = 0; j < count; j++) {
-            auto ins = &insn[j];
-
-            address_t target = 0;
-            if(shouldSplitFunctionDueTo(ins, &target)) {
-                splitRanges.splitAt(target);
-            }
+    // split at call targets, and at jumps to the next instruction
+    std::vector<address_t> targets;
+    auto list = QuickDecode::instructions((const uint8_t *)readAddress,
+        readSize, virtualAddress);
+    for(const auto &ins : list) {
+        if(ins.kind == QuickInstruction::KIND_CALL) {
+            targets.push_back(ins.target);
         }
+        else if(ins.kind == QuickInstruction::KIND_JUMP
+            && ins.target == ins.address + 4) {
 
-        if(count > 0) {
-            cs_free(insn, count);
-            size += count * 4;
-        }
-        else {
-            size += 4;
+            LOG(10, " strange uncoditional jump to next address");
+            targets.push_back(ins.target);
         }
     }
+    splitRanges.splitAtAll(std::move(targets));
 }
 
 // this could be run multiple times until it converges
 void DisassembleAARCH64Function::finalDisassemblyPass(ElfSection *section,
     IntervalTree &splitRanges) {
 
+    std::vector<address_t> targets;
     for(auto const& range : splitRanges.getAllData()) {
         address_t virtualAddress = range.getStart();
         address_t readAddress = section->getReadAddress()
@@ -1041,7 +1119,7 @@ void DisassembleAARCH64Function::finalDisassemblyPass(ElfSection *section,
                 if(shouldSplitFunctionDueTo2(ins, virtualAddress,
                     virtualAddress + readSize, &target)) {
 
-                    splitRanges.splitAt(target);
+                    targets.push_back(target);
                 }
             }
 
@@ -1054,31 +1132,36 @@ void DisassembleAARCH64Function::finalDisassemblyPass(ElfSection *section,
             }
         }
     }
+    splitRanges.splitAtAll(std::move(targets));
 }
 
 void DisassembleAARCH64Function::splitByDynamicSymbols(
     SymbolList *dynamicSymbolList, IntervalTree &splitRanges) {
 
     if(!dynamicSymbolList) return;
+    std::vector<address_t> points;
     for(auto sym : *dynamicSymbolList) {
         if(sym->getType() == Symbol::TYPE_FUNC
             && sym->getSectionIndex() != SHN_UNDEF) {
 
-            splitRanges.splitAt(sym->getAddress());
-            splitRanges.splitAt(sym->getAddress() + sym->getSize());
+            points.push_back(sym->getAddress());
+            points.push_back(sym->getAddress() + sym->getSize());
         }
     }
+    splitRanges.splitAtAll(std::move(points));
 }
 
 void DisassembleAARCH64Function::splitByRelocations(
     RelocList *relocList, IntervalTree &splitRanges) {
 
     if(!relocList) return;
+    std::vector<address_t> points;
     for(auto r : *relocList) {
         if(r->getType() == R_AARCH64_RELATIVE) {
-            splitRanges.splitAt(r->getAddend());
+            points.push_back(r->getAddend());
         }
     }
+    splitRanges.splitAtAll(std::move(points));
 }
 
 Function *DisassembleAARCH64Function::fuzzyFunction(const Range &range,
@@ -1257,23 +1340,12 @@ FunctionList *DisassembleRISCVFunction::linearDisassembly(
 }
 
 
-void DisassembleFunctionBase::disassembleBlocks(Function *function,
-    address_t readAddress, size_t readSize, address_t virtualAddress) {
+template <typename InsnType>
+void DisassembleFunctionBase::makeBlocks(Function *function, InsnType *insn,
+    size_t count, size_t readSize) {
 
     PositionFactory *positionFactory = PositionFactory::getInstance();
 
-    LOG(19, "disassemble 0x" << std::hex << readAddress << " size " << readSize
-        << ", virtual address " << virtualAddress);
-    #ifndef ARCH_RISCV
-    cs_insn *insn;
-    size_t count = cs_disasm(handle.raw(),
-        (const uint8_t *)readAddress, readSize, virtualAddress, 0, &insn);
-    #else
-    auto insn = rv_disasm_buffer(rv64, virtualAddress,
-        (const uint8_t *)readAddress, readSize);
-    size_t count = insn.size();
-    #endif
-
     Block *block = makeBlock(function, nullptr);
 
     for(size_t j = 0; j < count; j++) {
@@ -1320,6 +1392,28 @@ void DisassembleFunctionBase::disassembleBlocks(Function *function,
         LOG(1, "disassembly error? " << function->getName()
             << " " << function->getSize() << " < " << readSize);
     }
+}
+
+void DisassembleFunctionBase::disassembleBlocks(Function *function,
+    address_t readAddress, size_t readSize, address_t virtualAddress) {
+
+    LOG(19, "disassemble 0x" << std::hex << readAddress << " size " << readSize
+        << ", virtual address " << virtualAddress);
+    #ifndef ARCH_RISCV
+    cs_insn *insn;
+    size_t count = cs_disasm(handle.raw(),
+        (const uint8_t *)readAddress, readSize, virtualAddress, 0, &insn);
+    #else
+    auto insn = rv_disasm_buffer(rv64, virtualAddress,
+        (const uint8_t *)readAddress, readSize);
+    size_t count = insn.size();
+    #endif
+
+    #ifndef ARCH_RISCV
+    makeBlocks(function, insn, count, readSize);
+    #else
+    makeBlocks(function, insn.data(), count, readSize);
+    #endif
 
 #ifdef ARCH_X86_64
     if(false) {
@@ -1630,47 +1724,6 @@ bool DisassembleFunctionBase::shouldSplitBlockAt(rv_instr *ins) {
 
 #endif
 
-bool DisassembleFunctionBase::shouldSplitFunctionDueTo(cs_insn *ins,
-    address_t *target) {
-
-#ifdef ARCH_X86_64
-    if(cs_insn_group(handle.raw(), ins, X86_GRP_CALL)) {
-        cs_x86 *x = &ins->detail->x86;
-        cs_x86_op *op = &x->operands[0];
-        if(x->op_count > 0 && op->type == X86_OP_IMM) {
-            *target = op->imm;
-            return true;
-        }
-    }
-#elif defined(ARCH_AARCH64)
-    if(ins->id == ARM64_INS_BL) {
-        cs_arm64 *x = &ins->detail->arm64;
-        cs_arm64_op *op = &x->operands[0];
-        if(x->op_count > 0 && op->type == ARM64_OP_IMM) {
-            *target = op->imm;
-            return true;
-        }
-    }
-    if(ins->id == ARM64_INS_B) {
-        cs_arm64 *x = &ins->detail->arm64;
-        cs_arm64_op *op = &x->operands[0];
-        if(x->op_count == 1 && op->type == ARM64_OP_IMM) {
-            address_t dest = op->imm;
-            if(dest == ins->address + 4) {
-                LOG(10, " strange uncoditional jump to next address");
-                *target = dest;
-                return true;
-            }
-        }
-    }
-#elif defined(ARCH_ARM)
-    #error "Not yet implemented"
-#elif defined(ARCH_RISCV)
-    LOG(1, "shouldSplitFunctionDueTo NYI for RISCV");
-#endif
-    return false;
-}
-
 bool DisassembleFunctionBase::shouldSplitFunctionDueTo2(cs_insn *ins,
     address_t start, address_t end, address_t *target) {
 
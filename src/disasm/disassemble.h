@@ -63,6 +63,10 @@ protected:
     Block *makeBlock(Function *function, Block *prev);
     void disassembleBlocks(Function *function, address_t readAddress,
         size_t readSize, address_t virtualAddress);
+    /** Builds function's blocks from already-decoded instructions. */
+    template <typename InsnType>
+    void makeBlocks(Function *function, InsnType *insn, size_t count,
+        size_t readSize);
     void disassembleCustomBlocks(Function *function, address_t readAddress,
         address_t virtualAddress,
         const std::vector<std::pair<address_t, size_t>> &blockBoundaries);
@@ -71,7 +75,6 @@ protected:
     #ifdef ARCH_RISCV
     bool shouldSplitBlockAt(rv_instr *ins);
     #endif
-    bool shouldSplitFunctionDueTo(cs_insn *ins, address_t *target);
     bool shouldSplitFunctionDueTo2(cs_insn *ins, address_t start,
         address_t end, address_t *target);
 };
@@ -87,8 +90,15 @@ public:
         DwarfUnwindInfo *dwarfInfo, SymbolList *dynamicSymbolList,
         RelocList *relocList);
 private:
-    void firstDisassemblyPass(ElfSection *section,
-        IntervalTree &splitRanges, IntervalTree &functionPadding);
+    /** Call targets and padding found in one range of a code section. */
+    struct DecodedRange {
+        Range range;
+        std::vector<address_t> callTargets;
+        std::vector<Range> nopRuns;
+
+        DecodedRange(const Range &range) : range(range) {}
+    };
+    void decodeRange(ElfSection *section, DecodedRange &decoded);
 public:
     void disassembleCrtBeginFunctions(ElfSection *section, Range crtbegin,
         IntervalTree &splitRanges);
@@ -1,36 +1,62 @@
 #include "handle.h"
 
-bool DisasmHandle::initialized[2] = {false, false};
-csh DisasmHandle::handle[2];
+namespace {
+    struct ThreadHandles {
+        bool initialized[2] = {false, false};
+        csh handle[2];
 
-DisasmHandle::DisasmHandle(bool detailed) {
-    this->which = detailed ? 1 : 0;
-    csh *h = &handle[which];
-    if(!initialized[which]) {
-#ifdef ARCH_X86_64
-        if(cs_open(CS_ARCH_X86, CS_MODE_64, h) != CS_ERR_OK) {
-            throw "Can't initialize capstone handle!";
+        ~ThreadHandles() {
+            for(int i = 0; i < 2; i ++) {
+                if(initialized[i]) cs_close(&handle[i]);
+            }
         }
+    };
+
+    thread_local ThreadHandles threadHandles;
+}
+
+static void openHandle(csh *h, bool detailed) {
+#ifdef ARCH_X86_64
+    if(cs_open(CS_ARCH_X86, CS_MODE_64, h) != CS_ERR_OK) {
+        throw "Can't initialize capstone handle!";
+    }
 #elif defined(ARCH_AARCH64)
-        if(cs_open(CS_ARCH_ARM64, CS_MODE_LITTLE_ENDIAN, h) != CS_ERR_OK) {
-            throw "Can't initialize capstone handle!";
-        }
+    if(cs_open(CS_ARCH_ARM64, CS_MODE_LITTLE_ENDIAN, h) != CS_ERR_OK) {
+        throw "Can't initialize capstone handle!";
+    }
 #elif defined(ARCH_ARM)
-        if(cs_open(CS_ARCH_ARM, CS_MODE_ARM, h) != CS_ERR_OK) {
-            throw "Can't initialize capstone handle!";
-        }
+    if(cs_open(CS_ARCH_ARM, CS_MODE_ARM, h) != CS_ERR_OK) {
+        throw "Can't initialize capstone handle!";
+    }
 #endif
 
-        cs_option(*h, CS_OPT_SYNTAX, CS_OPT_SYNTAX_ATT);  // AT&T syntax
-        if(detailed) {
-            cs_option(*h, CS_OPT_DETAIL, CS_OPT_ON);
-        }
-
-        initialized[which] = true;
+    cs_option(*h, CS_OPT_SYNTAX, CS_OPT_SYNTAX_ATT);  // AT&T syntax
+    if(detailed) {
+        cs_option(*h, CS_OPT_DETAIL, CS_OPT_ON);
     }
 }
 
+DisasmHandle::DisasmHandle(bool detailed) {
+    this->which = detailed ? 1 : 0;
+    raw();
+}
+
 DisasmHandle::~DisasmHandle() {
     //cs_close(&handle);
 }
 
+DisasmHandle &DisasmHandle::forThread(bool detailed) {
+    thread_local DisasmHandle handle[2] = {
+        DisasmHandle(false), DisasmHandle(true)};
+    return handle[detailed ? 1 : 0];
+}
+
+csh &DisasmHandle::raw() {
+    // static DisasmHandles may be shared by threads, so check every time
+    auto &handles = threadHandles;
+    if(!handles.initialized[which]) {
+        openHandle(&handles.handle[which], which == 1);
+        handles.initialized[which] = true;
+    }
+    return handles.handle[which];
+}
@@ -3,16 +3,24 @@
 
 #include <capstone/capstone.h>
 
+/** Wrapper around the capstone disassembler handle.
+
+    Capstone handles may not be used concurrently, so each thread lazily
+    opens its own pair of handles (with and without instruction details).
+    All DisasmHandle instances on one thread share that thread's handles;
+    code that does not already have one should use forThread().
+*/
 class DisasmHandle {
 private:
-    static bool initialized[2];
-    static csh handle[2];
     int which;
 public:
     DisasmHandle(bool detailed = false);
     ~DisasmHandle();
 
-    csh &raw() { return handle[which]; }
+    csh &raw();
+
+    /** The calling thread's handle, opened on first use. */
+    static DisasmHandle &forThread(bool detailed = true);
 };
 
 #endif
@@ -17,7 +17,7 @@ InstructionSemantic *MakeSemantic::makeNormalSemantic(
     Instruction *instruction, cs_insn *ins) {
 
     InstructionSemantic *semantic = nullptr;
-    DisasmHandle handle(true);
+    auto &handle = DisasmHandle::forThread();
 
 #if defined(ARCH_X86_64)
     cs_x86 *x = &ins->detail->x86;
@@ -184,7 +184,7 @@ InstructionSemantic *MakeSemantic::makeNormalSemantic(
     Instruction *instruction, rv_instr *ins) {
 
     InstructionSemantic *semantic = nullptr;
-    DisasmHandle handle(true);
+    auto &handle = DisasmHandle::forThread();
 
     bool is_cflow = false;
     if(ins->codec == rv_codec_sb) is_cflow = true;
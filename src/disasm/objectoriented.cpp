@@ -55,6 +55,7 @@ VTable *DisassembleVTables::makeVTable(ElfMap *elfMap,
     size_t index = 0;
     index += 8;  // skip top_offset pointer
     index += 8;  // skip typeinfo pointer
+    vtable->setAddressPoint(vtableSymbol->getAddress() + index);
     for( ; index < vtableSymbol->getSize(); index += 8) {
         address_t vtableEntry = vtableSymbol->getAddress() + index;
         LOG(19, "vtableSymbol at " << vtableEntry);
@@ -0,0 +1,319 @@
+#include "quickdecode.h"
+
+#ifdef ARCH_X86_64
+namespace {
+    // low nibble: immediate kind; high bits: flags
+    enum {
+        B = 1,  // imm8
+        W = 2,  // imm16
+        Z = 3,  // imm16 or imm32, by operand size
+        V = 4,  // imm16, imm32 or imm64, by operand size
+        E = 5,  // enter: imm16 and imm8
+        O = 6,  // moffs, by address size
+        G = 7,  // group 3 (test): imm only for /0 and /1
+        D = 8,  // rel32, whatever the operand size
+        M = 0x10,   // has a ModRM byte
+        X = 0x80,   // invalid in 64-bit mode
+    };
+
+    // prefixes, REX, and escapes (0f, VEX, EVEX) are handled separately
+    const unsigned char oneByteMap[256] = {
+        M,  M,  M,  M,  B,  Z,  X,  X,  M,  M,  M,  M,  B,  Z,  X,  0,    // 00
+        M,  M,  M,  M,  B,  Z,  X,  X,  M,  M,  M,  M,  B,  Z,  X,  X,    // 10
+        M,  M,  M,  M,  B,  Z,  0,  X,  M,  M,  M,  M,  B,  Z,  0,  X,    // 20
+        M,  M,  M,  M,  B,  Z,  0,  X,  M,  M,  M,  M,  B,  Z,  0,  X,    // 30
+        0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,    // 40
+        0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,    // 50
+        X,  X,  X,  M,  0,  0,  0,  0,  Z,M|Z,  B,M|B,  0,  0,  0,  0,    // 60
+        B,  B,  B,  B,  B,  B,  B,  B,  B,  B,  B,  B,  B,  B,  B,  B,    // 70
+      M|B,M|Z,  X,M|B,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,    // 80
+        0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  X,  0,  0,  0,  0,  0,    // 90
+        O,  O,  O,  O,  0,  0,  0,  0,  B,  Z,  0,  0,  0,  0,  0,  0,    // a0
+        B,  B,  B,  B,  B,  B,  B,  B,  V,  V,  V,  V,  V,  V,  V,  V,    // b0
+      M|B,M|B,  W,  0,  X,  X,M|B,M|Z,  E,  0,  W,  0,  0,  B,  X,  0,    // c0
+        M,  M,  M,  M,  X,  X,  X,  0,  M,  M,  M,  M,  M,  M,  M,  M,    // d0
+        B,  B,  B,  B,  B,  B,  B,  B,  D,  D,  X,  B,  0,  0,  0,  0,    // e0
+        0,  0,  0,  0,  0,  0,M|G,M|G,  0,  0,  0,  0,  0,  0,  M,  M,    // f0
+    };
+
+    // 0f xx; 0f 38 and 0f 3a are always ModRM, and 0f 3a always has imm8
+    const unsigned char twoByteMap[256] = {
+        M,  M,  M,  M,  X,  0,  0,  0,  0,  0,  X,  0,  X,  M,  0,M|B,    // 00
+        M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,    // 10
+        M,  M,  M,  M,  X,  X,  X,  X,  M,  M,  M,  M,  M,  M,  M,  M,    // 20
+        0,  0,  0,  0,  0,  0,  X,  0,  X,  X,  X,  X,  X,  X,  X,  X,    // 30
+        M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,    // 40
+        M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,    // 50
+        M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,    // 60
+      M|B,M|B,M|B,M|B,  M,  M,  M,  0,  M,  M,  M,  M,  M,  M,  M,  M,    // 70
+        D,  D,  D,  D,  D,  D,  D,  D,  D,  D,  D,  D,  D,  D,  D,  D,    // 80
+        M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,    // 90
+        0,  0,  0,  M,M|B,  M,  X,  X,  0,  0,  0,  M,M|B,  M,  M,  M,    // a0
+        M,  M,  M,  M,  M,  M,  M,  M,  M,  M,M|B,  M,  M,  M,  M,  M,    // b0
+        M,  M,M|B,  M,M|B,M|B,M|B,  M,  0,  0,  0,  0,  0,  0,  0,  0,    // c0
+        M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,    // d0
+        M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,    // e0
+        M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,  M,    // f0
+    };
+
+    const size_t MAX_LENGTH = 15;
+
+    int64_t readSigned(const unsigned char *p, size_t size) {
+        switch(size) {
+        case 1: return static_cast<int8_t>(p[0]);
+        case 2: return static_cast<int16_t>(p[0] | (p[1] << 8));
+        case 4: return static_cast<int32_t>(p[0] | (p[1] << 8)
+            | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24));
+        default: return 0;
+        }
+    }
+}
+
+bool QuickDecode::instruction(const unsigned char *bytes, size_t size,
+    address_t address, QuickInstruction *out) {
+
+    if(size > MAX_LENGTH) size = MAX_LENGTH;
+    size_t i = 0;
+
+    bool opsize = false, addrsize = false, repz = false;
+    unsigned char rex = 0;
+    for( ; i < size; i ++) {
+        unsigned char b = bytes[i];
+        if(b == 0x66) opsize = true;
+        else if(b == 0x67) addrsize = true;
+        else if(b == 0xf3) repz = true;
+        else if(b == 0xf0 || b == 0xf2 || b == 0x26 || b == 0x2e
+            || b == 0x36 || b == 0x3e || b == 0x64 || b == 0x65) {}
+        else if((b & 0xf0) == 0x40) {
+            // a REX prefix only counts if it comes last
+            if(i + 1 < size && (bytes[i + 1] & 0xf0) != 0x40) {
+                switch(bytes[i + 1]) {
+                case 0x66: case 0x67: case 0xf0: case 0xf2: case 0xf3:
+                case 0x26: case 0x2e: case 0x36: case 0x3e: case 0x64:
+                case 0x65:
+                    continue;
+                }
+            }
+            rex = b;
+        }
+        else break;
+    }
+    if(i >= size) return false;
+
+    bool rexW = (rex & 0x8);
+    int map = 0;            // 0: one-byte, 1: 0f, 2: 0f 38, 3: 0f 3a
+    bool vex = false;
+    unsigned char opcode = bytes[i];
+    if(opcode == 0xc5 || opcode == 0xc4 || opcode == 0x62) {
+        size_t payload = (opcode == 0xc5 ? 1 : opcode == 0xc4 ? 2 : 3);
+        if(i + payload + 1 >= size) return false;
+        unsigned char p0 = bytes[i + 1];
+        if(opcode == 0xc5) map = 1;
+        else if(opcode == 0xc4) {
+            map = p0 & 0x1f;
+            rexW = (bytes[i + 2] & 0x80);
+        }
+        else {
+            map = p0 & 0x7;
+            rexW = (bytes[i + 2] & 0x80);
+        }
+        if(map < 1 || (map > 3 && !(opcode == 0x62 && (map == 5 || map == 6)))) {
+            return false;
+        }
+        vex = true;
+        i += payload + 1;
+        opcode = bytes[i];
+    }
+    else if(opcode == 0x0f) {
+        if(++i >= size) return false;
+        opcode = bytes[i];
+        map = 1;
+        if(opcode == 0x38 || opcode == 0x3a) {
+            map = (opcode == 0x38 ? 2 : 3);
+            if(++i >= size) return false;
+            opcode = bytes[i];
+        }
+    }
+    i ++;  // past the opcode
+
+    unsigned char entry;
+    switch(map) {
+    case 0: entry = oneByteMap[opcode]; break;
+    case 1: entry = twoByteMap[opcode]; break;
+    case 3: entry = M | B; break;
+    default: entry = M; break;  // 0f 38 and the EVEX fp16 maps
+    }
+    if(vex) entry |= M;  // except vzeroupper/vzeroall, all have a ModRM
+    if(vex && map == 1 && opcode == 0x77) entry &= ~M;
+    if(entry & X) return false;
+
+    bool ripRelative = false;
+    unsigned char modrm = 0;
+    if(entry & M) {
+        if(i >= size) return false;
+        modrm = bytes[i ++];
+        int mod = modrm >> 6, rm = modrm & 7;
+        if(mod != 3) {
+            if(rm == 4) {
+                if(i >= size) return false;
+                unsigned char sib = bytes[i ++];
+                if(mod == 0 && (sib & 7) == 5) i += 4;
+            }
+            else if(mod == 0 && rm == 5) {
+                i += 4;
+                ripRelative = true;
+            }
+            if(mod == 1) i += 1;
+            else if(mod == 2) i += 4;
+        }
+    }
+
+    size_t immSize = 0;
+    switch(entry & 0xf) {
+    case B: immSize = 1; break;
+    case W: immSize = 2; break;
+    case Z: immSize = (opsize && !rexW) ? 2 : 4; break;
+    case V: immSize = rexW ? 8 : (opsize ? 2 : 4); break;
+    case E: immSize = 3; break;
+    case O: immSize = addrsize ? 4 : 8; break;
+    case G:
+        if(((modrm >> 3) & 7) < 2) {
+            immSize = (opcode == 0xf6) ? 1 : ((opsize && !rexW) ? 2 : 4);
+        }
+        break;
+    case D: immSize = 4; break;
+    }
+    size_t immOffset = i;
+    i += immSize;
+    if(i > size) return false;
+
+    QuickInstruction::Kind kind = QuickInstruction::KIND_NORMAL;
+    bool relative = false;
+    int reg = (modrm >> 3) & 7;
+    if(vex) {}
+    else if(map == 0) {
+        if(opcode == 0xc3 || opcode == 0xc2 || opcode == 0xcb || opcode == 0xca) {
+            kind = QuickInstruction::KIND_RET;
+        }
+        else if(opcode == 0xe8) {
+            kind = QuickInstruction::KIND_CALL, relative = true;
+        }
+        else if(opcode == 0xe9 || opcode == 0xeb) {
+            kind = QuickInstruction::KIND_JUMP, relative = true;
+        }
+        else if((opcode & 0xf0) == 0x70 || (opcode >= 0xe0 && opcode <= 0xe3)) {
+            kind = QuickInstruction::KIND_COND_JUMP, relative = true;
+        }
+        else if(opcode == 0xff && (reg == 2 || reg == 3)) {
+            kind = QuickInstruction::KIND_INDIRECT_CALL;
+        }
+        else if(opcode == 0xff && (reg == 4 || reg == 5)) {
+            kind = QuickInstruction::KIND_INDIRECT_JUMP;
+        }
+        else if(opcode == 0x90 && !(rex & 0x1) && !repz) {
+            kind = QuickInstruction::KIND_NOP;  // not xchg %r8, or pause
+        }
+    }
+    else if(map == 1) {
+        if((opcode & 0xf0) == 0x80) {
+            kind = QuickInstruction::KIND_COND_JUMP, relative = true;
+        }
+        else if(opcode == 0x1f) {
+            kind = QuickInstruction::KIND_NOP;
+        }
+    }
+
+    out->address = address;
+    out->size = i;
+    out->kind = kind;
+    out->ripRelative = ripRelative;
+    out->target = relative
+        ? address + i + readSigned(bytes + immOffset, immSize) : 0;
+    return true;
+}
+#elif defined(ARCH_AARCH64)
+namespace {
+    int64_t signExtend(uint32_t value, int bits) {
+        return static_cast<int64_t>(static_cast<uint64_t>(value) << (64 - bits))
+            >> (64 - bits);
+    }
+}
+
+// every instruction is 4 bytes, so decoding only fails at the end of input
+bool QuickDecode::instruction(const unsigned char *bytes, size_t size,
+    address_t address, QuickInstruction *out) {
+
+    if(size < 4) return false;
+    uint32_t w = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16)
+        | (static_cast<uint32_t>(bytes[3]) << 24);
+
+    QuickInstruction::Kind kind = QuickInstruction::KIND_NORMAL;
+    int64_t offset = 0;
+    if((w & 0xfc000000) == 0x14000000) {            // b
+        kind = QuickInstruction::KIND_JUMP;
+        offset = signExtend(w & 0x3ffffff, 26) * 4;
+    }
+    else if((w & 0xfc000000) == 0x94000000) {       // bl
+        kind = QuickInstruction::KIND_CALL;
+        offset = signExtend(w & 0x3ffffff, 26) * 4;
+    }
+    else if((w & 0xff000010) == 0x54000000          // b.cond
+        || (w & 0x7e000000) == 0x34000000) {        // cbz, cbnz
+
+        kind = QuickInstruction::KIND_COND_JUMP;
+        offset = signExtend((w >> 5) & 0x7ffff, 19) * 4;
+    }
+    else if((w & 0x7e000000) == 0x36000000) {       // tbz, tbnz
+        kind = QuickInstruction::KIND_COND_JUMP;
+        offset = signExtend((w >> 5) & 0x3fff, 14) * 4;
+    }
+    else if((w & 0xfffffc1f) == 0xd61f0000) {
+        kind = QuickInstruction::KIND_INDIRECT_JUMP;
+    }
+    else if((w & 0xfffffc1f) == 0xd63f0000) {
+        kind = QuickInstruction::KIND_INDIRECT_CALL;
+    }
+    else if((w & 0xfffffc1f) == 0xd65f0000) {
+        kind = QuickInstruction::KIND_RET;
+    }
+    else if(w == 0xd503201f) {
+        kind = QuickInstruction::KIND_NOP;
+    }
+
+    out->address = address;
+    out->size = 4;
+    out->kind = kind;
+    out->ripRelative = ((w & 0x1f000000) == 0x10000000      // adr, adrp
+        || (w & 0x3b000000) == 0x18000000);                 // ldr literal
+    out->target = out->hasTarget() ? address + offset : 0;
+    return true;
+}
+#else
+bool QuickDecode::instruction(const unsigned char *bytes, size_t size,
+    address_t address, QuickInstruction *out) {
+
+    return false;
+}
+#endif
+
+std::vector<QuickInstruction> QuickDecode::instructions(
+    const unsigned char *bytes, size_t size, address_t address) {
+
+    std::vector<QuickInstruction> list;
+    list.reserve(size / 4);
+    QuickInstruction ins;
+    for(size_t offset = 0; offset < size; offset += ins.size) {
+        if(!instruction(bytes + offset, size - offset, address + offset, &ins)) {
+            break;
+        }
+        list.push_back(ins);
+    }
+    return list;
+}
+
+bool QuickDecode::isNop(const std::string &data) {
+    QuickInstruction ins;
+    return instruction(reinterpret_cast<const unsigned char *>(data.data()),
+        data.size(), 0, &ins)
+        && ins.size == data.size() && ins.kind == QuickInstruction::KIND_NOP;
+}
@@ -0,0 +1,54 @@
+#ifndef EGALITO_DISASM_QUICKDECODE_H
+#define EGALITO_DISASM_QUICKDECODE_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include "types.h"
+
+/** The length and control-flow class of one instruction, without operands.
+*/
+struct QuickInstruction {
+    enum Kind {
+        KIND_NORMAL,
+        KIND_NOP,
+        KIND_JUMP,          // direct, unconditional
+        KIND_COND_JUMP,     // direct, conditional
+        KIND_CALL,          // direct
+        KIND_RET,
+        KIND_INDIRECT_JUMP,
+        KIND_INDIRECT_CALL,
+    };
+
+    address_t address;
+    unsigned char size;
+    Kind kind;
+    bool ripRelative;       // has a pc-relative memory operand
+    address_t target;       // for direct jumps and calls
+
+    bool isControlFlow() const { return kind >= KIND_JUMP; }
+    bool hasTarget() const
+        { return kind == KIND_JUMP || kind == KIND_COND_JUMP
+            || kind == KIND_CALL; }
+};
+
+/** Table-driven decoder that only finds instruction lengths and classes.
+
+    This is much cheaper than capstone with details on, and is enough for
+    passes that only look for boundaries, branches, calls and padding. The
+    instructions they end up keeping are decoded with capstone afterwards.
+    Like cs_disasm(), decoding stops at the first invalid instruction.
+*/
+class QuickDecode {
+public:
+    /** Returns false if bytes do not start with a valid instruction. */
+    static bool instruction(const unsigned char *bytes, size_t size,
+        address_t address, QuickInstruction *out);
+    static std::vector<QuickInstruction> instructions(
+        const unsigned char *bytes, size_t size, address_t address);
+
+    /** For instructions that already exist, e.g. from getData(). */
+    static bool isNop(const std::string &data);
+};
+
+#endif
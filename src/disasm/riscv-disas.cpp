@@ -860,7 +860,7 @@ static const char *csr_name(int csrno)
 
 /* decode opcode */
 
-static void decode_inst_opcode(rv_decode *dec, rv_isa isa)
+static void decode_inst_opcode_ladder(rv_decode *dec, rv_isa isa)
 {
     rv_inst inst = dec->inst;
     rv_opcode op = rv_op_illegal;
@@ -1496,6 +1496,44 @@ static void decode_inst_opcode(rv_decode *dec, rv_isa isa)
     dec->op = op;
 }
 
+/* Compressed instructions have only 16 bits, so their opcodes come from a
+ * table that is filled in from the decoder above the first time an isa is
+ * used. Whole functions of compressed code then skip the switch ladder. */
+
+typedef struct rv_compressed_table {
+    uint16_t op[1 << 16];
+
+    rv_compressed_table(rv_isa isa) {
+        rv_decode dec;
+        for (uint32_t inst = 0; inst < (1 << 16); inst++) {
+            memset(&dec, 0, sizeof(dec));
+            dec.inst = inst;
+            decode_inst_opcode_ladder(&dec, isa);
+            op[inst] = dec.op;
+        }
+    }
+} rv_compressed_table;
+
+static const uint16_t *compressed_op_table(rv_isa isa)
+{
+    // each table is built on first use; initialization is thread-safe
+    switch (isa) {
+    case rv32: { static const rv_compressed_table table(rv32); return table.op; }
+    case rv64: { static const rv_compressed_table table(rv64); return table.op; }
+    case rv128: { static const rv_compressed_table table(rv128); return table.op; }
+    }
+    return NULL;
+}
+
+static void decode_inst_opcode(rv_decode *dec, rv_isa isa)
+{
+    if ((dec->inst & 0b11) != 0b11) {
+        dec->op = compressed_op_table(isa)[dec->inst & 0xffff];
+        return;
+    }
+    decode_inst_opcode_ladder(dec, isa);
+}
+
 /* operand extractors */
 
 static uint32_t operand_rd(rv_inst inst) {
@@ -2549,6 +2587,7 @@ std::vector<rv_instr> rv_disasm_buffer(rv_isa isa, uint64_t ip,
     const uint8_t *code, uint64_t code_size) {
 
     std::vector<rv_instr> result;
+    result.reserve(code_size / 4 + 1);  // a guess, between 2 and 4 bytes each
 
     uint64_t off = 0;
     while(off < code_size) {
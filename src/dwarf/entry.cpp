@@ -1,5 +1,7 @@
+#include <algorithm>
 #include <cassert>
 #include "entry.h"
+#include "parser.h"
 #include "defines.h"
 
 DwarfCIE::Augmentation::Augmentation() {
@@ -17,11 +19,12 @@ DwarfCIE::DwarfCIE(address_t startAddress, uint64_t length, uint64_t index)
     this->codeAlignFactor = 0;
     this->dataAlignFactor = 0;
     this->retAddressReg = 0;
+    this->augmentation = nullptr;
 }
 
 DwarfFDE::DwarfFDE(address_t startAddress, uint64_t length, uint64_t cieIndex)
     : DwarfEntry(startAddress, length), cieIndex(cieIndex), ciePointer(0),
-    pcBegin(0), pcRange(0) {
+    pcBegin(0), pcRange(0), augmentation(nullptr) {
 
 }
 
@@ -32,6 +35,7 @@ void DwarfUnwindInfo::addCIE(DwarfCIE *cie) {
 
 void DwarfUnwindInfo::addFDE(DwarfFDE *fde) {
     fdeList.push_back(fde);
+    sortedFdeList.clear();
 }
 
 bool DwarfUnwindInfo::findCIE(address_t address, uint64_t *index) {
@@ -47,3 +51,28 @@ DwarfCIE *DwarfUnwindInfo::getCIE(uint64_t cieIndex) {
     assert(cieIndex < cieList.size());
     return cieList[cieIndex];
 }
+
+DwarfFDE *DwarfUnwindInfo::findFDE(address_t address) {
+    if(sortedFdeList.size() != fdeList.size()) {
+        // already sorted when built from .eh_frame_hdr
+        sortedFdeList = fdeList;
+        std::stable_sort(sortedFdeList.begin(), sortedFdeList.end(),
+            [](DwarfFDE *a, DwarfFDE *b) {
+                return a->getPcBegin() < b->getPcBegin(); });
+    }
+
+    auto it = std::upper_bound(sortedFdeList.begin(), sortedFdeList.end(),
+        address, [](address_t address, DwarfFDE *fde) {
+            return address < static_cast<address_t>(fde->getPcBegin()); });
+    if(it == sortedFdeList.begin()) return nullptr;
+    auto fde = *--it;
+    if(address < fde->getPcBegin() + fde->getPcRange()) return fde;
+    return nullptr;
+}
+
+DwarfState *DwarfUnwindInfo::getState(DwarfFDE *fde) {
+    if(!fde->getState()) {
+        fde->setState(DwarfParser::parseState(getCIE(fde->getCieIndex()), fde));
+    }
+    return fde->getState();
+}
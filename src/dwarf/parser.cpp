@@ -52,13 +52,18 @@ private:
     void parseAdvanceLocN(int count);
 };
 
-DwarfParser::DwarfParser(ElfMap *elfMap) : info(nullptr) {
+DwarfParser::DwarfParser(ElfMap *elfMap, bool lazy) : info(nullptr) {
     ElfSection *section = elfMap->findSection(".eh_frame");
 
     if(section) {
         this->readAddress = section->getReadAddress();
         this->virtualAddress = section->getVirtualAddress();
-        parse(section->getSize());
+
+        auto header = elfMap->findSection(".eh_frame_hdr");
+        if(!lazy || !header || !parseFromHeader(header, section->getSize())) {
+            elfMap->adviseSection(section, ElfMap::ACCESS_SEQUENTIAL);
+            parse(section->getSize());
+        }
     }
     else {
         LOG(0, "WARNING: no .eh_frame section present in ELF file!");
@@ -73,43 +78,96 @@ void DwarfParser::parse(size_t virtualSize) {
     LOG(10, "Contents of the .eh_frame section:");
 
     while(start < end) {
-        uint64_t length = start.next<uint32_t>();
-        uint64_t entryLength = length + 4;
-        if(length == 0xfffffffful) {
-            // the length is in the next 8 bytes
-            start >> length;
-            entryLength = length + 8;
-        }
+        if(!parseEntry(start, end)) break;
+    }
+}
 
-        if(length == 0) {
-            CLOG(10, "\n%08lx ZERO terminator\n\n",
-                start.getStart() - readAddress);
-            break;
+bool DwarfParser::parseFromHeader(ElfSection *header, size_t virtualSize) {
+    DwarfCursor cursor(header->getReadAddress());
+    uint8_t version = cursor.next<uint8_t>();
+    uint8_t framePointerEnc = cursor.next<uint8_t>();
+    uint8_t countEnc = cursor.next<uint8_t>();
+    uint8_t tableEnc = cursor.next<uint8_t>();
+
+    // the linker always emits datarel sdata4; anything else is unusual
+    // enough that we just walk .eh_frame instead
+    if(version != 1 || countEnc == DW_EH_PE_omit
+        || tableEnc != (DW_EH_PE_datarel | DW_EH_PE_sdata4)) {
+
+        return false;
+    }
+
+    cursor.nextEncodedPointer<int64_t>(framePointerEnc);
+    uint64_t count = cursor.nextEncodedPointer<uint64_t>(countEnc);
+
+    LOG(10, "Using " << count << " entries of .eh_frame_hdr");
+
+    info = new DwarfUnwindInfo();
+    DwarfCursor end(readAddress + virtualSize);
+    for(uint64_t i = 0; i < count; i ++) {
+        cursor.next<int32_t>();  // initial location, also found in the FDE
+        address_t fde = header->getVirtualAddress() + cursor.next<int32_t>();
+        if(fde < virtualAddress || fde >= virtualAddress + virtualSize) {
+            LOG(1, "WARNING: .eh_frame_hdr entry outside .eh_frame");
+            continue;
         }
 
-        DwarfCursor startOfEntry{start.getCursor()};
-        DwarfCursor endOfEntry{start.getStart() + entryLength};
-        uint32_t entryID = start.next<uint32_t>();
+        DwarfCursor start(fde - virtualAddress + readAddress);
+        parseEntry(start, end);
+    }
+    return true;
+}
 
-        if(entryID == 0) {  // it's a CIE
-            const uint64_t cieIndex = info->getCIECount();
+bool DwarfParser::parseEntry(DwarfCursor &start, DwarfCursor end) {
+    uint64_t length = start.next<uint32_t>();
+    uint64_t entryLength = length + 4;
+    if(length == 0xfffffffful) {
+        // the length is in the next 8 bytes
+        start >> length;
+        entryLength = length + 8;
+    }
+
+    if(length == 0) {
+        CLOG(10, "\n%08lx ZERO terminator\n\n",
+            start.getStart() - readAddress);
+        return false;
+    }
+
+    DwarfCursor startOfEntry{start.getCursor()};
+    DwarfCursor endOfEntry{start.getStart() + entryLength};
+    uint32_t entryID = start.next<uint32_t>();
+
+    if(entryID == 0) {  // it's a CIE
+        uint64_t cieIndex;
+        if(!info->findCIE(start.getStart(), &cieIndex)) {
+            cieIndex = info->getCIECount();
             DwarfCIE *cie = parseCIE(start, endOfEntry, length, cieIndex);
             info->addCIE(cie);
         }
-        else {  // it's an FDE within the given CIE
-            uint64_t cieIndex;
-            if(info->findCIE(startOfEntry.getCursor() - entryID, &cieIndex)) {
-                DwarfFDE *fde = parseFDE(start, endOfEntry, length, cieIndex,
-                    entryID);
-                info->addFDE(fde);
-            }
-            else {
-                LOG(1, "WARNING: unknown CIE index in FDE definition");
+    }
+    else {  // it's an FDE within the given CIE
+        address_t cieAddress = startOfEntry.getCursor() - entryID;
+        uint64_t cieIndex;
+        if(!info->findCIE(cieAddress, &cieIndex)) {
+            // only possible when following .eh_frame_hdr: the CIE has not
+            // been seen yet, so parse it now
+            DwarfCursor cieStart(cieAddress);
+            if(cieAddress >= readAddress && cieAddress < end.getStart()) {
+                parseEntry(cieStart, end);
             }
         }
-
-        start = endOfEntry;
+        if(info->findCIE(cieAddress, &cieIndex)) {
+            DwarfFDE *fde = parseFDE(start, endOfEntry, length, cieIndex,
+                entryID);
+            info->addFDE(fde);
+        }
+        else {
+            LOG(1, "WARNING: unknown CIE index in FDE definition");
+        }
     }
+
+    start = endOfEntry;
+    return true;
 }
 
 DwarfCIE *DwarfParser::parseCIE(DwarfCursor start, DwarfCursor end,
@@ -141,8 +199,10 @@ DwarfCIE *DwarfParser::parseCIE(DwarfCursor start, DwarfCursor end,
             switch(static_cast<char>(*ptr)) {
             case 'P':
                 augmentation->setPersonalityEncoding(start.next<uint8_t>());
-                augmentation->setPersonalityEncodingRoutine(
-                    start.nextEncodedPointer<uint64_t>(augmentation->getPersonalityEncoding()));
+                augmentation->setPersonalityEncodingRoutine(toVirtual(
+                    start.nextEncodedPointer<uint64_t>(
+                        augmentation->getPersonalityEncoding()),
+                    augmentation->getPersonalityEncoding()));
                 break;
             case 'R':
                 augmentation->setCodeEnc(start.next<uint8_t>());
@@ -171,6 +231,7 @@ DwarfCIE *DwarfParser::parseCIE(DwarfCursor start, DwarfCursor end,
     CLOG(10, "  Return address column: %lu", cie->getRetAddressReg());
     CLOG(10, "");
 
+    cie->setInstructions(start.getCursor(), end.getStart());
     DwarfInstructionDecoder decoder(start, end, cie, 0);
     auto state = decoder.parseInstructions();
     cie->setState(state);
@@ -195,8 +256,9 @@ DwarfFDE *DwarfParser::parseFDE(DwarfCursor start, DwarfCursor end,
         start.nextUleb128();  // skip the augmentation length
 
         // will be set to 0 if the LSDA encoding is DW_EH_PE_omit
-        const auto lsdaPointer = start.nextEncodedPointer<uint64_t>(
-            cie->getAugmentation()->getLsdaEnc());
+        const auto lsdaEnc = cie->getAugmentation()->getLsdaEnc();
+        const auto lsdaPointer = toVirtual(
+            start.nextEncodedPointer<uint64_t>(lsdaEnc), lsdaEnc);
 
         fde->setAugmentation(new DwarfFDE::Augmentation(lsdaPointer));
     }
@@ -207,19 +269,36 @@ DwarfFDE *DwarfParser::parseFDE(DwarfCursor start, DwarfCursor end,
         cie->getStartAddress() - readAddress,
         fde->getPcBegin(), 
         fde->getPcBegin() + fde->getPcRange());
-    DwarfInstructionDecoder decoder(start, end, cie, fde->getPcBegin());
-    // XXX: temporarily disable DWARF instructions parsing, as we only use the
-    // extracted function bounds.
-    /*auto state = decoder.parseInstructions();
-    fde->setState(state);*/
+    // DWARF instructions are only parsed on demand, since most users only
+    // need the extracted function bounds
+    fde->setInstructions(start.getCursor(), end.getStart());
     return fde;
 }
 
+address_t DwarfParser::toVirtual(address_t pointer, uint8_t encoding) const {
+    // pc-relative pointers were computed from where .eh_frame is mapped
+    if(pointer && encoding != DW_EH_PE_omit
+        && (encoding & 0x70) == DW_EH_PE_pcrel) {
+
+        return pointer + virtualAddress - readAddress;
+    }
+    return pointer;
+}
+
+DwarfState *DwarfParser::parseState(DwarfCIE *cie, DwarfFDE *fde) {
+    DwarfInstructionDecoder decoder(fde->getInstructionStart(),
+        fde->getInstructionEnd(), cie, fde->getPcBegin());
+    return decoder.parseInstructions();
+}
+
 // ----
 // DwarfExpressionDecoder and DwarfInstructionDecoder follow
 
+// Expressions are only decoded for printing; register values are not known
+// at parse time, so dereferencing the computed value would be meaningless
+// (and usually faults).
 static uint64_t dereferencePointer(uint64_t pointer) {
-    return *(reinterpret_cast<uint64_t *>(pointer));
+    return 0;
 }
 
 template <typename Type>
@@ -717,7 +796,7 @@ DwarfState *DwarfInstructionDecoder::parseInstructions() {
         case DW_CFA_def_cfa_expression:
             //TODO: Complete this decoding
             CLOG0(10, "  DW_CFA_def_cfa_expression (");
-            DwarfExpressionDecoder(start, state).decode();
+            IF_LOG(10) DwarfExpressionDecoder(start, state).decode();
             CLOG(10, ")");
             state->setCfaExpression(start.getCursor());
             ul = start.nextUleb128();
@@ -730,7 +809,7 @@ DwarfState *DwarfInstructionDecoder::parseInstructions() {
             //TODO: Complete this decoding
             CLOG0(10, "  DW_CFA_expression: %s (",
                 getRegisterName(reg).c_str());
-            DwarfExpressionDecoder(start, state).decode();
+            IF_LOG(10) DwarfExpressionDecoder(start, state).decode();
             CLOG(10, ")");
             ul = start.nextUleb128();
             start.skip(ul);
@@ -741,7 +820,7 @@ DwarfState *DwarfInstructionDecoder::parseInstructions() {
             //TODO: Complete this decoding
             CLOG0(10, "  DW_CFA_val_expression: %s (",
                 getRegisterName(reg).c_str());
-            DwarfExpressionDecoder(start, state).decode();
+            IF_LOG(10) DwarfExpressionDecoder(start, state).decode();
             CLOG(10, ")");
             ul = start.nextUleb128();
             state->set(reg, DW_CFA_val_expression, state->get(reg).getOffset());
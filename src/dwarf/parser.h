@@ -7,6 +7,7 @@
 #include "defines.h"
 
 class ElfMap;
+class ElfSection;
 
 class DwarfCIE;
 class DwarfFDE;
@@ -15,6 +16,12 @@ class DwarfState;
 
 /** Parses DWARF information from a .eh_frame section.
 
+    In lazy mode, the FDEs are found through the binary search table in
+    .eh_frame_hdr (if there is a usable one) instead of walking .eh_frame,
+    and only the CIEs they refer to are parsed. In either mode, the CFA
+    program of an FDE is only decoded when its state is requested through
+    DwarfUnwindInfo::getState().
+
     Note: if debugging info is enabled, this class prints out DWARF
     information in the same format as `objdump -g`.
 */
@@ -24,15 +31,20 @@ private:
     address_t readAddress;
     address_t virtualAddress;
 public:
-    DwarfParser(ElfMap *elfMap);
+    DwarfParser(ElfMap *elfMap, bool lazy = false);
 
     DwarfUnwindInfo *getUnwindInfo() const { return info; }
+
+    static DwarfState *parseState(DwarfCIE *cie, DwarfFDE *fde);
 private:
     void parse(size_t virtualSize);
+    bool parseFromHeader(ElfSection *header, size_t virtualSize);
+    bool parseEntry(DwarfCursor &start, DwarfCursor end);
     DwarfCIE *parseCIE(DwarfCursor start, DwarfCursor end, uint64_t length,
         uint64_t index);
     DwarfFDE *parseFDE(DwarfCursor start, DwarfCursor end, uint64_t length,
         size_t cieIndex, uint32_t entryID);
+    address_t toVirtual(address_t pointer, uint8_t encoding) const;
 };
 
 #endif
@@ -16,55 +16,52 @@ static address_t *findAuxiliaryVector(char **argv) {
     return address;
 }
 
-void adjustAuxiliaryVector(char **argv, ElfMap *elf, ElfMap *interpreter) {
+void AuxiliaryVectorPatch::set(ElfMap *elf, ElfMap *interpreter) {
+    typeMask = 0;
     if(!elf) return;
     ElfMap *beginning = (interpreter ? interpreter : elf);
     ElfXX_Ehdr *header = (ElfXX_Ehdr *)elf->getCharmap();
 
-    address_t *auxv = findAuxiliaryVector(argv);
+    auto add = [this] (address_t type, address_t value) {
+        valueList[type] = value;
+        typeMask |= 1ul << type;
+    };
+    add(AT_BASE, reinterpret_cast<address_t>(beginning->getCharmap()));
+    add(AT_ENTRY, beginning->getBaseAddress() + beginning->getEntryPoint());
+    add(AT_PHDR, reinterpret_cast<address_t>(elf->getCharmap())
+        + header->e_phoff);
+    add(AT_PHENT, header->e_phentsize);
+    add(AT_PHNUM, header->e_phnum);
 
-    CLOG(0, "fixing auxiliary vector");
+    CLOG(1, "    auxv base address: 0x%lx", valueList[AT_BASE]);
+    CLOG(1, "    auxv entry point: 0x%lx", valueList[AT_ENTRY]);
+}
+
+address_t *AuxiliaryVectorPatch::apply(char **envp) const {
+    address_t *p = reinterpret_cast<address_t *>(envp);
+    while(*p++) {}  // skip envp entries
 
     // Loop through all auxiliary vector entries, stopping at the terminating
     // entry of type AT_NULL.
-    for(address_t *p = auxv; p[0] != AT_NULL; p += 2) {
+    for( ; p[0] != AT_NULL; p += 2) {
         address_t type = p[0];
-        address_t *new_value = &p[1];
-        switch(type) {
-        case AT_BASE:
-            *new_value = reinterpret_cast<address_t>(beginning->getCharmap());
-            CLOG(1, "    auxv base address: 0x%lx", *new_value);
-            break;
-        case AT_ENTRY:
-            *new_value = beginning->getBaseAddress()
-                + beginning->getEntryPoint();
-            CLOG(1, "    auxv entry point: 0x%lx", *new_value);
-            break;
-        case AT_PHDR:
-            *new_value = reinterpret_cast<address_t>(elf->getCharmap())
-                + header->e_phoff;
-            break;
-        case AT_PHENT:
-            *new_value = header->e_phentsize;
-            break;
-        case AT_PHNUM:
-            *new_value = header->e_phnum;
-            break;
-#if 0
-        case AT_EXECFN:
-            static const char *fakeFilename
-                = "./hello";
-            std::printf("AUXV: old exec filename is [%s]\n",
-                reinterpret_cast<char *>(*new_value));
-            *new_value = reinterpret_cast<address_t>(fakeFilename);
-            std::printf("AUXV: new exec filename is [%s]\n",
-                reinterpret_cast<char *>(*new_value));
-            break;
-#endif
-        default:
-            break;
+        if(type < TYPE_LIMIT && (typeMask & (1ul << type))) {
+            p[1] = valueList[type];
         }
     }
+    return p;
+}
+
+void adjustAuxiliaryVector(char **argv, ElfMap *elf, ElfMap *interpreter) {
+    if(!elf) return;
+
+    CLOG(0, "fixing auxiliary vector");
+    AuxiliaryVectorPatch patch;
+    patch.set(elf, interpreter);
+
+    char **envp = argv;
+    while(*envp++) {}  // skip argv entries
+    patch.apply(envp);
 }
 
 int removeLoaderFromArgv(void *argv) {
@@ -4,6 +4,29 @@
 #include "types.h"
 #include "elf/elfmap.h"
 
+/** The auxiliary vector entries the loader rewrites, so that the target
+    program sees its own headers and entry point instead of the loader's.
+    The values are computed from the ELF headers when the program is
+    parsed; apply() then makes one pass over auxv, storing each value by
+    indexing on the entry type.
+*/
+class AuxiliaryVectorPatch {
+private:
+    enum {
+        TYPE_LIMIT = 16     // AT_ENTRY is the largest type patched
+    };
+    address_t valueList[TYPE_LIMIT];
+    unsigned long typeMask;
+public:
+    AuxiliaryVectorPatch() : typeMask(0) {}
+
+    void set(ElfMap *elf, ElfMap *interpreter);
+    bool isEmpty() const { return typeMask == 0; }
+
+    /** Patches the auxv following envp and returns its AT_NULL entry. */
+    address_t *apply(char **envp) const;
+};
+
 void adjustAuxiliaryVector(char **argv, ElfMap *elf, ElfMap *interpreter);
 int removeLoaderFromArgv(void *argv);
 
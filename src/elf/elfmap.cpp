@@ -1,6 +1,7 @@
 #include <iostream>
 #include <sstream>
 #include <cstring>
+#include <algorithm>
 #include <elf.h>
 #include <sys/mman.h>
 #include <unistd.h>
@@ -9,6 +10,68 @@
 #include "elfmap.h"
 #include "log/log.h"
 
+/** Names looked up over and over by passes and generators. They are
+    matched through a collision-free hash table built on first use.
+*/
+static const char *knownSectionNames[] = {
+    ".text", ".data", ".bss", ".rodata", ".tdata", ".tbss",
+    ".symtab", ".strtab", ".dynsym", ".dynstr", ".dynamic", ".interp",
+    ".plt", ".plt.got", ".plt.sec", ".got", ".got.plt",
+    ".rela.dyn", ".rela.plt", ".gnu.hash", ".gnu.version",
+    ".gnu.version_d", ".gnu.version_r", ".eh_frame", ".eh_frame_hdr",
+    ".init", ".fini", ".init_array", ".fini_array",
+    ".note.gnu.build-id", ".gnu_debuglink", ".profiling",
+};
+static const size_t KNOWN_SECTION_COUNT
+    = sizeof(knownSectionNames) / sizeof(*knownSectionNames);
+
+class KnownSectionHash {
+private:
+    static const size_t TABLE_SIZE = 128;
+    uint32_t seed;
+    int8_t table[TABLE_SIZE];
+public:
+    KnownSectionHash();
+    /** Returns the index into knownSectionNames, or -1. */
+    int find(const char *name) const;
+private:
+    size_t slot(const char *name) const;
+};
+
+KnownSectionHash::KnownSectionHash() {
+    for(seed = 1; ; seed ++) {
+        std::fill(table, table + TABLE_SIZE, -1);
+        size_t i = 0;
+        for( ; i < KNOWN_SECTION_COUNT; i ++) {
+            auto s = slot(knownSectionNames[i]);
+            if(table[s] != -1) break;
+            table[s] = static_cast<int8_t>(i);
+        }
+        if(i == KNOWN_SECTION_COUNT) break;
+    }
+}
+
+int KnownSectionHash::find(const char *name) const {
+    int index = table[slot(name)];
+    if(index >= 0 && std::strcmp(name, knownSectionNames[index]) == 0) {
+        return index;
+    }
+    return -1;
+}
+
+size_t KnownSectionHash::slot(const char *name) const {
+    uint32_t h = seed;
+    for(const char *p = name; *p; p ++) {
+        h = (h ^ static_cast<unsigned char>(*p)) * 16777619u;
+    }
+    return (h ^ (h >> 15)) & (TABLE_SIZE - 1);
+}
+
+static const KnownSectionHash &getKnownSectionHash() {
+    static const KnownSectionHash hash;
+    return hash;
+}
+
 ElfMap::ElfMap() : map(nullptr), length(0), fd(-1) {
 }
 
@@ -50,6 +113,7 @@ void ElfMap::setup() {
     makeSectionMap();
     makeSegmentList();
     makeVirtualAddresses();
+    makeSortedAllocList();
 }
 
 void ElfMap::parseElf(const char *filename) {
@@ -98,6 +162,10 @@ void ElfMap::makeSectionMap() {
 
     this->shstrtab = charmap + sheader[header->e_shstrndx].sh_offset;
 
+    const auto &knownHash = getKnownSectionHash();
+    knownSectionList.assign(KNOWN_SECTION_COUNT, nullptr);
+    sectionMap.reserve(header->e_shnum);
+    sectionList.reserve(header->e_shnum);
     for(int i = 0; i < header->e_shnum; i ++) {
         ElfXX_Shdr *s = &sheader[i];
         const char *name = shstrtab + s->sh_name;
@@ -106,6 +174,9 @@ void ElfMap::makeSectionMap() {
 
         sectionMap[name] = section;
         sectionList.push_back(section);
+        typeMap[s->sh_type].push_back(static_cast<void *>(s));
+        int known = knownHash.find(name);
+        if(known >= 0) knownSectionList[known] = section;
         LOG(11, "found section [" << name << "] in elf file");
     }
 }
@@ -127,7 +198,7 @@ void ElfMap::makeVirtualAddresses() {
     interpreter = nullptr;
     char *charmap = static_cast<char *>(map);
 
-    for(std::map<std::string, ElfSection *>::iterator it = sectionMap.begin(); it != sectionMap.end(); ++it) {
+    for(auto it = sectionMap.begin(); it != sectionMap.end(); ++it) {
         auto section = it->second;
         auto header = section->getHeader();
         section->setReadAddress((address_t)charmap + header->sh_offset);
@@ -165,7 +236,26 @@ void ElfMap::makeVirtualAddresses() {
     }
 }
 
+void ElfMap::makeSortedAllocList() {
+    for(auto section : sectionList) {
+        auto shdr = section->getHeader();
+        if(!(shdr->sh_flags & SHF_ALLOC) || shdr->sh_size == 0) continue;
+
+        // .tbss occupies no address space of its own and overlaps
+        // whatever follows it
+        if((shdr->sh_flags & SHF_TLS) && shdr->sh_type == SHT_NOBITS) continue;
+
+        sortedAllocList.push_back(section);
+    }
+    std::stable_sort(sortedAllocList.begin(), sortedAllocList.end(),
+        [] (ElfSection *a, ElfSection *b) {
+            return a->getVirtualAddress() < b->getVirtualAddress(); });
+}
+
 ElfSection *ElfMap::findSection(const char *name) const {
+    int known = getKnownSectionHash().find(name);
+    if(known >= 0) return knownSectionList[known];
+
     auto it = sectionMap.find(name);
     if(it == sectionMap.end()) return nullptr;
 
@@ -181,22 +271,85 @@ ElfSection *ElfMap::findSection(int index) const {
     return nullptr;
 }
 
-std::vector<void *> ElfMap::findSectionsByType(int type) const {
-    std::vector<void *> sections;
-    ElfXX_Shdr sCast;
+ElfSection *ElfMap::findSectionContaining(address_t va) const {
+    auto it = std::upper_bound(sortedAllocList.begin(), sortedAllocList.end(),
+        va, [] (address_t a, ElfSection *section) {
+            return a < section->getVirtualAddress(); });
 
-    char *charmap = static_cast<char *>(map);
-    ElfXX_Ehdr *header = (ElfXX_Ehdr *)map;
-    ElfXX_Shdr *sheader = (ElfXX_Shdr *)(charmap + header->e_shoff);
-    for(int i = 0; i < header->e_shnum; i ++) {
-        ElfXX_Shdr *s = &sheader[i];
+    if(it == sortedAllocList.begin()) return nullptr;
+    auto section = *(--it);
+    if(va < section->getVirtualAddress() + section->getSize()) return section;
+    return nullptr;
+}
 
-        if(s->sh_type == static_cast<decltype(sCast.sh_type)>(type)) {
-            sections.push_back(static_cast<void *>(s));
-        }
+static int adviceFor(ElfMap::AccessPattern pattern) {
+    switch(pattern) {
+    case ElfMap::ACCESS_SEQUENTIAL: return MADV_SEQUENTIAL;
+    case ElfMap::ACCESS_WILLNEED:   return MADV_WILLNEED;
+    case ElfMap::ACCESS_DONTNEED:   return MADV_DONTNEED;
+    default:                        return MADV_NORMAL;
     }
+}
+
+void ElfMap::adviseSection(ElfSection *section, AccessPattern pattern) {
+    if(!section || !length) return;
+    if(section->getHeader()->sh_type == SHT_NOBITS) return;
+
+    address_t mapStart = reinterpret_cast<address_t>(map);
+    address_t start = section->getReadAddress();
+    address_t end = std::min(start + section->getSize(), mapStart + length);
+    if(start < mapStart || start >= end) return;
+
+    const address_t pageMask = sysconf(_SC_PAGESIZE) - 1;
+    if(pattern == ACCESS_DONTNEED) {
+        // only drop pages that lie entirely inside the section
+        start = (start + pageMask) & ~pageMask;
+        end &= ~pageMask;
+    }
+    else {
+        start &= ~pageMask;
+    }
+    if(start >= end) return;
+
+    if(madvise(reinterpret_cast<void *>(start), end - start,
+        adviceFor(pattern)) != 0) {
+
+        LOG(10, "madvise failed for section [" << section->getName() << "]");
+    }
+}
 
-    return std::move(sections);
+void ElfMap::prefetch(address_t readAddress, size_t size) {
+    if(!length) return;
+
+    address_t mapStart = reinterpret_cast<address_t>(map);
+    address_t end = std::min(readAddress + size, mapStart + length);
+    if(readAddress < mapStart || readAddress >= end) return;
+
+    const address_t pageMask = sysconf(_SC_PAGESIZE) - 1;
+    address_t start = readAddress & ~pageMask;
+    madvise(reinterpret_cast<void *>(start), end - start, MADV_WILLNEED);
+}
+
+void ElfMap::readAhead() {
+    if(fd < 0 || !length) return;
+
+    // unlike MADV_WILLNEED on the map, this only queues the reads
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+}
+
+void ElfMap::readAhead(const std::string &filename) {
+    int file = open(filename.c_str(), O_RDONLY);
+    if(file < 0) return;
+
+    // the page cache keeps what was read after the file is closed
+    posix_fadvise(file, 0, 0, POSIX_FADV_WILLNEED);
+    close(file);
+}
+
+std::vector<void *> ElfMap::findSectionsByType(int type) const {
+    auto it = typeMap.find(static_cast<unsigned>(type));
+    if(it == typeMap.end()) return {};
+    return it->second;
 }
 
 std::vector<void *> ElfMap::findSectionsByFlag(long flag) const {
@@ -250,6 +403,6 @@ bool ElfMap::isDynamic() const {
 }
 
 bool ElfMap::hasRelocations() const {
-    return !findSectionsByType(SHT_RELA).empty();
+    return typeMap.count(SHT_RELA) > 0;
     //return findSection(".rela.text") != nullptr;
 }
@@ -2,6 +2,7 @@
 #define EGALITO_ELF_ELFMAP_H
 
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <string>
 #include "types.h"
@@ -35,6 +36,14 @@ public:
 
 class ElfMap {
     friend class ELFGen;
+public:
+    /** Access-pattern hints for parts of the mapped file; see madvise(2). */
+    enum AccessPattern {
+        ACCESS_NORMAL,
+        ACCESS_SEQUENTIAL,  // about to be scanned linearly
+        ACCESS_WILLNEED,    // about to be read, start paging it in now
+        ACCESS_DONTNEED     // done with it; pages are re-read if touched
+    };
 private:
     /** Memory map of executable image.
     */
@@ -51,8 +60,12 @@ private:
     const char *shstrtab;
     const char *strtab;
     const char *dynstr;
-    std::map<std::string, ElfSection *> sectionMap;
+    std::unordered_map<std::string, ElfSection *> sectionMap;
     std::vector<ElfSection *> sectionList;
+    /** Sections with well-known names, found without hashing a string. */
+    std::vector<ElfSection *> knownSectionList;
+    std::map<unsigned, std::vector<void *>> typeMap;
+    std::vector<ElfSection *> sortedAllocList;  // by virtual address
     std::vector<void *> segmentList;
     const char *interpreter;
 private:
@@ -74,6 +87,7 @@ private:
     void makeSectionMap();
     void makeSegmentList();
     void makeVirtualAddresses();
+    void makeSortedAllocList();
 public:
     void setBaseAddress(address_t base) { baseAddress = base; }
     address_t getBaseAddress() const { return baseAddress; }
@@ -86,6 +100,8 @@ public:
 
     ElfSection *findSection(const char *name) const;
     ElfSection *findSection(int index) const;
+    /** Finds the SHF_ALLOC section whose virtual range contains va. */
+    ElfSection *findSectionContaining(address_t va) const;
     template <typename T>
     T getSectionReadPtr(ElfSection *section);
     template <typename T>
@@ -93,6 +109,21 @@ public:
     template <typename T>
     T getSectionReadPtr(const char *name);
 
+    /** Hints how section's contents will be read next. Only a hint: data
+        stays valid whatever is passed, and mappings not backed by a file
+        (e.g. ElfMap(void *self)) ignore it.
+    */
+    void adviseSection(ElfSection *section, AccessPattern pattern);
+    void adviseSection(int index, AccessPattern pattern)
+        { adviseSection(findSection(index), pattern); }
+    /** Starts paging in [readAddress, readAddress+size) ahead of use. */
+    void prefetch(address_t readAddress, size_t size);
+    /** Starts reading the whole file into the page cache, without waiting
+        for it. */
+    void readAhead();
+    /** As above, for a file that is not mapped (yet). */
+    static void readAhead(const std::string &filename);
+
     std::vector<void *> findSectionsByType(int type) const;
     std::vector<void *> findSectionsByFlag(long flag) const;
 
@@ -23,7 +23,7 @@
 
 ElfSpace::ElfSpace(ElfMap *elf, const std::string &name,
     const std::string &fullPath) : elf(elf), dwarf(nullptr),
-    name(name), fullPath(fullPath), module(nullptr),
+    name(name), fullPath(fullPath), symbolFileKnown(false), module(nullptr),
     symbolList(nullptr), dynamicSymbolList(nullptr),
     relocList(nullptr), aliasMap(nullptr) {
 
@@ -41,15 +41,14 @@ ElfSpace::~ElfSpace() {
 
 void ElfSpace::findSymbolsAndRelocs() {
     if(fullPath.size() > 0) {
-        auto symbolFile = getAlternativeSymbolFile();
-        this->symbolList = SymbolList::buildSymbolList(elf, symbolFile);
+        this->symbolList = SymbolList::buildSymbolList(elf, getSymbolFile());
     }
     else {
         this->symbolList = SymbolList::buildSymbolList(elf);
     }
 
     if(!symbolList) {
-        DwarfParser dwarfParser(elf);
+        DwarfParser dwarfParser(elf, true);
         this->dwarf = dwarfParser.getUnwindInfo();
     }
 
@@ -61,6 +60,34 @@ void ElfSpace::findSymbolsAndRelocs() {
         = RelocList::buildRelocList(elf, symbolList, dynamicSymbolList);
 }
 
+void ElfSpace::compact() {
+    delete dwarf;
+    dwarf = nullptr;
+
+    if(symbolList) symbolList->compact();
+    if(dynamicSymbolList) dynamicSymbolList->compact();
+
+    // the map is read-only, so dropped pages are simply re-read if a
+    // symbol name or debug section is touched again
+    size_t released = 0;
+    for(auto section : elf->getSectionList()) {
+        if(section->getHeader()->sh_flags & SHF_ALLOC) continue;
+
+        elf->adviseSection(section, ElfMap::ACCESS_DONTNEED);
+        released += section->getSize();
+    }
+    LOG(10, "compacted [" << name << "], released " << std::dec << released
+        << " bytes of non-alloc sections");
+}
+
+const std::string &ElfSpace::getSymbolFile() {
+    if(!symbolFileKnown && fullPath.size() > 0) {
+        symbolFile = getAlternativeSymbolFile();
+    }
+    symbolFileKnown = true;
+    return symbolFile;
+}
+
 std::string ElfSpace::getAlternativeSymbolFile() const {
     auto buildIdSection = elf->findSection(".note.gnu.build-id");
     if(buildIdSection) {
@@ -18,6 +18,8 @@ private:
     DwarfUnwindInfo *dwarf;
     std::string name;
     std::string fullPath;
+    std::string symbolFile;
+    bool symbolFileKnown;
     Module *module;
 private:
     SymbolList *symbolList;
@@ -31,6 +33,16 @@ public:
 
     void findSymbolsAndRelocs();
 
+    /** The separate debug file that holds this ELF's full symbol table,
+        or an empty string if there is none. Found on first use. */
+    const std::string &getSymbolFile();
+
+    /** Releases parse-time data once analysis is done: the DWARF unwind
+        info (re-parsed on demand by MakeEhFrame), symbol list indexes, and
+        the resident pages of non-SHF_ALLOC sections.
+    */
+    void compact();
+
     ElfMap *getElfMap() const { return elf; }
     Module *getModule() const { return module; }
     void setModule(Module *module) { this->module = module; }
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
 #include "reloc.h"
@@ -19,6 +20,7 @@ void RelocSection::add(Reloc *reloc) {
 
 bool RelocList::add(Reloc *reloc) {
     relocList.push_back(reloc);
+    sortedList.clear();
     address_t address = reloc->getAddress();
 
     // return true on success (no existing duplicate element)
@@ -30,6 +32,16 @@ Reloc *RelocList::find(address_t address) {
     return (it != relocMap.end() ? (*it).second : nullptr);
 }
 
+const RelocList::ListType &RelocList::getSortedList() {
+    if(sortedList.size() != relocList.size()) {
+        sortedList = relocList;
+        std::stable_sort(sortedList.begin(), sortedList.end(),
+            [](Reloc *a, Reloc *b) {
+                return a->getAddress() < b->getAddress(); });
+    }
+    return sortedList;
+}
+
 RelocSection *RelocList::getSection(const std::string &name) {
     auto it = sectionList.find(name);
     return (it != sectionList.end() ? (*it).second : nullptr);
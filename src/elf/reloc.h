@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <string>
 #include <elf.h>
 
@@ -66,10 +67,11 @@ class RelocList {
 private:
     typedef std::vector<Reloc *> ListType;
     ListType relocList;
-    typedef std::map<address_t, Reloc *> MapType;
+    typedef std::unordered_map<address_t, Reloc *> MapType;
     MapType relocMap;
     typedef std::map<std::string, RelocSection *> SectionListType;
     SectionListType sectionList;
+    ListType sortedList;
 public:
     bool add(Reloc *reloc);
 
@@ -78,6 +80,11 @@ public:
 
     Reloc *find(address_t address);
 
+    /** All relocations ordered by address; equal addresses keep their
+        order in the file. Built once, on first use.
+    */
+    const ListType &getSortedList();
+
     RelocSection *getSection(const std::string &name);
 
     static RelocList *buildRelocList(ElfMap *elfmap, SymbolList *symbolList,
@@ -14,7 +14,8 @@
 #include "log/log.h"
 #include "log/temp.h"
 
-class SymbolAliasFinder : private UnionFind {
+class SymbolAliasFinder : private OrderedUnionFind<SymbolAliasFinder> {
+    friend class OrderedUnionFind<SymbolAliasFinder>;
 private:
     std::vector<Symbol *> sortedList;
 
@@ -27,7 +28,7 @@ public:
 
 private:
     int edgeComparator(size_t x1, size_t x2);
-    virtual void setEdge(size_t x1, size_t x2);
+    void setEdge(size_t x1, size_t x2);
 };
 
 bool Symbol::isFunction() const {
@@ -55,21 +56,123 @@ bool Symbol::isMarker() const {
         && shndx > 0;
 }
 
+uint32_t SymbolNameIndex::hash(const char *name) {
+    // same function as bfd_elf_gnu_hash / dl_new_hash
+    uint32_t h = 5381;
+    for(auto p = reinterpret_cast<const unsigned char *>(name); *p; p++) {
+        h = (h << 5) + h + *p;
+    }
+    return h;
+}
+
+void SymbolNameIndex::reserve(size_t n) {
+    size_t size = 16;
+    while(size < 2 * n) size <<= 1;
+    if(size > table.size()) rehash(size);
+}
+
+void SymbolNameIndex::rehash(size_t newSize) {
+    std::vector<Slot> old(newSize, Slot{0, nullptr});
+    old.swap(table);
+    size_t mask = table.size() - 1;
+    for(const auto &slot : old) {
+        if(!slot.symbol) continue;
+        size_t i = slot.hash & mask;
+        while(table[i].symbol) i = (i + 1) & mask;
+        table[i] = slot;
+    }
+}
+
+Symbol *SymbolNameIndex::insert(Symbol *symbol) {
+    if(2 * (count + 1) > table.size()) {
+        rehash(table.empty() ? 16 : table.size() * 2);
+    }
+
+    const char *name = symbol->getName();
+    uint32_t h = hash(name);
+    size_t mask = table.size() - 1;
+    size_t i = h & mask;
+    while(table[i].symbol) {
+        if(table[i].hash == h && !strcmp(table[i].symbol->getName(), name)) {
+            return table[i].symbol;
+        }
+        i = (i + 1) & mask;
+    }
+    table[i] = Slot{h, symbol};
+    count++;
+    return nullptr;
+}
+
+Symbol *SymbolNameIndex::find(const char *name) const {
+    if(table.empty()) return nullptr;
+
+    uint32_t h = hash(name);
+    size_t mask = table.size() - 1;
+    size_t i = h & mask;
+    while(table[i].symbol) {
+        if(table[i].hash == h && !strcmp(table[i].symbol->getName(), name)) {
+            return table[i].symbol;
+        }
+        i = (i + 1) & mask;
+    }
+    return nullptr;
+}
+
+GnuHashTable::GnuHashTable(const uint32_t *data) {
+    nbuckets = data[0];
+    symoffset = data[1];
+    bloomSize = data[2];
+    bloomShift = data[3];
+    bloom = reinterpret_cast<const ElfXX_Addr *>(data + 4);
+    buckets = reinterpret_cast<const uint32_t *>(bloom + bloomSize);
+    chain = buckets + nbuckets;
+}
+
+size_t GnuHashTable::lookup(const char *name, const ElfXX_Sym *symtab,
+    const char *strtab) const {
+
+    if(!nbuckets || !bloomSize) return 0;
+
+    const uint32_t bits = sizeof(ElfXX_Addr) * 8;
+    uint32_t h = SymbolNameIndex::hash(name);
+    ElfXX_Addr word = bloom[(h / bits) % bloomSize];
+    ElfXX_Addr mask = (ElfXX_Addr(1) << (h % bits))
+        | (ElfXX_Addr(1) << ((h >> bloomShift) % bits));
+    if((word & mask) != mask) return 0;
+
+    uint32_t index = buckets[h % nbuckets];
+    if(index < symoffset) return 0;
+
+    for(;; index++) {
+        uint32_t h2 = chain[index - symoffset];
+        if((h | 1) == (h2 | 1)
+            && !strcmp(name, strtab + symtab[index].st_name)) {
+
+            return index;
+        }
+        if(h2 & 1) break;
+    }
+    return 0;
+}
+
+static bool isSpaceListSymbol(Symbol *symbol) {
+    return symbol->getType() != Symbol::TYPE_SECTION
+        && symbol->getName()[0] != '$';
+}
+
 bool SymbolList::add(Symbol *symbol, size_t index) {
-    // Can't check just by name since it may not be unique
-    //auto it = symbolMap.find(symbol->getName());
-    //if(it != symbolMap.end()) return false;
+    // Can't check just by name since it may not be unique, so only the
+    // first symbol with a given name is indexed
 
     symbolList.push_back(symbol);
     if(indexMap.size() <= index) indexMap.resize(index + 1);
     indexMap[index] = symbol;
-    if(symbolMap.find(symbol->getName()) == symbolMap.end()) {
-        symbolMap[symbol->getName()] = symbol;
+    if(!gnuHash || index < gnuHash->getSymOffset()) {
+        symbolMap.insert(symbol);
     }
-    if(symbol->getType() != Symbol::TYPE_SECTION
-        && symbol->getName()[0] != '$') {
-
-        spaceMap[symbol->getAddress()] = symbol;
+    if(isSpaceListSymbol(symbol) && !spaceListReleased) {
+        spaceList.push_back(symbol);
+        spaceListDirty = true;
     }
     return true;
 }
@@ -84,24 +187,59 @@ Symbol *SymbolList::get(size_t index) {
     return indexMap[index];
 }
 
+Symbol *SymbolList::findByName(const char *name) {
+    if(auto sym = symbolMap.find(name)) return sym;
+
+    if(gnuHash) {
+        size_t index = gnuHash->lookup(name, gnuHashSymtab, gnuHashStrtab);
+        if(index) return get(index);
+    }
+    return nullptr;
+}
+
 Symbol *SymbolList::find(const char *name) {
-    auto it = symbolMap.find(name);
-    if(it != symbolMap.end()) {
-        auto sym = (*it).second;
-        if(sym->getAliasFor()) {
-            sym = sym->getAliasFor();
+    auto sym = findByName(name);
+    if(sym && sym->getAliasFor()) {
+        sym = sym->getAliasFor();
+    }
+    return sym;
+}
+
+void SymbolList::sortSpaceList() {
+    if(spaceListReleased) {
+        // symbolList is in the order symbols were added
+        for(auto symbol : symbolList) {
+            if(isSpaceListSymbol(symbol)) spaceList.push_back(symbol);
         }
-        return sym;
+        spaceListReleased = false;
+        spaceListDirty = true;
     }
-    else {
-        return nullptr;
+    if(!spaceListDirty) return;
+
+    // keep the last symbol added at each address, as a map would
+    std::stable_sort(spaceList.begin(), spaceList.end(),
+        [](Symbol *a, Symbol *b) {
+            return a->getAddress() < b->getAddress(); });
+    size_t out = 0;
+    for(size_t i = 0; i < spaceList.size(); i++) {
+        if(i + 1 < spaceList.size()
+            && spaceList[i + 1]->getAddress() == spaceList[i]->getAddress()) {
+
+            continue;
+        }
+        spaceList[out++] = spaceList[i];
     }
+    spaceList.resize(out);
+    spaceListDirty = false;
 }
 
 Symbol *SymbolList::find(address_t address) {
-    auto it = spaceMap.find(address);
-    if(it != spaceMap.end()) {
-        auto sym = (*it).second;
+    sortSpaceList();
+    auto it = std::lower_bound(spaceList.begin(), spaceList.end(), address,
+        [](Symbol *a, address_t address) {
+            return a->getAddress() < address; });
+    if(it != spaceList.end() && (*it)->getAddress() == address) {
+        auto sym = *it;
         if(sym->getAliasFor()) {
             sym = sym->getAliasFor();
         }
@@ -249,7 +387,8 @@ SymbolList *SymbolList::buildSymbolList(ElfMap *elfMap) {
         }
     }
 
-    std::map<std::string, Symbol *> seenNamed;
+    SymbolNameIndex seenNamed;
+    seenNamed.reserve(list->getCount());
     for(auto sym : *list) {
         if(!*sym->getName()) continue;  // empty names are fine
 
@@ -259,10 +398,7 @@ SymbolList *SymbolList::buildSymbolList(ElfMap *elfMap) {
         // don't alias SECTIONs with other types (e.g. first FUNC in .text) or FILEs with other types
         if(sym->getType() == Symbol::TYPE_SECTION || sym->getType() == Symbol::TYPE_FILE) continue;
 
-        auto prev = seenNamed.find(sym->getName());
-        if(prev != seenNamed.end()) {
-            auto prevSym = (*prev).second;
-
+        if(auto prevSym = seenNamed.insert(sym)) {
             CLOG(0, "SAME NAME symbol [%s] at addresses 0x%lx and 0x%lx",
                 sym->getName(), prevSym->getAddress(), sym->getAddress());
 
@@ -270,9 +406,6 @@ SymbolList *SymbolList::buildSymbolList(ElfMap *elfMap) {
             if(!sym->getAliasFor()) sym->setAliasFor(prevSym);
             prevSym->addAlias(sym);
         }
-        else {
-            seenNamed[sym->getName()] = sym;
-        }
     }
 
     for(auto sym : *list) {
@@ -357,6 +490,31 @@ SymbolList *SymbolList::buildAnySymbolList(ElfMap *elfMap,
     auto sym = elfMap->getSectionReadPtr<ElfXX_Sym *>(section);
     auto s = section->getHeader();
     int symcount = s->sh_size / s->sh_entsize;
+
+    if(sectionType == SHT_DYNSYM) {
+        // defined dynamic symbols can be found through the ELF's own hash
+        // table, so only the undefined ones need to go in our index
+        auto gnuHashSection = elfMap->findSection(".gnu.hash");
+        if(gnuHashSection && gnuHashSection->getHeader()->sh_type
+            == SHT_GNU_HASH) {
+
+            list->gnuHash = new GnuHashTable(elfMap->getSectionReadPtr
+                <const uint32_t *>(gnuHashSection));
+            list->gnuHashSymtab = sym;
+            list->gnuHashStrtab = strtab;
+        }
+    }
+
+    // the table is scanned once front to back; names are read at random
+    elfMap->adviseSection(section, ElfMap::ACCESS_SEQUENTIAL);
+    elfMap->adviseSection(section->getHeader()->sh_link, ElfMap::ACCESS_WILLNEED);
+
+    list->arena.reserve(symcount);
+    list->symbolList.reserve(symcount);
+    list->indexMap.reserve(symcount);
+    list->spaceList.reserve(symcount);
+    list->symbolMap.reserve(list->gnuHash
+        ? list->gnuHash->getSymOffset() : symcount);
     for(int j = 0; j < symcount; j ++, sym ++) {
         auto type = Symbol::typeFromElfToInternal(sym->st_info);
         auto bind = Symbol::bindFromElfToInternal(sym->st_info);
@@ -392,16 +550,31 @@ SymbolList *SymbolList::buildAnySymbolList(ElfMap *elfMap,
             }
         }
 
-        Symbol *symbol = new Symbol(address, size, name, type, bind, j, shndx);
+        list->arena.emplace_back(address, size, name, type, bind, j, shndx);
+        Symbol *symbol = &list->arena.back();
         CLOG0(5, "%s symbol #%d, index %d, [%s] %lx, type %d\n", sectionName,
             (int)list->symbolList.size(), j, name, address, type);
         list->add(symbol, (size_t)j);
     }
 
+    if(sectionType == SHT_SYMTAB) {
+        // every entry has been copied; .dynsym stays in use for gnuHash
+        elfMap->adviseSection(section, ElfMap::ACCESS_DONTNEED);
+    }
+
     list->buildMappingList();
     return list;
 }
 
+Symbol *MappingCursor::next() {
+    if(!valid) return nullptr;
+
+    auto address = (*it)->getAddress();
+    while(++it != end && (*it)->getAddress() == address) {}
+    valid = (it != end);
+    return get();
+}
+
 void SymbolListWithMapping::buildMappingList() {
     sortedMappingList.reserve(getCount());
     for(auto sym : *this) {
@@ -410,53 +583,51 @@ void SymbolListWithMapping::buildMappingList() {
         }
     }
     sortedMappingList.shrink_to_fit();
-    std::sort(sortedMappingList.begin(), sortedMappingList.end(),
+    std::stable_sort(sortedMappingList.begin(), sortedMappingList.end(),
         [](Symbol *a, Symbol *b) {
+            if(a->getSectionIndex() != b->getSectionIndex()) {
+                return a->getSectionIndex() < b->getSectionIndex();
+            }
             return a->getAddress() < b->getAddress(); });
 }
 
-Symbol *SymbolListWithMapping::findMappingBelowOrAt(Symbol *symbol) {
-    auto it = std::lower_bound(
+MappingCursor SymbolListWithMapping::findMappings(Symbol *symbol) {
+    auto section = std::equal_range(
         sortedMappingList.begin(), sortedMappingList.end(), symbol,
-        [](Symbol *a, Symbol *b) {  // b: symbol, continue if true
-            return a->getAddress() < b->getAddress();
-        });
-    if(it != sortedMappingList.end()) {
-        if((*it)->getAddress() == symbol->getAddress()) {
-            if((*it)->getSectionIndex() == symbol->getSectionIndex()) {
-                return *it;
-            }
-        }
-    }
-    if(it != sortedMappingList.begin()) {
-        while(--it != sortedMappingList.begin()) {
-            if((*it)->getSectionIndex() == symbol->getSectionIndex()) {
-                return *(it);
-            }
+        [](Symbol *a, Symbol *b) {
+            return a->getSectionIndex() < b->getSectionIndex(); });
+    if(section.first == section.second) return MappingCursor();
+
+    auto it = std::lower_bound(section.first, section.second, symbol,
+        [](Symbol *a, Symbol *b) {
+            return a->getAddress() < b->getAddress(); });
+    if(it == section.second || (*it)->getAddress() != symbol->getAddress()) {
+        if(it == section.first) return MappingCursor();
+        auto address = (*--it)->getAddress();
+        // use the first of several mapping symbols at the same address
+        while(it != section.first && (*(it - 1))->getAddress() == address) {
+            --it;
         }
     }
-    return nullptr;
+    return MappingCursor(it, section.second);
 }
 
-Symbol *SymbolListWithMapping::findMappingAbove(Symbol *symbol) {
-    auto it = std::upper_bound(
-        sortedMappingList.begin(), sortedMappingList.end(), symbol,
-        [](Symbol *a, Symbol *b) {  // b: symbol, continue if false
-            return a->getAddress() < b->getAddress();
-        });
-    while(it != sortedMappingList.end()) {
-        if((*it)->getSectionIndex() == symbol->getSectionIndex()) {
-            return *it;
-        }
-        ++it;
-    }
-    return nullptr;
+void SymbolList::compact() {
+    std::vector<Symbol *>().swap(spaceList);
+    spaceListReleased = true;
+    spaceListDirty = false;
+
+    symbolList.shrink_to_fit();
+    indexMap.shrink_to_fit();
 }
 
 size_t SymbolList::estimateSizeOf(Symbol *symbol) {
-    auto it = spaceMap.upper_bound(symbol->getAddress());
-    while(it != spaceMap.end()) {
-        Symbol *other = (*it).second;
+    sortSpaceList();
+    auto it = std::upper_bound(spaceList.begin(), spaceList.end(),
+        symbol->getAddress(), [](address_t address, Symbol *a) {
+            return address < a->getAddress(); });
+    while(it != spaceList.end()) {
+        Symbol *other = *it;
         // for AARCH64, if the next symbol is a mapping symbol, then it is
         // still part of the same function
         if(!strcmp(other->getName(), "$d")) {
@@ -626,7 +797,9 @@ SymbolVersionList::SymbolVersionList(ElfMap *elfMap) {
 }
 
 SymbolAliasFinder::SymbolAliasFinder(SymbolList *list)
-    : UnionFind(list->getCount()), sortedList(list->begin(), list->end()) {
+    : OrderedUnionFind(list->getCount()),
+    sortedList(list->begin(), list->end()) {
+
     std::sort(sortedList.begin(), sortedList.end(),
         [](Symbol *a, Symbol *b) {
             return a->getAddress() < b->getAddress();
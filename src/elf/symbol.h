@@ -3,6 +3,7 @@
 
 #include <cstddef>  // for size_t
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <string>
 #include "types.h"
@@ -118,20 +119,101 @@ private:
     bool hasVersionInfo() const { return verList.size() > 0; }
 };
 
+/** Open-addressed hash index from symbol name to the first Symbol with
+    that name. Names are compared in place (they point into the ELF string
+    table), so no strings are copied. Uses the GNU ELF hash function.
+*/
+class SymbolNameIndex {
+private:
+    struct Slot {
+        uint32_t hash;
+        Symbol *symbol;
+    };
+    std::vector<Slot> table;
+    size_t count;
+public:
+    SymbolNameIndex() : count(0) {}
+
+    /** Returns the existing symbol with this name, or adds symbol and
+        returns nullptr.
+    */
+    Symbol *insert(Symbol *symbol);
+    Symbol *find(const char *name) const;
+    void reserve(size_t n);
+
+    static uint32_t hash(const char *name);
+private:
+    void rehash(size_t newSize);
+};
+
+/** Read-only view of an ELF .gnu.hash section, used to look up dynamic
+    symbols without building our own index for the defined ones.
+*/
+class GnuHashTable {
+private:
+    uint32_t nbuckets;
+    uint32_t symoffset;
+    uint32_t bloomSize;
+    uint32_t bloomShift;
+    const ElfXX_Addr *bloom;
+    const uint32_t *buckets;
+    const uint32_t *chain;
+public:
+    GnuHashTable(const uint32_t *data);
+
+    uint32_t getSymOffset() const { return symoffset; }
+
+    /** Returns the symbol table index of name, or 0 if not present. The
+        caller supplies the symbol table to compare names against.
+    */
+    size_t lookup(const char *name, const ElfXX_Sym *symtab,
+        const char *strtab) const;
+};
+
+/** Walks the mapping symbols ($x, $d, ...) of one section in address
+    order, so code/data boundaries within a function are found in a single
+    sweep.
+*/
+class MappingCursor {
+public:
+    typedef std::vector<Symbol *>::const_iterator IteratorType;
+private:
+    IteratorType it, end;
+    bool valid;
+public:
+    MappingCursor() : valid(false) {}
+    MappingCursor(IteratorType it, IteratorType end)
+        : it(it), end(end), valid(it != end) {}
+
+    Symbol *get() const { return valid ? *it : nullptr; }
+    /** Advances to the next mapping symbol at a higher address. */
+    Symbol *next();
+};
+
 class SymbolList {
 private:
     typedef std::vector<Symbol *> ListType;
     ListType symbolList;
     typedef std::vector<Symbol *> IndexMapType;
     IndexMapType indexMap;
-    typedef std::map<std::string, Symbol *> MapType;
-    MapType symbolMap;
-    std::map<address_t, Symbol *> spaceMap;
+    // symbols parsed from the ELF live here, contiguously; reserved up
+    // front so that Symbol pointers stay valid
+    std::vector<Symbol> arena;
+    SymbolNameIndex symbolMap;
+    // sorted by address, one (the last added) symbol per address
+    std::vector<Symbol *> spaceList;
+    bool spaceListDirty;
+    bool spaceListReleased;
+    GnuHashTable *gnuHash;
+    const ElfXX_Sym *gnuHashSymtab;
+    const char *gnuHashStrtab;
     // elfmap this symbol list was built from. this may be a separate symbol elfmap.
     ElfMap *sourceElfMap;
 public:
-    SymbolList(ElfMap *sourceElfMap = nullptr) : sourceElfMap(sourceElfMap) {}
-    virtual ~SymbolList() {}
+    SymbolList(ElfMap *sourceElfMap = nullptr) : spaceListDirty(false),
+        spaceListReleased(false), gnuHash(nullptr), gnuHashSymtab(nullptr), gnuHashStrtab(nullptr),
+        sourceElfMap(sourceElfMap) {}
+    virtual ~SymbolList() { delete gnuHash; }
 
     bool add(Symbol *symbol, size_t index);
     void addAlias(Symbol *symbol, size_t otherIndex);
@@ -147,14 +229,22 @@ public:
 
     size_t estimateSizeOf(Symbol *symbol);
 
+    /** Frees the by-address index, which is rebuilt if needed again, and
+        trims list slack. Symbols themselves are kept, since Chunks point
+        to them.
+    */
+    void compact();
+
     virtual void buildMappingList() {}
-    virtual Symbol *findMappingBelowOrAt(Symbol *symbol) { return nullptr; }
-    virtual Symbol *findMappingAbove(Symbol *symbol) { return nullptr; }
+    virtual MappingCursor findMappings(Symbol *symbol)
+        { return MappingCursor(); }
 
     static SymbolList *buildSymbolList(ElfMap *elfMap, std::string symbolFile);
     static SymbolList *buildSymbolList(ElfMap *elfMap);
     static SymbolList *buildDynamicSymbolList(ElfMap *elfMap);
 private:
+    Symbol *findByName(const char *name);
+    void sortSpaceList();
     static SymbolList *buildAnySymbolList(ElfMap *elfMap,
         const char *sectionName, unsigned sectionType);
     static Symbol *findSizeZero(SymbolList *list, const char *sym);
@@ -162,13 +252,16 @@ private:
 
 class SymbolListWithMapping : public SymbolList {
 private:
+    // ordered by section index, then address
     std::vector<Symbol *> sortedMappingList;
 public:
     using SymbolList::SymbolList;
 
     virtual void buildMappingList();
-    virtual Symbol *findMappingBelowOrAt(Symbol *symbol);
-    virtual Symbol *findMappingAbove(Symbol *symbol);
+    /** Positions a cursor on the mapping symbol in effect at symbol's
+        address: one at that address if any, else the closest one below.
+    */
+    virtual MappingCursor findMappings(Symbol *symbol);
 };
 
 #endif
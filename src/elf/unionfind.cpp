@@ -1,25 +1,33 @@
 #include "unionfind.h"
 
-UnionFind::UnionFind(size_t count) {
+UnionFindBase::UnionFindBase(size_t count) : parent(count) {
     for(size_t i = 0; i < count; i++) {
-        parent.push_back(i);
+        parent[i] = i;
     }
 }
 
+size_t UnionFindBase::find(size_t x) {
+    size_t root = x;
+    while(parent[root] != root) { root = parent[root]; }
+
+    // path compression
+    while(parent[x] != root) {
+        auto next = parent[x];
+        parent[x] = root;
+        x = next;
+    }
+    return root;
+}
+
 void UnionFind::join(size_t x1, size_t x2) {
     auto p1 = find(x1);
     auto p2 = find(x2);
-    setEdge(p1, p2);
-}
+    if(p1 == p2) return;
 
-size_t UnionFind::find(size_t x) {
-    while(parent[x] != x) { x = parent[x]; }
-    parent[x] = x;  // path compression
-    return x;
-}
-
-void UnionFind::setEdge(size_t x1, size_t x2) {
-    if(x1 < x2) parent[x2] = x1;
-    if(x1 > x2) parent[x1] = x2;
+    if(rank[p1] < rank[p2]) parent[p1] = p2;
+    else if(rank[p1] > rank[p2]) parent[p2] = p1;
+    else {
+        parent[p2] = p1;
+        rank[p1] ++;
+    }
 }
-
@@ -4,19 +4,42 @@
 #include <vector>
 #include <cstddef>
 
-class UnionFind {
+/** Disjoint sets over the indices [0, count). find() compresses the path
+    it walks, so repeated lookups are nearly constant time.
+*/
+class UnionFindBase {
 protected:
     std::vector<size_t> parent;
+protected:
+    UnionFindBase(size_t count);
+public:
+    size_t find(size_t x);
+};
 
+/** Joins by rank, so any element may end up as a set's representative. */
+class UnionFind : public UnionFindBase {
+private:
+    std::vector<unsigned char> rank;
 public:
-    UnionFind(size_t count);
-    virtual ~UnionFind() {}
+    UnionFind(size_t count) : UnionFindBase(count), rank(count) {}
 
     void join(size_t x1, size_t x2);
-    size_t find(size_t x);
+};
 
-private:
-    virtual void setEdge(size_t x1, size_t x2);
+/** For sets whose representative matters: DerivedType::setEdge(r1, r2)
+    is given two distinct roots and links one below the other by setting
+    parent[] itself. The call is resolved statically.
+*/
+template <typename DerivedType>
+class OrderedUnionFind : public UnionFindBase {
+protected:
+    OrderedUnionFind(size_t count) : UnionFindBase(count) {}
+public:
+    void join(size_t x1, size_t x2) {
+        auto p1 = find(x1);
+        auto p2 = find(x2);
+        if(p1 != p2) static_cast<DerivedType *>(this)->setEdge(p1, p2);
+    }
 };
 
 #endif
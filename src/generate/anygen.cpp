@@ -198,24 +198,13 @@ void AnyGen::makePhdrTable() {
 }
 
 void AnyGen::updateOffsets() {
-    // every Section is written to the file, even those without SectionHeaders
-    size_t offset = 0;
-    for(auto section : sectionList) {
-        LOG(1, "section [" << section->getName() << "] is at offset " << std::dec << offset);
-        section->setOffset(offset);
-        offset += section->getContent()->getSize();
-    }
+    sectionList.updateOffsets();
 }
 
 void AnyGen::serialize(const std::string &filename) {
-    std::ofstream fs(filename, std::ios::out | std::ios::binary);
-    for(auto section : sectionList) {
-        LOG(1, "serializing " << section->getName()
-            << " @ " << std::hex << section->getOffset()
-            << " of size " << std::dec << section->getContent()->getSize());
-        fs << *section;
+    if(!sectionList.serialize(filename)) {
+        LOG(0, "Cannot open output file [" << filename << "]");
     }
-    fs.close();
 }
 
 size_t AnyGen::shdrIndexOf(Section *section) {
@@ -18,6 +18,7 @@
 #include "pass/relocheck.h"
 #include "snippet/hook.h"
 #include "snippet/logfunction.h"
+#include "util/threadpool.h"
 
 #include "log/log.h"
 #include "log/temp.h"
@@ -563,7 +564,19 @@ address_t BinGen::writeOutCode(Module *module, address_t pos) {
     const int ll = 10;
     auto list = makeSortedFunctionList(module);
 
-    for(auto func : list) {
+    // addresses are fixed by now, so functions can be encoded in parallel
+    std::vector<std::string> codeList(list.size());
+    ThreadPool().parallelFor(list.size(), [&] (size_t i) {
+        InstrWriterCppString writer(codeList[i]);
+        for(auto block : CIter::children(list[i])) {
+            for(auto instr : CIter::children(block)) {
+                instr->getSemantic()->accept(&writer);
+            }
+        }
+    });
+
+    for(size_t i = 0; i < list.size(); i ++) {
+        auto func = list[i];
         LOG(ll, "writing out " << func->getName()
             << ": pos " << pos << " vs function " << func->getAddress());
         LOG(ll, " size " << func->getSize());
@@ -574,19 +587,9 @@ address_t BinGen::writeOutCode(Module *module, address_t pos) {
             fs << zero;
         }
 
-        for(auto block : CIter::children(func)) {
-            for(auto instr : CIter::children(block)) {
-#if 0
-                ChunkDumper dumper;
-                instr->accept(&dumper);
-#endif
-
-                std::string output;
-                InstrWriterCppString writer(output);
-                instr->getSemantic()->accept(&writer);
-                fs << output;
-            }
-        }
+        fs << codeList[i];
+        codeList[i].clear();
+        codeList[i].shrink_to_fit();
         pos = func->getAddress() + func->getSize();
         LOG(ll, " to " << pos);
     }
@@ -10,12 +10,23 @@
 #include "operation/find2.h"
 #include "elf/elfspace.h"
 #include "elf/symbol.h"
+#include "dwarf/parser.h"
+#include "dwarf/entry.h"
+#include "dwarf/defines.h"
 #include "instr/concrete.h"
 #include "util/streamasstring.h"
+#include "util/threadpool.h"
 #include "pass/chunkpass.h"
 #include "log/log.h"
 #include "config.h"
 
+#ifndef DT_RELR  // older elf.h
+    #define SHT_RELR    19
+    #define DT_RELRSZ   35
+    #define DT_RELR     36
+    #define DT_RELRENT  37
+#endif
+
 void BasicElfCreator::execute() {
     auto header = new Section("=elfheader");
     getSectionList()->addSection(header);
@@ -88,6 +99,16 @@ void BasicElfCreator::execute() {
         relaDynSection->setContent(relaDyn);
         getSectionList()->addSection(relaDynSection);
 
+        // .relr.dyn
+        if(getConfig()->useRelrRelocs()) {
+            auto relr = new RelrSectionContent();
+            auto relrDynSection = new Section(".relr.dyn", SHT_RELR,
+                SHF_ALLOC);
+            relrDynSection->setContent(relr);
+            getSectionList()->addSection(relrDynSection);
+            relaDyn->setRelr(relr);
+        }
+
         // .dynamic
         auto dynamicSection = new Section(".dynamic", SHT_DYNAMIC,
             SHF_ALLOC | SHF_WRITE);
@@ -256,6 +277,12 @@ void GenerateSectionTable::makeShdrTable() {
                     shdr->sh_link = sectionList->indexOf(".dynsym");
                 });
             }
+            else if(dynamic_cast<RelrSectionContent *>(section->getContent())) {
+                deferred->addFunction([] (ElfXX_Shdr *shdr) {
+                    shdr->sh_addralign = 8;
+                    shdr->sh_entsize = sizeof(address_t);
+                });
+            }
             else if(auto v = dynamic_cast<GnuHashSectionContent *>(section->getContent())) {
                 deferred->addFunction([this, sectionList, v] (ElfXX_Shdr *shdr) {
                     shdr->sh_addralign = 8;
@@ -417,6 +444,18 @@ void BasicElfStructure::makeDynamicSection() {
     });
     dynamic->addPair(DT_RELAENT, sizeof(ElfXX_Rela));
 
+    if(getConfig()->useRelrRelocs()) {
+        dynamic->addPair(DT_RELR, [this] () {
+            auto relrDyn = getSection(".relr.dyn");
+            return relrDyn->getHeader()->getAddress();
+        });
+        dynamic->addPair(DT_RELRSZ, [this] () {
+            auto relrDyn = getSection(".relr.dyn");
+            return relrDyn->getContent()->getSize();
+        });
+        dynamic->addPair(DT_RELRENT, sizeof(address_t));
+    }
+
     dynamic->addPair(DT_INIT_ARRAY, [this] () {
         auto initArray = getSection(".init_array");
         return initArray->getHeader()->getAddress();
@@ -500,6 +539,9 @@ void AssignSectionsToSegments::execute() {
             dynSegment->addContains(getSection(".gnu.hash"));
         }
         dynSegment->addContains(getSection(".rela.dyn"));
+        if(getConfig()->useRelrRelocs()) {
+            dynSegment->addContains(getSection(".relr.dyn"));
+        }
         dynSegment->addContains(getSection(".dynamic"));
         phdrTable->add(dynSegment, 0x400000);
 
@@ -522,15 +564,19 @@ void AssignSectionsToSegments::execute() {
 void TextSectionCreator::execute() {
     // this function assumes WatermarkAllocator being used.
 
-    // Before all LOAD segments, we need to put padding.
-    MakePaddingSection makePadding(0);
+    // Before all LOAD segments, we need to put padding. For huge pages, the
+    // file offset must match the address modulo 2MB as well.
+    auto address = getData()->getBacking()->getBase();
+    bool hugePages = getConfig()->isHugePageText();
+    const size_t pageSize = hugePages
+        ? PagePaddingContent::HUGE_PAGE_SIZE : PagePaddingContent::PAGE_SIZE;
+    MakePaddingSection makePadding(address & (pageSize - 1), true, pageSize);
     makePadding.setData(getData());
     makePadding.setConfig(getConfig());
     makePadding.execute();
 
     auto phdrTable = getSection("=phdr_table")->castAs<PhdrTableContent *>();
     // Finally, map all code regions as individual ELF segments.
-    auto address = getData()->getBacking()->getBase();
     //auto size = getData()->getBacking()->getSize();
     auto size = (getData()->getBacking()->getBuffer().length() + 0xfff) & ~0x1000;
     LOG(1, "map " << std::hex << address << " size " << size);
@@ -538,12 +584,9 @@ void TextSectionCreator::execute() {
 
     auto textSection = new Section(".text", SHT_PROGBITS,
         SHF_ALLOC | SHF_EXECINSTR);
-    DeferredString *textValue = nullptr;
-    // Don't modify backing after this point to avoid invalidating c_str
-    auto copy = new std::string(getData()->getBacking()->getBuffer());
-    textValue = new DeferredString(
-        reinterpret_cast<const char *>(copy->c_str()),
-        copy->length());
+    // Don't modify backing after this point to avoid invalidating the view
+    const auto &buffer = getData()->getBacking()->getBuffer();
+    auto textValue = new DeferredStringView(buffer.data(), buffer.length());
 
     if(getConfig()->isFreestandingKernel()) {
         textSection->getHeader()->setAddress(LINUX_KERNEL_CODE_BASE);
@@ -555,8 +598,14 @@ void TextSectionCreator::execute() {
 
     getSectionList()->addSection(textSection);
 
-    auto loadSegment = new SegmentInfo(PT_LOAD, PF_R | PF_X, 0x1000);
+    auto loadSegment = new SegmentInfo(PT_LOAD, PF_R | PF_X, pageSize);
     loadSegment->addContains(textSection);
+    if(hugePages) {
+        // extend the mapping to whole huge pages
+        address_t end = address + buffer.length();
+        loadSegment->setAdditionalMemSize(
+            ((end + pageSize - 1) & ~(pageSize - 1)) - end);
+    }
     phdrTable->add(loadSegment);
 }
 
@@ -581,8 +630,16 @@ void MakeInitArray::addInitFunction(InitArraySectionContent *content,
         // !!! Hardcoding this address for now. After =elfheader & .interp
         const address_t INIT_ARRAY_ADDR = 0x20005c + initArraySize;
         auto offset = content->getSize();
-        relaDyn->addDataAddressRef(INIT_ARRAY_ADDR + offset, value);
-        content->addPointer([] () { return address_t(0); });
+        if(getConfig()->useRelrRelocs()) {
+            auto relr = getData()->getSection(".relr.dyn")
+                ->castAs<RelrSectionContent *>();
+            relr->add(INIT_ARRAY_ADDR + offset);
+            content->addPointer(value);
+        }
+        else {
+            relaDyn->addDataAddressRef(INIT_ARRAY_ADDR + offset, value);
+            content->addPointer([] () { return address_t(0); });
+        }
     }
     else {
         content->addPointer(value);
@@ -1030,6 +1087,22 @@ bfd_elf_gnu_hash (const char *namearg)
   return h & 0xffffffff;
 }
 
+/** Picks the number of .gnu.hash buckets for count symbols, from the same
+    table of primes as binutils, aiming for about two symbols per bucket.
+*/
+static size_t gnuHashBucketCount(size_t count) {
+    static const size_t primes[] = {
+        1, 3, 17, 37, 67, 97, 131, 197, 263, 521, 1031, 2053, 4099, 8209,
+        16411, 32771, 65537, 131101, 262147
+    };
+    size_t buckets = 1;
+    for(auto prime : primes) {
+        if(prime > count / 2) break;
+        buckets = prime;
+    }
+    return buckets;
+}
+
 void MakeDynsymHash::execute() {
     auto gnuhash = getData()->getSection(".gnu.hash")->castAs<GnuHashSectionContent *>();
     auto dynsym = getData()->getSection(".dynsym")->castAs<SymbolTableContent *>();
@@ -1040,40 +1113,63 @@ void MakeDynsymHash::execute() {
     dynstr->writeTo(dynstrStream);
     auto dynstrData = dynstrStream.str();
 
-    bucketList.resize(1011);
-    //bucketList.resize(10007);
-
-    bool hashing = false;
+    // Undefined symbols are looked up in other libraries, so they are not
+    // hashed; they stay at the front of .dynsym, before symoffset.
+    struct HashedName {
+        std::string name;
+        uint32_t hash;
+    };
+    std::vector<HashedName> hashedList;
     size_t firstHashedSymbol = 0;
     for(auto sym : *dynsym) {
         auto elfSym = sym->getElfPtr();
-        LOG(1, "elfSym address " << elfSym->st_value);
-        // Skip the undefined symbols (first, address == 0), don't hash them.
-        // These will be looked up in another library, not in our own .dynsym.
-        if(elfSym->st_value) hashing = true;
-        if(!hashing) {
+        if(!elfSym->st_value && elfSym->st_shndx == SHN_UNDEF) {
             firstHashedSymbol ++;
             continue;
         }
 
         auto name = dynstrData.c_str() + elfSym->st_name;
-        auto hash = bfd_elf_gnu_hash(name);
+        hashedList.push_back({name, static_cast<uint32_t>(
+            bfd_elf_gnu_hash(name))});
+        LOG(1, "elfSym name [" << name << "] hash 0x" << std::hex
+            << hashedList.back().hash);
+    }
 
-        LOG(1, "elfSym name [" << name << "] hash 0x" << std::hex << hash);
-        bucketList[hash % bucketList.size()].push_back(name);
+    bucketList.clear();
+    bucketList.resize(gnuHashBucketCount(hashedList.size()));
+    std::vector<std::vector<uint32_t>> hashList(bucketList.size());
+    for(const auto &hashed : hashedList) {
+        auto bucket = hashed.hash % bucketList.size();
+        bucketList[bucket].push_back(hashed.name);
+        hashList[bucket].push_back(hashed.hash);
     }
 
-    size_t index = 0;
+    // hashed symbols are placed after all unhashed ones, in bucket order
+    size_t index = 1;
     for(const auto &bucket : bucketList) {
         for(const auto &name : bucket) {
             indexMap[name] = index++;
         }
     }
 
+    // bloom filter, sized like binutils does: k=2 bits per symbol
     typedef uint64_t BloomType;  // Assumes ELFCLASS64
-    const uint32_t bloomShift = 5;
-    std::vector<BloomType> bloomList; //= {-1ul, -1ul};
-    for(size_t i = 0; i < 0x100; i ++) bloomList.push_back(-1ul);
+    const uint32_t bloomBits = 8 * sizeof(BloomType);
+    uint32_t maskBitsLog2 = 1;
+    while((size_t(1) << maskBitsLog2) <= hashedList.size()) maskBitsLog2 ++;
+    if(maskBitsLog2 < 3) maskBitsLog2 = 5;
+    else if((size_t(1) << (maskBitsLog2 - 2)) & hashedList.size()) {
+        maskBitsLog2 += 3;
+    }
+    else maskBitsLog2 += 2;
+    if(maskBitsLog2 < 6) maskBitsLog2 = 6;  // at least one bloom word
+    const uint32_t bloomShift = maskBitsLog2;
+    std::vector<BloomType> bloomList((size_t(1) << maskBitsLog2) / bloomBits);
+    for(const auto &hashed : hashedList) {
+        auto &word = bloomList[(hashed.hash / bloomBits) % bloomList.size()];
+        word |= BloomType(1) << (hashed.hash % bloomBits);
+        word |= BloomType(1) << ((hashed.hash >> bloomShift) % bloomBits);
+    }
 
     gnuhash->add(static_cast<uint32_t>(bucketList.size()));     // nbuckets
     gnuhash->add(static_cast<uint32_t>(firstHashedSymbol));     // symoffset
@@ -1098,25 +1194,25 @@ void MakeDynsymHash::execute() {
         }
     }
 
-    // chain
-    for(const auto &bucket : bucketList) {
-        for(const auto &name : bucket) {
-            auto hash = bfd_elf_gnu_hash(name.c_str());
-            //uint32_t value = (hash % bucketList.size()) & ~1;
-            uint32_t value = hash & ~1;
-            if(name == bucket.back()) value += 1;
+    // chain: hash with the low bit marking the end of each bucket
+    for(const auto &hashes : hashList) {
+        for(size_t i = 0; i < hashes.size(); i ++) {
+            uint32_t value = hashes[i] & ~1;
+            if(i + 1 == hashes.size()) value |= 1;
             gnuhash->add(value);
         }
     }
-    
+
     // .dymsym sorting
     auto oldValueMap = dynsym->getValueMap();  // deep copy
     dynsym->clearAll();
     for(const auto &pair : oldValueMap) {
         auto key = pair.first;
         auto val = pair.second;
+        auto elfSym = val->getElfPtr();
+        bool hashed = elfSym->st_value || elfSym->st_shndx != SHN_UNDEF;
         auto it = indexMap.find(key.getName());
-        if(it != indexMap.end()) {
+        if(hashed && it != indexMap.end()) {
             LOG(1, "Found symbol index for name [" << (*it).first << "] at index "
                 << (*it).second);
             key.setTableIndex((*it).second);
@@ -1125,20 +1221,137 @@ void MakeDynsymHash::execute() {
     }
 
     dynsym->recalculateIndices();
+}
+
+void MakeEhFrame::execute() {
+    // fixed address, like the other dynamic segments in AssignSectionsToSegments
+    const address_t EH_FRAME_ADDRESS = 0x700000;
+
+    auto ehFrameSection = new Section(".eh_frame", SHT_PROGBITS, SHF_ALLOC);
+    auto ehFrame = new EhFrameContent(ehFrameSection);
+    for(auto module : CIter::children(getData()->getProgram())) {
+        addModule(module, ehFrame);
+    }
+    ehFrame->finish();
+    ehFrameSection->setContent(ehFrame);
 
-    //auto newValueMap = dynsym->getValueMap();  // deep copy
-    //for(const auto &val : *dynsym) {
-    //    LOG(1, "new order for symbol with name [" << val->getName() << "]");
-    //}
+    auto hdrSection = new Section(".eh_frame_hdr", SHT_PROGBITS, SHF_ALLOC);
+    hdrSection->setContent(new EhFrameHdrContent(hdrSection, ehFrame));
+
+    MakePaddingSection makePadding(EH_FRAME_ADDRESS & 0xfff);
+    makePadding.setData(getData());
+    makePadding.setConfig(getConfig());
+    makePadding.execute();
+
+    getData()->getSectionList()->addSection(ehFrameSection);
+    getData()->getSectionList()->addSection(hdrSection);
+
+    auto phdrTable = getData()->getSection("=phdr_table")
+        ->castAs<PhdrTableContent *>();
+    auto loadSegment = new SegmentInfo(PT_LOAD, PF_R, 0x1000);
+    loadSegment->addContains(ehFrameSection);
+    loadSegment->addContains(hdrSection);
+    phdrTable->add(loadSegment, EH_FRAME_ADDRESS);
+    phdrTable->assignAddressesToSections(loadSegment, EH_FRAME_ADDRESS);
+
+    auto hdrSegment = new SegmentInfo(PT_GNU_EH_FRAME, PF_R, 0x4);
+    hdrSegment->addContains(hdrSection);
+    phdrTable->add(hdrSegment);
+
+    LOG(1, "regenerated .eh_frame with " << ehFrame->getFDEList().size()
+        << " FDEs");
+}
+
+void MakeEhFrame::addModule(Module *module, EhFrameContent *ehFrame) {
+    auto elfSpace = module->getElfSpace();
+    if(!elfSpace || !elfSpace->getElfMap()) return;
+    auto elfMap = elfSpace->getElfMap();
+
+    DwarfUnwindInfo *info = elfSpace->getDwarfInfo();
+    bool ownInfo = false;
+    if(!info) {
+        info = DwarfParser(elfMap).getUnwindInfo();
+        if(!info) return;
+        ownInfo = true;
+    }
+
+    std::map<address_t, Function *> functionMap;
+    for(auto function : CIter::functions(module)) {
+        if(auto position = function->getOriginalPosition()) {
+            functionMap[position->get()] = function;
+        }
+    }
+
+    // The CFA programs are expressed in offsets from the start of the
+    // function, so they are only reused when the function size matches.
+    std::map<uint64_t, std::vector<std::pair<DwarfFDE *, Function *>>> cieMap;
+    for(auto it = info->fdeBegin(); it != info->fdeEnd(); ++it) {
+        auto fde = *it;
+        auto found = functionMap.find(fde->getPcBegin());
+        if(found == functionMap.end()) continue;
+        auto function = found->second;
+        if(fde->getPcRange() != function->getSize()) {
+            LOG(10, "dropping FDE for resized function "
+                << function->getName());
+            continue;
+        }
+        cieMap[fde->getCieIndex()].emplace_back(fde, function);
+    }
+
+    address_t base = elfMap->getBaseAddress();
+    for(const auto &pair : cieMap) {
+        auto cie = info->getCIE(pair.first);
+        std::function<address_t ()> personality = [] () { return 0; };
+        if(auto augmentation = cie->getAugmentation()) {
+            address_t routine = augmentation->getPersonalityEncodingRoutine();
+            auto found = functionMap.find(routine);
+            if(!(augmentation->getPersonalityEncoding() & DW_EH_PE_indirect)
+                && found != functionMap.end()) {
+
+                auto function = found->second;
+                personality = [function] () { return function->getAddress(); };
+            }
+            else {
+                personality = [routine, base] () { return routine + base; };
+            }
+        }
+
+        ehFrame->addCIE(cie, personality);
+        for(const auto &entry : pair.second) {
+            auto fde = entry.first;
+            address_t lsda = 0;
+            if(fde->getAugmentation() && fde->getAugmentation()->getLsdaPointer()) {
+                lsda = fde->getAugmentation()->getLsdaPointer() + base;
+            }
+            ehFrame->addFDE(fde, entry.second, lsda);
+        }
+    }
+
+    if(ownInfo) delete info;
 }
 
 void MakeGlobalSymbols::execute() {
     auto symtab = getData()->getSection(".symtab")->castAs<SymbolTableContent *>();
 
     LOG(5, "MakeGlobalSymbols::execute()");
-    // generate symtab entries for global variables
+
+    // Symbols are collected for each module in parallel, then added to the
+    // table in module order; the table sorts them all at once when read.
+    struct GlobalSymbol {
+        GlobalVariable *var;
+        DataSection *section;
+        Symbol *symbol;
+    };
+    std::vector<Module *> moduleList;
     for(auto module : CIter::children(getData()->getProgram())) {
-        for(auto region : CIter::regions(module)) {
+        moduleList.push_back(module);
+    }
+    std::vector<std::vector<GlobalSymbol>> symbolLists(moduleList.size());
+
+    ThreadPool pool;
+    pool.parallelFor(moduleList.size(), [&] (size_t i) {
+        auto &list = symbolLists[i];
+        for(auto region : CIter::regions(moduleList[i])) {
             for(auto section : CIter::children(region)) {
 #if 0  // sections aren't added to list yet, so this fails
                 if(getData()->getSectionList()->indexOf(section->getName()) < 0) {
@@ -1152,40 +1365,44 @@ void MakeGlobalSymbols::execute() {
                     continue;
                 }
                 for(auto var : section->getGlobalVariables()) {
-                    if(auto origsym = var->getSymbol()) {
-
-                        address_t address = var->getAddress();
-
-                        auto handleGlobal = [this, section, address, symtab, var]
-                            (Symbol *osymbol) {
+                    auto origsym = var->getSymbol();
+                    if(!origsym) continue;
 
-                            const char *oname = osymbol->getName();
-                            if(osymbol->getType() != Symbol::TYPE_OBJECT) return;
-                            LOG(10, "adding symtab entry for " << oname << ", type "
-                                << osymbol->getType());
-
-                            auto nsymbol = new Symbol(
-                                address, osymbol->getSize(), oname,
-                                osymbol->getType(), osymbol->getBind(), 0, 0);
+                    address_t address = var->getAddress();
+                    auto handleGlobal = [&] (Symbol *osymbol) {
+                        if(osymbol->getType() != Symbol::TYPE_OBJECT) return;
 
-                            auto v = symtab->addGlobalVarSymbol(var, nsymbol, address);
+                        auto nsymbol = new Symbol(
+                            address, osymbol->getSize(), osymbol->getName(),
+                            osymbol->getType(), osymbol->getBind(), 0, 0);
+                        list.push_back(GlobalSymbol{var, section, nsymbol});
+                    };
 
-                            v->addFunction([this, symtab, section] (ElfXX_Sym *symbol) {
-                                symbol->st_shndx = symtab
-                                    ->indexOfSectionSymbol(section->getName(),
-                                        getData()->getSectionList());
-                            });
-                        };
-
-                        handleGlobal(origsym);
+                    handleGlobal(origsym);
 
-                        for(auto alias : origsym->getAliases()) {
-                            handleGlobal(alias);
-                        }
+                    for(auto alias : origsym->getAliases()) {
+                        handleGlobal(alias);
                     }
                 }
             }
         }
+    });
+
+    for(const auto &list : symbolLists) {
+        for(const auto &global : list) {
+            LOG(10, "adding symtab entry for " << global.symbol->getName()
+                << ", type " << global.symbol->getType());
+
+            auto section = global.section;
+            auto v = symtab->addGlobalVarSymbol(global.var, global.symbol,
+                global.symbol->getAddress());
+
+            v->addFunction([this, symtab, section] (ElfXX_Sym *symbol) {
+                symbol->st_shndx = symtab
+                    ->indexOfSectionSymbol(section->getName(),
+                        getData()->getSectionList());
+            });
+        }
     }
 }
 
@@ -1195,18 +1412,18 @@ void ElfFileWriter::execute() {
 }
 
 void ElfFileWriter::updateOffsets() {
-    // every Section is written to the file, even those without SectionHeaders
-    size_t offset = 0;
-    for(auto section : *getSectionList()) {
-        LOG(1, "section [" << section->getName() << "] is at offset " << std::dec << offset);
-        section->setOffset(offset);
-        offset += section->getContent()->getSize();
-    }
+    getSectionList()->updateOffsets();
 }
 
 void ElfFileWriter::serialize() {
-    std::ofstream fs(filename, std::ios::out | std::ios::binary);
-    if(!fs.is_open()) {
+    if(filename.empty()) {
+        auto backing = static_cast<MemoryBufferBacking *>(
+            getData()->getBacking());
+        getSectionList()->serializeInto(backing->getImage());
+        return;
+    }
+
+    if(!getSectionList()->serialize(filename)) {
         LOG(0, "Cannot open executable file [" << filename << "]");
         std::cerr << "Cannot open executable file [" << filename << "]" << std::endl;
         LOG(0, "");
@@ -1214,21 +1431,12 @@ void ElfFileWriter::serialize() {
         LOG(0, "**** PLEASE RE-RUN WITH DIFFERENT OUTPUT FILENAME! ****");
         return;
     }
-    for(auto section : *getSectionList()) {
-        LOG(1, "serializing " << section->getName()
-            << " @ " << std::hex << section->getOffset()
-            << " of size " << std::dec << section->getContent()->getSize());
-        if(static_cast<std::streamoff>(section->getOffset()) != fs.tellp()) {
-            LOG(1, " WARNING: section offset does not match file position");
-        }
-        fs << *section;
-    }
-    fs.close();
     chmod(filename.c_str(), 0744);
 }
 
-MakePaddingSection::MakePaddingSection(size_t desiredAlignment, bool isIsolatedPadding)
-    : desiredAlignment(desiredAlignment), isIsolatedPadding(isIsolatedPadding) {
+MakePaddingSection::MakePaddingSection(size_t desiredAlignment, bool isIsolatedPadding,
+    size_t pageSize) : desiredAlignment(desiredAlignment),
+    isIsolatedPadding(isIsolatedPadding), pageSize(pageSize) {
 
     setName(StreamAsString() << "MakePaddingSection{align=" << std::hex
         << desiredAlignment << ",isIsolated=" << (isIsolatedPadding ? '1':'0'));
@@ -1240,7 +1448,8 @@ void MakePaddingSection::execute() {
     auto paddingSection = new Section(
         isIsolatedPadding ? "=padding" : "=intra-padding");
     auto paddingContent = new PagePaddingContent(
-        getData()->getSectionList()->back(), desiredAlignment, isIsolatedPadding);
+        getData()->getSectionList()->back(), desiredAlignment,
+        isIsolatedPadding, pageSize);
     paddingSection->setContent(paddingContent);
     getData()->getSectionList()->addSection(paddingSection);
 }
@@ -117,11 +117,26 @@ public:
     virtual void execute();
 };
 
+/** Regenerates .eh_frame/.eh_frame_hdr for the functions in every module,
+    so the unwinder can find frames in the new code.
+*/
+class Module;
+class EhFrameContent;
+class MakeEhFrame : public NormalElfOperation {
+public:
+    virtual void execute();
+private:
+    void addModule(Module *module, EhFrameContent *ehFrame);
+};
+
 class MakeGlobalSymbols : public NormalElfOperation {
 public:
     virtual void execute();
 };
 
+/** Writes the output to filename, or with an empty filename into the
+    image of the MemoryBufferBacking, so it can be run without a file.
+*/
 class ElfFileWriter : public ConcreteElfOperation {
 private:
     std::string filename;
@@ -140,8 +155,10 @@ class MakePaddingSection : public NormalElfOperation {
 private:
     size_t desiredAlignment;
     bool isIsolatedPadding;
+    size_t pageSize;
 public:
-    MakePaddingSection(size_t desiredAlignment, bool isIsolatedPadding = true);
+    MakePaddingSection(size_t desiredAlignment, bool isIsolatedPadding = true,
+        size_t pageSize = 0x1000);
 
     virtual void execute();
 };
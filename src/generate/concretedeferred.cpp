@@ -1,4 +1,5 @@
 #include <cstring>  // for memset
+#include <algorithm>
 #include "concretedeferred.h"
 #include "section.h"
 #include "sectionlist.h"
@@ -6,7 +7,11 @@
 #include "elf/symbol.h"
 #include "chunk/function.h"
 #include "chunk/dataregion.h"
+#include "chunk/external.h"
+#include "chunk/plt.h"
 #include "chunk/link.h"
+#include "dwarf/entry.h"
+#include "dwarf/defines.h"
 #include "instr/instr.h"
 #include "instr/concrete.h"
 #include "log/log.h"
@@ -124,8 +129,7 @@ SymbolTableContent::DeferredType *SymbolTableContent
         if(contains(sit)) return find(sit);
     }
 
-    auto name = std::string(sym->getName());
-    auto index = strtab->add(name, true);  // add name to string table
+    auto index = strtab->addUnique(sym->getName());  // shares equal names
 
     ElfXX_Sym *symbol = new ElfXX_Sym();
     symbol->st_name = static_cast<ElfXX_Word>(index);
@@ -169,8 +173,7 @@ SymbolTableContent::DeferredType *SymbolTableContent
         if(contains(sit)) return find(sit);
     }
 
-    auto name = std::string(sym->getName());
-    auto index = strtab->add(name, true);  // add name to string table
+    auto index = strtab->addUnique(sym->getName());  // shares equal names
 
     ElfXX_Sym *symbol = new ElfXX_Sym();
     symbol->st_name = static_cast<ElfXX_Word>(index);
@@ -212,8 +215,7 @@ SymbolTableContent::DeferredType *SymbolTableContent
         if(contains(sit)) return find(sit);
     }
 
-    auto name = std::string(sym->getName());
-    auto index = strtab->add(name, true);  // add name to string table
+    auto index = strtab->addUnique(sym->getName());  // shares equal names
 
     ElfXX_Sym *symbol = new ElfXX_Sym();
     symbol->st_name = static_cast<ElfXX_Word>(index);
@@ -240,8 +242,7 @@ SymbolTableContent::DeferredType *SymbolTableContent
 SymbolTableContent::DeferredType *SymbolTableContent
     ::addPLTSymbol(PLTTrampoline *plt, Symbol *sym) {
 
-    auto name = std::string(sym->getName());
-    auto index = strtab->add(name, true);  // add name to string table
+    auto index = strtab->addUnique(sym->getName());  // shares equal names
 
     ElfXX_Sym *symbol = new ElfXX_Sym();
     symbol->st_name = static_cast<ElfXX_Word>(index);
@@ -266,6 +267,24 @@ SymbolTableContent::DeferredType *SymbolTableContent
     return addSymbol(nullptr, sym);
 }
 
+SymbolTableContent::DeferredType *SymbolTableContent
+    ::addExternalSymbol(ExternalSymbol *external) {
+
+    auto it = externalSymbols.find(external);
+    if(it != externalSymbols.end()) return (*it).second;
+
+    char *name = new char[external->getName().length() + 1];
+    std::strcpy(name, external->getName().c_str());
+    // an undefined symbol can't be local
+    auto bind = (external->getBind() == Symbol::BIND_WEAK)
+        ? Symbol::BIND_WEAK : Symbol::BIND_GLOBAL;
+    auto sym = new Symbol(0, 0, name, external->getType(), bind, 0, SHN_UNDEF);
+
+    auto value = addUndefinedSymbol(sym);
+    externalSymbols[external] = value;
+    return value;
+}
+
 size_t SymbolTableContent::indexOfSectionSymbol(const std::string &section,
     SectionList *sectionList) {
 
@@ -428,11 +447,11 @@ size_t PagePaddingContent::getSize() const {
 
     if(isIsolatedPadding) {
         // how much data is needed to round from lastByte to a page boundary?
-        size_t roundToPageBoundary = ((lastByte + PAGE_SIZE-1) & ~(PAGE_SIZE-1))
+        size_t roundToPageBoundary = ((lastByte + pageSize-1) & ~(pageSize-1))
             - lastByte;
         LOG(0, "desiredOffset = " << desiredOffset << ", got = "
-            << ((lastByte + (roundToPageBoundary + desiredOffset)) & (PAGE_SIZE-1)));
-        return (roundToPageBoundary + desiredOffset) & (PAGE_SIZE-1);
+            << ((lastByte + (roundToPageBoundary + desiredOffset)) & (pageSize-1)));
+        return (roundToPageBoundary + desiredOffset) & (pageSize-1);
     }
     else {
         static const address_t PAGE_SIZE = 0x1000;
@@ -447,6 +466,10 @@ void PagePaddingContent::writeTo(std::ostream &stream) {
     stream << std::string(getSize(), '\0');
 }
 
+void PagePaddingContent::writeInto(char *output) {
+    std::memset(output, 0, getSize());
+}
+
 Section *RelocSectionContent::getTargetSection() {
     return outer->get();
 }
@@ -474,7 +497,7 @@ RelocSectionContent::DeferredType *RelocSectionContent
     std::memset(rela, 0, sizeof(*rela));
     auto deferred = new DeferredType(rela);
 
-    auto address = source->getAddress();
+    auto address = source->getAddress() - base;
     int specialAddendOffset = 0;
 #ifdef ARCH_X86_64
     if(auto sem = dynamic_cast<LinkedInstruction *>(source->getSemantic())) {
@@ -528,18 +551,15 @@ RelocSectionContent::DeferredType *RelocSectionContent
 
     auto deferred = makeDeferredForLink(source);
 
-#if 0  // ExternalSymbol can no longer be converted to a Symbol
+    auto external = link->getPLTTrampoline()->getExternalSymbol();
+    if(!external) return deferred;
+
     auto symtab = (*sectionList)[".symtab"]->castAs<SymbolTableContent *>();
-    deferred->addFunction([this, symtab, link] (ElfXX_Rela *rela) {
-        auto sit = SymbolInTable(SymbolInTable::TYPE_UNDEF,
-            link->getPLTTrampoline()->getTargetSymbol());
-        auto elfSym = symtab->find(sit);
+    auto elfSym = symtab->addExternalSymbol(external);
+    deferred->addFunction([symtab, elfSym] (ElfXX_Rela *rela) {
         size_t index = symtab->indexOf(elfSym);
-        if(index == (size_t)-1) LOG(1, "ERROR with target "
-            << link->getPLTTrampoline()->getExternalSymbol()->getName());
         rela->r_info = ELFXX_R_INFO(index, R_X86_64_PLT32);
     });
-#endif
 
     return deferred;
 }
@@ -561,6 +581,41 @@ RelocSectionContent::DeferredType *RelocSectionContent
     return deferred;
 }
 
+RelocSectionContent::DeferredType *RelocSectionContent
+    ::addSectionRef(Instruction *source, Link *link,
+    const std::string &targetSection, address_t targetOffset) {
+
+    auto deferred = makeDeferredForLink(source);
+    auto rela = deferred->getElfPtr();
+
+    ElfXX_Word type = R_X86_64_PC32;
+    if(link->isAbsolute()) {
+        rela->r_addend = targetOffset;
+        type = R_X86_64_32S;
+#ifdef ARCH_X86_64
+        auto sem = dynamic_cast<LinkedInstruction *>(source->getSemantic());
+        if(sem && sem->getDispSize() == 8) type = R_X86_64_64;
+#endif
+    }
+    else {
+        rela->r_addend += targetOffset;
+#ifdef ARCH_X86_64
+        auto sem = dynamic_cast<ControlFlowInstruction *>(source->getSemantic());
+        if(sem && sem->getDisplacementSize() == 1) type = R_X86_64_PC8;
+#endif
+    }
+
+    auto symtab = (*sectionList)[".symtab"]->castAs<SymbolTableContent *>();
+    deferred->addFunction([this, symtab, targetSection, type]
+        (ElfXX_Rela *rela) {
+
+        size_t index = symtab->indexOfSectionSymbol(targetSection, sectionList);
+        rela->r_info = ELFXX_R_INFO(index, type);
+    });
+
+    return deferred;
+}
+
 Section *RelocSectionContent2::getTargetSection() {
     return other->get();
 }
@@ -720,6 +775,9 @@ DataRelocSectionContent::DeferredType *DataRelocSectionContent
 DataRelocSectionContent::DeferredType *DataRelocSectionContent
     ::addDataArbitraryRef(DataVariable *var, address_t targetAddress) {
 
+    // the data bytes already hold targetAddress, only the slide is left
+    if(relr && relr->add(var->getAddress())) return nullptr;
+
     auto rela = new ElfXX_Rela();
     std::memset(rela, 0, sizeof(*rela));
     auto deferred = new DeferredType(rela);
@@ -915,6 +973,67 @@ DynamicSectionContent::DeferredType *DynamicSectionContent
     return deferred;
 }
 
+bool RelrSectionContent::add(address_t address) {
+    if(address % sizeof(address_t) != 0) return false;
+    addressList.push_back(address);
+    dirty = true;
+    return true;
+}
+
+size_t RelrSectionContent::getSize() const {
+    return getEncoded().size() * sizeof(address_t);
+}
+
+void RelrSectionContent::writeTo(std::ostream &stream) {
+    for(auto word : getEncoded()) {
+        stream.write(reinterpret_cast<const char *>(&word), sizeof(word));
+    }
+}
+
+const std::vector<address_t> &RelrSectionContent::getEncoded() const {
+    if(dirty) {
+        auto self = const_cast<RelrSectionContent *>(this);
+        self->encoded = encode(addressList);
+        self->dirty = false;
+    }
+    return encoded;
+}
+
+std::vector<address_t> RelrSectionContent::encode(
+    std::vector<address_t> addressList) {
+
+    const size_t wordSize = sizeof(address_t);
+    const size_t bitmapBits = 8 * wordSize - 1;
+
+    std::sort(addressList.begin(), addressList.end());
+    addressList.erase(std::unique(addressList.begin(), addressList.end()),
+        addressList.end());
+
+    std::vector<address_t> encoded;
+    size_t i = 0;
+    while(i < addressList.size()) {
+        // an address entry relocates one word...
+        address_t base = addressList[i ++];
+        encoded.push_back(base);
+        base += wordSize;
+
+        // ...and each following bitmap covers the next 63 words
+        for(;;) {
+            address_t bitmap = 0;
+            while(i < addressList.size()) {
+                address_t delta = addressList[i] - base;
+                if(delta >= bitmapBits * wordSize || delta % wordSize) break;
+                bitmap |= address_t(1) << (delta / wordSize);
+                i ++;
+            }
+            if(!bitmap) break;
+            encoded.push_back((bitmap << 1) | 1);
+            base += bitmapBits * wordSize;
+        }
+    }
+    return encoded;
+}
+
 void InitArraySectionContent::writeTo(std::ostream &stream) {
     for(auto func : callbacks) {
         func();
@@ -927,6 +1046,164 @@ void InitArraySectionContent::writeTo(std::ostream &stream) {
     }
 }
 
+static void appendUleb128(std::string &buffer, uint64_t value) {
+    do {
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+        if(value) byte |= 0x80;
+        buffer.push_back(static_cast<char>(byte));
+    } while(value);
+}
+
+static void appendSleb128(std::string &buffer, int64_t value) {
+    bool more = true;
+    while(more) {
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+        if((value == 0 && !(byte & 0x40)) || (value == -1 && (byte & 0x40))) {
+            more = false;
+        }
+        else {
+            byte |= 0x80;
+        }
+        buffer.push_back(static_cast<char>(byte));
+    }
+}
+
+template <typename IntType>
+static void appendInteger(std::string &buffer, IntType value) {
+    buffer.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template <typename IntType>
+static void patchInteger(std::string &buffer, size_t offset, IntType value) {
+    std::memcpy(&buffer[offset], &value, sizeof(value));
+}
+
+void EhFrameContent::addCIE(DwarfCIE *cie,
+    std::function<address_t ()> personality) {
+
+    auto augmentation = cie->getAugmentation();
+    bool hasPersonality = augmentation
+        && augmentation->getPersonalityEncodingRoutine() != 0;
+    cieHasLsda = augmentation
+        && augmentation->getLsdaEnc() != DW_EH_PE_omit;
+
+    cieOffset = buffer.size();
+    appendInteger<uint32_t>(buffer, 0);  // length, patched below
+    appendInteger<uint32_t>(buffer, 0);  // CIE id
+    buffer.push_back(1);  // version
+
+    std::string augString = "z";
+    if(hasPersonality) augString += "P";
+    if(cieHasLsda) augString += "L";
+    augString += "R";
+    if(augmentation && augmentation->getIsSignal()) augString += "S";
+    buffer.append(augString.c_str(), augString.size() + 1);
+
+    appendUleb128(buffer, cie->getCodeAlignFactor());
+    appendSleb128(buffer, cie->getDataAlignFactor());
+    buffer.push_back(static_cast<char>(cie->getRetAddressReg()));
+
+    appendUleb128(buffer, (hasPersonality ? 5 : 0) + (cieHasLsda ? 1 : 0) + 1);
+    if(hasPersonality) {
+        // keep the indirection through DW.ref.* data pointers, if any
+        buffer.push_back(static_cast<char>(DW_EH_PE_pcrel | DW_EH_PE_sdata4
+            | (augmentation->getPersonalityEncoding() & DW_EH_PE_indirect)));
+        addPointer(personality);
+    }
+    if(cieHasLsda) buffer.push_back(DW_EH_PE_pcrel | DW_EH_PE_sdata4);
+    buffer.push_back(DW_EH_PE_pcrel | DW_EH_PE_sdata4);
+
+    addInstructions(cie->getInstructionStart(), cie->getInstructionEnd(),
+        cieOffset);
+}
+
+void EhFrameContent::addFDE(DwarfFDE *fde, Function *function,
+    address_t lsda) {
+
+    size_t offset = buffer.size();
+    appendInteger<uint32_t>(buffer, 0);  // length, patched below
+    appendInteger<uint32_t>(buffer, buffer.size() - cieOffset);
+    addPointer([function] () { return function->getAddress(); });
+    appendInteger<uint32_t>(buffer, function->getSize());
+
+    appendUleb128(buffer, cieHasLsda ? 4 : 0);
+    if(cieHasLsda) {
+        if(lsda) {
+            addPointer([lsda] () { return lsda; });
+        }
+        else {
+            appendInteger<int32_t>(buffer, 0);
+        }
+    }
+
+    addInstructions(fde->getInstructionStart(), fde->getInstructionEnd(),
+        offset);
+    fdeList.push_back(FDEEntry{function, offset});
+}
+
+void EhFrameContent::finish() {
+    appendInteger<uint32_t>(buffer, 0);
+}
+
+void EhFrameContent::addPointer(std::function<address_t ()> target) {
+    fixupList.push_back(Fixup{buffer.size(), target});
+    appendInteger<int32_t>(buffer, 0);
+}
+
+void EhFrameContent::addInstructions(address_t start, address_t end,
+    size_t entryStart) {
+
+    buffer.append(reinterpret_cast<const char *>(start), end - start);
+
+    // pad the entry with DW_CFA_nop to the address size
+    while((buffer.size() - entryStart) % sizeof(address_t)) {
+        buffer.push_back(DW_CFA_nop);
+    }
+    patchInteger<uint32_t>(buffer, entryStart,
+        buffer.size() - entryStart - sizeof(uint32_t));
+}
+
+void EhFrameContent::writeTo(std::ostream &stream) {
+    address_t base = section->getHeader()->getAddress();
+    for(const auto &fixup : fixupList) {
+        int64_t value = fixup.target() - (base + fixup.offset);
+        if(value != static_cast<int32_t>(value)) {
+            LOG(0, "WARNING: .eh_frame pointer to 0x" << std::hex
+                << fixup.target() << " does not fit in 32 bits");
+        }
+        patchInteger<int32_t>(buffer, fixup.offset, value);
+    }
+    stream << buffer;
+}
+
+void EhFrameHdrContent::writeTo(std::ostream &stream) {
+    address_t base = section->getHeader()->getAddress();
+    address_t ehFrameAddress = ehFrame->getSection()->getHeader()->getAddress();
+
+    std::string buffer;
+    buffer.push_back(1);  // version
+    buffer.push_back(DW_EH_PE_pcrel | DW_EH_PE_sdata4);  // eh_frame_ptr
+    buffer.push_back(DW_EH_PE_udata4);  // fde_count
+    buffer.push_back(DW_EH_PE_datarel | DW_EH_PE_sdata4);  // table
+    appendInteger<int32_t>(buffer, ehFrameAddress - (base + 4));
+    appendInteger<uint32_t>(buffer, ehFrame->getFDEList().size());
+
+    std::vector<std::pair<address_t, address_t>> table;
+    table.reserve(ehFrame->getFDEList().size());
+    for(const auto &entry : ehFrame->getFDEList()) {
+        table.emplace_back(entry.function->getAddress(),
+            ehFrameAddress + entry.offset);
+    }
+    std::sort(table.begin(), table.end());
+    for(const auto &pair : table) {
+        appendInteger<int32_t>(buffer, pair.first - base);
+        appendInteger<int32_t>(buffer, pair.second - base);
+    }
+    stream << buffer;
+}
+
 /*
     Example PLT:
 0000000000000610 <.plt>:
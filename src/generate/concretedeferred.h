@@ -2,6 +2,7 @@
 #define EGALITO_GENERATE_CONCRETE_DEFERRED_H
 
 #include <vector>
+#include <map>
 #include "deferred.h"
 #include "integerdeferred.h"
 #include "chunk/link.h"
@@ -17,6 +18,7 @@ class Instruction;
 class ElfSpace;
 class Chunk;
 class SectionList;
+class ExternalSymbol;
 
 class SymbolInTable {
 public:
@@ -51,6 +53,7 @@ public:
 private:
     DeferredStringList *strtab;
     std::vector<DeferredType *> sectionSymbols;
+    std::map<ExternalSymbol *, DeferredType *> externalSymbols;
     int firstGlobalIndex;
 public:
     SymbolTableContent(DeferredStringList *strtab)
@@ -65,6 +68,8 @@ public:
         address_t address, size_t section = SHN_UNDEF);
     DeferredType *addPLTSymbol(PLTTrampoline *plt, Symbol *sym);
     DeferredType *addUndefinedSymbol(Symbol *sym);
+    /** Returns the same undefined symbol for every use of external. */
+    DeferredType *addExternalSymbol(ExternalSymbol *external);
 
     size_t indexOfSectionSymbol(const std::string &section,
         SectionList *sectionList);
@@ -115,20 +120,23 @@ public:
 };
 
 class PagePaddingContent : public DeferredValue {
-private:
-    //static const address_t PAGE_SIZE = 0x200000;
+public:
     static const address_t PAGE_SIZE = 0x1000;
+    static const address_t HUGE_PAGE_SIZE = 0x200000;
 private:
     Section *previousSection;
     address_t desiredOffset;
     bool isIsolatedPadding;  // true if data outside map region should be null
+    address_t pageSize;     // only for isolated padding
 public:
     PagePaddingContent(Section *previousSection, address_t desiredOffset = 0,
-        bool isIsolatedPadding = true) : previousSection(previousSection),
-        desiredOffset(desiredOffset), isIsolatedPadding(isIsolatedPadding) {}
+        bool isIsolatedPadding = true, address_t pageSize = PAGE_SIZE)
+        : previousSection(previousSection), desiredOffset(desiredOffset),
+        isIsolatedPadding(isIsolatedPadding), pageSize(pageSize) {}
 
     virtual size_t getSize() const;
     virtual void writeTo(std::ostream &stream);
+    virtual void writeInto(char *output);
 };
 
 class RelocSectionContent : public DeferredMap<address_t, ElfXX_Rela> {
@@ -138,14 +146,20 @@ private:
     SectionRef *outer;
     SectionList *sectionList;
     ElfSpace *elfSpace;
+    address_t base;  // address of the start of outer
 public:
     RelocSectionContent(SectionRef *outer, SectionList *sectionList,
-        ElfSpace *elfSpace) : outer(outer), sectionList(sectionList),
-        elfSpace(elfSpace) {}
+        ElfSpace *elfSpace, address_t base = 0) : outer(outer),
+        sectionList(sectionList), elfSpace(elfSpace), base(base) {}
 
     Section *getTargetSection();
 
     DeferredType *add(Chunk *source, Link *link);
+    /** Relocation against the section symbol of targetSection, for links
+        into code that the linker may move, e.g. another function's section.
+    */
+    DeferredType *addSectionRef(Instruction *source, Link *link,
+        const std::string &targetSection, address_t targetOffset);
 private:
     DeferredType *makeDeferredForLink(Instruction *source);
     DeferredType *addConcrete(Instruction *source, DataOffsetLink *link);
@@ -170,6 +184,31 @@ public:
         DataSection *targetSection);
 };
 
+/** Relative relocations in the compact SHT_RELR encoding: each address
+    word is followed by bitmap words marking which of the next 63 words
+    also need the load base added. The words being relocated must already
+    hold their link-time values.
+*/
+class RelrSectionContent : public DeferredValue {
+private:
+    std::vector<address_t> addressList;
+    std::vector<address_t> encoded;
+    bool dirty;
+public:
+    RelrSectionContent() : dirty(false) {}
+
+    /** Returns false if address can't be expressed (i.e. is unaligned). */
+    bool add(address_t address);
+    size_t getCount() const { return addressList.size(); }
+
+    virtual size_t getSize() const;
+    virtual void writeTo(std::ostream &stream);
+
+    static std::vector<address_t> encode(std::vector<address_t> addressList);
+private:
+    const std::vector<address_t> &getEncoded() const;
+};
+
 class DataVariable;
 class DataRelocSectionContent : public DeferredMap<address_t, ElfXX_Rela> {
 public:
@@ -177,12 +216,18 @@ public:
 private:
     SectionRef *outer;
     SectionList *sectionList;
+    RelrSectionContent *relr;
 public:
     DataRelocSectionContent(SectionRef *outer, SectionList *sectionList)
-        : outer(outer), sectionList(sectionList) {}
+        : outer(outer), sectionList(sectionList), relr(nullptr) {}
 
     Section *getTargetSection();
 
+    /** When set, relative relocations go into relr instead (prelinking),
+        and the add functions for them return nullptr.
+    */
+    void setRelr(RelrSectionContent *relr) { this->relr = relr; }
+
     DeferredType *addUndefinedRef(DataVariable *var,
         const std::string &targetName);
     DeferredType *addDataRef(address_t source, address_t target,
@@ -234,6 +279,61 @@ public:
     virtual void writeTo(std::ostream &stream);
 };
 
+class DwarfCIE;
+class DwarfFDE;
+
+/** Regenerated .eh_frame. Entries are copied from the input modules, but
+    every pointer is re-encoded as pcrel|sdata4 against the output layout.
+*/
+class EhFrameContent : public DeferredValue {
+public:
+    struct FDEEntry {
+        Function *function;
+        size_t offset;
+    };
+private:
+    struct Fixup {
+        size_t offset;
+        std::function<address_t ()> target;
+    };
+    Section *section;
+    std::string buffer;
+    std::vector<Fixup> fixupList;
+    std::vector<FDEEntry> fdeList;
+    size_t cieOffset;
+    bool cieHasLsda;
+public:
+    EhFrameContent(Section *section)
+        : section(section), cieOffset(0), cieHasLsda(false) {}
+
+    /** Starts a new CIE; FDEs added afterwards refer to it. */
+    void addCIE(DwarfCIE *cie, std::function<address_t ()> personality);
+    void addFDE(DwarfFDE *fde, Function *function, address_t lsda);
+    void finish();  // appends the zero terminator
+
+    const std::vector<FDEEntry> &getFDEList() const { return fdeList; }
+    Section *getSection() const { return section; }
+    virtual size_t getSize() const { return buffer.size(); }
+    virtual void writeTo(std::ostream &stream);
+private:
+    void addPointer(std::function<address_t ()> target);
+    void addInstructions(address_t start, address_t end, size_t entryStart);
+};
+
+/** Binary search table over EhFrameContent, sorted by new function address. */
+class EhFrameHdrContent : public DeferredValue {
+private:
+    Section *section;
+    EhFrameContent *ehFrame;
+public:
+    EhFrameHdrContent(Section *section, EhFrameContent *ehFrame)
+        : section(section), ehFrame(ehFrame) {}
+
+    virtual size_t getSize() const
+        { return 12 + 8 * ehFrame->getFDEList().size(); }
+    virtual void writeTo(std::ostream &stream);
+};
+
 #ifdef ARCH_X86_64
 struct PLTCodeEntry {
     char data[16];
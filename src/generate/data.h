@@ -50,19 +50,26 @@ private:
     bool positionIndependent;
     bool unionOutput;
     bool freestandingKernel;
+    bool hugePageText;  // align code to 2MB, for transparent huge pages
+    bool relrRelocs;    // relative relocations applied, slides via RELR
 public:
     ElfConfig() : dynamicallyLinked(false), positionIndependent(false),
-        unionOutput(false), freestandingKernel(false) {}
+        unionOutput(false), freestandingKernel(false), hugePageText(false),
+        relrRelocs(false) {}
 
     void setDynamicallyLinked(bool enable) { dynamicallyLinked = enable; }
     void setPositionIndependent(bool enable) { positionIndependent = enable; }
     void setUnionOutput(bool enable) { unionOutput = enable; }
     void setFreestandingKernel(bool enable) { freestandingKernel = enable; }
+    void setHugePageText(bool enable) { hugePageText = enable; }
+    void setRelrRelocs(bool enable) { relrRelocs = enable; }
 
     bool isDynamicallyLinked() const { return dynamicallyLinked; }
     bool isPositionIndependent() const { return positionIndependent; }
     bool isUnionOutput() const { return unionOutput; }
     bool isFreestandingKernel() const { return freestandingKernel; }
+    bool isHugePageText() const { return hugePageText; }
+    bool useRelrRelocs() const { return relrRelocs; }
 };
 
 class ElfOperationTrace {
@@ -6,6 +6,8 @@
 #include <unistd.h>
 #include <sys/mman.h>
 
+#include <cstdio>  // for rename
+#include <cstdlib>  // for atexit
 #include "debugelf.h"
 #include "chunk/concrete.h"  // for Function
 
@@ -29,6 +31,11 @@ DebugElf::DebugElf() {
 
     start = -1;
     end = 0;
+
+    symbols_written = 0;
+    strtable_written = 0;
+    symbols_reserved = 0;
+    strtable_reserved = 0;
 }
 
 DebugElf::~DebugElf() {
@@ -103,83 +110,173 @@ void DebugElf::add(Function *func, const char *suffix) {
 }
 
 void DebugElf::writeTo(int fd) {
+    // leave room to append as many symbols again, see append()
+    symbols_reserved = 2 * symbols_used * sizeof(ElfXX_Sym) + 0x1000;
+    strtable_reserved = 2 * strtable_used + 0x1000;
+
+    symbols_written = 0;
+    strtable_written = 0;
+    append(fd);
+}
+
+void DebugElf::append(int fd) {
+    if(symbols_used * sizeof(ElfXX_Sym) > symbols_reserved
+        || strtable_used > strtable_reserved) {
+
+        writeTo(fd);
+        return;
+    }
+
+    // the gaps between the tables are holes in the file until used
+    const off_t symbols_offset = sizeof(ElfXX_Ehdr) + 4*sizeof(ElfXX_Shdr);
+    const off_t strtable_offset = symbols_offset + symbols_reserved;
+    (void)pwrite(fd, symbols + symbols_written,
+        (symbols_used - symbols_written)*sizeof(ElfXX_Sym),
+        symbols_offset + symbols_written*sizeof(ElfXX_Sym));
+    (void)pwrite(fd, strtable + strtable_written,
+        strtable_used - strtable_written,
+        strtable_offset + strtable_written);
+    symbols_written = symbols_used;
+    strtable_written = strtable_used;
+
+    // then the headers, so that readers never see a size too large
+    writeHeaders(fd, symbols_offset, strtable_offset);
+}
+
+void DebugElf::writeHeaders(int fd, unsigned long symbols_offset,
+    unsigned long strtable_offset) {
+
+    char headers[sizeof(ElfXX_Ehdr) + 4*sizeof(ElfXX_Shdr)];
+    for(size_t i = 0; i < sizeof(headers); i ++) headers[i] = 0;
+
     // build ELF header
-    ElfXX_Ehdr ehdr;
+    ElfXX_Ehdr *ehdr = (ElfXX_Ehdr *)headers;
     // sensible defaults
     const unsigned char ident[] = {0x7f, 0x45, 0x4c, 0x46, 0x02, 0x01, 0x01,
         0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
-    for(size_t i = 0; i < EI_NIDENT; i ++) ehdr.e_ident[i] = ident[i];
-
-    ehdr.e_type = ET_EXEC;
-    ehdr.e_machine = EM_386;
-    ehdr.e_version = EV_CURRENT;
-    ehdr.e_entry = 0;
-    ehdr.e_phoff = 0; // one program header, NULL
-    ehdr.e_shoff = sizeof(ElfXX_Ehdr); // section head go right after elf head
-    ehdr.e_flags = 0;
-    ehdr.e_ehsize = sizeof(ElfXX_Ehdr);
-    ehdr.e_phentsize = sizeof(ElfXX_Phdr);
-    ehdr.e_phnum = 0; // one NULL program header
-    ehdr.e_shentsize = sizeof(ElfXX_Shdr);
+    for(size_t i = 0; i < EI_NIDENT; i ++) ehdr->e_ident[i] = ident[i];
+
+    ehdr->e_type = ET_EXEC;
+    ehdr->e_machine = EM_386;
+    ehdr->e_version = EV_CURRENT;
+    ehdr->e_entry = 0;
+    ehdr->e_phoff = 0; // one program header, NULL
+    ehdr->e_shoff = sizeof(ElfXX_Ehdr); // section head go right after elf head
+    ehdr->e_flags = 0;
+    ehdr->e_ehsize = sizeof(ElfXX_Ehdr);
+    ehdr->e_phentsize = sizeof(ElfXX_Phdr);
+    ehdr->e_phnum = 0; // one NULL program header
+    ehdr->e_shentsize = sizeof(ElfXX_Shdr);
     // NULL section + symbols + string table + text section
-    ehdr.e_shnum = 4;
-    ehdr.e_shstrndx = 2;
-
-    (void)write(fd, &ehdr, sizeof(ehdr));
-
-    // build section headers
-    ElfXX_Shdr shdr;
-    for(size_t i = 0; i < sizeof(ElfXX_Shdr); i ++) {
-        ((char *)&shdr)[i] = 0;
-    }
-    (void)write(fd, &shdr, sizeof(shdr));
-
-    shdr.sh_name = 1; // .symtab
-    shdr.sh_type = SHT_SYMTAB;
-    shdr.sh_flags = 0;
-    shdr.sh_addr = 0;
-    shdr.sh_offset = sizeof(ElfXX_Ehdr) + 4*sizeof(ElfXX_Shdr);
-    shdr.sh_size = symbols_used * sizeof(ElfXX_Sym);
-    shdr.sh_link = 2;
-    shdr.sh_info = 0; // all symbols global
-    shdr.sh_addralign = 1;
-    shdr.sh_entsize = sizeof(ElfXX_Sym);
-    (void)write(fd, &shdr, sizeof(shdr));
-
-    shdr.sh_name = 9; // .strtab
-    shdr.sh_type = SHT_STRTAB;
-    shdr.sh_offset += shdr.sh_size;
-    shdr.sh_size = strtable_used;
-    shdr.sh_link = 0;
-    shdr.sh_entsize = 0;
-    (void)write(fd, &shdr, sizeof(shdr));
-
-    shdr.sh_name = 17; // .text
-    shdr.sh_type = SHT_NOBITS;
-    shdr.sh_offset = 0;
-
-    end += start;
-    start = 0;  // symbol values are added to this, make math easy
-    end = (end + 0xfffff) & ~0xfffff;  // round end up
-    shdr.sh_addr = start;  // 0
-    shdr.sh_size = end - start;  // end
-
-    shdr.sh_link = 0;
-    shdr.sh_entsize = 0;
-    shdr.sh_flags = SHF_ALLOC | SHF_EXECINSTR;
-    shdr.sh_addralign = 1;
-    (void)write(fd, &shdr, sizeof(shdr));
-
-    (void)write(fd, symbols,
-        symbols_used*sizeof(ElfXX_Sym));
-    (void)write(fd, strtable, strtable_used);
+    ehdr->e_shnum = 4;
+    ehdr->e_shstrndx = 2;
+
+    // build section headers, after the NULL one
+    ElfXX_Shdr *shdr = (ElfXX_Shdr *)(headers + sizeof(ElfXX_Ehdr)) + 1;
+
+    shdr->sh_name = 1; // .symtab
+    shdr->sh_type = SHT_SYMTAB;
+    shdr->sh_flags = 0;
+    shdr->sh_addr = 0;
+    shdr->sh_offset = symbols_offset;
+    shdr->sh_size = symbols_used * sizeof(ElfXX_Sym);
+    shdr->sh_link = 2;
+    shdr->sh_info = 0; // all symbols global
+    shdr->sh_addralign = 1;
+    shdr->sh_entsize = sizeof(ElfXX_Sym);
+    shdr ++;
+
+    shdr->sh_name = 9; // .strtab
+    shdr->sh_type = SHT_STRTAB;
+    shdr->sh_offset = strtable_offset;
+    shdr->sh_size = strtable_used;
+    shdr->sh_addralign = 1;
+    shdr ++;
+
+    shdr->sh_name = 17; // .text
+    shdr->sh_type = SHT_NOBITS;
+    shdr->sh_offset = 0;
+
+    // symbol values are added to start, so make it 0 to make math easy
+    unsigned long text_end = (start + end + 0xfffff) & ~0xfffff;
+    shdr->sh_addr = 0;
+    shdr->sh_size = text_end;
+
+    shdr->sh_flags = SHF_ALLOC | SHF_EXECINSTR;
+    shdr->sh_addralign = 1;
+
+    (void)pwrite(fd, headers, sizeof(headers), 0);
 }
 
 void DebugElf::writeTo(const char *filename) {
-    int fd = open(filename, O_WRONLY | O_CREAT, S_IRUSR | S_IWUSR);
+    int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
     if(fd == -1) return;
 
     writeTo(fd);
 
     close(fd);
 }
+
+DebugElfWriter *DebugElfWriter::instance = nullptr;
+
+DebugElfWriter::DebugElfWriter(const char *filename, const char *suffix)
+    : elf(nullptr), filename(filename), suffix(suffix), fd(-1) {
+
+}
+
+void DebugElfWriter::start(Program *program, const char *filename,
+    const char *suffix) {
+
+    // never destroyed, the JIT-shuffling runtime keeps adding entries
+    if(instance) instance->wait();
+    else {
+        instance = new DebugElfWriter(filename, suffix);
+        std::atexit(&DebugElfWriter::waitAtExit);
+    }
+    auto writer = instance;
+
+    // the snapshot: names and addresses are copied before returning
+    auto elf = new DebugElf();
+    for(auto module : CIter::modules(program)) {
+        for(auto func : CIter::functions(module)) {
+            elf->add(func, suffix);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(writer->mutex);
+        delete writer->elf;
+        writer->elf = elf;
+        writer->filename = filename;
+        writer->suffix = suffix;
+    }
+
+    writer->thread = std::thread(&DebugElfWriter::writeSnapshot, writer);
+}
+
+void DebugElfWriter::writeSnapshot() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(fd >= 0) close(fd);
+
+    // readers see either the old file or all of the new one
+    std::string temporary = filename + ".tmp";
+    fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+        S_IRUSR | S_IWUSR);
+    if(fd < 0) return;
+    elf->writeTo(fd);
+    std::rename(temporary.c_str(), filename.c_str());
+}
+
+void DebugElfWriter::add(Function *function) {
+    std::lock_guard<std::mutex> lock(mutex);
+    elf->add(function, suffix.c_str());
+    if(fd >= 0) elf->append(fd);
+}
+
+void DebugElfWriter::wait() {
+    if(thread.joinable()) thread.join();
+}
+
+void DebugElfWriter::waitAtExit() {
+    instance->wait();
+}
@@ -3,8 +3,12 @@
 
 #include <stddef.h>
 #include <elf.h>
+#include <mutex>
+#include <string>
+#include <thread>
 #include "elf/elfxx.h"
 
+class Program;
 class Function;
 
 /** Ported from Shuffler. Originally written by Kent.
@@ -19,15 +23,57 @@ private:
     char *strtable;
     size_t strtable_size, strtable_used;
     unsigned long start, end;
+    // what is in the file, and the room it has for each table
+    size_t symbols_written, strtable_written;
+    size_t symbols_reserved, strtable_reserved;
 public:
     DebugElf();
     ~DebugElf();
 
     void writeTo(int fd);
     void writeTo(const char *filename);
+    /** Writes only the symbols added since fd was last written, then the
+        headers. Falls back to writeTo(fd) once the room left for more
+        symbols by writeTo() is used up. */
+    void append(int fd);
 
     void add(unsigned long address, unsigned long size, const char *name);
     void add(Function *func, const char *suffix);
+private:
+    void writeHeaders(int fd, unsigned long symbols_offset,
+        unsigned long strtable_offset);
+};
+
+/** Keeps a debug ELF (symbols.elf) up to date while code moves. start()
+    takes a snapshot of the function addresses and writes it on a
+    background thread, so the loader doesn't wait for it; add() appends a
+    re-placed function, e.g. from JIT shuffling, in place.
+
+    The file is renamed into place once complete. Exiting normally waits
+    for it, but a program run by the loader that exits right away may not.
+*/
+class DebugElfWriter {
+private:
+    static DebugElfWriter *instance;
+    DebugElf *elf;
+    std::string filename;
+    std::string suffix;
+    int fd;
+    std::mutex mutex;
+    std::thread thread;
+public:
+    /** Returns nullptr until start() is called. */
+    static DebugElfWriter *getInstance() { return instance; }
+    static void start(Program *program, const char *filename,
+        const char *suffix);
+
+    void add(Function *function);
+    /** Waits until the first write is done. */
+    void wait();
+private:
+    DebugElfWriter(const char *filename, const char *suffix);
+    void writeSnapshot();
+    static void waitAtExit();
 };
 
 #endif
@@ -1,5 +1,5 @@
 #include <ostream>
-#include <cstring>  // for strlen
+#include <cstring>  // for strlen, memcpy
 #include "deferred.h"
 #include "log/log.h"
 
@@ -8,6 +8,13 @@ std::ostream &operator << (std::ostream &stream, DeferredValue &dv) {
     return stream;
 }
 
+void DeferredValue::writeInto(char *output) {
+    std::ostringstream stream;
+    writeTo(stream);
+    auto data = stream.str();
+    std::memcpy(output, data.data(), data.length());
+}
+
 void DeferredValueCString::writeTo(std::ostream &stream) {
     LOG0(10, "writing " << getSize() << " bytes:");
     for(size_t i = 0; i < getSize(); i ++) {
@@ -17,6 +24,10 @@ void DeferredValueCString::writeTo(std::ostream &stream) {
     stream.write(getPtr(), getSize());
 }
 
+void DeferredValueCString::writeInto(char *output) {
+    std::memcpy(output, getPtr(), getSize());
+}
+
 size_t DeferredStringList::add(const std::string &data, bool withNull) {
     size_t oldIndex = output.length();
     size_t len = data.length();
@@ -25,6 +36,15 @@ size_t DeferredStringList::add(const std::string &data, bool withNull) {
     return oldIndex;
 }
 
+size_t DeferredStringList::addUnique(const std::string &str) {
+    auto it = uniqueMap.find(str);
+    if(it != uniqueMap.end()) return (*it).second;
+
+    size_t index = add(str, true);
+    uniqueMap[str] = index;
+    return index;
+}
+
 size_t DeferredStringList::add(const char *str, bool withNull) {
     size_t oldIndex = output.length();
     size_t len = std::strlen(str);
@@ -4,19 +4,28 @@
 #include <iostream>  // for debugging
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <string>
 #include <functional>
 #include <algorithm>
 #include <sstream>
+#include <cstring>  // for memcpy
 #include "types.h"
 
 /** Base class for any output value which may need further computation.
+
+    Output is produced in two phases: getSize() is used to lay everything
+    out, then writeInto() fills in each value at its place in one buffer.
 */
 class DeferredValue {
 public:
     virtual ~DeferredValue() {}
     virtual size_t getSize() const = 0;
     virtual void writeTo(std::ostream &stream) = 0;
+    /** Writes exactly getSize() bytes to output. By default this goes
+        through writeTo(std::ostream &); large values should override it.
+    */
+    virtual void writeInto(char *output);
 };
 
 std::ostream &operator << (std::ostream &stream, DeferredValue &dv);
@@ -24,6 +33,7 @@ std::ostream &operator << (std::ostream &stream, DeferredValue &dv);
 class DeferredValueCString : public DeferredValue {
 public:
     virtual void writeTo(std::ostream &stream);
+    virtual void writeInto(char *output);
 protected:
     virtual const char *getPtr() const = 0;
 };
@@ -44,6 +54,7 @@ public:
     ElfType *getElfPtr() const { return elfValue; }
     virtual size_t getSize() const { return sizeof(ElfType); }
     virtual void writeTo(std::ostream &stream);
+    virtual void writeInto(char *output);
 
     // basic operators to allow this type to be a key in a std::map
     bool operator < (const DeferredValueImpl<ElfType> &other) const
@@ -53,14 +64,27 @@ public:
 protected:
     virtual const char *getPtr() const
         { return reinterpret_cast<const char *>(elfValue); }
+private:
+    void applyFunctions();
 };
 
 template <typename ElfType>
 void DeferredValueImpl<ElfType>::writeTo(std::ostream &stream) {
-    for(auto func : functionList) {
+    applyFunctions();
+    DeferredValueCString::writeTo(stream);
+}
+
+template <typename ElfType>
+void DeferredValueImpl<ElfType>::writeInto(char *output) {
+    applyFunctions();
+    std::memcpy(output, elfValue, sizeof(ElfType));
+}
+
+template <typename ElfType>
+void DeferredValueImpl<ElfType>::applyFunctions() {
+    for(auto &func : functionList) {
         func(elfValue);
     }
-    DeferredValueCString::writeTo(stream);
 }
 
 /** Base class for list of deferred values. */
@@ -86,6 +110,9 @@ public:
 
     virtual size_t getSize() const;
     virtual void writeTo(std::ostream &stream);
+    virtual void writeInto(char *output);
+protected:
+    ValueListType &getValueList() { return valueList; }
 };
 
 // This getSize implementation assumes that VType is itself a DeferredValue,
@@ -105,19 +132,33 @@ void DeferredListBase<VType>::writeTo(std::ostream &stream) {
     }
 }
 
+template <typename VType>
+void DeferredListBase<VType>::writeInto(char *output) {
+    for(auto value : valueList) {
+        value->writeInto(output);
+        output += value->getSize();
+    }
+}
+
+/** Adds lookup by key. Values added with insertSorted() are kept aside
+    and merged into the list in one sort the next time the list is read,
+    so building a large sorted table is O(n log n) rather than O(n^2).
+*/
 template <typename BaseType, typename KeyType>
 class DeferredListMapDecorator : public BaseType {
 public:
     typedef typename BaseType::ValueType ValueType;
+    typedef typename BaseType::IteratorType IteratorType;
 private:
     typedef std::map<KeyType, ValueType> ValueMapType;
     typedef std::map<ValueType, KeyType> ReverseMapType;
     ValueMapType valueMap;
     ReverseMapType reverseMap;
+    std::vector<std::pair<KeyType, ValueType>> pending;
 public:
     void add(KeyType key, ValueType value)
-        { BaseType::add(value); valueMap[key] = value; reverseMap[value] = key; }
-    void insertAt(typename BaseType::IteratorType it, KeyType key, ValueType value)
+        { sortPending(); BaseType::add(value); valueMap[key] = value; reverseMap[value] = key; }
+    void insertAt(IteratorType it, KeyType key, ValueType value)
         { BaseType::insertAt(it, value); valueMap[key] = value; reverseMap[value] = key; }
     bool insertSorted(KeyType key, ValueType value);
     bool contains(KeyType key) const
@@ -125,29 +166,68 @@ public:
     ValueType find(KeyType key) { return valueMap[key]; }
     KeyType getKey(ValueType value) { return reverseMap[value]; }
     const ValueMapType& getValueMap() const { return valueMap; }
-    virtual void clearAll() { valueMap.clear(); reverseMap.clear(); BaseType::clearAll(); }
+    virtual void clearAll()
+        { valueMap.clear(); reverseMap.clear(); pending.clear(); BaseType::clearAll(); }
+
+    // everything that observes the order sorts pending values in first
+    IteratorType begin() { sortPending(); return BaseType::begin(); }
+    IteratorType end() { sortPending(); return BaseType::end(); }
+    size_t getCount() const { return BaseType::getCount() + pending.size(); }
+    size_t indexOf(ValueType value)
+        { sortPending(); return BaseType::indexOf(value); }
+    void recalculateIndices()
+        { sortPending(); BaseType::recalculateIndices(); }
+    virtual size_t getSize() const
+        { const_cast<DeferredListMapDecorator *>(this)->sortPending();
+            return BaseType::getSize(); }
+    virtual void writeTo(std::ostream &stream)
+        { sortPending(); BaseType::writeTo(stream); }
+    virtual void writeInto(char *output)
+        { sortPending(); BaseType::writeInto(output); }
+private:
+    void sortPending();
 };
 
 template <typename BaseType, typename KeyType>
 bool DeferredListMapDecorator<BaseType, KeyType>
     ::insertSorted(KeyType key, ValueType value) {
 
-    //std::cout << "inserting " << key.getName() << "\n";
-
     if(contains(key)) return false;
 
     valueMap[key] = value;
     reverseMap[value] = key;
+    pending.push_back(std::make_pair(key, value));
+    return true;
+}
 
-    auto it = std::upper_bound(this->begin(), this->end(), value,
-        [this] (const ValueType &a, const ValueType &b) {
-            /*std::cout << "    " << getKey(a).getName()
-                << " vs " << getKey(b).getName() << "\n";*/
-            return getKey(a) < getKey(b);
+template <typename BaseType, typename KeyType>
+void DeferredListMapDecorator<BaseType, KeyType>::sortPending() {
+    if(pending.empty()) return;
+
+    // stable, and existing values come first among equal keys, exactly as
+    // if each value had been inserted at its upper bound in turn
+    std::stable_sort(pending.begin(), pending.end(),
+        [] (const std::pair<KeyType, ValueType> &a,
+            const std::pair<KeyType, ValueType> &b) {
+
+            return a.first < b.first;
         });
-    //std::cout << "insert at index " << it - this->begin() << "\n";
-    BaseType::insertAt(it, value);
-    return true;
+
+    auto &list = this->getValueList();
+    typename BaseType::ValueListType merged;
+    merged.reserve(list.size() + pending.size());
+    auto it = list.begin();
+    for(const auto &p : pending) {
+        while(it != list.end() && !(p.first < reverseMap[*it])) {
+            merged.push_back(*it++);
+        }
+        merged.push_back(p.second);
+    }
+    merged.insert(merged.end(), it, list.end());
+
+    list.swap(merged);
+    pending.clear();
+    BaseType::recalculateIndices();
 }
 
 template <typename BaseType>
@@ -206,12 +286,39 @@ protected:
     virtual const char *getPtr() const { return value.c_str(); }
 };
 
+/** Refers to bytes owned elsewhere (code backing, DataRegion contents)
+    rather than copying them, so large sections are not duplicated in
+    memory before being written out. The referenced bytes must stay alive
+    and unchanged until the ELF has been written.
+*/
+class DeferredStringView : public DeferredValueCString {
+private:
+    const char *data;
+    size_t length;
+public:
+    DeferredStringView(const char *data, size_t length)
+        : data(data), length(length) {}
+    /** Views at most length bytes of value, starting at offset. */
+    DeferredStringView(const std::string &value, size_t offset, size_t length)
+        : data(value.data() + std::min(offset, value.length())),
+        length(std::min(length, value.length() - std::min(offset,
+            value.length()))) {}
+    virtual size_t getSize() const { return length; }
+protected:
+    virtual const char *getPtr() const { return data; }
+};
+
 class DeferredStringList : public DeferredValueCString {
 private:
     std::string output;
+    std::unordered_map<std::string, size_t> uniqueMap;
 public:
     size_t add(const std::string &data, bool withNull = false);
     size_t add(const char *str, bool withNull = false);
+    /** Adds str with a null terminator, unless an identical string was
+        already added this way, in which case its index is returned.
+    */
+    size_t addUnique(const std::string &str);
     virtual size_t getSize() const { return output.length(); }
 protected:
     virtual const char *getPtr() const { return output.c_str(); }
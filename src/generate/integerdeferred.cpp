@@ -1,21 +1,18 @@
+#include <cstring>  // for memcpy
 #include "integerdeferred.h"
 
 void DeferredIntegerList::add(uint32_t value) {
-    std::string str{reinterpret_cast<char *>(&value), sizeof(value)};
-    stream << str;
+    data.append(reinterpret_cast<char *>(&value), sizeof(value));
 }
 
 void DeferredIntegerList::add(uint64_t value) {
-    std::string str{reinterpret_cast<char *>(&value), sizeof(value)};
-    stream << str;
+    data.append(reinterpret_cast<char *>(&value), sizeof(value));
 }
 
-size_t DeferredIntegerList::getSize() const {
-    auto data = this->stream.str();
-    return data.length();
+void DeferredIntegerList::writeTo(std::ostream &stream) {
+    stream.write(data.data(), data.length());
 }
 
-void DeferredIntegerList::writeTo(std::ostream &stream) {
-    auto data = this->stream.str();
-    stream << data;
+void DeferredIntegerList::writeInto(char *output) {
+    std::memcpy(output, data.data(), data.length());
 }
@@ -1,17 +1,18 @@
 #ifndef EGALITO_GENERATE_INTEGER_DEFERRED_H
 #define EGALITO_GENERATE_INTEGER_DEFERRED_H
 
-#include <sstream>
+#include <string>
 #include "deferred.h"
 
 class DeferredIntegerList : public DeferredValue {
 private:
-    std::ostringstream stream;
+    std::string data;
 public:
     void add(uint32_t value);
     void add(uint64_t value);
-    virtual size_t getSize() const;
+    virtual size_t getSize() const { return data.length(); }
     virtual void writeTo(std::ostream &stream);
+    virtual void writeInto(char *output);
 };
 
 #endif
@@ -0,0 +1,210 @@
+#include <cstdio>  // for std::remove
+#include <fstream>
+#include <typeinfo>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "layoutmanifest.h"
+#include "chunk/concrete.h"
+#include "instr/semantic.h"
+#include "transform/sandbox.h"
+#include "log/log.h"
+
+static const char *MANIFEST_SIGNATURE = "egalito-layout 1";
+
+// 64-bit FNV-1a
+class LayoutHash {
+private:
+    uint64_t value;
+public:
+    LayoutHash() : value(0xcbf29ce484222325ull) {}
+
+    void add(const void *data, size_t size) {
+        auto bytes = static_cast<const unsigned char *>(data);
+        for(size_t i = 0; i < size; i ++) {
+            value ^= bytes[i];
+            value *= 0x100000001b3ull;
+        }
+    }
+    void add(uint64_t number) { add(&number, sizeof(number)); }
+    void add(const std::string &str)
+        { add(str.length()); add(str.data(), str.length()); }
+    void add(Link *link) {
+        if(!link) { add(uint64_t(0)); return; }
+        add(std::string(typeid(*link).name()));
+        add(uint64_t(link->getTargetAddress()));
+    }
+
+    uint64_t get() const { return value; }
+};
+
+void LayoutManifest::build(Program *program, MemoryBufferBacking *backing) {
+    code = backing->getBuffer().data();
+    textAddress = backing->getBase();
+    textSize = backing->getBuffer().length();
+
+    LayoutHash structure;
+    structure.add(uint64_t(textAddress));
+    structure.add(uint64_t(textSize));
+    for(auto module : CIter::modules(program)) {
+        structure.add(module->getName());
+
+        for(auto function : CIter::functions(module)) {
+            structure.add(function->getName());
+            structure.add(uint64_t(function->getAddress()));
+            structure.add(uint64_t(function->getSize()));
+            for(auto block : CIter::children(function)) {
+                for(auto instr : CIter::children(block)) {
+                    auto semantic = instr->getSemantic();
+                    structure.add(uint64_t(semantic->getSize()));
+                    structure.add(semantic->getLink());
+                }
+            }
+            addEntry(module->getName() + ":" + function->getName(),
+                function->getAddress(), function->getSize());
+        }
+
+        if(module->getPLTList()) {
+            for(auto plt : CIter::plts(module)) {
+                structure.add(plt->getName());
+                structure.add(uint64_t(plt->getAddress()));
+                structure.add(uint64_t(plt->getSize()));
+                addEntry(module->getName() + ":" + plt->getName(),
+                    plt->getAddress(), plt->getSize());
+            }
+        }
+
+        for(auto region : CIter::regions(module)) {
+            structure.add(uint64_t(region->getAddress()));
+            structure.add(uint64_t(region->getSize()));
+            structure.add(region->getDataBytes());
+            for(auto section : CIter::children(region)) {
+                for(auto var : CIter::children(section)) {
+                    structure.add(uint64_t(var->getAddress()));
+                    structure.add(var->getDest());
+                }
+            }
+        }
+    }
+    structureHash = structure.get();
+}
+
+void LayoutManifest::addEntry(const std::string &name, address_t address,
+    size_t size) {
+
+    LayoutHash hash;
+    if(address >= textAddress && address - textAddress + size <= textSize) {
+        hash.add(code + (address - textAddress), size);
+    }
+
+    // local symbols may share a name
+    std::string key = name;
+    for(int i = 2; entryMap.count(key); i ++) {
+        key = name + "#" + std::to_string(i);
+    }
+    entryMap[key] = Entry{address, size, hash.get()};
+}
+
+bool LayoutManifest::load(const std::string &filename) {
+    std::ifstream file(filename);
+    std::string line;
+    if(!std::getline(file, line) || line != MANIFEST_SIGNATURE) return false;
+
+    file >> std::hex;
+    std::string tag;
+    if(!(file >> tag >> fileSize) || tag != "file") return false;
+    if(!(file >> tag >> textAddress >> textOffset >> textSize)
+        || tag != "text") return false;
+    if(!(file >> tag >> structureHash) || tag != "structure") return false;
+
+    while(file >> tag) {
+        Entry entry;
+        std::string name;
+        if(tag != "chunk"
+            || !(file >> entry.address >> entry.size >> entry.codeHash)
+            || !std::getline(file >> std::ws, name)) {
+
+            return false;
+        }
+        entryMap[name] = entry;
+    }
+    return true;
+}
+
+bool LayoutManifest::save(const std::string &filename) const {
+    std::ofstream file(filename);
+    file << MANIFEST_SIGNATURE << "\n" << std::hex
+        << "file " << fileSize << "\n"
+        << "text " << textAddress << " " << textOffset
+            << " " << textSize << "\n"
+        << "structure " << structureHash << "\n";
+    for(const auto &kv : entryMap) {
+        const auto &entry = kv.second;
+        file << "chunk " << entry.address << " " << entry.size
+            << " " << entry.codeHash << " " << kv.first << "\n";
+    }
+    return file.good();
+}
+
+bool LayoutManifest::isCompatible(const LayoutManifest &previous) const {
+    if(structureHash != previous.structureHash) {
+        LOG(1, "layout or data changed since the previous output");
+        return false;
+    }
+    if(entryMap.size() != previous.entryMap.size()) return false;
+
+    for(const auto &kv : entryMap) {
+        auto it = previous.entryMap.find(kv.first);
+        if(it == previous.entryMap.end()
+            || it->second.address != kv.second.address
+            || it->second.size != kv.second.size) {
+
+            LOG(1, "placement of [" << kv.first << "] changed");
+            return false;
+        }
+    }
+    return true;
+}
+
+bool LayoutManifest::patchOutput(const std::string &outputFile,
+    const LayoutManifest &previous) {
+
+    if(!code || !isCompatible(previous)) return false;
+
+    struct stat st;
+    if(stat(outputFile.c_str(), &st) != 0
+        || size_t(st.st_size) != previous.fileSize) {
+
+        LOG(1, "previous output [" << outputFile << "] is missing or modified");
+        return false;
+    }
+
+    int fd = open(outputFile.c_str(), O_WRONLY);
+    if(fd < 0) return false;
+
+    size_t patched = 0;
+    for(const auto &kv : entryMap) {
+        const auto &entry = kv.second;
+        if(entry.codeHash == previous.entryMap.at(kv.first).codeHash) continue;
+
+        auto delta = entry.address - textAddress;
+        if(pwrite(fd, code + delta, entry.size, previous.textOffset + delta)
+            != static_cast<ssize_t>(entry.size)) {
+
+            LOG(0, "Error patching [" << kv.first << "] in " << outputFile);
+            close(fd);
+            std::remove(getFilename(outputFile).c_str());  // force rebuild
+            return false;
+        }
+        LOG(1, "patched [" << kv.first << "]");
+        patched ++;
+    }
+    close(fd);
+
+    LOG(0, "Incremental output: patched " << std::dec << patched
+        << " of " << entryMap.size() << " code chunks in " << outputFile);
+    textOffset = previous.textOffset;
+    fileSize = previous.fileSize;
+    save(getFilename(outputFile));
+    return true;
+}
@@ -0,0 +1,63 @@
+#ifndef EGALITO_GENERATE_LAYOUT_MANIFEST_H
+#define EGALITO_GENERATE_LAYOUT_MANIFEST_H
+
+#include <string>
+#include <map>
+#include <cstdint>
+#include "types.h"
+
+class Program;
+class MemoryBufferBacking;
+
+/** Records where each function and PLT entry of a mirror ELF was placed,
+    stored next to the output as <output>.layout.
+
+    When EGALITO_INCREMENTAL=1, the next generation into the same file
+    compares its layout against the stored one. If only the bytes of some
+    code chunks differ, just those bytes are rewritten in the existing
+    output. Everything that could change any other part of the file
+    (addresses, sizes, links, data contents) goes into a single structure
+    hash, and any difference there requires a full rebuild.
+*/
+class LayoutManifest {
+public:
+    struct Entry {
+        address_t address;
+        size_t size;
+        uint64_t codeHash;
+    };
+private:
+    const char *code;  // start of text in the backing, if built
+    address_t textAddress;
+    size_t textOffset;
+    size_t textSize;
+    size_t fileSize;
+    uint64_t structureHash;
+    std::map<std::string, Entry> entryMap;
+public:
+    LayoutManifest() : code(nullptr), textAddress(0), textOffset(0),
+        textSize(0), fileSize(0), structureHash(0) {}
+
+    /** Describes the code that was just generated into backing. */
+    void build(Program *program, MemoryBufferBacking *backing);
+
+    void setTextOffset(size_t offset) { textOffset = offset; }
+    void setFileSize(size_t size) { fileSize = size; }
+
+    bool load(const std::string &filename);
+    bool save(const std::string &filename) const;
+
+    /** Rewrites the changed code chunks of outputFile, which was generated
+        with the layout in previous, and then saves this manifest. Returns
+        false without touching the file if a full rebuild is needed. */
+    bool patchOutput(const std::string &outputFile,
+        const LayoutManifest &previous);
+
+    static std::string getFilename(const std::string &outputFile)
+        { return outputFile + ".layout"; }
+private:
+    bool isCompatible(const LayoutManifest &previous) const;
+    void addEntry(const std::string &name, address_t address, size_t size);
+};
+
+#endif
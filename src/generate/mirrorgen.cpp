@@ -1,13 +1,41 @@
+#include <cstring>  // for memmem
 #include "mirrorgen.h"
 #include "modulegen.h"
 #include "data.h"
 #include "concrete.h"
+#include "elf/elfspace.h"
+#include "elf/elfmap.h"
+#include "util/feature.h"
+#include "log/log.h"
+
+/** glibc 2.36 and later define this version to mark DT_RELR support. */
+static bool supportsRelr(Program *program) {
+    for(auto module : CIter::children(program)) {
+        if(module->getLibrary()->getRole() != Library::ROLE_LIBC) continue;
+        if(!module->getElfSpace()) return false;
+
+        auto elfMap = module->getElfSpace()->getElfMap();
+        auto dynstr = elfMap->findSection(".dynstr");
+        if(!dynstr) return false;
+        const char *version = "GLIBC_ABI_DT_RELR";
+        return memmem(elfMap->getSectionReadPtr<const char *>(dynstr),
+            dynstr->getSize(), version, std::strlen(version)) != nullptr;
+    }
+    return false;
+}
 
 MirrorGen::MirrorGen(Program *program, SandboxBacking *backing)
     : ElfGeneratorImpl(program, backing) {
 
     getConfig()->setDynamicallyLinked(true);
     getConfig()->setPositionIndependent(true);
+    getConfig()->setHugePageText(isFeatureEnabled("EGALITO_HUGE_PAGE_TEXT"));
+
+    // EGALITO_RELR=0 or 1 overrides what the libc in the output supports
+    bool relr = getenv("EGALITO_RELR") ? isFeatureEnabled("EGALITO_RELR")
+        : (isFeatureEnabled("EGALITO_PRELINK") || supportsRelr(program));
+    LOG(1, "using " << (relr ? "RELR" : "RELA") << " relative relocations");
+    getConfig()->setRelrRelocs(relr);
 }
 
 void MirrorGen::preCodeGeneration() {
@@ -47,6 +75,7 @@ void MirrorGen::generateContent(const std::string &filename) {
             moduleGen.makeTLS();
         }
     }
+    pipeline.add(new MakeEhFrame());
     pipeline.add(new MakeDynsymHash());  // after all .dynsym entries added
     pipeline.add(new TextSectionCreator());
     pipeline.add(new GenerateSectionTable());
@@ -12,7 +12,8 @@
 #include "config.h"
 
 ModuleGen::ModuleGen(Config config, Module *module, SectionList *sectionList)
-    : config(config), module(module), sectionList(sectionList) {
+    : config(config), module(module), sectionList(sectionList),
+    jumpTableVarsBuilt(false) {
 
 }
 
@@ -79,8 +80,8 @@ void ModuleGen::makeDataSections() {
                 // by default, make everything writable
                 auto dataSection = new Section(section->getName(),
                     SHT_PROGBITS, flags);
-                auto content = new DeferredString(region->getDataBytes()
-                    .substr(section->getOriginalOffset(), section->getSize()));
+                auto content = new DeferredStringView(region->getDataBytes(),
+                    section->getOriginalOffset(), section->getSize());
                 dataSection->setContent(content);
                 dataSection->getHeader()->setAddress(section->getAddress());
                 sectionList->addSection(dataSection);
@@ -109,8 +110,8 @@ void ModuleGen::makeDataSections() {
                     LOG(1, "   Initializing bss with 0");
                 }
                 else {
-                    auto content = new DeferredString(region->getDataBytes()
-                        .substr(section->getOriginalOffset(), section->getSize()));
+                    auto content = new DeferredStringView(region->getDataBytes(),
+                        section->getOriginalOffset(), section->getSize());
                     bssSection->setContent(content);
                     LOG(1, "   Initializing bss with " << section->getSize() << " data bytes");
                 }
@@ -158,8 +159,8 @@ void ModuleGen::makeDataSections() {
                 // by default, make everything writable
                 auto dataSection = new Section(section->getName(),
                     SHT_PROGBITS, SHF_ALLOC | SHF_WRITE);
-                auto content = new DeferredString(region->getDataBytes()
-                    .substr(section->getOriginalOffset(), section->getSize()));
+                auto content = new DeferredStringView(region->getDataBytes(),
+                    section->getOriginalOffset(), section->getSize());
                 dataSection->setContent(content);
                 dataSection->getHeader()->setAddress(section->getAddress());
                 sectionList->addSection(dataSection);
@@ -180,8 +181,8 @@ void ModuleGen::makeDataSections() {
                     LOG(1, "   Initializing bss with 0");
                 }
                 else {
-                    auto content = new DeferredString(region->getDataBytes()
-                        .substr(section->getOriginalOffset(), section->getSize()));
+                    auto content = new DeferredStringView(region->getDataBytes(),
+                        section->getOriginalOffset(), section->getSize());
                     bssSection->setContent(content);
                     LOG(1, "   Initializing bss with data bytes");
                 }
@@ -209,12 +210,7 @@ void ModuleGen::makeDataSections() {
 }
 
 void ModuleGen::maybeMakeDataRelocs(DataSection *section, Section *sec) {
-    std::set<DataVariable *> jumpTableVars; //jump table entries
-    for(auto jt : CIter::children(module->getJumpTableList())) {
-        for(auto entry : CIter::children(jt)) {
-            jumpTableVars.insert(entry->getDataVariable());
-        }
-    }
+    const auto &jumpTableVars = getJumpTableVars();
     std::vector<DataVariable *> ldRelocVars, generalRelocVars;
     for(auto var : CIter::children(section)) {
         auto link = var->getDest();
@@ -361,13 +357,11 @@ void ModuleGen::makeText() {
 
         auto textSection = new Section(name.c_str(), SHT_PROGBITS,
             SHF_ALLOC | SHF_EXECINSTR);
-        DeferredString *textValue = nullptr;
+        DeferredValue *textValue = nullptr;
         if(auto backing = config.getCodeBacking()) {
-            // Don't modify backing after this point to avoid invalidating c_str
-            auto copy = new std::string(backing->getBuffer());
-            textValue = new DeferredString(
-                reinterpret_cast<const char *>(copy->c_str()),
-                size);
+            // Don't modify backing after this point to avoid invalidating it
+            textValue = new DeferredStringView(
+                backing->getBuffer().data(), size);
         }
         else {
             textValue = new DeferredString(
@@ -426,24 +420,11 @@ void ModuleGen::makeSymbolsAndRelocs(address_t begin, size_t size,
             continue;  // not in this text section
         }
 
-        if(config.isKernel()) {
-            // fix addresses for kernel generation
-            auto backing = config.getCodeBacking();
-            func->getPosition()->set(func->getAddress() - backing->getBase()
-                + LINUX_KERNEL_CODE_BASE);
-        }
-
-        LOG(1, "making symbol for " << func->getName());
+        LOG(10, "making symbol for " << func->getName());
         makeSymbolInText(func, textSection);
 #if 0
         makeRelocInText(func, textSection);
 #endif
-
-        if(config.isKernel()) {
-            // undo address fix
-            auto backing = config.getCodeBacking();
-            func->getPosition()->set(backing->getBase() + func->getAddress());
-        }
     }
 #if 0
     // Make symbols for PLT entries
@@ -482,10 +463,20 @@ void ModuleGen::makeSymbolsAndRelocs(address_t begin, size_t size,
 void ModuleGen::makeSymbolInText(Function *func, const std::string &textSection) {
     auto symtab = getSection(".symtab")->castAs<SymbolTableContent *>();
 
+    // Kernel code is linked at LINUX_KERNEL_CODE_BASE rather than where the
+    // backing holds it. Fix up the symbol values directly instead of moving
+    // each function there and back.
+    address_t address = func->getAddress();
+    if(config.isKernel()) {
+        address = address - config.getCodeBacking()->getBase()
+            + LINUX_KERNEL_CODE_BASE;
+    }
+
     // add name to string table
     auto value = symtab->addSymbol(func, func->getSymbol());
-    value->addFunction([this, textSection] (ElfXX_Sym *symbol) {
+    value->addFunction([this, textSection, address] (ElfXX_Sym *symbol) {
         symbol->st_shndx = shdrIndexOf(textSection);
+        symbol->st_value = address;
     });
 
     if(func->getSymbol()) for(auto alias : func->getSymbol()->getAliases()) {
@@ -508,8 +499,9 @@ void ModuleGen::makeSymbolInText(Function *func, const std::string &textSection)
 
         // add name to string table
         auto value = symtab->addSymbol(func, alias);
-        value->addFunction([this, textSection] (ElfXX_Sym *symbol) {
+        value->addFunction([this, textSection, address] (ElfXX_Sym *symbol) {
             symbol->st_shndx = shdrIndexOf(textSection);
+            symbol->st_value = address;
         });
     }
 
@@ -584,8 +576,8 @@ void ModuleGen::makeTLS() {
             // by default, make everything writable
             auto dataSection = new Section(section->getName(),
                 SHT_PROGBITS, SHF_ALLOC | SHF_WRITE | SHF_TLS);
-            auto content = new DeferredString(tlsRegion->getDataBytes()
-                .substr(section->getOriginalOffset(), section->getSize()));
+            auto content = new DeferredStringView(tlsRegion->getDataBytes(),
+                section->getOriginalOffset(), section->getSize());
             dataSection->setContent(content);
             dataSection->getHeader()->setAddress(section->getAddress());
             sectionList->addSection(dataSection);
@@ -699,6 +691,19 @@ Section *ModuleGen::makeIntraPaddingSection(size_t desiredAlignment) {
     return paddingSection;
 }
 
+const std::set<DataVariable *> &ModuleGen::getJumpTableVars() {
+    // built once per module, not once per data section
+    if(!jumpTableVarsBuilt) {
+        for(auto jt : CIter::children(module->getJumpTableList())) {
+            for(auto entry : CIter::children(jt)) {
+                jumpTableVars.insert(entry->getDataVariable());
+            }
+        }
+        jumpTableVarsBuilt = true;
+    }
+    return jumpTableVars;
+}
+
 size_t ModuleGen::shdrIndexOf(Section *section) {
 #if 0
     auto shdrTableSection = getSection("=shdr_table");
@@ -2,6 +2,7 @@
 #define EGALITO_GENERATE_MODULEGEN_H
 
 #include <string>
+#include <set>
 #include "types.h"
 #include "section.h"
 #include "sectionlist.h"
@@ -11,6 +12,7 @@ class Function;
 class MemoryBufferBacking;
 class DataSection;
 class TLSDataRegion;
+class DataVariable;
 
 class ModuleGen {
 public:
@@ -52,6 +54,8 @@ private:
     Config config;
     Module *module;
     SectionList *sectionList;
+    std::set<DataVariable *> jumpTableVars;
+    bool jumpTableVarsBuilt;
 public:
     ModuleGen(Config config, Module *module, SectionList *sectionList);
 
@@ -72,6 +76,7 @@ public:
     void makePaddingSection(size_t desiredAlignment);
     Section *makeIntraPaddingSection(size_t desiredAlignment);
 private:
+    const std::set<DataVariable *> &getJumpTableVars();
     size_t shdrIndexOf(Section *section);
     size_t shdrIndexOf(const std::string &name);
     static bool blacklistedSymbol(const std::string &name);
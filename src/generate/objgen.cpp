@@ -30,6 +30,7 @@ void ObjGen::generate() {
     makeHeader();
     makeSymbolInfo();
     makeText();
+    makeSymbolsAndRelocs();
     makeRoData();
     makeShdrTable();
     updateSymbolTable();  // must run after .text & shdrTable are created
@@ -66,46 +67,29 @@ void ObjGen::makeHeader() {
 }
 
 void ObjGen::makeText() {
-    // Split separate pages into their own LOAD sections.
-    // First, find the set of all pages that are used.
-    std::set<address_t> pagesUsed;
+    // Give every function its own section, as with -ffunction-sections, so
+    // that the linker can still garbage-collect, fold and reorder them.
     for(auto func : CIter::functions(elfSpace->getModule())) {
-        address_t start = func->getAddress() & ~0xfff;
-        address_t end = ((func->getAddress() + func->getSize()) + 0xfff) & ~0xfff;
-        for(address_t page = start; page < end; page += 0x1000) {
-            LOG(1, "code uses page " << std::hex << page);
-            pagesUsed.insert(page);
+        if(blacklistedSymbol(func->getName())) {
+            continue;  // skip making a section for this function
         }
-    }
 
-    // Next, map any contiguous pages as single sections.
-    std::set<address_t>::iterator i = pagesUsed.begin();
-    size_t totalSize = 0;
-    while(i != pagesUsed.end()) {
-        size_t size = 0;
-        std::set<address_t>::iterator j = i;
-        while(j != pagesUsed.end() && (*j) == (*i) + size) {
-            j++;
-            size += 0x1000;
+        std::string name = ".text." + func->getName();
+        if(sectionList[name]) {
+            // local functions from different sources can share a name
+            name = StreamAsString() << name << ".0x" << std::hex
+                << (func->getAddress() - backing->getBase());
         }
 
-        address_t address = *i;
-
-        LOG(1, "map " << std::hex << address << " size " << size);
-
-        std::string name = StreamAsString()
-            << ".text.0x" << std::hex << address;
+        LOG(10, "section [" << name << "] for " << func->getName());
         auto textSection = new Section(name.c_str(), SHT_PROGBITS,
             SHF_ALLOC | SHF_EXECINSTR);
-        auto textValue = new DeferredString(reinterpret_cast<const char *>(*i), size);
+        auto textValue = new DeferredString(
+            reinterpret_cast<const char *>(func->getAddress()), func->getSize());
         textSection->setContent(textValue);
         sectionList.addSection(textSection);
 
-        makeRelocInfo(name);
-        makeSymbolsAndRelocs(address, size, name);
-
-        totalSize += size;
-        i = j;
+        functionSections[func] = name;
     }
 }
 
@@ -124,39 +108,29 @@ void ObjGen::makeSymbolInfo() {
     sectionList.addSection(symtabSection);
 }
 
-void ObjGen::makeRelocInfo(const std::string &textSection) {
+RelocSectionContent *ObjGen::makeRelocInfo(const std::string &textSection,
+    address_t base) {
+
     auto reloc = new RelocSectionContent(
-        new SectionRef(&sectionList, textSection), &sectionList, elfSpace);
+        new SectionRef(&sectionList, textSection), &sectionList, elfSpace,
+        base);
     auto relocSection = new Section(".rela" + textSection, SHT_RELA, SHF_INFO_LINK);
     relocSection->setContent(reloc);
 
     sectionList.addSection(relocSection);
+    return reloc;
 }
 
-void ObjGen::makeSymbolsAndRelocs(address_t begin, size_t size,
-    const std::string &textSection) {
-
-    // Add symbols to the symbol list, but only for those functions
-    // which fall into the given range [begin, begin+size).
+void ObjGen::makeSymbolsAndRelocs() {
+    // All function sections exist by now, so relocations can refer to any
+    // of them. Iterate in function order to keep the output stable.
     for(auto func : CIter::functions(elfSpace->getModule())) {
-        if(blacklistedSymbol(func->getName())) {
-            continue;  // skip making a symbol for this function
-        }
-
-        if(func->getAddress() < begin
-            || func->getAddress() + func->getSize() >= begin + size) {
-            continue;  // not in this text section
-        }
+        auto it = functionSections.find(func);
+        if(it == functionSections.end()) continue;
 
-        // fix addresses for objgen (set base to 0)
-        func->getPosition()->set(func->getAddress() - backing->getBase());
-
-        LOG(1, "making symbol for " << func->getName());
-        makeSymbolInText(func, textSection);
-        makeRelocInText(func, textSection);
-
-        // undo address fix
-        func->getPosition()->set(backing->getBase() + func->getAddress());
+        LOG(10, "making symbol for " << func->getName());
+        makeSymbolInText(func, (*it).second);
+        makeRelocInText(func, (*it).second);
     }
 
     // Handle any other types of symbols that need generating.
@@ -175,13 +149,14 @@ void ObjGen::makeSymbolsAndRelocs(address_t begin, size_t size,
 void ObjGen::makeSymbolInText(Function *func, const std::string &textSection) {
     auto symtab = sectionList[".symtab"]->castAs<SymbolTableContent *>();
 
-    // add name to string table
+    // add name to string table; the function starts its own section
     auto value = symtab->addSymbol(func, func->getSymbol());
     value->addFunction([this, textSection] (ElfXX_Sym *symbol) {
         symbol->st_shndx = sectionList.indexOf(textSection);
+        symbol->st_value = 0;
     });
 
-    for(auto alias : func->getSymbol()->getAliases()) {
+    if(func->getSymbol()) for(auto alias : func->getSymbol()->getAliases()) {
         // skip functions with the same name (due to versioning)
         if(alias->getName() == func->getName()) continue;
 
@@ -189,6 +164,7 @@ void ObjGen::makeSymbolInText(Function *func, const std::string &textSection) {
         auto value = symtab->addSymbol(func, alias);
         value->addFunction([this, textSection] (ElfXX_Sym *symbol) {
             symbol->st_shndx = sectionList.indexOf(textSection);
+            symbol->st_value = 0;
         });
     }
 
@@ -208,12 +184,29 @@ void ObjGen::makeSymbolInText(Function *func, const std::string &textSection) {
 }
 
 void ObjGen::makeRelocInText(Function *func, const std::string &textSection) {
-    auto reloc = sectionList[".rela" + textSection]->castAs<RelocSectionContent *>();
+    RelocSectionContent *reloc = nullptr;  // only made if needed
 
     for(auto block : CIter::children(func)) {
         for(auto instr : CIter::children(block)) {
-            if(auto link = instr->getSemantic()->getLink()) {
-                LOG(1, "adding relocation at " << instr->getName());
+            auto link = instr->getSemantic()->getLink();
+            if(!link) continue;
+
+            auto target = functionOf(link->getTarget());
+            if(target == func && !link->isAbsolute()) {
+                continue;  // pc-relative within this section
+            }
+
+            if(!reloc) reloc = makeRelocInfo(textSection, func->getAddress());
+
+            auto it = functionSections.find(target);
+            if(target && it != functionSections.end()) {
+                LOG(10, "adding relocation at " << instr->getName()
+                    << " to [" << (*it).second << "]");
+                reloc->addSectionRef(instr, link, (*it).second,
+                    link->getTargetAddress() - target->getAddress());
+            }
+            else {
+                LOG(10, "adding relocation at " << instr->getName());
                 reloc->add(instr, link);
             }
         }
@@ -250,7 +243,12 @@ void ObjGen::makeShdrTable() {
             deferred->getElfPtr()->sh_name
                 = shstrtab->add(section->getName(), true);
 
-            if(dynamic_cast<SymbolTableContent *>(section->getContent())) {
+            if(section->getHeader()->getShdrFlags() & SHF_EXECINSTR) {
+                deferred->addFunction([] (ElfXX_Shdr *shdr) {
+                    shdr->sh_addralign = 16;
+                });
+            }
+            else if(dynamic_cast<SymbolTableContent *>(section->getContent())) {
                 deferred->addFunction([this, shdrTable] (ElfXX_Shdr *shdr) {
                     auto symtab = sectionList[".symtab"]->castAs<SymbolTableContent *>();
                     //shdr->sh_info = shdrTable->getCount();
@@ -295,24 +293,20 @@ void ObjGen::updateSymbolTable() {
 }
 
 void ObjGen::updateOffsets() {
-    // every section is written to the file, even those without Headers
-    size_t offset = 0;
-    for(auto section : sectionList) {
-        LOG(1, "section [" << section->getName() << "] is at offset " << std::dec << offset);
-        section->setOffset(offset);
-        offset += section->getContent()->getSize();
-    }
+    sectionList.updateOffsets();
 }
 
 void ObjGen::serialize() {
-    std::ofstream fs(filename, std::ios::out | std::ios::binary);
-    for(auto section : sectionList) {
-        LOG(1, "serializing " << section->getName()
-            << " @ " << std::hex << section->getOffset()
-            << " of size " << std::dec << section->getContent()->getSize());
-        fs << *section;
+    if(!sectionList.serialize(filename)) {
+        LOG(0, "Cannot open output file [" << filename << "]");
+    }
+}
+
+Function *ObjGen::functionOf(Chunk *chunk) {
+    while(chunk && !dynamic_cast<Function *>(chunk)) {
+        chunk = chunk->getParent();
     }
-    fs.close();
+    return static_cast<Function *>(chunk);
 }
 
 bool ObjGen::blacklistedSymbol(const std::string &name) {
@@ -1,17 +1,21 @@
 #ifndef EGALITO_ELF_OBJGEN_H
 #define EGALITO_ELF_OBJGEN_H
 
+#include <map>
 #include "transform/sandbox.h"
 #include "elf/elfspace.h"
 #include "section.h"
 #include "sectionlist.h"
 
+class RelocSectionContent;
+
 class ObjGen {
 private:
     ElfSpace *elfSpace;
     MemoryBacking *backing;
     std::string filename;
     SectionList sectionList;
+    std::map<Function *, std::string> functionSections;
     int sectionSymbolCount;
 public:
     ObjGen(ElfSpace *elfSpace, MemoryBacking *backing, std::string filename);
@@ -20,10 +24,10 @@ public:
 private:
     void makeHeader();
     void makeSymbolInfo();
-    void makeRelocInfo(const std::string &textSection);
+    RelocSectionContent *makeRelocInfo(const std::string &textSection,
+        address_t base);
     void makeText();
-    void makeSymbolsAndRelocs(address_t begin, size_t size,
-        const std::string &textSection);
+    void makeSymbolsAndRelocs();
     void makeSymbolInText(Function *func, const std::string &textSection);
     void makeRelocInText(Function *func, const std::string &textSection);
     void makeRoData();
@@ -34,6 +38,7 @@ private:
     void serialize();
 private:
     static bool blacklistedSymbol(const std::string &name);
+    static Function *functionOf(Chunk *chunk);
 };
 
 #endif
@@ -0,0 +1,259 @@
+#include <algorithm>
+#include <fstream>
+#include <set>
+#include <cstring>  // for std::memcmp, std::memcpy
+#include <sys/stat.h>  // for chmod
+#include "patchgen.h"
+#include "chunk/concrete.h"
+#include "elf/elfmap.h"
+#include "elf/elfspace.h"
+#include "elf/symbol.h"
+#include "instr/concrete.h"
+#include "instr/writer.h"
+#include "operation/mutator.h"
+#include "log/log.h"
+
+#define PATCH_PAGE_SIZE     0x1000
+#define PATCH_JUMP_SIZE     5  // jmp rel32
+#define PATCH_ALIGNMENT     16
+
+static address_t alignUp(address_t value, address_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+PatchGen::PatchGen(Module *module) : module(module), elfMap(nullptr),
+    noteIndex(-1), segmentAddress(0), segmentOffset(0) {
+
+    if(module && module->getElfSpace()) {
+        elfMap = module->getElfSpace()->getElfMap();
+    }
+}
+
+bool PatchGen::prepare() {
+#ifdef ARCH_X86_64
+    if(!elfMap) return false;
+    if(!findSegment()) {
+        LOG(1, "No PT_NOTE after the PT_LOAD segments to reuse for patching");
+        return false;
+    }
+
+    std::vector<Function *> functionList;
+    for(auto function : CIter::functions(module)) {
+        functionList.push_back(function);
+    }
+    std::sort(functionList.begin(), functionList.end(),
+        [] (Function *a, Function *b)
+            { return a->getAddress() < b->getAddress(); });
+
+    std::map<address_t, address_t> changedRange;  // start to end
+    std::set<Function *> changedSet;
+    for(size_t i = 0; i < functionList.size(); i ++) {
+        auto function = functionList[i];
+        auto address = function->getAddress();
+
+        // the original extent: the symbol, or up to the next function
+        size_t extent = function->getSize();
+        auto symbol = function->getSymbol();
+        if(symbol && symbol->getSize()) extent = symbol->getSize();
+        else if(i + 1 < functionList.size()) {
+            extent = functionList[i + 1]->getAddress() - address;
+        }
+
+        if(!getOriginalBytes(address, extent)) {
+            LOG(1, "Function [" << function->getName()
+                << "] is not in the original code, can't patch");
+            return false;
+        }
+        if(isUnchanged(function, extent)) continue;
+
+        if(extent < PATCH_JUMP_SIZE) {
+            LOG(1, "Function [" << function->getName()
+                << "] is too small to patch");
+            return false;
+        }
+        for(auto block : CIter::children(function)) {
+            auto last = block->getChildren()->getIterable()->getLast();
+            auto indirect = last ? dynamic_cast<IndirectJumpInstruction *>(
+                last->getSemantic()) : nullptr;
+            if(indirect && !indirect->getJumpTables().empty()) {
+                LOG(1, "Function [" << function->getName()
+                    << "] has jump tables into its original code,"
+                    " can't patch");
+                return false;
+            }
+        }
+
+        changedList.push_back(function);
+        changedSet.insert(function);
+        changedRange[address] = address + extent;
+    }
+
+    // the old copies stay behind the entry jmp, so nothing else may
+    // reach into them
+    auto isInterior = [&changedRange] (Link *link) {
+        if(!link) return false;
+        auto target = link->getTargetAddress();
+        auto it = changedRange.upper_bound(target);
+        if(it == changedRange.begin()) return false;
+        --it;
+        return target > (*it).first && target < (*it).second;
+    };
+    for(auto function : functionList) {
+        if(changedSet.count(function)) continue;
+        for(auto block : CIter::children(function)) {
+            for(auto instr : CIter::children(block)) {
+                if(isInterior(instr->getSemantic()->getLink())) {
+                    LOG(1, "[" << function->getName() << "] refers into"
+                        " the middle of a changed function, can't patch");
+                    return false;
+                }
+            }
+        }
+    }
+    for(auto region : CIter::regions(module)) {
+        for(auto section : CIter::children(region)) {
+            for(auto var : CIter::children(section)) {
+                if(isInterior(var->getDest())) {
+                    LOG(1, "Data refers into the middle of a changed"
+                        " function, can't patch");
+                    return false;
+                }
+            }
+        }
+    }
+
+    LOG(1, "Patching " << std::dec << changedList.size() << " of "
+        << functionList.size() << " functions");
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool PatchGen::generate(const std::string &outputFile) {
+    auto header = reinterpret_cast<ElfXX_Ehdr *>(elfMap->getMap());
+    std::string image(elfMap->getCharmap(), elfMap->getLength());
+
+    for(auto function : changedList) {
+        originalAddress[function] = function->getAddress();
+    }
+
+    // place all of them first, since they may refer to each other
+    address_t address = segmentAddress;
+    for(auto function : changedList) {
+        address = alignUp(address, PATCH_ALIGNMENT);
+        ChunkMutator(function).setPosition(address);
+        address += function->getSize();
+    }
+
+    std::string code;
+    for(auto function : changedList) {
+        code.append(function->getAddress() - segmentAddress - code.length(),
+            static_cast<char>(0xcc));  // int3
+        code += getCode(function);
+
+        auto original = originalAddress[function];
+        size_t offset;
+        getOriginalBytes(original, PATCH_JUMP_SIZE, &offset);
+        int32_t displacement = static_cast<int32_t>(
+            function->getAddress() - (original + PATCH_JUMP_SIZE));
+        image[offset] = static_cast<char>(0xe9);
+        std::memcpy(&image[offset + 1], &displacement, sizeof(displacement));
+    }
+
+    if(!code.empty()) {
+        image.resize(segmentOffset, '\0');
+        image += code;
+
+        auto phdr = reinterpret_cast<ElfXX_Phdr *>(&image[header->e_phoff
+            + noteIndex * header->e_phentsize]);
+        phdr->p_type = PT_LOAD;
+        phdr->p_flags = PF_R | PF_X;
+        phdr->p_offset = segmentOffset;
+        phdr->p_vaddr = segmentAddress;
+        phdr->p_paddr = segmentAddress;
+        phdr->p_filesz = code.length();
+        phdr->p_memsz = code.length();
+        phdr->p_align = PATCH_PAGE_SIZE;
+    }
+
+    {
+        std::ofstream file(outputFile.c_str(), std::ios::binary);
+        file.write(image.data(), image.length());
+        if(!file) {
+            LOG(0, "Cannot write patched file [" << outputFile << "]");
+            return false;
+        }
+    }
+    chmod(outputFile.c_str(), 0744);
+
+    LOG(0, "Patched " << std::dec << changedList.size()
+        << " changed functions into [" << outputFile << "]");
+    return true;
+}
+
+bool PatchGen::findSegment() {
+    const auto &segmentList = elfMap->getSegmentList();
+    int lastLoad = -1;
+    address_t end = 0;
+    for(size_t i = 0; i < segmentList.size(); i ++) {
+        auto phdr = static_cast<ElfXX_Phdr *>(segmentList[i]);
+        if(phdr->p_type == PT_LOAD) {
+            lastLoad = i;
+            end = std::max(end, phdr->p_vaddr + phdr->p_memsz);
+        }
+    }
+
+    // the loader expects PT_LOAD entries in address order, and the new
+    // segment is placed above all others
+    for(size_t i = lastLoad + 1; i < segmentList.size(); i ++) {
+        if(static_cast<ElfXX_Phdr *>(segmentList[i])->p_type == PT_NOTE) {
+            noteIndex = i;
+            break;
+        }
+    }
+    if(lastLoad < 0 || noteIndex < 0) return false;
+
+    segmentAddress = alignUp(end, PATCH_PAGE_SIZE);
+    segmentOffset = alignUp(elfMap->getLength(), PATCH_PAGE_SIZE);
+    return true;
+}
+
+bool PatchGen::isUnchanged(Function *function, size_t extent) {
+    auto code = getCode(function);
+    auto symbol = function->getSymbol();
+    if(symbol && symbol->getSize() && code.length() != extent) return false;
+    if(code.length() > extent) return false;
+
+    auto original = getOriginalBytes(function->getAddress(), code.length());
+    return original
+        && std::memcmp(original, code.data(), code.length()) == 0;
+}
+
+const char *PatchGen::getOriginalBytes(address_t address, size_t size,
+    size_t *offset) {
+
+    auto section = elfMap->findSectionContaining(address);
+    if(!section) return nullptr;
+
+    auto shdr = section->getHeader();
+    if(!(shdr->sh_flags & SHF_EXECINSTR) || shdr->sh_type == SHT_NOBITS) {
+        return nullptr;
+    }
+    auto delta = address - section->getVirtualAddress();
+    if(delta + size > shdr->sh_size) return nullptr;
+
+    if(offset) *offset = shdr->sh_offset + delta;
+    return elfMap->getCharmap() + shdr->sh_offset + delta;
+}
+
+std::string PatchGen::getCode(Function *function) {
+    std::string code;
+    InstrWriterCppString writer(code);
+    for(auto block : CIter::children(function)) {
+        for(auto instr : CIter::children(block)) {
+            instr->getSemantic()->accept(&writer);
+        }
+    }
+    return code;
+}
@@ -0,0 +1,60 @@
+#ifndef EGALITO_GENERATE_PATCHGEN_H
+#define EGALITO_GENERATE_PATCHGEN_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include "types.h"
+
+class Module;
+class Function;
+class ElfMap;
+
+/** Writes a mirror ELF as a copy of the input with only the changed
+    functions replaced, so that unchanged pages stay byte-identical (and
+    can share the page cache or deduplicate with the original).
+
+    Functions whose code regenerates to the original bytes are left where
+    they are. Changed functions are moved into a new PT_LOAD segment at the
+    end of the file, made from an unused PT_NOTE entry, and their original
+    entry point is overwritten with a jmp to the new copy. Everything that
+    reaches a function through its entry point, including data and
+    relocations, thus ends up in the new code.
+
+    prepare() rejects changes that this cannot express: new functions,
+    changed functions with jump tables or with references into their
+    middle, or entries too small for a jmp. Nothing is modified in that
+    case, and a full mirror generation should be used instead. Changes to
+    data are not detected, and the moved code has no unwind information.
+    Only x86_64 is supported.
+*/
+class PatchGen {
+private:
+    Module *module;
+    ElfMap *elfMap;
+    std::vector<Function *> changedList;
+    std::map<Function *, address_t> originalAddress;
+    int noteIndex;  // program header that becomes the new segment
+    address_t segmentAddress;
+    size_t segmentOffset;
+public:
+    PatchGen(Module *module);
+
+    /** Finds the changed functions. Returns false if they can't be
+        patched in. */
+    bool prepare();
+
+    /** Moves the changed functions into the new segment and writes
+        outputFile. Call only after prepare() succeeded. */
+    bool generate(const std::string &outputFile);
+
+    size_t getChangedCount() const { return changedList.size(); }
+private:
+    bool findSegment();
+    bool isUnchanged(Function *function, size_t extent);
+    const char *getOriginalBytes(address_t address, size_t size,
+        size_t *offset = nullptr);
+    static std::string getCode(Function *function);
+};
+
+#endif
@@ -0,0 +1,196 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <cstdio>  // for snprintf
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <elf.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "perfmap.h"
+#include "chunk/concrete.h"
+#include "util/feature.h"
+
+#include "log/log.h"
+
+// see tools/perf/Documentation/jitdump-specification.txt in Linux
+#define JITDUMP_MAGIC       0x4A695444
+#define JITDUMP_VERSION     1
+#define JIT_CODE_LOAD       0
+
+struct JitDumpHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t totalSize;
+    uint32_t elfMach;
+    uint32_t pad1;
+    uint32_t pid;
+    uint64_t timestamp;
+    uint64_t flags;
+};
+
+struct JitDumpCodeLoad {
+    uint32_t id;
+    uint32_t totalSize;
+    uint64_t timestamp;
+    uint32_t pid;
+    uint32_t tid;
+    uint64_t vma;
+    uint64_t codeAddress;
+    uint64_t codeSize;
+    uint64_t codeIndex;
+    // followed by the name and the code bytes
+};
+
+static uint64_t monotonicNS() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ul + ts.tv_nsec;
+}
+
+static bool writeAll(int fd, const void *data, size_t size) {
+    auto p = static_cast<const char *>(data);
+    while(size > 0) {
+        auto n = write(fd, p, size);
+        if(n <= 0) return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+PerfMap *PerfMap::getInstance() {
+    // never destroyed, the JIT-shuffling runtime keeps adding entries
+    static PerfMap *instance = [] () -> PerfMap * {
+        if(!isFeatureEnabled("EGALITO_PERF_MAP")
+            && !isFeatureEnabled("EGALITO_JITDUMP")) {
+
+            return nullptr;
+        }
+        return new PerfMap();
+    }();
+    return instance;
+}
+
+PerfMap::PerfMap() : mapFd(-1), dumpFd(-1), dumpMarker(nullptr),
+    codeIndex(0) {
+
+    char filename[64];
+    if(isFeatureEnabled("EGALITO_PERF_MAP")) {
+        std::snprintf(filename, sizeof filename, "/tmp/perf-%d.map",
+            static_cast<int>(getpid()));
+        mapFd = open(filename, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+            0644);
+        if(mapFd < 0) LOG(0, "can't open perf map [" << filename << "]");
+    }
+    if(isFeatureEnabled("EGALITO_JITDUMP")) {
+        if(!openDump()) LOG(0, "can't create jitdump file in /tmp");
+    }
+}
+
+bool PerfMap::openDump() {
+    char filename[64];
+    std::snprintf(filename, sizeof filename, "/tmp/jit-%d.dump",
+        static_cast<int>(getpid()));
+    dumpFd = open(filename, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(dumpFd < 0) return false;
+
+    // perf record finds the dump file through this executable mapping
+    dumpMarker = mmap(nullptr, sysconf(_SC_PAGESIZE), PROT_READ | PROT_EXEC,
+        MAP_PRIVATE, dumpFd, 0);
+    if(dumpMarker == MAP_FAILED) {
+        dumpMarker = nullptr;
+        close(dumpFd);
+        dumpFd = -1;
+        return false;
+    }
+
+    JitDumpHeader header;
+    std::memset(&header, 0, sizeof header);
+    header.magic = JITDUMP_MAGIC;
+    header.version = JITDUMP_VERSION;
+    header.totalSize = sizeof header;
+#ifdef ARCH_X86_64
+    header.elfMach = EM_X86_64;
+#elif defined(ARCH_AARCH64)
+    header.elfMach = EM_AARCH64;
+#elif defined(ARCH_RISCV)
+    header.elfMach = EM_RISCV;
+#endif
+    header.pid = getpid();
+    header.timestamp = monotonicNS();
+    return writeAll(dumpFd, &header, sizeof header);
+}
+
+void PerfMap::add(Program *program) {
+    for(auto module : CIter::modules(program)) {
+        for(auto function : CIter::functions(module)) {
+            add(function);
+        }
+        if(auto pltList = module->getPLTList()) {
+            for(auto trampoline : CIter::children(pltList)) {
+                add(trampoline);
+            }
+        }
+    }
+}
+
+void PerfMap::add(Function *function) {
+    add(function->getAddress(), function->getSize(),
+        function->getName().c_str());
+}
+
+void PerfMap::add(PLTTrampoline *trampoline) {
+    add(trampoline->getAddress(), trampoline->getSize(),
+        trampoline->getName().c_str());
+}
+
+void PerfMap::add(address_t address, size_t size, const char *name) {
+    if(!address || !size) return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if(mapFd >= 0) writeMapEntry(address, size, name);
+    if(dumpFd >= 0) writeCodeLoad(address, size, name);
+}
+
+void PerfMap::writeMapEntry(address_t address, size_t size,
+    const char *name) {
+
+    char line[512];
+    int length = std::snprintf(line, sizeof line, "%lx %lx %s\n",
+        static_cast<unsigned long>(address), static_cast<unsigned long>(size),
+        name);
+    if(length >= static_cast<int>(sizeof line)) {
+        // keep the entry, with a truncated name
+        length = sizeof line - 1;
+        line[length - 1] = '\n';
+    }
+    writeAll(mapFd, line, length);
+}
+
+void PerfMap::writeCodeLoad(address_t address, size_t size,
+    const char *name) {
+
+    size_t nameSize = std::strlen(name) + 1;
+
+    JitDumpCodeLoad record;
+    std::memset(&record, 0, sizeof record);
+    record.id = JIT_CODE_LOAD;
+    record.totalSize = sizeof record + nameSize + size;
+    record.timestamp = monotonicNS();
+    record.pid = getpid();
+    record.tid = syscall(SYS_gettid);
+    record.vma = address;
+    record.codeAddress = address;
+    record.codeSize = size;
+    record.codeIndex = codeIndex ++;
+
+    writeAll(dumpFd, &record, sizeof record);
+    writeAll(dumpFd, name, nameSize);
+    writeAll(dumpFd, reinterpret_cast<const void *>(address), size);
+}
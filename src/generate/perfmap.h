@@ -0,0 +1,46 @@
+#ifndef EGALITO_GENERATE_PERFMAP_H
+#define EGALITO_GENERATE_PERFMAP_H
+
+#include <mutex>
+#include "types.h"
+
+class Program;
+class Function;
+class PLTTrampoline;
+
+/** Tells perf where egalito placed code at runtime, so that samples in
+    the sandbox resolve to function names.
+
+    EGALITO_PERF_MAP=1 appends "start size name" lines to
+    /tmp/perf-<pid>.map, which perf report reads directly. Since JIT
+    shuffling reuses addresses, EGALITO_JITDUMP=1 also writes timestamped
+    code load records (with the code bytes) to /tmp/jit-<pid>.dump; record
+    with "perf record -k mono" and run "perf inject --jit" before perf
+    report.
+
+    Like DebugElf, output is written with plain system calls, since this
+    also runs inside the JIT-shuffling runtime.
+*/
+class PerfMap {
+private:
+    int mapFd;
+    int dumpFd;
+    void *dumpMarker;
+    unsigned long codeIndex;
+    std::mutex mutex;
+public:
+    /** Returns nullptr unless one of the outputs is enabled. */
+    static PerfMap *getInstance();
+
+    void add(Program *program);
+    void add(Function *function);
+    void add(PLTTrampoline *trampoline);
+    void add(address_t address, size_t size, const char *name);
+private:
+    PerfMap();
+    void writeMapEntry(address_t address, size_t size, const char *name);
+    void writeCodeLoad(address_t address, size_t size, const char *name);
+    bool openDump();
+};
+
+#endif
@@ -1,5 +1,7 @@
+#include <fstream>
 #include "sectionlist.h"
 #include "section.h"
+#include "log/log.h"
 
 SectionList::~SectionList() {
     for(auto section : sections) {
@@ -46,6 +48,53 @@ int SectionList::indexOf(const std::string &sectionName) {
     return (found ? sectionIndexMap[found] : -1);
 }
 
+size_t SectionList::updateOffsets() {
+    // every Section is written to the file, even those without SectionHeaders
+    size_t offset = 0;
+    for(auto section : sections) {
+        LOG(1, "section [" << section->getName() << "] is at offset "
+            << std::dec << offset);
+        section->setOffset(offset);
+        if(section->hasContent()) offset += section->getContent()->getSize();
+    }
+    return offset;
+}
+
+bool SectionList::serialize(const std::string &filename) {
+    std::ofstream fs(filename, std::ios::out | std::ios::binary);
+    if(!fs.is_open()) return false;
+
+    std::string image;
+    serializeInto(image);
+    fs.write(image.data(), image.length());
+    return fs.good();
+}
+
+void SectionList::serializeInto(std::string &image) {
+    size_t totalSize = 0;
+    for(auto section : sections) {
+        if(!section->hasContent()) continue;
+        size_t end = section->getOffset() + section->getContent()->getSize();
+        if(end > totalSize) totalSize = end;
+    }
+
+    // every byte is covered by some Section, so the zeroes are overwritten
+    image.assign(totalSize, 0);
+    size_t expected = 0;
+    for(auto section : sections) {
+        if(!section->hasContent()) continue;
+        auto content = section->getContent();
+        LOG(1, "serializing " << section->getName()
+            << " @ " << std::hex << section->getOffset()
+            << " of size " << std::dec << content->getSize());
+        if(section->getOffset() != expected) {
+            LOG(1, " WARNING: section offset does not match file position");
+        }
+        content->writeInto(&image[section->getOffset()]);
+        expected = section->getOffset() + content->getSize();
+    }
+}
+
 bool SectionList::isAssignedAnIndex(Section *section) {
     return section->getName()[0] != '=';
 }
@@ -32,6 +32,15 @@ public:
     Section *back();
     int indexOf(Section *section);
     int indexOf(const std::string &sectionName);
+
+    /** Assigns every Section its file offset; returns the total size. */
+    size_t updateOffsets();
+    /** Writes every Section's content into one buffer at its offset, then
+        the buffer to filename. updateOffsets() must have been called.
+    */
+    bool serialize(const std::string &filename);
+    /** Like serialize(filename), but leaves the ELF image in image. */
+    void serializeInto(std::string &image);
 private:
     static bool isAssignedAnIndex(Section *section);
 };
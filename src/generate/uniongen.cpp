@@ -2,12 +2,14 @@
 #include "modulegen.h"
 #include "data.h"
 #include "concrete.h"
+#include "util/feature.h"
 
 UnionGen::UnionGen(Program *program, SandboxBacking *backing)
     : ElfGeneratorImpl(program, backing) {
 
     getConfig()->setDynamicallyLinked(true);
     getConfig()->setUnionOutput(true);
+    getConfig()->setHugePageText(isFeatureEnabled("EGALITO_HUGE_PAGE_TEXT"));
 }
 
 void UnionGen::preCodeGeneration() {
@@ -44,6 +46,7 @@ void UnionGen::generateContent(const std::string &filename) {
             moduleGen.makeTLS();
         }
     }
+    pipeline.add(new MakeEhFrame());
     pipeline.add(new TextSectionCreator());
     pipeline.add(new GenerateSectionTable());
     pipeline.add(new ElfFileWriter(filename));
@@ -7,10 +7,12 @@
 
 
 #ifdef ARCH_RISCV
-Assembly::Assembly(const rv_instr &instr) : operands(instr) {
+Assembly::Assembly(const rv_instr &instr) : size(instr.len),
+    operands(instr) {
+
     id = instr.op;
     for(uint8_t i = 0; i < instr.len; i++) {
-        bytes.push_back((instr.inst >> (i * 8)) & 0xff);
+        bytes[i] = (instr.inst >> (i * 8)) & 0xff;
     }
     mnemonic = instr.op_name;
 
@@ -40,23 +42,22 @@ Assembly::Assembly(const rv_instr &instr) : operands(instr) {
         // one single reg write
         regs_write_count = 1;
         assert(instr.oper[0].type == rv_oper::rv_oper_reg);
-        regs_write.push_back(instr.oper[0].value.reg);
+        regs_write[0] = instr.oper[0].value.reg;
     }
 
     for(size_t i = regs_write_count; i < instr.oper_count; i ++) {
         switch(instr.oper[i].type) {
         case rv_oper::rv_oper_imm: break;
         case rv_oper::rv_oper_reg:
-            regs_read.push_back(instr.oper[i].value.reg);
+            regs_read[regs_read_count ++] = instr.oper[i].value.reg;
             break;
         case rv_oper::rv_oper_mem:
-            regs_read.push_back(instr.oper[i].value.mem.basereg);
+            regs_read[regs_read_count ++] = instr.oper[i].value.mem.basereg;
             break;
         default:
             break;
         }
     }
-    regs_read_count = regs_read.size();
 
     // build operandString
     std::ostringstream ss;
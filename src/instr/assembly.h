@@ -5,6 +5,7 @@
 #include <string>
 #include <vector>
 #include <memory>  // for std::shared_ptr
+#include <algorithm>  // for std::copy
 #include <assert.h>
 
 #include <capstone/capstone.h>
@@ -13,6 +14,10 @@
 #include "../disasm/riscv-disas.h"
 #endif
 
+/** Operands are stored inline, in an array sized to capstone's own limit,
+    so building an Assembly performs no heap allocation for them. ARM can
+    have up to 36 operands, which is too large to inline, and keeps a vector.
+*/
 class AssemblyOperands {
 public:
     enum OperandsMode {
@@ -41,31 +46,35 @@ private:
 
 #ifdef ARCH_X86_64
 private:
-    std::vector<cs_x86_op> operands;
+    cs_x86_op operands[sizeof(cs_x86::operands) / sizeof(cs_x86_op)];
 
 public:
     AssemblyOperands(const cs_insn &insn)
-        : op_count(insn.detail->x86.op_count),
-          operands(insn.detail->x86.operands,
-                   insn.detail->x86.operands + insn.detail->x86.op_count)
-        { overrideCapstone(insn); }
-    const cs_x86_op *getOperands() const { return operands.data(); }
+        : op_count(insn.detail->x86.op_count) {
+
+        std::copy(insn.detail->x86.operands,
+            insn.detail->x86.operands + op_count, operands);
+        overrideCapstone(insn);
+    }
+    const cs_x86_op *getOperands() const { return operands; }
 private:
     void overrideCapstone(const cs_insn &insn);
 #elif defined(ARCH_AARCH64)
 private:
     bool writeback;
-    std::vector<cs_arm64_op> operands;
+    cs_arm64_op operands[sizeof(cs_arm64::operands) / sizeof(cs_arm64_op)];
 
 public:
     AssemblyOperands(const cs_insn &insn)
         : op_count(insn.detail->arm64.op_count),
-          writeback(insn.detail->arm64.writeback),
-          operands(insn.detail->arm64.operands,
-                   insn.detail->arm64.operands + insn.detail->arm64.op_count)
-        { overrideCapstone(insn); }
+          writeback(insn.detail->arm64.writeback) {
+
+        std::copy(insn.detail->arm64.operands,
+            insn.detail->arm64.operands + op_count, operands);
+        overrideCapstone(insn);
+    }
     bool getWriteback() const { return writeback; }
-    const cs_arm64_op *getOperands() const { return operands.data(); }
+    const cs_arm64_op *getOperands() const { return operands; }
 private:
     void overrideCapstone(const cs_insn &insn);
 #elif defined(ARCH_ARM)
@@ -83,21 +92,20 @@ public:
     const cs_arm_op *getOperands() const { return operands.data(); }
 #elif defined(ARCH_RISCV)
 private:
-    std::vector<rv_oper> operands;
+    rv_oper operands[sizeof(rv_instr::oper) / sizeof(rv_oper)];
 public:
     AssemblyOperands(const cs_insn &) {
         // should never be reached on RISC-V
         assert(0);
     }
 
-    AssemblyOperands(const rv_instr &instr)
-        : op_count(instr.oper_count),
-        operands(instr.oper, instr.oper + instr.oper_count) {}
+    AssemblyOperands(const rv_instr &instr) : op_count(instr.oper_count)
+        { std::copy(instr.oper, instr.oper + op_count, operands); }
 
-    const rv_oper *getOperands() const { return operands.data(); }
+    const rv_oper *getOperands() const { return operands; }
 #endif
 public:
-    AssemblyOperands() {}
+    AssemblyOperands() : op_count(0) {}
     size_t getOpCount() const { return op_count; }
     OperandsMode getMode() const;
 };
@@ -110,47 +118,57 @@ public:
         MODE_UNKNOWN
     };
 
+    enum {
+        MAX_BYTES = sizeof(cs_insn::bytes),
+        MAX_REGS_READ = sizeof(cs_detail::regs_read)
+            / sizeof(cs_detail::regs_read[0]),
+        MAX_REGS_WRITE = sizeof(cs_detail::regs_write)
+            / sizeof(cs_detail::regs_write[0]),
+    };
+
 private:
     unsigned int id;
-    std::vector<uint8_t> bytes;
+    uint8_t size;
+    uint8_t regs_read_count;            // implicit read is not being used
+    uint8_t regs_write_count;           // effectively?
+    uint8_t bytes[MAX_BYTES];
+    uint16_t regs_read[MAX_REGS_READ];
+    uint16_t regs_write[MAX_REGS_WRITE];
     std::string mnemonic;
     std::string operandString;
     AssemblyOperands operands;
 
-    size_t regs_read_count;             // implicit read is not being used
-    std::vector<uint8_t> regs_read;     // effectively?
-    size_t regs_write_count;
-    std::vector<uint8_t> regs_write;
-
 public:
-    Assembly() {}
+    Assembly() : id(0), size(0), regs_read_count(0), regs_write_count(0) {}
     Assembly(const cs_insn &insn)
-        : id(insn.id),
-          bytes(insn.bytes, insn.bytes + insn.size),
-          mnemonic(insn.mnemonic), operandString(insn.op_str),
-          operands(insn),
+        : id(insn.id), size(insn.size),
           regs_read_count(insn.detail->regs_read_count),
-          regs_read(insn.detail->regs_read,
-                     insn.detail->regs_read + insn.detail->regs_read_count),
           regs_write_count(insn.detail->regs_write_count),
-          regs_write(insn.detail->regs_write,
-                     insn.detail->regs_write + insn.detail->regs_write_count)
-        { overrideCapstone(insn); }
+          mnemonic(insn.mnemonic), operandString(insn.op_str),
+          operands(insn) {
+
+        std::copy(insn.bytes, insn.bytes + size, bytes);
+        std::copy(insn.detail->regs_read,
+            insn.detail->regs_read + regs_read_count, regs_read);
+        std::copy(insn.detail->regs_write,
+            insn.detail->regs_write + regs_write_count, regs_write);
+        overrideCapstone(insn);
+    }
 #ifdef ARCH_RISCV
     Assembly(const rv_instr &instr);
 #endif
 
     unsigned int getId() const { return id; }
-    size_t getSize() const { return bytes.size(); }
+    size_t getSize() const { return size; }
     const char *getBytes() const
-        { return reinterpret_cast<const char *>(bytes.data()); }
+        { return reinterpret_cast<const char *>(bytes); }
     const std::string &getMnemonic() const { return mnemonic; }
     const std::string &getOpStr() const { return operandString; }
     const AssemblyOperands *getAsmOperands() const { return &operands; }
     size_t getImplicitRegsReadCount() const { return regs_read_count; }
-    const uint8_t *getImplicitRegsRead() const { return regs_read.data(); }
+    const uint16_t *getImplicitRegsRead() const { return regs_read; }
     size_t getImplicitRegsWriteCount() const { return regs_write_count; }
-    const uint8_t *getImplicitRegsWrite() const { return regs_write.data(); }
+    const uint16_t *getImplicitRegsWrite() const { return regs_write; }
 
 #ifdef ARCH_AARCH64
     bool isPreIndex() const;
@@ -158,7 +176,7 @@ public:
 #endif
 #ifdef ARCH_ARM
     ExecutionMode getExecutionMode() const
-        { return insn.size == 2 ? MODE_THUMB : MODE_ARM; }
+        { return size == 2 ? MODE_THUMB : MODE_ARM; }
 #endif
 
 private:
@@ -32,8 +32,8 @@ void Instruction::serialize(ChunkSerializerOperations &op,
 
     // not called for Functions, just for PLTTrampolines
 #if 1
-    writer.write(getAddress());
-    writer.write(op.assign(getPreviousSibling() ? getPreviousSibling() : getParent()));
+    writer.writeVarint(getAddress());
+    writer.writeID(op.assign(getPreviousSibling() ? getPreviousSibling() : getParent()));
 
     InstrSerializer(op).serialize(getSemantic(), writer);
 #endif
@@ -44,7 +44,7 @@ bool Instruction::deserialize(ChunkSerializerOperations &op,
 
     // not called for Functions, just for PLTTrampolines
 #if 1
-    auto address = reader.read<address_t>();
+    auto address = reader.readVarint<address_t>();
     //setPosition(new AbsolutePosition(address));
     auto afterThis = op.lookup(reader.readID());
     setPosition(new SubsequentPosition(afterThis));
@@ -4,13 +4,14 @@
 #include "chunk/chunk.h"
 #include "archive/chunktypes.h"
 #include "types.h"
+#include "util/slab.h"
 
 class InstructionSemantic;
 class SemanticVisitor;
 class ChunkVisitor;
 
 class Instruction : public ChunkSerializerImpl<TYPE_Instruction,
-    AddressableChunkImpl> {
+    AddressableChunkImpl>, public SlabAllocated {
 private:
     InstructionSemantic *semantic;
 public:
@@ -381,19 +381,28 @@ void LinkedInstruction::makeAllLinked(Module *module) {
     if(list.size() > 0) {
         resolveLinks(module, list);
     } else {
-        DataFlow df;
-        LiveRegister live;
+        // most ADRP pairs sit within one block; use-def is only needed
+        // for functions where some pair may not
         PointerDetection pd;
+        std::vector<Function *> useDefList;
         for(auto func : CIter::functions(module)) {
+            if(!pd.detectLocal(func)) useDefList.push_back(func);
+        }
+        LOG(10, "pointer detection needs use-def for " << std::dec
+            << useDefList.size() << " functions");
+
+        DataFlow df;
+        LiveRegister live;
+        for(auto func : useDefList) {
             df.addUseDefFor(func);
         }
-        for(auto func : CIter::functions(module)) {
+        for(auto func : useDefList) {
             live.detect(df.getWorkingSet(func));
         }
-        for(auto func : CIter::functions(module)) {
+        for(auto func : useDefList) {
             df.adjustCallUse(&live, func, module);
         }
-        for(auto func : CIter::functions(module)) {
+        for(auto func : useDefList) {
             pd.detect(df.getWorkingSet(func));
         }
 
@@ -34,31 +34,31 @@ unsigned long LinkedInstructionBase::calculateDisplacement() {
     return disp;
 }
 
+// The raw bytes are used rather than the Assembly, which may have to be
+// decoded again (or never was, for InstrTemplate instructions).
 void LinkedInstructionBase::writeTo(char *target, bool useDisp) {
-    auto assembly = getAssembly();
+    const auto &bytes = getData();
     auto dispSize = getDispSize();
     unsigned long int newDisp = useDisp ? calculateDisplacement() : 0;
     int dispOffset = getDispOffset();
     int i = 0;
-    std::memcpy(target + i, assembly->getBytes() + i, dispOffset);
+    std::memcpy(target + i, bytes.data() + i, dispOffset);
     i += dispOffset;
     std::memcpy(target + i, &newDisp, dispSize);
     i += dispSize;
-    std::memcpy(target + i, assembly->getBytes() + i,
-        assembly->getSize() - dispSize - dispOffset);
+    std::memcpy(target + i, bytes.data() + i,
+        bytes.size() - dispSize - dispOffset);
 }
 
 void LinkedInstructionBase::writeTo(std::string &target, bool useDisp) {
-    auto assembly = getAssembly();
+    const auto &bytes = getData();
     auto dispSize = getDispSize();
     unsigned long int newDisp = useDisp ? calculateDisplacement() : 0;
     int dispOffset = getDispOffset();
-    target.append(reinterpret_cast<const char *>(assembly->getBytes()),
-        dispOffset);
+    target.append(bytes.data(), dispOffset);
     target.append(reinterpret_cast<const char *>(&newDisp), dispSize);
-    target.append(reinterpret_cast<const char *>(assembly->getBytes())
-        + dispOffset + dispSize,
-        assembly->getSize() - dispSize - dispOffset);
+    target.append(bytes.data() + dispOffset + dispSize,
+        bytes.size() - dispSize - dispOffset);
 }
 
 void LinkedInstructionBase::regenerateAssembly() {
@@ -108,9 +108,54 @@ LinkedInstructionBase *LinkedInstruction::makeLinked(Module *module,
     return linked;
 }
 
+Chunk *InferredTargetMap::getContaining(address_t target) const {
+    auto it = containing.find(target);
+    return (it != containing.end() ? (*it).second : nullptr);
+}
+
+Function *InferredTargetMap::getStart(address_t target) const {
+    auto it = start.find(target);
+    return (it != start.end() ? (*it).second : nullptr);
+}
+
+static bool inferImmediates(Module *module) {
+    auto elfMap = module->getElfSpace()->getElfMap();
+    return elfMap->isExecutable() && !elfMap->hasRelocations();
+}
+
+bool LinkedInstruction::getOperandTargets(Module *module,
+    Instruction *instruction, AssemblyPtr assembly,
+    std::vector<address_t> &dispTargets, std::vector<address_t> &immTargets) {
+
+    bool found = false;
+    auto asmOps = assembly->getAsmOperands();
+    for(size_t i = 0; i < asmOps->getOpCount(); i ++) {
+        const cs_x86_op *op = &asmOps->getOperands()[i];
+        if(MakeSemantic::isRIPRelative(&*assembly, i)) {
+            dispTargets.push_back(
+                (instruction->getAddress() + instruction->getSize())
+                + op->mem.disp);
+            found = true;
+        }
+        else if(op->type == X86_OP_IMM && inferImmediates(module)) {
+            immTargets.push_back(op->imm);
+            found = true;
+        }
+    }
+    return found;
+}
+
 LinkedInstructionBase *LinkedInstruction::makeLinked(Module *module,
     Instruction *instruction, AssemblyPtr assembly) {
 
+    return makeLinked(module, instruction, assembly,
+        static_cast<const InferredTargetMap *>(nullptr));
+}
+
+LinkedInstructionBase *LinkedInstruction::makeLinked(Module *module,
+    Instruction *instruction, AssemblyPtr assembly,
+    const InferredTargetMap *targets) {
+
     auto asmOps = assembly->getAsmOperands();
     int immIndex = -1;
     int dispIndex = -1;
@@ -123,11 +168,17 @@ LinkedInstructionBase *LinkedInstruction::makeLinked(Module *module,
             address_t target
                 = (instruction->getAddress() + instruction->getSize())
                 + op->mem.disp;
-            Chunk *found = CIter::spatial(module->getFunctionList())
-                ->findContaining(target);
-            if(!found && module->getPLTList()) {
-                found = CIter::spatial(module->getPLTList())
-                    ->find(target);
+            Chunk *found = nullptr;
+            if(targets) {
+                found = targets->getContaining(target);
+            }
+            else {
+                found = CIter::spatial(module->getFunctionList())
+                    ->findContaining(target);
+                if(!found && module->getPLTList()) {
+                    found = CIter::spatial(module->getPLTList())
+                        ->find(target);
+                }
             }
             if(found) {
                 auto scope = (found == instruction->getParent()->getParent()) ?
@@ -174,11 +225,10 @@ LinkedInstructionBase *LinkedInstruction::makeLinked(Module *module,
             dispIndex = i;
         }
         else if(op->type == X86_OP_IMM) {
-            auto elfMap = module->getElfSpace()->getElfMap();
-            if(elfMap->isExecutable() && !elfMap->hasRelocations()) {
+            if(inferImmediates(module)) {
                 address_t target = op->imm;
-                auto found = CIter::spatial(module->getFunctionList())
-                    ->find(target);
+                auto found = targets ? targets->getStart(target)
+                    : CIter::spatial(module->getFunctionList())->find(target);
                 if(found) {
                     immLink = new AbsoluteNormalLink(found,
                         Link::SCOPE_WITHIN_MODULE);
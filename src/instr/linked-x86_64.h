@@ -1,12 +1,16 @@
 #ifndef EGALITO_INSTR_LINKED_X86_64_H
 #define EGALITO_INSTR_LINKED_X86_64_H
 
+#include <unordered_map>
+#include <vector>
 #include "semantic.h"
 #include "isolated.h"
 
 // Defines LinkedInstruction, ControlFlowInstruction, etc for x86_64.
 
 #ifdef ARCH_X86_64
+class Chunk;
+class Function;
 class Instruction;
 class Module;
 class Reloc;
@@ -48,12 +52,39 @@ protected:
     void makeDisplacementInfo();
 };
 
+/** The chunks that makeLinked() looks up for operand targets, found for a
+    whole Module at once by InferLinksPass. getContaining() gives the
+    Function containing a RIP-relative target, or the PLTTrampoline at it;
+    getStart() gives the Function starting at an immediate target.
+*/
+class InferredTargetMap {
+private:
+    std::unordered_map<address_t, Chunk *> containing;
+    std::unordered_map<address_t, Function *> start;
+public:
+    void setContaining(address_t target, Chunk *chunk)
+        { containing[target] = chunk; }
+    void setStart(address_t target, Function *function)
+        { start[target] = function; }
+    Chunk *getContaining(address_t target) const;
+    Function *getStart(address_t target) const;
+};
+
 class LinkedInstruction : public LinkedInstructionBase {
 public:
     using LinkedInstructionBase::LinkedInstructionBase;
 
     static LinkedInstructionBase *makeLinked(Module *module,
         Instruction *instruction, AssemblyPtr assembly);
+    static LinkedInstructionBase *makeLinked(Module *module,
+        Instruction *instruction, AssemblyPtr assembly,
+        const InferredTargetMap *targets);
+    /** Appends the operand targets that makeLinked() would look up, and
+        returns false if there are none.
+    */
+    static bool getOperandTargets(Module *module, Instruction *instruction,
+        AssemblyPtr assembly, std::vector<address_t> &dispTargets,
+        std::vector<address_t> &immTargets);
     static LinkedInstructionBase *makeLinked(Module *module,
         Instruction *instruction, AssemblyPtr assembly, Reloc *reloc);
 
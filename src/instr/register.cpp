@@ -22,9 +22,8 @@ const int X86Register::mappings[][5] = {
 };
 
 const char *X86Register::getRepresentativeName(int reg) {
-    static DisasmHandle handle;
     if(reg == X86Register::FLAGS) return "flags";
-    return cs_reg_name(handle.raw(), mappings[reg][4]);
+    return cs_reg_name(DisasmHandle::forThread(false).raw(), mappings[reg][4]);
 }
 
 int X86Register::convertToPhysicalINT(int id) {
@@ -7,6 +7,8 @@
 #include "storage.h"
 #include "visitor.h"
 #include "types.h"
+#include "chunk/linkindex.h"
+#include "util/slab.h"
 
 class Link;
 
@@ -14,8 +16,9 @@ class Link;
 
     The getAssembly() method provides details of the instruction operands etc,
     and the Assembly content will be created on the fly if necessary.
+    Semantics are slab-allocated, since there is one per instruction.
 */
-class InstructionSemantic {
+class InstructionSemantic : public SlabAllocated {
 public:
     virtual ~InstructionSemantic() {}
 
@@ -59,9 +62,14 @@ private:
     Link *link;
 public:
     LinkDecorator() : link(nullptr) {}
+    virtual ~LinkDecorator()
+        { if(auto index = LinkIndex::getInstance()) index->remove(this); }
 
     virtual Link *getLink() const { return link; }
-    virtual void setLink(Link *link) { this->link = link; }
+    virtual void setLink(Link *link) {
+        this->link = link;
+        if(auto index = LinkIndex::getInstance()) index->update(this, link);
+    }
 };
 
 #endif
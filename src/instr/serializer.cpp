@@ -92,7 +92,7 @@ void SemanticSerializer::visit(LinkedInstruction *linked) {
 void SemanticSerializer::visit(ControlFlowInstruction *controlFlow) {
     writer.write<uint8_t>(TYPE_ControlFlowInstruction);
 #ifdef ARCH_X86_64
-    writer.write<uint32_t>(controlFlow->getId());
+    writer.writeVarint(controlFlow->getId());
 #endif
     writer.writeID(op.assign(controlFlow->getSource()));
 #ifdef ARCH_X86_64
@@ -127,7 +127,7 @@ void SemanticSerializer::visit(IndirectJumpInstruction *indirect) {
     indirect->accept(&instrWriter);
     writer.writeBytes<uint8_t>(instrWriter.get());
 
-    writer.write<uint32_t>(indirect->getJumpTables().size());
+    writer.writeVarint(indirect->getJumpTables().size());
     for(auto jumpTable : indirect->getJumpTables()) {
         writer.writeID(op.assign(jumpTable));
     }
@@ -135,7 +135,7 @@ void SemanticSerializer::visit(IndirectJumpInstruction *indirect) {
 
 void SemanticSerializer::visit(IndirectCallInstruction *indirect) {
     writer.write<uint8_t>(TYPE_IndirectCallInstruction);
-    writer.write<uint32_t>(indirect->getRegister());
+    writer.writeVarint(indirect->getRegister());
 
     InstrWriterGetData instrWriter;
     indirect->accept(&instrWriter);
@@ -181,14 +181,14 @@ InstructionSemantic *InstrSerializer::deserialize(Instruction *instruction,
             static_cast<Register>(reg), mnemonic);
         semantic->setData(reader.readBytes<uint8_t>());
 
-        auto tableCount = reader.read<uint32_t>();
+        auto tableCount = reader.readVarint<uint32_t>();
         for(uint32_t i = 0; i < tableCount; i ++) {
             semantic->addJumpTable(op.lookupAs<JumpTable>(reader.readID()));
         }
         return semantic;
     }
     case TYPE_IndirectCallInstruction: {
-        auto reg = reader.read<uint32_t>();
+        auto reg = reader.readVarint<uint32_t>();
         auto semantic = new IndirectCallInstruction(
             static_cast<Register>(reg));
         semantic->setData(reader.readBytes<uint8_t>());
@@ -203,7 +203,7 @@ InstructionSemantic *InstrSerializer::deserialize(Instruction *instruction,
     }
     case TYPE_ControlFlowInstruction: {
 #ifdef ARCH_X86_64
-        auto id = reader.read<uint32_t>();  // NOT a chunk ID
+        auto id = reader.readVarint<uint32_t>();  // NOT a chunk ID
         auto source = op.lookupAs<Instruction>(reader.readID());
         auto opcode = reader.readBytes<uint8_t>();
         auto mnemonic = reader.readString();
@@ -284,7 +284,7 @@ void LinkSerializer::serialize(Link *link, ArchiveStreamWriter &writer) {
         writer.write<uint8_t>(link->getScope());
         auto target = link->getTarget();
         writer.writeID(op.assign(&*target));
-        writer.write(link->getTargetAddress() - target->getAddress());
+        writer.writeVarint(link->getTargetAddress() - target->getAddress());
     }
     else if(auto v = dynamic_cast<PLTLink *>(link)) {
         writer.write<uint8_t>(TYPE_PLTLink);
@@ -310,19 +310,19 @@ void LinkSerializer::serialize(Link *link, ArchiveStreamWriter &writer) {
         writer.write<uint8_t>(TYPE_AbsoluteDataLink);
         auto section = link->getTarget();
         writer.writeID(op.assign(&*section));
-        writer.write(link->getTargetAddress() - section->getAddress());
+        writer.writeVarint(link->getTargetAddress() - section->getAddress());
     }
     else if(dynamic_cast<DataOffsetLink *>(link)) {
         writer.write<uint8_t>(TYPE_DataOffsetLink);
         writer.write<uint8_t>(link->getScope());
         auto section = link->getTarget();
         writer.writeID(op.assign(&*section));
-        writer.write(link->getTargetAddress() - section->getAddress());
+        writer.writeVarint(link->getTargetAddress() - section->getAddress());
     }
     else if(auto v = dynamic_cast<TLSDataOffsetLink *>(link)) {
         writer.write<uint8_t>(TYPE_TLSDataOffsetLink);
         writer.writeID(op.assign(v->getTLSRegion()));
-        writer.write(v->getRawTarget());
+        writer.writeVarint(v->getRawTarget());
         writer.write<bool>(v->getSymbol() != nullptr);
         if(v->getSymbol()) {
             writer.writeString(v->getSymbol()->getName());  // should be WEAK
@@ -330,7 +330,7 @@ void LinkSerializer::serialize(Link *link, ArchiveStreamWriter &writer) {
     }
     else if(dynamic_cast<UnresolvedLink *>(link)) {
         writer.write<uint8_t>(TYPE_UnresolvedLink);
-        writer.write(link->getTargetAddress());
+        writer.writeVarint(link->getTargetAddress());
     }
     else if(auto v = dynamic_cast<ImmAndDispLink *>(link)) {
         writer.write<uint8_t>(TYPE_ImmAndDispLink);
@@ -359,7 +359,7 @@ Link *LinkSerializer::deserialize(ArchiveStreamReader &reader) {
     case TYPE_OffsetLink: {
         auto scope = static_cast<Link::LinkScope>(reader.read<uint8_t>());
         auto target = deserializeLinkTarget(reader);
-        auto offset = reader.read<address_t>();
+        auto offset = reader.readVarint<address_t>();
         return new OffsetLink(target, offset, scope);
     }
     case TYPE_PLTLink:
@@ -376,18 +376,18 @@ Link *LinkSerializer::deserialize(ArchiveStreamReader &reader) {
         return new UnresolvedLink(0);  // unsupported
     case TYPE_AbsoluteDataLink: {
         auto section = dynamic_cast<DataSection *>(deserializeLinkTarget(reader));
-        auto offset = reader.read<address_t>();
+        auto offset = reader.readVarint<address_t>();
         return new AbsoluteDataLink(section, offset);
     }
     case TYPE_DataOffsetLink: {
         auto scope = static_cast<Link::LinkScope>(reader.read<uint8_t>());
         auto section = dynamic_cast<DataSection *>(deserializeLinkTarget(reader));
-        auto offset = reader.read<address_t>();
+        auto offset = reader.readVarint<address_t>();
         return new DataOffsetLink(section, offset, scope);
     }
     case TYPE_TLSDataOffsetLink: {
         auto tls = dynamic_cast<TLSDataRegion *>(deserializeLinkTarget(reader));
-        auto rawTarget = reader.read<address_t>();
+        auto rawTarget = reader.readVarint<address_t>();
         auto hasSymbol = reader.read<bool>();
         Symbol *symbol = nullptr;
         if(hasSymbol) {
@@ -398,7 +398,7 @@ Link *LinkSerializer::deserialize(ArchiveStreamReader &reader) {
         return new TLSDataOffsetLink(tls, symbol, rawTarget);
     }
     case TYPE_UnresolvedLink:
-        return new UnresolvedLink(reader.read<address_t>());
+        return new UnresolvedLink(reader.readVarint<address_t>());
     case TYPE_ImmAndDispLink: {
         auto immScope = static_cast<Link::LinkScope>(reader.read<uint8_t>());
         auto immLink = new NormalLink(op.lookup(reader.readID()), immScope);
@@ -413,14 +413,6 @@ Link *LinkSerializer::deserialize(ArchiveStreamReader &reader) {
 
 Chunk *LinkSerializer::deserializeLinkTarget(ArchiveStreamReader &reader) {
     auto id = reader.readID();  // can be NoneID
-    Chunk *target = op.lookup(id);  // can be nullptr
-    if(target && !target->getPosition()) {
-        try {
-            target->setPosition(new AbsolutePosition(-1));
-        }
-        catch(const char *) {
-            // can't set position for this type
-        }
-    }
-    return target;
+    op.setPlaceholderPosition(id);
+    return op.lookup(id);  // can be nullptr
 }
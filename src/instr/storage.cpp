@@ -1,7 +1,9 @@
+#include <cstdlib>  // for getenv, strtoul
 #include "semantic.h"
 #include "instr.h"
 #include "disasm/handle.h"
 #include "disasm/disassemble.h"
+#include "log/log.h"
 
 const std::string &InstructionStorage::getData() const {
     return rawData;
@@ -12,9 +14,13 @@ size_t InstructionStorage::getSize() const {
 }
 
 AssemblyPtr InstructionStorage::getAssembly(address_t address) {
+    auto factory = AssemblyFactory::getInstance();
     AssemblyPtr ptr = assembly.lock();
-    if(!ptr) {
-        ptr = AssemblyFactory::getInstance()->buildAssembly(this, address);
+    if(ptr) {
+        factory->recordHit(ptr);
+    }
+    else {
+        ptr = factory->buildAssembly(this, address);
         this->assembly = ptr;
     }
     return ptr;
@@ -24,28 +30,75 @@ void InstructionStorage::setAssembly(AssemblyPtr assembly) {
     AssemblyFactory::getInstance()->registerAssembly(assembly);
     this->assembly = assembly;
 
-    if(rawData.empty()) {
-        rawData.assign(assembly->getBytes(), assembly->getSize());
-    }
+    // the bytes always follow the Assembly, since writers use the bytes
+    rawData.assign(assembly->getBytes(), assembly->getSize());
 }
 
 AssemblyFactory AssemblyFactory::instance;
 
+AssemblyFactory::AssemblyFactory() : capacity(0), hits(0), misses(0) {
+    const char *variable = getenv("EGALITO_ASSEMBLY_CACHE");
+    if(variable && *variable) {
+        capacity = std::strtoul(variable, nullptr, 0);
+    }
+}
+
 AssemblyPtr AssemblyFactory::buildAssembly(InstructionStorage *storage,
     address_t address) {
 
-    static DisasmHandle handle(true);
-    auto assembly = DisassembleInstruction(handle, true)
+    misses ++;
+    auto assembly = DisassembleInstruction(DisasmHandle::forThread(), true)
         .allocateAssembly(storage->getData(), address);
     auto ptr = AssemblyPtr(assembly);
-    assemblyList.push_back(ptr);
+    registerAssembly(ptr);
     return ptr;
 }
 
 void AssemblyFactory::registerAssembly(AssemblyPtr assembly) {
-    assemblyList.push_back(assembly);
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto it = lruMap.find(assembly.get());
+    if(it != lruMap.end()) {
+        lruList.splice(lruList.begin(), lruList, it->second);
+        return;
+    }
+    lruList.push_front(assembly);
+    lruMap[assembly.get()] = lruList.begin();
+    evictIfNeeded();
+}
+
+void AssemblyFactory::recordHit(const AssemblyPtr &assembly) {
+    hits ++;
+    if(!capacity) return;  // ordering only matters when evicting
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto it = lruMap.find(assembly.get());
+    if(it != lruMap.end()) {
+        lruList.splice(lruList.begin(), lruList, it->second);
+    }
 }
 
 void AssemblyFactory::clearCache() {
-    assemblyList.clear();
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    LOG(1, "assembly cache: " << std::dec << lruList.size() << " entries, "
+        << hits << " hits, " << misses << " misses");
+    lruMap.clear();
+    lruList.clear();
+}
+
+void AssemblyFactory::setCapacity(size_t capacity) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    this->capacity = capacity;
+    evictIfNeeded();
+}
+
+size_t AssemblyFactory::getCacheSize() {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    return lruList.size();
+}
+
+void AssemblyFactory::evictIfNeeded() {
+    while(capacity && lruList.size() > capacity) {
+        lruMap.erase(lruList.back().get());
+        lruList.pop_back();
+    }
 }
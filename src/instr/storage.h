@@ -2,7 +2,10 @@
 #define EGALITO_INSTR_STORAGE_H
 
 #include <string>
-#include <vector>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
 #include "assembly.h"
 
 class InstructionStorage {
@@ -20,17 +23,46 @@ public:
     void clearAssembly() { assembly.reset(); }
 };
 
+/** Keeps Assemblies alive on behalf of the InstructionStorage weak_ptrs.
+
+    The cache is LRU-ordered and may be bounded by setting the
+    EGALITO_ASSEMBLY_CACHE environment variable to a maximum entry count;
+    evicted Assemblies are rebuilt on demand from the instruction bytes.
+    Rebuilt Assemblies are decoded at address 0, so the default is
+    unbounded until all users of address-dependent operands (such as
+    branch immediates) go through Links.
+
+    One factory is shared by every Conductor in the process. It only
+    caches what can be rebuilt, and is locked, so concurrent pipelines
+    share nothing but the hit rate.
+*/
 class AssemblyFactory {
 private:
     static AssemblyFactory instance;
 public:
     static AssemblyFactory *getInstance() { return &instance; }
 private:
-    std::vector<AssemblyPtr> assemblyList;
+    typedef std::list<AssemblyPtr> LRUList;
+    std::mutex cacheMutex;  // disassembly may run on several threads
+    LRUList lruList;  // most recently used first
+    std::unordered_map<Assembly *, LRUList::iterator> lruMap;
+    size_t capacity;  // 0 means unbounded
+    std::atomic<unsigned long> hits, misses;
 public:
+    AssemblyFactory();
+
     AssemblyPtr buildAssembly(InstructionStorage *storage, address_t address);
     void registerAssembly(AssemblyPtr assembly);
+    void recordHit(const AssemblyPtr &assembly);
     void clearCache();
+
+    void setCapacity(size_t capacity);
+    size_t getCapacity() const { return capacity; }
+    size_t getCacheSize();
+    unsigned long getHitCount() const { return hits; }
+    unsigned long getMissCount() const { return misses; }
+private:
+    void evictIfNeeded();
 };
 
 #endif
@@ -0,0 +1,63 @@
+#include "template.h"
+#include "concrete.h"
+#include "instr.h"
+#include "chunk/link.h"
+
+#ifdef ARCH_X86_64
+// the encodings are checked here once, rather than by capstone at each use
+static_assert(InstrTemplate::push(X86Register::R11).getSize() == 2
+    && InstrTemplate::push(X86Register::R11)[1] == 0x53, "push r11");
+static_assert(InstrTemplate::movImm(X86Register::R0, 2)[2] == 0xc0
+    && InstrTemplate::movImm(X86Register::R0, 2).getSize() == 7, "mov $2,%rax");
+static_assert(InstrTemplate::leaRip(X86Register::R10)[0] == 0x4c
+    && InstrTemplate::leaRip(X86Register::R10)[2] == 0x15
+    && InstrTemplate::leaRip(X86Register::R10).getDispOffset() == 3,
+    "lea 0(%rip),%r10");
+static_assert(InstrTemplate::leaStack(-0x80)[4] == 0x80
+    && InstrTemplate::leaStack(0x80).getSize() == 8, "lea 0x80(%rsp),%rsp");
+static_assert(InstrTemplate::subStack(8)[2] == 0xec, "sub $8,%rsp");
+
+Instruction *InstrTemplate::make(const InstrEncoding &encoding) {
+    auto instr = new Instruction();
+    SemanticImpl *semantic;
+    if(encoding.getSize() == 1 && encoding[0] == 0xc3) {
+        semantic = new ReturnInstruction();
+    }
+    else {
+        semantic = new IsolatedInstruction();
+    }
+    semantic->setData(encoding.toString());
+    instr->setSemantic(semantic);
+    return instr;
+}
+
+Instruction *InstrTemplate::makeLinked(const InstrEncoding &encoding,
+    Link *link) {
+
+    auto instr = new Instruction();
+    auto semantic = new LinkedInstruction(instr);
+    semantic->setData(encoding.toString());
+    semantic->setLink(link);
+    semantic->setIndex(0, 4, encoding.getDispOffset());
+    instr->setSemantic(semantic);
+    return instr;
+}
+
+Instruction *InstrTemplate::makeCall(Chunk *target) {
+    auto instr = new Instruction();
+    auto semantic = new ControlFlowInstruction(
+        X86_INS_CALL, instr, "\xe8", "callq", 4);
+    semantic->setLink(new NormalLink(target, Link::SCOPE_EXTERNAL_JUMP));
+    instr->setSemantic(semantic);
+    return instr;
+}
+
+Instruction *InstrTemplate::makeJump(Chunk *target) {
+    auto instr = new Instruction();
+    auto semantic = new ControlFlowInstruction(
+        X86_INS_JMP, instr, "\xe9", "jmp", 4);
+    semantic->setLink(new NormalLink(target, Link::SCOPE_EXTERNAL_JUMP));
+    instr->setSemantic(semantic);
+    return instr;
+}
+#endif
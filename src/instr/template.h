@@ -0,0 +1,142 @@
+#ifndef EGALITO_INSTR_TEMPLATE_H
+#define EGALITO_INSTR_TEMPLATE_H
+
+#include <cstdint>
+#include <string>
+#include <initializer_list>
+
+class Instruction;
+class Chunk;
+class Link;
+
+/** The bytes of one x86_64 instruction, small enough to be built by
+    constexpr functions.
+*/
+class InstrEncoding {
+public:
+    static const size_t MAX_SIZE = 15;
+private:
+    unsigned char data[MAX_SIZE];
+    size_t length;
+    size_t dispOffset;  // of a rip-relative displacement, if any
+public:
+    constexpr InstrEncoding() : data{}, length(0), dispOffset(0) {}
+    constexpr InstrEncoding(std::initializer_list<unsigned char> bytes)
+        : data{}, length(0), dispOffset(0)
+        { for(auto b : bytes) add(b); }
+
+    constexpr InstrEncoding &add(unsigned char byte)
+        { data[length++] = byte; return *this; }
+    constexpr InstrEncoding &addImm32(uint32_t value) {
+        for(int i = 0; i < 4; i ++) add((value >> (8*i)) & 0xff);
+        return *this;
+    }
+    constexpr InstrEncoding &addDisp32()
+        { dispOffset = length; return addImm32(0); }
+
+    constexpr size_t getSize() const { return length; }
+    constexpr size_t getDispOffset() const { return dispOffset; }
+    constexpr unsigned char operator [] (size_t i) const { return data[i]; }
+    std::string toString() const
+        { return std::string(reinterpret_cast<const char *>(data), length); }
+};
+
+/** Encodings of the instructions that instrumentation inserts, and
+    Instructions made from them without a round-trip through capstone.
+    Registers are X86Register numbers (R0-R15), not capstone ids.
+
+    The made Instructions get the same semantic types as from
+    Disassemble::instruction(); their Assembly is only decoded if a later
+    analysis asks for it.
+*/
+class InstrTemplate {
+public:
+    static constexpr InstrEncoding push(int reg) {
+        return reg >= 8 ? InstrEncoding{0x41, uint8_t(0x50 + (reg & 7))}
+            : InstrEncoding{uint8_t(0x50 + reg)};
+    }
+    static constexpr InstrEncoding pop(int reg) {
+        return reg >= 8 ? InstrEncoding{0x41, uint8_t(0x58 + (reg & 7))}
+            : InstrEncoding{uint8_t(0x58 + reg)};
+    }
+    static constexpr InstrEncoding pushfq() { return InstrEncoding{0x9c}; }
+    static constexpr InstrEncoding popfq() { return InstrEncoding{0x9d}; }
+
+    /** mov $imm, %reg (64-bit, sign-extended) */
+    static constexpr InstrEncoding movImm(int reg, int32_t imm) {
+        return InstrEncoding{rexW(0, reg), 0xc7, modrm(3, 0, reg)}
+            .addImm32(imm);
+    }
+    /** mov %src, %dest (64-bit) */
+    static constexpr InstrEncoding movReg(int dest, int src)
+        { return InstrEncoding{rexW(src, dest), 0x89, modrm(3, src, dest)}; }
+    /** cmp %reg, disp(%base) (64-bit); base must not be %rip */
+    static constexpr InstrEncoding cmpMem(int reg, int base, int32_t disp) {
+        return memOperand(InstrEncoding{rexW(reg, base), 0x39},
+            reg, base, disp);
+    }
+    /** lea 0(%rip), %reg; the displacement is filled in from a link */
+    static constexpr InstrEncoding leaRip(int reg)
+        { return InstrEncoding{rexW(reg, 0), 0x8d, modrm(0, reg, 5)}.addDisp32(); }
+    /** lea offset(%rsp), %rsp, which leaves the flags alone */
+    static constexpr InstrEncoding leaStack(int32_t offset) {
+        return offset >= -128 && offset < 128
+            ? InstrEncoding{0x48, 0x8d, 0x64, 0x24, uint8_t(offset)}
+            : InstrEncoding{0x48, 0x8d, 0xa4, 0x24}.addImm32(offset);
+    }
+    /** add $imm, %rsp / sub $imm, %rsp */
+    static constexpr InstrEncoding addStack(int32_t imm)
+        { return arithStack(0, imm); }
+    static constexpr InstrEncoding subStack(int32_t imm)
+        { return arithStack(5, imm); }
+
+    static constexpr InstrEncoding nop() { return InstrEncoding{0x90}; }
+    /** The recommended multi-byte nop of 1 to MAX_NOP_SIZE bytes. */
+    static constexpr InstrEncoding nop(size_t size) {
+        return size <= 1 ? InstrEncoding{0x90}
+            : size == 2 ? InstrEncoding{0x66, 0x90}
+            : size == 3 ? InstrEncoding{0x0f, 0x1f, 0x00}
+            : size == 4 ? InstrEncoding{0x0f, 0x1f, 0x40, 0x00}
+            : size == 5 ? InstrEncoding{0x0f, 0x1f, 0x44, 0x00, 0x00}
+            : size == 6 ? InstrEncoding{0x66, 0x0f, 0x1f, 0x44, 0x00, 0x00}
+            : size == 7 ? InstrEncoding{0x0f, 0x1f, 0x80}.addImm32(0)
+            : size == 8 ? InstrEncoding{0x0f, 0x1f, 0x84, 0x00}.addImm32(0)
+            : InstrEncoding{0x66, 0x0f, 0x1f, 0x84, 0x00}.addImm32(0);
+    }
+    static const size_t MAX_NOP_SIZE = 9;
+    static constexpr InstrEncoding ret() { return InstrEncoding{0xc3}; }
+    static constexpr InstrEncoding int3() { return InstrEncoding{0xcc}; }
+    static constexpr InstrEncoding syscall() { return InstrEncoding{0x0f, 0x05}; }
+public:
+    /** An IsolatedInstruction (or ReturnInstruction, for ret). */
+    static Instruction *make(const InstrEncoding &encoding);
+    /** A LinkedInstruction whose rip-relative displacement targets link. */
+    static Instruction *makeLinked(const InstrEncoding &encoding, Link *link);
+    /** call rel32 / jmp rel32 to target. */
+    static Instruction *makeCall(Chunk *target);
+    static Instruction *makeJump(Chunk *target);
+private:
+    static constexpr uint8_t rexW(int reg, int rm)
+        { return 0x48 | (reg >= 8 ? 0x4 : 0) | (rm >= 8 ? 0x1 : 0); }
+    static constexpr uint8_t modrm(int mod, int reg, int rm)
+        { return (mod << 6) | ((reg & 7) << 3) | (rm & 7); }
+    static constexpr InstrEncoding memOperand(InstrEncoding encoding,
+        int reg, int base, int32_t disp) {
+        // %rbp and %r13 have no form without a displacement; %rsp and
+        // %r12 need a SIB byte
+        int mod = (disp == 0 && (base & 7) != 5) ? 0
+            : (disp >= -128 && disp < 128) ? 1 : 2;
+        encoding.add(modrm(mod, reg, base));
+        if((base & 7) == 4) encoding.add(0x24);
+        if(mod == 1) encoding.add(uint8_t(disp));
+        if(mod == 2) encoding.addImm32(disp);
+        return encoding;
+    }
+    static constexpr InstrEncoding arithStack(int ext, int32_t imm) {
+        return imm >= -128 && imm < 128
+            ? InstrEncoding{0x48, 0x83, modrm(3, ext, 4), uint8_t(imm)}
+            : InstrEncoding{0x48, 0x81, modrm(3, ext, 4)}.addImm32(imm);
+    }
+};
+
+#endif
@@ -4,17 +4,18 @@
 #include "concrete.h"
 
 // IsolatedInstruction
+// The raw bytes always match the Assembly (see InstructionStorage), and
+// asking for the Assembly would decode it again if it was evicted from
+// the AssemblyFactory, or never decoded (InstrTemplate instructions).
 void InstrWriterCString::visit(IsolatedInstruction *isolated) {
-    auto assembly = isolated->getAssembly();
-    std::memcpy(target, assembly->getBytes(), assembly->getSize());
+    const auto &bytes = isolated->getData();
+    std::memcpy(target, bytes.data(), bytes.size());
 }
 void InstrWriterCppString::visit(IsolatedInstruction *isolated) {
-    auto assembly = isolated->getAssembly();
-    target.append(assembly->getBytes(), assembly->getSize());
+    target.append(isolated->getData());
 }
 void InstrWriterGetData::visit(IsolatedInstruction *isolated) {
-    auto assembly = isolated->getAssembly();
-    data.assign(assembly->getBytes(), assembly->getSize());
+    data = isolated->getData();
 }
 
 // LinkedInstruction
@@ -6,7 +6,9 @@
 #include "chunk/concrete.h"
 #include "chunk/gstable.h"
 #include "operation/find2.h"
+#include "runtime/hotpatch.h"
 #include "util/feature.h"
+#include "util/timing.h"
 #include "log/log.h"
 #include "log/temp.h"
 
@@ -22,6 +24,7 @@ void egalito_runtime_init(void) {
 
     if(isFeatureEnabled("EGALITO_USE_GS")) {
         egalito_jit_gs_setup();
+        HotPatchService::start();
     }
     egalito_init_done = true;
 }
@@ -43,6 +46,7 @@ void egalito_callInit(void) {
 void CallInit::makeInitArray(Program *program, int argc, char **argv,
     char **envp, GSTable *gsTable) {
 
+    EgalitoTraceSpan span("CallInit::makeInitArray");
     egalito_init_array[1] = (address_t)argc;
     egalito_init_array[2] = (address_t)argv;
     egalito_init_array[3] = (address_t)envp;
@@ -58,18 +58,13 @@ void DataStructMigrator::migrateList(VTableList *loaderVTableList,
 
     // This relies on VTables having the same name in libegalito
     // as in the loader (i.e. no address in the name).
+    VTableIndex loaderIndex;
+    loaderIndex.add(loaderVTableList, nullptr);
     for(auto vtable : CIter::children(sourceList)) {
-#if 0   // we can not use named iterator for local objects
-        auto named = loaderVTableList->getChildren()->getNamed();
-        auto loaderVTable = named->find(vtable->getName());
-        if(loaderVTable) {
-            migrateTable(loaderVTable, vtable);
-        }
-#endif
-        for(auto loaderVTable : CIter::children(loaderVTableList)) {
-            if(loaderVTable->getName() == vtable->getName()
-                && loaderVTable->getChildren()->getIterable()->getCount()
-                    == vtable->getChildren()->getIterable()->getCount()) {
+        auto &candidates = loaderIndex.getVTables(vtable->getClassName());
+        for(auto loaderVTable : candidates) {
+            if(loaderVTable->getChildren()->getIterable()->getCount()
+                == vtable->getChildren()->getIterable()->getCount()) {
 
                 migrateTable(loaderVTable, vtable);
                 break;
@@ -10,9 +10,31 @@
 #include "conductor/setup.h"
 #include "operation/mutator.h"
 #include "operation/find2.h"
+#include "util/perfecthash.h"
 #include "log/log.h"
 
 extern ConductorSetup *egalito_conductor_setup;
+
+static constexpr const char *functionNames[] = {
+    #define EGALITO_EMULATED_FUNCTION(name) #name,
+    #define EGALITO_EMULATED_DATA(name)
+    #include "emulatorentries.h"
+    #undef EGALITO_EMULATED_FUNCTION
+    #undef EGALITO_EMULATED_DATA
+};
+static constexpr const char *dataNames[] = {
+    #define EGALITO_EMULATED_FUNCTION(name)
+    #define EGALITO_EMULATED_DATA(name) #name,
+    #include "emulatorentries.h"
+    #undef EGALITO_EMULATED_FUNCTION
+    #undef EGALITO_EMULATED_DATA
+};
+
+static constexpr PerfectHash<LoaderEmulator::FUNCTION_COUNT>
+    functionHash(functionNames);
+static constexpr PerfectHash<LoaderEmulator::DATA_COUNT> dataHash(dataNames);
+static_assert(functionHash.isValid() && dataHash.isValid(),
+    "no perfect hash for the emulated ld.so symbols");
 #ifdef USE_LOADER
 namespace Emulation {
     #include "../dep/rtld/rtld.h"
@@ -100,10 +122,9 @@ namespace Emulation {
 }
 #endif
 
-static void createDataVariable2(Symbol *source, void *target,
+static void createDataVariable2(address_t address, void *target,
     Module *egalito) {
 
-    address_t address = source->getAddress();
     address += egalito->getElfSpace()->getElfMap()->getBaseAddress();
 
     address_t targetAddress = reinterpret_cast<address_t>(target);
@@ -114,21 +135,15 @@ static void createDataVariable2(Symbol *source, void *target,
 
 void LoaderEmulator::setStackLinks(char **argv, char **envp) {
     if(!egalito || !egalito->getElfSpace()) return;
-    auto symbolList = egalito->getElfSpace()->getSymbolList();
-
-    auto dl_argv = symbolList->find("_ZN9Emulation8_dl_argvE");
-    createDataVariable2(dl_argv, argv, egalito);
 
-    auto environ = symbolList->find("_ZN9Emulation9__environE");
-    createDataVariable2(environ, envp, egalito);
+    // symbol addresses were looked up in setup()
+    createDataVariable2(getData(DATA__dl_argv), argv, egalito);
+    createDataVariable2(getData(DATA___environ), envp, egalito);
 
     // __libc_stack_end doesn't have to be precise
-    auto libc_stack_end = symbolList->find("_ZN9Emulation16__libc_stack_endE");
-    createDataVariable2(libc_stack_end, argv, egalito);
+    createDataVariable2(getData(DATA___libc_stack_end), argv, egalito);
 }
 
-LoaderEmulator LoaderEmulator::instance;
-
 void LoaderEmulator::setup(Conductor *conductor) {
     const char *functions_NI[] = {
         "_dl_find_dso_for_object",
@@ -201,28 +216,35 @@ void LoaderEmulator::setupForExecutableGen(Conductor *conductor) {
     }
 }
 
-void LoaderEmulator::addFunction(const std::string &symbol,
-    Function *function) {
-
-    functionMap[symbol] = function;
+void LoaderEmulator::addFunction(const char *symbol, Function *function) {
+    int index = functionHash.indexOf(symbol);
+    if(index < 0) {
+        LOG(0, "ERROR: " << symbol << " is not in emulatorentries.h");
+        return;
+    }
+    functionList[index] = function;
 }
 
-void LoaderEmulator::addData(const std::string &symbol, address_t address) {
-    dataMap[symbol] = address;
+void LoaderEmulator::addData(const char *symbol, address_t address) {
+    int index = dataHash.indexOf(symbol);
+    if(index < 0) {
+        LOG(0, "ERROR: " << symbol << " is not in emulatorentries.h");
+        return;
+    }
+    dataList[index] = address;
+    hasData.set(index);
 }
 
-Function *LoaderEmulator::findFunction(const std::string &symbol) {
-    auto it = functionMap.find(symbol);
-    return (it != functionMap.end() ? (*it).second : nullptr);
+Function *LoaderEmulator::findFunction(const char *symbol) {
+    int index = functionHash.indexOf(symbol);
+    return (index >= 0 ? functionList[index] : nullptr);
 }
 
-Link *LoaderEmulator::makeDataLink(const std::string &symbol,
-    bool afterMapping) {
-
-    auto it = dataMap.find(symbol);
-    if(it == dataMap.end()) return nullptr;
+Link *LoaderEmulator::makeDataLink(const char *symbol, bool afterMapping) {
+    int index = dataHash.indexOf(symbol);
+    if(index < 0 || !hasData[index]) return nullptr;
 
-    auto addr = (*it).second;
+    auto addr = dataList[index];
     if(!addr) {
         // special case for static executable generation
         return new LDSOLoaderLink(symbol);
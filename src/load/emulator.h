@@ -2,7 +2,7 @@
 #define EGALITO_LOAD_EMULATOR_H
 
 #include <string>
-#include <map>
+#include <bitset>
 #include "types.h"
 
 class Conductor;
@@ -11,32 +11,53 @@ class Function;
 class Link;
 class DataVariable;
 
-/** Emulate functionality provided by ld.so. */
+/** Emulate functionality provided by ld.so. Each Conductor has its own,
+    since the emulated symbols point into that Conductor's egalito Module.
+
+    The emulated symbols are fixed (see emulatorentries.h), so they are
+    looked up with a PerfectHash instead of a map; every external symbol
+    of every module is checked here first.
+*/
 class LoaderEmulator {
-private:
-    Module *egalito;
-    static LoaderEmulator instance;
 public:
-    static LoaderEmulator &getInstance() { return instance; }
+    enum {
+        #define EGALITO_EMULATED_FUNCTION(name) FUNCTION_ ## name,
+        #define EGALITO_EMULATED_DATA(name)
+        #include "emulatorentries.h"
+        #undef EGALITO_EMULATED_FUNCTION
+        #undef EGALITO_EMULATED_DATA
+        FUNCTION_COUNT
+    };
+    enum {
+        #define EGALITO_EMULATED_FUNCTION(name)
+        #define EGALITO_EMULATED_DATA(name) DATA_ ## name,
+        #include "emulatorentries.h"
+        #undef EGALITO_EMULATED_FUNCTION
+        #undef EGALITO_EMULATED_DATA
+        DATA_COUNT
+    };
 private:
-    std::map<std::string, Function *> functionMap;
-    std::map<std::string, address_t> dataMap;
+    Module *egalito;
+    Function *functionList[FUNCTION_COUNT];
+    address_t dataList[DATA_COUNT];
+    std::bitset<DATA_COUNT> hasData;  // an address of 0 is still emulated
 public:
+    LoaderEmulator() : egalito(nullptr), functionList{}, dataList{} {}
+
     void setup(Conductor *conductor);
     void setupForExecutableGen(Conductor *conductor);
 
     void setStackLinks(char **argv, char **envp);
     void initRT(Conductor *conductor);
 
-    Function *findFunction(const std::string &symbol);
-    Link *makeDataLink(const std::string &symbol, bool afterMapping);
+    Function *findFunction(const char *symbol);
+    Link *makeDataLink(const char *symbol, bool afterMapping);
 private:
-    LoaderEmulator() : egalito(nullptr) {}
-
     DataVariable *findEgalitoDataVariable(const char *name);
 
-    void addFunction(const std::string &symbol, Function *function);
-    void addData(const std::string &symbol, address_t address);
+    void addFunction(const char *symbol, Function *function);
+    void addData(const char *symbol, address_t address);
+    address_t getData(int index) const { return dataList[index]; }
 };
 
 #endif
@@ -0,0 +1,28 @@
+// no include guards to allow reuse in different context
+
+#if !defined(EGALITO_EMULATED_FUNCTION) || !defined(EGALITO_EMULATED_DATA)
+    #error "Please define EGALITO_EMULATED_FUNCTION(name) and EGALITO_EMULATED_DATA(name) before including emulatorentries.h"
+#endif
+
+// ld.so functions, see LoaderEmulator::setup()
+EGALITO_EMULATED_FUNCTION(_dl_find_dso_for_object)
+EGALITO_EMULATED_FUNCTION(__tunable_get_val)
+EGALITO_EMULATED_FUNCTION(__tunable_set_val)
+EGALITO_EMULATED_FUNCTION(__tls_get_addr)
+EGALITO_EMULATED_FUNCTION(_dl_get_tls_static_info)
+EGALITO_EMULATED_FUNCTION(_dl_allocate_tls)
+EGALITO_EMULATED_FUNCTION(__cxa_get_globals)
+
+// ld.so variables
+EGALITO_EMULATED_DATA(_rtld_global)
+EGALITO_EMULATED_DATA(_rtld_global_ro)
+EGALITO_EMULATED_DATA(_dl_argv)
+EGALITO_EMULATED_DATA(__environ)
+EGALITO_EMULATED_DATA(environ)
+EGALITO_EMULATED_DATA(__libc_stack_end)
+EGALITO_EMULATED_DATA(_dl_starting_up)
+EGALITO_EMULATED_DATA(__libc_enable_secure)
+#ifdef ARCH_AARCH64
+EGALITO_EMULATED_DATA(__stack_chk_guard)
+EGALITO_EMULATED_DATA(__pointer_chk_guard)
+#endif
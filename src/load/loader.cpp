@@ -2,6 +2,7 @@
 #include <cstdio>  // for std::fflush
 #include <cstdlib>  // for getenv
 #include <unistd.h>  // for STDERR_FILENO
+#include <sys/syscall.h>  // for SYS_arch_prctl
 
 #include "loader.h"
 #include "usage.h"
@@ -11,9 +12,12 @@
 #include "preparetls.h"
 #include "datastruct.h"
 #include "makebridge.h"
+#include "sandboximage.h"
 #include "chunk/tls.h"
+#include "chunk/linkindex.h"
 #include "elf/auxv.h"
 #include "elf/elfmap.h"
+#include "generate/perfmap.h"
 #include "conductor/conductor.h"
 #include "conductor/setup.h"
 #include "instr/storage.h"
@@ -21,6 +25,8 @@
 #include "pass/loginstr.h"
 #include "pass/noppass.h"
 #include "pass/promotejumps.h"
+#include "pass/loopalign.h"
+#include "pass/relaxtls.h"
 #include "pass/resolveplt.h"
 #include "pass/collapseplt.h"
 #include "pass/hijack.h"
@@ -35,8 +41,11 @@
 #include "pass/endbradd.h"
 #include "pass/endbrenforce.h"
 #include "pass/syscallsandbox.h"
+#include "pass/syscallfilter.h"
 #include "pass/clearplts.h"
 #include "runtime/managegs.h"
+#include "runtime/sampler.h"
+#include "runtime/calltrace.h"
 #include "transform/sandbox.h"
 #include "util/feature.h"
 #include "util/timing.h"
@@ -55,14 +64,20 @@ static GSTable *gsTable;
 
 static std::chrono::high_resolution_clock::time_point masterLoadTime;
 
-EgalitoLoader::EgalitoLoader() : sandbox(nullptr) {
+EgalitoLoader::EgalitoLoader() : sandbox(nullptr), fromArchive(false),
+    image(nullptr), fromImage(false), programName(nullptr) {
+
     this->setup = new ConductorSetup();
     ::egalito_conductor_setup = setup;
 }
 
 bool EgalitoLoader::parse(const char *filename) {
+    this->programName = filename;
     try {
-        if(ElfMap::isElf(filename)) {
+        if(parseImage(filename)) {
+            // the archive has already been parsed
+        }
+        else if(ElfMap::isElf(filename)) {
             LOG(1, "parsing ELF file [" << filename << "]");
             setup->parseElfFiles(filename, true, true);
             fromArchive = false;
@@ -78,31 +93,79 @@ bool EgalitoLoader::parse(const char *filename) {
         return false;
     }
 
+    // only needs the ELF headers, which are not mapped for archives
+    auxvPatch.set(setup->getElfMap(), nullptr);
+    return true;
+}
+
+bool EgalitoLoader::parseImage(const char *filename) {
+    // the shuffling sandbox regenerates code at runtime, and a shuffled
+    // layout must differ between runs, so there is nothing worth saving
+    std::string imagePath;
+    if(const char *file = getenv("EGALITO_SANDBOX_IMAGE")) {
+        imagePath = file;
+    }
+    else if(const char *directory = getenv("EGALITO_SANDBOX_CACHE")) {
+        imagePath = SandboxImage::getCachePath(directory, filename);
+    }
+    if(imagePath.empty() || isFeatureEnabled("EGALITO_USE_GS")
+        || isFeatureEnabled("EGALITO_SHUFFLE_FUNCTIONS")) {
+
+        return false;
+    }
+
+    this->image = new SandboxImage(imagePath);
+    if(!image->isValid(filename)) return false;
+
+    LOG(1, "parsing sandbox image [" << imagePath << "]");
+    setup->parseEgalitoArchive(image->getArchivePath().c_str());
+    fromArchive = true;
+    fromImage = true;
     return true;
 }
 
 void EgalitoLoader::setupEnvironment(int argc, char *argv[]) {
-    adjustAuxiliaryVector(argv, setup->getElfMap(), nullptr);
+    if(!auxvPatch.isEmpty()) {
+        CLOG(0, "fixing auxiliary vector");
+        auxvPatch.apply(argv + argc + 1);
+    }
     auto adjust = removeLoaderFromArgv(argv);
     egalito_initial_stack += adjust;
     argv = (char **)((char *)argv + adjust);
 
-    char **environ = argv;
-    while(*environ) environ ++;
-    environ ++;
+    // one argument fewer, whether argv moved up or its contents moved down
     this->argc = argc;
     this->argv = argv;
-    this->envp = environ;
-    LoaderEmulator::getInstance().setStackLinks(argv, envp);
+    this->envp = argv + argc;
+    setup->getConductor()->getLoaderEmulator()->setStackLinks(argv, envp);
 
     SegMap::mapAllSegments(setup);
-    LoaderEmulator::getInstance().initRT(setup->getConductor());
+    setup->getConductor()->getLoaderEmulator()->initRT(setup->getConductor());
 
     // assign addresses of global variables passed-through to target
     MakeLoaderBridge::make();
 }
 
 void EgalitoLoader::generateCode() {
+    if(isFeatureEnabled("EGALITO_USE_SECCOMP_SANDBOX")) {
+        makeSyscallFilter();
+    }
+
+    if(fromImage) {
+        // the archived Program has already been transformed
+        setup->getConductor()->setupIFuncLazySelector();
+        if(!image->restore(setup)) {
+            LOG(1, "falling back to generating code for the sandbox image");
+            this->sandbox = setup->makeLoaderSandbox();
+            setup->moveCode(sandbox);
+        }
+        setup->getConductor()->fixDataSections();
+        if(auto perfMap = PerfMap::getInstance()) {
+            perfMap->add(setup->getConductor()->getProgram());
+        }
+        return;
+    }
+
     if(isFeatureEnabled("EGALITO_USE_GS")) {
         this->sandbox = setup->makeShufflingSandbox();
     }
@@ -115,7 +178,12 @@ void EgalitoLoader::generateCode() {
     setup->moveCode(sandbox);
     otherPassesAfterMove();
 
+    if(image) image->save(setup, sandbox, programName);
+
     setup->getConductor()->fixDataSections();
+    if(auto perfMap = PerfMap::getInstance()) {
+        perfMap->add(setup->getConductor()->getProgram());
+    }
 #ifndef RELEASE_BUILD
     setup->getConductor()->writeDebugElf("symbols.elf");
 #endif
@@ -148,6 +216,25 @@ void EgalitoLoader::run() {
     ShufflingSandbox *shufflingSandbox
         = dynamic_cast<ShufflingSandbox *>(sandbox);
 
+    if(getenv("EGALITO_PROFILE")) {
+        if(shufflingSandbox) {
+            LOG(0, "EGALITO_PROFILE can't follow JIT-shuffled code, ignoring");
+        }
+        else SamplingProfiler::start(program);
+    }
+    if(isFeatureEnabled("EGALITO_LOG_CALL")
+        && getenv("EGALITO_LOG_CALL_TRACE")) {
+
+        if(shufflingSandbox) {
+            LOG(0, "EGALITO_LOG_CALL_TRACE can't follow JIT-shuffled code,"
+                " ignoring");
+        }
+        else CallTracer::start(program);
+    }
+
+    // the trace can't be written once the loader's heap and TLS are gone
+    EgalitoTracer::getInstance()->flush();
+
     // --- last point virtual functions work ---
     // update vtable pointers to new libegalito code (LOG needs vtable)
     DataStructMigrator().migrate(setup);
@@ -160,6 +247,14 @@ void EgalitoLoader::run() {
             static_cast<int>(duration / 1000));
     }
 
+    if(!syscallFilter.empty()) {
+        // from here on, only system calls found in the program are allowed
+        if(!SyscallFilterPass::install(syscallFilter)) {
+            egalito_fprintf(egalito_stderr,
+                "failed to install the seccomp filter\n");
+        }
+    }
+
     // --- last point accesses to loader TLS work ('new' needs loader TLS)
     PrepareTLS::prepare(setup->getConductor());
 
@@ -173,6 +268,16 @@ void EgalitoLoader::run() {
     //_start2();
 }
 
+void EgalitoLoader::makeSyscallFilter() {
+    SyscallFilterPass syscallFilterPass;
+    setup->getConductor()->getProgram()->accept(&syscallFilterPass);
+#ifdef ARCH_X86_64
+    // PrepareTLS sets %fs after the filter is installed
+    syscallFilterPass.allow(SYS_arch_prctl);
+#endif
+    this->syscallFilter = syscallFilterPass.makeFilter();
+}
+
 void EgalitoLoader::otherPasses() {
     auto program = setup->getConductor()->getProgram();
 
@@ -203,19 +308,31 @@ void EgalitoLoader::otherPasses() {
     if(1 || isFeatureEnabled("EGALITO_USE_GS")) {
         //TemporaryLogLevel tll("pass", 20);
 
+        // with the index, only PLT callers are visited instead of all code
+        if(isFeatureEnabled("EGALITO_LINK_INDEX")) LinkIndex::enable(program);
         CollapsePLTPass collapsePLT(setup->getConductor());
         setup->getConductor()->acceptInAllModules(&collapsePLT, true);
+        LinkIndex::disable();
+    }
+
+#ifdef ARCH_X86_64
+    if(isFeatureEnabled("EGALITO_RELAX_TLS") && !fromArchive) {
+        RelaxTLSPass relaxTLS;
+        program->accept(&relaxTLS);
     }
+#endif
 
     if(isFeatureEnabled("EGALITO_USE_GS")) {
+        // before JitGSSetup, so no GS entry is made for the originals
         {
-            HijackPass hijackPass(setup->getConductor(), "pthread_create");
-            program->getMain()->accept(&hijackPass);
+            HijackPass hijackPass(setup->getConductor(), "pthread_create",
+                true);
+            program->accept(&hijackPass);
         }
 
         {
-            HijackPass hijackPass(setup->getConductor(), "sigaction");
-            program->getMain()->accept(&hijackPass);
+            HijackPass hijackPass(setup->getConductor(), "sigaction", true);
+            program->accept(&hijackPass);
         }
     }
 
@@ -240,7 +357,10 @@ void EgalitoLoader::otherPasses() {
     }
 
     if(isFeatureEnabled("EGALITO_USE_RETPOLINES")) {
-        RetpolinePass retpoline;
+        // promote this many of the likeliest targets of each virtual call
+        const char *promote = getenv("EGALITO_RETPOLINE_PROMOTE");
+        RetpolinePass retpoline(
+            promote ? std::strtoul(promote, nullptr, 0) : 0);
         program->accept(&retpoline);
     }
 
@@ -252,6 +372,9 @@ void EgalitoLoader::otherPasses() {
     }
     if(isFeatureEnabled("EGALITO_USE_SYSCALL_SANDBOX")) {
         SyscallSandbox sandbox(program);
+        if(const char *allow = getenv("EGALITO_SYSCALL_ALLOW")) {
+            sandbox.setAllowList(SyscallSandbox::parseAllowList(allow));
+        }
         program->accept(&sandbox);
     }
 
@@ -271,6 +394,12 @@ void EgalitoLoader::otherPasses() {
         CancelPushPass cancelPush(program);
         program->accept(&cancelPush);
     }
+
+    // padding depends on the final code size, so this goes last
+    if(isFeatureEnabled("EGALITO_ALIGN_LOOPS")) {
+        LoopAlignPass loopAlign;
+        program->accept(&loopAlign);
+    }
 }
 
 void EgalitoLoader::otherPassesAfterMove() {
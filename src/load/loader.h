@@ -1,7 +1,12 @@
 #ifndef EGALITO_LOAD_LOADER_H
 #define EGALITO_LOAD_LOADER_H
 
+#include <vector>
+#include <linux/filter.h>  // for sock_filter
 #include "conductor/setup.h"
+#include "elf/auxv.h"
+
+class SandboxImage;
 
 class EgalitoLoader {
 private:
@@ -11,6 +16,11 @@ private:
     char **argv;
     char **envp;
     bool fromArchive;
+    SandboxImage *image;
+    bool fromImage;
+    const char *programName;
+    AuxiliaryVectorPatch auxvPatch;
+    std::vector<sock_filter> syscallFilter;
 public:
     EgalitoLoader();
     bool parse(const char *filename);
@@ -20,6 +30,8 @@ public:
     void generateCode();
     void run();
 private:
+    bool parseImage(const char *filename);
+    void makeSyscallFilter();
     void otherPasses();
     void otherPassesAfterMove();
 };
@@ -12,7 +12,8 @@ void MakeLoaderBridge::make() {
     LoaderBridge *bridge = LoaderBridge::getInstance();
 
     #define EGALITO_BRIDGE_ENTRY(type, name) \
-        bridge->assignAddress(#name, reinterpret_cast<address_t>(&name));
+        bridge->assignAddress(BRIDGE_ ## name, \
+            reinterpret_cast<address_t>(&name));
     #include "conductor/bridgeentries.h"
     #undef EGALITO_BRIDGE_ENTRY
 }
@@ -0,0 +1,304 @@
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>  // for std::rename, std::remove
+#include <sstream>
+#include <cstdlib>  // for realpath
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>  // for flock
+#include <fcntl.h>
+#include <unistd.h>
+#include "sandboximage.h"
+#include "conductor/setup.h"
+#include "conductor/conductor.h"
+#include "chunk/serializer.h"
+#include "archive/stream.h"
+#include "archive/filesystem.h"
+#include "transform/sandbox.h"
+#include "util/timing.h"
+#include "log/log.h"
+
+extern char **environ;
+
+#define IMAGE_MAGIC         "EGSIMG01"
+#define IMAGE_MAGIC_SIZE    8
+#define IMAGE_PAGE_SIZE     0x1000
+
+bool SandboxImage::isValid(const char *program) {
+    if(!readHeader()) return false;
+
+    if(this->program != canonicalPath(program)) {
+        LOG(1, "sandbox image [" << path << "] was made for ["
+            << this->program << "]");
+        return false;
+    }
+    if(environmentHash != hashEnvironment()) {
+        LOG(1, "sandbox image [" << path << "] built with other settings");
+        return false;
+    }
+    for(const auto &input : inputList) {
+        InputFile current;
+        if(!statInput(input.path, current)
+            || current.size != input.size
+            || current.modifyTime != input.modifyTime) {
+
+            LOG(1, "sandbox image [" << path << "] is stale: ["
+                << input.path << "] has changed");
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SandboxImage::save(ConductorSetup *setup, Sandbox *sandbox,
+    const char *program) {
+
+    EgalitoTiming ttt("sandbox image save");
+
+    ArchiveFileSystem().makeArchivePath(path);
+
+    // several processes may start at once; only one of them writes
+    int lock = open((path + ".lock").c_str(),
+        O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if(lock < 0 || flock(lock, LOCK_EX | LOCK_NB) != 0) {
+        LOG(1, "sandbox image [" << path << "] is being written elsewhere");
+        if(lock >= 0) close(lock);
+        return false;
+    }
+
+    this->program = canonicalPath(program);
+
+    base = sandbox->getBacking()->getBase();
+    size = sandbox->getWatermark() - base;
+    environmentHash = hashEnvironment();
+    inputList.clear();
+    moduleBaseList.clear();
+    auto root = setup->getConductor()->getProgram();
+    for(auto module : CIter::modules(root)) {
+        moduleBaseList.emplace_back(module->getName(),
+            module->getBaseAddress());
+
+        auto library = module->getLibrary();
+        if(!library || library->getResolvedPath().empty()) continue;
+        InputFile input;
+        if(statInput(library->getResolvedPath(), input)) {
+            inputList.push_back(input);
+        }
+    }
+
+    // other processes may have the current image mapped, so it is
+    // replaced rather than overwritten
+    auto suffix = ".tmp" + std::to_string(getpid());
+    bool saved = writeCode(getCodePath() + suffix);
+    if(saved) {
+        ChunkSerializer().serialize(root, path + suffix);
+
+        // the archive is renamed last; without it the image is never used
+        saved = std::rename((getCodePath() + suffix).c_str(),
+                getCodePath().c_str()) == 0
+            && std::rename((path + suffix).c_str(), path.c_str()) == 0;
+    }
+    std::remove((getCodePath() + suffix).c_str());
+    std::remove((path + suffix).c_str());
+    close(lock);
+
+    if(!saved) {
+        LOG(1, "can't write sandbox image [" << path << "]");
+        return false;
+    }
+    LOG(1, "saved sandbox image [" << path << "] with 0x" << std::hex
+        << size << " bytes of code at 0x" << base);
+    return true;
+}
+
+bool SandboxImage::writeCode(const std::string &codePath) {
+    std::ofstream file(codePath, std::ios::out | std::ios::binary
+        | std::ios::trunc);
+    if(!file) return false;
+
+    ArchiveStreamWriter writer(file);
+    writer.writeFixedLengthBytes(IMAGE_MAGIC, IMAGE_MAGIC_SIZE);
+    writer.writeBytes(this->program);
+    writer.write<uint64_t>(base);
+    writer.write<uint64_t>(size);
+    writer.write<uint64_t>(environmentHash);
+    writer.write<uint32_t>(inputList.size());
+    for(const auto &input : inputList) {
+        writer.writeBytes(input.path);
+        writer.write<uint64_t>(input.size);
+        writer.write<uint64_t>(input.modifyTime);
+    }
+    writer.write<uint32_t>(moduleBaseList.size());
+    for(const auto &module : moduleBaseList) {
+        writer.writeBytes(module.first);
+        writer.write<uint64_t>(module.second);
+    }
+
+    // code starts on a page boundary, so restore() can map it directly
+    size_t headerSize = file.tellp();
+    size_t codeOffset = (headerSize + IMAGE_PAGE_SIZE - 1)
+        & ~(IMAGE_PAGE_SIZE - 1);
+    std::string padding(codeOffset - headerSize, '\0');
+    writer.writeFixedLengthBytes(padding.data(), padding.size());
+    writer.writeFixedLengthBytes(reinterpret_cast<const char *>(base), size);
+    file.close();
+    return !file.fail();
+}
+
+bool SandboxImage::restore(ConductorSetup *setup) {
+    EgalitoTiming ttt("sandbox image restore");
+    if(!checkModuleBases(setup)) return false;
+
+    int fd = open(getCodePath().c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0) return false;
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < size) {
+        close(fd);
+        return false;
+    }
+    size_t codeOffset = st.st_size - size;
+    if(codeOffset % IMAGE_PAGE_SIZE != 0) {
+        LOG(1, "sandbox image code is not page aligned");
+        close(fd);
+        return false;
+    }
+
+    // a private mapping still shares pages with every other process
+    // mapping this file, until one of them writes to the code
+    void *code = mmap(reinterpret_cast<void *>(base), size,
+        PROT_READ | PROT_EXEC, MAP_PRIVATE, fd, codeOffset);
+    close(fd);
+    if(code == MAP_FAILED) {
+        LOG(1, "can't map sandbox image: " << std::strerror(errno));
+        return false;
+    }
+    if(code != reinterpret_cast<void *>(base)) {
+        LOG(1, "sandbox image base 0x" << std::hex << base
+            << " is not available");
+        munmap(code, size);
+        return false;
+    }
+
+    LOG(1, "restored 0x" << std::hex << size
+        << " bytes of code from sandbox image at 0x" << base);
+    return true;
+}
+
+bool SandboxImage::readHeader() {
+    std::ifstream file(getCodePath(), std::ios::in | std::ios::binary);
+    if(!file) return false;
+    {
+        std::ifstream archive(path, std::ios::in | std::ios::binary);
+        if(!archive) return false;
+    }
+
+    ArchiveStreamReader reader(file);
+    if(reader.readFixedLengthBytes(IMAGE_MAGIC_SIZE)
+        != std::string(IMAGE_MAGIC, IMAGE_MAGIC_SIZE)) {
+
+        LOG(1, "[" << getCodePath() << "] is not a sandbox image");
+        return false;
+    }
+    program = reader.readBytes();
+    base = reader.read<uint64_t>();
+    size = reader.read<uint64_t>();
+    environmentHash = reader.read<uint64_t>();
+
+    inputList.clear();
+    uint32_t inputCount = reader.read<uint32_t>();
+    for(uint32_t i = 0; i < inputCount && reader.stillGood(); i ++) {
+        InputFile input;
+        input.path = reader.readBytes();
+        input.size = reader.read<uint64_t>();
+        input.modifyTime = reader.read<uint64_t>();
+        inputList.push_back(input);
+    }
+
+    moduleBaseList.clear();
+    uint32_t moduleCount = reader.read<uint32_t>();
+    for(uint32_t i = 0; i < moduleCount && reader.stillGood(); i ++) {
+        auto name = reader.readBytes();
+        address_t moduleBase = reader.read<uint64_t>();
+        moduleBaseList.emplace_back(name, moduleBase);
+    }
+
+    return reader.stillGood();
+}
+
+bool SandboxImage::checkModuleBases(ConductorSetup *setup) {
+    auto program = setup->getConductor()->getProgram();
+    for(const auto &saved : moduleBaseList) {
+        auto module = CIter::findChild(program, saved.first.c_str());
+        if(!module || module->getBaseAddress() != saved.second) {
+            LOG(1, "sandbox image: module [" << saved.first
+                << "] is not at its saved base address");
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string SandboxImage::getCachePath(const std::string &directory,
+    const char *program) {
+
+    auto canonical = canonicalPath(program);
+    auto slash = canonical.rfind('/');
+    auto name = canonical.substr(slash == std::string::npos ? 0 : slash + 1);
+
+    // FNV-1a of the full path, so programs with the same name don't clash
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for(char c : canonical) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001b3ull;
+    }
+
+    std::ostringstream cachePath;
+    cachePath << directory << "/" << name << "-" << std::hex << hash
+        << "-" << hashEnvironment() << ".img";
+    return cachePath.str();
+}
+
+std::string SandboxImage::canonicalPath(const char *path) {
+    char *resolved = realpath(path, nullptr);
+    if(!resolved) return path;
+    std::string result(resolved);
+    free(resolved);
+    return result;
+}
+
+bool SandboxImage::statInput(const std::string &path, InputFile &input) {
+    struct stat st;
+    if(stat(path.c_str(), &st) != 0) return false;
+
+    input.path = path;
+    input.size = st.st_size;
+    input.modifyTime = static_cast<uint64_t>(st.st_mtim.tv_sec) * 1000000000
+        + st.st_mtim.tv_nsec;
+    return true;
+}
+
+uint64_t SandboxImage::hashEnvironment() {
+    // EGALITO_ settings can change the generated code; sort them, since
+    // the order of the environment is not significant
+    std::vector<std::string> settingList;
+    for(char **env = environ; env && *env; env ++) {
+        if(std::strncmp(*env, "EGALITO_", 8) != 0) continue;
+        if(std::strncmp(*env, "EGALITO_DEBUG=", 14) == 0) continue;
+        if(std::strncmp(*env, "EGALITO_SANDBOX_IMAGE=", 22) == 0) continue;
+        if(std::strncmp(*env, "EGALITO_SANDBOX_CACHE=", 22) == 0) continue;
+        settingList.push_back(*env);
+    }
+    std::sort(settingList.begin(), settingList.end());
+
+    // FNV-1a
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for(const auto &setting : settingList) {
+        for(char c : setting + "\n") {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 0x100000001b3ull;
+        }
+    }
+    return hash;
+}
@@ -0,0 +1,79 @@
+#ifndef EGALITO_LOAD_SANDBOX_IMAGE_H
+#define EGALITO_LOAD_SANDBOX_IMAGE_H
+
+#include <string>
+#include <vector>
+#include "types.h"
+
+class ConductorSetup;
+class Sandbox;
+
+/** Saves the result of code generation so that later launches of the
+    loader can skip the transformation passes and code generation.
+
+    An image has two parts. The transformed Program is written as an
+    ordinary archive at the image path. The generated code is written to
+    <path>.code: a header first, then the sandbox contents starting on a
+    page boundary, so that it can be mmap'd straight into place.
+
+    Data regions and TLS are still set up on every launch. They are rebuilt
+    from the archive by fixDataSections(). This is cheap, and the data can
+    hold pointers into the loader's own heap.
+
+    The loader gives modules and the sandbox fixed base addresses, so the
+    code needs no relocation. An image is rejected if any input file, any
+    EGALITO_ feature setting or any module base address has changed since
+    it was written.
+
+    The code is mapped read-only from the file, so every process using the
+    same image shares its pages through the page cache. Only GS tables,
+    data and TLS are private. Images are written under temporary names and
+    renamed into place, never rewritten, so a mapped image can't change.
+    getCachePath() names an image per program and settings inside a
+    cache directory, for hosts running many copies of the same programs.
+*/
+class SandboxImage {
+public:
+    struct InputFile {
+        std::string path;
+        uint64_t size;
+        uint64_t modifyTime;
+    };
+private:
+    std::string path;
+    std::string program;
+    address_t base;
+    size_t size;
+    uint64_t environmentHash;
+    std::vector<InputFile> inputList;
+    std::vector<std::pair<std::string, address_t>> moduleBaseList;
+public:
+    SandboxImage(const std::string &path)
+        : path(path), base(0), size(0), environmentHash(0) {}
+
+    /** Returns true if the image was made for program and still matches
+        its inputs. */
+    bool isValid(const char *program);
+
+    /** Writes an image of setup's Program, whose code is in sandbox. */
+    bool save(ConductorSetup *setup, Sandbox *sandbox, const char *program);
+
+    /** After the archive is parsed, maps the saved code back into place. */
+    bool restore(ConductorSetup *setup);
+
+    /** Where the image of program is kept inside directory. */
+    static std::string getCachePath(const std::string &directory,
+        const char *program);
+
+    const std::string &getArchivePath() const { return path; }
+    std::string getCodePath() const { return path + ".code"; }
+private:
+    bool writeCode(const std::string &codePath);
+    bool readHeader();
+    bool checkModuleBases(ConductorSetup *setup);
+    static std::string canonicalPath(const char *path);
+    static bool statInput(const std::string &path, InputFile &input);
+    static uint64_t hashEnvironment();
+};
+
+#endif
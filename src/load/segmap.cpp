@@ -1,6 +1,7 @@
 #include <iostream>
 #include <fstream>
 #include <cstring>  // for std::memset
+#include <vector>
 
 #include <sys/mman.h>
 #include <elf.h>
@@ -10,12 +11,26 @@
 #include "conductor/conductor.h"
 #include "pass/clearspatial.h"
 #include "transform/data.h"
+#include "util/threadpool.h"
 #include "log/log.h"
 #include "log/temp.h"
 
 #define ROUND_DOWN(x)   ((x) & ~0xfff)
 #define ROUND_UP(x)     (((x) + 0xfff) & ~0xfff)
 
+static bool isZero(const char *data, size_t size) {
+    size_t i = 0;
+    for(; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof word);
+        if(word) return false;
+    }
+    for(; i < size; i ++) {
+        if(data[i]) return false;
+    }
+    return true;
+}
+
 void SegMap::mapAllSegments(ConductorSetup *setup) {
 #if 0
     auto elf = setup->getElfMap();
@@ -43,12 +58,20 @@ void SegMap::mapAllSegments(ConductorSetup *setup) {
 #endif
     }
 #else
+    // mmap calls serialize on the address space anyway, so only the
+    // copying is spread across threads, one DataRegion per work item
+    std::vector<DataRegion *> regionList;
     for(auto module : CIter::modules(setup->getConductor()->getProgram())) {
         for(auto region : CIter::regions(module)) {
             if(dynamic_cast<TLSDataRegion *>(region)) continue;
             mapRegion(region);
+            regionList.push_back(region);
         }
     }
+    ThreadPool pool;
+    pool.parallelFor(regionList.size(), [&] (size_t i) {
+        copyRegion(regionList[i]);
+    });
     ClearSpatialPass clearSpatial;
 #endif
     for(auto module : CIter::modules(setup->getConductor()->getProgram())) {
@@ -193,8 +216,26 @@ void SegMap::mapRegion(DataRegion *region) {
         LOG(1, "mmap DataRegion: overlapping?");
         throw "error: mapRegion";
     }
-    const std::string &dataBytes = region->getDataBytes();
-    LOG(1, "memcpy " << std::hex << (void *)dataBytes.c_str()
-        << " to " << address << " size " << dataBytes.length());
-    std::memcpy((void *)address, dataBytes.c_str(), dataBytes.length());
+}
+
+void SegMap::copyRegion(DataRegion *region) {
+    address_t address = region->getAddress();
+    const char *source = region->getDataPointer();
+    size_t size = region->getSizeOfInitializedData();
+    LOG(1, "memcpy " << std::hex << (void *)source
+        << " to " << address << " size " << size);
+
+    // The destination is fresh anonymous memory, which already reads as
+    // zero. Skipping all-zero pages (.bss, padding, sparse tables) leaves
+    // them untouched, so they are never faulted in or made private.
+    size_t done = 0;
+    while(done < size) {
+        // chunks end on destination page boundaries
+        size_t chunk = ROUND_UP(address + done + 1) - (address + done);
+        if(chunk > size - done) chunk = size - done;
+        if(!isZero(source + done, chunk)) {
+            std::memcpy((void *)(address + done), source + done, chunk);
+        }
+        done += chunk;
+    }
 }
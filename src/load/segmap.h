@@ -15,6 +15,7 @@ public:
 private:
     static void mapElfSegment(ElfMap &elf, Elf64_Phdr *phdr, address_t baseAddress);
     static void mapRegion(DataRegion *region);
+    static void copyRegion(DataRegion *region);
 };
 
 #endif
@@ -21,5 +21,59 @@ void printUsage(const char *exepath) {
     std::fprintf(stderr, "\n"
         "Debug options: EGALITO_DEBUG=/dev/null|(some/settings/file)|(setting)\n"
         "    where a setting may be e.g. load, load=2, !load\n"
-        "    and a settings file contains one setting/filename per line\n");
+        "    and a settings file contains one setting/filename per line\n"
+        "Startup trace: EGALITO_TRACE=(output file)\n"
+        "    records a Chrome/Perfetto trace of the loader's startup phases\n");
+
+    std::fprintf(stderr, "\n"
+        "Startup image: EGALITO_SANDBOX_IMAGE=(image file)\n"
+        "    saves the transformed program and its code on the first run,\n"
+        "    and reuses them while the inputs and settings are unchanged\n"
+        "Shared images: EGALITO_SANDBOX_CACHE=(directory)\n"
+        "    keeps one image per program and settings in the directory;\n"
+        "    processes using the same image share its code pages\n");
+
+    std::fprintf(stderr, "\n"
+        "Lazy libraries: EGALITO_LAZY_LIBS=libfoo.so:libbar.so\n"
+        "    skips these libraries unless another object imports from them\n");
+
+    std::fprintf(stderr, "\n"
+        "TLS relaxation: EGALITO_RELAX_TLS=1\n"
+        "    rewrites dynamic TLS accesses to avoid calling __tls_get_addr\n");
+
+    std::fprintf(stderr, "\n"
+        "Loop alignment: EGALITO_ALIGN_LOOPS=1\n"
+        "    pads innermost loop heads to 32-byte boundaries where the\n"
+        "    padding is never executed\n");
+
+    std::fprintf(stderr, "\n"
+        "Function shuffling: EGALITO_SHUFFLE_FUNCTIONS=1\n"
+        "    places functions in a new random order on every run; with\n"
+        "    EGALITO_THREADS, their code is written in parallel\n");
+
+    std::fprintf(stderr, "\n"
+        "System call sandbox: EGALITO_USE_SYSCALL_SANDBOX=1\n"
+        "    calls egalito_sandbox_syscall_N/_default before system calls;\n"
+        "    with EGALITO_SYSCALL_ALLOW=0,1,... sites that can only make\n"
+        "    listed (or only unlisted) calls are not checked at runtime\n");
+
+    std::fprintf(stderr, "\n"
+        "System call filter: EGALITO_USE_SECCOMP_SANDBOX=1\n"
+        "    installs a seccomp filter that only allows the system calls\n"
+        "    found in the program, instead of calling enforcement functions\n");
+
+    std::fprintf(stderr, "\n"
+        "Sampling profile: EGALITO_PROFILE=(output file)\n"
+        "    samples the program with SIGPROF (EGALITO_PROFILE_USEC apart)\n"
+        "    and writes function counts in the format etorder reads\n");
+
+    std::fprintf(stderr, "\n"
+        "Hot patching: EGALITO_HOTPATCH_SOCKET=(socket path)\n"
+        "    with EGALITO_USE_SHUFFLING, applies passes to functions of the\n"
+        "    running program on request; see app/hotpatch.py\n");
+
+    std::fprintf(stderr, "\n"
+        "Call trace: EGALITO_LOG_CALL=1 EGALITO_LOG_CALL_TRACE=(output file)\n"
+        "    records calls and returns in per-thread binary buffers instead\n"
+        "    of printing them; decode with etprofile --calls (file)\n");
 }
@@ -0,0 +1,101 @@
+#include <cstdlib>  // for getenv, atexit
+#include <chrono>
+#include "async.h"
+#include "log.h"
+
+AsyncLogSink *AsyncLogSink::getInstance() {
+    // never destroyed, so that messages logged at exit are not lost
+    static AsyncLogSink *instance = [] () -> AsyncLogSink * {
+        const char *value = getenv("EGALITO_LOG_ASYNC");
+        if(!value || !*value || *value == '0') return nullptr;
+        auto sink = new AsyncLogSink();
+        std::atexit(&AsyncLogSink::stopAtExit);
+        return sink;
+    }();
+    return instance;
+}
+
+AsyncLogSink::AsyncLogSink() : ring(new Slot[CAPACITY]), enqueuePos(0),
+    dequeuePos(0), writtenPos(0), stopping(false) {
+
+    for(size_t i = 0; i < CAPACITY; i ++) {
+        ring[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    writer = std::thread(&AsyncLogSink::run, this);
+}
+
+void AsyncLogSink::push(std::string &&message) {
+    if(stopping.load(std::memory_order_acquire)) {
+        // the writer thread is gone during exit
+        (*LogStream::getStream()) << message;
+        return;
+    }
+
+    size_t pos = enqueuePos.load(std::memory_order_relaxed);
+    Slot *slot;
+    for(;;) {
+        slot = &ring[pos & (CAPACITY - 1)];
+        size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        auto diff = static_cast<long>(sequence) - static_cast<long>(pos);
+        if(diff == 0) {
+            if(enqueuePos.compare_exchange_weak(pos, pos + 1,
+                std::memory_order_relaxed)) {
+
+                break;
+            }
+        }
+        else {
+            // the ring is full, give the writer a chance to catch up
+            if(diff < 0) std::this_thread::yield();
+            pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+    slot->message = std::move(message);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+}
+
+bool AsyncLogSink::pop(std::string &message) {
+    size_t pos = dequeuePos.load(std::memory_order_relaxed);
+    auto slot = &ring[pos & (CAPACITY - 1)];
+    if(slot->sequence.load(std::memory_order_acquire) != pos + 1) {
+        return false;
+    }
+    message = std::move(slot->message);
+    slot->message.clear();
+    slot->sequence.store(pos + CAPACITY, std::memory_order_release);
+    dequeuePos.store(pos + 1, std::memory_order_relaxed);
+    return true;
+}
+
+void AsyncLogSink::flush() {
+    auto target = enqueuePos.load(std::memory_order_acquire);
+    while(writtenPos.load(std::memory_order_acquire) < target) {
+        std::this_thread::yield();
+    }
+}
+
+void AsyncLogSink::run() {
+    std::string message;
+    for(;;) {
+        bool any = false;
+        while(pop(message)) {
+            (*LogStream::getStream()) << message;
+            writtenPos.fetch_add(1, std::memory_order_release);
+            any = true;
+        }
+        if(any) LogStream::getStream()->flush();
+        else if(stopping.load(std::memory_order_acquire)) break;
+        else std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+}
+
+void AsyncLogSink::stopAtExit() {
+    auto sink = getInstance();
+    sink->flush();
+    sink->stopping.store(true, std::memory_order_release);
+    sink->writer.join();
+
+    // anything pushed while stopping
+    std::string message;
+    while(sink->pop(message)) (*LogStream::getStream()) << message;
+}
@@ -0,0 +1,49 @@
+#ifndef EGALITO_LOG_ASYNC_H
+#define EGALITO_LOG_ASYNC_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+
+/** Writes log messages to the LogStream from a background thread, so
+    that logging doesn't serialize the threads producing messages or show
+    up in their timing. Enabled by setting EGALITO_LOG_ASYNC.
+
+    Messages go through a bounded lock-free ring (multiple producers, one
+    consumer); a producer only waits when the ring is full. Each thread's
+    messages stay in order. Output written to std::cout directly, e.g. by
+    dump() calls inside IF_LOG, is not ordered with the queued messages.
+    Threads with their own LogStream::overrideThreadStream() bypass the
+    sink.
+*/
+class AsyncLogSink {
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        std::string message;
+    };
+    enum { CAPACITY = 4096 };  // a power of two
+
+    std::unique_ptr<Slot[]> ring;
+    std::atomic<size_t> enqueuePos;
+    std::atomic<size_t> dequeuePos;
+    std::atomic<size_t> writtenPos;
+    std::atomic<bool> stopping;
+    std::thread writer;
+public:
+    /** Returns nullptr unless EGALITO_LOG_ASYNC is set. */
+    static AsyncLogSink *getInstance();
+
+    void push(std::string &&message);
+
+    /** Waits until every message pushed so far has been written. */
+    void flush();
+private:
+    AsyncLogSink();
+    bool pop(std::string &message);
+    void run();
+    static void stopAtExit();
+};
+
+#endif
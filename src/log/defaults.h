@@ -65,3 +65,14 @@
 #define D_dtiming       9
 #define D_dreorder      0
 #endif
+
+/* Messages more verbose than a group's ceiling are removed at compile
+    time, so they cost nothing even inside hot loops; EGALITO_DEBUG can
+    only show messages up to the ceiling. A group foo can have its own
+    ceiling C_foo (at least 1); other groups use LOG_CEILING, which can
+    be set when building (LOG_CEILING=n in env.mk).
+*/
+#ifndef LOG_CEILING
+#define LOG_CEILING     20
+#endif
+// e.g. #define C_analysis  9
@@ -5,6 +5,7 @@
 #include <iomanip>
 #include "log.h"
 #include "registry.h"
+#include "async.h"
 
 LogLevelSetting::LogLevelSetting(const char *group,
     int initialBound) : bound(initialBound) {
@@ -14,15 +15,57 @@ LogLevelSetting::LogLevelSetting(const char *group,
 
 #define DEFAULT_STREAM (&std::cout)
 std::ostream *LogStream::output = DEFAULT_STREAM;
+thread_local std::ostream *LogStream::threadOutput = nullptr;
 
 void LogStream::overrideStream(std::ostream *out) {
+    // messages still queued belong to the old stream
+    if(auto sink = AsyncLogSink::getInstance()) sink->flush();
     output = (out ? out : DEFAULT_STREAM);
 }
 
+static AsyncLogSink *getAsyncSink() {
+    return LogStream::hasThreadStream() ? nullptr
+        : AsyncLogSink::getInstance();
+}
+
+static thread_local std::ostringstream messageBuffer;
+static thread_local bool messageBufferInUse = false;
+
+LogMessage::LogMessage() : buffered(false) {
+    if(getAsyncSink()) {
+        // a message can be logged while formatting another one
+        out = messageBufferInUse ? new std::ostringstream() : &messageBuffer;
+        messageBufferInUse = true;
+        buffered = true;
+    }
+    else out = LogStream::getStream();
+}
+
+LogMessage::~LogMessage() {
+    if(buffered) {
+        auto buffer = static_cast<std::ostringstream *>(out);
+        AsyncLogSink::getInstance()->push(buffer->str());
+        if(buffer == &messageBuffer) {
+            messageBuffer.str(std::string());
+            messageBuffer.clear();
+            messageBufferInUse = false;
+        }
+        else delete buffer;
+    }
+}
+
 int _log_printf(const char *format, ...) {
     va_list args;
     int ret = 0;
-    if(LogStream::getStream() == DEFAULT_STREAM) {
+    if(auto sink = getAsyncSink()) {
+        char buffer[4096];
+        va_start(args, format);
+        ret = vsnprintf(buffer, sizeof buffer, format, args);
+        va_end(args);
+
+        sink->push(buffer);
+    }
+    else if(LogStream::getStream() == DEFAULT_STREAM) {
         va_start(args, format);
         ret = vfprintf(stdout, format, args);
         va_end(args);
@@ -43,7 +86,14 @@ int _log_printf_n(const char *format, ...) {
     va_list args;
     char buffer[4096];
     int ret = 0;
-    if(LogStream::getStream() == DEFAULT_STREAM) {
+    if(auto sink = getAsyncSink()) {
+        va_start(args, format);
+        ret = vsnprintf(buffer, sizeof buffer, format, args);
+        va_end(args);
+
+        sink->push(std::string(buffer) + '\n');
+    }
+    else if(LogStream::getStream() == DEFAULT_STREAM) {
         size_t len = strlen(format);
         memcpy(buffer, format, len);
         buffer[len++] = '\n';
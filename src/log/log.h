@@ -19,7 +19,8 @@ private:
     int bound;
 public:
     LogLevelSetting(const char *group, int initialBound);
-    bool shouldShow(int level) const { return level <= bound; }
+    bool shouldShow(int level) const
+        { return __builtin_expect(level <= bound, 0); }
     void setBound(int b) { this->bound = b; }
 
     // for debugging
@@ -29,11 +30,32 @@ public:
 class LogStream {
 private:
     static std::ostream *output;
+    static thread_local std::ostream *threadOutput;
 public:
-    static std::ostream *getStream() { return output; }
+    static std::ostream *getStream()
+        { return threadOutput ? threadOutput : output; }
+    static bool hasThreadStream() { return threadOutput != nullptr; }
 
     // pass out=nullptr to reset to standard output
     static void overrideStream(std::ostream *out);
+
+    // redirects only the calling thread; pass out=nullptr to undo
+    static void overrideThreadStream(std::ostream *out)
+        { threadOutput = out; }
+};
+
+/** One message from LOG or LOG0. With the async sink, the message is
+    formatted into a buffer of this thread and handed to the sink when
+    done; otherwise it goes straight to the LogStream.
+*/
+class LogMessage {
+private:
+    std::ostream *out;
+    bool buffered;
+public:
+    LogMessage();
+    ~LogMessage();
+    std::ostream &stream() { return *out; }
 };
 
 int _log_printf(const char *format, ...);
@@ -48,35 +70,47 @@ std::ostream &_log_stream();
 #define _STRINGIZE2(x) _STRINGIZE(x)
 #define DEBUG_GROUP_NAME _STRINGIZE2(DEBUG_GROUP)
 
+#define _DEBUG_CEILING_NAME _APPEND2(C_, DEBUG_GROUP)
+#if _DEBUG_CEILING_NAME > 0
+    #define DEBUG_CEILING _DEBUG_CEILING_NAME
+#else
+    #define DEBUG_CEILING LOG_CEILING
+#endif
+
 #if defined(DEBUG_LEVEL) && DEBUG_LEVEL >= 0
     #define LOGGING_PRELUDE() \
         static LogLevelSetting _logLevel( \
             DEBUG_GROUP_NAME, DEBUG_LEVEL)
+    // levels are constants, so the first test is decided when compiling
+    #define _LOG_SHOWN(level) \
+        ((level) <= DEBUG_CEILING && _logLevel.shouldShow(level))
     #define IF_LOG(level) \
-        if(_logLevel.shouldShow(level))
+        if(_LOG_SHOWN(level))
 
     #define LOG(level, ...) \
         do { \
-            if(_logLevel.shouldShow(level)) { \
-                _log_stream() << __VA_ARGS__ << '\n'; \
+            if(_LOG_SHOWN(level)) { \
+                LogMessage _logMessage; \
+                _logMessage.stream() << __VA_ARGS__ << '\n'; \
             } \
         } while(0)
     #define LOG0(level, ...) \
         do { \
-            if(_logLevel.shouldShow(level)) { \
-                _log_stream() << __VA_ARGS__; \
+            if(_LOG_SHOWN(level)) { \
+                LogMessage _logMessage; \
+                _logMessage.stream() << __VA_ARGS__; \
             } \
         } while(0)
 
     #define CLOG(level, format, ...) \
         do { \
-            if(_logLevel.shouldShow(level)) { \
+            if(_LOG_SHOWN(level)) { \
                 _log_printf_n(format, ##__VA_ARGS__); \
             } \
         } while(0)
     #define CLOG0(level, format, ...) \
         do { \
-            if(_logLevel.shouldShow(level)) { \
+            if(_LOG_SHOWN(level)) { \
                 _log_printf(format, ##__VA_ARGS__); \
             } \
         } while(0)
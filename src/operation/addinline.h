@@ -2,10 +2,19 @@
 #define EGALITO_OPERATION_ADDINLINE_PASS_H
 
 #include <vector>
+#include <memory>
 #include <functional>
 #include "instr/instr.h"
 #include "instr/register.h"
 
+class Function;
+class RegisterLiveness;
+
+/** Inserts a Modification's code at a point, saving and restoring the
+    registers it clobbers. Registers that are dead at the point (per
+    RegisterLiveness) are not saved, which for most instrumentation
+    leaves only the flags or nothing at all to spill.
+*/
 class ChunkAddInline {
 public:
     typedef std::vector<Instruction *> InstrList;
@@ -59,18 +68,22 @@ private:
     };
 private:
     Modification *modification;
+    Function *liveFunction;     // the one liveness was computed for
+    std::unique_ptr<RegisterLiveness> liveness;
 public:
     // allow this modification to be applied in multiple places.
     // takes ownership of modification and will free it.
     ChunkAddInline(Modification *modification);
     ChunkAddInline(std::vector<Register> regList,
         std::function<std::vector<Instruction *> (unsigned int)> generator);
-    ~ChunkAddInline() { delete modification; }
+    ~ChunkAddInline();
 
     void insertBefore(Instruction *point, bool beforeJumpTo);
     void insertAfter(Instruction *point);
 private:
-    std::vector<Instruction *> getFullCode(Instruction *point);
+    std::vector<Instruction *> getFullCode(Instruction *point, bool after);
+    RegList getLiveRegisters(const RegList &regList, Function *function,
+        Instruction *point, bool after);
     void extendList(std::vector<Instruction *> &list,
         const std::vector<Instruction *> &additions);
 };
@@ -18,6 +18,10 @@
 #endif
 #include "log/log.h"
 
+int ChunkMutator::batchDepth = 0;
+std::vector<Chunk *> ChunkMutator::batchRoots;
+std::set<Chunk *> ChunkMutator::batchRootSet;
+
 void ChunkMutator::makePositionFor(Chunk *child) {
     PositionFactory *positionFactory = PositionFactory::getInstance();
     Position *pos = nullptr;
@@ -80,6 +84,7 @@ void ChunkMutator::append(Chunk *child) {
 
     if(!child->getPosition()) makePositionFor(child);
     updateSizesAndAuthorities(child);
+    markFunctionModified();
 }
 
 void ChunkMutator::insertAfter(Chunk *insertPoint, Chunk *newChunk) {
@@ -103,6 +108,7 @@ void ChunkMutator::insertAfter(Chunk *insertPoint, Chunk *newChunk) {
 
     if(!newChunk->getPosition()) makePositionFor(newChunk);
     updateSizesAndAuthorities(newChunk);
+    markFunctionModified();
 
     // if the next sibling has children, need to update their position
     // (this happens when inserting one Block between two others)
@@ -154,6 +160,7 @@ void ChunkMutator::insertBefore(Chunk *insertPoint, Chunk *newChunk) {
     }
 
     updateSizesAndAuthorities(newChunk);
+    markFunctionModified();
 }
 
 void ChunkMutator::insertBeforeJumpTo(Instruction *insertPoint, Instruction *newChunk) {
@@ -234,6 +241,7 @@ void ChunkMutator::remove(Chunk *child) {
 
     // update authority pointers in positions
     updateGenerationCounts(chunk);  // ???
+    markFunctionModified();
 }
 
 void ChunkMutator::removeLast(int n) {
@@ -259,6 +267,7 @@ void ChunkMutator::removeLast(int n) {
 
     // update authority pointers in positions
     updateGenerationCounts(chunk);  // ???
+    markFunctionModified();
 }
 
 void ChunkMutator::splitBlockBefore(Instruction *point) {
@@ -393,6 +402,7 @@ void ChunkMutator::modifiedChildSize(Chunk *child, int added) {
 
     // update authority pointers in positions
     updateGenerationCounts(child);
+    markFunctionModified();
 }
 
 void ChunkMutator::setPosition(address_t address) {
@@ -416,6 +426,15 @@ void ChunkMutator::setNextSibling(Chunk *c, Chunk *next) {
     }
 }
 
+void ChunkMutator::markFunctionModified() {
+    for(Chunk *c = chunk; c; c = c->getParent()) {
+        if(auto function = dynamic_cast<Function *>(c)) {
+            function->markModified();
+            break;
+        }
+    }
+}
+
 void ChunkMutator::updateSizesAndAuthorities(Chunk *child) {
     // update sizes of parents and grandparents
     for(Chunk *c = chunk; c && !dynamic_cast<Module *>(c); c = c->getParent()) {
@@ -457,12 +476,31 @@ void ChunkMutator::updatePositions() {
 
     for(Chunk *c = chunk; c; c = c->getParent()) {
         if(dynamic_cast<AbsolutePosition *>(c->getPosition())) {
+            if(batchDepth > 0) {
+                if(batchRootSet.insert(c).second) batchRoots.push_back(c);
+                continue;
+            }
             updatePositionHelper(c);
             //PositionDump().visit(c);
         }
     }
 }
 
+void ChunkMutator::commitBatch() {
+    if(batchRoots.empty()) return;
+
+    LOG(12, "updating positions of " << batchRoots.size()
+        << " batched subtrees");
+
+    // recalculate in the order the subtrees were first modified
+    std::vector<Chunk *> roots;
+    roots.swap(batchRoots);
+    batchRootSet.clear();
+    for(auto root : roots) {
+        updatePositionHelper(root);
+    }
+}
+
 void ChunkMutator::updateAuthorityHelper(Chunk *root) {
     root->getPosition()->updateAuthority();
 
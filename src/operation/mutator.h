@@ -1,6 +1,8 @@
 #ifndef EGALITO_OPERATION_MUTATOR_H
 #define EGALITO_OPERATION_MUTATOR_H
 
+#include <vector>
+#include <set>
 #include "disasm/reassemble.h"
 #include "chunk/chunk.h"
 #include "chunk/chunklist.h"
@@ -15,14 +17,38 @@ class Instruction;
     because only parents' sizes must be updated as a result. Position updates
     are delayed and applied by the destructor (can also be manually invoked),
     because this potentially requires updating many sibling positions.
+
+    Passes that make many small edits (one ChunkMutator per inserted
+    instruction, or one per Block) should hold a ChunkMutator::Batch for
+    the whole Function, so that positions are recalculated once instead of
+    once per mutator.
 */
 class ChunkMutator {
+public:
+    /** While any Batch is alive, ChunkMutators only record which subtrees
+        need position updates. The outermost Batch recalculates each of
+        them once when it is destroyed. Sizes are still updated right away.
+
+        Addresses read inside the batch may be stale, just as they are
+        inside a single ChunkMutator; do not delete a mutated Function
+        before the Batch ends.
+    */
+    class Batch {
+    public:
+        Batch() { ChunkMutator::batchDepth ++; }
+        ~Batch() { if(-- ChunkMutator::batchDepth == 0) commitBatch(); }
+    };
+private:
+    static int batchDepth;
+    static std::vector<Chunk *> batchRoots;
+    static std::set<Chunk *> batchRootSet;
 private:
     Chunk *chunk;
     bool allowUpdates;
 public:
     ChunkMutator(Chunk *chunk, bool allowUpdates = true)
-        : chunk(chunk), allowUpdates(allowUpdates) {}
+        : chunk(chunk), allowUpdates(allowUpdates)
+        { if(PositionManager::isFrozen()) PositionManager::thaw(); }
     ~ChunkMutator() { updatePositions(); }
 
     void makePositionFor(Chunk *child);
@@ -89,10 +115,12 @@ public:
     void setPreviousSibling(Chunk *c, Chunk *prev);
     void setNextSibling(Chunk *c, Chunk *next);
 private:
+    void markFunctionModified();
     void updateSizesAndAuthorities(Chunk *child);
     void updateGenerationCounts(Chunk *child);
     void updateAuthorityHelper(Chunk *root);
-    void updatePositionHelper(Chunk *root);
+    static void updatePositionHelper(Chunk *root);
+    static void commitBatch();
 };
 
 #endif
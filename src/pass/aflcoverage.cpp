@@ -1,7 +1,11 @@
 #include <vector>
 #include <cassert>
+#include <cstring>  // for std::strcpy
 #include "aflcoverage.h"
+#include "analysis/analysiscache.h"
+#include "chunk/module.h"
 #include "disasm/disassemble.h"
+#include "elf/symbol.h"
 #include "instr/register.h"
 #include "instr/concrete.h"
 #include "operation/mutator.h"
@@ -10,32 +14,44 @@
 #include "pass/switchcontext.h"
 #include "types.h"
 
+#include "log/log.h"
+
+// each module's counters get a region of their own, one after the other
+#define COUNTER_REGION_ADDRESS  0x38000000
+#define COUNTER_REGION_STRIDE   0x100000
+#define COUNTER_SECTION_NAME    ".coverage.counters"
+#define COUNTER_SYMBOL_NAME     "__egalito_coverage_counters"
+
+AFLCoveragePass::AFLCoveragePass(Mode mode) : mode(mode), entryPoint(nullptr),
+    blockID(1), counterRegionAddress(COUNTER_REGION_ADDRESS),
+    counterSection(nullptr) {}
+
 void AFLCoveragePass::visit(Program *program) {
     auto allocateFunc = ChunkFind2(program).findFunction(
         "egalito_allocate_afl_shm");
+    auto forkServerFunc = ChunkFind2(program).findFunction(
+        "egalito_afl_forkserver");
 
-    if(allocateFunc) {
-        SwitchContextPass switchContext;
-        allocateFunc->accept(&switchContext);
-
-        // add call to afl shm allocate function in __libc_start_main
-        auto call = new Instruction();
-        auto callSem = new ControlFlowInstruction(
-            X86_INS_CALL, call, "\xe8", "call", 4);
-        callSem->setLink(new NormalLink(allocateFunc, Link::SCOPE_EXTERNAL_JUMP));
-        call->setSemantic(callSem);
-        
-        {
-            auto sourceFunc = ChunkFind2(program).findFunction(
-                "__libc_start_main");
-            assert(sourceFunc && "AFLCoveragePass requires libc to be present (uniongen)");
-            auto block1 = sourceFunc->getChildren()->getIterable()->get(0);
-
-            {
-                ChunkMutator m(block1, true);
-                m.prepend(call);
-            }
+    Function *libcStart = nullptr;
+    if(allocateFunc || forkServerFunc) {
+        libcStart = ChunkFind2(program).findFunction("__libc_start_main");
+        assert(libcStart && "AFLCoveragePass requires libc to be present (uniongen)");
+    }
+
+    // the fork server starts each test case from main, once constructors
+    // have run; without a main symbol, fall back to the start of libc
+    if(forkServerFunc) {
+        Function *mainFunc = nullptr;
+        if(auto module = program->getMain()) {
+            mainFunc = ChunkFind2(program).findFunctionInModule("main", module);
         }
+        addEntryCall(mainFunc ? mainFunc : libcStart, forkServerFunc);
+    }
+
+    // add call to afl shm allocate function in __libc_start_main; it is
+    // prepended last, so the map exists before any fork
+    if(allocateFunc) {
+        addEntryCall(libcStart, allocateFunc);
     }
 
     if(auto f = dynamic_cast<Function *>(program->getEntryPoint())) {
@@ -46,7 +62,19 @@ void AFLCoveragePass::visit(Program *program) {
 }
 
 void AFLCoveragePass::visit(Module *module) {
-    if(module->getLibrary()->getRole() != Library::ROLE_EXTRA) {
+    if(module->getLibrary()->getRole() == Library::ROLE_EXTRA) return;
+
+    if(mode == MODE_COUNTERS) {
+        counterSection = createCounterSection(module);
+        recurse(module);
+
+        auto symbol = counterSection->getGlobalVariables()[0]->getSymbol();
+        symbol->setSize(counterSection->getSize());
+        LOG(1, "coverage: " << counterSection->getSize()
+            << " counters in module [" << module->getName() << "]");
+        counterSection = nullptr;
+    }
+    else {
         recurse(module);
     }
 }
@@ -91,13 +119,138 @@ void AFLCoveragePass::visit(Function *function) {
     // sphinx3, function does tail recursion to itself
     if(function->getName() == "mdef_phone_id") return;
 
-    recurse(function);
+    if(mode == MODE_COUNTERS) {
+        // decided up front, the CFG no longer matches once code is added
+        for(auto block : getCountedBlocks(function)) {
+            addCounterCode(block);
+        }
+    }
+    else {
+        recurse(function);
+    }
+}
+
+void AFLCoveragePass::addEntryCall(Function *function, Function *target) {
+    SwitchContextPass switchContext;
+    target->accept(&switchContext);
+
+    auto call = new Instruction();
+    auto callSem = new ControlFlowInstruction(
+        X86_INS_CALL, call, "\xe8", "call", 4);
+    callSem->setLink(new NormalLink(target, Link::SCOPE_EXTERNAL_JUMP));
+    call->setSemantic(callSem);
+
+    auto block1 = function->getChildren()->getIterable()->get(0);
+    ChunkMutator m(block1, true);
+    m.prepend(call);
 }
 
 void AFLCoveragePass::visit(Block *block) {
     addCoverageCode(block);
 }
 
+std::vector<Block *> AFLCoveragePass::getCountedBlocks(Function *function) {
+    auto analysis = AnalysisCache::getInstance()->get(function);
+    auto cfg = analysis->getCFG();
+    auto dominance = analysis->getDominance();
+
+    // same pruning as SanitizerCoverage: if every successor is dominated
+    // by the block, or every predecessor is post-dominated by it, the
+    // block ran whenever they did. The entry is always counted.
+    std::vector<Block *> blockList;
+    for(ControlFlow::id_t id = 0; id < ControlFlow::id_t(cfg->getCount());
+        id ++) {
+
+        auto node = cfg->get(id);
+        if(id != 0) {
+            auto successors = node->successorIDs();
+            bool fullDominator = !successors.empty();
+            for(auto s : successors) {
+                if(!dominance->dominates(id, s)) fullDominator = false;
+            }
+
+            auto predecessors = node->predecessorIDs();
+            bool fullPostDominator = !predecessors.empty();
+            for(auto p : predecessors) {
+                if(!dominance->postDominates(id, p)) fullPostDominator = false;
+            }
+
+            if(fullDominator || fullPostDominator) continue;
+        }
+        blockList.push_back(node->getBlock());
+    }
+    return blockList;
+}
+
+DataSection *AFLCoveragePass::createCounterSection(Module *module) {
+    auto regionList = module->getDataRegionList();
+    if(auto section = regionList->findDataSection(COUNTER_SECTION_NAME)) {
+        return section;
+    }
+
+    auto address = counterRegionAddress;
+    counterRegionAddress += COUNTER_REGION_STRIDE;
+
+    auto region = new DataRegion(address);
+    region->setPosition(new AbsolutePosition(address));
+    regionList->getChildren()->add(region);
+    region->setParent(regionList);
+
+    auto section = new DataSection();
+    section->setName(COUNTER_SECTION_NAME);
+    section->setAlignment(0x40);
+    section->setPermissions(SHF_WRITE | SHF_ALLOC);
+    section->setPosition(new AbsoluteOffsetPosition(section, 0));
+    section->setType(DataSection::TYPE_DATA);
+    region->getChildren()->add(section);
+    section->setParent(region);
+
+    // the fuzzer finds the counters through this; its size is set once
+    // the whole module has been instrumented
+    auto var = new GlobalVariable(COUNTER_SYMBOL_NAME);
+    var->setPosition(new AbsolutePosition(address));
+    char *name = new char[var->getName().length() + 1];
+    std::strcpy(name, var->getName().c_str());
+    var->setSymbol(new Symbol(address, 0, name,
+        Symbol::TYPE_OBJECT, Symbol::BIND_GLOBAL, 0, 0));
+    section->addGlobalVariable(var);
+
+    return section;
+}
+
+void AFLCoveragePass::addCounterCode(Block *block) {
+    auto section = counterSection;
+    auto region = static_cast<DataRegion *>(section->getParent());
+    auto offset = section->getSize();
+    if(offset >= COUNTER_REGION_STRIDE) {
+        throw "AFLCoveragePass: too many coverage counters in one module";
+    }
+
+    section->setSize(offset + 1);
+    region->setSize(region->getSize() + 1);
+    auto bytes = region->getDataBytes();
+    bytes.push_back('\0');
+    region->saveDataBytes(bytes);
+
+    // incb only clobbers the flags, which are usually dead at block entry
+    ChunkAddInline ai({X86_REG_EFLAGS}, [section, offset] (unsigned int) {
+        //   0:   fe 05 cc cc cc cc       incb   0xcccccccc(%rip)
+        DisasmHandle handle(true);
+        auto instr = new Instruction();
+        auto sem = new LinkedInstruction(instr);
+        sem->setAssembly(DisassembleInstruction(handle).makeAssemblyPtr(
+            std::vector<unsigned char>{0xfe, 0x05, 0x00, 0x00, 0x00, 0x00}));
+        sem->setLink(new DataOffsetLink(section, offset,
+            Link::SCOPE_INTERNAL_DATA));
+        sem->setIndex(0);
+        instr->setSemantic(sem);
+
+        return std::vector<Instruction *>{ instr };
+    });
+    auto instr1 = block->getChildren()->getIterable()->get(0);
+    ai.insertBefore(instr1, true);
+}
+
 #define GET_BYTE(x, shift) static_cast<unsigned char>(((x) >> (shift*8)) & 0xff)
 #define GET_BYTES(x) GET_BYTE((x),0), GET_BYTE((x),1), GET_BYTE((x),2), GET_BYTE((x),3)
 
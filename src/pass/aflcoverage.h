@@ -1,20 +1,51 @@
 #ifndef EGALITO_PASS_AFL_COVERAGE_H
 #define EGALITO_PASS_AFL_COVERAGE_H
 
+#include <vector>
 #include "chunkpass.h"
+#include "chunk/dataregion.h"
 
+/** Adds block coverage to every instrumented Function.
+
+    MODE_AFL is the classic AFL sequence: a hash of the previous and the
+    current block indexes a byte in the shared memory map.
+
+    MODE_COUNTERS gives each block its own 8-bit counter (as with
+    libFuzzer's inline 8-bit counters), one incb per block. The counters
+    of a module are contiguous in its own DataSection, which starts at the
+    __egalito_coverage_counters symbol. Blocks whose execution is implied
+    by another block's are not counted: one that dominates all of its
+    successors, or post-dominates all of its predecessors.
+
+    If the injected coverage library provides egalito_allocate_afl_shm and
+    egalito_afl_forkserver, calls to them are added at the start of libc
+    and of main respectively, so afl-fuzz can reuse one initialized
+    process for every test case.
+*/
 class AFLCoveragePass : public ChunkPass {
+public:
+    enum Mode {
+        MODE_AFL,
+        MODE_COUNTERS
+    };
 private:
+    Mode mode;
     Function *entryPoint;
     unsigned long blockID;
+    address_t counterRegionAddress;
+    DataSection *counterSection;
 public:
-    AFLCoveragePass() : blockID(1) {}
+    AFLCoveragePass(Mode mode = MODE_AFL);
     virtual void visit(Program *program);
     virtual void visit(Module *module);
     virtual void visit(Function *function);
     virtual void visit(Block *block);
 private:
+    void addEntryCall(Function *function, Function *target);
     void addCoverageCode(Block *block);
+    void addCounterCode(Block *block);
+    std::vector<Block *> getCountedBlocks(Function *function);
+    DataSection *createCounterSection(Module *module);
 };
 
 
@@ -0,0 +1,137 @@
+#include <cstring>  // for std::strlen
+#include "aflpersistent.h"
+#include "chunk/concrete.h"
+#include "chunk/link.h"
+#include "chunk/plt.h"
+#include "instr/concrete.h"
+#include "operation/find2.h"
+#include "log/log.h"
+
+#define TABLE_REGION_ADDRESS    0x34000000
+#define TABLE_SECTION_NAME      ".afl.persistent"
+#define TABLE_SIGNATURE_SIZE    32
+
+// afl-fuzz switches to persistent mode if the binary contains this
+#define PERSISTENT_SIGNATURE    "##SIG_AFL_PERSISTENT##"
+
+void AFLPersistentPass::visit(Program *program) {
+    target = ChunkFind2(program).findFunction(targetName.c_str());
+    if(!target) {
+        throw "AFLPersistentPass: target function not found";
+    }
+    wrapper = ChunkFind2(program).findFunction(
+        "egalito_afl_persistent_wrapper");
+    if(!wrapper) {
+        LOG(0, "AFLPersistentPass: libcoverage.so not found, not looping");
+        return;
+    }
+
+    recurse(program);
+    LOG(1, "persistent: redirected " << redirected << " references to ["
+        << target->getName() << "]");
+
+    // table: signature, target, iterations, region count, regions
+    auto table = createTableSection(program->getMain());
+    appendTableWord(table, 0,
+        new AbsoluteNormalLink(target, Link::SCOPE_EXTERNAL_CODE));
+    appendTableWord(table, iterations);
+
+    auto module = static_cast<Module *>(target->getParent()->getParent());
+    std::vector<DataSection *> snapshotList;
+    for(auto region : CIter::regions(module)) {
+        for(auto section : CIter::children(region)) {
+            if(isSnapshotted(section)) snapshotList.push_back(section);
+        }
+    }
+    appendTableWord(table, snapshotList.size());
+    for(auto section : snapshotList) {
+        LOG(10, "persistent: restoring [" << section->getName() << "] of "
+            << module->getName());
+        appendTableWord(table, 0, new AbsoluteDataLink(section, 0,
+            Link::SCOPE_EXTERNAL_DATA));
+        appendTableWord(table, section->getSize());
+    }
+}
+
+void AFLPersistentPass::visit(Module *module) {
+    if(module->getLibrary()->getRole() == Library::ROLE_EXTRA) return;
+    recurse(module);
+}
+
+void AFLPersistentPass::visit(Instruction *instruction) {
+    auto semantic = dynamic_cast<ControlFlowInstruction *>(
+        instruction->getSemantic());
+    if(!semantic) return;
+
+    auto link = semantic->getLink();
+    if(!link) return;
+
+    Chunk *linkTarget = nullptr;
+    if(auto pltLink = dynamic_cast<PLTLink *>(link)) {
+        linkTarget = pltLink->getPLTTrampoline()->getTarget();
+    }
+    else {
+        linkTarget = link->getTarget();
+    }
+
+    if(linkTarget == target) {
+        semantic->setLink(new NormalLink(wrapper, Link::SCOPE_EXTERNAL_JUMP));
+        delete link;
+        redirected ++;
+    }
+}
+
+bool AFLPersistentPass::isSnapshotted(DataSection *section) {
+    if(!(section->getPermissions() & SHF_WRITE)) return false;
+    if(!section->isData() && !section->isBss()) return false;
+
+    // relro sections are read-only by the time the target runs
+    auto name = section->getName();
+    if(name.find(".got") == 0) return false;
+    if(name.find(".data.rel.ro") == 0) return false;
+    return section->getSize() > 0;
+}
+
+DataSection *AFLPersistentPass::createTableSection(Module *module) {
+    auto regionList = module->getDataRegionList();
+    auto region = new DataRegion(TABLE_REGION_ADDRESS);
+    region->setPosition(new AbsolutePosition(TABLE_REGION_ADDRESS));
+    regionList->getChildren()->add(region);
+    region->setParent(regionList);
+
+    auto section = new DataSection();
+    section->setName(TABLE_SECTION_NAME);
+    section->setAlignment(0x8);
+    section->setPermissions(SHF_ALLOC);
+    section->setPosition(new AbsoluteOffsetPosition(section, 0));
+    section->setType(DataSection::TYPE_DATA);
+    region->getChildren()->add(section);
+    section->setParent(region);
+
+    std::string signature(TABLE_SIGNATURE_SIZE, '\0');
+    signature.replace(0, std::strlen(PERSISTENT_SIGNATURE),
+        PERSISTENT_SIGNATURE);
+    region->setSize(signature.size());
+    section->setSize(signature.size());
+    region->saveDataBytes(signature);
+
+    return section;
+}
+
+void AFLPersistentPass::appendTableWord(DataSection *table,
+    unsigned long value, Link *link) {
+
+    auto region = static_cast<DataRegion *>(table->getParent());
+    auto offset = table->getSize();
+    region->setSize(region->getSize() + sizeof(value));
+    table->setSize(offset + sizeof(value));
+
+    auto bytes = region->getDataBytes();
+    bytes.append(reinterpret_cast<const char *>(&value), sizeof(value));
+    region->saveDataBytes(bytes);
+
+    if(link) {
+        DataVariable::create(table, TABLE_REGION_ADDRESS + offset, link,
+            nullptr);
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef EGALITO_PASS_AFL_PERSISTENT_H
+#define EGALITO_PASS_AFL_PERSISTENT_H
+
+#include <string>
+#include "chunkpass.h"
+
+class DataSection;
+
+/** Runs one function in an AFL persistent-mode loop, for fuzzing library
+    entry points without a fork (or an exec) per input.
+
+    Direct calls and jumps to the target, including those through the PLT,
+    are redirected to egalito_afl_persistent_wrapper from libcoverage.so.
+    The wrapper saves the six integer argument registers and calls the
+    target up to the given number of times, stopping itself between runs
+    so that afl-fuzz can supply the next input (the target must read its
+    input itself, e.g. from the file afl-fuzz rewrites). Before each rerun,
+    the writable data and bss sections of the target's module are restored
+    from a snapshot taken at the first call; heap state is not.
+
+    The wrapper finds its settings in a table at a fixed address, which
+    also holds the signature that makes afl-fuzz use persistent mode.
+*/
+class AFLPersistentPass : public ChunkPass {
+private:
+    std::string targetName;
+    unsigned long iterations;
+    Function *target;
+    Function *wrapper;
+    size_t redirected;
+public:
+    AFLPersistentPass(const std::string &targetName,
+        unsigned long iterations = 1000)
+        : targetName(targetName), iterations(iterations), target(nullptr),
+        wrapper(nullptr), redirected(0) {}
+
+    virtual void visit(Program *program);
+    virtual void visit(Module *module);
+    virtual void visit(Instruction *instruction);
+private:
+    bool isSnapshotted(DataSection *section);
+    DataSection *createTableSection(Module *module);
+    void appendTableWord(DataSection *table, unsigned long value,
+        Link *link = nullptr);
+};
+
+#endif
@@ -4,6 +4,7 @@
 #include "analysis/call.h"
 #include "analysis/dataflow.h"
 #include "analysis/walker.h"
+#include "analysis/analysiscache.h"
 #include "analysis/frametype.h"
 #include "instr/concrete.h"
 #include "instr/semantic.h"
@@ -30,13 +31,14 @@ RegisterSet& UnusedRegister::detect(Function *function) {
 #ifdef ARCH_AARCH64
     DataFlow df;
     auto working = df.getWorkingSet(function);
-    FrameType ft(function);
+    auto analysis = AnalysisCache::getInstance()->get(function);
+    auto ft = analysis->getFrameType();
 
     //auto module = dynamic_cast<Module *>(function->getParent()->getParent());
 
     regset.setAll();
     for(const auto& state : working->getStateList()) {
-        if(ft.createsFrame() && StateGroup::isPushOrPop(&state)) continue;
+        if(ft->createsFrame() && StateGroup::isPushOrPop(&state)) continue;
         if(StateGroup::isCall(&state)) continue;
         // we must assume ABI use for unknown targets
         //if(StateGroup::isExternalJump(&state, module)) continue;
@@ -155,7 +157,8 @@ void CancelPushPass::optimize(const std::vector<Function *>& rootList) {
             for(auto vv : sccOrder.get()) {
                 for(auto v : vv) {
                     auto f = graph.getFunction(v);
-                    if(FrameType(f).createsFrame()) {
+                    if(AnalysisCache::getInstance()->get(f)
+                        ->getFrameType()->createsFrame()) {
                         LOG(10, "maybe optimize " << f->getName());
                     }
                 }
@@ -1,10 +1,12 @@
 #include <cassert>
 #include "collapseplt.h"
 #include "chunk/link.h"
+#include "chunk/linkindex.h"
 #include "chunk/plt.h"
 #include "conductor/conductor.h"
 #include "instr/semantic.h"
 #include "operation/find2.h"
+#include "util/cpusig.h"
 #include "log/log.h"
 #include "log/temp.h"
 
@@ -51,9 +53,21 @@ CollapsePLTPass::CollapsePLTPass(Conductor *conductor)
     if(function) ifuncMap.emplace(#name, function);
 #endif
 
+    uint64_t signature = 0;
+#define KNOWN_IFUNC_SIGNATURE(value) \
+    signature = value;
+
 #include "../dep/ifunc/ifunc.h"
 
 #undef KNOWN_IFUNC_ENTRY
+#undef KNOWN_IFUNC_SIGNATURE
+
+    // an ifunc.h from before signatures were recorded is trusted as is
+    if(signature && signature != egalito_cpu_signature()) {
+        LOG(1, "CPU features differ from the ones IFuncs were determined"
+            " on, using lazy selection");
+        ifuncMap.clear();
+    }
 
     for(auto pair : ifuncMap) {
         assert(pair.second);
@@ -64,13 +78,28 @@ CollapsePLTPass::CollapsePLTPass(Conductor *conductor)
 void CollapsePLTPass::visit(Module *module) {
     //TemporaryLogLevel tll("pass", 20);
 
-    recurse(module);
+    if(auto index = LinkIndex::getInstance()) {
+        // only the instructions that call through a PLT entry
+        if(module->getPLTList()) {
+            for(auto trampoline : CIter::plts(module)) {
+                for(auto ref : index->getReferences(trampoline)) {
+                    if(auto semantic = ref.getSemantic()) collapse(semantic);
+                }
+            }
+        }
+    }
+    else {
+        recurse(module);
+    }
     recurse(module->getDataRegionList());
 }
 
 void CollapsePLTPass::visit(Instruction *instr) {
-    if(auto pltLink
-        = dynamic_cast<PLTLink *>(instr->getSemantic()->getLink())) {
+    collapse(instr->getSemantic());
+}
+
+void CollapsePLTPass::collapse(InstructionSemantic *semantic) {
+    if(auto pltLink = dynamic_cast<PLTLink *>(semantic->getLink())) {
 
         auto trampoline = pltLink->getPLTTrampoline();
 
@@ -80,7 +109,7 @@ void CollapsePLTPass::visit(Instruction *instr) {
             if(it != ifuncMap.end()) {
                 LOG(10, "resolving IFunc " << name
                     << " as " << it->second->getName());
-                instr->getSemantic()->setLink(
+                semantic->setLink(
                     new NormalLink(it->second, Link::SCOPE_EXTERNAL_JUMP));
                 delete pltLink;
             }
@@ -91,14 +120,14 @@ void CollapsePLTPass::visit(Instruction *instr) {
         }
 
         if(auto target = trampoline->getTarget()) {
-            instr->getSemantic()->setLink(
+            semantic->setLink(
                 new NormalLink(target, Link::SCOPE_EXTERNAL_JUMP));
             delete pltLink;
         }
         else {
             assert(trampoline->getExternalSymbol());
-            LOG(9, "Unresolved PLT entry from " << instr->getName()
-                << " to [" << trampoline->getExternalSymbol()->getName() << "]");
+            LOG(9, "Unresolved PLT entry to ["
+                << trampoline->getExternalSymbol()->getName() << "]");
         }
     }
 }
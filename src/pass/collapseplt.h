@@ -7,6 +7,11 @@
 class Conductor;
 class Function;
 
+/** Links callers of known IFuncs directly to the implementation that the
+    build machine selected (see dep/ifunc). The table is only used when
+    this CPU's feature signature matches the one recorded with it;
+    otherwise every IFunc keeps its lazy selector.
+*/
 class CollapsePLTPass : public ChunkPass {
 private:
     Conductor *conductor;
@@ -16,6 +21,8 @@ public:
     virtual void visit(Module *module);
     virtual void visit(Instruction *instr);
     virtual void visit(DataSection *section);
+private:
+    void collapse(InstructionSemantic *semantic);
 };
 
 #endif
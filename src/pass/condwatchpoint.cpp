@@ -1,19 +1,36 @@
 #include <cstring>  // for memset
+#include <cstddef>  // for offsetof
+#include <algorithm>
+#include <climits>
+#include <linux/perf_event.h>
+#include <linux/hw_breakpoint.h>
 #include "condwatchpoint.h"
 #include "operation/addinline.h"
 #include "operation/mutator.h"
 #include "disasm/disassemble.h"
-#include "chunk/module.h"
+#include "chunk/concrete.h"
+#include "chunk/initfunction.h"
 #include "instr/concrete.h"
+#include "instr/register.h"
 #include "log/log.h"
 
-void CondWatchpointPass::visit(Module *module) {
-#ifdef ARCH_X86_64
-    auto instr = Disassemble::instruction({0xc3});  // ret
-    // auto instr = Disassemble::instruction({0x0f, 0x0b});  // ud2
+#define DATA_REGION_ADDRESS 0x30000000
+#define DATA_NAMEREGION_ADDRESS 0x31000000
+#define DATA_REGION_NAME ("region-" #DATA_REGION_ADDRESS)
+#define DATA_SECTION_NAME ".profiling"
+#define DATA_NAMESECTION_NAME ".profiling.names"
+
+#define WATCH_REGION_ADDRESS 0x35000000
+#define WATCH_SECTION_NAME ".watch.attrs"
+
+#define MAX_DEBUG_REGISTERS 4
+
+static Function *makeFunction(Module *module, const char *name,
+    const std::vector<Instruction *> &instrList) {
+
     auto block = new Block();
 
-    auto symbol = new Symbol(0x0, 0, "egalito_cond_watchpoint_hit",
+    auto symbol = new Symbol(0x0, 0, name,
        Symbol::TYPE_FUNC, Symbol::BIND_GLOBAL, 0, 0);
     auto function = new Function(symbol);
     function->setName(symbol->getName());
@@ -22,19 +39,134 @@ void CondWatchpointPass::visit(Module *module) {
     module->getFunctionList()->getChildren()->add(function);
     function->setParent(module->getFunctionList());
     ChunkMutator(function).append(block);
-    ChunkMutator(block).append(instr);
+    for(auto instr : instrList) {
+        ChunkMutator(block).append(instr);
+    }
+    return function;
+}
+
+#ifdef ARCH_X86_64
+static Instruction *makeLinkedInstruction(
+    const std::vector<unsigned char> &bytes, Link *link) {
+
+    DisasmHandle handle(true);
+    auto instr = new Instruction();
+    auto sem = new LinkedInstruction(instr);
+    sem->setAssembly(DisassembleInstruction(handle).makeAssemblyPtr(bytes));
+    sem->setLink(link);
+    sem->setIndex(0);
+    instr->setSemantic(sem);
+    return instr;
+}
+
+static void appendImm32(std::vector<unsigned char> &bytes, uint32_t value) {
+    for(int i = 0; i < 4; i ++) bytes.push_back((value >> (8*i)) & 0xff);
+}
+
+/** Returns the memory operand an instruction writes, if any. In AT&T
+    order the destination is the last operand; these only read it.
+*/
+static const cs_x86_op *getStoreOperand(Assembly *assembly) {
+    auto asmOps = assembly->getAsmOperands();
+    if(asmOps->getOpCount() == 0) return nullptr;
+    auto op = &asmOps->getOperands()[asmOps->getOpCount() - 1];
+    if(op->type != X86_OP_MEM) return nullptr;
+
+    switch(assembly->getId()) {
+    case X86_INS_CMP:
+    case X86_INS_TEST:
+    case X86_INS_BT:
+    case X86_INS_PUSH:
+    case X86_INS_NOP:
+    case X86_INS_CALL:
+    case X86_INS_JMP:
+    case X86_INS_DIV:
+    case X86_INS_IDIV:
+    case X86_INS_MUL:
+    case X86_INS_IMUL:
+    case X86_INS_FLD:
+    case X86_INS_FILD:
+    case X86_INS_PREFETCHT0:
+    case X86_INS_PREFETCHT1:
+    case X86_INS_PREFETCHT2:
+    case X86_INS_PREFETCHNTA:
+    case X86_INS_PREFETCHW:
+    case X86_INS_CLFLUSH:
+        return nullptr;
+    default:
+        return op;
+    }
+}
+
+/** True if a store also changes general-purpose registers, so that the
+    stores after it can't share its address computation.
+*/
+static bool writesRegisters(Assembly *assembly) {
+    switch(assembly->getId()) {
+    case X86_INS_XCHG:
+    case X86_INS_XADD:
+    case X86_INS_CMPXCHG:
+        return true;
+    default:
+        break;
+    }
+    auto regs = assembly->getImplicitRegsWrite();
+    for(size_t i = 0; i < assembly->getImplicitRegsWriteCount(); i ++) {
+        if(regs[i] != X86_REG_EFLAGS) return true;
+    }
+    return false;
+}
+
+static bool isGroupRegister(unsigned int reg) {
+    if(reg == X86_REG_INVALID) return true;
+    int pid = X86Register::convertToPhysical(reg);
+    return X86Register::isInteger(pid) && X86Register::getWidth(pid, reg) == 8;
+}
+#endif
+
+void CondWatchpointPass::visit(Program *program) {
+    if(watchList.empty()) {
+        recurse(program);
+        return;
+    }
+
+#ifdef ARCH_X86_64
+    if(!resolveWatches(program->getMain())) return;
+
+    if(watchMode == WATCH_DEBUG_REGISTERS && !canUseDebugRegisters()) {
+        throw "CondWatchpointPass: watches don't fit in the debug registers";
+    }
+    if(watchMode != WATCH_RANGE_CHECKS && canUseDebugRegisters()) {
+        armDebugRegisters(program->getMain());
+        return;
+    }
 
-    this->condTarget = function;
+    recurse(program);
+    LOG(1, "watchpoint: added " << checkCount << " range checks for "
+        << rangeList.size() << " watched ranges");
+#endif
+}
+
+void CondWatchpointPass::visit(Module *module) {
+#ifdef ARCH_X86_64
+    this->condTarget = makeFunction(module, "egalito_cond_watchpoint_hit",
+        {Disassemble::instruction({0xc3})});  // ret
     recurse(module);
 #endif
 }
 
 void CondWatchpointPass::visit(Function *function) {
+    if(function == condTarget) return;
     if(function->getName() == "_init") return;
     if(function->getName() == "_fini") return;
     if(function->getName() == "__libc_csu_init") return;
     if(function->getName() == "__libc_csu_fini") return;
 
+    if(watchList.empty()) countCalls(function);
+    else checkStores(function);
+}
+
+void CondWatchpointPass::countCalls(Function *function) {
     auto module = static_cast<Module *>(function->getParent()->getParent());
     auto sectionPair = createDataSection(module);
 
@@ -100,15 +232,340 @@ void CondWatchpointPass::visit(Function *function) {
     auto sem = static_cast<LinkedInstruction *>(instr0->getSemantic());
     sem->regenerateAssembly();
     LOG(0, "adding profiling to function [" << function->getName()
-        << "] using global var " 
+        << "] using global var "
         << std::hex << sem->getLink()->getTargetAddress());
 }
 
-#define DATA_REGION_ADDRESS 0x30000000
-#define DATA_NAMEREGION_ADDRESS 0x31000000
-#define DATA_REGION_NAME ("region-" #DATA_REGION_ADDRESS)
-#define DATA_SECTION_NAME ".profiling"
-#define DATA_NAMESECTION_NAME ".profiling.names"
+void CondWatchpointPass::checkStores(Function *function) {
+#ifdef ARCH_X86_64
+    std::vector<StoreGroup> groupList;
+    std::vector<Instruction *> hitList;
+
+    for(auto block : CIter::children(function)) {
+        bool extendable = false;    // may the next store join the last group?
+        for(auto instr : CIter::children(block)) {
+            auto assembly = instr->getSemantic()->getAssembly();
+            const cs_x86_op *op = assembly ? getStoreOperand(&*assembly)
+                : nullptr;
+            if(!op) {
+                extendable = false;
+                continue;
+            }
+
+            auto &mem = op->mem;
+            if(mem.segment == X86_REG_FS || mem.segment == X86_REG_GS
+                || mem.base == X86_REG_RSP) {
+
+                extendable = false;
+                continue;
+            }
+
+            if(mem.base == X86_REG_RIP
+                || (mem.base == X86_REG_INVALID && mem.index == X86_REG_INVALID)) {
+
+                if(isStaticHit(instr, mem.base)) hitList.push_back(instr);
+                extendable = false;
+                continue;
+            }
+
+            // the check recomputes the address from the registers, which
+            // only works if the displacement isn't itself relocated
+            if(instr->getSemantic()->getLink()
+                || !isGroupRegister(mem.base) || !isGroupRegister(mem.index)) {
+
+                LOG(10, "watchpoint: can't check store in ["
+                    << function->getName() << "] at 0x" << std::hex
+                    << instr->getAddress());
+                extendable = false;
+                continue;
+            }
+
+            int64_t end = mem.disp + op->size;
+            if(end - 1 > INT_MAX) {
+                extendable = false;
+                continue;
+            }
+            auto last = groupList.empty() ? nullptr : &groupList.back();
+            if(extendable && last->base == mem.base
+                && last->index == mem.index && last->scale == mem.scale) {
+
+                if(mem.disp < last->minDisp) last->minDisp = mem.disp;
+                if(end > last->maxEnd) last->maxEnd = end;
+            }
+            else {
+                groupList.push_back({instr, mem.base, mem.index, mem.scale,
+                    mem.disp, end});
+            }
+            extendable = !writesRegisters(&*assembly);
+        }
+    }
+
+    for(auto instr : hitList) addHitCall(instr);
+    for(const auto &group : groupList) addRangeCheck(group);
+    checkCount += groupList.size();
+
+    if(!hitList.empty() || !groupList.empty()) {
+        ChunkMutator(function, true);
+    }
+#endif
+}
+
+bool CondWatchpointPass::resolveWatches(Module *module) {
+    auto regionList = module->getDataRegionList();
+    for(auto &watch : watchList) {
+        watch.section = regionList->findDataSectionContaining(watch.address);
+        if(!watch.section || watch.address + watch.size
+            > watch.section->getAddress() + watch.section->getSize()) {
+
+            LOG(0, "watchpoint: 0x" << std::hex << watch.address
+                << " is not in a data section of " << module->getName());
+            return false;
+        }
+    }
+
+    // one range check per section covers every watch in it
+    rangeList.clear();
+    for(const auto &watch : watchList) {
+        bool merged = false;
+        for(auto &range : rangeList) {
+            if(range.section != watch.section) continue;
+            address_t end = std::max(range.address + range.size,
+                watch.address + watch.size);
+            range.address = std::min(range.address, watch.address);
+            range.size = end - range.address;
+            merged = true;
+        }
+        if(!merged) rangeList.push_back(watch);
+    }
+    return true;
+}
+
+bool CondWatchpointPass::canUseDebugRegisters() const {
+#ifdef PERF_ATTR_SIZE_VER7
+    if(watchList.size() > MAX_DEBUG_REGISTERS) return false;
+    for(const auto &watch : watchList) {
+        switch(watch.size) {
+        case 1: case 2: case 4: case 8:
+            break;
+        default:
+            return false;
+        }
+        if(watch.address % watch.size) return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void CondWatchpointPass::armDebugRegisters(Module *module) {
+#if defined(ARCH_X86_64) && defined(PERF_ATTR_SIZE_VER7)
+    auto regionList = module->getDataRegionList();
+    auto region = new DataRegion(WATCH_REGION_ADDRESS);
+    region->setPosition(new AbsolutePosition(WATCH_REGION_ADDRESS));
+    regionList->getChildren()->add(region);
+    region->setParent(regionList);
+
+    auto section = new DataSection();
+    section->setName(WATCH_SECTION_NAME);
+    section->setAlignment(0x8);
+    section->setPermissions(SHF_ALLOC);
+    section->setPosition(new AbsoluteOffsetPosition(section, 0));
+    section->setType(DataSection::TYPE_DATA);
+    region->getChildren()->add(section);
+    section->setParent(region);
+
+    std::string bytes;
+    std::vector<Instruction *> instrList;
+    for(size_t i = 0; i < watchList.size(); i ++) {
+        const auto &watch = watchList[i];
+        size_t offset = bytes.size();
+
+        // a synchronous SIGTRAP on every write, in this thread and the
+        // ones it creates; si_perf_data tells the handler which watch
+        struct perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_BREAKPOINT;
+        attr.size = sizeof(attr);
+        attr.bp_type = HW_BREAKPOINT_W;
+        attr.bp_len = watch.size;
+        attr.sample_period = 1;
+        attr.inherit = 1;
+        attr.inherit_thread = 1;
+        attr.remove_on_exec = 1;
+        attr.sigtrap = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.sig_data = i;
+        bytes.append(reinterpret_cast<const char *>(&attr), sizeof(attr));
+
+        DataVariable::create(section, WATCH_REGION_ADDRESS + offset
+            + offsetof(struct perf_event_attr, bp_addr),
+            new AbsoluteDataLink(watch.section,
+                watch.address - watch.section->getAddress(),
+                Link::SCOPE_INTERNAL_DATA), nullptr);
+
+        // perf_event_open(&attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC)
+        instrList.push_back(makeLinkedInstruction({0x48, 0x8d, 0x3d, 0, 0, 0, 0},
+            new DataOffsetLink(section, offset, Link::SCOPE_INTERNAL_DATA)));
+        instrList.push_back(Disassemble::instruction({0x31, 0xf6}));
+        instrList.push_back(Disassemble::instruction(
+            {0xba, 0xff, 0xff, 0xff, 0xff}));
+        instrList.push_back(Disassemble::instruction(
+            {0x49, 0xc7, 0xc2, 0xff, 0xff, 0xff, 0xff}));
+        instrList.push_back(Disassemble::instruction(
+            {0x41, 0xb8, 0x08, 0x00, 0x00, 0x00}));    // PERF_FLAG_FD_CLOEXEC
+        instrList.push_back(Disassemble::instruction(
+            {0xb8, 0x2a, 0x01, 0x00, 0x00}));   // __NR_perf_event_open
+        instrList.push_back(Disassemble::instruction({0x0f, 0x05}));
+
+        LOG(1, "watchpoint: debug register for 0x" << std::hex
+            << watch.address << " (" << std::dec << watch.size << " bytes)");
+    }
+    instrList.push_back(Disassemble::instruction({0xc3}));  // ret
+
+    region->setSize(bytes.size());
+    section->setSize(bytes.size());
+    region->saveDataBytes(bytes);
+
+    auto arm = makeFunction(module, "egalito_cond_watchpoint_arm", instrList);
+    auto initFunction = new InitFunction(true, arm);
+    module->getInitFunctionList()->getChildren()->add(initFunction);
+    initFunction->setParent(module->getInitFunctionList());
+#endif
+}
+
+bool CondWatchpointPass::isStaticHit(Instruction *instr, unsigned int base) {
+#ifdef ARCH_X86_64
+    auto assembly = instr->getSemantic()->getAssembly();
+    auto op = getStoreOperand(&*assembly);
+    address_t size = op->size;
+
+    DataSection *section = nullptr;
+    address_t address = op->mem.disp;
+    if(base == X86_REG_RIP) {
+        auto link = instr->getSemantic()->getLink();
+        if(auto immAndDisp = dynamic_cast<ImmAndDispLink *>(link)) {
+            link = immAndDisp->getDispLink();
+        }
+        auto dataLink = dynamic_cast<DataOffsetLinkBase *>(link);
+        if(!dataLink) return false;     // not a store into data
+        section = static_cast<DataSection *>(&*dataLink->getTarget());
+        address = dataLink->getTargetAddress();
+    }
+    else {
+        // an absolute address is only meaningful in the main module
+        auto function = static_cast<Function *>(
+            instr->getParent()->getParent());
+        auto module = static_cast<Module *>(
+            function->getParent()->getParent());
+        if(module != watchList.front().section->getParent()
+            ->getParent()->getParent()) return false;
+    }
+
+    for(const auto &watch : watchList) {
+        if(section && section != watch.section) continue;
+        if(address < watch.address + watch.size
+            && watch.address < address + size) return true;
+    }
+#endif
+    return false;
+}
+
+void CondWatchpointPass::addRangeCheck(const StoreGroup &group) {
+#ifdef ARCH_X86_64
+    ChunkAddInline ai({X86_REG_R10, X86_REG_R11, X86_REG_EFLAGS},
+        [this, group] (unsigned int stackBytesAdded) {
+
+        std::vector<Instruction *> list;
+
+        /*
+            4c 8d 9c 88 ff 00 00 00     lea    0xff(%rax,%rcx,4),%r11
+            4c 8d 15 00 00 00 00        lea    range(%rip),%r10
+            49 f7 da                    neg    %r10
+            4d 01 da                    add    %r11,%r10
+            49 81 fa 10 00 00 00        cmp    $0x10,%r10
+            73 05                       jae    1f
+            e8 00 00 00 00              call   condTarget
+        1:  90                          nop
+
+            The address of the last byte the group can write is compared,
+            so that one unsigned comparison finds whether the group's
+            whole span overlaps the range.
+        */
+        int64_t span = group.maxEnd - group.minDisp;
+        int64_t disp = group.maxEnd - 1;
+
+        int baseReg = group.base == X86_REG_INVALID ? -1
+            : X86Register::convertToPhysical(group.base);
+        int indexReg = group.index == X86_REG_INVALID ? -1
+            : X86Register::convertToPhysical(group.index);
+        int scaleBits = group.scale == 8 ? 3 : group.scale == 4 ? 2
+            : group.scale == 2 ? 1 : 0;
+
+        std::vector<unsigned char> lea;
+        lea.push_back(0x4c | (indexReg >= 8 ? 0x2 : 0)
+            | (baseReg >= 8 ? 0x1 : 0));
+        lea.push_back(0x8d);
+        lea.push_back((baseReg < 0 ? 0x00 : 0x80) | (3 << 3) | 4);
+        lea.push_back((scaleBits << 6)
+            | ((indexReg < 0 ? 4 : indexReg & 7) << 3)
+            | (baseReg < 0 ? 5 : baseReg & 7));
+        appendImm32(lea, uint32_t(disp));
+        list.push_back(Disassemble::instruction(lea));
+
+        for(const auto &range : rangeList) {
+            uint64_t bound = range.size + span - 1;
+            if(bound > INT_MAX) bound = INT_MAX;
+
+            list.push_back(makeLinkedInstruction({0x4c, 0x8d, 0x15, 0, 0, 0, 0},
+                new DataOffsetLink(range.section,
+                    range.address - range.section->getAddress(),
+                    Link::SCOPE_INTERNAL_DATA)));
+            list.push_back(Disassemble::instruction({0x49, 0xf7, 0xda}));
+            list.push_back(Disassemble::instruction({0x4d, 0x01, 0xda}));
+            std::vector<unsigned char> cmp{0x49, 0x81, 0xfa};
+            appendImm32(cmp, uint32_t(bound));
+            list.push_back(Disassemble::instruction(cmp));
+
+            auto skip = Disassemble::instruction({0x90});
+
+            auto jae = new Instruction();
+            auto jaeSem = new ControlFlowInstruction(
+                X86_INS_JAE, jae, "\x73", "jae", 1);
+            jaeSem->setLink(new NormalLink(skip, Link::SCOPE_INTERNAL_JUMP));
+            jae->setSemantic(jaeSem);
+            list.push_back(jae);
+
+            auto call = new Instruction();
+            auto callSem = new ControlFlowInstruction(
+                X86_INS_CALL, call, "\xe8", "callq", 4);
+            callSem->setLink(new NormalLink(condTarget, Link::SCOPE_EXTERNAL_JUMP));
+            call->setSemantic(callSem);
+            list.push_back(call);
+
+            list.push_back(skip);
+        }
+        return list;
+    });
+    ai.insertBefore(group.first, true);
+#endif
+}
+
+void CondWatchpointPass::addHitCall(Instruction *instr) {
+#ifdef ARCH_X86_64
+    // the flags are only listed so that the red zone is stepped over
+    ChunkAddInline ai({X86_REG_EFLAGS}, [this] (unsigned int stackBytesAdded) {
+        auto call = new Instruction();
+        auto callSem = new ControlFlowInstruction(
+            X86_INS_CALL, call, "\xe8", "callq", 4);
+        callSem->setLink(new NormalLink(condTarget, Link::SCOPE_EXTERNAL_JUMP));
+        call->setSemantic(callSem);
+        return std::vector<Instruction *>{ call };
+    });
+    ai.insertBefore(instr, true);
+#endif
+}
 
 std::pair<DataSection *, DataSection *> CondWatchpointPass
     ::createDataSection(Module *module) {
@@ -2,17 +2,75 @@
 #define EGALITO_PASS_COND_WATCHPOINT_H
 
 #include <utility>
+#include <vector>
 #include "chunkpass.h"
 #include "chunk/dataregion.h"
 #include "chunk/function.h"
 
+class Instruction;
+
+/** Without watches, counts the calls of every function and calls
+    egalito_cond_watchpoint_hit on the first one.
+
+    With watches (addresses of the main module), calls the hit function
+    before any store into a watched range instead. If there are at most
+    four watches of 1, 2, 4 or 8 aligned bytes, they are armed in the CPU
+    debug registers at startup (through perf_event_open, which delivers
+    SIGTRAP on a write) and no code is instrumented. Otherwise, stores are
+    checked inline: consecutive stores in a block through the same base
+    and index registers share one unsigned range comparison per watched
+    section. Stores that cannot alias a watch are not checked: those
+    relative to %rsp or %fs/%gs, and those whose target is known from
+    their link (as PointerDetection would find on other architectures).
+    Only the first element of a rep-prefixed string store is checked.
+*/
 class CondWatchpointPass : public ChunkPass {
+public:
+    enum WatchMode {
+        WATCH_AUTO,
+        WATCH_DEBUG_REGISTERS,
+        WATCH_RANGE_CHECKS
+    };
+private:
+    struct Watch {
+        address_t address;
+        size_t size;
+        DataSection *section;   // resolved in the main module
+    };
+    struct StoreGroup {
+        Instruction *first;
+        unsigned int base, index;
+        int scale;
+        int64_t minDisp, maxEnd;    // covers [minDisp, maxEnd)
+    };
 private:
     Function *condTarget;
+    std::vector<Watch> watchList;
+    std::vector<Watch> rangeList;   // watches merged per section
+    WatchMode watchMode;
+    size_t checkCount;
 public:
+    CondWatchpointPass() : condTarget(nullptr), watchMode(WATCH_AUTO),
+        checkCount(0) {}
+
+    /** Watch writes to [address, address + size) of the main module. */
+    void addWatch(address_t address, size_t size)
+        { watchList.push_back({address, size, nullptr}); }
+    void setWatchMode(WatchMode mode) { watchMode = mode; }
+
+    virtual void visit(Program *program);
     virtual void visit(Module *module);
     virtual void visit(Function *function);
 private:
+    void countCalls(Function *function);
+    void checkStores(Function *function);
+    bool resolveWatches(Module *module);
+    bool canUseDebugRegisters() const;
+    void armDebugRegisters(Module *module);
+    bool isStaticHit(Instruction *instr, unsigned int base);
+    void addRangeCheck(const StoreGroup &group);
+    void addHitCall(Instruction *instr);
+
     std::pair<DataSection *, DataSection*> createDataSection(Module *module);
     Link *addVariable(DataSection *section, Function *function);
     void appendFunctionName(DataSection *nameSection, const std::string &name);
@@ -12,12 +12,20 @@
 #include "log/log.h"
 #include "log/temp.h"
 
-DebloatPass::DebloatPass(Program *program) : program(program), graph(program) {
+DebloatPass::DebloatPass(Program *program) : program(program), graph(program),
+    removedBytes(0) {
+
     useFromDynamicInitFini();
     useFromEntry();
     useFromIndirectCallee();
-    useFromCodeLinks();
     useFromSpecialName();
+    useFromCodeLinks();  // must be last, it follows the ones found so far
+}
+
+void DebloatPass::visit(Program *program) {
+    recurse(program);
+    removeDeadTrampolines();
+    LOG(1, "debloat removed " << std::dec << removedBytes << " bytes of code");
 }
 
 void DebloatPass::visit(Module *module) {
@@ -44,12 +52,14 @@ void DebloatPass::visit(Module *module) {
         }
     }
 
-    ChunkMutator m(module->getFunctionList());
+    std::vector<Function *> removeList;
     for(auto f : CIter::functions(module)) {
-        auto it = usedList.find(f);
-        if(it == usedList.end()) {
-            m.remove(f);
-        }
+        if(usedList.find(f) == usedList.end()) removeList.push_back(f);
+    }
+    ChunkMutator m(module->getFunctionList());
+    for(auto f : removeList) {
+        removedBytes += f->getSize();
+        m.remove(f);
     }
 }
 
@@ -120,9 +130,18 @@ void DebloatPass::useFromPointerArray(address_t start, size_t size,
 }
 
 void DebloatPass::useFromEntry() {
-    auto entry = dynamic_cast<Function *>(program->getEntryPoint());
-    assert(entry);
-    markTreeAsUsed(entry);
+    if(auto entry = dynamic_cast<Function *>(program->getEntryPoint())) {
+        markTreeAsUsed(entry);
+        return;
+    }
+
+    // a shared library: anything it exports may be called
+    auto main = program->getMain();
+    if(!main) return;
+    LOG(1, "no entry point, keeping all exported functions of the main module");
+    for(auto function : CIter::functions(main)) {
+        if(function->getDynamicSymbol()) markTreeAsUsed(function);
+    }
 }
 
 void DebloatPass::useFromIndirectCallee() {
@@ -133,31 +152,38 @@ void DebloatPass::useFromIndirectCallee() {
 }
 
 void DebloatPass::useFromCodeLinks() {
-    for(auto module : CIter::children(program)) {
-        for(auto function : CIter::functions(module)) {
-            for(auto block : CIter::children(function)) {
-                for(auto instr : CIter::children(block)) {
-                    if(auto link = instr->getSemantic()->getLink()) {
-                        if(auto f = dynamic_cast<Function *>(
-                            &*link->getTarget())) {
-
-                            markTreeAsUsed(f);
-                        }
-                        else if(auto i = dynamic_cast<Instruction *>(
-                            &*link->getTarget())) {
-
-                            auto f = dynamic_cast<Function *>(
-                                i->getParent()->getParent());
-                            assert(f);
-                            markTreeAsUsed(f);
-                        }
-                        else if(auto pl = dynamic_cast<PLTLink *>(link)) {
-                            if(auto f = dynamic_cast<Function *>(
-                                pl->getPLTTrampoline()->getTarget())) {
-
-                                markTreeAsUsed(f);
-                            }
-                        }
+    // only code that is itself used keeps its targets alive; marking a
+    // target pulls in its call tree, which has links of its own
+    std::set<Function *> scanned;
+    for(size_t count = 0; count != usedList.size(); ) {
+        count = usedList.size();
+        std::vector<Function *> list(usedList.begin(), usedList.end());
+        for(auto function : list) {
+            if(scanned.insert(function).second) useFromCodeLinks(function);
+        }
+    }
+}
+
+void DebloatPass::useFromCodeLinks(Function *function) {
+    for(auto block : CIter::children(function)) {
+        for(auto instr : CIter::children(block)) {
+            if(auto link = instr->getSemantic()->getLink()) {
+                if(auto f = dynamic_cast<Function *>(&*link->getTarget())) {
+                    markTreeAsUsed(f);
+                }
+                else if(auto i = dynamic_cast<Instruction *>(
+                    &*link->getTarget())) {
+
+                    auto f = dynamic_cast<Function *>(
+                        i->getParent()->getParent());
+                    assert(f);
+                    markTreeAsUsed(f);
+                }
+                else if(auto pl = dynamic_cast<PLTLink *>(link)) {
+                    if(auto f = dynamic_cast<Function *>(
+                        pl->getPLTTrampoline()->getTarget())) {
+
+                        markTreeAsUsed(f);
                     }
                 }
             }
@@ -179,12 +205,14 @@ void DebloatPass::useFromSpecialName() {
             }
             if(isFeatureEnabled("EGALITO_USE_GS")) {
                 if(function->hasName("egalito_pthread_create")
+                    || function->hasName("egalito_pthread_atfork_child")
                     || function->hasName("egalito_sigaction")
                     || function->hasName("egalito_signal_handler")){
 
                     markTreeAsUsed(function);
                 }
-                else if(function->hasName("egalito_jit_gs_setup_thread")){
+                else if(function->hasName("egalito_jit_gs_setup_thread")
+                    || function->hasName("_ZN20JitGenerationService3runEPv")){
                     markTreeAsUsed(function);
                 }
                 else if(function->hasName("egalito_hook_jit_fixup")
@@ -216,3 +244,54 @@ void DebloatPass::markTreeAsUsed(Function *root) {
         usedList.insert(graph.getFunction(n));
     }
 }
+
+void DebloatPass::removeDeadTrampolines() {
+    std::set<PLTTrampoline *> referenced;
+    auto addReference = [&referenced] (Link *link) {
+        if(!link) return;
+        if(auto pltLink = dynamic_cast<PLTLink *>(link)) {
+            referenced.insert(pltLink->getPLTTrampoline());
+        }
+        else if(auto trampoline = dynamic_cast<PLTTrampoline *>(
+            &*link->getTarget())) {
+
+            referenced.insert(trampoline);
+        }
+    };
+    for(auto module : CIter::children(program)) {
+        for(auto function : CIter::functions(module)) {
+            for(auto block : CIter::children(function)) {
+                for(auto instr : CIter::children(block)) {
+                    addReference(instr->getSemantic()->getLink());
+                }
+            }
+        }
+        for(auto region : CIter::regions(module)) {
+            for(auto section : CIter::children(region)) {
+                for(auto var : CIter::children(section)) {
+                    addReference(var->getDest());
+                }
+            }
+        }
+    }
+
+    size_t count = 0;
+    for(auto module : CIter::children(program)) {
+        auto pltList = module->getPLTList();
+        if(!pltList) continue;
+
+        // unresolved entries are still needed for the global PLT
+        std::vector<PLTTrampoline *> deadList;
+        for(auto plt : CIter::children(pltList)) {
+            if(plt->getTarget() && !referenced.count(plt)) {
+                deadList.push_back(plt);
+            }
+        }
+        for(auto plt : deadList) {
+            removedBytes += plt->getSize();
+            pltList->getChildren()->remove(plt);
+        }
+        count += deadList.size();
+    }
+    LOG(1, "debloat removed " << std::dec << count << " unused PLT entries");
+}
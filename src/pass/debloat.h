@@ -4,22 +4,36 @@
 #include "chunkpass.h"
 #include "analysis/call.h"
 
+/** Removes the functions that can't be reached from the entry point, the
+    init/fini arrays, pointers in data, or a few runtime names, and then
+    the PLT entries that no remaining code or data refers to.
+
+    Data sections are kept: regions are emitted as whole images, so code
+    may still depend on the offsets between sections that nothing links
+    to.
+*/
 class DebloatPass : public ChunkPass {
 private:
     Program *program;
     CallGraph graph;
     std::set<Function *> usedList;
+    size_t removedBytes;
 public:
     DebloatPass(Program *program);
+    virtual void visit(Program *program);
     virtual void visit(Module *module);
+
+    size_t getRemovedBytes() const { return removedBytes; }
 private:
     void useFromDynamicInitFini();
     void useFromPointerArray(address_t start, size_t size, Module *module);
     void useFromEntry();
     void useFromIndirectCallee();
     void useFromCodeLinks();
+    void useFromCodeLinks(Function *function);
     void useFromSpecialName();
     void markTreeAsUsed(Function *root);
+    void removeDeadTrampolines();
 };
 
 #endif
@@ -0,0 +1,222 @@
+#include <algorithm>
+#include "devirtualize.h"
+#include "analysis/analysiscache.h"
+#include "chunk/concrete.h"
+#include "chunk/vtable.h"
+#include "instr/concrete.h"
+#include "instr/register.h"
+#include "instr/template.h"
+#include "operation/mutator.h"
+#include "log/log.h"
+
+void DevirtualizePass::visit(Program *program) {
+    buildSlotMap(program);
+    recurse(program);
+
+    LOG(1, "guarded " << std::dec << guardedCount << " of " << siteCount
+        << " virtual calls with direct calls");
+}
+
+void DevirtualizePass::buildSlotMap(Program *program) {
+    for(auto module : CIter::children(program)) {
+        auto vtableList = module->getVTableList();
+        if(!vtableList) continue;
+
+        for(auto vtable : CIter::children(vtableList)) {
+            if(!vtable->getAddressPoint()) continue;
+
+            for(auto entry : CIter::children(vtable)) {
+                auto &slot = slotMap[entry->getAddress()
+                    - vtable->getAddressPoint()];
+                auto link = entry->getLink();
+                auto target = link
+                    ? dynamic_cast<Function *>(&*link->getTarget()) : nullptr;
+                if(!target || link->getTargetAddress()
+                    != target->getAddress()) {
+
+                    slot.unknown = true;
+                    continue;
+                }
+                if(std::find(slot.targets.begin(), slot.targets.end(),
+                    target) == slot.targets.end()) {
+
+                    slot.targets.push_back(target);
+                }
+            }
+        }
+    }
+
+    for(auto &pair : slotMap) {
+        std::sort(pair.second.targets.begin(), pair.second.targets.end(),
+            [] (Function *a, Function *b) {
+                return a->getAddress() < b->getAddress();
+            });
+    }
+}
+
+void DevirtualizePass::visit(Function *function) {
+    // sites are found before any change makes the analysis stale
+    std::vector<Site> siteList;
+    for(auto block : CIter::children(function)) {
+        for(auto instr : CIter::children(block)) {
+            Site site;
+            if(findSite(function, instr, site)) siteList.push_back(site);
+        }
+    }
+
+    for(const auto &site : siteList) {
+        siteCount ++;
+        if(guard(function, site)) guardedCount ++;
+    }
+}
+
+bool DevirtualizePass::findSite(Function *function, Instruction *instr,
+    Site &site) {
+
+#ifdef ARCH_X86_64
+    auto v = dynamic_cast<IndirectCallInstruction *>(instr->getSemantic());
+    if(!v || !v->hasMemoryOperand()) return false;
+    if(X86Register::convertToPhysical(v->getIndexRegister())
+        != X86Register::INVALID) return false;
+
+    // call *off(%r11) would read the register the guard overwrites
+    auto base = X86Register::convertToPhysical(v->getRegister());
+    if(base == X86Register::INVALID || base == X86Register::R11) return false;
+
+    auto it = slotMap.find(v->getDisplacement());
+    if(it == slotMap.end()) return false;
+    const auto &slot = (*it).second;
+    if(slot.unknown || slot.targets.empty()
+        || slot.targets.size() > maxTargets) return false;
+
+    if(!loadsVTablePointer(function, instr, base)) return false;
+
+    site.call = instr;
+    site.base = base;
+    site.offset = v->getDisplacement();
+    site.slot = &slot;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool DevirtualizePass::loadsVTablePointer(Function *function,
+    Instruction *instr, int reg) {
+
+#ifdef ARCH_X86_64
+    auto analysis = AnalysisCache::getInstance()->get(function);
+    auto state = analysis->getWorkingSet()->getState(instr);
+    if(!state || !analysis->isCurrent()) return false;
+
+    // every reaching definition is mov (%obj),%reg, reading an object's
+    // first word; other calls through a table of pointers are left alone
+    auto &refList = state->getRegRef(reg);
+    if(refList.empty()) return false;
+    for(auto ref : refList) {
+        auto assembly = ref->getInstruction()->getSemantic()->getAssembly();
+        if(!assembly || assembly->getId() != X86_INS_MOV) return false;
+
+        auto operands = assembly->getAsmOperands();
+        if(operands->getOpCount() != 2) return false;
+        auto op = operands->getOperands();
+        if(op[0].type != X86_OP_MEM || op[0].mem.disp != 0
+            || op[0].mem.index != X86_REG_INVALID
+            || op[0].mem.segment != X86_REG_INVALID
+            || op[0].mem.base == X86_REG_RIP) {
+
+            return false;
+        }
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+#ifdef ARCH_X86_64
+static Instruction *makeBranch(unsigned int id, const char *opcode,
+    const char *mnemonic, Chunk *target) {
+
+    auto instr = new Instruction();
+    auto semantic = new ControlFlowInstruction(id, instr, opcode, mnemonic, 4);
+    semantic->setLink(new NormalLink(target, Link::SCOPE_INTERNAL_JUMP));
+    instr->setSemantic(semantic);
+    return instr;
+}
+#endif
+
+bool DevirtualizePass::guard(Function *function, const Site &site) {
+#ifdef ARCH_X86_64
+    using T = InstrTemplate;
+    const int r11 = X86Register::R11;
+    auto &targets = site.slot->targets;
+    auto call = site.call;
+    auto block = static_cast<Block *>(call->getParent());
+
+    // the direct call returns to the start of a block
+    Block *done = nullptr;
+    if(auto next = static_cast<Instruction *>(call->getNextSibling())) {
+        ChunkMutator(function, true).splitBlockBefore(next);
+        done = static_cast<Block *>(next->getParent());
+    }
+    else {
+        done = static_cast<Block *>(block->getNextSibling());
+    }
+    if(!done) return false;
+
+    // one block per further target, then one for the indirect call
+    std::vector<Block *> slowList;
+    for(size_t i = 0; i < targets.size(); i ++) {
+        auto slow = new Block();
+        ChunkMutator(function, true).append(slow);
+        slowList.push_back(slow);
+    }
+
+    auto makeGuard = [&] (Function *target, Block *miss) {
+        return std::vector<Instruction *>{
+            T::makeLinked(T::leaRip(r11),
+                new NormalLink(target, Link::SCOPE_EXTERNAL_JUMP)),
+            T::make(T::cmpMem(r11, site.base, site.offset)),
+            makeBranch(X86_INS_JNE, "\x0f\x85", "jnz", miss),
+            T::makeCall(target)
+        };
+    };
+
+    {
+        // jumps to the call now reach the guard
+        auto guardList = makeGuard(targets[0], slowList[0]);
+        ChunkMutator m(block, true);
+        m.insertBeforeJumpTo(call, guardList[0]);
+        std::swap(call, guardList[0]);
+        m.insertAfter(guardList[0], std::vector<Instruction *>(
+            guardList.begin() + 1, guardList.end()));
+
+        m.remove(call);
+        call->setPreviousSibling(nullptr);
+        call->setNextSibling(nullptr);
+        call->setParent(nullptr);
+        delete call->getPosition();
+        call->setPosition(nullptr);
+    }
+
+    for(size_t i = 1; i < targets.size(); i ++) {
+        ChunkMutator m(slowList[i - 1], true);
+        for(auto instr : makeGuard(targets[i], slowList[i])) m.append(instr);
+        m.append(makeBranch(X86_INS_JMP, "\xe9", "jmp", done));
+    }
+
+    {
+        ChunkMutator m(slowList.back(), true);
+        m.append(call);
+        m.append(makeBranch(X86_INS_JMP, "\xe9", "jmp", done));
+    }
+
+    LOG(10, "guarded virtual call at offset 0x" << std::hex << site.offset
+        << " in [" << function->getName() << "] with " << std::dec
+        << targets.size() << " target(s)");
+    return true;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,53 @@
+#ifndef EGALITO_PASS_DEVIRTUALIZE_H
+#define EGALITO_PASS_DEVIRTUALIZE_H
+
+#include <map>
+#include <vector>
+#include "chunkpass.h"
+
+/** Guarded devirtualization. A virtual call loads the vtable pointer and
+    then calls through a slot: mov (%rdi),%rax; call *off(%rax). Egalito
+    sees the VTables of every Module, so the functions that can sit at a
+    given slot offset are known across the whole program. When there are
+    at most maxTargets of them, the call becomes
+
+        lea target(%rip),%r11; cmp %r11,off(%rax); jne next; call target
+
+    with the remaining targets and the original indirect call in blocks
+    at the end of the function. The compare keeps this correct even for
+    objects whose vtable was not found, e.g. without symbols; those just
+    take the slow path. %r11 and the flags are dead at every call.
+*/
+class DevirtualizePass : public ChunkPass {
+private:
+    struct Slot {
+        std::vector<Function *> targets;
+        bool unknown;   // an entry whose target isn't a known Function
+        Slot() : unknown(false) {}
+    };
+    struct Site {
+        Instruction *call;
+        int base;
+        int64_t offset;
+        const Slot *slot;
+    };
+
+    size_t maxTargets;
+    std::map<int64_t, Slot> slotMap;
+    size_t siteCount;
+    size_t guardedCount;
+public:
+    DevirtualizePass(size_t maxTargets = 2) : maxTargets(maxTargets),
+        siteCount(0), guardedCount(0) {}
+    virtual void visit(Program *program);
+    virtual void visit(Function *function);
+
+    size_t getGuardedCount() const { return guardedCount; }
+private:
+    void buildSlotMap(Program *program);
+    bool findSite(Function *function, Instruction *instr, Site &site);
+    bool loadsVTablePointer(Function *function, Instruction *instr, int reg);
+    bool guard(Function *function, const Site &site);
+};
+
+#endif
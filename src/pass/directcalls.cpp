@@ -0,0 +1,123 @@
+#include "directcalls.h"
+#include "chunk/concrete.h"
+#include "disasm/disassemble.h"
+#include "instr/concrete.h"
+#include "operation/mutator.h"
+#include "log/log.h"
+
+void DirectCallsPass::visit(Program *program) {
+    recurse(program);
+    removeDeadTrampolines(program);
+
+    LOG(1, "DirectCallsPass: " << callCount << " GOT calls made direct, "
+        << dataCount << " pointers to PLT entries retargeted");
+}
+
+void DirectCallsPass::visit(Module *module) {
+    this->module = module;
+    recurse(module->getFunctionList());
+    recurse(module->getDataRegionList());
+}
+
+void DirectCallsPass::visit(Instruction *instruction) {
+#ifdef ARCH_X86_64
+    auto semantic = instruction->getSemantic();
+    auto v = dynamic_cast<DataLinkedControlFlowInstruction *>(semantic);
+    if(!v || !v->getLink()) {
+        addReference(semantic->getLink());
+        return;
+    }
+
+    // only .got entries are known never to change at runtime; any
+    // other memory operand may be a function pointer the program sets
+    auto var = module->getDataRegionList()->findVariable(
+        v->getLink()->getTargetAddress());
+    if(!var || var->getParent()->getName() != ".got") return;
+    auto target = getKnownTarget(var->getDest());
+    if(!target) return;
+
+    LOG(10, "making GOT call at " << instruction->getName()
+        << " direct to [" << target->getName() << "]");
+    InstructionSemantic *newSem;
+    if(v->isCall()) {
+        newSem = new ControlFlowInstruction(
+            X86_INS_CALL, instruction, "\xe8", "callq", 4);
+    }
+    else {
+        newSem = new ControlFlowInstruction(
+            X86_INS_JMP, instruction, "\xe9", "jmp", 4);
+    }
+    newSem->setLink(new NormalLink(target, Link::SCOPE_EXTERNAL_JUMP));
+    instruction->setSemantic(newSem);
+    ChunkMutator(instruction->getParent(), true).modifiedChildSize(
+        instruction, newSem->getSize() - v->getSize());
+    delete v;
+    callCount ++;
+#endif
+}
+
+void DirectCallsPass::visit(DataSection *section) {
+    for(auto var : CIter::children(section)) {
+        auto dest = var->getDest();
+        if(!dest) continue;
+
+        auto trampoline = dynamic_cast<PLTTrampoline *>(&*dest->getTarget());
+        auto target = trampoline ? getKnownTarget(dest) : nullptr;
+        if(!target) {
+            addReference(dest);
+            continue;
+        }
+
+        LOG(10, "retargeting pointer to PLT entry ["
+            << trampoline->getName() << "]");
+        var->setDest(new NormalLink(target, Link::SCOPE_EXTERNAL_JUMP));
+        delete dest;
+        dataCount ++;
+    }
+}
+
+Function *DirectCallsPass::getKnownTarget(Link *link) {
+    if(!link) return nullptr;
+
+    auto target = &*link->getTarget();
+    if(auto trampoline = dynamic_cast<PLTTrampoline *>(target)) {
+        if(trampoline->isIFunc()) return nullptr;
+        target = trampoline->getTarget();
+    }
+    auto function = dynamic_cast<Function *>(target);
+    if(function && function->isIFunc()) return nullptr;
+    return function;
+}
+
+void DirectCallsPass::addReference(Link *link) {
+    if(!link) return;
+    if(auto pltLink = dynamic_cast<PLTLink *>(link)) {
+        referenced.insert(pltLink->getPLTTrampoline());
+    }
+    else if(auto trampoline = dynamic_cast<PLTTrampoline *>(
+        &*link->getTarget())) {
+
+        referenced.insert(trampoline);
+    }
+}
+
+void DirectCallsPass::removeDeadTrampolines(Program *program) {
+    size_t count = 0;
+    for(auto module : CIter::children(program)) {
+        auto pltList = module->getPLTList();
+        if(!pltList) continue;
+
+        // unresolved entries are still needed for the global PLT
+        std::vector<PLTTrampoline *> deadList;
+        for(auto plt : CIter::children(pltList)) {
+            if(plt->getTarget() && !referenced.count(plt)) {
+                deadList.push_back(plt);
+            }
+        }
+        for(auto plt : deadList) {
+            pltList->getChildren()->remove(plt);
+        }
+        count += deadList.size();
+    }
+    LOG(1, "DirectCallsPass: removed " << count << " unused PLT entries");
+}
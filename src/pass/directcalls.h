@@ -0,0 +1,37 @@
+#ifndef EGALITO_PASS_DIRECT_CALLS_H
+#define EGALITO_PASS_DIRECT_CALLS_H
+
+#include <set>
+#include "chunkpass.h"
+
+class PLTTrampoline;
+
+/** For union output, where every module ends up in one executable, so
+    that calls with a known target no longer go through the GOT or PLT.
+
+    call/jmp *foo@GOTPCREL(%rip) becomes a direct rel32 call/jmp when the
+    .got entry points at a known Function. Data that points at a resolved
+    PLT trampoline is pointed at its target instead (code is already
+    handled by CollapsePLTPass, which must run first), and trampolines
+    that nothing refers to any more are not generated. IFuncs are left
+    alone, since their target is only chosen at runtime.
+*/
+class DirectCallsPass : public ChunkPass {
+private:
+    Module *module;
+    size_t callCount;
+    size_t dataCount;
+    std::set<PLTTrampoline *> referenced;
+public:
+    DirectCallsPass() : module(nullptr), callCount(0), dataCount(0) {}
+    virtual void visit(Program *program);
+    virtual void visit(Module *module);
+    virtual void visit(Instruction *instruction);
+    virtual void visit(DataSection *section);
+private:
+    static Function *getKnownTarget(Link *link);
+    void addReference(Link *link);
+    void removeDeadTrampolines(Program *program);
+};
+
+#endif
@@ -0,0 +1,78 @@
+#include "elidegot.h"
+#include "chunk/concrete.h"
+#include "disasm/disassemble.h"
+#include "instr/concrete.h"
+#include "operation/mutator.h"
+#include "log/log.h"
+
+void ElideGOTPass::visit(Program *program) {
+    recurse(program);
+    LOG(1, "ElideGOTPass: " << std::dec << count
+        << " GOT loads turned into lea");
+}
+
+void ElideGOTPass::visit(Module *module) {
+    this->module = module;
+    recurse(module->getFunctionList());
+}
+
+void ElideGOTPass::visit(Instruction *instruction) {
+#ifdef ARCH_X86_64
+    auto linked = dynamic_cast<LinkedInstruction *>(
+        instruction->getSemantic());
+    if(!linked || !linked->getLink()) return;
+
+    // REX.W 8b /r with a RIP-relative operand: mov disp32(%rip), %reg
+    const auto &bytes = linked->getData();
+    if(bytes.size() != 7) return;
+    if((bytes[0] & 0xf8) != 0x48 || (unsigned char)bytes[1] != 0x8b
+        || (bytes[2] & 0xc7) != 0x05) return;
+
+    auto var = module->getDataRegionList()->findVariable(
+        linked->getLink()->getTargetAddress());
+    if(!var || var->getParent()->getName() != ".got") return;
+    auto link = makeDirectLink(var->getDest());
+    if(!link) return;
+
+    LOG(10, "turning GOT load at " << instruction->getName() << " into lea");
+    std::vector<unsigned char> newBytes(bytes.begin(), bytes.end());
+    newBytes[1] = 0x8d;
+    DisasmHandle handle(true);
+    auto semantic = new LinkedInstruction(instruction);
+    semantic->setAssembly(
+        DisassembleInstruction(handle).makeAssemblyPtr(newBytes));
+    semantic->setLink(link);
+    semantic->setIndex(linked->getIndex());
+    instruction->setSemantic(semantic);
+    ChunkMutator(instruction->getParent(), true).modifiedChildSize(
+        instruction, semantic->getSize() - linked->getSize());
+    delete linked;
+    count ++;
+#endif
+}
+
+Link *ElideGOTPass::makeDirectLink(Link *gotDest) {
+    if(!gotDest) return nullptr;
+    if(dynamic_cast<PLTLink *>(gotDest)
+        || dynamic_cast<ExternalSymbolLink *>(gotDest)
+        || dynamic_cast<CopyRelocLink *>(gotDest)
+        || dynamic_cast<TLSDataOffsetLink *>(gotDest)) {
+
+        return nullptr;
+    }
+
+    if(auto dataLink = dynamic_cast<DataOffsetLinkBase *>(gotDest)) {
+        auto section = dynamic_cast<DataSection *>(&*dataLink->getTarget());
+        if(!section) return nullptr;
+        if(dynamic_cast<TLSDataRegion *>(section->getParent())) return nullptr;
+        return new DataOffsetLink(section,
+            dataLink->getTargetAddress() - section->getAddress(),
+            Link::SCOPE_EXTERNAL_DATA);
+    }
+    if(auto normalLink = dynamic_cast<NormalLinkBase *>(gotDest)) {
+        auto function = dynamic_cast<Function *>(&*normalLink->getTarget());
+        if(!function || function->isIFunc()) return nullptr;
+        return new NormalLink(function, Link::SCOPE_EXTERNAL_JUMP);
+    }
+    return nullptr;
+}
@@ -0,0 +1,34 @@
+#ifndef EGALITO_PASS_ELIDE_GOT_H
+#define EGALITO_PASS_ELIDE_GOT_H
+
+#include "chunkpass.h"
+
+class Link;
+
+/** For union output, turns GOT loads of symbols that are now defined in
+    the same executable into direct address computations.
+
+        mov foo@GOTPCREL(%rip), %reg   becomes   lea foo(%rip), %reg
+
+    which has the same length, so no other code moves. Only .got entries
+    that point at a known Function or data object are rewritten; entries
+    for PLT trampolines, IFuncs, TLS, copy relocations and symbols still
+    resolved at runtime keep their load. Copy relocations themselves need
+    no work here: PerfectLinkResolver already points every module at the
+    executable's copy, and HandleCopyRelocs fills it in at generation time.
+    This pass is x86_64-specific; run it after CollapsePLTPass.
+*/
+class ElideGOTPass : public ChunkPass {
+private:
+    Module *module;
+    size_t count;
+public:
+    ElideGOTPass() : module(nullptr), count(0) {}
+    virtual void visit(Program *program);
+    virtual void visit(Module *module);
+    virtual void visit(Instruction *instruction);
+private:
+    static Link *makeDirectLink(Link *gotDest);
+};
+
+#endif
@@ -1,11 +1,14 @@
 #include <vector>
 #include <cassert>
 #include "endbrenforce.h"
+#include "analysis/analysiscache.h"
 #include "disasm/disassemble.h"
 #include "instr/register.h"
 #include "instr/concrete.h"
 #include "operation/mutator.h"
+#include "util/bytescan.h"
 #include "types.h"
+#include "log/log.h"
 
 template <typename SemanticType>
 static Instruction *makeMovR11Instruction(SemanticType *semantic) {
@@ -108,6 +111,10 @@ void EndbrEnforcePass::visit(Module *module) {
 
     this->violationTarget = function;
     recurse(module);
+
+    LOG(1, "endbr checks in " << module->getName() << ": " << std::dec
+        << checkedCount << " added, " << provenCount << " proven unneeded");
+    checkedCount = provenCount = 0;
 #endif
 }
 
@@ -122,19 +129,72 @@ void EndbrEnforcePass::visit(Function *function) {
     if(function->getName() == "__longjmp") return;
     if(function->getName() == "____longjmp_chk") return;
 
-    recurse(function);
+    // decide for every site before adding code, which invalidates the
+    // function's analysis
+    std::vector<Instruction *> pointList;
+    for(auto block : CIter::children(function)) {
+        for(auto instr : CIter::children(block)) {
+            if(!needsEnforcement(instr)) continue;
+
+            if(hasProvenTarget(instr, function)) provenCount ++;
+            else pointList.push_back(instr);
+        }
+    }
+
+    for(auto point : pointList) makeEnforcementCode(point);
+    checkedCount += pointList.size();
 }
 
-void EndbrEnforcePass::visit(Instruction *instruction) {
+bool EndbrEnforcePass::needsEnforcement(Instruction *instruction) {
     auto semantic = instruction->getSemantic();
     if(auto v = dynamic_cast<IndirectJumpInstruction *>(semantic)) {
-        if(!v->isForJumpTable()) {
-            makeEnforcementCode(instruction);
-        }
+        return !v->isForJumpTable();
     }
-    else if(dynamic_cast<IndirectCallInstruction *>(semantic)) {
-        makeEnforcementCode(instruction);
+    return dynamic_cast<IndirectCallInstruction *>(semantic) != nullptr;
+}
+
+bool EndbrEnforcePass::hasProvenTarget(Instruction *instruction,
+    Function *function) {
+
+#ifdef ARCH_X86_64
+    auto v = static_cast<IndirectControlFlowInstructionBase *>(
+        instruction->getSemantic());
+    if(v->hasMemoryOperand()) return false;
+    auto reg = X86Register::convertToPhysical(v->getRegister());
+    if(reg == X86Register::INVALID) return false;
+
+    auto analysis = AnalysisCache::getInstance()->get(function);
+    auto state = analysis->getWorkingSet()->getState(instruction);
+    if(!state || !analysis->isCurrent()) return false;
+
+    // every definition that reaches here must load the same function
+    Function *target = nullptr;
+    auto &refList = state->getRegRef(reg);
+    if(refList.empty()) return false;
+    for(auto ref : refList) {
+        auto linked = dynamic_cast<LinkedInstruction *>(
+            ref->getInstruction()->getSemantic());
+        if(!linked || !linked->getAssembly()
+            || linked->getAssembly()->getId() != X86_INS_LEA) {
+            return false;
+        }
+
+        auto link = linked->getLink();
+        auto f = link ? dynamic_cast<Function *>(&*link->getTarget()) : nullptr;
+        if(!f || link->getTargetAddress() != f->getAddress()) return false;
+        if(target && f != target) return false;
+        target = f;
     }
+
+    if(target->getChildren()->getIterable()->getCount() == 0) return false;
+    auto block = target->getChildren()->getIterable()->get(0);
+    if(block->getChildren()->getIterable()->getCount() == 0) return false;
+    auto first = block->getChildren()->getIterable()->get(0);
+    return BytePattern::getEndbr64().isExactly(
+        first->getSemantic()->getData());
+#else
+    return false;
+#endif
 }
 
 void EndbrEnforcePass::makeEnforcementCode(Instruction *point) {
@@ -175,7 +235,7 @@ void EndbrEnforcePass::makeEnforcementCode(Instruction *point) {
     }
 
     // jmpq *%r11 / callq *%r11
-    static DisasmHandle handle(true);
+    auto &handle = DisasmHandle::forThread();
     AssemblyPtr newAssembly;
     InstructionSemantic *newSem = nullptr;
     if(dynamic_cast<IndirectJumpInstruction *>(semantic)) {
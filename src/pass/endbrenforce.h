@@ -3,15 +3,25 @@
 
 #include "chunkpass.h"
 
+/** Checks that every indirect call and jump lands on an endbr64, for CPUs
+    without CET. Jump table jumps are left alone, since their targets are
+    already bounded. So is an indirect branch whose register can only hold
+    the address of one function that begins with endbr64, e.g. after
+    lea func(%rip), %rax in the same function: the check could never fail.
+*/
 class EndbrEnforcePass : public ChunkPass {
 private:
     Function *violationTarget;
+    size_t checkedCount;
+    size_t provenCount;
 public:
-    EndbrEnforcePass() : violationTarget(nullptr) {}
+    EndbrEnforcePass() : violationTarget(nullptr), checkedCount(0),
+        provenCount(0) {}
     virtual void visit(Module *module);
     virtual void visit(Function *function);
-    virtual void visit(Instruction *instruction);
 private:
+    bool needsEnforcement(Instruction *instruction);
+    bool hasProvenTarget(Instruction *instruction, Function *function);
     void makeEnforcementCode(Instruction *point); 
 };
 
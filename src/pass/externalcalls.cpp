@@ -1,26 +1,74 @@
+#include <algorithm>
 #include "externalcalls.h"
 #include "instr/concrete.h"
+#include "util/threadpool.h"
 
 #undef DEBUG_GROUP
 #define DEBUG_GROUP dplt
 #include "log/log.h"
 
-void ExternalCalls::visit(Instruction *instruction) {
-    auto semantic = instruction->getSemantic();
+void ExternalCalls::visit(Module *module) {
+    std::vector<PLTTrampoline *> sortedList;
+    for(auto plt : CIter::children(pltList)) {
+        sortedList.push_back(plt);
+    }
+    std::stable_sort(sortedList.begin(), sortedList.end(),
+        [] (PLTTrampoline *a, PLTTrampoline *b)
+            { return a->getAddress() < b->getAddress(); });
+
+    std::vector<Function *> functionList;
+    for(auto function : CIter::functions(module)) {
+        functionList.push_back(function);
+    }
+
+    // look up targets; each function only writes its own list
+    std::vector<std::vector<ResolvedType>> resolvedList(functionList.size());
+    ThreadPool pool;
+    pool.parallelFor(functionList.size(), [&] (size_t i) {
+        resolve(functionList[i], sortedList, resolvedList[i]);
+    });
+
+    for(auto &list : resolvedList) {
+        for(auto &resolved : list) {
+            auto instruction = resolved.first;
+            auto pltEntry = resolved.second;
+            auto v = static_cast<ControlFlowInstruction *>(
+                instruction->getSemantic());
+            auto link = v->getLink();
+            auto address = link->getTargetAddress();
+
+            LOG(1, "plt call at 0x" << std::hex << instruction->getAddress()
+                << " to 0x" << address
+                << " i.e. [" << pltEntry->getName() << "]");
+            v->setLink(new PLTLink(address, pltEntry));
+            delete link;
+        }
+    }
+}
+
+void ExternalCalls::resolve(Function *function,
+    const std::vector<PLTTrampoline *> &sortedList,
+    std::vector<ResolvedType> &resolvedList) {
+
+    for(auto block : CIter::children(function)) {
+        for(auto instruction : CIter::children(block)) {
+            // look for instructions with Links
+            auto v = dynamic_cast<ControlFlowInstruction *>(
+                instruction->getSemantic());
+            if(!v) continue;
+
+            auto link = v->getLink();
+            if(!link || link->getTarget()) continue;
 
-    // look for instructions with Links
-    if(auto v = dynamic_cast<ControlFlowInstruction *>(semantic)) {
-        auto link = v->getLink();
-        if(link && !link->getTarget()) {
             auto address = link->getTargetAddress();
-            auto pltEntry = CIter::spatial(pltList)->find(address);
-
-            if(pltEntry) {
-                LOG(1, "plt call at 0x" << std::hex << instruction->getAddress()
-                    << " to 0x" << address
-                    << " i.e. [" << pltEntry->getName() << "]");
-                v->setLink(new PLTLink(address, pltEntry));
-                delete link;
+            auto it = std::upper_bound(sortedList.begin(), sortedList.end(),
+                address, [] (address_t a, PLTTrampoline *plt)
+                    { return a < plt->getAddress(); });
+            if(it == sortedList.begin()) continue;
+
+            auto pltEntry = *(it - 1);
+            if(pltEntry->getAddress() == address) {
+                resolvedList.push_back(std::make_pair(instruction, pltEntry));
             }
         }
     }
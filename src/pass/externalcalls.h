@@ -1,16 +1,26 @@
 #ifndef EGALITO_PASS_EXTERNAL_CALLS_H
 #define EGALITO_PASS_EXTERNAL_CALLS_H
 
+#include <vector>
 #include "chunkpass.h"
 #include "elf/reloc.h"
 #include "chunk/plt.h"
 
+/** Points unresolved ControlFlowInstruction Links at PLT entries. Targets
+    are looked up in parallel against an address-sorted copy of the
+    PLTList, and the PLTLinks are set serially afterwards.
+*/
 class ExternalCalls : public ChunkPass {
 private:
     PLTList *pltList;
 public:
     ExternalCalls(PLTList *pltList) : pltList(pltList) {}
-    virtual void visit(Instruction *instruction);
+    virtual void visit(Module *module);
+private:
+    typedef std::pair<Instruction *, PLTTrampoline *> ResolvedType;
+    void resolve(Function *function,
+        const std::vector<PLTTrampoline *> &sortedList,
+        std::vector<ResolvedType> &resolvedList);
 };
 
 #endif
@@ -1,5 +1,6 @@
 #include "findendbr.h"
 #include "instr/concrete.h"
+#include "util/bytescan.h"
 #include "log/log.h"
 
 void FindEndbrPass::visit(Module *module) {
@@ -20,7 +21,8 @@ void FindEndbrPass::visit(Instruction *instruction) {
     auto semantic = instruction->getSemantic();
     if (auto v = dynamic_cast<IsolatedInstruction *>(semantic)) {
 #ifdef ARCH_X86_64
-        if (v->getAssembly()->getId() == X86_INS_ENDBR64) {
+        // compare bytes rather than building an Assembly for every instruction
+        if (BytePattern::getEndbr64().isExactly(v->getData())) {
             brCount[currentFunction]++;
         }
 #endif
@@ -1,6 +1,7 @@
 #include <assert.h>
 
 #include "findsyscalls.h"
+#include "analysis/analysiscache.h"
 #include "analysis/dataflow.h"
 #include "analysis/slicingtree.h"
 #include "analysis/usedef.h"
@@ -8,6 +9,7 @@
 #include "analysis/walker.h"
 #include "chunk/dump.h"
 #include "conductor/conductor.h"
+#include "util/bytescan.h"
 #include "log/log.h"
 
 void FindSyscalls::visit(Function *function) {
@@ -18,20 +20,18 @@ void FindSyscalls::visit(Function *function) {
     // equivalent to a syscall() instruction.
     if (isSyscallFunction(function)) return;
 
-    auto graph = new ControlFlowGraph(function);
-    auto config = new UDConfiguration(graph);
-    auto working = new UDRegMemWorkingSet(function, graph);
-    auto usedef = new UseDef(config, working);
+    // don't run use-def analysis on functions that can't contain a syscall
+    if (!hasSyscallInstruction(function)) return;
 
-    SccOrder order(graph);
-    order.genFull(0);
-    usedef->analyze(order.get());
+    auto analysis = AnalysisCache::getInstance()->get(function);
+    auto working = analysis->getWorkingSet();
 
     for (auto block : CIter::children(function)) {
         for (auto instr : CIter::children(block)) {
-            auto assembly = instr->getSemantic()->getAssembly();
             auto state = working->getState(instr);
-            if (assembly && assembly->getId() == X86_INS_SYSCALL) {
+            if (BytePattern::getSyscall().isExactly(
+                instr->getSemantic()->getData())) {
+
                 std::set<unsigned long> values;
                 seen.clear();
                 auto rax = X86Register::convertToPhysical(X86_REG_RAX);
@@ -41,6 +41,7 @@ void FindSyscalls::visit(Function *function) {
                 else {
                     LOG(1, "WARNING: Unable to determine syscall number for " 
                         << instr->getName() << " inside [" << function->getName() << "]");
+                    unknownSet.insert(instr);
                 }
             }
             else if (auto cfi = dynamic_cast<ControlFlowInstruction *>(
@@ -70,6 +71,7 @@ void FindSyscalls::visit(Function *function) {
                     else {
                         LOG(1, "WARNING: Unable to determine syscall number for " 
                             << instr->getName() << " inside [" << function->getName() << "]");
+                        unknownSet.insert(instr);
                     }
                 }
             }
@@ -96,6 +98,19 @@ void FindSyscalls::visit(Function *function) {
 #endif
 }
 
+bool FindSyscalls::hasSyscallInstruction(Function *function) {
+    for (auto block : CIter::children(function)) {
+        for (auto instr : CIter::children(block)) {
+            if (BytePattern::getSyscall().isExactly(
+                instr->getSemantic()->getData())) {
+
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
 bool FindSyscalls::isSyscallFunction(Function *function) {
     if (function->getName() == "syscall") {
         auto module = static_cast<Module *>(function->getParent()->getParent());
@@ -13,13 +13,18 @@ class UDState;
 class FindSyscalls : public ChunkPass {
 private:
     std::map<Instruction *, std::set<unsigned long>> numberMap;
+    std::set<Instruction *> unknownSet;
     std::set<UDState *> seen;
 public: 
     virtual void visit(Function *function);
 
     const std::map<Instruction *, std::set<unsigned long>> &getNumberMap() const
         { return numberMap; }
+    /** Sites whose system call number could not be determined. */
+    const std::set<Instruction *> &getUnknownSet() const
+        { return unknownSet; }
 private:
+    bool hasSyscallInstruction(Function *function);
     bool isSyscallFunction(Function *function);
     bool getRegisterValue(UDState *state, int curreg, std::set<unsigned long> &valueSet);
 };
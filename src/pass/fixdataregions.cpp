@@ -1,13 +1,32 @@
 #include <typeinfo>
+#include <algorithm>
 #include <cassert>
 #include "fixdataregions.h"
+#include "chunk/position.h"
 #include "elf/symbol.h"
+#include "util/threadpool.h"
 #include "log/log.h"
 #include "log/temp.h"
 
 void FixDataRegionsPass::visit(Program *program) {
     this->program = program;
-    recurse(program);
+
+    // Each DataRegion is patched independently, so regions are spread
+    // across threads. Freezing makes address lookups read-only.
+    std::vector<DataRegion *> regionList;
+    for(auto module : CIter::modules(program)) {
+        LOG(10, "Fixing variables in regions for " << module->getName());
+        for(auto region : CIter::regions(module)) {
+            regionList.push_back(region);
+        }
+    }
+
+    PositionManager::freeze(program);
+    ThreadPool pool;
+    pool.parallelFor(regionList.size(), [&] (size_t i) {
+        visit(regionList[i]);
+    });
+    PositionManager::thaw();
 }
 
 void FixDataRegionsPass::visit(Module *module) {
@@ -26,7 +45,11 @@ void FixDataRegionsPass::visit(DataRegion *dataRegion) {
     if(!dataRegion) return;
 #endif
 
+    DataFixupList fixupList;
     for(auto dsec : CIter::children(dataRegion)) {
+        fixupList.clear();
+        fixupList.reserve(dsec->getChildren()->getIterable()->getCount());
+
         for(auto var : CIter::children(dsec)) {
             if(!var->getDest()) continue;
             if(var->getIsCopy()) continue;
@@ -35,20 +58,11 @@ void FixDataRegionsPass::visit(DataRegion *dataRegion) {
             auto target = var->getDest()->getTargetAddress();
             address_t address = var->getAddress();
             LOG(8, "set variable " << std::hex << address << " => " << target << " (size " << var->getSize() << ")");
-            if(var->getSize() == sizeof(address_t)) {
-                *reinterpret_cast<address_t *>(address) = target;
-            }
-            else if(var->getSize() == 4) {
-                *reinterpret_cast<uint32_t *>(address) = target;
-            }
-            else if(var->getSize() == 2) {
-                *reinterpret_cast<uint16_t *>(address) = target;
-            }
-            else {
-                assert(var->getSize() == 1);
-                *reinterpret_cast<uint8_t *>(address) = target;
-            }
+            fixupList.add(address, target, var->getSize());
         }
+
+        fixupList.sort();
+        fixupList.apply();
     }
 }
 
@@ -62,3 +76,51 @@ bool FixDataRegionsPass::isForIFuncJumpSlot(DataVariable *var) {
 
     return false;
 }
+
+void DataFixupList::add(address_t address, address_t value, size_t size) {
+    if(size == sizeof(address_t)) {
+        wordList.push_back({address, value});
+    }
+    else {
+        assert(size == 4 || size == 2 || size == 1);
+        smallList.push_back({address, value, size});
+    }
+}
+
+void DataFixupList::sort() {
+    std::stable_sort(wordList.begin(), wordList.end(),
+        [] (const WordFixup &a, const WordFixup &b)
+            { return a.address < b.address; });
+    std::stable_sort(smallList.begin(), smallList.end(),
+        [] (const SmallFixup &a, const SmallFixup &b)
+            { return a.address < b.address; });
+}
+
+void DataFixupList::apply() const {
+    // how many entries ahead to prefetch the destination
+    const size_t distance = 8;
+
+    const WordFixup *fixup = wordList.data();
+    const size_t count = wordList.size();
+    for(size_t i = 0; i < count; i ++) {
+        if(i + distance < count) {
+            __builtin_prefetch(
+                reinterpret_cast<void *>(fixup[i + distance].address), 1);
+        }
+        *reinterpret_cast<address_t *>(fixup[i].address) = fixup[i].value;
+    }
+
+    for(const auto &small : smallList) {
+        switch(small.size) {
+        case 4:
+            *reinterpret_cast<uint32_t *>(small.address) = small.value;
+            break;
+        case 2:
+            *reinterpret_cast<uint16_t *>(small.address) = small.value;
+            break;
+        default:
+            *reinterpret_cast<uint8_t *>(small.address) = small.value;
+            break;
+        }
+    }
+}
@@ -1,10 +1,43 @@
 #ifndef EGALITO_PASS_FIX_DATA_REGIONS_H
 #define EGALITO_PASS_FIX_DATA_REGIONS_H
 
+#include <vector>
 #include "chunkpass.h"
+#include "types.h"
 
 class DataVariable;
 
+/** Pointer fix-ups for one DataSection, packed and sorted by address so
+    they are applied in one forward sweep over the section's memory.
+
+    Pointer-sized fix-ups (nearly all of them) are kept apart from the
+    rare 1, 2 and 4-byte ones, so the main loop is a branch-free run of
+    8-byte stores with the next entries prefetched.
+*/
+class DataFixupList {
+public:
+    struct WordFixup {
+        address_t address;
+        address_t value;
+    };
+    struct SmallFixup {
+        address_t address;
+        address_t value;
+        size_t size;
+    };
+private:
+    std::vector<WordFixup> wordList;
+    std::vector<SmallFixup> smallList;
+public:
+    void reserve(size_t count) { wordList.reserve(count); }
+    void add(address_t address, address_t value, size_t size);
+    void sort();
+    void apply() const;
+
+    size_t getCount() const { return wordList.size() + smallList.size(); }
+    void clear() { wordList.clear(); smallList.clear(); }
+};
+
 class FixDataRegionsPass : public ChunkPass {
 private:
     Program *program;
@@ -57,7 +57,7 @@ void FixEnvironPass::visit(Program *program) {
 
 */
     auto leaInstr = Disassemble::instruction({0x4c, 0x8d, 0x44, 0xf2, 0x08});
-    static DisasmHandle handle(true);
+    auto &handle = DisasmHandle::forThread();
     auto movAssembly = DisassembleInstruction(handle).makeAssemblyPtr(
         std::vector<unsigned char>({0x4c, 0x89, 0x05, 0x00, 0x00, 0x00, 0x00}));
 
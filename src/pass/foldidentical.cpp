@@ -0,0 +1,326 @@
+#include <typeinfo>
+#include <algorithm>
+#include "foldidentical.h"
+#include "chunk/concrete.h"
+#include "chunk/linkindex.h"
+#include "elf/symbol.h"
+#include "instr/concrete.h"
+#include "operation/mutator.h"
+#include "util/threadpool.h"
+#include "log/log.h"
+
+void FoldIdenticalPass::visit(Program *program) {
+    while(foldRound(program) > 0) {}
+
+    LOG(1, "folded " << std::dec << foldedCount << " identical functions, "
+        << foldedBytes << " bytes of code");
+}
+
+size_t FoldIdenticalPass::foldRound(Program *program) {
+    std::set<Function *> pinned;
+    findPinned(program, pinned);
+
+    std::vector<std::pair<Module *, std::vector<Function *>>> removeList;
+    for(auto module : CIter::children(program)) {
+        std::vector<Function *> functionList;
+        for(auto function : CIter::functions(module)) {
+            if(pinned.find(function) != pinned.end()) continue;
+            functionList.push_back(function);
+        }
+
+        // keys only read the function they describe
+        std::vector<std::string> keyList(functionList.size());
+        ThreadPool pool;
+        pool.parallelFor(functionList.size(), [&] (size_t i) {
+            keyList[i] = makeKey(functionList[i]);
+        });
+
+        // the first function with a given key is the one kept
+        std::unordered_map<std::string, Function *> keptMap;
+        std::vector<Function *> folded;
+        for(size_t i = 0; i < functionList.size(); i ++) {
+            if(keyList[i].empty()) continue;
+
+            auto it = keptMap.insert(std::make_pair(
+                std::move(keyList[i]), functionList[i]));
+            if(it.second) continue;
+
+            auto kept = (*it.first).second;
+            LOG(10, "folding [" << functionList[i]->getName()
+                << "] into [" << kept->getName() << "]");
+            mapChildren(functionList[i], kept);
+            folded.push_back(functionList[i]);
+        }
+        if(!folded.empty()) removeList.emplace_back(module, std::move(folded));
+    }
+    if(replacement.empty()) return 0;
+
+    redirect(program);
+
+    size_t count = 0;
+    for(auto &pair : removeList) {
+        ChunkMutator m(pair.first->getFunctionList());
+        for(auto function : pair.second) {
+            foldedBytes += function->getSize();
+            m.remove(function);
+        }
+        count += pair.second.size();
+    }
+    foldedCount += count;
+    replacement.clear();
+    return count;
+}
+
+void FoldIdenticalPass::findPinned(Program *program,
+    std::set<Function *> &pinned) {
+
+    auto pinTarget = [&pinned] (Link *link) {
+        if(!link || dynamic_cast<NormalLinkBase *>(link)) return;
+        if(auto function = functionOf(link->getTarget())) {
+            pinned.insert(function);
+        }
+    };
+
+    if(auto function = functionOf(program->getEntryPoint())) {
+        pinned.insert(function);
+    }
+
+    for(auto module : CIter::children(program)) {
+        for(auto function : CIter::functions(module)) {
+            // resolvers are looked up by name
+            if(function->isIFunc()) pinned.insert(function);
+
+            for(auto block : CIter::children(function)) {
+                for(auto instr : CIter::children(block)) {
+                    pinTarget(instr->getSemantic()->getLink());
+                }
+            }
+        }
+
+        for(auto list : {module->getInitFunctionList(),
+            module->getFiniFunctionList()}) {
+
+            if(!list) continue;
+            for(auto init : CIter::children(list)) {
+                if(init->getFunction()) pinned.insert(init->getFunction());
+            }
+        }
+
+        for(auto region : CIter::regions(module)) {
+            for(auto section : CIter::children(region)) {
+                for(auto var : CIter::children(section)) {
+                    pinTarget(var->getDest());
+                }
+            }
+        }
+
+        if(auto vtableList = module->getVTableList()) {
+            for(auto vtable : CIter::children(vtableList)) {
+                for(auto entry : CIter::children(vtable)) {
+                    pinTarget(entry->getLink());
+                }
+            }
+        }
+    }
+}
+
+std::string FoldIdenticalPass::makeKey(Function *function) {
+    // An empty key means the function can't be folded. Every part of the
+    // key has a fixed size or a length prefix, so keys can't run together.
+    if(function->getSize() == 0 || !endsWithoutFallthrough(function)) {
+        return "";
+    }
+
+    std::string key;
+    auto appendValue = [&key] (address_t value) {
+        key.append(reinterpret_cast<const char *>(&value), sizeof(value));
+    };
+    auto appendData = [&key, &appendValue] (const std::string &data) {
+        appendValue(data.length());
+        key.append(data);
+    };
+
+    // only fold within one module, so output never needs new cross-module
+    // references
+    appendValue(reinterpret_cast<address_t>(function->getParent()));
+
+    for(auto block : CIter::children(function)) {
+        appendValue(block->getChildren()->getIterable()->getCount());
+
+        for(auto instr : CIter::children(block)) {
+            auto semantic = instr->getSemantic();
+            auto link = semantic->getLink();
+            if(!link) {
+                try {
+                    appendData(semantic->getData());
+                }
+                catch(const char *) {
+                    return "";
+                }
+                continue;
+            }
+
+#ifdef ARCH_X86_64
+            if(auto cfi = dynamic_cast<ControlFlowInstruction *>(semantic)) {
+                appendData(cfi->getOpcode());
+                appendValue(cfi->getDisplacementSize());
+            }
+            else if(auto linked
+                = dynamic_cast<LinkedInstructionBase *>(semantic)) {
+
+                // the displacement depends on where the function is
+                auto data = linked->getData();
+                auto offset = linked->getDispOffset();
+                auto size = linked->getDispSize();
+                if(offset + size > data.length()) return "";
+                std::fill_n(data.begin() + offset, size, '\0');
+                appendData(data);
+            }
+            else return "";
+#else
+            return "";
+#endif
+
+            appendValue(typeid(*link).hash_code());
+            auto target = link->getTarget();
+            if(target && functionOf(target) == function) {
+                // same position in the other copy
+                appendValue(0);
+                appendValue(link->getTargetAddress() - function->getAddress());
+            }
+            else if(target) {
+                appendValue(1);
+                appendValue(reinterpret_cast<address_t>(&*target));
+                appendValue(link->getTargetAddress() - target->getAddress());
+            }
+            else {
+                appendValue(2);
+                appendValue(link->getTargetAddress());
+            }
+        }
+    }
+
+    return key;
+}
+
+void FoldIdenticalPass::mapChildren(Function *folded, Function *kept) {
+    // equal keys imply the same block and instruction counts
+    replacement[folded] = kept;
+
+    size_t b = 0;
+    for(auto block : CIter::children(folded)) {
+        auto keptBlock = kept->getChildren()->getIterable()->get(b ++);
+        replacement[block] = keptBlock;
+
+        size_t i = 0;
+        for(auto instr : CIter::children(block)) {
+            replacement[instr] = keptBlock->getChildren()->getIterable()->get(i ++);
+        }
+    }
+
+    if(auto keptSymbol = kept->getSymbol()) {
+        if(auto symbol = folded->getSymbol()) {
+            keptSymbol->addAlias(symbol);
+            for(auto alias : symbol->getAliases()) {
+                keptSymbol->addAlias(alias);
+            }
+        }
+    }
+}
+
+void FoldIdenticalPass::redirect(Program *program) {
+    auto update = [this] (const LinkReference &ref) {
+        auto oldLink = ref.getLink();
+        if(auto newLink = redirectLink(oldLink)) {
+            ref.setLink(newLink);
+            delete oldLink;
+        }
+    };
+
+    auto index = LinkIndex::getInstance();
+    if(index) {
+        for(auto pair : replacement) {
+            for(auto ref : index->getReferences(pair.first)) update(ref);
+        }
+    }
+
+    for(auto module : CIter::children(program)) {
+        if(!index) {
+            for(auto function : CIter::functions(module)) {
+                // folded functions are about to be removed
+                if(replacement.find(function) != replacement.end()) continue;
+
+                for(auto block : CIter::children(function)) {
+                    for(auto instr : CIter::children(block)) {
+                        update(LinkReference(instr->getSemantic()));
+                    }
+                }
+            }
+
+            for(auto region : CIter::regions(module)) {
+                for(auto section : CIter::children(region)) {
+                    for(auto var : CIter::children(section)) {
+                        update(LinkReference(var));
+                    }
+                }
+            }
+        }
+
+        // these are not tracked by the LinkIndex
+        if(auto vtableList = module->getVTableList()) {
+            for(auto vtable : CIter::children(vtableList)) {
+                for(auto entry : CIter::children(vtable)) {
+                    auto oldLink = entry->getLink();
+                    if(auto newLink = redirectLink(oldLink)) {
+                        entry->setLink(newLink);
+                        delete oldLink;
+                    }
+                }
+            }
+        }
+
+        if(auto externalList = module->getExternalSymbolList()) {
+            for(auto external : CIter::children(externalList)) {
+                auto it = replacement.find(external->getResolved());
+                if(it != replacement.end()) external->setResolved((*it).second);
+            }
+        }
+    }
+}
+
+Link *FoldIdenticalPass::redirectLink(Link *link) {
+    if(!dynamic_cast<NormalLinkBase *>(link)) return nullptr;
+
+    auto it = replacement.find(link->getTarget());
+    if(it == replacement.end()) return nullptr;
+
+    if(link->isAbsolute()) {
+        return new AbsoluteNormalLink((*it).second, link->getScope());
+    }
+    return new NormalLink((*it).second, link->getScope());
+}
+
+Function *FoldIdenticalPass::functionOf(Chunk *chunk) {
+    while(chunk && !dynamic_cast<Function *>(chunk)) {
+        chunk = chunk->getParent();
+    }
+    return static_cast<Function *>(chunk);
+}
+
+bool FoldIdenticalPass::endsWithoutFallthrough(Function *function) {
+    // a copy that falls through would continue into a different function
+    auto block = function->getChildren()->getIterable()->getLast();
+    if(!block) return false;
+    auto instr = block->getChildren()->getIterable()->getLast();
+    if(!instr) return false;
+
+    auto semantic = instr->getSemantic();
+    if(dynamic_cast<ReturnInstruction *>(semantic)) return true;
+    if(dynamic_cast<IndirectJumpInstruction *>(semantic)) return true;
+#ifdef ARCH_X86_64
+    if(auto cfi = dynamic_cast<ControlFlowInstruction *>(semantic)) {
+        return cfi->getMnemonic() == "jmp";
+    }
+#endif
+    return false;
+}
@@ -0,0 +1,45 @@
+#ifndef EGALITO_PASS_FOLD_IDENTICAL_H
+#define EGALITO_PASS_FOLD_IDENTICAL_H
+
+#include <set>
+#include <string>
+#include <unordered_map>
+#include "chunkpass.h"
+
+class Link;
+
+/** Identical code folding. Functions in the same Module whose instructions
+    are the same, comparing Links by their targets rather than by encoded
+    displacements, are merged into one copy. Links, DataVariables, VTable
+    entries and resolved ExternalSymbols that referred to a folded function
+    are redirected to the kept copy, and the folded function's symbols
+    become aliases of the kept one.
+
+    This runs until nothing changes, since callers of folded functions may
+    become identical themselves. Only NormalLinks (relative or absolute)
+    can be redirected, so a function that any other kind of Link points
+    into is kept, as are the entry point, init/fini functions and IFuncs.
+*/
+class FoldIdenticalPass : public ChunkPass {
+private:
+    std::unordered_map<Chunk *, Chunk *> replacement;
+    size_t foldedCount;
+    size_t foldedBytes;
+public:
+    FoldIdenticalPass() : foldedCount(0), foldedBytes(0) {}
+    virtual void visit(Program *program);
+
+    size_t getFoldedCount() const { return foldedCount; }
+    size_t getFoldedBytes() const { return foldedBytes; }
+private:
+    size_t foldRound(Program *program);
+    void findPinned(Program *program, std::set<Function *> &pinned);
+    std::string makeKey(Function *function);
+    void mapChildren(Function *folded, Function *kept);
+    void redirect(Program *program);
+    Link *redirectLink(Link *link);
+    static Function *functionOf(Chunk *chunk);
+    static bool endsWithoutFallthrough(Function *function);
+};
+
+#endif
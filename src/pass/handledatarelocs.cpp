@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <typeinfo>
 #include <cstring>
 #include <cassert>
@@ -79,11 +80,24 @@ void HandleDataRelocsPass::resolveSpecificRelocSection(
 void HandleDataRelocsPass::resolveGeneralRelocSection(
     RelocSection *relocSection, Module *module) {
 
+    // visit relocations in address order, so that the containing section
+    // only has to be looked up when we move past the end of the last one
+    std::vector<Reloc *> sortedList(relocSection->begin(), relocSection->end());
+    std::stable_sort(sortedList.begin(), sortedList.end(),
+        [](Reloc *a, Reloc *b) { return a->getAddress() < b->getAddress(); });
+
     auto list = module->getDataRegionList();
-    for(auto reloc : *relocSection) {
+    auto tls = list->getTLS();
+    DataSection *section = nullptr;
+    for(auto reloc : sortedList) {
         auto addr = reloc->getAddress() + module->getBaseAddress();
-        auto region = list->findRegionContaining(addr);
-        auto section = region->findDataSectionContaining(addr);
+        // the TLS region overlaps other regions and takes priority
+        if(!section || !section->contains(addr)
+            || (tls && section->getParent() != tls && tls->containsData(addr))) {
+
+            auto region = list->findRegionContaining(addr);
+            section = region->findDataSectionContaining(addr);
+        }
         DataVariable *var = nullptr;
         if(auto oldVar = section->findVariable(addr)) {
             if(oldVar->getDest()) continue;
@@ -96,7 +110,7 @@ void HandleDataRelocsPass::resolveGeneralRelocSection(
         // if DataVariable already exists (null link), update its link.
         // else create a new DataVariable, even if its link is initially null.
         if(!var) {
-            var = DataVariable::create(module, addr, link, reloc->getSymbol());
+            var = DataVariable::create(section, addr, link, reloc->getSymbol());
         }
         finalizeDataVariable(reloc, var, module);
     }
@@ -7,6 +7,7 @@
 #include "operation/find.h"
 #include "instr/concrete.h"
 #include "disasm/makesemantic.h"
+#include "util/threadpool.h"
 
 #include "log/log.h"
 #include "log/temp.h"
@@ -14,31 +15,44 @@
 void HandleRelocsPass::visit(Module *module) {
     this->module = module;
     auto functionList = module->getFunctionList();
-    for(auto r : *relocList) {
-        Chunk *inner = ChunkFind().findInnermostInsideInstruction(
-            functionList, r->getAddress());
-        auto instruction = dynamic_cast<Instruction *>(inner);
-        if(!instruction) continue;
-        if(instruction->getSemantic()->getLink()) continue;
-
-        // looks like very old code
-#if 0//def ARCH_X86_64
-        if(!r->getSymbol()) continue;
-
-        Function *target = CIter::findChild(functionList,
-            r->getSymbol()->getName());
+    auto &sortedList = relocList->getSortedList();
+
+    // Relocations are sorted by address, so consecutive ones usually fall
+    // in the same function; only look up the function when we leave it.
+    struct Span {
+        Function *function;
+        size_t begin, end;
+    };
+    std::vector<Span> spanList;
+    Function *function = nullptr;
+    for(size_t i = 0; i < sortedList.size(); i++) {
+        auto address = sortedList[i]->getAddress();
+        if(!function || !function->getRange().contains(address)) {
+            function = static_cast<Function *>(functionList->getChildren()
+                ->getSpatial()->findContaining(address));
+            if(!function) continue;
+            spanList.push_back(Span{function, i, i});
+        }
+        spanList.back().end = i + 1;
+    }
 
-        if(!target) {
-            if(module->getElfSpace()->getElfMap()->isObjectFile()) {
-                handleRelocation(r, instruction, r->getSymbol());
-            }
-            continue;
+    // finding the instructions only reads the chunk tree, and each function
+    // is searched by one thread
+    std::vector<Instruction *> instructionList(sortedList.size());
+    ThreadPool().parallelFor(spanList.size(), [&] (size_t s) {
+        const auto &span = spanList[s];
+        for(size_t i = span.begin; i < span.end; i++) {
+            Chunk *inner = ChunkFind().findInnermostInsideInstruction(
+                span.function, sortedList[i]->getAddress());
+            instructionList[i] = dynamic_cast<Instruction *>(inner);
         }
+    });
 
-        // we know r is inside this module, but we don't know where yet
-        LOG(10, "reloc inside " << instruction->getName() << " at "
-            << r->getAddress() << " targets [" << target->getName() << "]");
-#endif
+    for(size_t i = 0; i < sortedList.size(); i++) {
+        auto r = sortedList[i];
+        auto instruction = instructionList[i];
+        if(!instruction) continue;
+        if(instruction->getSemantic()->getLink()) continue;
 
         handleRelocation(r, instruction);
     }
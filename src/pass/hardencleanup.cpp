@@ -0,0 +1,275 @@
+#include <climits>
+#include <capstone/x86.h>
+#include "hardencleanup.h"
+#include "analysis/liveregister.h"
+#include "chunk/link.h"
+#include "instr/concrete.h"
+#include "instr/register.h"
+#include "instr/template.h"
+#include "operation/mutator.h"
+#include "log/log.h"
+
+#ifdef ARCH_X86_64
+/** The register of push %reg (or pop), X86Register::FLAGS for pushfq (or
+    popfq), or X86Register::INVALID, in the encodings of InstrTemplate. */
+static int getPushRegister(Instruction *instruction, bool pop) {
+    auto semantic = instruction->getSemantic();
+    if(!dynamic_cast<IsolatedInstruction *>(semantic)) {
+        return X86Register::INVALID;
+    }
+    const auto &data = semantic->getData();
+    const unsigned char base = pop ? 0x58 : 0x50;
+    unsigned char opcode = data.back();
+    int reg = X86Register::INVALID;
+    if(data.length() == 1) {
+        if(opcode == (pop ? 0x9d : 0x9c)) return X86Register::FLAGS;
+        if(opcode >= base && opcode < base + 8) reg = opcode - base;
+    }
+    else if(data.length() == 2 && static_cast<unsigned char>(data[0]) == 0x41
+        && opcode >= base && opcode < base + 8) {
+
+        reg = 8 + opcode - base;
+    }
+    return reg == X86Register::SP ? X86Register::INVALID : reg;
+}
+
+/** Recognizes lea offset(%rsp), %rsp, as InstrTemplate::leaStack() makes. */
+static bool getStackAdjustment(Instruction *instruction, int32_t &offset) {
+    auto semantic = instruction->getSemantic();
+    if(!dynamic_cast<IsolatedInstruction *>(semantic)) return false;
+    const auto &data = semantic->getData();
+    if(data.compare(0, 4, "\x48\x8d\x64\x24") == 0 && data.length() == 5) {
+        offset = static_cast<int8_t>(data[4]);
+        return true;
+    }
+    if(data.compare(0, 4, "\x48\x8d\xa4\x24") == 0 && data.length() == 8) {
+        uint32_t value = 0;
+        for(int i = 3; i >= 0; i --) {
+            value = (value << 8) | static_cast<unsigned char>(data[4 + i]);
+        }
+        offset = static_cast<int32_t>(value);
+        return true;
+    }
+    return false;
+}
+
+/** mov %reg, %reg with REX.W, e.g. from EndbrEnforcePass on call *%r11. */
+static bool isSelfMove(Instruction *instruction) {
+    auto semantic = instruction->getSemantic();
+    if(!dynamic_cast<IsolatedInstruction *>(semantic)) return false;
+    const auto &data = semantic->getData();
+    if(data.length() != 3) return false;
+
+    unsigned char rex = data[0], opcode = data[1], modrm = data[2];
+    if((rex & 0xfa) != 0x48 || (opcode != 0x89 && opcode != 0x8b)) {
+        return false;
+    }
+    if((modrm >> 6) != 3) return false;
+    int reg = ((modrm >> 3) & 7) | ((rex & 0x4) ? 8 : 0);
+    int rm = (modrm & 7) | ((rex & 0x1) ? 8 : 0);
+    return reg == rm;
+}
+
+static ControlFlowInstruction *getConditionalJump(Instruction *instruction) {
+    auto cfi = dynamic_cast<ControlFlowInstruction *>(
+        instruction->getSemantic());
+    if(!cfi || !cfi->getLink()) return nullptr;
+    if(cfi->getId() == X86_INS_JMP || cfi->getId() == X86_INS_CALL) {
+        return nullptr;
+    }
+    return cfi;
+}
+
+static bool isCompare(Instruction *instruction) {
+    auto semantic = instruction->getSemantic();
+    if(!dynamic_cast<IsolatedInstruction *>(semantic)) return false;
+    auto assembly = semantic->getAssembly();
+    return assembly && (assembly->getId() == X86_INS_CMP
+        || assembly->getId() == X86_INS_TEST);
+}
+
+/** The registers a compare reads, including its address registers. */
+static std::bitset<32> getReadRegisters(Instruction *instruction) {
+    std::bitset<32> regs;
+    auto assembly = instruction->getSemantic()->getAssembly();
+    auto add = [&regs] (int capstoneReg) {
+        auto reg = RegisterLiveness::getRegisterID(capstoneReg);
+        if(reg != X86Register::INVALID) regs.set(reg);
+    };
+    auto operands = assembly->getAsmOperands();
+    auto op = operands->getOperands();
+    for(size_t i = 0; i < operands->getOpCount(); i ++) {
+        if(op[i].type == X86_OP_REG) add(op[i].reg);
+        else if(op[i].type == X86_OP_MEM) {
+            add(op[i].mem.base);
+            add(op[i].mem.index);
+        }
+    }
+    for(size_t i = 0; i < assembly->getImplicitRegsReadCount(); i ++) {
+        add(assembly->getImplicitRegsRead()[i]);
+    }
+    return regs;
+}
+
+/** A mov or lea into a register, which leaves memory and flags alone;
+    returns the register, or X86Register::INVALID. */
+static int getMoveDestination(Instruction *instruction) {
+    auto semantic = instruction->getSemantic();
+    if(!dynamic_cast<IsolatedInstruction *>(semantic)) {
+        return X86Register::INVALID;
+    }
+    auto assembly = semantic->getAssembly();
+    if(!assembly || (assembly->getId() != X86_INS_MOV
+        && assembly->getId() != X86_INS_LEA)) {
+
+        return X86Register::INVALID;
+    }
+    auto operands = assembly->getAsmOperands();
+    if(operands->getOpCount() != 2) return X86Register::INVALID;
+    // in AT&T order the destination is the last operand
+    const auto &last = operands->getOperands()[1];
+    if(last.type != X86_OP_REG) return X86Register::INVALID;
+    return RegisterLiveness::getRegisterID(last.reg);
+}
+#endif
+
+HardenCleanupPass::HardenCleanupPass() : pairCount(0), stackCount(0),
+    checkCount(0), function(nullptr), liveness(nullptr) {
+
+}
+
+void HardenCleanupPass::visit(Module *module) {
+#ifdef ARCH_X86_64
+    recurse(module);
+
+    LOG(1, "hardening cleanup in " << module->getName() << ": " << std::dec
+        << pairCount << " save/restore pairs, " << stackCount
+        << " stack adjustments, " << checkCount << " checks removed");
+    pairCount = stackCount = checkCount = 0;
+#endif
+}
+
+void HardenCleanupPass::visit(Function *function) {
+    this->function = function;
+    {
+        ChunkMutator::Batch batch;
+        recurse(function);
+    }
+
+    for(auto instruction : removedList) {
+        delete instruction->getSemantic();
+        delete instruction;
+    }
+    removedList.clear();
+#ifdef ARCH_X86_64
+    delete liveness;
+#endif
+    liveness = nullptr;
+}
+
+void HardenCleanupPass::visit(Block *block) {
+#ifdef ARCH_X86_64
+    for(bool changed = true; changed; ) {
+        changed = false;
+        std::vector<Instruction *> list;
+        for(auto instr : CIter::children(block)) list.push_back(instr);
+
+        // index 0 stays, since it may be a jump target
+        for(size_t i = 1; i < list.size() && !changed; i ++) {
+            changed = cleanAt(block, list, i);
+        }
+    }
+#endif
+}
+
+bool HardenCleanupPass::cleanAt(Block *block,
+    const std::vector<Instruction *> &list, size_t i) {
+
+#ifdef ARCH_X86_64
+    auto instr = list[i];
+    if(isSelfMove(instr)) {
+        remove(block, instr);
+        return true;
+    }
+    if(i + 1 >= list.size()) return false;
+    auto next = list[i + 1];
+
+    int32_t offset1, offset2;
+    if(getStackAdjustment(instr, offset1)
+        && getStackAdjustment(next, offset2)) {
+
+        int64_t sum = static_cast<int64_t>(offset1) + offset2;
+        if(sum < INT32_MIN || sum > INT32_MAX) return false;
+        if(sum != 0) {
+            ChunkMutator(block, false).insertBefore(instr,
+                InstrTemplate::make(InstrTemplate::leaStack(sum)));
+        }
+        remove(block, instr);
+        remove(block, next);
+        stackCount ++;
+        return true;
+    }
+
+    int reg = getPushRegister(instr, true);
+    if(reg != X86Register::INVALID && getPushRegister(next, false) == reg
+        && isDeadAfter(next, reg)) {
+
+        // pop leaves the saved value in reg and push stores it back, so
+        // only reg changes, and nothing reads it
+        remove(block, instr);
+        remove(block, next);
+        pairCount ++;
+        return true;
+    }
+
+    if(isDuplicateCheck(list, i)) {
+        remove(block, instr);
+        remove(block, next);
+        checkCount ++;
+        return true;
+    }
+#endif
+    return false;
+}
+
+bool HardenCleanupPass::isDuplicateCheck(
+    const std::vector<Instruction *> &list, size_t i) {
+
+#ifdef ARCH_X86_64
+    if(!isCompare(list[i])) return false;
+    auto jump = getConditionalJump(list[i + 1]);
+    if(!jump) return false;
+
+    auto readList = getReadRegisters(list[i]);
+    for(size_t j = i; j >= 2; j --) {
+        auto earlierJump = getConditionalJump(list[j - 1]);
+        if(earlierJump && isCompare(list[j - 2])) {
+            // the earlier check fell through with the same flags
+            return earlierJump->getId() == jump->getId()
+                && &*earlierJump->getLink()->getTarget()
+                    == &*jump->getLink()->getTarget()
+                && list[j - 2]->getSemantic()->getData()
+                    == list[i]->getSemantic()->getData();
+        }
+
+        int dest = getMoveDestination(list[j - 1]);
+        if(dest == X86Register::INVALID || readList[dest]) return false;
+    }
+#endif
+    return false;
+}
+
+bool HardenCleanupPass::isDeadAfter(Instruction *instruction, int reg) {
+#ifdef ARCH_X86_64
+    // removals only shorten live ranges, so this stays conservative
+    if(!liveness) liveness = new RegisterLiveness(function);
+    return !liveness->getLiveAfter(instruction).get(reg);
+#else
+    return false;
+#endif
+}
+
+void HardenCleanupPass::remove(Block *block, Instruction *instruction) {
+    ChunkMutator(block, false).remove(instruction);
+    removedList.push_back(instruction);
+}
@@ -0,0 +1,51 @@
+#ifndef EGALITO_PASS_HARDEN_CLEANUP_H
+#define EGALITO_PASS_HARDEN_CLEANUP_H
+
+#include <vector>
+#include "chunkpass.h"
+
+class RegisterLiveness;
+
+/** Removes the redundancy left when several hardening passes add code at
+    the same points, as etharden does with more than one mode.
+
+    Each ChunkAddInline insertion saves the registers it clobbers and steps
+    over the red zone on its own, so two insertions in a row restore
+    registers only to save them again:
+
+        pop %r11; lea 0x80(%rsp),%rsp; lea -0x80(%rsp),%rsp; push %r11
+
+    Within each block, adjacent lea adjustments of %rsp are merged, or
+    removed if they cancel, and a pop and push of the same register (or
+    popfq and pushfq) are removed if it is dead after the push, per
+    RegisterLiveness; this repeats until nothing changes. A check (cmp or
+    test, then a conditional jump) that repeats an earlier one in the same
+    block is removed if only moves into other registers come in between,
+    and so is a 64-bit mov of a register to itself.
+
+    The first instruction of a block is never removed, since it may be a
+    jump target. Only x86_64 is supported.
+*/
+class HardenCleanupPass : public ChunkPass {
+private:
+    size_t pairCount;
+    size_t stackCount;
+    size_t checkCount;
+    Function *function;
+    RegisterLiveness *liveness;  // of function, computed when needed
+    std::vector<Instruction *> removedList;
+public:
+    HardenCleanupPass();
+
+    virtual void visit(Module *module);
+    virtual void visit(Function *function);
+    virtual void visit(Block *block);
+private:
+    bool cleanAt(Block *block, const std::vector<Instruction *> &list,
+        size_t i);
+    bool isDuplicateCheck(const std::vector<Instruction *> &list, size_t i);
+    bool isDeadAfter(Instruction *instruction, int reg);
+    void remove(Block *block, Instruction *instruction);
+};
+
+#endif
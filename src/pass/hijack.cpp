@@ -1,6 +1,8 @@
 #include <cassert>
 #include "hijack.h"
 #include "chunk/link.h"
+#include "chunk/vtable.h"
+#include "chunk/external.h"
 #include "conductor/conductor.h"
 #include "instr/semantic.h"
 #include "operation/find2.h"
@@ -8,16 +10,42 @@
 #include "log/log.h"
 #include "chunk/dump.h"
 
-HijackPass::HijackPass(Conductor *conductor, const char *name) {
+HijackPass::HijackPass(Conductor *conductor, const char *name,
+    bool everywhere) : everywhere(everywhere), redirected(0) {
+
     original = ChunkFind2(conductor->getProgram()).findFunction(name, nullptr);
     assert(original);
 
-    auto egalito = conductor->getProgram()->getEgalito();
+    egalito = conductor->getProgram()->getEgalito();
+    vtableIndex = everywhere ? conductor->getVTableIndex() : nullptr;
     std::string name2 = std::string("egalito_") + std::string(name);
     wrapper = ChunkFind2().findFunctionInModule(name2.c_str(), egalito);
     assert(wrapper);
 }
 
+void HijackPass::visit(Program *program) {
+    if(!everywhere) {
+        recurse(program);
+        return;
+    }
+
+    for(auto module : CIter::children(program)) {
+        if(module == egalito) continue;
+        redirectModule(module);
+    }
+
+    // copied, since retarget() changes the list
+    auto entryList = vtableIndex->getEntriesTargeting(original);
+    for(const auto &location : entryList) {
+        if(location.module == egalito) continue;
+        vtableIndex->retarget(location,
+            new AbsoluteNormalLink(wrapper, Link::SCOPE_EXTERNAL_DATA));
+        redirected ++;
+    }
+    LOG(1, "redirected " << std::dec << redirected << " references from "
+        << original->getName() << " to " << wrapper->getName());
+}
+
 void HijackPass::visit(Module *module) {
     assert(module->getLibrary()->getRole() == Library::ROLE_MAIN);
     recurse(module);
@@ -49,3 +77,68 @@ void HijackPass::visit(PLTTrampoline *trampoline) {
         external->setResolved(wrapper);
     }
 }
+
+void HijackPass::redirectModule(Module *module) {
+    // LinkReferences don't know their module, and libegalito's references
+    // must stay, so this scans instead of using the LinkIndex
+    for(auto function : CIter::functions(module)) {
+        for(auto block : CIter::children(function)) {
+            for(auto instr : CIter::children(block)) {
+                auto semantic = instr->getSemantic();
+                auto link = semantic->getLink();
+                if(!isHijacked(link)) continue;
+
+                semantic->setLink(
+                    new NormalLink(wrapper, Link::SCOPE_EXTERNAL_JUMP));
+                delete link;
+                redirected ++;
+            }
+        }
+    }
+
+    for(auto region : CIter::regions(module)) {
+        for(auto section : CIter::children(region)) {
+            for(auto var : CIter::children(section)) {
+                auto link = var->getDest();
+                if(!isHijacked(link)) continue;
+
+                if(link->isAbsolute()) {
+                    var->setDest(new AbsoluteNormalLink(
+                        wrapper, Link::SCOPE_EXTERNAL_DATA));
+                }
+                else {
+                    var->setDest(
+                        new NormalLink(wrapper, Link::SCOPE_EXTERNAL_DATA));
+                }
+                delete link;
+                redirected ++;
+            }
+        }
+    }
+
+    // anything resolved later, such as a GS table entry made for a PLT
+    // entry, then finds the wrapper too
+    if(module->getPLTList()) {
+        for(auto trampoline : CIter::plts(module)) visit(trampoline);
+    }
+    if(auto externalList = module->getExternalSymbolList()) {
+        for(auto external : CIter::children(externalList)) {
+            if(external->getResolved() == original) {
+                external->setResolved(wrapper);
+            }
+        }
+    }
+}
+
+bool HijackPass::isHijacked(Link *link) {
+    if(!link) return false;
+    auto target = &*link->getTarget();
+    if(target == original) return true;
+
+    if(auto trampoline = dynamic_cast<PLTTrampoline *>(target)) {
+        auto external = trampoline->getExternalSymbol();
+        return external && (external->getResolved() == original
+            || external->getResolved() == wrapper);
+    }
+    return false;
+}
@@ -3,16 +3,36 @@
 
 #include "pass/chunkpass.h"
 
+class Link;
+class VTableIndex;
+
+/** Redirects a function to its egalito_ wrapper in libegalito. Visiting a
+    Module retargets its direct calls and PLT entries. Visiting the Program
+    with everywhere set also retargets instructions and DataVariables that
+    use the function as a pointer, VTable entries and resolved
+    ExternalSymbols in every module but libegalito (whose wrapper calls the
+    original). Calls through a PLT entry for the function then go to the
+    wrapper directly. This must run before GS table entries are made from
+    the Links.
+*/
 class HijackPass : public ChunkPass {
 private:
     Chunk *original;
     Chunk *wrapper;
+    Module *egalito;
+    VTableIndex *vtableIndex;
+    bool everywhere;
+    size_t redirected;
 public:
-    HijackPass(Conductor *conductor, const char *name);
+    HijackPass(Conductor *conductor, const char *name,
+        bool everywhere = false);
+    void visit(Program *program);
     void visit(Module *module);
 private:
     void visit(Instruction *instruction);
     void visit(PLTTrampoline *trampoline);
+    void redirectModule(Module *module);
+    bool isHijacked(Link *link);
 };
 
 #endif
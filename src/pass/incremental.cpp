@@ -0,0 +1,74 @@
+#include <set>
+#include "incremental.h"
+#include "chunk/concrete.h"
+#include "instr/concrete.h"
+#include "log/log.h"
+
+void IncrementalPassDriver::markClean() {
+    checkpoint.clear();
+    for(auto function : CIter::functions(module)) {
+        checkpoint[function] = function->getModificationCount();
+    }
+}
+
+std::vector<Function *> IncrementalPassDriver::getModifiedFunctions() const {
+    std::vector<Function *> modified;
+    for(auto function : CIter::functions(module)) {
+        if(isModified(function)) modified.push_back(function);
+    }
+    return modified;
+}
+
+std::vector<Function *> IncrementalPassDriver::getFunctionsToReanalyze()
+    const {
+
+    auto modified = getModifiedFunctions();
+    std::set<Function *> dirty(modified.begin(), modified.end());
+    if(dirty.empty()) return modified;
+
+    std::vector<Function *> result;
+    for(auto function : CIter::functions(module)) {
+        bool include = (dirty.count(function) > 0);
+        for(auto block : CIter::children(function)) {
+            if(include) break;
+            for(auto instr : CIter::children(block)) {
+                auto cfi = dynamic_cast<ControlFlowInstruction *>(
+                    instr->getSemantic());
+                if(!cfi || !cfi->getLink()) continue;
+
+                auto target = cfi->getLink()->getTarget();
+                auto targetFunction = dynamic_cast<Function *>(target);
+                if(!targetFunction) {
+                    if(auto i = dynamic_cast<Instruction *>(target)) {
+                        targetFunction = dynamic_cast<Function *>(
+                            i->getParent()->getParent());
+                    }
+                }
+                if(targetFunction && targetFunction != function
+                    && dirty.count(targetFunction)) {
+
+                    include = true;
+                    break;
+                }
+            }
+        }
+        if(include) result.push_back(function);
+    }
+
+    LOG(5, "incremental: " << std::dec << modified.size()
+        << " modified functions, " << result.size() << " to re-analyze in "
+        << module->getName());
+    return result;
+}
+
+void IncrementalPassDriver::run(ChunkVisitor *pass) const {
+    for(auto function : getFunctionsToReanalyze()) {
+        function->accept(pass);
+    }
+}
+
+bool IncrementalPassDriver::isModified(Function *function) const {
+    auto it = checkpoint.find(function);
+    return it == checkpoint.end()
+        || it->second != function->getModificationCount();
+}
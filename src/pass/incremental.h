@@ -0,0 +1,50 @@
+#ifndef EGALITO_PASS_INCREMENTAL_H
+#define EGALITO_PASS_INCREMENTAL_H
+
+#include <map>
+#include <vector>
+
+class Module;
+class Function;
+class ChunkVisitor;
+
+/** Re-runs function-level analyses only where the code has changed.
+
+    Every Function carries a modification counter which ChunkMutator bumps
+    on each change. This driver remembers the counters at a checkpoint;
+    afterwards, functions whose counter moved (or which did not exist at
+    the checkpoint) are considered dirty. Since analyses like
+    NonReturnFunction or JumpTablePass look across direct calls, the
+    direct callers of dirty functions are re-analyzed as well.
+
+    Typical use:
+        IncrementalPassDriver driver(module);
+        ... transformations ...
+        SplitBasicBlock split;
+        driver.run(&split);
+*/
+class IncrementalPassDriver {
+private:
+    Module *module;
+    std::map<Function *, unsigned long> checkpoint;
+public:
+    IncrementalPassDriver(Module *module) : module(module) { markClean(); }
+
+    /** Treat the current state of every function as up to date. */
+    void markClean();
+
+    /** Functions changed or created since the last markClean(). */
+    std::vector<Function *> getModifiedFunctions() const;
+
+    /** Modified functions plus their direct callers, in module order. */
+    std::vector<Function *> getFunctionsToReanalyze() const;
+
+    /** Visit each function needing re-analysis. Does not markClean(), so
+        several passes can be run over the same dirty set.
+    */
+    void run(ChunkVisitor *pass) const;
+private:
+    bool isModified(Function *function) const;
+};
+
+#endif
@@ -1,44 +1,170 @@
+#include <algorithm>
 #include "inferlinks.h"
 #include "chunk/dump.h"
 #include "disasm/makesemantic.h"
+#include "util/threadpool.h"
 #include "log/log.h"
 
 void InferLinksPass::visit(Module *module) {
     this->module = module;
 #if defined(ARCH_AARCH64) || defined(ARCH_RISCV)
     LinkedInstruction::makeAllLinked(module);
+#elif defined(ARCH_X86_64)
+    inferModuleLinks(module);
 #else
-    recurse(module);
+    CIter::forEachInstruction(module,
+        [this] (Instruction *instruction) { inferLinks(instruction); });
 #endif
 }
 
 void InferLinksPass::visit(Instruction *instruction) {
+    inferLinks(instruction);
+}
+
+void InferLinksPass::inferLinks(Instruction *instruction) {
+    auto assembly = getCandidateAssembly(instruction);
+    if(!assembly) return;
+
+#if defined(ARCH_X86_64) || defined(ARCH_ARM)
     auto semantic = instruction->getSemantic();
+    // see if this instruction has any operands that need links
+    // (can return NULL if not)
+    auto linked = LinkedInstruction::makeLinked(module, instruction, assembly);
+    if(linked) {
+        instruction->setSemantic(linked);
+        delete semantic;
+    }
+#endif
+}
+
+AssemblyPtr InferLinksPass::getCandidateAssembly(Instruction *instruction) {
+    // cheap checks first, most instructions stop here
+    auto semantic = instruction->getSemantic();
+    if(semantic->getLink()) return nullptr;
+
     if(dynamic_cast<IndirectCallInstruction *>(semantic)) {
         // if this is RIP-relative, we should try to convert this to
         // ControlFlowInstruction
-        return;
+        return nullptr;
     }
     if(dynamic_cast<IndirectJumpInstruction *>(semantic)) {
-        return;
+        return nullptr;
     }
-    if(semantic->getLink()) return;
-    auto assembly = semantic->getAssembly();
-    if(!assembly) return;
+
+    return semantic->getAssembly();
+}
 
 #ifdef ARCH_X86_64
-    // see if this instruction has any operands that need links
-    // (can return NULL if not)
-    auto linked = LinkedInstruction::makeLinked(module, instruction, assembly);
-    if(linked) {
-        instruction->setSemantic(linked);
-        delete semantic;
+void InferLinksPass::inferModuleLinks(Module *module) {
+    std::vector<Function *> functionList;
+    for(auto function : CIter::functions(module)) {
+        functionList.push_back(function);
     }
-#elif defined(ARCH_ARM)
-    auto linked = LinkedInstruction::makeLinked(module, instruction, assembly);
-    if(linked) {
-        instruction->setSemantic(linked);
-        delete semantic;
+
+    // phase 1: collect operand targets; each function only reads itself
+    std::vector<std::vector<Candidate>> candidateList(functionList.size());
+    std::vector<std::vector<address_t>> dispList(functionList.size());
+    std::vector<std::vector<address_t>> immList(functionList.size());
+    ThreadPool pool;
+    pool.parallelFor(functionList.size(), [&] (size_t i) {
+        CIter::forEachInstruction(functionList[i],
+            [&] (Instruction *instruction) {
+
+            auto assembly = getCandidateAssembly(instruction);
+            if(assembly && LinkedInstruction::getOperandTargets(module,
+                instruction, assembly, dispList[i], immList[i])) {
+
+                candidateList[i].push_back(Candidate{instruction, assembly});
+            }
+        });
+    });
+
+    // phase 2: classify every distinct target at once
+    std::vector<address_t> dispTargets, immTargets;
+    for(size_t i = 0; i < functionList.size(); i ++) {
+        dispTargets.insert(dispTargets.end(),
+            dispList[i].begin(), dispList[i].end());
+        immTargets.insert(immTargets.end(),
+            immList[i].begin(), immList[i].end());
     }
-#endif
+    InferredTargetMap targets;
+    findTargets(module, dispTargets, immTargets, targets);
+
+    // phase 3: make links, in instruction order since inferred markers
+    // are created as they are found
+    size_t count = 0;
+    for(auto &list : candidateList) {
+        for(auto &candidate : list) {
+            auto instruction = candidate.instruction;
+            auto semantic = instruction->getSemantic();
+            auto linked = LinkedInstruction::makeLinked(module, instruction,
+                candidate.assembly, &targets);
+            if(linked) {
+                instruction->setSemantic(linked);
+                delete semantic;
+                count ++;
+            }
+        }
+    }
+    LOG(10, "inferred links for " << std::dec << count << " instructions");
 }
+
+void InferLinksPass::findTargets(Module *module,
+    std::vector<address_t> &dispTargets, std::vector<address_t> &immTargets,
+    InferredTargetMap &targets) {
+
+    auto sortUnique = [] (std::vector<address_t> &list) {
+        std::sort(list.begin(), list.end());
+        list.erase(std::unique(list.begin(), list.end()), list.end());
+    };
+    sortUnique(dispTargets);
+    sortUnique(immTargets);
+
+    std::vector<Function *> functionList;
+    for(auto function : CIter::functions(module)) {
+        functionList.push_back(function);
+    }
+    std::stable_sort(functionList.begin(), functionList.end(),
+        [] (Function *a, Function *b)
+            { return a->getAddress() < b->getAddress(); });
+
+    std::vector<PLTTrampoline *> pltList;
+    if(module->getPLTList()) {
+        for(auto plt : CIter::children(module->getPLTList())) {
+            pltList.push_back(plt);
+        }
+        std::stable_sort(pltList.begin(), pltList.end(),
+            [] (PLTTrampoline *a, PLTTrampoline *b)
+                { return a->getAddress() < b->getAddress(); });
+    }
+
+    // RIP-relative: the last function starting at or before the target,
+    // if it contains it, or else a PLT entry starting there
+    size_t f = 0, p = 0;
+    for(auto target : dispTargets) {
+        while(f < functionList.size()
+            && functionList[f]->getAddress() <= target) f ++;
+        while(p < pltList.size() && pltList[p]->getAddress() < target) p ++;
+
+        if(f > 0 && functionList[f - 1]->getRange().contains(target)) {
+            targets.setContaining(target, functionList[f - 1]);
+        }
+        else if(p < pltList.size() && pltList[p]->getAddress() == target) {
+            targets.setContaining(target, pltList[p]);
+        }
+    }
+
+    // immediates: a function starting exactly at the target
+    f = 0;
+    for(auto target : immTargets) {
+        while(f < functionList.size()
+            && functionList[f]->getAddress() < target) f ++;
+
+        // with several, the last one wins, as in the spatial list
+        size_t last = f;
+        while(last < functionList.size()
+            && functionList[last]->getAddress() == target) last ++;
+        if(last > f) targets.setStart(target, functionList[last - 1]);
+    }
+}
+#endif
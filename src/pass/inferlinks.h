@@ -1,17 +1,41 @@
 #ifndef EGALITO_PASS_INFER_LINKS_H
 #define EGALITO_PASS_INFER_LINKS_H
 
+#include <vector>
 #include "chunkpass.h"
 #include "elf/elfmap.h"
+#include "instr/assembly.h"
 
+class InferredTargetMap;
+
+/** Adds Links for instruction operands that no relocation covered.
+
+    On x86_64 this runs in three phases over a Module: operand targets
+    are collected from each function in parallel, then sorted and matched
+    against the functions and PLT entries in one sweep, and finally the
+    LinkedInstructions are made using those results.
+*/
 class InferLinksPass : public ChunkPass {
 private:
+    struct Candidate {
+        Instruction *instruction;
+        AssemblyPtr assembly;
+    };
+
     ElfMap *elf;
     Module *module;
 public:
     InferLinksPass(ElfMap *elf) : elf(elf), module(nullptr) {}
     virtual void visit(Module *module);
     virtual void visit(Instruction *instruction);
+private:
+    void inferLinks(Instruction *instruction);
+    AssemblyPtr getCandidateAssembly(Instruction *instruction);
+#ifdef ARCH_X86_64
+    void inferModuleLinks(Module *module);
+    void findTargets(Module *module, std::vector<address_t> &dispTargets,
+        std::vector<address_t> &immTargets, InferredTargetMap &targets);
+#endif
 };
 
 #endif
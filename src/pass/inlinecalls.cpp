@@ -0,0 +1,249 @@
+#include "inlinecalls.h"
+#include "analysis/frametype.h"
+#include "chunk/concrete.h"
+#include "disasm/disassemble.h"
+#include "instr/concrete.h"
+#include "operation/mutator.h"
+#include "log/log.h"
+
+void InlineCallsPass::visit(Program *program) {
+    recurse(program);
+    LOG(1, "InlineCallsPass: inlined " << count << " calls");
+}
+
+void InlineCallsPass::visit(Function *function) {
+#ifdef ARCH_X86_64
+    // collect first, inlining adds blocks to the function
+    std::vector<std::pair<Block *, Function *>> siteList;
+    for(auto block : CIter::children(function)) {
+        if(!block->getNextSibling()) continue;  // nothing to return to
+
+        // calls always end a block
+        auto last = block->getChildren()->getIterable()->getLast();
+        auto cfi = dynamic_cast<ControlFlowInstruction *>(last->getSemantic());
+        if(!cfi || cfi->getMnemonic() != "callq" || !cfi->getLink()) continue;
+
+        auto callee = dynamic_cast<Function *>(&*cfi->getLink()->getTarget());
+        if(!callee || callee == function) continue;
+        if(!crossModule
+            && callee->getParent() != function->getParent()) continue;
+        if(!isInlinable(callee)) continue;
+
+        siteList.emplace_back(block, callee);
+    }
+
+    for(auto site : siteList) {
+        LOG(10, "inlining [" << site.second->getName() << "] into ["
+            << function->getName() << "]");
+        inlineCall(function, site.first, site.second);
+        count ++;
+    }
+#endif
+}
+
+bool InlineCallsPass::isInlinable(Function *function) {
+    auto it = inlinableMap.find(function);
+    if(it != inlinableMap.end()) return it->second;
+
+    bool inlinable = checkInlinable(function);
+    inlinableMap[function] = inlinable;
+    return inlinable;
+}
+
+bool InlineCallsPass::checkInlinable(Function *function) {
+#ifdef ARCH_X86_64
+    if(function->isIFunc() || function->getSize() > maxSize) return false;
+    if(function->getChildren()->getIterable()->getCount() == 0) return false;
+    if(FrameType::hasStackFrame(function)) return false;
+
+    auto lastBlock = function->getChildren()->getIterable()->getLast();
+    for(auto block : CIter::children(function)) {
+        for(auto instr : CIter::children(block)) {
+            auto semantic = instr->getSemantic();
+            if(dynamic_cast<ReturnInstruction *>(semantic)) continue;
+
+            if(auto cfi = dynamic_cast<ControlFlowInstruction *>(semantic)) {
+                if(cfi->getMnemonic() == "callq" || !cfi->getLink()) {
+                    return false;
+                }
+
+                // only branches within the function, no tail calls
+                auto target = &*cfi->getLink()->getTarget();
+                if(auto targetInstr = dynamic_cast<Instruction *>(target)) {
+                    target = targetInstr->getParent();
+                }
+                if(!target || target->getParent() != function) return false;
+                continue;
+            }
+
+            if(auto linked = dynamic_cast<LinkedInstruction *>(semantic)) {
+                if(!dynamic_cast<DataOffsetLink *>(linked->getLink())) {
+                    return false;
+                }
+            }
+            else if(!dynamic_cast<IsolatedInstruction *>(semantic)
+                || dynamic_cast<IndirectControlFlowInstructionBase *>(
+                    semantic)) {
+
+                return false;
+            }
+
+            auto assembly = semantic->getAssembly();
+            if(!assembly) return false;
+            switch(assembly->getId()) {
+            case X86_INS_CALL:
+            case X86_INS_PUSH:
+            case X86_INS_POP:
+            case X86_INS_PUSHFQ:
+            case X86_INS_POPFQ:
+            case X86_INS_LEAVE:
+            case X86_INS_ENTER:
+                return false;
+            default:
+                break;
+            }
+
+            auto operands = assembly->getAsmOperands();
+            auto op = operands->getOperands();
+            for(size_t i = 0; i < operands->getOpCount(); i ++) {
+                if(op[i].type == X86_OP_REG && op[i].reg == X86_REG_RSP) {
+                    return false;
+                }
+                if(op[i].type == X86_OP_MEM && (op[i].mem.base == X86_REG_RSP
+                    || op[i].mem.index == X86_REG_RSP)) {
+
+                    return false;
+                }
+            }
+        }
+    }
+
+    // the copy must not fall off the end of the callee
+    auto last = lastBlock->getChildren()->getIterable()->getLast();
+    auto semantic = last->getSemantic();
+    if(dynamic_cast<ReturnInstruction *>(semantic)) {
+        // a callee that only returns would leave nothing to inline
+        auto first = function->getChildren()->getIterable()->get(0)
+            ->getChildren()->getIterable()->get(0);
+        return first != last;
+    }
+    auto cfi = dynamic_cast<ControlFlowInstruction *>(semantic);
+    return cfi && cfi->getMnemonic() == "jmp";
+#else
+    return false;
+#endif
+}
+
+void InlineCallsPass::inlineCall(Function *caller, Block *block,
+    Function *callee) {
+
+#ifdef ARCH_X86_64
+    auto call = block->getChildren()->getIterable()->getLast();
+    auto next = static_cast<Block *>(block->getNextSibling());
+    auto continuation = next->getChildren()->getIterable()->get(0);
+    bool sameModule = (callee->getParent() == caller->getParent());
+
+    // every callee instruction maps to its copy: the first one reuses the
+    // call, and a final return falls through to the continuation
+    std::map<Instruction *, Instruction *> instrMap;
+    auto lastBlock = callee->getChildren()->getIterable()->getLast();
+    auto last = lastBlock->getChildren()->getIterable()->getLast();
+    bool dropLast = dynamic_cast<ReturnInstruction *>(last->getSemantic());
+    for(auto calleeBlock : CIter::children(callee)) {
+        for(auto instr : CIter::children(calleeBlock)) {
+            if(instrMap.empty()) instrMap[instr] = call;
+            else if(instr == last && dropLast) instrMap[instr] = continuation;
+            else instrMap[instr] = new Instruction();
+        }
+    }
+
+    Block *previous = block;
+    for(auto calleeBlock : CIter::children(callee)) {
+        Block *newBlock = nullptr;
+        for(auto instr : CIter::children(calleeBlock)) {
+            auto copy = instrMap[instr];
+            if(copy == continuation) continue;
+
+            auto semantic = copySemantic(instr->getSemantic(), copy,
+                instrMap, continuation, sameModule);
+            if(copy == call) {
+                auto old = call->getSemantic();
+                call->setSemantic(semantic);
+                ChunkMutator(block, true).modifiedChildSize(call,
+                    semantic->getSize() - old->getSize());
+                delete old;
+                continue;
+            }
+            copy->setSemantic(semantic);
+
+            // the rest of the first block stays in the call's block
+            if(previous == block && calleeBlock
+                == callee->getChildren()->getIterable()->get(0)) {
+
+                ChunkMutator(block, true).append(copy);
+                continue;
+            }
+            if(!newBlock) {
+                newBlock = new Block();
+                ChunkMutator(caller, true).insertAfter(previous, newBlock);
+                previous = newBlock;
+            }
+            ChunkMutator(newBlock, true).append(copy);
+        }
+    }
+#endif
+}
+
+InstructionSemantic *InlineCallsPass::copySemantic(
+    InstructionSemantic *semantic, Instruction *instr,
+    const std::map<Instruction *, Instruction *> &instrMap,
+    Instruction *continuation, bool sameModule) {
+
+#ifdef ARCH_X86_64
+    auto &handle = DisasmHandle::forThread();
+
+    if(dynamic_cast<ReturnInstruction *>(semantic)) {
+        auto jump = new ControlFlowInstruction(
+            X86_INS_JMP, instr, "\xe9", "jmp", 4);
+        jump->setLink(new NormalLink(continuation, Link::SCOPE_WITHIN_FUNCTION));
+        return jump;
+    }
+
+    if(auto cfi = dynamic_cast<ControlFlowInstruction *>(semantic)) {
+        auto target = &*cfi->getLink()->getTarget();
+        if(auto targetBlock = dynamic_cast<Block *>(target)) {
+            target = targetBlock->getChildren()->getIterable()->get(0);
+        }
+        auto jump = new ControlFlowInstruction(cfi->getId(), instr,
+            cfi->getOpcode(), cfi->getMnemonic(), cfi->getDisplacementSize());
+        jump->setLink(new NormalLink(
+            instrMap.at(static_cast<Instruction *>(target)),
+            Link::SCOPE_WITHIN_FUNCTION));
+        return jump;
+    }
+
+    auto assembly = DisassembleInstruction(handle).makeAssemblyPtr(
+        semantic->getData());
+    if(auto linked = dynamic_cast<LinkedInstruction *>(semantic)) {
+        auto link = static_cast<DataOffsetLink *>(linked->getLink());
+        auto section = static_cast<DataSection *>(&*link->getTarget());
+        auto offset = link->getTargetAddress() - section->getAddress()
+            - link->getAddend();
+        auto newLink = new DataOffsetLink(section, offset, sameModule
+            ? Link::SCOPE_INTERNAL_DATA : Link::SCOPE_EXTERNAL_DATA);
+        newLink->setAddend(link->getAddend());
+
+        auto copy = new LinkedInstruction(instr);
+        copy->setAssembly(assembly);
+        copy->setLink(newLink);
+        copy->setIndex(linked->getIndex());
+        return copy;
+    }
+
+    auto copy = new IsolatedInstruction();
+    copy->setAssembly(assembly);
+    return copy;
+#else
+    return nullptr;
+#endif
+}
@@ -0,0 +1,48 @@
+#ifndef EGALITO_PASS_INLINE_CALLS_H
+#define EGALITO_PASS_INLINE_CALLS_H
+
+#include <map>
+#include <vector>
+#include "chunkpass.h"
+
+class Instruction;
+class InstructionSemantic;
+
+/** Replaces direct calls to small leaf functions with a copy of the
+    callee's code. This is x86_64-only.
+
+    A callee qualifies if it is at most maxSize bytes, makes no calls,
+    has no stack frame (see FrameType) and does not touch %rsp at all:
+    without the call, (%rsp) is no longer the return address, so any
+    stack access would see a different slot. The copy's blocks are
+    placed right after the call's block; returns become jumps to the
+    instruction after the call, and the last one falls through instead.
+    The call instruction itself becomes the callee's first instruction,
+    so that branches into the call site stay valid.
+
+    Callees in another module are only inlined with crossModule set,
+    which is only correct for union output: the copy keeps referring to
+    the callee module's data.
+*/
+class InlineCallsPass : public ChunkPass {
+private:
+    size_t maxSize;
+    bool crossModule;
+    std::map<Function *, bool> inlinableMap;
+    size_t count;
+public:
+    InlineCallsPass(size_t maxSize = 32, bool crossModule = false)
+        : maxSize(maxSize), crossModule(crossModule), count(0) {}
+    virtual void visit(Program *program);
+    virtual void visit(Function *function);
+private:
+    bool isInlinable(Function *function);
+    bool checkInlinable(Function *function);
+    void inlineCall(Function *caller, Block *block, Function *callee);
+    InstructionSemantic *copySemantic(InstructionSemantic *semantic,
+        Instruction *instr,
+        const std::map<Instruction *, Instruction *> &instrMap,
+        Instruction *continuation, bool sameModule);
+};
+
+#endif
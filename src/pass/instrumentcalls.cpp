@@ -14,24 +14,31 @@ void InstrumentCallsPass::useStack(Function *function, FrameType *frame) {
     LOG(10, "instrumenting " << function->getName() << " in "
         << function->getParent()->getParent()->getName());
 
+    size_t index = indexList.size();
+    if(indexed) indexList.push_back(function);
+
     if(entry) {
-        addEntryAdvice(function, frame);
+        addEntryAdvice(function, frame, index);
     }
 
     if(exit) {
-        addExitAdvice(function, frame);
+        addExitAdvice(function, frame, index);
     }
 }
 
-void InstrumentCallsPass::addEntryAdvice(Function *function, FrameType *frame) {
+void InstrumentCallsPass::addEntryAdvice(Function *function, FrameType *frame,
+    size_t index) {
+
     auto block = function->getChildren()->getIterable()->get(0);
     auto ins = block->getChildren()->getIterable()->get(0);
-    addAdvice(ins, entry, false);
+    addAdvice(ins, entry, false, index);
 }
 
-void InstrumentCallsPass::addExitAdvice(Function *function, FrameType *frame) {
+void InstrumentCallsPass::addExitAdvice(Function *function, FrameType *frame,
+    size_t index) {
+
     for(auto ins : frame->getEpilogueInstrs()) {
-        addAdvice(ins, exit, false);
+        addAdvice(ins, exit, false, index);
         if(auto block = dynamic_cast<Block *>(ins->getParent())) {
             auto top = block->getChildren()->getIterable()->get(0);
             frame->fixEpilogue(ins, top);
@@ -40,9 +47,19 @@ void InstrumentCallsPass::addExitAdvice(Function *function, FrameType *frame) {
 }
 
 void InstrumentCallsPass::addAdvice(
-    Instruction *point, Function *advice, bool after) {
+    Instruction *point, Function *advice, bool after, size_t index) {
 
 #ifdef ARCH_X86_64
+    // mov $index, %r11d
+    Instruction *movIns = nullptr;
+    if(indexed) {
+        movIns = Disassemble::instruction({0x41, 0xbb,
+            static_cast<unsigned char>(index & 0xff),
+            static_cast<unsigned char>((index >> 8) & 0xff),
+            static_cast<unsigned char>((index >> 16) & 0xff),
+            static_cast<unsigned char>((index >> 24) & 0xff)});
+    }
+
     // call f
     auto callIns = new Instruction();
     auto callSem
@@ -54,11 +71,15 @@ void InstrumentCallsPass::addAdvice(
 
     if(after) {
         ChunkMutator(block).insertAfter(point, callIns);
+        if(movIns) ChunkMutator(block).insertAfter(point, movIns);
     }
     else {
+        if(movIns) ChunkMutator(block).insertBefore(point, movIns);
         ChunkMutator(block).insertBefore(point, callIns);
     }
 #elif defined(ARCH_AARCH64)
+    if(indexed) throw "InstrumentCallsPass: indexed advice needs x86_64";
+
     /* For an arbitrary cutpoint, the base register must be figured out
      * from the frame type. */
     const PhysicalRegister<AARCH64GPRegister> rSP(
@@ -1,9 +1,16 @@
 #ifndef EGALITO_PASS_INSTRUMENTCALLS_PASS_H
 #define EGALITO_PASS_INSTRUMENTCALLS_PASS_H
 
+#include <vector>
 #include "pass/stackextend.h"
 
-/* The assumption is that the advice is transformed by SwitchContextPass. */
+/* The assumption is that the advice is transformed by SwitchContextPass.
+
+   With setIndexedAdvice(), each instrumented function gets an index (its
+   position in getIndexList()), which is loaded into %r11d right before each
+   call to the advice; %r11 is never live at function entry or at a return.
+   This is only supported on x86_64.
+*/
 
 // This should be zero so that it will still survive even when the number of
 // entry and exit don't match
@@ -17,19 +24,24 @@ private:
     Function *entry;
     Function *exit;
     predicate_t predicate;
+    bool indexed;
+    std::vector<Function *> indexList;
 public:
     InstrumentCallsPass()
         : StackExtendPass(FUNCTIONCALL_CONTEXT_SIZE),
-          entry(nullptr), exit(nullptr), predicate(nullptr) {}
+          entry(nullptr), exit(nullptr), predicate(nullptr), indexed(false) {}
     void setPredicate(predicate_t predicate) { this->predicate = predicate; }
     void setEntryAdvice(Function *entry) { this->entry = entry; }
     void setExitAdvice(Function *exit) { this->exit = exit; }
+    void setIndexedAdvice(bool indexed) { this->indexed = indexed; }
+    const std::vector<Function *> &getIndexList() const { return indexList; }
 
 private:
     virtual void useStack(Function *function, FrameType *frame);
-    void addEntryAdvice(Function *function, FrameType *frame);
-    void addExitAdvice(Function *function, FrameType *frame);
-    void addAdvice(Instruction *point, Function *advice, bool before);
+    void addEntryAdvice(Function *function, FrameType *frame, size_t index);
+    void addExitAdvice(Function *function, FrameType *frame, size_t index);
+    void addAdvice(Instruction *point, Function *advice, bool before,
+        size_t index);
     virtual bool shouldApply(Function *function) {
         return function != entry && function != exit
             && (predicate ? predicate(function) : true); }
@@ -12,6 +12,7 @@
 void InstrumentInstructionPass::visit(Function *function) { 
     if(!shouldApply(function)) return;
 
+    ChunkMutator::Batch batch;
     for(size_t i = 0; i < function->getChildren()->getIterable()->getCount(); i ++) {
         auto block = function->getChildren()->getIterable()->get(i);
         visit(block);
@@ -1,119 +1,175 @@
-#include <iostream>
+#include <algorithm>
 #include "internalcalls.h"
-#include "operation/find.h"
 #include "instr/semantic.h"
 #include "instr/concrete.h"
 #include "instr/writer.h"
+#include "util/threadpool.h"
 #include "log/log.h"
 
 void InternalCalls::visit(Module *module) {
-    functionList = module->getFunctionList();
-    recurse(functionList);
+    buildIndex(module);
+
+    // look up targets; each function only writes its own list
+    std::vector<std::vector<Resolved>> resolvedList(functionList.size());
+    ThreadPool pool;
+    pool.parallelFor(functionList.size(), [&] (size_t i) {
+        resolve(i, resolvedList[i]);
+    });
+
+    for(auto &list : resolvedList) {
+        for(auto &resolved : list) makeLink(resolved);
+    }
+
+    functionList.clear();
+    maxEnd.clear();
+    instructionList.clear();
 }
 
-void InternalCalls::visit(Instruction *instruction) {
-    auto semantic = instruction->getSemantic();
-    auto link = semantic->getLink();
-    if(!link) return;  // no link in this instruction
-    if(link->getTarget()) return;  // link already resolved
+void InternalCalls::buildIndex(Module *module) {
+    for(auto function : CIter::functions(module)) {
+        functionList.push_back(function);
+    }
+    // stable, so that of several functions at one address the last one
+    // added wins, as in the FunctionList's spatial map
+    std::stable_sort(functionList.begin(), functionList.end(),
+        [] (Function *a, Function *b)
+            { return a->getAddress() < b->getAddress(); });
 
-    auto targetAddress = link->getTargetAddress();
+    address_t highest = 0;
+    for(auto function : functionList) {
+        highest = std::max(highest, function->getRange().getEnd());
+        maxEnd.push_back(highest);
+    }
+
+    instructionList.resize(functionList.size());
+    ThreadPool pool;
+    pool.parallelFor(functionList.size(), [this] (size_t i) {
+        auto &list = instructionList[i];
+        for(auto block : CIter::children(functionList[i])) {
+            for(auto instr : CIter::children(block)) {
+                list.push_back(instr);
+            }
+        }
+        std::stable_sort(list.begin(), list.end(),
+            [] (Instruction *a, Instruction *b)
+                { return a->getAddress() < b->getAddress(); });
+    });
+}
+
+void InternalCalls::resolve(size_t index,
+    std::vector<Resolved> &resolvedList) {
+
+    auto function = functionList[index];
+    auto byAddress = [] (address_t address, Function *f)
+        { return address < f->getAddress(); };
 
-    // We are only resolving ControlFlowInstruction targets
-    if(!dynamic_cast<ControlFlowInstruction *>(semantic)) return;
+    for(auto instruction : instructionList[index]) {
+        auto semantic = instruction->getSemantic();
+        auto link = semantic->getLink();
+        if(!link) continue;  // no link in this instruction
+        if(link->getTarget()) continue;  // link already resolved
 
-    LOG0(10, "Looking up target 0x" << std::hex << targetAddress << " -> ");
+        // We are only resolving ControlFlowInstruction targets
+        if(!dynamic_cast<ControlFlowInstruction *>(semantic)) continue;
 
-    Chunk *found = nullptr;
-    bool isExternal = false;
-    // Common case for call instructions: point at another function
-    if(!found) {
-        found = functionList->getChildren()->getSpatial()->find(targetAddress);
-        if(found && found != instruction->getParent()->getParent()) {
-            isExternal = true;
+        auto targetAddress = link->getTargetAddress();
+        size_t upper = std::upper_bound(functionList.begin(),
+            functionList.end(), targetAddress, byAddress)
+            - functionList.begin();
+
+        Chunk *found = nullptr;
+        bool isExternal = false;
+        // Common case for call instructions: point at another function
+        if(upper > 0 && functionList[upper - 1]->getAddress()
+            == targetAddress) {
+
+            found = functionList[upper - 1];
+            isExternal = (found != function);
         }
-    }
-    // Common case for jumps: internal jump elsewhere within function
-    if(!found) {
-        auto enclosing = instruction->getParent()->getParent();
-        auto func = dynamic_cast<Function *>(enclosing);
+        // Common case for jumps: internal jump elsewhere within function
+        if(!found) {
 #ifdef ARCH_X86_64
-        // we get jumps into the middle of an instruction to skip "LOCK" prefix
-        found = ChunkFind().findInnermostInsideInstruction(func, targetAddress);
+            // we get jumps into the middle of an instruction to skip "LOCK"
+            // prefix
+            found = findInstruction(index, targetAddress, true);
 #else
-        found = ChunkFind().findInnermostAt(func, targetAddress);
+            found = findInstruction(index, targetAddress, false);
 #endif
-    }
-    // Uncommon case for jumps: external jump to another function
-    // This can be for tail recursion or for overlapping functions (_nocancel)
-    if(!found) {
-        auto enclosing = instruction->getParent()->getParent()->getParent();
-        auto otherFunctionList = dynamic_cast<FunctionList *>(enclosing);
-
-#if 0
-        // Right now, spatial search in a Module/FunctionList doesn't work.
-        // It doesn't handle overlapping functions correctly.
-        found = ChunkFind().findInnermostAt(module, targetAddress);
-#elif 1
-        // Here's a hack, look at a few nearby functions in the list to
-        // resolve targets. Should really just use a data structure that
-        // supports overlaps.
-        std::vector<Function *> funcs;
-        funcs = CIter::spatial(otherFunctionList)
-            ->findAllContaining(targetAddress);
-        for(auto f : funcs) {
-            found = ChunkFind().findInnermostAt(f, targetAddress);
-            if(found) break;
         }
-#else
-        // Brute-force version, guaranteed to work.
-        for(auto f : CIter::functions(module)) {
-            found = ChunkFind().findInnermostAt(f, targetAddress);
-            if(found) break;
+        // Uncommon case for jumps: external jump to another function
+        // This can be for tail recursion or for overlapping functions
+        // (_nocancel), so check every function that reaches the target
+        for(size_t i = upper; !found && i > 0 && maxEnd[i - 1] > targetAddress;
+            i --) {
+
+            if(functionList[i - 1]->getRange().contains(targetAddress)) {
+                found = findInstruction(i - 1, targetAddress, false);
+                if(found) isExternal = true;
+            }
         }
-#endif
-        if(found && found != instruction->getParent()->getParent()) {
-            isExternal = true;
+
+        if(found) {
+            resolvedList.push_back(Resolved{instruction, found, isExternal});
         }
     }
+}
+
+Chunk *InternalCalls::findInstruction(size_t index, address_t target,
+    bool inside) {
+
+    auto &list = instructionList[index];
+    auto it = std::upper_bound(list.begin(), list.end(), target,
+        [] (address_t address, Instruction *instr)
+            { return address < instr->getAddress(); });
+    if(it == list.begin()) return nullptr;
+
+    auto instr = *(it - 1);
+    if(instr->getAddress() == target
+        || (inside && instr->getRange().contains(target))) {
+
+        return instr;
+    }
+    return nullptr;
+}
+
+void InternalCalls::makeLink(const Resolved &resolved) {
+    auto semantic = resolved.instruction->getSemantic();
+    auto link = semantic->getLink();
+    auto targetAddress = link->getTargetAddress();
+    auto found = resolved.found;
+    auto scope = resolved.isExternal
+        ? Link::SCOPE_EXTERNAL_JUMP : Link::SCOPE_INTERNAL_JUMP;
 
-    if(found) {
-        LOG(10, "FOUND [" << found->getName() << "]");
+    LOG(10, "Looking up target 0x" << std::hex << targetAddress
+        << " -> FOUND [" << found->getName() << "]");
 #ifdef ARCH_X86_64
-        auto offset = targetAddress - found->getAddress();
-        if(offset == 0) {
-            semantic->setLink(new NormalLink(found, isExternal
-                ? Link::SCOPE_EXTERNAL_JUMP : Link::SCOPE_INTERNAL_JUMP));
-        }
-        else {
-            auto i = dynamic_cast<Instruction *>(found);
-            if(i && offset == 1) {
-                InstrWriterGetData writer;
-                i->getSemantic()->accept(&writer);
-                if(static_cast<unsigned char>(writer.get()[0]) == 0xf0) {
-                    // jumping by skipping the "LOCK" prefix
-                    semantic->setLink(new OffsetLink(found, 1, isExternal
-                        ? Link::SCOPE_EXTERNAL_JUMP : Link::SCOPE_INTERNAL_JUMP));
-                }
-                else {
-                    LOG(1, "WARNING: unknown prefix when jumping into "
-                        "the middle of an instruction!");
-                    return;  // skip delete link
-                }
+    auto offset = targetAddress - found->getAddress();
+    if(offset == 0) {
+        semantic->setLink(new NormalLink(found, scope));
+    }
+    else {
+        auto i = dynamic_cast<Instruction *>(found);
+        if(i && offset == 1) {
+            InstrWriterGetData writer;
+            i->getSemantic()->accept(&writer);
+            if(static_cast<unsigned char>(writer.get()[0]) == 0xf0) {
+                // jumping by skipping the "LOCK" prefix
+                semantic->setLink(new OffsetLink(found, 1, scope));
             }
             else {
-                LOG(1, "WARNING: jumping into the middle of an instruction"
-                    " in unknown manner!");
+                LOG(1, "WARNING: unknown prefix when jumping into "
+                    "the middle of an instruction!");
                 return;  // skip delete link
             }
         }
+        else {
+            LOG(1, "WARNING: jumping into the middle of an instruction"
+                " in unknown manner!");
+            return;  // skip delete link
+        }
+    }
 #else
-        semantic->setLink(new NormalLink(found, isExternal
-            ? Link::SCOPE_EXTERNAL_JUMP : Link::SCOPE_INTERNAL_JUMP));
+    semantic->setLink(new NormalLink(found, scope));
 #endif
-        delete link;
-    }
-    else {
-        LOG(10, "NOT FOUND!");
-    }
+    delete link;
 }
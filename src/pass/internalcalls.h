@@ -1,15 +1,34 @@
 #ifndef EGALITO_INTERNAL_CALLS_H
 #define EGALITO_INTERNAL_CALLS_H
 
+#include <vector>
 #include "chunkpass.h"
 
+/** Resolves ControlFlowInstruction Links that have no target yet to a
+    Function or Instruction in the same Module.
+
+    Targets are looked up in parallel, one Function per thread, against
+    address-sorted lists of the Module's Functions and their Instructions
+    that are built beforehand and not modified during the lookup. The new
+    Links are then set serially, in instruction order.
+*/
 class InternalCalls : public ChunkPass {
 private:
-    FunctionList *functionList;
+    struct Resolved {
+        Instruction *instruction;
+        Chunk *found;
+        bool isExternal;
+    };
+    std::vector<Function *> functionList;  // sorted by address
+    std::vector<address_t> maxEnd;  // highest end among functions [0, i]
+    std::vector<std::vector<Instruction *>> instructionList;
 public:
-    InternalCalls() : functionList(nullptr) {}
     virtual void visit(Module *module);
-    virtual void visit(Instruction *instruction);
+private:
+    void buildIndex(Module *module);
+    void resolve(size_t index, std::vector<Resolved> &resolvedList);
+    Chunk *findInstruction(size_t index, address_t target, bool inside);
+    void makeLink(const Resolved &resolved);
 };
 
 #endif
@@ -13,6 +13,8 @@
 #include "operation/mutator.h"
 #include "cminus/print.h"
 #include "snippet/hook.h"
+#include "runtime/hotpatch.h"
+#include "runtime/jitservice.h"
 #include "runtime/managegs.h"
 #include "transform/generator.h"
 #include "transform/sandbox.h"
@@ -22,11 +24,18 @@
 #include "log/log.h"
 
 Chunk *egalito_gsCallback __attribute__((weak));
+bool egalito_jit_async __attribute__((weak));
 
 extern "C"
 size_t egalito_jit_gs_fixup(size_t offset) {
     auto gsTable = EgalitoTLS::getGSTable();
+    ManageGS::quiesce(gsTable);
+    auto service = EgalitoTLS::getJITService();
+    if(service) service->poll();
+    HotPatchService::GenerateLock lock;
+
     size_t index = gsTable->offsetToIndex(offset);
+    if(service) service->recordHit(index);
     //egalito_printf("index=%d\n", (int)index);
     //egalito_printf("(JIT-fixup index=%d ", (int)index);
 
@@ -72,6 +81,11 @@ size_t egalito_jit_gs_fixup(size_t offset) {
 
 extern "C"
 void egalito_jit_gs_init(ShufflingSandbox *sandbox, GSTable *gsTable) {
+    HotPatchService::GenerateLock lock;
+    if(auto hotPatch = HotPatchService::getInstance()) {
+        gsTable->setPatchGeneration(hotPatch->getGeneration());
+    }
+
     sandbox->reopen();
     sandbox->recreate();
     Generator generator(sandbox, true);
@@ -95,6 +109,16 @@ void egalito_jit_gs_init(ShufflingSandbox *sandbox, GSTable *gsTable) {
     sandbox->finalize();
 }
 
+// after a staged epoch is published: the same as the end of
+// egalito_jit_gs_init(), only the region for functions generated on first
+// call is recycled
+static void egalito_jit_gs_recycle(ShufflingSandbox *sandbox) {
+    explicit_bzero(EgalitoTLS::getJITAddressTable(), JIT_TABLE_SIZE);
+    sandbox->reopen();
+    sandbox->recreate();
+    sandbox->finalize();
+}
+
 extern "C"
 void egalito_jit_gs_reset(void) {
 #if 0
@@ -105,6 +129,30 @@ void egalito_jit_gs_reset(void) {
     }
     t = new EgalitoTiming("from previous reset");
 #endif
+    // reached from a syscall hook, through the current entries
+    ManageGS::quiesce(EgalitoTLS::getGSTable());
+    auto service = EgalitoTLS::getJITService();
+    if(service) service->poll();
+
+    auto hotPatch = HotPatchService::getInstance();
+    if(hotPatch && hotPatch->isPending(EgalitoTLS::getGSTable())) {
+        // everything is regenerated once no patched function is live here
+        if(hotPatch->switchGeneration(EgalitoTLS::getGSTable(),
+            EgalitoTLS::getSandbox())) {
+
+            EgalitoTLS::setJITResetCounter(0);
+        }
+        return;
+    }
+
+    if(service && service->isForkPending()) {
+        // a forked child keeps its parent's layout until its own is staged
+        if(service->publishAfterFork()) {
+            egalito_jit_gs_recycle(EgalitoTLS::getSandbox());
+        }
+        return;
+    }
+
     auto counter = EgalitoTLS::getJITResetCounter();
     auto threshold = EgalitoTLS::getJITResetThreshold();
     counter++;
@@ -117,6 +165,16 @@ void egalito_jit_gs_reset(void) {
     auto sandbox = EgalitoTLS::getSandbox();
     auto gsTable = EgalitoTLS::getGSTable();
 
+    if(egalito_jit_async) {
+        service = JitGenerationService::getInstance(
+            gsTable, egalito_gsCallback);
+        service->recordHotEntries();
+        if(service->publish()) {
+            egalito_jit_gs_recycle(sandbox);
+            return;
+        }
+    }
+
     egalito_jit_gs_init(sandbox, gsTable);
 }
 
@@ -126,6 +184,10 @@ void egalito_jit_gs_setup_thread(void) {
     volatile size_t *barrier = EgalitoTLS::getBarrier();
     *barrier = 1;
     EgalitoTLS::setBarrier(nullptr);
+
+    if(auto hotPatch = HotPatchService::getInstance()) {
+        hotPatch->registerThread(EgalitoTLS::getGSTable());
+    }
 }
 
 JitGSFixup::JitGSFixup(Conductor *conductor, GSTable *gsTable)
@@ -153,6 +215,7 @@ void JitGSFixup::visit(Program *program) {
         "egalito_hook_jit_fixup", lib);
     assert(callback);
     ::egalito_gsCallback = callback;
+    ::egalito_jit_async = isFeatureEnabled("EGALITO_JIT_ASYNC");
 
     if(isFeatureEnabled("EGALITO_USE_SHUFFLING")) {
         addResetCalls();
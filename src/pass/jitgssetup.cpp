@@ -1,4 +1,5 @@
 #include <sys/mman.h>
+#include <pthread.h>
 #include <cctype>
 #include <cstring>
 #include <cassert>
@@ -10,6 +11,7 @@
 #include "instr/semantic.h"
 #include "instr/linked-x86_64.h"
 #include "operation/find2.h"
+#include "util/feature.h"
 #include "log/log.h"
 #include "log/temp.h"
 #include "cminus/print.h"
@@ -18,6 +20,8 @@
 #define JIT_RESET_THRESHOLD 1
 #endif
 
+extern "C" void egalito_pthread_atfork_child(void);
+
 extern "C"
 void egalito_jit_gs_setup() {
     auto base = mmap(NULL, JIT_TABLE_SIZE, PROT_READ|PROT_WRITE,
@@ -32,6 +36,10 @@ void egalito_jit_gs_setup() {
             target->setPositionIndex(Chunk::POSITION_JIT_GS);
         }
     }
+
+    if(isFeatureEnabled("EGALITO_JIT_FORK")) {
+        pthread_atfork(nullptr, nullptr, &egalito_pthread_atfork_child);
+    }
 }
 
 void JitGSSetup::visit(Program *program) {
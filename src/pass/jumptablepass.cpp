@@ -1,9 +1,11 @@
 #include <algorithm>
 #include <fstream>
 #include <cassert>
+#include <cstring>
 #include "jumptablepass.h"
 #include "analysis/jumptable.h"
 #include "analysis/jumptabledetection.h"
+#include "analysis/functioncache.h"
 #include "config.h"
 #include "chunk/jumptable.h"
 #include "chunk/link.h"
@@ -36,6 +38,8 @@ void JumpTablePass::visit(JumpTableList *jumpTableList) {
     //TemporaryLogLevel tll2("analysis", 10, module->getName() == "module-(executable)");
 
     JumptableDetection search(module);
+    FunctionAnalysisCache cache(module);
+    cache.restore(search);
     search.detect(module);
 
     auto count1 = search.getTableList().size();
@@ -48,6 +52,9 @@ void JumpTablePass::visit(JumpTableList *jumpTableList) {
         count1 = count2;
     }
 
+    // before the adjustment below, which is made again on every run
+    cache.save(search.getTableList());
+
 #ifdef ARCH_X86_64
     // we cannot detect all the bounds in hand written assembly functions
     // yet, which means we need to rely on the other jump table passes.
@@ -128,9 +135,22 @@ void JumpTablePass::makeJumpTable(JumpTableList *jumpTableList,
     }
 }
 
+template <typename EntryType>
+static void decodeEntries(const unsigned char *p, size_t stride,
+    std::vector<ptrdiff_t> &valueList) {
+
+    // a plain widening loop over fixed-size reads, which compilers vectorize
+    for(size_t i = 0; i < valueList.size(); i ++) {
+        EntryType value;
+        std::memcpy(&value, p + i*stride, sizeof(value));
+        valueList[i] = value;
+    }
+}
+
 size_t JumpTablePass::makeChildren(JumpTable *jumpTable, int count) {
     //auto elfMap = module->getElfSpace()->getElfMap();
     auto descriptor = jumpTable->getDescriptor();
+    if(count <= 0) return count;
 
     auto section = descriptor->getContentSection();
 
@@ -140,37 +160,47 @@ size_t JumpTablePass::makeChildren(JumpTable *jumpTable, int count) {
     auto tableReadPtr = module->getElfSpace()->getElfMap()
         ->getSectionReadPtr<unsigned char *>(elfSection);
 
+    // decode every entry before looking any of them up
+    auto scale = descriptor->getScale();
+    auto p = tableReadPtr + elfSection->convertVAToOffset(
+        jumpTable->getAddress());
+    std::vector<ptrdiff_t> valueList(count);
+    switch(scale) {
+    case 1:
+        decodeEntries<int8_t>(p, scale, valueList);
+        break;
+    case 2:
+        decodeEntries<int16_t>(p, scale, valueList);
+        break;
+    case 4:
+    default:
+        decodeEntries<int32_t>(p, scale, valueList);
+        break;
+    }
+
+    auto targetBase = descriptor->getTargetBaseLink()->getTargetAddress();
+    std::vector<address_t> targetList(count);
     for(int i = 0; i < count; i ++) {
-        auto address = jumpTable->getAddress() + i*descriptor->getScale();
-        address_t offset = elfSection->convertVAToOffset(address);
-        auto p = tableReadPtr + offset;
-        ptrdiff_t value;
-        switch(descriptor->getScale()) {
-        case 1:
-            value = *reinterpret_cast<int8_t *>(p);
-            break;
-        case 2:
-            value = *reinterpret_cast<int16_t *>(p);
-            break;
-        case 4:
-        default:
-            value = *reinterpret_cast<int32_t *>(p);
-            break;
-        }
+        ptrdiff_t value = valueList[i];
 #ifdef ARCH_AARCH64
         // We only see the scale of 4 for hand-crafted jump tables in
         // printf_positional of glibc. If this assumption does not hold,
         // we should add another field to the descriptor.
-        if(descriptor->getScale() != 4) {
+        if(scale != 4) {
             value *= 4;
         }
 #endif
-        auto targetBase = descriptor->getTargetBaseLink()->getTargetAddress();
-        address_t target = targetBase + value;
+        targetList[i] = targetBase + value;
+    }
+
+    auto innerList = findTargets(descriptor->getFunction(), targetList);
+
+    for(int i = 0; i < count; i ++) {
+        auto address = jumpTable->getAddress() + i*scale;
+        auto target = targetList[i];
         LOG(2, "    jump table entry " << i << " @ 0x" << std::hex << target);
 
-        Chunk *inner = ChunkFind().findInnermostInsideInstruction(
-            module->getFunctionList(), target);
+        Chunk *inner = innerList[i];
         Link *link = nullptr;
         if(inner) {
             LOG(3, "        resolved to " << std::hex << inner->getName());
@@ -183,7 +213,7 @@ size_t JumpTablePass::makeChildren(JumpTable *jumpTable, int count) {
         }
 
         auto var = DataVariable::create(section, address, link, nullptr);
-        var->setSize(descriptor->getScale());
+        var->setSize(scale);
 
         auto entry = new JumpTableEntry(var);
         entry->setPosition(PositionFactory::getInstance()
@@ -193,6 +223,50 @@ size_t JumpTablePass::makeChildren(JumpTable *jumpTable, int count) {
     return count;
 }
 
+std::vector<Chunk *> JumpTablePass::findTargets(Function *function,
+    const std::vector<address_t> &targetList) {
+
+    // Entries almost always point into the function that does the jump.
+    // Sweep its instructions once in address order rather than building
+    // spatial maps for each of its blocks.
+    std::vector<Chunk *> innerList(targetList.size());
+    std::vector<Instruction *> instructionList;
+    if(function) {
+        for(auto block : CIter::children(function)) {
+            for(auto instr : CIter::children(block)) {
+                instructionList.push_back(instr);
+            }
+        }
+        std::sort(instructionList.begin(), instructionList.end(),
+            [] (Instruction *a, Instruction *b)
+                { return a->getAddress() < b->getAddress(); });
+    }
+
+    std::vector<size_t> order(targetList.size());
+    for(size_t i = 0; i < order.size(); i ++) order[i] = i;
+    std::sort(order.begin(), order.end(), [&targetList] (size_t a, size_t b)
+        { return targetList[a] < targetList[b]; });
+
+    auto functionSpatial = CIter::spatial(module->getFunctionList());
+    size_t next = 0;
+    for(auto i : order) {
+        auto target = targetList[i];
+        while(next < instructionList.size()
+            && instructionList[next]->getAddress() <= target) next ++;
+
+        if(next > 0 && instructionList[next - 1]->getRange().contains(target)
+            && functionSpatial->findContaining(target) == function) {
+
+            innerList[i] = instructionList[next - 1];
+        }
+        else {
+            innerList[i] = ChunkFind().findInnermostInsideInstruction(
+                module->getFunctionList(), target);
+        }
+    }
+    return innerList;
+}
+
 void JumpTablePass::saveToFile() const {
 #ifdef CACHE_DIR
     if(module->getName() == "module-(executable)") return;
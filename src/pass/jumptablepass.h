@@ -2,6 +2,7 @@
 #define EGALITO_PASS_JUMP_TABLE_PASS_H
 
 #include <map>
+#include <vector>
 #include "chunkpass.h"
 
 /** Constructs jump table data structures in the given Module. */
@@ -22,6 +23,8 @@ public:
 private:
     void makeJumpTable(JumpTableList *jumpTableList,
         const std::vector<JumpTableDescriptor *> &tables);
+    std::vector<Chunk *> findTargets(Function *function,
+        const std::vector<address_t> &targetList);
     void saveToFile() const;
     bool loadFromFile(JumpTableList *jumpTableList);
 };
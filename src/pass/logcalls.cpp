@@ -8,6 +8,7 @@
 #include "disasm/disassemble.h"
 #include "cminus/print.h"
 #include "pass/switchcontext.h"
+#include "runtime/calltrace.h"
 #include "snippet/hook.h"
 #include "log/log.h"
 
@@ -17,6 +18,8 @@ extern bool egalito_init_done;
 
 extern "C"
 void egalito_log_function_name(unsigned long address, int dir) {
+    if(CallTracer::record(address, dir)) return;
+
     indent += dir;
     //for(int i = 0; i < indent; i ++) egalito_printf("    ");
     egalito_printf("%d ", indent);
@@ -0,0 +1,162 @@
+#include <set>
+#include <algorithm>  // for std::none_of
+#include <capstone/capstone.h>
+#include "loopalign.h"
+#include "promotejumps.h"
+#include "shortenjumps.h"
+#include "analysis/analysiscache.h"
+#include "analysis/controlflow.h"
+#include "analysis/dominance.h"
+#include "chunk/concrete.h"
+#include "instr/concrete.h"
+#include "instr/template.h"
+#include "operation/mutator.h"
+#include "log/log.h"
+
+// padding moves jumps in and out of rel8 range, which moves the loop heads
+// again; this is only a bound, layouts normally settle in two rounds
+#define MAX_ROUNDS  8
+
+void LoopAlignPass::visit(Program *program) {
+    recurse(program);
+    LOG(1, "aligned " << std::dec << alignedCount << " loop heads to "
+        << alignment << " bytes");
+}
+
+void LoopAlignPass::visit(Function *function) {
+#ifdef ARCH_X86_64
+    if(function->getChildren()->getIterable()->getCount() == 0) return;
+
+    std::vector<Block *> headList;
+    for(auto head : findLoopHeads(function)) {
+        auto before = dynamic_cast<Block *>(head->getPreviousSibling());
+        if(before && !hasFallThrough(before)) headList.push_back(head);
+    }
+    if(headList.empty()) return;
+
+    bool stable = false;
+    for(int round = 0; round < MAX_ROUNDS && !stable; round ++) {
+        bool changed = false;
+        for(auto head : headList) {
+            if(updatePadding(function, head)) changed = true;
+        }
+
+        auto modification = function->getModificationCount();
+        PromoteJumpsPass promoteJumps;
+        function->accept(&promoteJumps);
+        ShortenJumpsPass shortenJumps;
+        function->accept(&shortenJumps);
+        stable = !changed && function->getModificationCount() == modification;
+    }
+    if(!stable) {
+        LOG(1, "loop heads in [" << function->getName()
+            << "] did not settle, some may be misaligned");
+    }
+
+    if(function->getAlignment() < alignment) {
+        function->setAlignment(alignment);
+    }
+    alignedCount += headList.size();
+    LOG(10, "aligned " << headList.size() << " loop heads in ["
+        << function->getName() << "]");
+#endif
+}
+
+std::vector<Block *> LoopAlignPass::findLoopHeads(Function *function) {
+    auto analysis = AnalysisCache::getInstance()->get(function);
+    auto cfg = analysis->getCFG();
+    auto dominance = analysis->getDominance();
+
+    // natural loops: a back edge u->h, where h dominates u, and every node
+    // that reaches u without going through h
+    typedef ControlFlow::id_t id_t;
+    std::map<id_t, std::set<id_t>> loopMap;
+    const auto count = static_cast<id_t>(cfg->getCount());
+    for(id_t u = 0; u < count; u ++) {
+        for(auto h : cfg->getSuccessors(u)) {
+            if(!dominance->dominates(h, u)) continue;
+
+            auto &body = loopMap[h];
+            body.insert(h);
+            std::vector<id_t> stack{u};
+            while(!stack.empty()) {
+                auto node = stack.back();
+                stack.pop_back();
+                if(!body.insert(node).second) continue;
+                for(auto p : cfg->getPredecessors(node)) stack.push_back(p);
+            }
+        }
+    }
+
+    std::set<Block *> chosen;
+    for(const auto &loop : loopMap) {
+        auto head = cfg->get(loop.first)->getBlock();
+        if(blockCount) {
+            auto it = blockCount->find(head);
+            if(it == blockCount->end() || (*it).second == 0) continue;
+        }
+        else {
+            // without a profile, assume that the innermost loops are hot
+            bool innermost = std::none_of(loop.second.begin(),
+                loop.second.end(), [&loop, &loopMap] (id_t node)
+                    { return node != loop.first && loopMap.count(node); });
+            if(!innermost) continue;
+        }
+        chosen.insert(head);
+    }
+
+    std::vector<Block *> headList;
+    for(auto block : CIter::children(function)) {
+        if(chosen.count(block)) headList.push_back(block);
+    }
+    return headList;
+}
+
+bool LoopAlignPass::updatePadding(Function *function, Block *head) {
+    auto &padding = paddingMap[head];
+    size_t current = padding ? padding->getSize() : 0;
+    address_t offset = head->getAddress() - function->getAddress();
+    size_t needed = (alignment - ((offset - current) & (alignment - 1)))
+        & (alignment - 1);
+    if(needed == current) return false;
+
+    if(padding) {
+        ChunkMutator(function).remove(padding);
+        std::vector<Instruction *> nopList;
+        for(auto instr : CIter::children(padding)) nopList.push_back(instr);
+        for(auto instr : nopList) {
+            delete instr->getSemantic();
+            delete instr;
+        }
+        delete padding;
+        padding = nullptr;
+    }
+    if(needed == 0) return true;
+
+    // a block of its own, which nothing jumps to or falls into
+    padding = new Block();
+    ChunkMutator(function).insertAfter(head->getPreviousSibling(), padding);
+    ChunkMutator mutator(padding);
+    while(needed > 0) {
+        size_t size = needed < InstrTemplate::MAX_NOP_SIZE
+            ? needed : InstrTemplate::MAX_NOP_SIZE;
+        mutator.append(InstrTemplate::make(InstrTemplate::nop(size)));
+        needed -= size;
+    }
+    return true;
+}
+
+bool LoopAlignPass::hasFallThrough(Block *block) {
+#ifdef ARCH_X86_64
+    auto last = block->getChildren()->getIterable()->getLast();
+    if(!last) return true;
+
+    auto semantic = last->getSemantic();
+    if(dynamic_cast<ReturnInstruction *>(semantic)) return false;
+    if(dynamic_cast<IndirectJumpInstruction *>(semantic)) return false;
+    if(auto cfi = dynamic_cast<ControlFlowInstruction *>(semantic)) {
+        return cfi->getId() != X86_INS_JMP;
+    }
+#endif
+    return true;
+}
@@ -0,0 +1,50 @@
+#ifndef EGALITO_PASS_LOOP_ALIGN_H
+#define EGALITO_PASS_LOOP_ALIGN_H
+
+#include <map>
+#include <vector>
+#include <cstdint>
+#include "chunkpass.h"
+
+/** Aligns the heads of hot loops to a cache-line or fetch boundary.
+
+    Loops are found from back edges in the ControlFlowGraph: an edge whose
+    target dominates its source. With block counts (e.g. from
+    ReorderBlocksPass::getBlockCounts()), the heads of loops that executed
+    are aligned; otherwise only the innermost loops are, as the likeliest
+    to be hot.
+
+    Padding is only inserted where control never falls into it, as a block
+    of its own after one that ends in a jump or return, so a loop head
+    that is entered by fall-through is left alone. The padding is made of
+    multi-byte nops, so that disassemblers stay in sync. Each function
+    that got padding asks the Generator to align its start.
+
+    Jumps are promoted and shortened here until the layout stops changing,
+    so this should run after PromoteJumpsPass and ShortenJumpsPass, and
+    nothing that changes code size should run afterwards. This pass is
+    x86_64-specific; on other architectures it does nothing.
+*/
+class LoopAlignPass : public ChunkPass {
+private:
+    size_t alignment;
+    const std::map<Block *, uint64_t> *blockCount;
+    std::map<Block *, Block *> paddingMap;  // loop head to its padding
+    size_t alignedCount;
+public:
+    LoopAlignPass(size_t alignment = 32,
+        const std::map<Block *, uint64_t> *blockCount = nullptr)
+        : alignment(alignment), blockCount(blockCount), alignedCount(0) {}
+
+    virtual void visit(Program *program);
+    virtual void visit(Module *module) { recurse(module->getFunctionList()); }
+    virtual void visit(Function *function);
+
+    size_t getAlignedCount() const { return alignedCount; }
+private:
+    std::vector<Block *> findLoopHeads(Function *function);
+    bool updatePadding(Function *function, Block *head);
+    static bool hasFallThrough(Block *block);
+};
+
+#endif
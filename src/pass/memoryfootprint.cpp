@@ -0,0 +1,290 @@
+#include <iomanip>
+#include "memoryfootprint.h"
+#include "chunk/concrete.h"
+#include "chunk/link.h"
+#include "chunk/position.h"
+#include "instr/concrete.h"
+#include "instr/storage.h"
+#include "log/log.h"
+
+namespace {
+    /** Heap bytes owned by a string, zero if it is stored inline (SSO). */
+    size_t heapBytesOf(const std::string &s) {
+        auto begin = reinterpret_cast<const char *>(&s);
+        if(s.data() >= begin && s.data() < begin + sizeof(s)) return 0;
+        return s.capacity() + 1;
+    }
+
+    class SemanticSizer : public InstructionVisitor {
+    private:
+        size_t size;
+    public:
+        SemanticSizer() : size(0) {}
+        size_t getSize() const { return size; }
+
+        virtual void visit(IsolatedInstruction *semantic)
+            { size = sizeof(*semantic); }
+        virtual void visit(LinkedInstruction *semantic)
+            { size = sizeof(*semantic); }
+        virtual void visit(ControlFlowInstruction *semantic)
+            { size = sizeof(*semantic); }
+#ifdef ARCH_X86_64
+        virtual void visit(DataLinkedControlFlowInstruction *semantic)
+            { size = sizeof(*semantic); }
+#endif
+        virtual void visit(ReturnInstruction *semantic)
+            { size = sizeof(*semantic); }
+        virtual void visit(IndirectJumpInstruction *semantic)
+            { size = sizeof(*semantic) + heapBytesOf(semantic->getMnemonic()); }
+        virtual void visit(IndirectCallInstruction *semantic)
+            { size = sizeof(*semantic); }
+        virtual void visit(StackFrameInstruction *semantic)
+            { size = sizeof(*semantic); }
+        virtual void visit(LiteralInstruction *semantic)
+            { size = sizeof(*semantic); }
+        virtual void visit(LinkedLiteralInstruction *semantic)
+            { size = sizeof(*semantic); }
+    };
+}
+
+MemoryFootprintPass::Usage MemoryFootprintPass::getTotal(
+    const std::string &category) const {
+
+    Usage total;
+    for(const auto &module : moduleUsage) {
+        auto it = module.second.find(category);
+        if(it == module.second.end()) continue;
+        total.count += it->second.count;
+        total.bytes += it->second.bytes;
+    }
+    return total;
+}
+
+size_t MemoryFootprintPass::getTotalBytes() const {
+    size_t total = 0;
+    for(const auto &module : moduleUsage) {
+        for(const auto &category : module.second) {
+            total += category.second.bytes;
+        }
+    }
+    return total;
+}
+
+void MemoryFootprintPass::dump() const {
+    for(const auto &module : moduleUsage) {
+        size_t moduleBytes = 0;
+        LOG(1, "memory footprint of [" << module.first << "]:");
+        for(const auto &category : module.second) {
+            LOG(1, "    " << std::left << std::setw(24) << category.first
+                << std::right << std::dec << std::setw(10)
+                << category.second.count << " objects"
+                << std::setw(12) << category.second.bytes << " bytes");
+            moduleBytes += category.second.bytes;
+        }
+        LOG(1, "    total " << std::dec << moduleBytes << " bytes");
+    }
+    LOG(1, "memory footprint total: " << std::dec << getTotalBytes()
+        << " bytes");
+}
+
+void MemoryFootprintPass::visit(Program *program) {
+    current = &moduleUsage["(program)"];
+    countChunk(program, "Program");
+
+    auto factory = AssemblyFactory::getInstance();
+    size_t assemblies = factory->getCacheSize();
+    auto &cache = moduleUsage["(assembly cache)"]["Assembly"];
+    cache.count += assemblies;
+    cache.bytes += assemblies * sizeof(Assembly);
+
+    recurse(program);
+}
+
+void MemoryFootprintPass::visit(Module *module) {
+    UsageMap *previous = current;
+    current = &moduleUsage[module->getName()];
+    countChunk(module, "Module");
+    recurse(module);
+    current = previous;
+}
+
+void MemoryFootprintPass::visit(FunctionList *functionList) {
+    countChunk(functionList, "FunctionList");
+    recurse(functionList);
+}
+
+void MemoryFootprintPass::visit(PLTList *pltList) {
+    countChunk(pltList, "PLTList");
+    recurse(pltList);
+}
+
+void MemoryFootprintPass::visit(JumpTableList *jumpTableList) {
+    countChunk(jumpTableList, "JumpTableList");
+    recurse(jumpTableList);
+}
+
+void MemoryFootprintPass::visit(DataRegionList *dataRegionList) {
+    countChunk(dataRegionList, "DataRegionList");
+    recurse(dataRegionList);
+}
+
+void MemoryFootprintPass::visit(VTableList *vtableList) {
+    countChunk(vtableList, "VTableList");
+    recurse(vtableList);
+}
+
+void MemoryFootprintPass::visit(InitFunctionList *initFunctionList) {
+    countChunk(initFunctionList, "InitFunctionList");
+    recurse(initFunctionList);
+}
+
+void MemoryFootprintPass::visit(ExternalSymbolList *externalSymbolList) {
+    countChunk(externalSymbolList, "ExternalSymbolList");
+    recurse(externalSymbolList);
+}
+
+void MemoryFootprintPass::visit(Function *function) {
+    countChunk(function, "Function");
+    recurse(function);
+}
+
+void MemoryFootprintPass::visit(Block *block) {
+    countChunk(block, "Block");
+    recurse(block);
+}
+
+void MemoryFootprintPass::visit(Instruction *instruction) {
+    countChunk(instruction, "Instruction");
+    if(auto semantic = instruction->getSemantic()) {
+        countSemantic(semantic);
+        countLink(semantic->getLink());
+    }
+}
+
+void MemoryFootprintPass::visit(PLTTrampoline *trampoline) {
+    countChunk(trampoline, "PLTTrampoline");
+}
+
+void MemoryFootprintPass::visit(JumpTable *jumpTable) {
+    countChunk(jumpTable, "JumpTable");
+    recurse(jumpTable);
+}
+
+void MemoryFootprintPass::visit(JumpTableEntry *jumpTableEntry) {
+    // the entry's Link belongs to its DataVariable, counted there
+    countChunk(jumpTableEntry, "JumpTableEntry");
+}
+
+void MemoryFootprintPass::visit(DataRegion *dataRegion) {
+    countChunk(dataRegion, "DataRegion");
+    recurse(dataRegion);
+}
+
+void MemoryFootprintPass::visit(DataSection *dataSection) {
+    countChunk(dataSection, "DataSection");
+    recurse(dataSection);
+}
+
+void MemoryFootprintPass::visit(DataVariable *dataVariable) {
+    countChunk(dataVariable, "DataVariable");
+    countLink(dataVariable->getDest());
+}
+
+void MemoryFootprintPass::visit(GlobalVariable *globalVariable) {
+    countChunk(globalVariable, "GlobalVariable");
+}
+
+void MemoryFootprintPass::visit(MarkerList *markerList) {
+    countChunk(markerList, "MarkerList");
+}
+
+void MemoryFootprintPass::visit(VTable *vtable) {
+    countChunk(vtable, "VTable");
+    recurse(vtable);
+}
+
+void MemoryFootprintPass::visit(VTableEntry *vtableEntry) {
+    countChunk(vtableEntry, "VTableEntry");
+    countLink(vtableEntry->getLink());
+}
+
+void MemoryFootprintPass::visit(InitFunction *initFunction) {
+    countChunk(initFunction, "InitFunction");
+}
+
+void MemoryFootprintPass::visit(ExternalSymbol *externalSymbol) {
+    countChunk(externalSymbol, "ExternalSymbol");
+}
+
+template <typename Type>
+void MemoryFootprintPass::countChunk(Type *chunk, const char *type) {
+    (*current)[type].add(sizeof(Type));
+    countPosition(chunk->getPosition());
+}
+
+void MemoryFootprintPass::countPosition(Position *position) {
+    if(!position) return;
+
+    // most-derived types first
+    size_t size = sizeof(Position);
+    if(dynamic_cast<GenerationalOffsetPosition *>(position)) {
+        size = sizeof(GenerationalOffsetPosition);
+    }
+    else if(dynamic_cast<GenerationalSubsequentPosition *>(position)) {
+        size = sizeof(GenerationalSubsequentPosition);
+    }
+    else if(dynamic_cast<CachedOffsetPosition *>(position)) {
+        size = sizeof(CachedOffsetPosition);
+    }
+    else if(dynamic_cast<CachedSubsequentPosition *>(position)) {
+        size = sizeof(CachedSubsequentPosition);
+    }
+    else if(dynamic_cast<AbsolutePosition *>(position)) {
+        size = sizeof(TrackedPositionDecorator<AbsolutePosition>);
+    }
+    else if(dynamic_cast<OffsetPosition *>(position)) {
+        size = sizeof(OffsetPosition);
+    }
+    else if(dynamic_cast<AbsoluteOffsetPosition *>(position)) {
+        size = sizeof(AbsoluteOffsetPosition);
+    }
+    else if(dynamic_cast<SubsequentPosition *>(position)) {
+        size = sizeof(SubsequentPosition);
+    }
+    else if(dynamic_cast<SlotPosition *>(position)) {
+        size = sizeof(SlotPosition);
+    }
+    (*current)["Position"].add(size);
+}
+
+void MemoryFootprintPass::countLink(Link *link) {
+    if(!link) return;
+
+    size_t size = sizeof(LinkImpl);
+    if(dynamic_cast<NormalLink *>(link)) size = sizeof(NormalLink);
+    else if(dynamic_cast<AbsoluteNormalLink *>(link)) {
+        size = sizeof(AbsoluteNormalLink);
+    }
+    else if(dynamic_cast<OffsetLink *>(link)) size = sizeof(OffsetLink);
+    else if(dynamic_cast<PLTLink *>(link)) size = sizeof(PLTLink);
+    else if(dynamic_cast<InternalAndExternalDataLink *>(link)) {
+        size = sizeof(InternalAndExternalDataLink);
+    }
+    else if(dynamic_cast<DataOffsetLinkBase *>(link)) {
+        size = sizeof(DataOffsetLinkBase);
+    }
+    else if(dynamic_cast<ExternalSymbolLink *>(link)) {
+        size = sizeof(ExternalSymbolLink);
+    }
+    else if(dynamic_cast<ImmAndDispLink *>(link)) {
+        size = sizeof(ImmAndDispLink);
+    }
+    (*current)["Link"].add(size);
+}
+
+void MemoryFootprintPass::countSemantic(InstructionSemantic *semantic) {
+    SemanticSizer sizer;
+    semantic->accept(&sizer);
+    (*current)["Semantic"].add(sizer.getSize()
+        + heapBytesOf(semantic->getData()));
+}
@@ -0,0 +1,77 @@
+#ifndef EGALITO_PASS_MEMORY_FOOTPRINT_H
+#define EGALITO_PASS_MEMORY_FOOTPRINT_H
+
+#include <map>
+#include <string>
+#include "chunkpass.h"
+
+class Position;
+class Link;
+class InstructionSemantic;
+
+/** Estimates how much memory a Chunk tree uses, per Module.
+
+    Chunks are tallied by concrete type; their Positions, Links,
+    InstructionSemantics and Assemblies are tallied as separate categories.
+    Each object counts as sizeof() of the most-derived class recognized,
+    plus any out-of-line string storage that is reachable by reference, so
+    the totals are lower bounds (allocator headers, container slack and
+    name strings are not included). Assemblies are shared and owned by the
+    AssemblyFactory, so they are reported once, under "(assembly cache)".
+*/
+class MemoryFootprintPass : public ChunkPass {
+public:
+    struct Usage {
+        size_t count;
+        size_t bytes;
+        Usage() : count(0), bytes(0) {}
+        void add(size_t size) { count ++; bytes += size; }
+    };
+    typedef std::map<std::string, Usage> UsageMap;
+private:
+    std::map<std::string, UsageMap> moduleUsage;
+    UsageMap *current;
+public:
+    MemoryFootprintPass() : current(nullptr) {}
+
+    /** Module name -> category (chunk type, "Position", ...) -> usage. */
+    const std::map<std::string, UsageMap> &getUsage() const
+        { return moduleUsage; }
+    Usage getTotal(const std::string &category) const;
+    size_t getTotalBytes() const;
+    void dump() const;
+
+    virtual void visit(Program *program);
+    virtual void visit(Module *module);
+    virtual void visit(FunctionList *functionList);
+    virtual void visit(PLTList *pltList);
+    virtual void visit(JumpTableList *jumpTableList);
+    virtual void visit(DataRegionList *dataRegionList);
+    virtual void visit(VTableList *vtableList);
+    virtual void visit(InitFunctionList *initFunctionList);
+    virtual void visit(ExternalSymbolList *externalSymbolList);
+    virtual void visit(LibraryList *libraryList) {}
+    virtual void visit(Function *function);
+    virtual void visit(Block *block);
+    virtual void visit(Instruction *instruction);
+    virtual void visit(PLTTrampoline *trampoline);
+    virtual void visit(JumpTable *jumpTable);
+    virtual void visit(JumpTableEntry *jumpTableEntry);
+    virtual void visit(DataRegion *dataRegion);
+    virtual void visit(DataSection *dataSection);
+    virtual void visit(DataVariable *dataVariable);
+    virtual void visit(GlobalVariable *globalVariable);
+    virtual void visit(MarkerList *markerList);
+    virtual void visit(VTable *vtable);
+    virtual void visit(VTableEntry *vtableEntry);
+    virtual void visit(InitFunction *initFunction);
+    virtual void visit(ExternalSymbol *externalSymbol);
+private:
+    template <typename Type>
+    void countChunk(Type *chunk, const char *type);
+    void countPosition(Position *position);
+    void countLink(Link *link);
+    void countSemantic(InstructionSemantic *semantic);
+};
+
+#endif
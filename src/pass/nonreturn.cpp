@@ -1,10 +1,13 @@
 #include "nonreturn.h"
+#include "analysis/analysiscache.h"
+#include "analysis/call.h"
 #include "analysis/controlflow.h"
 #include "analysis/dominance.h"
 #include "analysis/usedef.h"
 #include "analysis/usedefutil.h"
 #include "analysis/walker.h"
 #include "chunk/concrete.h"
+#include "chunk/plt.h"
 #ifdef ARCH_X86_64
     #include "instr/linked-x86_64.h"
 #endif
@@ -30,16 +33,120 @@ const std::vector<std::string> NonReturnFunction::knownList = {
     "_ZSt24__throw_invalid_argumentPKc"
 };
 
-void NonReturnFunction::visit(FunctionList *functionList) {
-    size_t size = 0;
+void NonReturnFunction::visit(Program *program) {
+    // PLT targets are resolved by now, so facts cross module boundaries
+    CallGraph graph(program);
+    for(const auto &scc : graph.getSCCList()) {
+        visitSCC(scc);
+    }
+}
 
+void NonReturnFunction::visit(FunctionList *functionList) {
     //TemporaryLogLevel tll("pass", 10);
     //TemporaryLogLevel tll2("analysis", 10);
 
+    if(useWorklist) {
+        runWorklist(functionList);
+        return;
+    }
+
+    for(const auto &scc : getSCCOrder(functionList)) {
+        visitSCC(scc);
+    }
+}
+
+void NonReturnFunction::visitSCC(const std::vector<Function *> &scc) {
+    // Callees in earlier SCCs are already settled. Within an SCC, another
+    // round is only needed if one of its functions became non-returning,
+    // so this runs at most once more than the SCC has functions.
+    size_t size = 0;
     do {
         size = nonReturnList.size();
-        recurse(functionList);
-    } while(size != nonReturnList.size());
+        for(auto function : scc) {
+            function->accept(this);
+        }
+    } while(scc.size() > 1 && size != nonReturnList.size());
+}
+
+void NonReturnFunction::runWorklist(FunctionList *functionList) {
+    auto callers = getCallers(functionList);
+
+    std::vector<Function *> worklist;
+    std::set<Function *> queued;
+    for(const auto &scc : getSCCOrder(functionList)) {
+        for(auto function : scc) {
+            if(changedList.count(function)) {
+                worklist.push_back(function);
+                queued.insert(function);
+            }
+        }
+    }
+
+    // a function that becomes non-returning can only change its callers
+    for(size_t i = 0; i < worklist.size(); i ++) {
+        auto function = worklist[i];
+        queued.erase(function);
+        if(!function->returns()) continue;
+
+        function->accept(this);
+        if(function->returns()) continue;
+
+        for(auto caller : callers[function]) {
+            if(queued.insert(caller).second) worklist.push_back(caller);
+        }
+    }
+    LOG(10, "NonReturnFunction visited " << std::dec << worklist.size()
+        << " functions from " << changedList.size() << " changed");
+}
+
+std::map<Function *, std::vector<Function *>> NonReturnFunction::getCallers(
+    FunctionList *functionList) {
+
+    std::map<Function *, std::vector<Function *>> callers;
+    for(auto function : CIter::children(functionList)) {
+        std::set<Function *> seen;
+        for(auto block : CIter::children(function)) {
+            for(auto instr : CIter::children(block)) {
+                auto cfi = dynamic_cast<ControlFlowInstruction *>(
+                    instr->getSemantic());
+                if(!cfi || !cfi->getLink()) continue;
+
+                auto target = dynamic_cast<Function *>(
+                    &*cfi->getLink()->getTarget());
+                if(target && seen.insert(target).second) {
+                    callers[target].push_back(function);
+                }
+            }
+        }
+    }
+    return callers;
+}
+
+std::vector<std::vector<Function *>> NonReturnFunction::getSCCOrder(
+    FunctionList *functionList) {
+
+    std::vector<std::vector<Function *>> order;
+    auto module = dynamic_cast<Module *>(functionList->getParent());
+    auto program = module
+        ? dynamic_cast<Program *>(module->getParent()) : nullptr;
+    if(!program) {
+        // without a call graph, treat everything as one SCC
+        order.emplace_back();
+        for(auto function : CIter::children(functionList)) {
+            order.back().push_back(function);
+        }
+        return order;
+    }
+
+    CallGraph graph(program);
+    for(const auto &scc : graph.getSCCList()) {
+        std::vector<Function *> local;
+        for(auto function : scc) {
+            if(function->getParent() == functionList) local.push_back(function);
+        }
+        if(!local.empty()) order.push_back(std::move(local));
+    }
+    return order;
 }
 
 // Since Dominance requires an exit node to be spotted in the control flow
@@ -62,6 +169,7 @@ void NonReturnFunction::visit(Function *function) {
                     LOG(10, "non-returning call at "
                         << std::hex << instr->getAddress());
                     cfi->setNonreturn();
+                    function->markModified();  // changes the CFG
                     continue;
                 }
 
@@ -73,14 +181,8 @@ void NonReturnFunction::visit(Function *function) {
     }
 
     if(!GNUErrorCalls.empty()) {
-        ControlFlowGraph cfg(function);
-        UDConfiguration config(&cfg);
-        UDRegMemWorkingSet working(function, &cfg);
-        UseDef usedef(&config, &working);
-
-        SccOrder order(&cfg);
-        order.genFull(0);
-        usedef.analyze(order.get());
+        auto analysis = AnalysisCache::getInstance()->get(function);
+        auto &working = *analysis->getWorkingSet();
 
         for(auto instr : GNUErrorCalls) {
             bool found;
@@ -92,6 +194,7 @@ void NonReturnFunction::visit(Function *function) {
                 auto cfi = dynamic_cast<ControlFlowInstruction *>(
                     instr->getSemantic());
                 cfi->setNonreturn();
+                function->markModified();
             }
         }
     }
@@ -105,16 +208,17 @@ void NonReturnFunction::visit(Function *function) {
 }
 
 bool NonReturnFunction::neverReturns(Function *function) {
-    ControlFlowGraph *cfg = nullptr;
-    Dominance *dom = nullptr;
+    std::shared_ptr<FunctionAnalysis> analysis;
     for(auto block : CIter::children(function)) {
         for(auto instr : CIter::children(block)) {
             if(auto cfi = dynamic_cast<ControlFlowInstruction *>(
                 instr->getSemantic())) {
 
                 if(!cfi->returns()) {
-                    if(!cfg) cfg = new ControlFlowGraph(function);
-                    //ControlFlowGraph cfg(function);
+                    if(!analysis) {
+                        analysis = AnalysisCache::getInstance()->get(function);
+                    }
+                    auto cfg = analysis->getCFG();
                     LOG(11, "--Function " << function->getName());
                     IF_LOG(11) {
                         ChunkDumper dump;
@@ -123,23 +227,17 @@ bool NonReturnFunction::neverReturns(Function *function) {
                         cfg->dumpDot();
                         std::cout.flush();
                     }
-                    //Dominance dom(cfg);
-                    if(!dom) dom = new Dominance(cfg);
-                    auto pdom = dom->getPostDominators(0);
+                    auto pdom = analysis->getDominance()->getPostDominators(0);
                     auto nid = cfg->getIDFor(block);
                     if(std::find(pdom.begin(), pdom.end(), nid) == pdom.end()) {
                         continue;
                     }
 
-                    delete cfg;
-                    delete dom;
                     return true;
                 }
             }
         }
     }
-    delete cfg;
-    delete dom;
     return false;
 }
 
@@ -152,6 +250,11 @@ bool NonReturnFunction::hasLinkToNeverReturn(ControlFlowInstruction *cfi) {
                 return true;
             }
         }
+
+        // resolved into another module that has been analyzed already
+        if(auto target = dynamic_cast<Function *>(trampoline->getTarget())) {
+            if(!target->returns()) return true;
+        }
     }
     else if(auto target = dynamic_cast<Function *>(
         &*cfi->getLink()->getTarget())) {
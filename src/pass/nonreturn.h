@@ -2,21 +2,45 @@
 #define EGALITO_PASS_NONRETURN_H
 
 #include <set>
+#include <map>
+#include <vector>
 #include "chunkpass.h"
 
 class ControlFlowInstruction;
 class UDState;
 
+/** Finds functions that never return and marks calls to them.
+
+    Functions are visited in bottom-up SCC order of the call graph, so
+    each is analyzed once, or a few times if it is part of a cycle. Run on
+    the Program after PLT resolution, non-returning functions in one
+    module are also seen through PLT calls from other modules.
+
+    Constructed with a set of changed functions, only those are revisited,
+    followed by the callers of any function that becomes non-returning;
+    functions outside the worklist keep their earlier result.
+*/
 class NonReturnFunction : public ChunkPass {
 private:
     const static std::vector<std::string> knownList;
     std::set<Function *> nonReturnList;
+    std::set<Function *> changedList;
+    bool useWorklist;
 
 public:
-    NonReturnFunction() {}
+    NonReturnFunction() : useWorklist(false) {}
+    NonReturnFunction(const std::set<Function *> &changedList)
+        : changedList(changedList), useWorklist(true) {}
+    virtual void visit(Program *program);
     virtual void visit(FunctionList *functionList);
     virtual void visit(Function *function);
 private:
+    void visitSCC(const std::vector<Function *> &scc);
+    void runWorklist(FunctionList *functionList);
+    std::map<Function *, std::vector<Function *>> getCallers(
+        FunctionList *functionList);
+    std::vector<std::vector<Function *>> getSCCOrder(
+        FunctionList *functionList);
     bool neverReturns(Function *function);
     bool hasLinkToNeverReturn(ControlFlowInstruction *cfi);
     bool inList(Function *function);
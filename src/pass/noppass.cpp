@@ -1,9 +1,15 @@
 #include "noppass.h"
 #include "disasm/disassemble.h"
 #include "instr/concrete.h"
+#include "instr/template.h"
 #include "operation/mutator.h"
 #include "log/log.h"
 
+void NopPass::visit(Function *function) {
+    ChunkMutator::Batch batch;
+    recurse(function);
+}
+
 void NopPass::visit(Block *block) {
 #ifdef ARCH_X86_64
     ChunkMutator mutator(block);
@@ -13,7 +19,8 @@ void NopPass::visit(Block *block) {
     if(instructionCount > 0) {
         while (instructionCount--) {
             auto instruction = block->getChildren()->getIterable()->get(instructionIndex);
-            mutator.insertAfter(instruction, Disassemble::instruction({0x90}));
+            mutator.insertAfter(instruction,
+                InstrTemplate::make(InstrTemplate::nop()));
             // increment by 2 to avoid processing the nop instruction
             instructionIndex += 2;
         }
@@ -6,6 +6,7 @@
 /** Adds nop instruction before every instruction. */
 class NopPass : public ChunkPass {
 public:
+    virtual void visit(Function *function);
     virtual void visit(Block *block);
 };
 
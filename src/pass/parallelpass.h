@@ -0,0 +1,77 @@
+#ifndef EGALITO_PASS_PARALLEL_PASS_H
+#define EGALITO_PASS_PARALLEL_PASS_H
+
+#include <vector>
+#include <functional>
+#include <type_traits>
+#include "chunkpass.h"
+#include "util/threadpool.h"
+
+/** Base class for passes whose visit(Function *) only touches state local
+    to that function, which lets RUN_PASS_PARALLEL spread the functions of
+    a Module across threads.
+
+    The executor constructs a fresh pass object for every Function, so
+    member variables act as per-function scratch space; visit(Module *)
+    and other non-function visitors are not called. A change that reaches
+    outside the current function (adding a Function to the Module, say)
+    must be queued with defer(). Deferred changes are applied on one
+    thread after all functions are done, in function order, so the result
+    does not depend on scheduling.
+
+    Such passes still work as normal ChunkPasses with RUN_PASS, in which
+    case deferred changes are applied straight away.
+*/
+class ParallelChunkPass : public ChunkPass {
+public:
+    typedef std::function<void ()> DeferredChange;
+private:
+    bool deferring;
+    std::vector<DeferredChange> deferredList;
+public:
+    ParallelChunkPass() : deferring(false) {}
+
+    void setDeferring(bool deferring) { this->deferring = deferring; }
+    std::vector<DeferredChange> takeDeferred()
+        { return std::move(deferredList); }
+protected:
+    void defer(const DeferredChange &change)
+        { if(deferring) deferredList.push_back(change); else change(); }
+};
+
+/** Runs a ParallelChunkPass over only the given functions, e.g. a worklist
+    of functions whose facts changed since the pass last ran.
+*/
+template <typename PassType, typename MakePass>
+void runParallelChunkPass(const std::vector<Function *> &functionList,
+    MakePass makePass) {
+
+    static_assert(std::is_base_of<ParallelChunkPass, PassType>::value,
+        "RUN_PASS_PARALLEL requires a ParallelChunkPass");
+
+    std::vector<std::vector<ParallelChunkPass::DeferredChange>> deferred(
+        functionList.size());
+    ThreadPool pool;
+    pool.parallelFor(functionList.size(), [&] (size_t i) {
+        PassType pass = makePass();
+        pass.setDeferring(true);
+        functionList[i]->accept(&pass);
+        deferred[i] = pass.takeDeferred();
+    });
+
+    // barrier: apply module-level side effects serially
+    for(auto &list : deferred) {
+        for(auto &change : list) change();
+    }
+}
+
+template <typename PassType, typename MakePass>
+void runParallelChunkPass(Module *module, MakePass makePass) {
+    std::vector<Function *> functionList;
+    for(auto function : CIter::functions(module)) {
+        functionList.push_back(function);
+    }
+    runParallelChunkPass<PassType>(functionList, makePass);
+}
+
+#endif
@@ -0,0 +1,81 @@
+#include "perfcount.h"
+#include "chunk/concrete.h"
+#include "chunk/initfunction.h"
+#include "operation/find2.h"
+#include "pass/instrumentcalls.h"
+#include "log/log.h"
+
+#define NAME_REGION_ADDRESS     0x33000000
+#define NAME_SECTION_NAME       ".perfcount.names"
+
+void PerfCountPass::visit(Program *program) {
+    auto enter = ChunkFind2(program).findFunction("egalito_perfcount_enter");
+    auto exit = ChunkFind2(program).findFunction("egalito_perfcount_exit");
+    auto save = ChunkFind2(program).findFunction("egalito_perfcount_save");
+    if(!enter || !exit || !save) {
+        LOG(0, "PerfCountPass: libperfcount.so not found, not instrumenting");
+        return;
+    }
+
+    // the advice saves registers itself, no SwitchContextPass needed
+    InstrumentCallsPass instrument;
+    instrument.setEntryAdvice(enter);
+    instrument.setExitAdvice(exit);
+    instrument.setPredicate(&PerfCountPass::shouldInstrument);
+    instrument.setIndexedAdvice(true);
+    program->accept(&instrument);
+
+    auto module = program->getMain();
+    auto nameSection = createNameSection(module);
+    for(auto function : instrument.getIndexList()) {
+        appendFunctionName(nameSection, function->getName());
+    }
+    LOG(1, "perfcount: instrumented " << instrument.getIndexList().size()
+        << " functions");
+
+    auto finiFunction = new InitFunction(false, save);
+    module->getFiniFunctionList()->getChildren()->add(finiFunction);
+    finiFunction->setParent(module->getFiniFunctionList());
+}
+
+bool PerfCountPass::shouldInstrument(Function *function) {
+    auto module = static_cast<Module *>(function->getParent()->getParent());
+    if(module->getLibrary()->getRole() == Library::ROLE_EXTRA) return false;
+
+    if(function->getName() == "_init") return false;
+    if(function->getName() == "_fini") return false;
+    if(function->getName() == "__libc_csu_init") return false;
+    if(function->getName() == "__libc_csu_fini") return false;
+    return true;
+}
+
+DataSection *PerfCountPass::createNameSection(Module *module) {
+    auto regionList = module->getDataRegionList();
+    auto region = new DataRegion(NAME_REGION_ADDRESS);
+    region->setPosition(new AbsolutePosition(NAME_REGION_ADDRESS));
+    regionList->getChildren()->add(region);
+    region->setParent(regionList);
+
+    auto section = new DataSection();
+    section->setName(NAME_SECTION_NAME);
+    section->setAlignment(0x1);
+    section->setPermissions(SHF_ALLOC);
+    section->setPosition(new AbsoluteOffsetPosition(section, 0));
+    section->setType(DataSection::TYPE_DATA);
+    region->getChildren()->add(section);
+    section->setParent(region);
+
+    return section;
+}
+
+void PerfCountPass::appendFunctionName(DataSection *nameSection,
+    const std::string &name) {
+
+    auto region = static_cast<DataRegion *>(nameSection->getParent());
+    region->setSize(region->getSize() + name.length() + 1);
+    nameSection->setSize(nameSection->getSize() + name.length() + 1);
+
+    auto bytes = region->getDataBytes();
+    bytes.append(name.c_str(), name.length() + 1);
+    region->saveDataBytes(bytes);
+}
@@ -0,0 +1,27 @@
+#ifndef EGALITO_PASS_PERF_COUNT_H
+#define EGALITO_PASS_PERF_COUNT_H
+
+#include <string>
+#include "chunkpass.h"
+#include "chunk/dataregion.h"
+
+/** Reads hardware performance counters (cycles, iTLB misses, L1i misses
+    and branch misses) around every function call, using the advice in
+    libperfcount.so, which must already be parsed as an extra library.
+
+    InstrumentCallsPass adds the entry and exit advice, passing each
+    function's index. The function names are stored in index order in a
+    .perfcount.names section of the main module, and the library appends
+    its per-function totals to perfcount.data at exit, where etprofile
+    finds them. Only x86_64 is supported.
+*/
+class PerfCountPass : public ChunkPass {
+public:
+    virtual void visit(Program *program);
+private:
+    static bool shouldInstrument(Function *function);
+    DataSection *createNameSection(Module *module);
+    void appendFunctionName(DataSection *nameSection, const std::string &name);
+};
+
+#endif
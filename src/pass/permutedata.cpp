@@ -1,6 +1,8 @@
 #include <cassert>
+#include <algorithm>
 #include <typeinfo>
 
+#include "analysis/dataprofile.h"
 #include "chunk/concrete.h"
 #include "instr/linked.h"
 
@@ -57,6 +59,9 @@ void PermuteDataPass::visit(Module *module) {
     // in the same function, treat them as one (i.e. remove the split point)
     std::set<GlobalVariable *> ignore;
 
+    buildGlobalIndex(module);
+    references.clear();
+
     LOG(1, "Searching for adjacent variable accesses.");
     for(auto &func : CIter::children(module->getFunctionList())) {
         LOG(1, "\tin function " << func->getName());
@@ -69,17 +74,12 @@ void PermuteDataPass::visit(Module *module) {
                 if(!li) continue;
                 auto link = li->getLink();
                 if(!link) continue;
+                if(referencesSection(link)) references.push_back(li);
                 address_t taddress = link->getTargetAddress();
 
                 if(/*auto dol = */dynamic_cast<DataOffsetLink *>(link)) {
-                    // TODO: more efficient way of doing this...
-                    for(auto dr : CIter::children(module->getDataRegionList())) {
-                        for(auto ds : CIter::children(dr)) {
-                            for(auto gv : ds->getGlobalVariables()) {
-                                if(gv->getRange().contains(taddress)) 
-                                    touched[link->getTargetAddress()] = gv;
-                            }
-                        }
+                    if(auto gv = findGlobalVariable(taddress)) {
+                        touched[taddress] = gv;
                     }
                 }
                 else if(dynamic_cast<NormalLink *>(li->getLink())) continue;
@@ -141,17 +141,18 @@ void PermuteDataPass::visit(Module *module) {
         ranges.push_back(Range::fromEndpoints(prev, ds->getSize()));
     }
 
-    // generate random new layout
-    newlayout.clear();
-    std::vector<Range> shuffle = ranges;
-    std::random_shuffle(shuffle.begin(), shuffle.end());
-    address_t lastend = 0;
+    // generate new layout
+    Placement placement;
+    address_t newSize = profile ? placeByProfile(ranges, placement)
+        : placeRandomly(ranges, placement);
+    nds->setSize(newSize);
+    ndr->setSize(newSize);
 
-    for(auto nr : shuffle) {
-        address_t newend = lastend + nr.getSize();
-        newlayout[nr.getStart()] = Range::fromEndpoints(lastend, newend);
-        lastend = newend;
+    remap.clear();
+    for(const auto &place : placement) {
+        remap.emplace_back(place.first.getStart(), place.second);
     }
+    std::sort(remap.begin(), remap.end());
 
     // step 5a: re-create all globalvariables in new datasection
     std::map<address_t, GlobalVariable *> newglobals;
@@ -243,29 +244,28 @@ void PermuteDataPass::visit(Module *module) {
         }
     }
 
-    // step 6: iterate through all instructions, update all links to point to new
-    //          datavariables and datasections (for dataoffsetlinks)
-    recurse(module);
+    // step 6: update the links of the instructions that reference ds to
+    //          point to new datavariables and datasections
+    LOG(1, "Updating " << references.size() << " instruction links.");
+    for(auto li : references) {
+        li->setLink(updatedLink(li->getLink()));
+    }
+    references.clear();
 
     // step 7: copy over data from original data region into new data region
     // NOTE: this only needs to be done for .data, not for (eventually) .bss
     auto dr = (DataRegion *)ds->getParent();
     const std::string &old_data = dr->getDataBytes();
-    std::string new_data(ds->getSize(), '\x00');
-
-    lastend = 0;
-
-    for(auto nr : shuffle) {
-        address_t newend = lastend + nr.getSize();
+    std::string new_data(newSize, '\x00');
 
-        LOG(1, "Moving data block " << nr << " to 0x" << std::hex << lastend);
+    for(const auto &place : placement) {
+        auto nr = place.first;
+        LOG(1, "Moving data block " << nr << " to 0x" << std::hex
+            << place.second);
         std::copy(
             old_data.begin() + ds->getOriginalOffset() + nr.getStart(),
             old_data.begin() + ds->getOriginalOffset() + nr.getEnd(),
-            new_data.begin() + lastend);
-
-        // newlayout[nr.getStart()] = Range::fromEndpoints(lastend, newend);
-        lastend = newend;
+            new_data.begin() + place.second);
     }
 
     ndr->saveDataBytes(new_data);
@@ -274,12 +274,112 @@ void PermuteDataPass::visit(Module *module) {
     curModule = nullptr;
 }
 
-void PermuteDataPass::visit(Instruction *instr) {
-    auto semantic = instr->getSemantic();
-    auto li = dynamic_cast<LinkedInstructionBase *>(semantic);
-    if(!li) return;
+address_t PermuteDataPass::placeRandomly(const std::vector<Range> &ranges,
+    Placement &placement) {
+
+    std::vector<Range> shuffle = ranges;
+    std::random_shuffle(shuffle.begin(), shuffle.end());
+    address_t lastend = 0;
 
-    li->setLink(updatedLink(li->getLink()));
+    for(auto nr : shuffle) {
+        placement.emplace_back(nr, lastend);
+        lastend += nr.getSize();
+    }
+    return lastend;
+}
+
+address_t PermuteDataPass::placeByProfile(const std::vector<Range> &ranges,
+    Placement &placement) {
+
+    // a sampled store anywhere in a line is enough to take it away from
+    // the cores that only read it
+    const address_t CACHE_LINE = 64;
+
+    struct Heat {
+        Range range;
+        uint64_t count;
+    };
+    std::vector<Heat> written, readMostly, cold;
+    for(auto nr : ranges) {
+        uint64_t loads, stores;
+        profile->count(ds->getAddress() + nr.getStart(),
+            ds->getAddress() + nr.getEnd(), loads, stores);
+        Heat heat{nr, loads + stores};
+        if(stores) written.push_back(heat);
+        else if(loads) readMostly.push_back(heat);
+        else cold.push_back(heat);
+    }
+    LOG(1, "data layout: " << std::dec << written.size() << " written, "
+        << readMostly.size() << " read-mostly and " << cold.size()
+        << " unsampled ranges");
+
+    // the densest ranges first, so the hot bytes fill as few lines as
+    // possible
+    auto byDensity = [] (const Heat &a, const Heat &b) {
+        return a.count * std::max<size_t>(b.range.getSize(), 1)
+            > b.count * std::max<size_t>(a.range.getSize(), 1);
+    };
+    std::stable_sort(written.begin(), written.end(), byDensity);
+    std::stable_sort(readMostly.begin(), readMostly.end(), byDensity);
+
+    address_t offset = 0;
+    for(auto group : {&written, &readMostly, &cold}) {
+        if(group->empty()) continue;
+        offset = (offset + CACHE_LINE - 1) & ~(CACHE_LINE - 1);
+
+        for(const auto &heat : *group) {
+            // keep each range as aligned as it was, up to a cache line
+            address_t start = ds->getAddress() + heat.range.getStart();
+            address_t alignment = start ? (start & -start) : CACHE_LINE;
+            alignment = std::min(alignment, CACHE_LINE);
+            offset = (offset + alignment - 1) & ~(alignment - 1);
+
+            placement.emplace_back(heat.range, offset);
+            offset += heat.range.getSize();
+        }
+    }
+    return offset;
+}
+
+void PermuteDataPass::buildGlobalIndex(Module *module) {
+    globalIndex.clear();
+    for(auto dr : CIter::children(module->getDataRegionList())) {
+        for(auto section : CIter::children(dr)) {
+            for(auto gv : section->getGlobalVariables()) {
+                globalIndex.push_back(gv);
+            }
+        }
+    }
+    std::stable_sort(globalIndex.begin(), globalIndex.end(),
+        [] (GlobalVariable *a, GlobalVariable *b) {
+            return a->getAddress() < b->getAddress();
+        });
+}
+
+GlobalVariable *PermuteDataPass::findGlobalVariable(address_t address) {
+    auto it = std::upper_bound(globalIndex.begin(), globalIndex.end(),
+        address, [] (address_t address, GlobalVariable *gv) {
+            return address < gv->getAddress();
+        });
+
+    // aliases share an address; any of them that contains it will do
+    while(it != globalIndex.begin()) {
+        --it;
+        if((*it)->getRange().contains(address)) return *it;
+        if(it == globalIndex.begin()
+            || (*(it - 1))->getAddress() != (*it)->getAddress()) break;
+    }
+    return nullptr;
+}
+
+bool PermuteDataPass::referencesSection(Link *link) {
+    if(auto dol = dynamic_cast<DataOffsetLinkBase *>(link)) {
+        return dol->getTarget() == ds;
+    }
+    if(auto ml = dynamic_cast<MarkerLink *>(link)) {
+        return ml->getMarker()->getBase() == ds;
+    }
+    return false;
 }
 
 Link *PermuteDataPass::updatedLink(Link *link) {
@@ -372,11 +472,14 @@ address_t PermuteDataPass::newAddress(address_t address) {
 }
 
 address_t PermuteDataPass::newOffset(address_t offset) {
-    auto it = newlayout.upper_bound(offset);
-    assert(it != newlayout.begin());
+    auto it = std::upper_bound(remap.begin(), remap.end(), offset,
+        [] (address_t offset, const std::pair<address_t, address_t> &entry) {
+            return offset < entry.first;
+        });
+    assert(it != remap.begin());
     it --;
 
     off_t subregion_offset = offset - (*it).first;
 
-    return (*it).second.getStart() + subregion_offset;
+    return (*it).second + subregion_offset;
 }
@@ -1,25 +1,57 @@
 #ifndef EGALITO_PASS_PERMUTEDATA_H
 #define EGALITO_PASS_PERMUTEDATA_H
 
+#include <vector>
+#include <utility>
 #include "chunk/module.h"
+#include "util/range.h"
 #include "chunkpass.h"
 
+class LinkedInstructionBase;
+class DataProfile;
+
+/** Moves the global variables of .data into a new section, updating every
+    link into it. Variables that are accessed together are kept together.
+
+    Without a profile, the order is random. With a DataProfile the layout
+    is for locality instead: sampled ranges that are written go first,
+    then the read-only sampled ones, then the unsampled ones in their
+    original order. Within each group the densest ranges come first, and
+    each group starts on its own cache line, so read-mostly variables
+    don't share a line with written ones.
+*/
 class PermuteDataPass : public ChunkPass {
 private:
+    typedef std::vector<std::pair<Range, address_t>> Placement;
+
+    DataProfile *profile;
     // old data section, new data section
     DataSection *ds, *nds;
     // stores map of datavariables (in ds) to dvs (in nds)
     std::map<DataVariable *, DataVariable *> dvmap;
-    // stores map of offsets (in ds) to offsets (in nds)
-    std::map<address_t, Range> newlayout;
+    // start offsets of moved ranges (in ds) and their new offsets (in nds),
+    // sorted by old offset
+    std::vector<std::pair<address_t, address_t>> remap;
+    // global variables of the module, sorted by address
+    std::vector<GlobalVariable *> globalIndex;
+    // instructions with links into ds, found while scanning for accesses
+    std::vector<LinkedInstructionBase *> references;
     // set of variables that have to remain in place
     std::map<Range, GlobalVariable *> immobileVariables;
     Module *curModule;
     GlobalVariable *lastVariable;
 public:
+    PermuteDataPass(DataProfile *profile = nullptr) : profile(profile) {}
+
     virtual void visit(Module *module);
-    virtual void visit(Instruction *instr);
 private:
+    address_t placeRandomly(const std::vector<Range> &ranges,
+        Placement &placement);
+    address_t placeByProfile(const std::vector<Range> &ranges,
+        Placement &placement);
+    void buildGlobalIndex(Module *module);
+    GlobalVariable *findGlobalVariable(address_t address);
+    bool referencesSection(Link *link);
     Link *updatedLink(Link *link);
 private:
     address_t newAddress(address_t address);
@@ -1,20 +1,57 @@
 #include <cstring>  // for memset
 #include "profileinstrument.h"
+#include "analysis/analysiscache.h"
 #include "operation/addinline.h"
 #include "operation/mutator.h"
 #include "disasm/disassemble.h"
-#include "chunk/module.h"
+#include "chunk/concrete.h"
+#include "chunk/initfunction.h"
 #include "instr/concrete.h"
 #include "log/log.h"
 
+#define DATA_REGION_ADDRESS 0x30000000
+#define DATA_NAMEREGION_ADDRESS 0x31000000
+#define DATA_DERIVEDREGION_ADDRESS 0x32000000
+#define DATA_SECTION_NAME ".profiling"
+#define DATA_NAMESECTION_NAME ".profiling.names"
+#define DATA_DERIVEDSECTION_NAME ".profiling.derived"
+#define DATA_SAMPLESECTION_NAME ".profiling.samples"
+
+// .profiling.samples: next sample index, runtime address of the section
+// itself (for etprofile to undo relocation), then the ring of PCs
+#define SAMPLE_HEADER_SIZE 16
+#define SAMPLE_COUNT 0x10000
+#define SAMPLE_INTERVAL_USEC 1000
+
+void ProfileInstrumentPass::visit(Program *program) {
+    if(mode == MODE_SAMPLE) {
+        // there is only one SIGPROF handler per process
+        if(auto module = program->getMain()) addSampler(module);
+        return;
+    }
+
+    if(mode == MODE_COUNT_TREE) findDerivedFunctions(program);
+    recurse(program);
+
+    for(auto &derived : derivedList) {
+        appendDerived(derived);
+    }
+}
+
+bool ProfileInstrumentPass::shouldInstrument(Function *function) {
+    if(function->getName() == "_init") return false;
+    if(function->getName() == "_fini") return false;
+    if(function->getName() == "__libc_csu_init") return false;
+    if(function->getName() == "__libc_csu_fini") return false;
+    return true;
+}
+
 void ProfileInstrumentPass::visit(Function *function) {
-    if(function->getName() == "_init") return;
-    if(function->getName() == "_fini") return;
-    if(function->getName() == "__libc_csu_init") return;
-    if(function->getName() == "__libc_csu_fini") return;
+    if(!shouldInstrument(function)) return;
+    if(derivedSet.count(function)) return;
 
     auto module = static_cast<Module *>(function->getParent()->getParent());
-    auto sectionPair = createDataSection(module);
+    auto sectionPair = createDataSection(module, DATA_SECTION_NAME);
 
     ChunkAddInline ai({}, [this, sectionPair, function] (unsigned int stackBytesAdded) {
         /*
@@ -52,50 +89,44 @@ void ProfileInstrumentPass::visit(Function *function) {
         << std::hex << sem->getLink()->getTargetAddress());
 }
 
-#define DATA_REGION_ADDRESS 0x30000000
-#define DATA_NAMEREGION_ADDRESS 0x31000000
-#define DATA_SECTION_NAME ".profiling"
-#define DATA_NAMESECTION_NAME ".profiling.names"
-
 std::pair<DataSection *, DataSection *> ProfileInstrumentPass
-    ::createDataSection(Module *module) {
+    ::createDataSection(Module *module, const char *sectionName) {
 
     auto regionList = module->getDataRegionList();
-    if(auto section = regionList->findDataSection(DATA_SECTION_NAME)) {
+    if(auto section = regionList->findDataSection(sectionName)) {
         if(auto nameSection = regionList->findDataSection(DATA_NAMESECTION_NAME)) {
             return std::make_pair(section, nameSection);
         }
     }
 
-    auto region = new DataRegion(DATA_REGION_ADDRESS);
-    region->setPosition(new AbsolutePosition(DATA_REGION_ADDRESS));
+    auto section = createSection(module, sectionName,
+        DATA_REGION_ADDRESS, 0x8, SHF_WRITE | SHF_ALLOC);
+    auto nameSection = createSection(module, DATA_NAMESECTION_NAME,
+        DATA_NAMEREGION_ADDRESS, 0x1, SHF_ALLOC);
+
+    return std::make_pair(section, nameSection);
+}
+
+DataSection *ProfileInstrumentPass::createSection(Module *module,
+    const char *name, address_t address, size_t alignment,
+    unsigned long permissions) {
+
+    auto regionList = module->getDataRegionList();
+    auto region = new DataRegion(address);
+    region->setPosition(new AbsolutePosition(address));
     regionList->getChildren()->add(region);
     region->setParent(regionList);
 
     auto section = new DataSection();
-    section->setName(DATA_SECTION_NAME);
-    section->setAlignment(0x8);
-    section->setPermissions(SHF_WRITE | SHF_ALLOC);
+    section->setName(name);
+    section->setAlignment(alignment);
+    section->setPermissions(permissions);
     section->setPosition(new AbsoluteOffsetPosition(section, 0));
     section->setType(DataSection::TYPE_DATA);
     region->getChildren()->add(section);
     section->setParent(region);
 
-    auto nameRegion = new DataRegion(DATA_NAMEREGION_ADDRESS);
-    nameRegion->setPosition(new AbsolutePosition(DATA_NAMEREGION_ADDRESS));
-    regionList->getChildren()->add(nameRegion);
-    nameRegion->setParent(regionList);
-
-    auto nameSection = new DataSection();
-    nameSection->setName(DATA_NAMESECTION_NAME);
-    nameSection->setAlignment(0x1);
-    nameSection->setPermissions(SHF_ALLOC);
-    nameSection->setPosition(new AbsoluteOffsetPosition(nameSection, 0));
-    nameSection->setType(DataSection::TYPE_DATA);
-    nameRegion->getChildren()->add(nameSection);
-    nameSection->setParent(nameRegion);
-
-    return std::make_pair(section, nameSection);
+    return section;
 }
 
 Link *ProfileInstrumentPass::addVariable(DataSection *section, Function *function) {
@@ -116,6 +147,7 @@ Link *ProfileInstrumentPass::addVariable(DataSection *section, Function *functio
     var->setSymbol(nsymbol);
 
     section->addGlobalVariable(var);
+    counterMap[function] = offset / VAR_SIZE;
 
     LOG(0, name << " is a global symbol");
 
@@ -136,3 +168,323 @@ void ProfileInstrumentPass::appendFunctionName(DataSection *nameSection,
     bytes.append(name.c_str(), name.length() + 1);
     region->saveDataBytes(bytes);
 }
+
+// the function that a link target is (or is inside of), if any
+static Function *getContainingFunction(Chunk *target) {
+    for(auto chunk = target; chunk; chunk = chunk->getParent()) {
+        if(auto function = dynamic_cast<Function *>(chunk)) return function;
+    }
+    return nullptr;
+}
+
+void ProfileInstrumentPass::findDerivedFunctions(Program *program) {
+    // callee -> (its only caller, number of once-per-call sites)
+    std::map<Function *, std::pair<Function *, unsigned long>> parentMap;
+    std::vector<Function *> order;
+    std::set<Function *> rejected;
+    auto reject = [&] (Link *link) {
+        if(!link) return;
+        if(auto target = getContainingFunction(&*link->getTarget())) {
+            rejected.insert(target);
+        }
+    };
+
+    for(auto module : CIter::children(program)) {
+        for(auto function : CIter::functions(module)) {
+            if(!shouldInstrument(function) || function->getDynamicSymbol()) {
+                rejected.insert(function);
+            }
+
+            auto onceSet = getOncePerCallBlocks(function);
+            for(auto block : CIter::children(function)) {
+                for(auto instr : CIter::children(block)) {
+                    auto semantic = instr->getSemantic();
+                    auto link = semantic->getLink();
+                    if(!link) continue;
+                    auto chunk = &*link->getTarget();
+                    auto target = getContainingFunction(chunk);
+                    if(!target) continue;
+                    // branches within the function don't start a new call
+                    if(target == function && chunk != function) continue;
+
+                    auto cfi = dynamic_cast<ControlFlowInstruction *>(semantic);
+                    if(cfi && cfi->getMnemonic() == "callq"
+                        && chunk == target && target != function
+                        && onceSet.count(block)
+                        && target->getParent() == function->getParent()) {
+
+                        auto it = parentMap.find(target);
+                        if(it == parentMap.end()) {
+                            parentMap[target] = std::make_pair(function, 1);
+                            order.push_back(target);
+                        }
+                        else if(it->second.first == function) {
+                            it->second.second ++;
+                        }
+                        else rejected.insert(target);
+                    }
+                    else rejected.insert(target);
+                }
+            }
+        }
+
+        for(auto region : CIter::regions(module)) {
+            for(auto section : CIter::children(region)) {
+                for(auto var : CIter::children(section)) {
+                    reject(var->getDest());
+                }
+            }
+        }
+        for(auto plt : CIter::plts(module)) {
+            if(auto target = getContainingFunction(plt->getTarget())) {
+                rejected.insert(target);
+            }
+        }
+        for(auto list : {module->getInitFunctionList(),
+            module->getFiniFunctionList()}) {
+
+            if(!list) continue;
+            for(auto init : CIter::children(list)) {
+                rejected.insert(init->getFunction());
+            }
+        }
+    }
+    if(auto entry = dynamic_cast<Function *>(program->getEntryPoint())) {
+        rejected.insert(entry);
+    }
+
+    // follow callers up to a counted function; a cycle of derived
+    // functions has no counter to start from, so count one of them
+    auto findRoot = [&] (Function *function, Derived &derived) {
+        std::set<Function *> seen{function};
+        derived = Derived{function, function, 1};
+        for(;;) {
+            auto &parent = parentMap[derived.root];
+            derived.multiplier *= parent.second;
+            derived.root = parent.first;
+            if(derived.multiplier > 0xffffffffUL) return false;
+            if(rejected.count(derived.root)
+                || !parentMap.count(derived.root)) return true;
+            if(!seen.insert(derived.root).second) return false;
+        }
+    };
+
+    bool changed = true;
+    while(changed) {
+        changed = false;
+        for(auto function : order) {
+            if(rejected.count(function)) continue;
+            Derived derived;
+            if(!findRoot(function, derived)) {
+                rejected.insert(function);
+                changed = true;
+            }
+        }
+    }
+
+    for(auto function : order) {
+        if(rejected.count(function)) continue;
+        Derived derived;
+        findRoot(function, derived);
+        derivedList.push_back(derived);
+        derivedSet.insert(function);
+        LOG(10, "profile count of [" << function->getName() << "] is "
+            << derived.multiplier << " x [" << derived.root->getName() << "]");
+    }
+    LOG(1, "profiling: " << derivedList.size()
+        << " function counts can be derived from other counters");
+}
+
+std::set<Block *> ProfileInstrumentPass::getOncePerCallBlocks(
+    Function *function) {
+
+    std::set<Block *> onceSet;
+    if(function->getChildren()->getIterable()->getCount() == 0) return onceSet;
+
+    auto analysis = AnalysisCache::getInstance()->get(function);
+    auto cfg = analysis->getCFG();
+    auto dominance = analysis->getDominance();
+
+    // on every path through the function, and not in a loop
+    const auto count = static_cast<ControlFlow::id_t>(cfg->getCount());
+    for(ControlFlow::id_t id = 0; id < count; id ++) {
+        if(!dominance->postDominates(id, 0)) continue;
+
+        std::vector<bool> visited(count, false);
+        std::vector<ControlFlow::id_t> stack;
+        for(auto next : cfg->get(id)->successorIDs()) stack.push_back(next);
+        bool cycle = false;
+        while(!stack.empty() && !cycle) {
+            auto next = stack.back();
+            stack.pop_back();
+            if(next == id) cycle = true;
+            else if(!visited[next]) {
+                visited[next] = true;
+                for(auto s : cfg->get(next)->successorIDs()) stack.push_back(s);
+            }
+        }
+        if(!cycle) onceSet.insert(cfg->get(id)->getBlock());
+    }
+    return onceSet;
+}
+
+void ProfileInstrumentPass::appendDerived(Derived &derived) {
+    auto it = counterMap.find(derived.root);
+    if(it == counterMap.end()) {
+        LOG(1, "profiling: no counter for [" << derived.root->getName()
+            << "], can't derive [" << derived.function->getName() << "]");
+        return;
+    }
+
+    auto module = static_cast<Module *>(
+        derived.function->getParent()->getParent());
+    auto regionList = module->getDataRegionList();
+    auto section = regionList->findDataSection(DATA_DERIVEDSECTION_NAME);
+    if(!section) {
+        section = createSection(module, DATA_DERIVEDSECTION_NAME,
+            DATA_DERIVEDREGION_ADDRESS, 0x1, SHF_ALLOC);
+    }
+
+    // name, then the root's counter index and the multiplier as uint32
+    std::string record = derived.function->getName();
+    record.push_back('\0');
+    for(auto value : {it->second, derived.multiplier}) {
+        for(int i = 0; i < 4; i ++) {
+            record.push_back(static_cast<char>((value >> (i*8)) & 0xff));
+        }
+    }
+
+    auto region = static_cast<DataRegion *>(section->getParent());
+    region->setSize(region->getSize() + record.length());
+    section->setSize(section->getSize() + record.length());
+    auto bytes = region->getDataBytes();
+    bytes.append(record);
+    region->saveDataBytes(bytes);
+}
+
+static Instruction *makeLinkedInstruction(std::vector<unsigned char> bytes,
+    Link *link, int index) {
+
+    DisasmHandle handle(true);
+    auto instr = new Instruction();
+    auto sem = new LinkedInstruction(instr);
+    sem->setAssembly(DisassembleInstruction(handle).makeAssemblyPtr(bytes));
+    sem->setLink(link);
+    sem->setIndex(index);
+    instr->setSemantic(sem);
+    return instr;
+}
+
+static Function *makeFunction(Module *module, const char *name,
+    const std::vector<Instruction *> &instrList) {
+
+    auto function = new Function();
+    function->setName(name);
+    function->setPosition(new AbsolutePosition(0x0));
+
+    auto block = new Block();
+    {
+        ChunkMutator(function, true).append(block);
+    }
+    {
+        ChunkMutator m(block, true);
+        for(auto instr : instrList) m.append(instr);
+    }
+
+    module->getFunctionList()->getChildren()->add(function);
+    function->setParent(module->getFunctionList());
+    return function;
+}
+
+#define GET_BYTE(x, shift) static_cast<unsigned char>(((x) >> (shift*8)) & 0xff)
+#define GET_BYTES(x) GET_BYTE((x),0), GET_BYTE((x),1), GET_BYTE((x),2), GET_BYTE((x),3)
+
+void ProfileInstrumentPass::addSampler(Module *module) {
+    auto section = createDataSection(module, DATA_SAMPLESECTION_NAME).first;
+    auto region = static_cast<DataRegion *>(section->getParent());
+    const size_t size = SAMPLE_HEADER_SIZE + SAMPLE_COUNT * 8;
+    section->setSize(size);
+    region->setSize(size);
+    region->saveDataBytes(std::string(size, '\0'));
+
+    auto sampleLink = [section] (size_t offset) {
+        return new DataOffsetLink(section, offset, Link::SCOPE_INTERNAL_DATA);
+    };
+
+    // void handler(int sig, siginfo_t *info, ucontext_t *context)
+    auto handler = makeFunction(module, "egalito_profiling_sample", {
+        // mov 0xa8(%rdx),%rax      (uc_mcontext.gregs[REG_RIP])
+        Disassemble::instruction({0x48, 0x8b, 0x82, 0xa8, 0x00, 0x00, 0x00}),
+        // mov $1,%ecx
+        Disassemble::instruction({0xb9, 0x01, 0x00, 0x00, 0x00}),
+        // lock xadd %rcx,index(%rip)
+        makeLinkedInstruction({0xf0, 0x48, 0x0f, 0xc1, 0x0d,
+            0x00, 0x00, 0x00, 0x00}, sampleLink(0), 1),
+        // and $(SAMPLE_COUNT-1),%ecx
+        Disassemble::instruction({0x81, 0xe1, GET_BYTES(SAMPLE_COUNT - 1)}),
+        // lea samples(%rip),%rsi
+        makeLinkedInstruction({0x48, 0x8d, 0x35, 0x00, 0x00, 0x00, 0x00},
+            sampleLink(SAMPLE_HEADER_SIZE), 0),
+        // mov %rax,(%rsi,%rcx,8)
+        Disassemble::instruction({0x48, 0x89, 0x04, 0xce}),
+        Disassemble::instruction({0xc3})
+    });
+
+    auto restorer = makeFunction(module, "egalito_profiling_restorer", {
+        // mov $__NR_rt_sigreturn,%eax; syscall
+        Disassemble::instruction({0xb8, 0x0f, 0x00, 0x00, 0x00}),
+        Disassemble::instruction({0x0f, 0x05})
+    });
+
+    // struct kernel_sigaction at 0(%rsp), struct itimerval at 0x20(%rsp)
+    auto start = makeFunction(module, "egalito_profiling_start", {
+        Disassemble::instruction({0x48, 0x83, 0xec, 0x48}),
+        makeLinkedInstruction({0x48, 0x8d, 0x05, 0x00, 0x00, 0x00, 0x00},
+            new NormalLink(handler, Link::SCOPE_WITHIN_MODULE), 0),
+        Disassemble::instruction({0x48, 0x89, 0x04, 0x24}),
+        // SA_SIGINFO | SA_RESTORER | SA_RESTART
+        Disassemble::instruction({0x48, 0xc7, 0x44, 0x24, 0x08,
+            0x04, 0x00, 0x00, 0x14}),
+        makeLinkedInstruction({0x48, 0x8d, 0x05, 0x00, 0x00, 0x00, 0x00},
+            new NormalLink(restorer, Link::SCOPE_WITHIN_MODULE), 0),
+        Disassemble::instruction({0x48, 0x89, 0x44, 0x24, 0x10}),
+        Disassemble::instruction({0x48, 0xc7, 0x44, 0x24, 0x18,
+            0x00, 0x00, 0x00, 0x00}),
+        // rt_sigaction(SIGPROF, %rsp, NULL, 8)
+        Disassemble::instruction({0xb8, 0x0d, 0x00, 0x00, 0x00}),
+        Disassemble::instruction({0xbf, 0x1b, 0x00, 0x00, 0x00}),
+        Disassemble::instruction({0x48, 0x89, 0xe6}),
+        Disassemble::instruction({0x31, 0xd2}),
+        Disassemble::instruction({0x41, 0xba, 0x08, 0x00, 0x00, 0x00}),
+        Disassemble::instruction({0x0f, 0x05}),
+        // it_interval and it_value are both SAMPLE_INTERVAL_USEC
+        Disassemble::instruction({0x48, 0xc7, 0x44, 0x24, 0x20,
+            0x00, 0x00, 0x00, 0x00}),
+        Disassemble::instruction({0x48, 0xc7, 0x44, 0x24, 0x28,
+            GET_BYTES(SAMPLE_INTERVAL_USEC)}),
+        Disassemble::instruction({0x48, 0xc7, 0x44, 0x24, 0x30,
+            0x00, 0x00, 0x00, 0x00}),
+        Disassemble::instruction({0x48, 0xc7, 0x44, 0x24, 0x38,
+            GET_BYTES(SAMPLE_INTERVAL_USEC)}),
+        // setitimer(ITIMER_PROF, 0x20(%rsp), NULL)
+        Disassemble::instruction({0xb8, 0x26, 0x00, 0x00, 0x00}),
+        Disassemble::instruction({0xbf, 0x02, 0x00, 0x00, 0x00}),
+        Disassemble::instruction({0x48, 0x8d, 0x74, 0x24, 0x20}),
+        Disassemble::instruction({0x31, 0xd2}),
+        Disassemble::instruction({0x0f, 0x05}),
+        // record where the section ended up
+        makeLinkedInstruction({0x48, 0x8d, 0x05, 0x00, 0x00, 0x00, 0x00},
+            sampleLink(0), 0),
+        makeLinkedInstruction({0x48, 0x89, 0x05, 0x00, 0x00, 0x00, 0x00},
+            sampleLink(8), 1),
+        Disassemble::instruction({0x48, 0x83, 0xc4, 0x48}),
+        Disassemble::instruction({0xc3})
+    });
+
+    auto initFunction = new InitFunction(true, start);
+    module->getInitFunctionList()->getChildren()->add(initFunction);
+    initFunction->setParent(module->getInitFunctionList());
+}
+
+#undef GET_BYTE
+#undef GET_BYTES
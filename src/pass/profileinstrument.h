@@ -1,18 +1,68 @@
 #ifndef EGALITO_PASS_PROFILE_INSTRUMENT_H
 #define EGALITO_PASS_PROFILE_INSTRUMENT_H
 
+#include <map>
+#include <set>
+#include <vector>
 #include <utility>
 #include "chunkpass.h"
 #include "chunk/dataregion.h"
 #include "chunk/function.h"
 
+/** Collects a function profile into a .profiling section, which
+    ProfileSavePass appends to profile.data at exit and etprofile sums up.
+
+    MODE_COUNT increments a counter on every function entry.
+
+    MODE_COUNT_TREE leaves out the counters whose values follow from
+    another one, like the spanning-tree edges of Ball-Larus profiling: if
+    every reference to g is a direct call from f, in blocks that run
+    exactly once per call of f, then g runs that many times per call of f.
+    These functions are listed in .profiling.derived instead, along with
+    the counter and multiplier etprofile reconstructs their count from.
+
+    MODE_SAMPLE adds no code to functions at all. A SIGPROF timer records
+    the interrupted PC into a ring in .profiling.samples, and etprofile
+    maps the samples back to functions. Its cost does not depend on the
+    call rate and threads share no counters, so it suits production runs;
+    the program must not install a SIGPROF handler of its own.
+*/
 class ProfileInstrumentPass : public ChunkPass {
 public:
+    enum Mode {
+        MODE_COUNT,
+        MODE_COUNT_TREE,
+        MODE_SAMPLE
+    };
+private:
+    struct Derived {
+        Function *function;
+        Function *root;
+        unsigned long multiplier;
+    };
+
+    Mode mode;
+    std::vector<Derived> derivedList;       // in program order
+    std::set<Function *> derivedSet;
+    std::map<Function *, size_t> counterMap;    // counter index
+public:
+    ProfileInstrumentPass(Mode mode = MODE_COUNT) : mode(mode) {}
+    virtual void visit(Program *program);
     virtual void visit(Function *function);
 private:
-    std::pair<DataSection *, DataSection*> createDataSection(Module *module);
+    static bool shouldInstrument(Function *function);
+    std::pair<DataSection *, DataSection*> createDataSection(Module *module,
+        const char *sectionName);
+    DataSection *createSection(Module *module, const char *name,
+        address_t address, size_t alignment, unsigned long permissions);
     Link *addVariable(DataSection *section, Function *function);
     void appendFunctionName(DataSection *nameSection, const std::string &name);
+
+    void findDerivedFunctions(Program *program);
+    std::set<Block *> getOncePerCallBlocks(Function *function);
+    void appendDerived(Derived &derived);
+
+    void addSampler(Module *module);
 };
 
 #endif
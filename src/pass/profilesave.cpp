@@ -5,6 +5,7 @@
 #include "chunk/module.h"
 #include "chunk/initfunction.h"
 #include "instr/concrete.h"
+#include "instr/template.h"
 #include "log/log.h"
 
 #define DATA_REGION_ADDRESS 0x30000000
@@ -12,6 +13,7 @@
 #define DATA_REGION_NAME ("region-" #DATA_REGION_ADDRESS)
 #define DATA_SECTION_NAME ".profiling"
 #define DATA_NAMESECTION_NAME ".profiling.names"
+#define DATA_SAMPLESECTION_NAME ".profiling.samples"
 
 /*
 	0000000000000000 <profiling_save_bytes>:
@@ -35,9 +37,6 @@
 
 */
 
-#define GET_BYTE(x, shift) static_cast<unsigned char>(((x) >> (shift*8)) & 0xff)
-#define GET_BYTES(x) GET_BYTE((x),0), GET_BYTE((x),1), GET_BYTE((x),2), GET_BYTE((x),3)
-
 void ProfileSavePass::visit(Module *module) {
     auto sectionPair = getDataSections(module);
     auto section = sectionPair.first;
@@ -56,50 +55,39 @@ void ProfileSavePass::visit(Module *module) {
         ChunkMutator(function, true).append(block);
     }
 
+#ifdef ARCH_X86_64
     {
-        DisasmHandle handle(true);
+        using T = InstrTemplate;
+        const int rax = X86Register::R0, rdx = X86Register::R2,
+            rbx = X86Register::R3, rsi = X86Register::R6, rdi = X86Register::R7;
+
+        // fd = open("profile.data", O_CREAT | O_APPEND | O_WRONLY, 0644)
         ChunkMutator m(block, true);
-        m.append(Disassemble::instruction({0x53}));
-        m.append(Disassemble::instruction({0x48, 0xc7, 0xc0, 0x02, 0x00, 0x00, 0x00}));
-
-        // lea 0x0(%rip), %rdi
-        auto leaInstr = new Instruction();
-        auto leaSem = new LinkedInstruction(leaInstr);
-        leaSem->setAssembly(DisassembleInstruction(handle).makeAssemblyPtr(
-            std::vector<unsigned char>{0x48, 0x8d, 0x3d, 0x00, 0x00, 0x00, 0x00}));
-        leaSem->setLink(appendString(nameSection, "profile.data"));
-        leaSem->setIndex(0);
-        leaInstr->setSemantic(leaSem);
-        m.append(leaInstr);
-        
-        m.append(Disassemble::instruction({0x48, 0xc7, 0xc6, 0x41, 0x04, 0x00, 0x00}));
-        m.append(Disassemble::instruction({0x48, 0xc7, 0xc2, 0xa4, 0x01, 0x00, 0x00}));
-        m.append(Disassemble::instruction({0x0f, 0x05}));
-        m.append(Disassemble::instruction({0x48, 0x89, 0xc3}));
-        m.append(Disassemble::instruction({0x48, 0xc7, 0xc0, 0x01, 0x00, 0x00, 0x00}));
-        m.append(Disassemble::instruction({0x48, 0x89, 0xdf}));
-
-	    //  lea    0x100(%rip),%rsi
-        auto mov1Instr = new Instruction();
-        auto mov1Sem = new LinkedInstruction(mov1Instr);
-        mov1Sem->setAssembly(DisassembleInstruction(handle).makeAssemblyPtr(
-            std::vector<unsigned char>{0x48, 0x8d, 0x35, 0x00, 0x01, 0x00, 0x00}));
-        mov1Sem->setLink(new DataOffsetLink(section, 0, Link::SCOPE_INTERNAL_DATA));
-        mov1Sem->setIndex(0);
-        mov1Instr->setSemantic(mov1Sem);
-        m.append(mov1Instr);
-
-	    //  mov    $0x101,%rdx
-        unsigned long size = section->getSize();
-        m.append(Disassemble::instruction({0x48, 0xc7, 0xc2, GET_BYTES(size)}));
-
-        m.append(Disassemble::instruction({0x0f, 0x05}));
-        m.append(Disassemble::instruction({0x48, 0xc7, 0xc0, 0x03, 0x00, 0x00, 0x00}));
-        m.append(Disassemble::instruction({0x48, 0x89, 0xdf}));
-        m.append(Disassemble::instruction({0x0f, 0x05}));
-        m.append(Disassemble::instruction({0x5b}));
-        m.append(Disassemble::instruction({0xc3}));
+        m.append(T::make(T::push(rbx)));
+        m.append(T::make(T::movImm(rax, 2)));
+        m.append(T::makeLinked(T::leaRip(rdi),
+            appendString(nameSection, "profile.data")));
+        m.append(T::make(T::movImm(rsi, 0x441)));
+        m.append(T::make(T::movImm(rdx, 0644)));
+        m.append(T::make(T::syscall()));
+        m.append(T::make(T::movReg(rbx, rax)));
+
+        // write(fd, section, size)
+        m.append(T::make(T::movImm(rax, 1)));
+        m.append(T::make(T::movReg(rdi, rbx)));
+        m.append(T::makeLinked(T::leaRip(rsi),
+            new DataOffsetLink(section, 0, Link::SCOPE_INTERNAL_DATA)));
+        m.append(T::make(T::movImm(rdx, section->getSize())));
+        m.append(T::make(T::syscall()));
+
+        // close(fd)
+        m.append(T::make(T::movImm(rax, 3)));
+        m.append(T::make(T::movReg(rdi, rbx)));
+        m.append(T::make(T::syscall()));
+        m.append(T::make(T::pop(rbx)));
+        m.append(T::make(T::ret()));
     }
+#endif
 
     module->getFunctionList()->getChildren()->add(function);
     function->setParent(module->getFunctionList());
@@ -113,7 +101,9 @@ std::pair<DataSection *, DataSection *> ProfileSavePass
     ::getDataSections(Module *module) {
 
     auto regionList = module->getDataRegionList();
-    if(auto section = regionList->findDataSection(DATA_SECTION_NAME)) {
+    auto section = regionList->findDataSection(DATA_SECTION_NAME);
+    if(!section) section = regionList->findDataSection(DATA_SAMPLESECTION_NAME);
+    if(section) {
         if(auto nameSection = regionList->findDataSection(DATA_NAMESECTION_NAME)) {
             return std::make_pair(section, nameSection);
         }
@@ -37,9 +37,10 @@ void AARCH64RegReplacePass::useStack(
     function->accept(&dumper);
 #endif
 
-    AARCH64RegisterUsageX regUsage(function, AARCH64GPRegister::R18);
+    AARCH64RegisterMasks masks(function);
+    AARCH64RegisterUsageX regUsage(function, AARCH64GPRegister::R18, masks);
 
-    std::vector<int> count = AARCH64RegisterUsage().getAllUseCounts(function);
+    std::vector<int> count = AARCH64RegisterUsage().getAllUseCounts(masks);
     std::vector<bool> unusable = regUsage.getUnusableRegister();
 
     AARCH64GPRegister::ID dualID;
@@ -0,0 +1,188 @@
+#include <cstring>  // for memcpy
+#include "relaxtls.h"
+#include "resolvetls.h"
+#include "chunk/concrete.h"
+#include "disasm/disassemble.h"
+#include "elf/elfspace.h"
+#include "elf/elfmap.h"
+#include "elf/reloc.h"
+#include "elf/symbol.h"
+#include "instr/concrete.h"
+#include "operation/mutator.h"
+#include "log/log.h"
+
+void RelaxTLSPass::visit(Program *program) {
+    this->program = program;
+    recurse(program);
+
+    // GOT slots that name another module's variable are left unresolved
+    if(relaxedCount > 0) {
+        ResolveTLSPass resolveTLS;
+        program->accept(&resolveTLS);
+    }
+    LOG(1, "relaxed " << std::dec << relaxedCount
+        << " dynamic TLS accesses");
+}
+
+void RelaxTLSPass::visit(Module *module) {
+    if(!module->getElfSpace()) return;
+    this->module = module;
+    recurse(module->getFunctionList());
+}
+
+void RelaxTLSPass::visit(Block *block) {
+#ifdef ARCH_X86_64
+    Instruction *lea = nullptr;
+    bool localDynamic = false;
+    for(auto instr : CIter::children(block)) {
+        if(lea && isTLSGetAddrCall(instr)) {
+            if(relax(lea, instr, localDynamic)) relaxedCount ++;
+            lea = nullptr;
+            continue;
+        }
+
+        // data16 lea x@tlsgd(%rip), %rdi  or  lea x@tlsld(%rip), %rdi
+        lea = nullptr;
+        auto linked = dynamic_cast<LinkedInstruction *>(instr->getSemantic());
+        if(!linked || !linked->getLink()) continue;
+        const auto &bytes = linked->getData();
+        static const char gd[] = {0x66, 0x48, (char)0x8d, 0x3d};
+        if(bytes.size() == 8 && !std::memcmp(bytes.data(), gd, 4)) {
+            lea = instr;
+            localDynamic = false;
+        }
+        else if(bytes.size() == 7 && !std::memcmp(bytes.data(), gd + 1, 3)) {
+            lea = instr;
+            localDynamic = true;
+        }
+    }
+#endif
+}
+
+bool RelaxTLSPass::isTLSGetAddrCall(Instruction *instruction) {
+#ifdef ARCH_X86_64
+    auto cfi = dynamic_cast<ControlFlowInstruction *>(
+        instruction->getSemantic());
+    if(!cfi || cfi->getMnemonic() != "callq" || !cfi->getLink()) return false;
+
+    // CollapsePLTPass may already have turned the PLT call into a direct one
+    if(auto pltLink = dynamic_cast<PLTLink *>(cfi->getLink())) {
+        auto symbol = pltLink->getPLTTrampoline()->getExternalSymbol();
+        return symbol && symbol->getName() == "__tls_get_addr";
+    }
+    if(auto function = dynamic_cast<Function *>(
+        &*cfi->getLink()->getTarget())) {
+
+        return function->getName() == "__tls_get_addr";
+    }
+#endif
+    return false;
+}
+
+bool RelaxTLSPass::relax(Instruction *lea, Instruction *call,
+    bool localDynamic) {
+
+#ifdef ARCH_X86_64
+    auto leaSemantic = static_cast<LinkedInstruction *>(lea->getSemantic());
+    auto gotLink = leaSemantic->getLink();
+    address_t got = gotLink->getTargetAddress();
+
+    auto var = module->getDataRegionList()->findVariable(got);
+    if(var && var->getDest()) {
+        LOG(10, "GOT slot 0x" << std::hex << got << " for "
+            << lea->getName() << " already has a link, not relaxing");
+        return false;
+    }
+    auto offsetLink = makeOffsetLink(got, localDynamic);
+    if(!offsetLink) {
+        LOG(1, "WARNING: can't determine TLS offset for GOT slot 0x"
+            << std::hex << got << " in " << module->getName());
+        return false;
+    }
+    if(var) var->setDest(offsetLink);
+    else DataVariable::create(module, got, offsetLink, nullptr);
+
+    LOG(10, "relaxing " << (localDynamic ? "LD" : "GD") << " access at "
+        << lea->getName() << " (GOT slot 0x" << std::hex << got << ")");
+
+    DisasmHandle handle(true);
+
+    // mov %fs:0, %rax
+    auto movSemantic = new IsolatedInstruction();
+    movSemantic->setAssembly(DisassembleInstruction(handle).makeAssemblyPtr(
+        std::vector<unsigned char>{0x64, 0x48, 0x8b, 0x04, 0x25, 0, 0, 0, 0}));
+    lea->setSemantic(movSemantic);
+
+    // add GOT(%rip), %rax
+    auto addSemantic = new LinkedInstruction(call);
+    addSemantic->setAssembly(DisassembleInstruction(handle).makeAssemblyPtr(
+        std::vector<unsigned char>{0x48, 0x03, 0x05, 0, 0, 0, 0}));
+    addSemantic->setLink(gotLink);
+    addSemantic->setIndex(0);
+    auto callSemantic = call->getSemantic();
+    call->setSemantic(addSemantic);
+
+    // the GD sequence is 16 bytes like its replacement, LD is 12
+    auto block = static_cast<Block *>(lea->getParent());
+    ChunkMutator(block).modifiedChildSize(lea,
+        movSemantic->getSize() - leaSemantic->getSize());
+    ChunkMutator(block).modifiedChildSize(call,
+        addSemantic->getSize() - callSemantic->getSize());
+
+    delete leaSemantic;
+    delete callSemantic;
+    return true;
+#else
+    return false;
+#endif
+}
+
+Link *RelaxTLSPass::makeOffsetLink(address_t got, bool localDynamic) {
+#ifdef ARCH_X86_64
+    auto relocList = module->getElfSpace()->getRelocList();
+    auto base = module->getBaseAddress();
+    auto moduleReloc = relocList->find(got - base);
+    if(!moduleReloc || moduleReloc->getType() != R_X86_64_DTPMOD64) {
+        return nullptr;
+    }
+
+    auto tls = module->getDataRegionList()->getTLS();
+    if(localDynamic) {
+        // start of this module's TLS block
+        return tls ? new TLSDataOffsetLink(tls, nullptr, 0) : nullptr;
+    }
+
+    // the second word of the pair holds the offset within the TLS block
+    Symbol *symbol = nullptr;
+    address_t offset = 0;
+    if(auto offsetReloc = relocList->find(got + 8 - base)) {
+        if(offsetReloc->getType() != R_X86_64_DTPOFF64) return nullptr;
+        symbol = offsetReloc->getSymbol();
+        offset = offsetReloc->getAddend();
+    }
+    else if(!readStaticOffset(got + 8 - base, &offset)) {
+        return nullptr;
+    }
+
+    if(symbol && symbol->getSectionIndex() == SHN_UNDEF) {
+        // defined in another module; ResolveTLSPass fills this in
+        return new TLSDataOffsetLink(nullptr, symbol, offset);
+    }
+    if(!tls) return nullptr;
+    if(symbol) offset += symbol->getAddress();
+    return new TLSDataOffsetLink(tls, symbol, offset);
+#else
+    return nullptr;
+#endif
+}
+
+bool RelaxTLSPass::readStaticOffset(address_t address, address_t *offset) {
+    auto elfMap = module->getElfSpace()->getElfMap();
+    auto section = elfMap->findSectionContaining(address);
+    if(!section || section->getHeader()->sh_type == SHT_NOBITS) return false;
+
+    auto p = section->getReadAddress()
+        + (address - section->getVirtualAddress());
+    std::memcpy(offset, reinterpret_cast<const void *>(p), sizeof(*offset));
+    return true;
+}
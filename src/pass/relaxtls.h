@@ -0,0 +1,56 @@
+#ifndef EGALITO_PASS_RELAX_TLS_H
+#define EGALITO_PASS_RELAX_TLS_H
+
+#include "chunkpass.h"
+
+class Program;
+class Module;
+class Link;
+class Reloc;
+class Instruction;
+
+/** Rewrites general-dynamic and local-dynamic TLS accesses so that they no
+    longer call __tls_get_addr.
+
+    Every module loaded by egalito gets a slot in the static TLS block, so
+    the GD sequence
+
+        data16 lea x@tlsgd(%rip), %rdi
+        data16 data16 rex.W call __tls_get_addr
+
+    can be relaxed the way the static linker relaxes GD to initial-exec:
+
+        mov %fs:0, %rax
+        add x@gottpoff(%rip), %rax
+
+    The add reuses the GOT pair the lea pointed at: its first word (the
+    DTPMOD64 slot) becomes a DataVariable with a TLSDataOffsetLink, which
+    fixDataSections() fills in with the final thread-pointer offset once the
+    TLS layout is known. LD sequences are handled the same way, with the
+    offset of the module's own TLS block.
+
+    Offsets of TLS variables defined in other modules are filled in by
+    ResolveTLSPass, which is rerun at the end. This pass is x86_64-specific;
+    run it on the Program before code is moved.
+*/
+class RelaxTLSPass : public ChunkPass {
+private:
+    Program *program;
+    Module *module;
+    size_t relaxedCount;
+public:
+    RelaxTLSPass() : program(nullptr), module(nullptr), relaxedCount(0) {}
+
+    size_t getRelaxedCount() const { return relaxedCount; }
+
+    virtual void visit(Program *program);
+    virtual void visit(Module *module);
+    virtual void visit(Block *block);
+private:
+    bool isTLSGetAddrCall(Instruction *instruction);
+    bool relax(Instruction *lea, Instruction *call, bool localDynamic);
+    Link *makeOffsetLink(address_t got, bool localDynamic);
+    bool readStaticOffset(address_t address, address_t *offset);
+};
+
+#endif
@@ -1,8 +1,8 @@
 #include <cassert>
-#include <capstone/capstone.h>
 #include "removepadding.h"
 #include "chunk/concrete.h"
 #include "instr/semantic.h"
+#include "disasm/quickdecode.h"
 #include "operation/mutator.h"
 
 #include "log/log.h"
@@ -52,9 +52,9 @@ void RemovePadding::removeHead(Function *function) {
     auto firstInstr = dynamic_cast<Instruction *>(
         firstBlock->getChildren()->getIterable()->get(0));
     auto semantic = firstInstr->getSemantic();
-    auto assembly = semantic->getAssembly();
 
-    if(assembly && assembly->getId() == ARM64_INS_NOP) {
+    // check the bytes, rather than decoding an Assembly for every function
+    if(QuickDecode::isNop(semantic->getData())) {
         LOG(10, "    first instruction is NOP");
 
         // __GNUC__ >= 5 for AARCH64
@@ -91,8 +91,7 @@ void RemovePadding::removeTail(Function *function) {
         lastBlock->getChildren()->getIterable()->getLast());
     if(lastInstr) {
         auto semantic = lastInstr->getSemantic();
-        auto assembly = semantic->getAssembly();
-        if(assembly && assembly->getId() == ARM64_INS_NOP) {
+        if(QuickDecode::isNop(semantic->getData())) {
             LOG(10, function->getName() << ":    removing last NOP at "
                 << std::hex << lastInstr->getAddress());
             ChunkMutator(lastBlock).removeLast();
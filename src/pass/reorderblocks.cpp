@@ -0,0 +1,351 @@
+#include <set>
+#include <capstone/capstone.h>
+#include "reorderblocks.h"
+#include "analysis/branchprofile.h"
+#include "chunk/concrete.h"
+#include "chunk/blocktable.h"
+#include "instr/concrete.h"
+#include "operation/mutator.h"
+#include "log/log.h"
+
+void ReorderBlocksPass::visit(Module *module) {
+    // taken branches into each block; (block, nullptr) counts all the
+    // branches out of a block, including calls and jumps elsewhere
+    {
+        BlockTable table(module);
+        for(const auto &branch : profile->getBranchList()) {
+            auto target = table.findContaining(branch.to);
+            if(target.isValid()) {
+                blockCount[target.getBlock()] += branch.count;
+            }
+
+            auto source = table.findContaining(branch.from);
+            if(!source.isValid()) continue;
+            auto sourceBlock = source.getBlock();
+            edgeCount[std::make_pair(sourceBlock, nullptr)] += branch.count;
+            if(target.isValid()
+                && source.getFunctionId() == target.getFunctionId()) {
+
+                edgeCount[std::make_pair(sourceBlock, target.getBlock())]
+                    += branch.count;
+            }
+        }
+    }
+
+    // visiting may add .cold functions to the list
+    std::vector<Function *> functions;
+    for(auto function : CIter::functions(module)) {
+        functions.push_back(function);
+    }
+    for(auto function : functions) {
+        function->accept(this);
+    }
+    LOG(1, "reordered blocks of " << std::dec << module->getName()
+        << ", " << coldList.size() << " cold parts split off");
+}
+
+#ifdef ARCH_X86_64
+static bool getInverse(unsigned int id, unsigned int &inverse,
+    const char *&opcode, const char *&mnemonic) {
+
+#define INVERSE(from, to, byte) \
+    case X86_INS_ ## from: \
+        inverse = X86_INS_ ## to; opcode = "\x0f" byte; mnemonic = #to; break
+    switch(id) {
+    INVERSE(JA, JBE, "\x86");
+    INVERSE(JBE, JA, "\x87");
+    INVERSE(JAE, JB, "\x82");
+    INVERSE(JB, JAE, "\x83");
+    INVERSE(JE, JNE, "\x85");
+    INVERSE(JNE, JE, "\x84");
+    INVERSE(JG, JLE, "\x8e");
+    INVERSE(JLE, JG, "\x8f");
+    INVERSE(JGE, JL, "\x8c");
+    INVERSE(JL, JGE, "\x8d");
+    INVERSE(JNO, JO, "\x80");
+    INVERSE(JO, JNO, "\x81");
+    INVERSE(JNP, JP, "\x8a");
+    INVERSE(JP, JNP, "\x8b");
+    INVERSE(JNS, JS, "\x88");
+    INVERSE(JS, JNS, "\x89");
+    default:
+        return false;  // including JCXZ and friends
+    }
+#undef INVERSE
+    return true;
+}
+
+static Instruction *getFirst(Block *block) {
+    return block->getChildren()->getIterable()->get(0);
+}
+
+static Block *getTargetBlock(ControlFlowInstruction *cfi) {
+    auto link = cfi->getLink();
+    if(!link) return nullptr;
+    auto target = dynamic_cast<Instruction *>(link->getTarget());
+    if(!target) return nullptr;
+    auto block = dynamic_cast<Block *>(target->getParent());
+    return (block && getFirst(block) == target) ? block : nullptr;
+}
+#endif
+
+void ReorderBlocksPass::visit(Function *function) {
+#ifdef ARCH_X86_64
+    auto blockList = function->getChildren()->getIterable();
+    if(blockList->getCount() < 2) return;
+
+    std::map<Block *, Successor> successors;
+    bool canMove = true;
+    for(auto block : CIter::children(function)) {
+        successors[block] = getSuccessor(block, &canMove);
+    }
+    if(!canMove) return;
+
+    countBlocks(function, successors);
+    std::vector<Block *> original;
+    bool sampled = false;
+    bool hasJumpTable = false;
+    for(auto block : CIter::children(function)) {
+        original.push_back(block);
+        if(blockCount[block] > 0) sampled = true;
+        auto last = block->getChildren()->getIterable()->getLast();
+        if(dynamic_cast<IndirectJumpInstruction *>(last->getSemantic())) {
+            hasJumpTable = true;
+        }
+    }
+    if(!sampled) return;
+
+    // greedy chain: follow the heaviest edge, or restart at the hottest block
+    std::set<Block *> placed;
+    std::vector<Block *> hot;
+    for(Block *block = original.front(); block; ) {
+        hot.push_back(block);
+        placed.insert(block);
+
+        const auto &successor = successors[block];
+        Block *next = nullptr;
+        uint64_t best = 0;
+        for(auto candidate : {successor.fallThrough, successor.taken}) {
+            if(!candidate || placed.count(candidate)) continue;
+            auto weight = edgeCount[std::make_pair(block, candidate)];
+            if(weight > best) {
+                next = candidate;
+                best = weight;
+            }
+        }
+        if(!next) {
+            for(auto b : original) {
+                if(!placed.count(b) && blockCount[b] > best) {
+                    next = b;
+                    best = blockCount[b];
+                }
+            }
+        }
+        block = next;
+    }
+    std::vector<Block *> cold;
+    for(auto block : original) {
+        if(!placed.count(block)) cold.push_back(block);
+    }
+    if(hot == original) return;
+
+    LOG(10, "reordering " << function->getName() << ": " << std::dec
+        << hot.size() << " hot blocks, " << cold.size() << " cold");
+
+    auto positionFactory = PositionFactory::getInstance();
+    Function *coldFunction = nullptr;
+    if(splitCold && !cold.empty() && !hasJumpTable) {
+        auto address = cold.front()->getAddress();
+        coldFunction = new Function(address);
+        coldFunction->setName(function->getName() + ".cold");
+        coldFunction->setPosition(
+            positionFactory->makeAbsolutePosition(address));
+        coldFunction->setParent(function->getParent());
+        auto functionList = dynamic_cast<FunctionList *>(function->getParent());
+        functionList->getChildren()->add(coldFunction);
+        coldList.push_back(coldFunction);
+    }
+    else {
+        hot.insert(hot.end(), cold.begin(), cold.end());
+        cold.clear();
+    }
+
+    for(auto block : original) {
+        ChunkMutator(function).remove(block);
+        delete block->getPosition();
+        block->setPosition(nullptr);
+    }
+    auto appendAll = [positionFactory] (Function *f,
+        const std::vector<Block *> &list) {
+
+        Chunk *prevChunk = f;
+        for(auto block : list) {
+            block->setPosition(positionFactory->makePosition(
+                prevChunk, block, f->getSize()));
+            ChunkMutator(f).append(block);
+            prevChunk = block;
+        }
+    };
+    appendAll(function, hot);
+    if(coldFunction) appendAll(coldFunction, cold);
+
+    // jumps between the two parts must be promoted to 32-bit displacements
+    if(coldFunction) {
+        for(auto f : {function, coldFunction}) {
+            for(auto block : CIter::children(f)) {
+                for(auto instr : CIter::children(block)) {
+                    auto cfi = dynamic_cast<ControlFlowInstruction *>(
+                        instr->getSemantic());
+                    if(!cfi) continue;
+                    auto target = getTargetBlock(cfi);
+                    if(!target || target->getParent() == f) continue;
+
+                    auto link = cfi->getLink();
+                    cfi->setLink(new NormalLink(getFirst(target),
+                        Link::SCOPE_EXTERNAL_JUMP));
+                    delete link;
+                }
+            }
+        }
+    }
+
+    for(auto list : {&hot, &cold}) {
+        for(size_t i = 0; i < list->size(); i ++) {
+            auto next = (i + 1 < list->size() ? (*list)[i + 1] : nullptr);
+            makeFallThrough((*list)[i], next,
+                successors[(*list)[i]].fallThrough);
+        }
+    }
+#endif
+}
+
+void ReorderBlocksPass::countBlocks(Function *function,
+    std::map<Block *, Successor> &successors) {
+
+    // blocks only reached by falling through have no branch samples
+    Block *prev = nullptr;
+    for(auto block : CIter::children(function)) {
+        if(prev && successors[prev].fallThrough == block) {
+            auto out = edgeCount[std::make_pair(prev, nullptr)];
+            auto in = blockCount[prev];
+            if(in > out) {
+                blockCount[block] += in - out;
+                edgeCount[std::make_pair(prev, block)] += in - out;
+            }
+        }
+        prev = block;
+    }
+}
+
+ReorderBlocksPass::Successor ReorderBlocksPass::getSuccessor(Block *block,
+    bool *canMove) {
+
+    Successor successor{nullptr, nullptr};
+#ifdef ARCH_X86_64
+    for(auto instr : CIter::children(block)) {
+        if(dynamic_cast<LiteralInstruction *>(instr->getSemantic())) {
+            *canMove = false;
+        }
+    }
+
+    auto semantic = block->getChildren()->getIterable()->getLast()
+        ->getSemantic();
+    bool falling = true;
+    if(dynamic_cast<ReturnInstruction *>(semantic)) {
+        falling = false;
+    }
+    else if(dynamic_cast<IndirectJumpInstruction *>(semantic)) {
+        falling = false;
+    }
+    else if(auto v = dynamic_cast<DataLinkedControlFlowInstruction *>(
+        semantic)) {
+
+        falling = v->isCall();
+    }
+    else if(auto cfi = dynamic_cast<ControlFlowInstruction *>(semantic)) {
+        if(cfi->getId() == X86_INS_CALL) {
+            falling = cfi->returns();
+        }
+        else {
+            falling = (cfi->getId() != X86_INS_JMP);
+            successor.taken = getTargetBlock(cfi);
+            if(successor.taken
+                && successor.taken->getParent() != block->getParent()) {
+
+                successor.taken = nullptr;  // tail call
+            }
+        }
+    }
+    else if(dynamic_cast<IsolatedInstruction *>(semantic)) {
+        if(auto assembly = semantic->getAssembly()) {
+            if(assembly->getId() == X86_INS_UD2
+                || assembly->getId() == X86_INS_HLT) {
+
+                falling = false;
+            }
+        }
+    }
+
+    if(falling) {
+        successor.fallThrough = dynamic_cast<Block *>(block->getNextSibling());
+        if(!successor.fallThrough) *canMove = false;  // falls out of function
+    }
+#endif
+    return successor;
+}
+
+void ReorderBlocksPass::makeFallThrough(Block *block, Block *next,
+    Block *fallThrough) {
+
+#ifdef ARCH_X86_64
+    auto last = block->getChildren()->getIterable()->getLast();
+    auto cfi = dynamic_cast<ControlFlowInstruction *>(last->getSemantic());
+    auto targetBlock = cfi ? getTargetBlock(cfi) : nullptr;
+
+    if(!fallThrough) {
+        // drop a jump to the block that now follows
+        if(cfi && cfi->getId() == X86_INS_JMP && next && targetBlock == next
+            && block->getChildren()->getIterable()->getCount() > 1) {
+
+            ChunkMutator(block).remove(last);
+        }
+        return;
+    }
+    if(fallThrough == next) return;
+
+    auto scope = (fallThrough->getParent() == block->getParent()
+        ? Link::SCOPE_INTERNAL_JUMP : Link::SCOPE_EXTERNAL_JUMP);
+
+    unsigned int inverse;
+    const char *opcode, *mnemonic;
+    if(cfi && next && targetBlock == next
+        && getInverse(cfi->getId(), inverse, opcode, mnemonic)) {
+
+        auto inverted = new ControlFlowInstruction(
+            inverse, last, opcode, mnemonic, 4);
+        inverted->setLink(new NormalLink(getFirst(fallThrough), scope));
+        size_t oldSize = cfi->getSize();
+        delete cfi->getLink();
+        delete cfi;
+        last->setSemantic(inverted);
+        ChunkMutator(block).modifiedChildSize(last,
+            inverted->getSize() - oldSize);
+        return;
+    }
+
+    auto function = dynamic_cast<Function *>(block->getParent());
+    auto connecting = new Block();
+    connecting->setPosition(PositionFactory::getInstance()->makePosition(
+        block, connecting,
+        block->getAddress() - function->getAddress() + block->getSize()));
+
+    auto branch = new Instruction();
+    auto semantic = new ControlFlowInstruction(
+        X86_INS_JMP, branch, "\xe9", "jmp", 4);
+    semantic->setLink(new NormalLink(getFirst(fallThrough), scope));
+    branch->setSemantic(semantic);
+
+    ChunkMutator(connecting).append(branch);
+    ChunkMutator(function).insertAfter(block, connecting);
+#endif
+}
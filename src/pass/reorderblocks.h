@@ -0,0 +1,56 @@
+#ifndef EGALITO_PASS_REORDER_BLOCKS_H
+#define EGALITO_PASS_REORDER_BLOCKS_H
+
+#include <map>
+#include <vector>
+#include "chunkpass.h"
+
+class BranchProfile;
+
+/** Profile-driven basic block layout within each function of a Module.
+
+    Block counts come from the taken branches in a BranchProfile, plus
+    whatever falls through from the block before. Starting at the entry
+    block, the hottest successor edge is made the fall-through; blocks that
+    never executed keep their original order after the hot ones. When
+    splitCold is set, those cold blocks are moved into a separate function
+    named <function>.cold, which gets no samples and is therefore placed
+    with the rest of the cold code by FunctionLayout.
+
+    Conditional jumps are inverted where that saves a jump, and otherwise
+    an unconditional jump is added to reach the original fall-through. Run
+    PromoteJumpsPass afterwards, since short jumps may now be out of range.
+    This pass is x86_64-specific; on other architectures it does nothing.
+*/
+class ReorderBlocksPass : public ChunkPass {
+private:
+    struct Successor {
+        Block *fallThrough;
+        Block *taken;
+    };
+
+    BranchProfile *profile;
+    bool splitCold;
+    std::map<Block *, uint64_t> blockCount;
+    std::map<std::pair<Block *, Block *>, uint64_t> edgeCount;
+    std::vector<Function *> coldList;
+public:
+    ReorderBlocksPass(BranchProfile *profile, bool splitCold = true)
+        : profile(profile), splitCold(splitCold) {}
+
+    virtual void visit(Module *module);
+    virtual void visit(Function *function);
+
+    /** The .cold functions that were created. */
+    const std::vector<Function *> &getColdList() const { return coldList; }
+    /** Taken branches into each block, as sampled. */
+    const std::map<Block *, uint64_t> &getBlockCounts() const
+        { return blockCount; }
+private:
+    void countBlocks(Function *function,
+        std::map<Block *, Successor> &successors);
+    Successor getSuccessor(Block *block, bool *canMove);
+    void makeFallThrough(Block *block, Block *next, Block *fallThrough);
+};
+
+#endif
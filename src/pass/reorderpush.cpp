@@ -3,7 +3,7 @@
 #include <vector>
 #include <map>
 #include "reorderpush.h"
-#include "analysis/frametype.h"
+#include "analysis/analysiscache.h"
 #include "analysis/reachingdef.h"
 #include "chunk/module.h"
 #include "chunk/function.h"
@@ -29,11 +29,12 @@ void ReorderPush::visit(Function *function) {
 #ifdef ARCH_X86_64
     LOG(1, "ReorderPush for [" << function->getName());
 
-    FrameType frameType(function);
-    //frameType.dump();
+    auto analysis = AnalysisCache::getInstance()->get(function);
+    auto frameType = analysis->getFrameType();
+    //frameType->dump();
 
-    auto prologueEnd = frameType.getSetSPInstr();
-    auto epilogueStartList = frameType.getResetSPInstrs();
+    auto prologueEnd = frameType->getSetSPInstr();
+    auto epilogueStartList = frameType->getResetSPInstrs();
     bool reorderPushes = (prologueEnd && !epilogueStartList.empty());
 
 #if 1  // enable this for super-conservative mode
@@ -1,6 +1,8 @@
 #include <cassert>
+#include <algorithm>
 #include "retpoline.h"
 #include "chunk/dump.h"
+#include "chunk/vtable.h"
 #include "instr/concrete.h"
 #include "instr/register.h"
 #include "disasm/disassemble.h"
@@ -11,7 +13,12 @@
 void RetpolinePass::visit(Module *module) {
 #ifdef ARCH_X86_64
     this->module = module;
+    if(promoteCount) findSlotTargets(module);
     recurse(module->getFunctionList());
+    if(promoteCount) {
+        LOG(1, "RetpolinePass: promoted " << promotedCount
+            << " indirect sites in " << module->getName());
+    }
 #endif
 }
 
@@ -19,6 +26,19 @@ void RetpolinePass::visit(Function *function) {
 #ifdef ARCH_X86_64
     if(function->getName().find("_ssse3") != std::string::npos) return;
 
+    if(promoteCount) {
+        std::vector<std::pair<Block *, Instruction *>> siteList;
+        for(auto block : CIter::children(function)) {
+            for(auto instr : CIter::children(block)) {
+                if(getCandidates(instr)) siteList.emplace_back(block, instr);
+            }
+        }
+        for(auto site : siteList) {
+            promote(function, site.first, site.second,
+                *getCandidates(site.second));
+        }
+    }
+
     for(auto block : CIter::children(function)) {
         for(auto instr : CIter::children(block)) {
             auto semantic = instr->getSemantic();
@@ -68,6 +88,206 @@ void RetpolinePass::log_instruction(Instruction *instr, const char *message) {
     }
 }
 
+void RetpolinePass::findSlotTargets(Module *module) {
+    slotTargets.clear();
+    if(!module->getVTableList()) return;
+
+    // entries are recorded from the address point on, so the index of an
+    // entry is its slot; secondary vtables just add noise to the counts
+    std::map<int64_t, std::map<Function *, size_t>> counts;
+    for(auto vtable : CIter::children(module->getVTableList())) {
+        int64_t slot = 0;
+        for(auto entry : CIter::children(vtable)) {
+            auto link = entry->getLink();
+            auto target = link ? dynamic_cast<Function *>(&*link->getTarget())
+                : nullptr;
+            if(target && target->getParent() == module->getFunctionList()) {
+                counts[slot][target] ++;
+            }
+            slot ++;
+        }
+    }
+
+    for(auto &it : counts) {
+        std::vector<std::pair<Function *, size_t>> list(
+            it.second.begin(), it.second.end());
+        std::stable_sort(list.begin(), list.end(),
+            [] (const std::pair<Function *, size_t> &a,
+                const std::pair<Function *, size_t> &b) {
+                return a.second > b.second;
+            });
+
+        auto &targets = slotTargets[it.first];
+        for(size_t i = 0; i < list.size() && i < promoteCount; i ++) {
+            targets.push_back(list[i].first);
+        }
+    }
+}
+
+const std::vector<Function *> *RetpolinePass::getCandidates(
+    Instruction *instr) {
+
+#ifdef ARCH_X86_64
+    auto semantic = instr->getSemantic();
+    auto v = dynamic_cast<IndirectControlFlowInstructionBase *>(semantic);
+    if(!v || !v->hasMemoryOperand()) return nullptr;
+    if(auto jump = dynamic_cast<IndirectJumpInstruction *>(semantic)) {
+        if(jump->isForJumpTable()) return nullptr;
+    }
+    else if(!dynamic_cast<IndirectCallInstruction *>(semantic)) {
+        return nullptr;
+    }
+
+    // only disp(%reg), with a base that the comparison does not clobber
+    auto reg = X86Register::convertToPhysical(v->getRegister());
+    if(v->getRegister() == X86_REG_RIP || reg == X86Register::INVALID
+        || reg == 11) {
+
+        return nullptr;
+    }
+    if(X86Register::convertToPhysical(v->getIndexRegister())
+        != X86Register::INVALID) {
+
+        return nullptr;
+    }
+    auto disp = v->getDisplacement();
+    if(disp < 0 || disp % 8 != 0) return nullptr;
+
+    // a call has to return to the block after it
+    if(dynamic_cast<IndirectCallInstruction *>(semantic)
+        && !instr->getParent()->getNextSibling()) {
+
+        return nullptr;
+    }
+
+    auto found = slotTargets.find(disp / 8);
+    if(found == slotTargets.end() || found->second.empty()) return nullptr;
+    return &found->second;
+#else
+    return nullptr;
+#endif
+}
+
+void RetpolinePass::promote(Function *function, Block *block,
+    Instruction *instr, const std::vector<Function *> &candidates) {
+
+#ifdef ARCH_X86_64
+    auto &handle = DisasmHandle::forThread();
+    auto semantic = static_cast<IndirectControlFlowInstructionBase *>(
+        instr->getSemantic());
+    bool isCall = dynamic_cast<IndirectCallInstruction *>(semantic);
+    auto reg = X86Register::convertToPhysical(semantic->getRegister());
+    int64_t displacement = semantic->getDisplacement();
+
+    log_instruction(instr, "promoting:");
+
+    // cmp %r11, disp(%reg)
+    std::vector<unsigned char> cmpBytes;
+    cmpBytes.push_back(reg >= 8 ? 0x4d : 0x4c);
+    cmpBytes.push_back(0x39);
+    cmpBytes.push_back(0x98 | (reg & 7));
+    if((reg & 7) == 4) cmpBytes.push_back(0x24);
+    for(int i = 0; i < 4; i ++) {
+        cmpBytes.push_back(displacement & 0xff);
+        displacement >>= 8;
+    }
+
+    // for a call, each match returns to the original continuation:
+    //     lea f1(%rip), %r11           (reuses the call instruction)
+    //     cmp %r11, disp(%reg)
+    //     jne next1
+    //     call f1
+    //     jmp continuation
+    // next1:
+    //     ...
+    //     call *disp(%reg)             (through the retpoline later)
+    // a jump just branches to the match instead, with je f1.
+    Instruction *continuation = nullptr;
+    if(isCall) {
+        auto next = static_cast<Block *>(block->getNextSibling());
+        continuation = next->getChildren()->getIterable()->get(0);
+    }
+
+    std::vector<Instruction *> leaList;
+    for(size_t i = 0; i < candidates.size(); i ++) {
+        leaList.push_back(i == 0 ? instr : new Instruction());
+    }
+    auto fallback = new Instruction();
+
+    Block *previous = block;
+    auto appendBlock = [&] () {
+        auto newBlock = new Block();
+        ChunkMutator(function, true).insertAfter(previous, newBlock);
+        previous = newBlock;
+        return newBlock;
+    };
+
+    for(size_t i = 0; i < candidates.size(); i ++) {
+        auto target = candidates[i];
+        auto next = (i + 1 < candidates.size()) ? leaList[i + 1] : fallback;
+
+        auto leaInstr = leaList[i];
+        auto leaSem = new LinkedInstruction(leaInstr);
+        leaSem->setAssembly(DisassembleInstruction(handle).makeAssemblyPtr(
+            (std::vector<unsigned char>){0x4c, 0x8d, 0x1d, 0, 0, 0, 0}));
+        leaSem->setLink(new NormalLink(target, Link::SCOPE_EXTERNAL_JUMP));
+        leaSem->setIndex(0);
+
+        Block *compareBlock = block;
+        if(leaInstr == instr) {
+            instr->setSemantic(leaSem);
+            ChunkMutator(block, true).modifiedChildSize(instr,
+                leaSem->getSize() - semantic->getSize());
+        }
+        else {
+            leaInstr->setSemantic(leaSem);
+            compareBlock = appendBlock();
+            ChunkMutator(compareBlock, true).append(leaInstr);
+        }
+
+        auto cmpInstr = DisassembleInstruction(handle).instruction(cmpBytes);
+        ChunkMutator(compareBlock, true).append(cmpInstr);
+
+        auto branchInstr = new Instruction();
+        if(isCall) {
+            auto jne = new ControlFlowInstruction(
+                X86_INS_JNE, branchInstr, "\x0f\x85", "jne", 4);
+            jne->setLink(new NormalLink(next, Link::SCOPE_WITHIN_FUNCTION));
+            branchInstr->setSemantic(jne);
+            ChunkMutator(compareBlock, true).append(branchInstr);
+
+            auto callInstr = new Instruction();
+            auto callSem = new ControlFlowInstruction(
+                X86_INS_CALL, callInstr, "\xe8", "callq", 4);
+            callSem->setLink(new NormalLink(target, Link::SCOPE_EXTERNAL_JUMP));
+            callInstr->setSemantic(callSem);
+            ChunkMutator(appendBlock(), true).append(callInstr);
+
+            auto jmpInstr = new Instruction();
+            auto jmpSem = new ControlFlowInstruction(
+                X86_INS_JMP, jmpInstr, "\xe9", "jmp", 4);
+            jmpSem->setLink(new NormalLink(continuation,
+                Link::SCOPE_WITHIN_FUNCTION));
+            jmpInstr->setSemantic(jmpSem);
+            ChunkMutator(appendBlock(), true).append(jmpInstr);
+        }
+        else {
+            auto je = new ControlFlowInstruction(
+                X86_INS_JE, branchInstr, "\x0f\x84", "je", 4);
+            je->setLink(new NormalLink(target, Link::SCOPE_EXTERNAL_JUMP));
+            branchInstr->setSemantic(je);
+            ChunkMutator(compareBlock, true).append(branchInstr);
+        }
+    }
+
+    fallback->setSemantic(semantic);
+    ChunkMutator(appendBlock(), true).append(fallback);
+    promotedCount ++;
+
+    log_instruction(fallback, "fallback:");
+#endif
+}
+
 Function *RetpolinePass::makeOutlinedTrampoline(Module *module, Instruction *instr) {
 #ifdef ARCH_X86_64
     StreamAsString nameStream;
@@ -167,7 +387,7 @@ Function *RetpolinePass::makeOutlinedTrampoline(Module *module, Instruction *ins
 
             auto retIns = new Instruction();
             auto retSem = new ReturnInstruction();
-            static DisasmHandle handle(true);
+            auto &handle = DisasmHandle::forThread();
             retSem->setAssembly(AssemblyPtr(DisassembleInstruction(handle)
                 .makeAssemblyPtr((std::vector<unsigned char>){0xc3})));
             retIns->setSemantic(retSem);
@@ -6,17 +6,35 @@
 #include <string>
 #include "chunkpass.h"
 
+/** Replaces indirect calls and jumps with calls through retpolines.
+
+    With a promoteCount, a virtual call through a vtable slot, such as
+    call *0x18(%rax), first compares the loaded pointer against the most
+    common functions in that slot across the module's vtables, and calls
+    a match directly; only the remaining targets go through the
+    retpoline. The comparison makes this correct whatever the candidates
+    are. %r11 is used as scratch, as the retpolines already do.
+*/
 class RetpolinePass : public ChunkPass {
 private:
     std::map<std::string, Function *> retpolineList;
     Module *module;
+    size_t promoteCount;
+    // vtable slot -> candidate targets, most common first
+    std::map<int64_t, std::vector<Function *>> slotTargets;
+    size_t promotedCount;
 public:
-    RetpolinePass() : module(nullptr) {}
+    RetpolinePass(size_t promoteCount = 0) : module(nullptr),
+        promoteCount(promoteCount), promotedCount(0) {}
     virtual void visit(Module *module);
 protected:
     virtual void visit(Function *function);
 private:
     void log_instruction(Instruction *instr, const char *message);
+    void findSlotTargets(Module *module);
+    const std::vector<Function *> *getCandidates(Instruction *instr);
+    void promote(Function *function, Block *block,
+        Instruction *instr, const std::vector<Function *> &candidates);
     Function *makeOutlinedTrampoline(Module *module, Instruction *instr);
     std::vector<Instruction *> makeMovInstruction(Instruction *instr);
 };
@@ -2,20 +2,40 @@
 #define EGALITO_PASS_RUN_H
 
 #include "util/timing.h"
+#include "util/passprofile.h"
+#include "util/alloctrack.h"
 
+/* RUN_PASS_PARALLEL is for ParallelChunkPass subclasses only, and needs
+    pass/parallelpass.h to be included at the point of use.
+*/
 #if 1  // enable pass profiling
     #define RUN_PASS(passConstructor, module) \
         { \
             EgalitoTiming timing(#passConstructor); \
+            PassProfileScope profile(#passConstructor, module); \
+            ALLOCATION_SCOPE(#passConstructor); \
             auto pass = passConstructor; \
             module->accept(&pass); \
         }
+    #define RUN_PASS_PARALLEL(passConstructor, module) \
+        { \
+            EgalitoTiming timing(#passConstructor); \
+            PassProfileScope profile(#passConstructor, module); \
+            ALLOCATION_SCOPE(#passConstructor); \
+            runParallelChunkPass<decltype(passConstructor)>(module, \
+                [&] () { return passConstructor; }); \
+        }
 #else
     #define RUN_PASS(passConstructor, module) \
         { \
             auto pass = passConstructor; \
             module->accept(&pass); \
         }
+    #define RUN_PASS_PARALLEL(passConstructor, module) \
+        { \
+            runParallelChunkPass<decltype(passConstructor)>(module, \
+                [&] () { return passConstructor; }); \
+        }
 #endif
 
 #endif
@@ -1,6 +1,7 @@
 #include <vector>
 #include <cassert>
 #include "shadowstack.h"
+#include "analysis/frametype.h"
 #include "disasm/disassemble.h"
 #include "instr/register.h"
 #include "instr/concrete.h"
@@ -10,6 +11,8 @@
 #include "pass/switchcontext.h"
 #include "types.h"
 
+#include "log/log.h"
+
 void ShadowStackPass::visit(Program *program) {
     auto allocateFunc = ChunkFind2(program).findFunction(
         mode == MODE_GS ? "egalito_allocate_shadow_stack_gs"
@@ -109,6 +112,12 @@ void ShadowStackPass::visit(Function *function) {
     // sphinx3, function does tail recursion to itself
     if(function->getName() == "mdef_phone_id") return;
 
+    // the entry push and every pop are skipped together
+    if(elideLeaves && FrameType::isSafeLeaf(function)) {
+        LOG(10, "no shadow stack needed for leaf " << function->getName());
+        return;
+    }
+
     pushToShadowStack(function);
     recurse(function);
 }
@@ -3,6 +3,12 @@
 
 #include "chunkpass.h"
 
+/** Keeps a copy of each return address, pushed on entry and checked
+    before every return or tail jump.
+
+    With elideLeaves, functions that can't overwrite their own return
+    address are left alone (see FrameType::isSafeLeaf()).
+*/
 class ShadowStackPass : public ChunkPass {
 public:
     enum Mode {
@@ -11,10 +17,12 @@ public:
     };
 private:
     Mode mode;
+    bool elideLeaves;
     Function *violationTarget;
     Function *entryPoint;
 public:
-    ShadowStackPass(Mode mode = MODE_CONST) : mode(mode),
+    ShadowStackPass(Mode mode = MODE_CONST, bool elideLeaves = false)
+        : mode(mode), elideLeaves(elideLeaves),
         violationTarget(nullptr), entryPoint(nullptr) {}
     virtual void visit(Program *program);
     virtual void visit(Module *module);
@@ -0,0 +1,95 @@
+#include <capstone/capstone.h>
+#include "shortenjumps.h"
+#include "promotejumps.h"
+#include "chunk/concrete.h"
+#include "operation/mutator.h"
+#include "instr/concrete.h"
+
+#include "log/log.h"
+
+// every pass can only shrink the function, so this is just a safety net
+#define MAX_ITERATIONS  16
+
+void ShortenJumpsPass::visit(Program *program) {
+    recurse(program);
+    LOG(1, "shortened jumps, saving " << saved << " bytes");
+}
+
+void ShortenJumpsPass::visit(Function *function) {
+    int iterations = 0;
+    do {
+        changed = false;
+        recurse(function);
+    } while(changed && ++ iterations < MAX_ITERATIONS);
+}
+
+void ShortenJumpsPass::visit(Instruction *instruction) {
+#ifdef ARCH_X86_64
+    auto v = dynamic_cast<ControlFlowInstruction *>(instruction->getSemantic());
+    if(!v || !v->getLink()) return;
+    if(v->getDisplacementSize() != 4) return;
+
+    // other functions may still move relative to this one
+    auto link = v->getLink();
+    if(link->isExternalJump()) return;
+    auto function = instruction->getParent()->getParent();
+    Chunk *target = link->getTarget();
+    while(target && target != function) target = target->getParent();
+    if(!target) return;
+
+    if(getNarrowerOpcode(v->getId()).empty()) return;
+
+    // the displacement is measured from the end of the instruction; for a
+    // forward jump the target moves back by as much as the end does, and
+    // a backward one only gets closer, so the current value is safe
+    address_t disp = v->calculateDisplacement();
+    if(PromoteJumpsPass::fitsIn<signed char>(disp)) {
+        shorten(instruction);
+    }
+#endif
+}
+
+void ShortenJumpsPass::shorten(Instruction *instruction) {
+    changed = true;
+#ifdef ARCH_X86_64
+    LOG(10, "shorten jump instruction " << instruction->getName());
+    auto v = dynamic_cast<ControlFlowInstruction *>(instruction->getSemantic());
+
+    size_t oldSize = v->getSize();
+
+    v->setOpcode(getNarrowerOpcode(v->getId()));
+    v->setDisplacementSize(1);
+
+    saved += oldSize - v->getSize();
+    ChunkMutator(instruction->getParent())
+        .modifiedChildSize(instruction, v->getSize() - oldSize);
+#endif
+}
+
+std::string ShortenJumpsPass::getNarrowerOpcode(unsigned int id) {
+    std::string opcode;
+#define WRITE_BYTE(b) opcode += static_cast<unsigned char>(b)
+    switch(id) {
+    case X86_INS_JMP:     WRITE_BYTE(0xeb); break;
+    case X86_INS_JA:      WRITE_BYTE(0x77); break;
+    case X86_INS_JAE:     WRITE_BYTE(0x73); break;
+    case X86_INS_JB:      WRITE_BYTE(0x72); break;
+    case X86_INS_JBE:     WRITE_BYTE(0x76); break;
+    case X86_INS_JG:      WRITE_BYTE(0x7f); break;
+    case X86_INS_JGE:     WRITE_BYTE(0x7d); break;
+    case X86_INS_JL:      WRITE_BYTE(0x7c); break;
+    case X86_INS_JLE:     WRITE_BYTE(0x7e); break;
+    case X86_INS_JNO:     WRITE_BYTE(0x71); break;
+    case X86_INS_JNP:     WRITE_BYTE(0x7b); break;
+    case X86_INS_JNS:     WRITE_BYTE(0x79); break;
+    case X86_INS_JO:      WRITE_BYTE(0x70); break;
+    case X86_INS_JP:      WRITE_BYTE(0x7a); break;
+    case X86_INS_JS:      WRITE_BYTE(0x78); break;
+    case X86_INS_JE:      WRITE_BYTE(0x74); break;
+    case X86_INS_JNE:     WRITE_BYTE(0x75); break;
+    default:
+        break;  // calls have no rel8 form
+    }
+#undef WRITE_BYTE
+    return opcode;
+}
@@ -0,0 +1,32 @@
+#ifndef EGALITO_PASS_SHORTEN_JUMPS_H
+#define EGALITO_PASS_SHORTEN_JUMPS_H
+
+#include "chunkpass.h"
+
+/** Narrows rel32 jumps within a function back to rel8 wherever the
+    displacement fits; the inverse of PromoteJumpsPass, which must run
+    first. This whole pass is x86_64-specific.
+
+    Only targets in the same function are considered. Their displacement
+    depends only on the layout of the function itself, so this can run
+    before addresses are assigned, and narrowing one jump never makes
+    another one's displacement larger: the pass iterates to a fixpoint.
+*/
+class ShortenJumpsPass : public ChunkPass {
+private:
+    bool changed;
+    size_t saved;
+public:
+    ShortenJumpsPass() : changed(false), saved(0) {}
+    virtual void visit(Program *program);
+    virtual void visit(Module *module) { recurse(module->getFunctionList()); }
+    virtual void visit(Function *function);
+    virtual void visit(Instruction *instruction);
+
+    size_t getBytesSaved() const { return saved; }
+private:
+    void shorten(Instruction *instruction);
+    static std::string getNarrowerOpcode(unsigned int id);
+};
+
+#endif
@@ -2,10 +2,10 @@
 #define EGALITO_PASS_SPLIT_BASIC_BLOCK_H
 
 #include <set>
-#include "chunkpass.h"
+#include "parallelpass.h"
 #include "elf/reloc.h"
 
-class SplitBasicBlock : public ChunkPass {
+class SplitBasicBlock : public ParallelChunkPass {
 private:
     std::set<Instruction *> splitPoints;
 public:
@@ -2,6 +2,7 @@
 #include <string>
 #include <assert.h>
 #include "stackextend.h"
+#include "analysis/analysiscache.h"
 #include "analysis/frametype.h"
 #include "analysis/jumptable.h"
 #include "analysis/usedefutil.h"
@@ -13,6 +14,7 @@
 #include "chunk/dump.h"
 #include "disasm/makesemantic.h"
 #include "instr/concrete.h"
+#include "instr/template.h"
 #include "disasm/disassemble.h"
 #include "operation/mutator.h"
 #include "log/log.h"
@@ -41,7 +43,9 @@ void StackExtendPass::visit(Module *module) {
 void StackExtendPass::visit(Function *function) {
     if(!shouldApply(function)) return;
 
-    FrameType frame(function);
+    // our own copy, since adding instructions edits the epilogue list
+    FrameType frame(*AnalysisCache::getInstance()->get(function)
+        ->getFrameType());
     IF_LOG(10) frame.dump();
 
     if(extendSize > 0) {
@@ -216,25 +220,13 @@ void StackExtendPass::extendStack(Function *function, FrameType *frame) {
     auto firstB = function->getChildren()->getIterable()->get(0);
     if(!saveList.empty()) {
         for(auto r : saveList) {
-            std::vector<unsigned char> pushBin;
-            if(r >= 8) {
-                pushBin.push_back(0x41);
-                pushBin.push_back(0x50 + r - 8);
-            }
-            else {
-                pushBin.push_back(0x50 + r);
-            }
-            auto pushIns = Disassemble::instruction(pushBin);
+            auto pushIns = InstrTemplate::make(InstrTemplate::push(r));
             ChunkMutator(firstB).prepend(pushIns);
         }
     }
     else {
-        std::vector<unsigned char> bin_sub = {0x48, 0x83, 0xec};
-        for(int s = sizeof(int) * 4 - 8; s >= 0; s -= 8) {
-            unsigned char c = (extendSize >> s) & 0xff;
-            if(c) bin_sub.push_back(c);
-        }
-        ChunkMutator(firstB).prepend(Disassemble::instruction(bin_sub));
+        ChunkMutator(firstB).prepend(
+            InstrTemplate::make(InstrTemplate::subStack(extendSize)));
     }
 
     // epilogue -- add $0x8,%rsp
@@ -244,29 +236,16 @@ void StackExtendPass::extendStack(Function *function, FrameType *frame) {
             // insertion point to be equivalent to insertBefore(ins, .)
             auto insPoint = ins;
             for(auto r : saveList) {
-                std::vector<unsigned char> popBin;
-                if(r >= 8) {
-                    popBin.push_back(0x41);
-                    popBin.push_back(0x58 + r - 8);
-                }
-                else {
-                    popBin.push_back(0x58 + r);
-                }
-                auto popIns = Disassemble::instruction(popBin);
+                auto popIns = InstrTemplate::make(InstrTemplate::pop(r));
                 ChunkMutator(ins->getParent()).insertBeforeJumpTo(insPoint, popIns);
                 insPoint = popIns;
             }
         }
     }
     else {
-        std::vector<unsigned char> bin_add = {0x48, 0x83, 0xc4};
-        for(int s = sizeof(int) * 4 - 8; s >= 0; s -= 8) {
-            unsigned char c = (extendSize >> s) & 0xff;
-            if(c) bin_add.push_back(c);
-        }
         for(auto ins : frame->getEpilogueInstrs()) {
             ChunkMutator(ins->getParent()).insertBefore(ins,
-                Disassemble::instruction(bin_add));
+                InstrTemplate::make(InstrTemplate::addStack(extendSize)));
         }
     }
 #endif
@@ -1,10 +1,19 @@
 #include <sstream>
 #include "stackxor.h"
+#include "analysis/frametype.h"
 #include "disasm/disassemble.h"
 #include "operation/mutator.h"
 #include "instr/concrete.h"
+#include "log/log.h"
 
 void StackXOR::visit(Function *function) {
+    // the entry XOR and every exit XOR are skipped together
+    if(elideLeaves && FrameType::isSafeLeaf(function)) {
+        LOG(10, "no return address XOR needed for leaf "
+            << function->getName());
+        return;
+    }
+
     auto block1 = function->getChildren()->getIterable()->get(0);
     Instruction *first = nullptr;
     if(block1->getChildren()->getIterable()->getCount() > 0) {
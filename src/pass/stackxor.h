@@ -4,11 +4,20 @@
 #include "chunkpass.h"
 #include "chunk/concrete.h"
 
+/** XORs the return address with a per-thread key at %fs:xorOffset (the
+    stack guard, at 0x28) on entry, and again before every return or tail
+    jump.
+
+    With elideLeaves, functions that can't overwrite their own return
+    address are left alone (see FrameType::isSafeLeaf()).
+*/
 class StackXOR : public ChunkPass {
 private:
     int xorOffset;
+    bool elideLeaves;
 public:
-    StackXOR(int xorOffset) : xorOffset(xorOffset) {}
+    StackXOR(int xorOffset, bool elideLeaves = false)
+        : xorOffset(xorOffset), elideLeaves(elideLeaves) {}
     virtual void visit(Function *function);
     virtual void visit(Block *block);
     virtual void visit(Instruction *instruction);
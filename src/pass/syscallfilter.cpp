@@ -0,0 +1,102 @@
+#include <cstddef>  // for offsetof
+#include <cerrno>
+#include <cstdint>
+#include <sys/prctl.h>
+#include <linux/audit.h>
+#include <linux/seccomp.h>
+#include "syscallfilter.h"
+#include "findsyscalls.h"
+#include "log/log.h"
+
+#define FILTER_ALLOW    (SECCOMP_RET_ALLOW)
+#define FILTER_DENY     (SECCOMP_RET_ERRNO | (EPERM & SECCOMP_RET_DATA))
+
+void SyscallFilterPass::visit(Program *program) {
+#ifdef ARCH_X86_64
+    FindSyscalls findSyscalls;
+    program->accept(&findSyscalls);
+
+    for(auto kv : findSyscalls.getNumberMap()) {
+        for(auto number : kv.second) {
+            // seccomp_data.nr is an int
+            if(number <= 0xffffffffUL) allowed.insert(number);
+        }
+    }
+
+    auto unknown = findSyscalls.getUnknownSet().size();
+    if(unknown > 0) {
+        LOG(0, "WARNING: " << std::dec << unknown
+            << " system calls could not be identified, not making a filter");
+        complete = false;
+    }
+    LOG(1, "allowing " << std::dec << allowed.size() << " system calls");
+#else
+    LOG(0, "seccomp filters are only supported on x86_64");
+    complete = false;
+#endif
+}
+
+std::vector<sock_filter> SyscallFilterPass::makeFilter() const {
+    std::vector<sock_filter> filter;
+    if(!complete) return filter;
+
+#ifdef ARCH_X86_64
+    // system call numbers only mean something for the expected ABI
+    filter.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+        offsetof(struct seccomp_data, arch)));
+    filter.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,
+        AUDIT_ARCH_X86_64, 1, 0));
+    filter.push_back(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_KILL));
+
+    filter.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+        offsetof(struct seccomp_data, nr)));
+
+    std::vector<uint32_t> list(allowed.begin(), allowed.end());
+    if(list.empty()) {
+        filter.push_back(BPF_STMT(BPF_RET | BPF_K, FILTER_DENY));
+    }
+    else makeSearch(filter, list, 0, list.size());
+
+    if(filter.size() > BPF_MAXINSNS) {
+        LOG(0, "WARNING: seccomp filter is too large, not using it");
+        filter.clear();
+    }
+#endif
+    return filter;
+}
+
+void SyscallFilterPass::makeSearch(std::vector<sock_filter> &filter,
+    const std::vector<uint32_t> &list, size_t begin, size_t end) const {
+
+    if(end - begin == 1) {
+        filter.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,
+            list[begin], 0, 1));
+        filter.push_back(BPF_STMT(BPF_RET | BPF_K, FILTER_ALLOW));
+        filter.push_back(BPF_STMT(BPF_RET | BPF_K, FILTER_DENY));
+        return;
+    }
+
+    // conditional jumps only reach 255 instructions ahead, so the upper
+    // half is reached with an unconditional jump over the lower half
+    size_t middle = begin + (end - begin) / 2;
+    filter.push_back(BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K,
+        list[middle], 0, 1));
+    size_t skip = filter.size();
+    filter.push_back(BPF_STMT(BPF_JMP | BPF_JA, 0));
+
+    makeSearch(filter, list, begin, middle);
+    filter[skip].k = filter.size() - (skip + 1);
+    makeSearch(filter, list, middle, end);
+}
+
+bool SyscallFilterPass::install(const std::vector<sock_filter> &filter) {
+    if(filter.empty()) return false;
+
+    struct sock_fprog fprog;
+    fprog.len = filter.size();
+    fprog.filter = const_cast<sock_filter *>(filter.data());
+
+    // required to install a filter without CAP_SYS_ADMIN
+    if(prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) != 0) return false;
+    return prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &fprog) == 0;
+}
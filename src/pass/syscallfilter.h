@@ -0,0 +1,44 @@
+#ifndef EGALITO_PASS_SYSCALL_FILTER_H
+#define EGALITO_PASS_SYSCALL_FILTER_H
+
+#include <set>
+#include <cstdint>
+#include <vector>
+#include <linux/filter.h>  // for sock_filter
+#include "chunkpass.h"
+
+/** Builds a seccomp-BPF filter that allows only the system calls that
+    FindSyscalls discovers in the Program. This is an alternative to
+    SyscallSandbox's enforcement calls: the kernel checks each system call
+    instead, so the rewritten code doesn't change.
+
+    Allowed numbers are matched by binary search, and any other system call
+    fails with EPERM. FindSyscalls only resolves system call numbers, so
+    arguments are not checked. If the number at some site can't be
+    determined, no filter is made, since it would break that site.
+*/
+class SyscallFilterPass : public ChunkPass {
+private:
+    std::set<unsigned long> allowed;
+    bool complete;
+public:
+    SyscallFilterPass() : complete(true) {}
+    virtual void visit(Program *program);
+
+    /** Allows a system call that is made outside the Program. */
+    void allow(unsigned long number) { allowed.insert(number); }
+    const std::set<unsigned long> &getAllowed() const { return allowed; }
+    bool isComplete() const { return complete; }
+
+    /** Returns an empty filter if some system call was not identified. */
+    std::vector<sock_filter> makeFilter() const;
+
+    /** Applies to the calling thread and the threads it creates. */
+    static bool install(const std::vector<sock_filter> &filter);
+private:
+    void makeSearch(std::vector<sock_filter> &filter,
+        const std::vector<uint32_t> &list, size_t begin,
+        size_t end) const;
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include <sstream>
+#include <cstdlib>  // for strtoul
 #include "syscallsandbox.h"
 #include "findsyscalls.h"
 #include "operation/find2.h"
@@ -6,9 +7,32 @@
 #include "chunk/block.h"
 #include "instr/instr.h"
 #include "instr/concrete.h"
+#include "instr/template.h"
 #include "disasm/disassemble.h"
+#include "util/bytescan.h"
 #include "log/log.h"
 
+void SyscallSandbox::visit(Module *module) {
+    trampolineList.clear();
+    recurse(module);
+
+    // added afterwards, so that the function list isn't changed during
+    // the recursion above
+    for(auto function : newFunctions) {
+        module->getFunctionList()->getChildren()->add(function);
+    }
+    if(!newFunctions.empty()) {
+        module->getFunctionList()->getChildren()->clearSpatial();
+    }
+    newFunctions.clear();
+
+    LOG(1, "sandboxed system calls in " << module->getName() << ": "
+        << std::dec << checkedCount << " checked, "
+        << uncheckedCount << " allowed without a check, "
+        << deniedCount << " denied");
+    checkedCount = uncheckedCount = deniedCount = 0;
+}
+
 void SyscallSandbox::visit(Function *function) {
     FindSyscalls findSyscalls;
     function->accept(&findSyscalls);
@@ -16,70 +40,106 @@ void SyscallSandbox::visit(Function *function) {
     for(auto kv : list) {
         auto syscallInstr = kv.first;
         auto syscallValues = kv.second;
-        if(syscallValues.size() != 1) {
+        bool isSyscall = BytePattern::getSyscall().isExactly(
+            syscallInstr->getSemantic()->getData());
+
+        if(syscallValues.size() == 1) {
+            if(auto func = findEnforcement(*syscallValues.begin())) {
+                addEnforcement(function, syscallInstr, func);
+                continue;
+            }
+        }
+
+        bool allowed;
+        if(isSyscall && isStaticallyAllowed(syscallValues, allowed)) {
+            if(allowed) uncheckedCount ++;
+            else addDenial(function, syscallInstr);
+            continue;
+        }
+
+        // calls to syscall() take the number in %rdi, which the default
+        // enforcement function doesn't know to look at
+        if(syscallValues.size() != 1 && !isSyscall) {
             LOG(1, "ERROR: expected one possible system call value, got "
                 << syscallValues.size() << " possibilities, at "
                 << syscallInstr->getName() << " inside ["
                 << syscallInstr->getParent()->getParent()->getName() << "]");
             continue;
         }
-        int value = static_cast<int>(*syscallValues.begin());
 
-        std::ostringstream name;
-        name << "egalito_sandbox_syscall_" << value;
+        if(auto func = findDefaultEnforcement()) {
+            addEnforcement(function, syscallInstr, func);
+        }
+    }
 
-        auto func = ChunkFind2(program).findFunction(name.str().c_str());
-        if (!func) {
-            func = ChunkFind2(program).findFunction("egalito_sandbox_syscall_default");
-            if(!func) {
-                LOG(2, "Looking for sandbox enforcement function [" << name.str()
-                    << "] or default handler, neither was found!");
-                continue;
-            }
+    // the number isn't known here, so only the default can decide
+    for(auto syscallInstr : findSyscalls.getUnknownSet()) {
+        if(!BytePattern::getSyscall().isExactly(
+            syscallInstr->getSemantic()->getData())) continue;
+
+        if(auto func = findDefaultEnforcement()) {
+            addEnforcement(function, syscallInstr, func);
         }
+    }
+}
 
-        addEnforcement(function, syscallInstr, func);
+std::set<unsigned long> SyscallSandbox::parseAllowList(const char *list) {
+    std::set<unsigned long> numbers;
+    while(*list) {
+        char *end;
+        auto value = std::strtoul(list, &end, 0);
+        if(end == list) break;
+        numbers.insert(value);
+        list = (*end == ',') ? end + 1 : end;
     }
+    return numbers;
+}
+
+bool SyscallSandbox::isStaticallyAllowed(
+    const std::set<unsigned long> &values, bool &allowed) {
+
+    if(!hasAllowList || values.empty()) return false;
+
+    size_t allowedCount = 0;
+    for(auto value : values) {
+        // a specific enforcement function may still need to run
+        if(findEnforcement(value)) return false;
+        allowedCount += allowList.count(value);
+    }
+
+    if(allowedCount == values.size()) allowed = true;
+    else if(allowedCount == 0) allowed = false;
+    else return false;  // depends on which one is made
+    return true;
+}
+
+Function *SyscallSandbox::findEnforcement(unsigned long value) {
+    std::ostringstream name;
+    name << "egalito_sandbox_syscall_" << value;
+    return ChunkFind2(program).findFunction(name.str().c_str());
+}
+
+Function *SyscallSandbox::findDefaultEnforcement() {
+    auto func = ChunkFind2(program).findFunction(
+        "egalito_sandbox_syscall_default");
+    if(!func) {
+        LOG(2, "Looking for sandbox enforcement function or default handler,"
+            " neither was found!");
+    }
+    return func;
 }
 
 void SyscallSandbox::addEnforcement(Function *function, Instruction *syscallInstr, Function*enforce) {
 #ifdef ARCH_X86_64
     /*
-           0:	57                   	push   %rdi
-           1:	48 89 e7             	mov    %rsp,%rdi
-           4:	48 83 e4 f0          	and    $0xfffffffffffffff0,%rsp
-           8:	57                   	push   %rdi
-           9:	48 8b 7c 24 08       	mov    0x8(%rsp),%rdi
-           e:	56                   	push   %rsi
-           f:	52                   	push   %rdx
-          10:	41 52                	push   %r10
-          12:	41 50                	push   %r8
-          14:	41 51                	push   %r9
-          16:	51                   	push   %rcx
-          17:	4c 89 d1             	mov    %r10,%rcx
-          1a:	50                   	push   %rax
-          1b:	90                   	nop
+                                        ; call trampoline
+           5:	4d 85 db             	test   %r11,%r11
+           8:	74 02                	je     c <skip>
 
-                                        ; call enforce
+           a:	0f 05                	syscall 
 
-          21:	49 89 c3             	mov    %rax,%r11
-          24:	58                   	pop    %rax
-          25:	59                   	pop    %rcx
-          26:	41 59                	pop    %r9
-          28:	41 58                	pop    %r8
-          2a:	41 5a                	pop    %r10
-          2c:	5a                   	pop    %rdx
-          2d:	5e                   	pop    %rsi
-          2e:	5f                   	pop    %rdi
-          2f:	48 89 fc             	mov    %rdi,%rsp
-          32:	5f                   	pop    %rdi
-          33:	4d 85 db             	test   %r11,%r11
-          36:	74 02                	je     3a <skip>
-
-          38:	0f 05                	syscall 
-
-        000000000000003a <skip>:
-          3a:	90                   	nop
+        000000000000000c <skip>:
+           c:	90                   	nop
     */
 
     auto epilogue = static_cast<Instruction *>(syscallInstr->getNextSibling());
@@ -95,13 +155,102 @@ void SyscallSandbox::addEnforcement(Function *function, Instruction *syscallInst
         m.splitBlockBefore(syscallInstr);
     }
 
+    ChunkMutator(block1, true).append(
+        InstrTemplate::makeCall(getTrampoline(enforce)));
+
+    auto block3 = static_cast<Block*>(epilogue->getParent());
+
     {
-        ChunkMutator bm(block1, true);
+        auto block2 = new Block();
+        ChunkMutator(function, true).insertAfter(block1, block2);
+
+        ChunkMutator bm(block2, true);
+        bm.append(Disassemble::instruction({0x4d, 0x85, 0xdb}));    // test %r11, %r11
+
+        // create new near 1-byte jz instruction
+        auto jmpIns = new Instruction();
+        auto jmpSem
+            = new ControlFlowInstruction(X86_INS_JE, jmpIns, "\x74", "je", 1);
+        jmpSem->setLink(new NormalLink(block3, Link::SCOPE_INTERNAL_JUMP));
+        jmpIns->setSemantic(jmpSem);
+        bm.append(jmpIns);
+    }
+
+    //ChunkMutator(function, true);  // recalculate everything
+
+    LOG(9, "Adding sandbox enforcement to syscall in [" << function->getName() << "]");
+    checkedCount ++;
+#endif
+}
+
+void SyscallSandbox::addDenial(Function *function, Instruction *syscallInstr) {
+#ifdef ARCH_X86_64
+    // mov $-EPERM, %rax, which is what a denied system call returns
+    DisasmHandle handle(true);
+    auto oldSemantic = syscallInstr->getSemantic();
+    auto semantic = DisassembleInstruction(handle).instructionSemantic(
+        syscallInstr, std::vector<unsigned char>{
+            0x48, 0xc7, 0xc0, 0xff, 0xff, 0xff, 0xff});
+    syscallInstr->setSemantic(semantic);
+    ChunkMutator(syscallInstr->getParent(), true).modifiedChildSize(
+        syscallInstr, semantic->getSize() - oldSemantic->getSize());
+    delete oldSemantic;
+
+    LOG(9, "Denying syscall in [" << function->getName() << "]");
+    deniedCount ++;
+#endif
+}
+
+Function *SyscallSandbox::getTrampoline(Function *enforce) {
+#ifdef ARCH_X86_64
+    auto found = trampolineList.find(enforce);
+    if(found != trampolineList.end()) return (*found).second;
+
+    /*
+           0:	57                   	push   %rdi
+           1:	48 89 e7             	mov    %rsp,%rdi
+           4:	48 83 e4 f0          	and    $0xfffffffffffffff0,%rsp
+           8:	57                   	push   %rdi
+           9:	48 8b 3f             	mov    (%rdi),%rdi
+           c:	56                   	push   %rsi
+           d:	52                   	push   %rdx
+           e:	41 52                	push   %r10
+          10:	41 50                	push   %r8
+          12:	41 51                	push   %r9
+          14:	51                   	push   %rcx
+          15:	4c 89 d1             	mov    %r10,%rcx
+          18:	50                   	push   %rax
+
+                                        ; call enforce
+
+          1e:	49 89 c3             	mov    %rax,%r11
+          21:	58                   	pop    %rax
+          22:	59                   	pop    %rcx
+          23:	41 59                	pop    %r9
+          25:	41 58                	pop    %r8
+          27:	41 5a                	pop    %r10
+          29:	5a                   	pop    %rdx
+          2a:	5e                   	pop    %rsi
+          2b:	5f                   	pop    %rdi
+          2c:	48 89 fc             	mov    %rdi,%rsp
+          2f:	5f                   	pop    %rdi
+          30:	c3                   	retq
+    */
+
+    auto function = new Function();
+    function->setName("egalito_sandbox_trampoline_" + enforce->getName());
+    function->setPosition(new AbsolutePosition(0x100));
+
+    auto block = new Block();
+    ChunkMutator(function).append(block);
+
+    {
+        ChunkMutator bm(block);
         bm.append(Disassemble::instruction({0x57}));    // push %rdi
         bm.append(Disassemble::instruction({0x48, 0x89, 0xe7}));    // mov %rsp, %rdi
         bm.append(Disassemble::instruction({0x48, 0x83, 0xe4, 0xf0}));    // and $-0x10, %rsp
         bm.append(Disassemble::instruction({0x57}));    // push %rdi
-        bm.append(Disassemble::instruction({0x48, 0x8b, 0x7c, 0x24, 0x08}));    // mov 0x8(%rsp),%rdi
+        bm.append(Disassemble::instruction({0x48, 0x8b, 0x3f}));    // mov (%rdi),%rdi
         bm.append(Disassemble::instruction({0x56}));    // push %rsi
         bm.append(Disassemble::instruction({0x52}));    // push %rdx
         bm.append(Disassemble::instruction({0x41, 0x52}));    // push %r10
@@ -111,21 +260,8 @@ void SyscallSandbox::addEnforcement(Function *function, Instruction *syscallInst
         bm.append(Disassemble::instruction({0x4c, 0x89, 0xd1}));    // mov %r10, %rcx
         bm.append(Disassemble::instruction({0x50}));    // push %rax
 
-        auto callIns = new Instruction();
-        auto callSem
-            = new ControlFlowInstruction(X86_INS_CALL, callIns, "\xe8", "callq", 4);
-        callSem->setLink(new NormalLink(enforce, Link::SCOPE_EXTERNAL_JUMP));
-        callIns->setSemantic(callSem);
-        bm.append(callIns);
-    }
+        bm.append(InstrTemplate::makeCall(enforce));
 
-    auto block3 = static_cast<Block*>(epilogue->getParent());
-
-    {
-        auto block2 = new Block();
-        ChunkMutator(function, true).insertAfter(block1, block2);
-
-        ChunkMutator bm(block2, true);
         bm.append(Disassemble::instruction({0x49, 0x89, 0xc3}));    // mov %rax, %r11
         bm.append(Disassemble::instruction({0x58}));    // pop %rax
         bm.append(Disassemble::instruction({0x59}));    // pop %rcx
@@ -137,19 +273,14 @@ void SyscallSandbox::addEnforcement(Function *function, Instruction *syscallInst
         bm.append(Disassemble::instruction({0x5f}));    // pop %rdi
         bm.append(Disassemble::instruction({0x48, 0x89, 0xfc}));    // mov %rdi, %rsp
         bm.append(Disassemble::instruction({0x5f}));    // pop %rdi
-        bm.append(Disassemble::instruction({0x4d, 0x85, 0xdb}));    // test %r11, %r11
-
-        // create new near 1-byte jz instruction
-        auto jmpIns = new Instruction();
-        auto jmpSem
-            = new ControlFlowInstruction(X86_INS_JE, jmpIns, "\x74", "je", 1);
-        jmpSem->setLink(new NormalLink(block3, Link::SCOPE_INTERNAL_JUMP));
-        jmpIns->setSemantic(jmpSem);
-        bm.append(jmpIns);
+        bm.append(InstrTemplate::make(InstrTemplate::ret()));
     }
 
-    //ChunkMutator(function, true);  // recalculate everything
-
-    LOG(9, "Adding sandbox enforcement to syscall in [" << function->getName() << "]");
+    LOG(9, "Made sandbox trampoline [" << function->getName() << "]");
+    trampolineList[enforce] = function;
+    newFunctions.push_back(function);
+    return function;
+#else
+    return nullptr;
 #endif
 }
@@ -1,16 +1,52 @@
 #ifndef EGALITO_PASS_SYSCALL_SANDBOX_H
 #define EGALITO_PASS_SYSCALL_SANDBOX_H
 
+#include <map>
+#include <set>
+#include <vector>
 #include "chunkpass.h"
 
+/** Calls an enforcement function before each system call, and skips the
+    system call if it returns zero.
+
+    Saving and restoring the system call arguments takes about 50 bytes, so
+    it lives in one out-of-line trampoline per enforcement function and
+    Module. Each site only adds a call to the trampoline, a test and a jump.
+
+    A site that can only make one system call uses that call's enforcement
+    function (egalito_sandbox_syscall_N) if there is one. Other sites,
+    including those whose number FindSyscalls can't determine, use
+    egalito_sandbox_syscall_default. Given an allow list, sites whose
+    numbers are all known and have no enforcement function of their own
+    need no check at all: they are left alone if all their numbers are
+    allowed, or made to fail with EPERM if none are.
+*/
 class SyscallSandbox : public ChunkPass {
 private:
     Program *program;
+    std::map<Function *, Function *> trampolineList;  // enforce -> trampoline
+    std::vector<Function *> newFunctions;
+    std::set<unsigned long> allowList;
+    bool hasAllowList;
+    size_t checkedCount, uncheckedCount, deniedCount;
 public:
-    SyscallSandbox(Program *program) : program(program) {}
+    SyscallSandbox(Program *program) : program(program), hasAllowList(false),
+        checkedCount(0), uncheckedCount(0), deniedCount(0) {}
+    virtual void visit(Module *module);
     virtual void visit(Function *function);
+
+    void setAllowList(const std::set<unsigned long> &list)
+        { allowList = list; hasAllowList = true; }
+    /** Parses a comma-separated list of system call numbers. */
+    static std::set<unsigned long> parseAllowList(const char *list);
 private:   
+    bool isStaticallyAllowed(const std::set<unsigned long> &values,
+        bool &allowed);
+    Function *findEnforcement(unsigned long value);
+    Function *findDefaultEnforcement();
     void addEnforcement(Function *function, Instruction *syscallInstr, Function*enforce);
+    void addDenial(Function *function, Instruction *syscallInstr);
+    Function *getTrampoline(Function *enforce);
 };
 
 #endif
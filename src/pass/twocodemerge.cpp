@@ -1,8 +1,11 @@
 #include <cstring>  // for memset
 #include <typeinfo> // for typeid
+#include <sstream>
+#include <functional>  // for std::hash
 #include "twocodemerge.h"
 #include "chunk/link.h"
 #include "instr/semantic.h"
+#include "instr/writer.h"
 #include "operation/find2.h"
 #include "log/log.h"
 
@@ -20,15 +23,75 @@ void TwocodeMergePass::visit(Module *module) {
         LOG(0, "merging [" << otherFunc->getName() << "]");
 
         if(updateLinks(module, otherFunc)) {
-            transformed.push_back(otherFunc);
+            if(isShareable(func, otherFunc)) {
+                LOG(1, "    sharing identical [" << func->getName() << "]");
+                otherFunctions[func] = func;
+                sharedCount ++;
+            }
+            else {
+                otherFunctions[func] = otherFunc;
+                transformed.push_back(otherFunc);
+            }
         }
         else LOG(0, "    SOME UNHANDLED LINK TYPES ABOVE");
     }
 
+    LOG(0, "twocode: sharing " << sharedCount << " functions, copying "
+        << transformed.size());
     copyFunctionsTo(module);
     copyRegionsTo(module);
 }
 
+bool TwocodeMergePass::isShareable(Function *func, Function *otherFunc) {
+    if(func->getSize() != otherFunc->getSize()) return false;
+
+    auto content = getContent(func);
+    auto otherContent = getContent(otherFunc);
+    std::hash<std::string> hash;
+    return hash(content) == hash(otherContent) && content == otherContent;
+}
+
+std::string TwocodeMergePass::getContent(Function *function) {
+    // displacements are left out and the link targets appended instead:
+    // the functions were laid out at different addresses
+    std::string bytes;
+    std::ostringstream targets;
+    InstrWriterWithoutDisplacements<InstrWriterCppString> writer(bytes);
+    for(auto block : CIter::children(function)) {
+        for(auto instr : CIter::children(block)) {
+            instr->getSemantic()->accept(&writer);
+
+            auto link = instr->getSemantic()->getLink();
+            if(!link) continue;
+            targets << bytes.size() << ":";
+            if(dynamic_cast<ImmAndDispLink *>(link)) {
+                targets << "?" << instr << ";";  // never shared
+                continue;
+            }
+
+            auto target = &*link->getTarget();
+            if(target && target->getParent()
+                && target->getParent()->getParent() == function) {
+
+                // within the function, by offset
+                targets << "i" << (link->getTargetAddress()
+                    - function->getAddress()) << ";";
+            }
+            else if(dynamic_cast<DataOffsetLinkBase *>(link)) {
+                targets << "d" << target << "+" << (link->getTargetAddress()
+                    - target->getAddress()) << ";";
+            }
+            else if(target) {
+                targets << "c" << target << ";";
+            }
+            else {
+                targets << "a" << link->getTargetAddress() << ";";
+            }
+        }
+    }
+    return bytes + targets.str();
+}
+
 bool TwocodeMergePass::updateLinks(Module *module, Function *otherFunc) {
     auto program = static_cast<Program *>(module->getParent());
 
@@ -3,23 +3,39 @@
 
 #include <utility>
 #include <vector>
+#include <string>
 #include <set>
+#include <map>
 #include "chunkpass.h"
 #include "chunk/dataregion.h"
 #include "chunk/function.h"
 #include "chunk/gstable.h"
 
+/** Merges the functions of otherModule (the second code variant) into a
+    module, renamed with a $rhs suffix. A function whose code is the same in
+    both variants once its links are retargeted is not copied; both code
+    tables then point at the one copy.
+*/
 class TwocodeMergePass : public ChunkPass {
 private:
     Module *otherModule;
     std::vector<Function *> transformed;
     std::set<DataRegion *> regionsNeeded;
+    std::map<Function *, Function *> otherFunctions;  // lhs -> rhs variant
+    size_t sharedCount;
 public:
-    TwocodeMergePass(Module *otherModule) : otherModule(otherModule) {}
+    TwocodeMergePass(Module *otherModule) : otherModule(otherModule),
+        sharedCount(0) {}
 
     virtual void visit(Module *module);
+
+    /** Maps each merged function to its variant, or to itself if shared. */
+    const std::map<Function *, Function *> &getOtherFunctions() const
+        { return otherFunctions; }
 private:
     bool updateLinks(Module *module, Function *otherFunc);
+    bool isShareable(Function *func, Function *otherFunc);
+    std::string getContent(Function *function);
 
     void copyFunctionsTo(Module *module);
     void copyRegionsTo(Module *module);
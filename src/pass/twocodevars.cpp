@@ -65,9 +65,17 @@ void TwocodeVarsPass::visit(Module *module) {
 #if 1
             Function *newFunc = nullptr;
             if(auto origFunc = dynamic_cast<Function *>(entry->getTarget())) {
-                auto newName = origFunc->getName();
-                newFunc = ChunkFind2(program)
-                    .findFunctionInModule(newName.c_str(), otherModule);
+                auto it = otherFunctions.find(origFunc);
+                if(it != otherFunctions.end()) {
+                    // the merged variant, or origFunc itself if shared
+                    newFunc = (*it).second;
+                    entry->setOtherTarget(newFunc);
+                }
+                else {
+                    auto newName = origFunc->getName();
+                    newFunc = ChunkFind2(program)
+                        .findFunctionInModule(newName.c_str(), otherModule);
+                }
             }
             LOG(0, "    gs for " << entry->getTarget()->getName()
                 << " + $rhs => " << newFunc);
@@ -2,6 +2,7 @@
 #define EGALITO_PASS_TWOCODEVARS_H
 
 #include <utility>
+#include <map>
 #include "chunkpass.h"
 #include "chunk/dataregion.h"
 #include "chunk/function.h"
@@ -12,10 +13,15 @@ private:
     GSTable *gsTable;
     Module *otherModule;
     DataSection *gsSection;
+    std::map<Function *, Function *> otherFunctions;
 public:
     TwocodeVarsPass(GSTable *gsTable, Module *otherModule) : gsTable(gsTable),
         otherModule(otherModule), gsSection(nullptr) {}
 
+    /** Second-table targets, from TwocodeMergePass::getOtherFunctions(). */
+    void setOtherFunctions(const std::map<Function *, Function *> &map)
+        { otherFunctions = map; }
+
     virtual void visit(Module *module);
     DataSection *getGSSection() const { return gsSection; }
 private:
@@ -13,10 +13,15 @@
 
 void UpdateLink::visit(Function *function) {
     sourceFunction = function;
-    recurse(function);
+    CIter::forEachInstruction(function,
+        [this] (Instruction *instruction) { updateInstruction(instruction); });
 }
 
 void UpdateLink::visit(Instruction *instruction) {
+    updateInstruction(instruction);
+}
+
+void UpdateLink::updateInstruction(Instruction *instruction) {
     auto s = instruction->getSemantic();
     if(dynamic_cast<LinkedInstruction *>(s)
         || dynamic_cast<ControlFlowInstruction *>(s)) {
@@ -14,6 +14,7 @@ public:
     virtual void visit(Instruction *instruction);
     virtual void visit(DataRegion *dataRegion);
 private:
+    void updateInstruction(Instruction *instruction);
     Link *makeUpdateLink(Link *link, Function *source);
 };
 
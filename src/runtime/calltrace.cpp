@@ -0,0 +1,233 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <cstdlib>  // for getenv
+#include <cstring>
+#include <new>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include "calltrace.h"
+#include "chunk/concrete.h"
+
+#undef DEBUG_GROUP
+#define DEBUG_GROUP load
+#include "log/log.h"
+
+CallTracer *CallTracer::instance = nullptr;
+
+static void *allocate(size_t size) {
+    void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+        MAP_ANONYMOUS | MAP_PRIVATE | MAP_NORESERVE, -1, 0);
+    return (p == MAP_FAILED) ? nullptr : p;
+}
+
+static inline uint64_t readTimestamp() {
+#ifdef ARCH_X86_64
+    uint32_t low, high;
+    __asm__ __volatile__ ("rdtsc" : "=a"(low), "=d"(high));
+    return (static_cast<uint64_t>(high) << 32) | low;
+#elif defined(ARCH_AARCH64)
+    uint64_t value;
+    __asm__ __volatile__ ("mrs %0, cntvct_el0" : "=r"(value));
+    return value;
+#elif defined(ARCH_RISCV)
+    uint64_t value;
+    __asm__ __volatile__ ("rdtime %0" : "=r"(value));
+    return value;
+#endif
+}
+
+static inline address_t readThreadPointer() {
+    address_t value;
+#ifdef ARCH_X86_64
+    // the TCB's self pointer, distinct for every thread
+    __asm__ __volatile__ ("mov %%fs:0, %0" : "=r"(value));
+#elif defined(ARCH_AARCH64)
+    __asm__ __volatile__ ("mrs %0, tpidr_el0" : "=r"(value));
+#elif defined(ARCH_RISCV)
+    __asm__ __volatile__ ("mv %0, tp" : "=r"(value));
+#endif
+    return value;
+}
+
+bool CallTracer::start(Program *program) {
+    const char *file = getenv("EGALITO_LOG_CALL_TRACE");
+    if(!file || !*file) return false;
+    if(std::strlen(file) >= NAME_LIMIT) {
+        LOG(0, "EGALITO_LOG_CALL_TRACE filename is too long");
+        return false;
+    }
+
+    // placed in its own mapping, the loader's heap can't be used later
+    auto memory = allocate(sizeof(CallTracer));
+    if(!memory) return false;
+    auto tracer = new (memory) CallTracer();
+    if(!tracer->build(program, file)) return false;
+
+    instance = tracer;
+    LOG(1, "tracing calls into [" << file << "], " << std::dec
+        << tracer->entryCount << " functions");
+    return true;
+}
+
+bool CallTracer::build(Program *program, const char *file) {
+    std::vector<Function *> functionList;
+    for(auto module : CIter::modules(program)) {
+        for(auto function : CIter::functions(module)) {
+            if(!function->getAddress() || !function->getSize()) continue;
+            functionList.push_back(function);
+        }
+    }
+    std::sort(functionList.begin(), functionList.end(),
+        [] (Function *a, Function *b) {
+            return a->getAddress() < b->getAddress();
+        });
+
+    entryList = static_cast<Entry *>(
+        allocate(std::max<size_t>(functionList.size(), 1) * sizeof(Entry)));
+    ringList = static_cast<Ring *>(allocate(THREAD_LIMIT * sizeof(Ring)));
+    if(!entryList || !ringList) return false;
+    for(size_t i = 0; i < THREAD_LIMIT; i ++) new (&ringList[i]) Ring();
+
+    // the table is written once; later writes only append blocks
+    std::vector<FunctionRecord> table;
+    std::string names;
+    for(auto function : functionList) {
+        auto entry = &entryList[entryCount ++];
+        entry->start = function->getAddress();
+        entry->end = function->getAddress() + function->getSize();
+        entry->flushOnEntry = function->hasName("exit")
+            || function->hasName("_exit") || function->hasName("_Exit");
+        entry->flushOnExit = function->hasName("main");
+
+        FunctionRecord record;
+        record.address = function->getAddress();
+        record.size = function->getSize();
+        record.nameOffset = names.length();
+        table.push_back(record);
+        names.append(function->getName());
+        names.push_back('\0');
+    }
+
+    fd = open(file, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC,
+        0644);
+    if(fd < 0) {
+        LOG(0, "can't open [" << file << "] for call tracing");
+        return false;
+    }
+
+    FileHeader header;
+    std::memcpy(header.magic, "ECTR", 4);
+    header.version = 1;
+    header.functionCount = table.size();
+    header.namesSize = names.length();
+    struct iovec iov[3] = {
+        {&header, sizeof header},
+        {table.data(), table.size() * sizeof(FunctionRecord)},
+        {&names[0], names.length()},
+    };
+    (void)writev(fd, iov, 3);
+    return true;
+}
+
+CallTracer::Entry *CallTracer::find(address_t address) {
+    size_t low = 0, high = entryCount;
+    while(low < high) {
+        size_t middle = low + (high - low) / 2;
+        if(entryList[middle].start <= address) low = middle + 1;
+        else high = middle;
+    }
+    if(low == 0) return nullptr;
+    auto entry = &entryList[low - 1];
+    return (address < entry->end) ? entry : nullptr;
+}
+
+CallTracer::Ring *CallTracer::findRing() {
+    auto self = readThreadPointer();
+    size_t start = (self >> 12) % THREAD_LIMIT;
+    for(size_t i = 0; i < THREAD_LIMIT; i ++) {
+        auto ring = &ringList[(start + i) % THREAD_LIMIT];
+        auto owner = ring->owner.load(std::memory_order_acquire);
+        if(owner == self) return ring;
+        if(owner == 0 && ring->owner.compare_exchange_strong(owner, self)) {
+            return ring;
+        }
+    }
+    return nullptr;
+}
+
+bool CallTracer::record(address_t address, int dir) {
+    auto tracer = instance;
+    if(!tracer) return false;
+
+    auto ring = tracer->findRing();
+    if(!ring) return true;
+
+    // only this thread advances head; tail moves once a block is written
+    auto head = ring->head.load(std::memory_order_relaxed);
+    if(head - ring->tail.load(std::memory_order_acquire) >= RING_SIZE) {
+        tracer->flush(ring);
+        if(head - ring->tail.load(std::memory_order_acquire) >= RING_SIZE) {
+            // another thread is writing this ring out
+            ring->dropped.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    auto entry = tracer->find(address);
+    auto &record = ring->records[head % RING_SIZE];
+    record.timestamp = readTimestamp();
+    record.id = entry ? (entry - tracer->entryList) : UNKNOWN_ID;
+    record.direction = (dir > 0) ? DIRECTION_ENTRY : DIRECTION_EXIT;
+    ring->head.store(head + 1, std::memory_order_release);
+
+    if(entry && ((dir > 0 && entry->flushOnEntry)
+        || (dir < 0 && entry->flushOnExit))) {
+
+        tracer->flushAll();
+    }
+    else if(head + 1 - ring->tail.load(std::memory_order_relaxed)
+        >= RING_SIZE / 2) {
+
+        tracer->flush(ring);
+    }
+    return true;
+}
+
+void CallTracer::flush(Ring *ring) {
+    if(ring->flushing.exchange(true, std::memory_order_acquire)) return;
+
+    auto tail = ring->tail.load(std::memory_order_relaxed);
+    auto head = ring->head.load(std::memory_order_acquire);
+    auto dropped = ring->dropped.exchange(0, std::memory_order_relaxed);
+    if(head != tail || dropped) {
+        BlockHeader header;
+        std::memcpy(header.magic, "ECTB", 4);
+        header.thread = ring - ringList;
+        header.count = head - tail;
+        header.dropped = dropped;
+
+        // the records may wrap around the end of the ring
+        size_t first = tail % RING_SIZE;
+        size_t firstCount = std::min<size_t>(head - tail, RING_SIZE - first);
+        struct iovec iov[3] = {
+            {&header, sizeof header},
+            {&ring->records[first], firstCount * sizeof(Record)},
+            {&ring->records[0], (head - tail - firstCount) * sizeof(Record)},
+        };
+        (void)writev(fd, iov, 3);
+        ring->tail.store(head, std::memory_order_release);
+    }
+
+    ring->flushing.store(false, std::memory_order_release);
+}
+
+void CallTracer::flushAll() {
+    for(size_t i = 0; i < THREAD_LIMIT; i ++) {
+        if(ringList[i].owner.load(std::memory_order_acquire)) {
+            flush(&ringList[i]);
+        }
+    }
+}
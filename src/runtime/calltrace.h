@@ -0,0 +1,101 @@
+#ifndef EGALITO_RUNTIME_CALL_TRACE_H
+#define EGALITO_RUNTIME_CALL_TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include "types.h"
+
+class Program;
+
+/** Binary call tracing for LogCallsPass, enabled with EGALITO_LOG_CALL=1
+    and EGALITO_LOG_CALL_TRACE=<file>. Instead of printing each call, the
+    hooks append a 16-byte Record (function id, direction, timestamp
+    counter) to a ring buffer owned by the calling thread. Rings are
+    claimed by thread pointer without locks, and each thread writes out
+    its own ring when it is half full. All rings are written when main
+    returns or exit() is entered, since the program's exit doesn't run any
+    loader code; records of threads still running after that are lost, as
+    are all records of threads beyond the first THREAD_LIMIT.
+
+    The file starts with a FileHeader and the function table the ids
+    refer to (runtime addresses and names), followed by one BlockHeader
+    and its Records per write. etprofile --calls decodes it.
+
+    Functions are looked up by their address at start(), so this can't
+    be used together with JIT shuffling.
+*/
+class CallTracer {
+public:
+    enum {
+        UNKNOWN_ID = 0xffffffffu,
+        DIRECTION_ENTRY = 1,
+        DIRECTION_EXIT = 2,
+    };
+    struct FileHeader {
+        char magic[4];          // "ECTR"
+        uint32_t version;
+        uint32_t functionCount;
+        uint32_t namesSize;
+    };
+    struct FunctionRecord {
+        uint64_t address;
+        uint32_t size;
+        uint32_t nameOffset;
+    };
+    struct BlockHeader {
+        char magic[4];          // "ECTB"
+        uint32_t thread;        // index of the ring
+        uint32_t count;
+        uint32_t dropped;       // records lost since the last block
+    };
+    struct Record {
+        uint64_t timestamp;
+        uint32_t id;
+        uint32_t direction;
+    };
+private:
+    enum {
+        RING_SIZE = 4096,
+        THREAD_LIMIT = 256,
+        NAME_LIMIT = 256,
+    };
+    struct Entry {
+        address_t start;
+        address_t end;
+        bool flushOnEntry;
+        bool flushOnExit;
+    };
+    struct Ring {
+        std::atomic<address_t> owner;
+        std::atomic<uint64_t> head;
+        std::atomic<uint64_t> tail;
+        std::atomic<uint32_t> dropped;
+        std::atomic<bool> flushing;
+        Record records[RING_SIZE];
+    };
+
+    static CallTracer *instance;
+
+    Entry *entryList;   // sorted by address
+    size_t entryCount;
+    Ring *ringList;
+    int fd;
+public:
+    /** Prepares the function table and writes the file header. Must run
+        while the loader can still allocate; returns false if not enabled. */
+    static bool start(Program *program);
+
+    /** Called by the LogCallsPass hooks; returns false when tracing is
+        off, so that the call is printed instead. */
+    static bool record(address_t address, int dir);
+private:
+    CallTracer() : entryList(nullptr), entryCount(0), ringList(nullptr),
+        fd(-1) {}
+    bool build(Program *program, const char *file);
+    Entry *find(address_t address);
+    Ring *findRing();
+    void flush(Ring *ring);
+    void flushAll();
+};
+
+#endif
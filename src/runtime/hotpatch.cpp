@@ -0,0 +1,349 @@
+#include <algorithm>
+#include <memory>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>  // for getenv
+#include <cstring>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include "config.h"
+#include "hotpatch.h"
+#include "chunk/concrete.h"
+#include "chunk/tls.h"
+#include "conductor/conductor.h"
+#include "conductor/setup.h"
+#include "operation/find2.h"
+#include "pass/noppass.h"
+#include "util/feature.h"
+
+#undef DEBUG_GROUP
+#define DEBUG_GROUP load
+#include "log/log.h"
+
+#define MESSAGE_LIMIT   4096
+#define SCAN_CHUNK      0x1000
+
+extern ConductorSetup *egalito_conductor_setup;
+
+extern "C" void egalito_jit_gs_init(ShufflingSandbox *, GSTable *);
+extern "C" int egalito_pthread_create(pthread_t *thread,
+    const pthread_attr_t *attr, void *(*start_routine)(void *), void *arg);
+
+HotPatchService *HotPatchService::instance = nullptr;
+
+HotPatchService::GenerateLock::GenerateLock() : service(instance),
+    depth(nullptr) {
+
+    if(!service) return;
+    auto gsTable = EgalitoTLS::getGSTable();
+    if(service->writer == gsTable) {
+        // the patching thread's own resolver; it doesn't run patched code
+        service = nullptr;
+        return;
+    }
+    depth = gsTable->getGenerateDepthAddress();
+    if((*depth)++ == 0) pthread_rwlock_rdlock(&service->treeLock);
+}
+
+HotPatchService::GenerateLock::~GenerateLock() {
+    if(!service) return;
+    if(--(*depth) == 0) pthread_rwlock_unlock(&service->treeLock);
+}
+
+HotPatchService::HotPatchService() : writer(nullptr), generation(0) {
+    // resolvers are frequent and short, so a patch would starve behind
+    // them; nested read locks are counted instead of taken twice
+    pthread_rwlockattr_t attr;
+    pthread_rwlockattr_init(&attr);
+    pthread_rwlockattr_setkind_np(&attr,
+        PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    pthread_rwlock_init(&treeLock, &attr);
+    pthread_rwlockattr_destroy(&attr);
+    pthread_mutex_init(&threadMutex, nullptr);
+}
+
+void HotPatchService::start() {
+    const char *path = getenv("EGALITO_HOTPATCH_SOCKET");
+    if(!path || !*path) return;
+    if(!isFeatureEnabled("EGALITO_USE_SHUFFLING")) {
+        LOG(0, "EGALITO_HOTPATCH_SOCKET requires EGALITO_USE_SHUFFLING");
+        return;
+    }
+
+    struct sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(std::strlen(path) >= sizeof(address.sun_path)) {
+        LOG(0, "EGALITO_HOTPATCH_SOCKET path is too long");
+        return;
+    }
+    std::strcpy(address.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if(fd < 0) return;
+    unlink(path);
+    if(bind(fd, reinterpret_cast<struct sockaddr *>(&address),
+        sizeof(address)) < 0 || listen(fd, 4) < 0) {
+
+        LOG(0, "can't listen on [" << path << "] for hot patches");
+        close(fd);
+        return;
+    }
+
+    auto service = new HotPatchService();
+    service->registerPass("nop",
+        [] () -> ChunkPass * { return new NopPass(); });
+    instance = service;
+    service->registerThread(EgalitoTLS::getGSTable());
+    pthread_atfork(&forkPrepare, &forkParent, &forkChild);
+
+    // an ordinary egalito thread, so it has a GS table of its own
+    pthread_t thread;
+    if(egalito_pthread_create(&thread, nullptr, &HotPatchService::run,
+        reinterpret_cast<void *>(static_cast<intptr_t>(fd))) != 0) {
+
+        LOG(0, "can't start the hot patch thread");
+        close(fd);
+        return;
+    }
+    pthread_detach(thread);
+    LOG(1, "accepting hot patches on [" << path << "]");
+}
+
+void HotPatchService::registerPass(const std::string &name,
+    PassFactory factory) {
+
+    passMap[name] = factory;
+}
+
+void HotPatchService::registerThread(GSTable *gsTable) {
+    int here;
+    auto sp = reinterpret_cast<address_t>(&here);
+
+    // the mapping containing the stack pointer; the main thread's stack
+    // may still grow down to its limit
+    ThreadStack stack{gsTable, 0, 0};
+    if(auto maps = std::fopen("/proc/self/maps", "r")) {
+        char line[512];
+        while(std::fgets(line, sizeof(line), maps)) {
+            unsigned long low, high;
+            if(std::sscanf(line, "%lx-%lx", &low, &high) != 2) continue;
+            if(sp < low || sp >= high) continue;
+
+            stack.low = low;
+            stack.high = high;
+            struct rlimit limit;
+            if(std::strstr(line, "[stack]")
+                && getrlimit(RLIMIT_STACK, &limit) == 0
+                && limit.rlim_cur != RLIM_INFINITY
+                && limit.rlim_cur < high) {
+
+                stack.low = std::min<address_t>(low, high - limit.rlim_cur);
+            }
+            break;
+        }
+        std::fclose(maps);
+    }
+    if(!stack.high) {
+        LOG(0, "can't find the stack of a thread for hot patching");
+        return;
+    }
+
+    pthread_mutex_lock(&threadMutex);
+    // a new thread may reuse the stack of one that exited
+    threadList.erase(std::remove_if(threadList.begin(), threadList.end(),
+        [&stack] (const ThreadStack &other) {
+            return other.gsTable == stack.gsTable
+                || (other.low < stack.high && stack.low < other.high);
+        }), threadList.end());
+    threadList.push_back(stack);
+    pthread_mutex_unlock(&threadMutex);
+}
+
+bool HotPatchService::apply(const std::string &passName,
+    const std::vector<std::string> &functionList, std::string &reply) {
+
+    auto it = passMap.find(passName);
+    if(it == passMap.end()) {
+        reply = "no pass named [" + passName + "]";
+        return false;
+    }
+
+    auto gsTable = EgalitoTLS::getGSTable();
+    auto conductor = egalito_conductor_setup->getConductor();
+    pthread_rwlock_wrlock(&treeLock);
+    writer = gsTable;
+
+    bool ok = true;
+    std::vector<Function *> targetList;
+    std::vector<PatchedFunction> list;
+    for(const auto &name : functionList) {
+        auto function = ChunkFind2(conductor).findFunction(name.c_str());
+        auto entry = function ? gsTable->getEntryFor(function) : nullptr;
+        if(!entry) {
+            reply = "no function [" + name + "] in the GS table";
+            ok = false;
+            break;
+        }
+        targetList.push_back(function);
+        list.push_back({entry->getOffset(), function->getSize(),
+            generation + 1});
+    }
+    if(ok && isLiveAnywhere(list)) {
+        reply = "busy: a function is running, try again";
+        ok = false;
+    }
+
+    if(ok) {
+        std::unique_ptr<ChunkPass> pass(it->second());
+        for(size_t i = 0; i < targetList.size(); i ++) {
+            targetList[i]->accept(pass.get());
+            list[i].size = std::max(list[i].size, targetList[i]->getSize());
+        }
+        patchedList.insert(patchedList.end(), list.begin(), list.end());
+        generation = generation + 1;
+
+        std::ostringstream message;
+        message << "applied [" << passName << "] to " << targetList.size()
+            << " functions, generation " << generation;
+        reply = message.str();
+    }
+
+    writer = nullptr;
+    pthread_rwlock_unlock(&treeLock);
+    LOG(1, "hot patch: " << reply);
+    return ok;
+}
+
+bool HotPatchService::switchGeneration(GSTable *gsTable,
+    ShufflingSandbox *sandbox) {
+
+    GenerateLock lock;
+
+    std::vector<PatchedFunction> list;
+    for(const auto &patched : patchedList) {
+        if(patched.generation > gsTable->getPatchGeneration()) {
+            list.push_back(patched);
+        }
+    }
+
+    address_t high = 0;
+    pthread_mutex_lock(&threadMutex);
+    for(const auto &stack : threadList) {
+        if(stack.gsTable == gsTable) high = stack.high;
+    }
+    pthread_mutex_unlock(&threadMutex);
+    if(!high) {
+        // started before the service; scanned from the next reset point
+        registerThread(gsTable);
+        return false;
+    }
+
+    // this thread is stopped here, so only its live frames are scanned
+    auto low = static_cast<address_t *>(__builtin_frame_address(0));
+    if(isLive(list, low, reinterpret_cast<address_t *>(high))) return false;
+
+    egalito_jit_gs_init(sandbox, gsTable);
+    return true;
+}
+
+bool HotPatchService::isLive(const std::vector<PatchedFunction> &list,
+    const address_t *low, const address_t *high) {
+
+    // see JitGSFixup::addAfter(): the GS offset, then the instruction
+    // offset in the upper half
+    for(auto p = low; p < high; p ++) {
+        auto offset = static_cast<GSTableEntry::IndexType>(*p);
+        for(const auto &patched : list) {
+            if(offset == patched.offset && (*p >> 32) < patched.size) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool HotPatchService::isLiveAnywhere(
+    const std::vector<PatchedFunction> &list) {
+
+    pthread_mutex_lock(&threadMutex);
+    auto stackList = threadList;
+    pthread_mutex_unlock(&threadMutex);
+
+    // other threads keep running, so their whole stacks are scanned, with
+    // stale slots too; parts that are no longer mapped can't be read
+    address_t buffer[SCAN_CHUNK / sizeof(address_t)];
+    for(const auto &stack : stackList) {
+        if(stack.gsTable == writer) continue;
+        for(address_t page = stack.low; page < stack.high;
+            page += SCAN_CHUNK) {
+
+            struct iovec local = {buffer, SCAN_CHUNK};
+            struct iovec remote = {reinterpret_cast<void *>(page), SCAN_CHUNK};
+            auto size = process_vm_readv(getpid(), &local, 1, &remote, 1, 0);
+            if(size <= 0) continue;
+            if(isLive(list, buffer, buffer + size / sizeof(address_t))) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void *HotPatchService::run(void *arg) {
+    int fd = static_cast<int>(reinterpret_cast<intptr_t>(arg));
+    for(;;) {
+        int connection = accept4(fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if(connection < 0) continue;
+        instance->handle(connection);
+        close(connection);
+    }
+    return nullptr;
+}
+
+void HotPatchService::handle(int connection) {
+    // each message is "pass function...", and gets one reply
+    char message[MESSAGE_LIMIT];
+    ssize_t size;
+    while((size = recv(connection, message, sizeof(message) - 1, 0)) > 0) {
+        message[size] = 0;
+        std::istringstream stream(message);
+        std::string passName, name;
+        std::vector<std::string> functionList;
+        stream >> passName;
+        while(stream >> name) functionList.push_back(name);
+
+        std::string reply;
+        if(passName.empty() || functionList.empty()) {
+            reply = "usage: pass function...";
+        }
+        else if(apply(passName, functionList, reply)) {
+            reply = "ok: " + reply;
+        }
+        else {
+            reply = "error: " + reply;
+        }
+        send(connection, reply.data(), reply.length(), MSG_NOSIGNAL);
+    }
+}
+
+void HotPatchService::forkPrepare() {
+    // a child must not inherit the lock held by a thread it won't have
+    pthread_rwlock_wrlock(&instance->treeLock);
+    instance->writer = EgalitoTLS::getGSTable();
+}
+
+void HotPatchService::forkParent() {
+    instance->writer = nullptr;
+    pthread_rwlock_unlock(&instance->treeLock);
+}
+
+void HotPatchService::forkChild() {
+    // the control thread stays with the parent
+    instance->writer = nullptr;
+    pthread_rwlock_unlock(&instance->treeLock);
+    pthread_mutex_init(&instance->threadMutex, nullptr);
+}
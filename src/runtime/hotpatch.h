@@ -0,0 +1,104 @@
+#ifndef EGALITO_RUNTIME_HOT_PATCH_H
+#define EGALITO_RUNTIME_HOT_PATCH_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <functional>
+#include <pthread.h>
+#include "chunk/gstable.h"
+#include "transform/sandbox.h"
+
+class ChunkPass;
+class Function;
+
+/** Applies passes to functions of a running JIT-shuffled program, e.g. to
+    deploy or update instrumentation without restarting it. Started by
+    egalito_runtime_init() when EGALITO_HOTPATCH_SOCKET names a Unix socket
+    (see app/hotpatch.py); requires EGALITO_USE_SHUFFLING.
+
+    Code is regenerated from the shared Chunk tree, so a pass changes the
+    tree under a write lock, and every code generation (resolver, reset,
+    staging thread) holds it for reading. Each thread then switches to the
+    new code at its next reset point, by regenerating all of its entries.
+
+    A return address is a GS offset and an offset into the function, so a
+    frame that is live across the change would return into the middle of
+    the new layout. apply() therefore refuses while any thread's stack
+    holds a return address into one of the functions, and a thread defers
+    its switch while its own stack does; until then it keeps the code it
+    has. A return that is being resolved at the moment the tree changes is
+    not on any stack, and is not detected. The stack scans look for the
+    return addresses as they are pushed, so passes must not change how
+    they are stored (as StackXOR or a shadow stack would). Changes can't
+    be undone, except by another pass.
+*/
+class HotPatchService {
+public:
+    typedef std::function<ChunkPass *()> PassFactory;
+
+    /** Holds the tree lock for reading while code is generated. Nested
+        locks on one thread are counted in its GS table. */
+    class GenerateLock {
+    private:
+        HotPatchService *service;
+        size_t *depth;
+    public:
+        GenerateLock();
+        ~GenerateLock();
+    };
+private:
+    struct ThreadStack {
+        GSTable *gsTable;
+        address_t low, high;
+    };
+    struct PatchedFunction {
+        GSTableEntry::IndexType offset;
+        size_t size;
+        size_t generation;
+    };
+
+    static HotPatchService *instance;
+
+    pthread_rwlock_t treeLock;
+    GSTable *writer;
+    volatile size_t generation;
+    pthread_mutex_t threadMutex;
+    std::vector<ThreadStack> threadList;
+    std::vector<PatchedFunction> patchedList;   // guarded by treeLock
+    std::map<std::string, PassFactory> passMap;
+public:
+    /** Returns the service, or nullptr if hot patching is not enabled. */
+    static HotPatchService *getInstance() { return instance; }
+    /** Starts the control socket if EGALITO_HOTPATCH_SOCKET is set. */
+    static void start();
+
+    void registerPass(const std::string &name, PassFactory factory);
+    /** Records the calling thread's stack, for apply() to scan. */
+    void registerThread(GSTable *gsTable);
+
+    /** Runs the pass on the named functions. On failure, nothing was
+        changed and reply says why. */
+    bool apply(const std::string &passName,
+        const std::vector<std::string> &functionList, std::string &reply);
+
+    size_t getGeneration() const { return generation; }
+    bool isPending(GSTable *gsTable) const
+        { return gsTable->getPatchGeneration() != generation; }
+    /** At a reset point of the calling thread: regenerates all of its
+        entries from the patched tree, unless a patched function is still
+        live on its stack. Returns false if the switch was deferred. */
+    bool switchGeneration(GSTable *gsTable, ShufflingSandbox *sandbox);
+private:
+    HotPatchService();
+    void handle(int connection);
+    static bool isLive(const std::vector<PatchedFunction> &list,
+        const address_t *low, const address_t *high);
+    bool isLiveAnywhere(const std::vector<PatchedFunction> &list);
+    static void *run(void *arg);
+    static void forkPrepare();
+    static void forkParent();
+    static void forkChild();
+};
+
+#endif
@@ -0,0 +1,233 @@
+#include <unistd.h>
+#include <algorithm>
+#include "config.h"
+#include "jitservice.h"
+#include "managegs.h"
+#include "hotpatch.h"
+#include "chunk/concrete.h"
+#include "chunk/tls.h"
+#include "conductor/setup.h"
+#include "transform/generator.h"
+#include "util/explicit_bzero.h"
+
+#undef DEBUG_GROUP
+#define DEBUG_GROUP load
+#include "log/log.h"
+
+// heat is a fixed-point count of recent epochs with a hit, decaying by a
+// quarter per epoch: one hit keeps an entry hot for the next three epochs
+#define HEAT_PER_EPOCH  16
+#define HOT_THRESHOLD   8
+
+extern ConductorSetup *egalito_conductor_setup;
+
+extern "C" int egalito_pthread_create(pthread_t *thread,
+    const pthread_attr_t *attr, void *(*start_routine)(void *), void *arg);
+
+JitGenerationService *JitGenerationService::getInstance(GSTable *gsTable,
+    Chunk *callback) {
+
+    auto service = EgalitoTLS::getJITService();
+    if(service && service->pid == getpid()) return service;
+
+    // a forked child inherits the TLS but not the thread, so nothing can
+    // be using the old service's staging regions any more
+    if(service) {
+        egalito_conductor_setup->releaseShufflingSandbox(service->staging);
+    }
+    service = new JitGenerationService(gsTable, callback);
+    EgalitoTLS::setJITService(service);
+    service->start();
+    return service;
+}
+
+JitGenerationService::JitGenerationService(GSTable *gsTable, Chunk *callback)
+    : gsTable(gsTable), staging(egalito_conductor_setup->makeShufflingSandbox()),
+    callback(callback), pid(getpid()), state(STATE_IDLE),
+    requestPending(false), forkPending(false), retiredEpoch(0),
+    stagedGeneration(0),
+    stagedList(gsTable->getChildren()->getIterable()->getCount(), 0),
+    hitList(stagedList.size(), 0), heatList(stagedList.size(), 0) {
+
+    pthread_mutex_init(&mutex, nullptr);
+    pthread_cond_init(&requested, nullptr);
+}
+
+void JitGenerationService::start() {
+    // this goes through egalito's own wrapper so that the new thread gets
+    // a GS table and TLS of its own, like any other thread
+    if(egalito_pthread_create(&thread, nullptr,
+        &JitGenerationService::run, this) != 0) {
+
+        // nothing will ever be staged; every reset stays synchronous
+        LOG(1, "JIT: can't start the code generation thread");
+        return;
+    }
+    pthread_detach(thread);
+}
+
+void JitGenerationService::recordHotEntries() {
+    auto jitStart = gsTable->getJITStartIndex();
+
+    std::vector<GSTableEntry::IndexType> list;
+    for(auto entry : CIter::children(gsTable)) {
+        auto i = entry->getIndex();
+        if(i < jitStart) continue;
+
+        auto &heat = heatList[i];
+        heat -= heat / 4;
+        if(hitList[i]) heat += HEAT_PER_EPOCH;
+        hitList[i] = 0;
+        if(heat < HOT_THRESHOLD) continue;
+
+        auto target = entry->getTarget();
+        if(dynamic_cast<Function *>(target)
+            || dynamic_cast<PLTTrampoline *>(target)) {
+
+            list.push_back(i);
+        }
+    }
+
+    // the hottest entries are placed first, next to the reserved ones
+    std::stable_sort(list.begin(), list.end(),
+        [this] (GSTableEntry::IndexType a, GSTableEntry::IndexType b) {
+            return heatList[a] > heatList[b];
+        });
+
+    pthread_mutex_lock(&mutex);
+    hotList.swap(list);
+    pthread_mutex_unlock(&mutex);
+}
+
+void JitGenerationService::poll() {
+    if(requestPending && ManageGS::canReclaim(gsTable, retiredEpoch)) {
+        requestPending = false;
+        request();
+    }
+}
+
+void JitGenerationService::request() {
+    pthread_mutex_lock(&mutex);
+    if(state == STATE_IDLE) {
+        state = STATE_REQUESTED;
+        pthread_cond_signal(&requested);
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+bool JitGenerationService::publish() {
+    pthread_mutex_lock(&mutex);
+    auto hotPatch = HotPatchService::getInstance();
+    if(state == STATE_READY && hotPatch
+        && stagedGeneration != hotPatch->getGeneration()) {
+
+        // staged from the tree before a hot patch
+        state = STATE_REQUESTED;
+        pthread_cond_signal(&requested);
+        pthread_mutex_unlock(&mutex);
+        return false;
+    }
+    if(state != STATE_READY) {
+        // the first reset, or the staging thread fell behind
+        if(state == STATE_IDLE && !requestPending) {
+            state = STATE_REQUESTED;
+            pthread_cond_signal(&requested);
+        }
+        pthread_mutex_unlock(&mutex);
+        return false;
+    }
+
+    retiredEpoch = ManageGS::getEpoch(gsTable);
+    ManageGS::publishEntries(gsTable, stagedList.data(), callback);
+    staging->flip();    // the published region stays live this epoch
+    state = STATE_IDLE;
+    pthread_mutex_unlock(&mutex);
+
+    requestPending = true;
+    return true;
+}
+
+void JitGenerationService::afterFork() {
+    // this service is new, so take the hits from the inherited entries:
+    // the ones the parent resolved no longer point at the callback
+    auto array = static_cast<address_t *>(gsTable->getTableAddress());
+    auto addr = callback->getAddress();
+    for(size_t i = gsTable->getJITStartIndex(); i < hitList.size(); i ++) {
+        if(array[i] != addr) hitList[i] ++;
+    }
+    recordHotEntries();
+    forkPending = true;
+    request();
+}
+
+bool JitGenerationService::publishAfterFork() {
+    if(!forkPending) return false;
+
+    pthread_mutex_lock(&mutex);
+    bool ready = (state == STATE_READY);
+    pthread_mutex_unlock(&mutex);
+    if(!ready) return false;
+
+    forkPending = false;
+    return publish();
+}
+
+void *JitGenerationService::run(void *arg) {
+    auto service = static_cast<JitGenerationService *>(arg);
+    for(;;) {
+        pthread_mutex_lock(&service->mutex);
+        while(service->state != STATE_REQUESTED) {
+            pthread_cond_wait(&service->requested, &service->mutex);
+        }
+        service->state = STATE_STAGING;
+        pthread_mutex_unlock(&service->mutex);
+
+        service->stage();
+
+        pthread_mutex_lock(&service->mutex);
+        service->state = STATE_READY;
+        pthread_mutex_unlock(&service->mutex);
+    }
+    return nullptr;
+}
+
+void JitGenerationService::stage() {
+    pthread_mutex_lock(&mutex);
+    auto list = hotList;
+    pthread_mutex_unlock(&mutex);
+
+    std::fill(stagedList.begin(), stagedList.end(), 0);
+
+    HotPatchService::GenerateLock lock;
+    if(auto hotPatch = HotPatchService::getInstance()) {
+        stagedGeneration = hotPatch->getGeneration();
+    }
+
+    staging->reopen();
+    staging->recreate();
+    Generator generator(staging, true);
+    auto generate = [&] (GSTableEntry *entry) {
+        auto target = entry->getTarget();
+        if(auto f = dynamic_cast<Function *>(target)) {
+            generator.assignAndGenerate(f);
+        }
+        else if(auto trampoline = dynamic_cast<PLTTrampoline *>(target)) {
+            generator.assignAndGenerate(trampoline);
+        }
+        else return;
+        stagedList[entry->getIndex()] = target->getAddress();
+    };
+
+    // the same reserved entries as egalito_jit_gs_init(), then the hot set
+    for(auto entry : CIter::children(gsTable)) {
+        if(entry->getIndex() == gsTable->getJITStartIndex()) break;
+        generate(entry);
+    }
+    for(auto index : list) {
+        generate(gsTable->getAtIndex(index));
+    }
+    staging->finalize();
+
+    // positions were assigned in this thread's own address table
+    explicit_bzero(EgalitoTLS::getJITAddressTable(), JIT_TABLE_SIZE);
+}
@@ -0,0 +1,89 @@
+#ifndef EGALITO_RUNTIME_JIT_SERVICE_H
+#define EGALITO_RUNTIME_JIT_SERVICE_H
+
+#include <vector>
+#include <pthread.h>
+#include <sys/types.h>
+#include "chunk/gstable.h"
+#include "transform/sandbox.h"
+
+/** Generates the code of the next JIT-shuffling epoch on a background
+    thread, so that a re-shuffle only has to swap GS table entries.
+
+    Each thread with a GS table (the owner) gets one service. Its
+    background thread is an ordinary egalito thread with its own GS table
+    copy and TLS, and writes into a pair of staging regions that the owner
+    never executes until they are published: the reserved entries plus
+    the hot JIT entries. Other functions are still generated on first
+    call, into the owner's own sandbox, as before.
+
+    Hotness is counted by the resolver: every JIT entry resolved in an
+    epoch gets a hit, and recordHotEntries() folds the hits into a
+    decaying heat per entry. An entry stays hot for a few epochs after
+    its last call, so a handler that runs every other request is not
+    regenerated lazily every other epoch; a cold one falls back to lazy
+    generation and its code is reclaimed with the region.
+
+    The staging regions alternate. The one just published stays in use
+    for the whole epoch; the other one was live in the epoch that publish()
+    ended, so the next round is only requested once ManageGS says it can
+    be reclaimed (see poll()).
+*/
+class JitGenerationService {
+private:
+    enum State {
+        STATE_IDLE,
+        STATE_REQUESTED,    // owner wants a new epoch staged
+        STATE_STAGING,
+        STATE_READY,        // stagedList matches the staging sandbox
+    };
+
+    GSTable *gsTable;
+    ShufflingSandbox *staging;
+    Chunk *callback;
+    pid_t pid;  // the background thread does not survive fork()
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t requested;
+    State state;
+    bool requestPending;    // only touched by the owner
+    bool forkPending;       // likewise
+    size_t retiredEpoch;
+    size_t stagedGeneration;    // HotPatchService generation staged from
+    std::vector<GSTableEntry::IndexType> hotList;   // hottest first
+    std::vector<address_t> stagedList;  // by index, 0 if not staged
+    std::vector<unsigned> hitList;      // by index, hits in this epoch
+    std::vector<unsigned> heatList;     // by index, only touched by the owner
+public:
+    /** Returns the service of the calling thread, starting it if needed. */
+    static JitGenerationService *getInstance(GSTable *gsTable,
+        Chunk *callback);
+
+    /** Counts a resolution of a JIT entry by the owner's resolver. */
+    void recordHit(GSTableEntry::IndexType index) { hitList[index] ++; }
+    /** Updates the heat of each JIT entry from this epoch's hits, and
+        picks the ones the next epoch will be staged with. */
+    void recordHotEntries();
+    /** Called at the owner's quiescent points; starts a deferred request. */
+    void poll();
+    /** If an epoch is staged, points the owner's GS table at it and
+        returns true. Otherwise the caller regenerates synchronously. */
+    bool publish();
+
+    /** Called in a forked child. The child keeps running the code and GS
+        entries it shares copy-on-write with its parent, while a layout of
+        its own is staged in the background; publishAfterFork() then swaps
+        it in at the first reset point where it is ready. */
+    void afterFork();
+    /** Publishes the layout requested by afterFork() if it is staged. */
+    bool publishAfterFork();
+    bool isForkPending() const { return forkPending; }
+private:
+    JitGenerationService(GSTable *gsTable, Chunk *callback);
+    void start();
+    void request();
+    static void *run(void *service);
+    void stage();
+};
+
+#endif
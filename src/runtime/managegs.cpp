@@ -88,7 +88,13 @@ void ManageGS::setEntry(GSTable *gsTable, GSTableEntry::IndexType index,
 
     assert(index < JIT_TABLE_SIZE/sizeof(address_t));
     address_t *array = static_cast<address_t *>(gsTable->getTableAddress());
-    array[index] = value;
+    storeEntry(array, index, value);
+}
+
+void ManageGS::storeEntry(address_t *array, GSTableEntry::IndexType index,
+    address_t value) {
+
+    __atomic_store_n(&array[index], value, __ATOMIC_RELEASE);
 }
 
 address_t ManageGS::getEntry(GSTableEntry::IndexType offset) {
@@ -109,15 +115,14 @@ void ManageGS::resetEntries(GSTable *gsTable, Chunk *callback) {
     auto jitEnd = gsTable->getChildren()->getIterable()->getCount();
 
     if(egalito_init_done) {
-        auto table = EgalitoTLS::getJITAddressTable();
-        std::memcpy(&array[0], table, jitStart*sizeof(address_t));
+        auto table = static_cast<address_t *>(EgalitoTLS::getJITAddressTable());
         for(auto entry : CIter::children(gsTable)) {
             auto i = entry->getIndex();
             if(i == jitStart) break;
 
-            if(array[i] == 0) { // target does not have an absolute position
-                array[i] = entry->getTarget()->getAddress();
-            }
+            // zero if the target does not have an absolute position
+            auto value = table[i] ? table[i] : entry->getTarget()->getAddress();
+            storeEntry(array, i, value);
         }
     }
     else {
@@ -125,19 +130,58 @@ void ManageGS::resetEntries(GSTable *gsTable, Chunk *callback) {
             auto i = entry->getIndex();
             if(i == jitStart) break;
 
-            array[i] = entry->getTarget()->getAddress();
+            storeEntry(array, i, entry->getTarget()->getAddress());
         }
     }
 
     // should be < 10us without vector instructions
     auto addr = callback->getAddress();
     for(size_t i = jitStart; i < jitEnd; i++) {
-        array[i] = addr;
+        storeEntry(array, i, addr);
+    }
+    advanceEpoch(gsTable);
+}
+
+void ManageGS::publishEntries(GSTable *gsTable, const address_t *staged,
+    Chunk *callback) {
+
+    address_t *array = static_cast<address_t *>(gsTable->getTableAddress());
+    auto jitStart = gsTable->getJITStartIndex();
+    auto addr = callback->getAddress();
+    for(auto entry : CIter::children(gsTable)) {
+        auto i = entry->getIndex();
+        address_t value = staged[i];
+        if(!value) {
+            value = (i < jitStart) ? entry->getTarget()->getAddress() : addr;
+        }
+        storeEntry(array, i, value);
     }
+    advanceEpoch(gsTable);
 }
 
 Chunk *ManageGS::resolve(GSTable *gsTable, GSTableEntry::IndexType index) {
-    auto entry = gsTable->getAtIndex(index);
-    ManageGS::setEntry(gsTable, index, entry->getTarget()->getAddress());
+    // the index comes from a jmpq *%gs:offset that was generated from
+    // this table, so it needs no bounds check
+    auto entry = gsTable->getAtValidIndex(index);
+    address_t *array = static_cast<address_t *>(gsTable->getTableAddress());
+    storeEntry(array, index, entry->getTarget()->getAddress());
     return entry->getTarget();
 }
+
+size_t ManageGS::getEpoch(GSTable *gsTable) {
+    return __atomic_load_n(gsTable->getEpochAddress(), __ATOMIC_ACQUIRE);
+}
+
+void ManageGS::advanceEpoch(GSTable *gsTable) {
+    __atomic_add_fetch(gsTable->getEpochAddress(), 1, __ATOMIC_RELEASE);
+}
+
+void ManageGS::quiesce(GSTable *gsTable) {
+    __atomic_store_n(gsTable->getQuiescentEpochAddress(),
+        getEpoch(gsTable), __ATOMIC_RELEASE);
+}
+
+bool ManageGS::canReclaim(GSTable *gsTable, size_t epoch) {
+    return __atomic_load_n(gsTable->getQuiescentEpochAddress(),
+        __ATOMIC_ACQUIRE) > epoch;
+}
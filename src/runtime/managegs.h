@@ -3,6 +3,22 @@
 
 #include "chunk/gstable.h"
 
+/** Runtime management of a thread's GS table.
+
+    Concurrency protocol: each table has a single writer, the thread that
+    owns it (code staged by another thread is handed over first, see
+    JitGenerationService). Readers are jmpq *%gs:... sequences on any
+    thread, so every entry is stored with release semantics, after the
+    code it points to has been written and protected.
+
+    Code regions are reclaimed by epoch. Redirecting the entries (reset or
+    publish) ends the current epoch. The owner passes a quiescent point
+    whenever it enters the runtime through a hook (a fixup, or the reset
+    hooks that JitGSFixup places after syscalls): it got there through the
+    current entries, and return addresses are GS indices, so no frame
+    still runs code from an earlier epoch. A region that was live in
+    epoch E may be overwritten once canReclaim(E) holds.
+*/
 class ManageGS {
 public:
     static void init(GSTable *gsTable);
@@ -15,7 +31,19 @@ public:
     static address_t getEntry(GSTableEntry::IndexType offset);
 
     static void resetEntries(GSTable *gsTable, Chunk *callback);
+    /** Like resetEntries, but takes each address from staged[index] when
+        it is nonzero, and stores entries atomically. */
+    static void publishEntries(GSTable *gsTable, const address_t *staged,
+        Chunk *callback);
     static Chunk *resolve(GSTable *gsTable, GSTableEntry::IndexType index);
+
+    static size_t getEpoch(GSTable *gsTable);
+    static void quiesce(GSTable *gsTable);
+    static bool canReclaim(GSTable *gsTable, size_t epoch);
+private:
+    static void storeEntry(address_t *array, GSTableEntry::IndexType index,
+        address_t value);
+    static void advanceEpoch(GSTable *gsTable);
 };
 
 #endif
@@ -0,0 +1,174 @@
+#include <algorithm>
+#include <vector>
+#include <cerrno>
+#include <cstdlib>  // for getenv, strtoul
+#include <cstring>
+#include <new>
+#include <fcntl.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include "sampler.h"
+#include "chunk/concrete.h"
+#include "cminus/print.h"
+
+#undef DEBUG_GROUP
+#define DEBUG_GROUP load
+#include "log/log.h"
+
+SamplingProfiler *SamplingProfiler::instance = nullptr;
+
+static void *allocate(size_t size) {
+    void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+        MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    return (p == MAP_FAILED) ? nullptr : p;
+}
+
+bool SamplingProfiler::start(Program *program) {
+    const char *file = getenv("EGALITO_PROFILE");
+    if(!file || !*file) return false;
+    if(std::strlen(file) + 5 > NAME_LIMIT) {
+        LOG(0, "EGALITO_PROFILE filename is too long");
+        return false;
+    }
+
+    // placed in its own mapping, the loader's heap can't be used later
+    auto memory = allocate(sizeof(SamplingProfiler));
+    if(!memory) return false;
+    auto profiler = new (memory) SamplingProfiler();
+    std::strcpy(profiler->filename, file);
+    if(!profiler->build(program)) return false;
+
+    unsigned long usec = 1000;
+    if(const char *value = getenv("EGALITO_PROFILE_USEC")) {
+        usec = std::strtoul(value, nullptr, 0);
+        if(!usec) usec = 1000;
+    }
+
+    instance = profiler;
+    struct sigaction action;
+    std::memset(&action, 0, sizeof action);
+    action.sa_sigaction = &SamplingProfiler::handler;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if(sigaction(SIGPROF, &action, nullptr) != 0) {
+        LOG(0, "can't install the SIGPROF handler for profiling");
+        return false;
+    }
+
+    struct itimerval timer;
+    timer.it_interval.tv_sec = usec / 1000000;
+    timer.it_interval.tv_usec = usec % 1000000;
+    timer.it_value = timer.it_interval;
+    setitimer(ITIMER_PROF, &timer, nullptr);
+
+    LOG(1, "sampling every " << std::dec << usec << " us into [" << file
+        << "], " << profiler->entryCount << " functions");
+    return true;
+}
+
+bool SamplingProfiler::build(Program *program) {
+    std::vector<Function *> functionList;
+    size_t namesSize = 0;
+    for(auto module : CIter::modules(program)) {
+        for(auto function : CIter::functions(module)) {
+            if(!function->getAddress() || !function->getSize()) continue;
+            functionList.push_back(function);
+            namesSize += function->getName().length() + 1;
+        }
+    }
+    std::sort(functionList.begin(), functionList.end(),
+        [] (Function *a, Function *b) {
+            return a->getAddress() < b->getAddress();
+        });
+
+    entryList = static_cast<Entry *>(
+        allocate(std::max<size_t>(functionList.size(), 1) * sizeof(Entry)));
+    names = static_cast<char *>(allocate(std::max<size_t>(namesSize, 1)));
+    if(!entryList || !names) return false;
+
+    size_t offset = 0;
+    for(auto function : functionList) {
+        auto entry = new (&entryList[entryCount ++]) Entry();
+        entry->start = function->getAddress();
+        entry->end = function->getAddress() + function->getSize();
+        entry->count = 0;
+        entry->nameOffset = offset;
+
+        const auto &name = function->getName();
+        std::memcpy(names + offset, name.c_str(), name.length() + 1);
+        offset += name.length() + 1;
+    }
+    return true;
+}
+
+SamplingProfiler::Entry *SamplingProfiler::find(address_t address) {
+    size_t low = 0, high = entryCount;
+    while(low < high) {
+        size_t middle = low + (high - low) / 2;
+        if(entryList[middle].start <= address) low = middle + 1;
+        else high = middle;
+    }
+    if(low == 0) return nullptr;
+    auto entry = &entryList[low - 1];
+    return (address < entry->end) ? entry : nullptr;
+}
+
+void SamplingProfiler::write() {
+    // another thread's handler may be writing already
+    if(writing.exchange(true)) return;
+
+    char temporary[NAME_LIMIT];
+    egalito_snprintf(temporary, sizeof temporary, "%s.tmp", filename);
+    int fd = open(temporary, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(fd >= 0) {
+        char buffer[4096];
+        size_t used = 0;
+        for(size_t i = 0; i < entryCount; i ++) {
+            auto count = entryList[i].count.load(std::memory_order_relaxed);
+            if(!count) continue;
+
+            const char *name = names + entryList[i].nameOffset;
+            if(used + std::strlen(name) + 32 > sizeof buffer) {
+                (void)::write(fd, buffer, used);
+                used = 0;
+            }
+            used += egalito_snprintf(buffer + used, sizeof buffer - used,
+                "%lu [%s]\n", static_cast<unsigned long>(count), name);
+        }
+        used += egalito_snprintf(buffer + used, sizeof buffer - used,
+            "# %lu samples outside of known functions\n",
+            static_cast<unsigned long>(unknown.load()));
+        (void)::write(fd, buffer, used);
+        close(fd);
+        rename(temporary, filename);
+    }
+
+    writing.store(false);
+}
+
+void SamplingProfiler::handler(int signum, siginfo_t *info, void *context) {
+    auto profiler = instance;
+    if(!profiler) return;
+
+    int savedErrno = errno;
+    auto uc = static_cast<ucontext_t *>(context);
+#ifdef ARCH_X86_64
+    address_t pc = uc->uc_mcontext.gregs[REG_RIP];
+#elif defined(ARCH_AARCH64)
+    address_t pc = uc->uc_mcontext.pc;
+#elif defined(ARCH_RISCV)
+    address_t pc = uc->uc_mcontext.__gregs[REG_PC];
+#endif
+
+    if(auto entry = profiler->find(pc)) {
+        entry->count.fetch_add(1, std::memory_order_relaxed);
+    }
+    else {
+        profiler->unknown.fetch_add(1, std::memory_order_relaxed);
+    }
+    auto total = profiler->total.fetch_add(1, std::memory_order_relaxed) + 1;
+    if(total % WRITE_INTERVAL == 0) profiler->write();
+    errno = savedErrno;
+}
@@ -0,0 +1,61 @@
+#ifndef EGALITO_RUNTIME_SAMPLER_H
+#define EGALITO_RUNTIME_SAMPLER_H
+
+#include <atomic>
+#include <cstdint>
+#include <signal.h>
+#include "types.h"
+
+class Program;
+
+/** Sampling profiler for programs run under the loader, enabled with
+    EGALITO_PROFILE=<file>. A SIGPROF timer (every EGALITO_PROFILE_USEC,
+    default 1000) interrupts the program, and the handler charges the
+    interrupted PC to the Function containing it. The counts are written
+    to the file in the "count [function]" format that etorder reads.
+
+    The program's exit doesn't run any loader code, so the file is
+    instead rewritten from the handler every WRITE_INTERVAL samples; the
+    samples of the last interval are lost. The handler only uses memory
+    set up by start() and async-signal-safe system calls.
+
+    Functions are looked up by their address at start(), so this can't
+    be used together with JIT shuffling, and the program must not install
+    a SIGPROF handler of its own.
+*/
+class SamplingProfiler {
+private:
+    enum {
+        WRITE_INTERVAL = 1000,
+        NAME_LIMIT = 256,
+    };
+    struct Entry {
+        address_t start;
+        address_t end;
+        std::atomic<uint64_t> count;
+        uint32_t nameOffset;
+    };
+
+    static SamplingProfiler *instance;
+
+    Entry *entryList;   // sorted by address
+    size_t entryCount;
+    char *names;
+    char filename[NAME_LIMIT];
+    std::atomic<uint64_t> total;
+    std::atomic<uint64_t> unknown;
+    std::atomic<bool> writing;
+public:
+    /** Prepares the function table and starts the timer. Must run while
+        the loader can still allocate; returns false if not enabled. */
+    static bool start(Program *program);
+private:
+    SamplingProfiler() : entryList(nullptr), entryCount(0), names(nullptr),
+        total(0), unknown(0), writing(false) {}
+    bool build(Program *program);
+    Entry *find(address_t address);
+    void write();
+    static void handler(int signum, siginfo_t *info, void *context);
+};
+
+#endif
@@ -5,9 +5,12 @@
 #include "conductor/setup.h"
 #include "conductor/conductor.h"
 #include "cminus/print.h"
+#include "runtime/jitservice.h"
 #include "runtime/managegs.h"
 
 extern ConductorSetup *egalito_conductor_setup;
+extern Chunk *egalito_gsCallback;
+extern bool egalito_jit_async;
 
 extern "C" void egalito_jit_gs_init(ShufflingSandbox *, GSTable *);
 
@@ -43,3 +46,27 @@ int egalito_pthread_create(pthread_t *thread, const pthread_attr_t *attr,
 
     return status;
 }
+
+/** Installed by egalito_jit_gs_setup() when EGALITO_JIT_FORK is set.
+
+    A pre-forked server's children would otherwise all run their parent's
+    layout until their first re-shuffle. Nothing is copied here: the GS
+    table, sandboxes and JIT address table stay shared copy-on-write, and
+    the child only asks for a layout of its own. With EGALITO_JIT_ASYNC it
+    is staged on a background thread and published at the first reset
+    point where it is ready; otherwise the next reset point re-shuffles.
+*/
+extern "C"
+void egalito_pthread_atfork_child(void) {
+    auto gsTable = EgalitoTLS::getGSTable();
+    if(!gsTable) return;
+
+    if(egalito_jit_async) {
+        // the parent's service is stale in the child; this replaces it
+        JitGenerationService::getInstance(gsTable, egalito_gsCallback)
+            ->afterFork();
+    }
+    else {
+        EgalitoTLS::setJITResetCounter(EgalitoTLS::getJITResetThreshold());
+    }
+}
@@ -57,22 +57,22 @@ address_t DataLoader::allocateTLS(address_t base, size_t size, size_t *offset) {
 #endif
 
 void DataLoader::loadRegion(DataRegion *region) {
-    const std::string &source = region->getDataBytes();
+    size_t length = region->getSizeOfInitializedData();
     char *output = reinterpret_cast<char *>(region->getAddress());
 
     LOG(1, "loading DataRegion " << region->getName()
         << " at 0x" << std::hex << region->getAddress());
 
-    std::memcpy(output, source.c_str(), source.length());
-    size_t zeroBytes = region->getSize() - source.length();
-    std::memset(output + source.length(), 0, zeroBytes);
+    std::memcpy(output, region->getDataPointer(), length);
+    size_t zeroBytes = region->getSize() - length;
+    std::memset(output + length, 0, zeroBytes);
 }
 
 address_t DataLoader::loadRegionTo(address_t address, DataRegion *region) {
-    const std::string &source = region->getDataBytes();
+    size_t length = region->getSizeOfInitializedData();
     char *output = reinterpret_cast<char *>(address);
-    std::memcpy(output, source.c_str(), source.length());
-    size_t zeroBytes = region->getSize() - source.length();
-    std::memset(output + source.length(), 0, zeroBytes);
+    std::memcpy(output, region->getDataPointer(), length);
+    size_t zeroBytes = region->getSize() - length;
+    std::memset(output + length, 0, zeroBytes);
     return address + region->getSize();
 }
@@ -2,6 +2,9 @@
 #include <iomanip>
 #include <cstdio>  // for std::fflush
 #include <cstring>
+#include <algorithm>
+#include <map>
+#include <random>
 #include "generator.h"
 #include "chunk/cache.h"
 #include "operation/mutator.h"
@@ -9,6 +12,9 @@
 #include "pass/clearspatial.h"
 #include "instr/semantic.h"
 #include "instr/writer.h"
+#include "generate/debugelf.h"
+#include "generate/perfmap.h"
+#include "util/threadpool.h"
 
 #undef DEBUG_GROUP
 #define DEBUG_GROUP dassign
@@ -23,10 +29,19 @@ class GeneratorHelper {
 public:
     void assignAddress(ChunkType *chunk, Slot slot);
     void copyToSandbox(ChunkType *chunk, Sandbox *sandbox);
+    void copyToBuffer(ChunkType *chunk, std::string &buffer);
 private:
+    size_t getPaddingSize(ChunkType *chunk);
     void addPaddingBytes(ChunkType *chunk, Sandbox *sandbox);
+    void addPaddingBytes(ChunkType *chunk, std::string &buffer);
 };
 
+#ifdef ARCH_X86_64
+static const char paddingByte = static_cast<char>(0x90);
+#else
+static const char paddingByte = 0x0;  // Should use platform-specific NOP here
+#endif
+
 template <typename ChunkType>
 void GeneratorHelper<ChunkType>::assignAddress(ChunkType *chunk, Slot slot) {
 #if 0
@@ -41,6 +56,19 @@ void GeneratorHelper<ChunkType>::assignAddress(ChunkType *chunk, Slot slot) {
 #endif
 }
 
+template <>
+void GeneratorHelper<Function>::copyToBuffer(Function *function,
+    std::string &buffer) {
+
+    InstrWriterCppString writer(buffer);
+    for(auto b : CIter::children(function)) {
+        for(auto i : CIter::children(b)) {
+            i->getSemantic()->accept(&writer);
+        }
+    }
+    addPaddingBytes(function, buffer);
+}
+
 template <>
 void GeneratorHelper<Function>::copyToSandbox(Function *function, Sandbox *sandbox) {
     if(sandbox->supportsDirectWrites()) {
@@ -67,16 +95,30 @@ void GeneratorHelper<Function>::copyToSandbox(Function *function, Sandbox *sandb
     }
     else {
         auto backing = static_cast<MemoryBufferBacking *>(sandbox->getBacking());
-        InstrWriterCppString writer(backing->getBuffer());
-        for(auto b : CIter::children(function)) {
-            for(auto i : CIter::children(b)) {
-                i->getSemantic()->accept(&writer);
-            }
-        }
+        copyToBuffer(function, backing->getBuffer());
+        return;
     }
     addPaddingBytes(function, sandbox);
 }
 
+template <>
+void GeneratorHelper<PLTTrampoline>::copyToBuffer(PLTTrampoline *trampoline,
+    std::string &buffer) {
+
+    //size_t expectedSize = buffer.length() + PLTList::getPLTTrampolineSize();
+    size_t expectedSize = buffer.length() + trampoline->getSize();
+    trampoline->writeTo(buffer);
+#if 1
+    size_t actualSize = buffer.length();
+    if (actualSize > expectedSize) {
+        LOG(0, "Writing too much data to PLT entry!!!!!");
+    } else {
+        buffer.append(expectedSize - actualSize, (char)0xf4);
+    }
+#endif
+    addPaddingBytes(trampoline, buffer);
+}
+
 template <>
 void GeneratorHelper<PLTTrampoline>::copyToSandbox(PLTTrampoline *trampoline, Sandbox *sandbox) {
     if(sandbox->supportsDirectWrites()) {
@@ -90,51 +132,43 @@ void GeneratorHelper<PLTTrampoline>::copyToSandbox(PLTTrampoline *trampoline, Sa
     }
     else {
         auto backing = static_cast<MemoryBufferBacking *>(sandbox->getBacking());
-        //size_t expectedSize = backing->getBuffer().length() + PLTList::getPLTTrampolineSize();
-        size_t expectedSize = backing->getBuffer().length() + trampoline->getSize();
-        trampoline->writeTo(backing->getBuffer());
-#if 1
-        size_t actualSize = backing->getBuffer().length();
-        if (actualSize > expectedSize) {
-            LOG(0, "Writing too much data to PLT entry!!!!!");
-        } else {
-            backing->getBuffer().append(expectedSize - actualSize, (char)0xf4);
-        }
-#endif
+        copyToBuffer(trampoline, backing->getBuffer());
+        return;
     }
     addPaddingBytes(trampoline, sandbox);
 }
 
 template <typename ChunkType>
-void GeneratorHelper<ChunkType>::addPaddingBytes(ChunkType *chunk, Sandbox *sandbox) {
+size_t GeneratorHelper<ChunkType>::getPaddingSize(ChunkType *chunk) {
     auto assignedSize = chunk->getAssignedPosition()->getAssignedSize();
-    if(assignedSize > chunk->getSize()) {
-        // Add appropriate number of NOP bytes
-        auto padding = assignedSize - chunk->getSize();
-        if(sandbox->supportsDirectWrites()) {
-            char *output = reinterpret_cast<char *>(chunk->getAddress());
-#ifdef ARCH_X86_64
-            std::memset(output + chunk->getSize(), 0x90, padding);
-#else
-            // Should use platform-specific NOP here
-            std::memset(output + chunk->getSize(), 0x0, padding);
-#endif
-        }
-        else {
-            auto backing = static_cast<MemoryBufferBacking *>(sandbox->getBacking());
-#ifdef ARCH_X86_64
-            backing->getBuffer().append(padding, static_cast<char>(0x90));
-#else
-            // Should use platform-specific NOP here
-            backing->getBuffer().append(padding, static_cast<char>(0x0));
-#endif
-        }
-    }
-    else if(assignedSize < chunk->getSize()) {
+    if(assignedSize < chunk->getSize()) {
         LOG(0, "ERROR: assigned size " << std::dec << assignedSize
             << " is too small to store chunk ["
             << chunk->getName() << "] of size " << chunk->getSize());
+        return 0;
     }
+    return assignedSize - chunk->getSize();
+}
+
+template <typename ChunkType>
+void GeneratorHelper<ChunkType>::addPaddingBytes(ChunkType *chunk, Sandbox *sandbox) {
+    if(!sandbox->supportsDirectWrites()) {
+        auto backing = static_cast<MemoryBufferBacking *>(sandbox->getBacking());
+        addPaddingBytes(chunk, backing->getBuffer());
+        return;
+    }
+
+    // Add appropriate number of NOP bytes
+    auto padding = getPaddingSize(chunk);
+    char *output = reinterpret_cast<char *>(chunk->getAddress());
+    std::memset(output + chunk->getSize(), paddingByte, padding);
+}
+
+template <typename ChunkType>
+void GeneratorHelper<ChunkType>::addPaddingBytes(ChunkType *chunk,
+    std::string &buffer) {
+
+    buffer.append(getPaddingSize(chunk), paddingByte);
 }
 
 void Generator::assignAddresses(Program *program) {
@@ -144,9 +178,12 @@ void Generator::assignAddresses(Program *program) {
 }
 
 void Generator::generateCode(Program *program, const std::vector<Function *> &order) {
+    // addresses are final now, and writing instructions queries them a lot
+    PositionManager::freeze(program);
     for(auto module : CIter::modules(program)) {
         generateCode(module, order);
     }
+    PositionManager::thaw();
 }
 
 void Generator::assignAddresses(Program *program, const std::vector<Function *> &order) {
@@ -156,9 +193,35 @@ void Generator::assignAddresses(Program *program, const std::vector<Function *>
 }
 
 void Generator::generateCode(Program *program) {
+    // addresses are final now, and writing instructions queries them a lot
+    PositionManager::freeze(program);
+
+    if(!sandbox->supportsDirectWrites()) {
+        // the buffer has to be filled module by module
+        for(auto module : CIter::modules(program)) {
+            generateCode(module);
+        }
+        PositionManager::thaw();
+        return;
+    }
+
+    // Slots are fixed for the whole program, so all functions can go into
+    // one parallel loop: small libraries don't each start a thread pool,
+    // and a large one (e.g. libc) doesn't leave the other workers idle.
+    std::vector<Function *> order;
     for(auto module : CIter::modules(program)) {
-        generateCode(module);
+        auto moduleOrder = pickFunctionOrder(module);
+        order.insert(order.end(), moduleOrder.begin(), moduleOrder.end());
     }
+    LOG(1, "Copying code into sandbox");
+    copyFunctionsToSandbox(order);
+
+    for(auto module : CIter::modules(program)) {
+        if(!module->getPLTList()) continue;
+        LOG(1, "Copying PLT entries into sandbox");
+        copyPLTsToSandbox(module);
+    }
+    PositionManager::thaw();
 }
 
 std::vector<Function *> Generator::pickFunctionOrder(Module *module) {
@@ -193,20 +256,58 @@ std::vector<Function *> Generator::pickFunctionOrder(Module *module) {
     return order;
 }
 
+std::vector<PLTTrampoline *> Generator::pickPLTOrder(Module *module) {
+    std::vector<PLTTrampoline *> order;
+    for(auto plt : CIter::plts(module)) {
+        order.push_back(plt);
+    }
+    if(!packHotPLTs) return order;
+
+    // Without a runtime profile, the number of call sites stands in for
+    // how often an entry is used. Packing the busiest entries together
+    // keeps them on fewer cache lines and pages.
+    std::map<PLTTrampoline *, size_t> callCount;
+    for(auto function : CIter::functions(module)) {
+        for(auto block : CIter::children(function)) {
+            for(auto instr : CIter::children(block)) {
+                auto link = instr->getSemantic()->getLink();
+                if(auto pltLink = dynamic_cast<PLTLink *>(link)) {
+                    callCount[pltLink->getPLTTrampoline()] ++;
+                }
+            }
+        }
+    }
+    std::stable_sort(order.begin(), order.end(),
+        [&callCount] (PLTTrampoline *a, PLTTrampoline *b)
+            { return callCount[a] > callCount[b]; });
+    return order;
+}
+
+void Generator::shuffleFunctionOrder(std::vector<Function *> &order) {
+    auto begin = order.begin();
+#ifdef LINUX_KERNEL_MODE
+    // startup_64 has to stay first
+    if(begin != order.end()) ++begin;
+#endif
+
+    // a fresh seed per load; the layout is not meant to be reproducible
+    std::random_device seed;
+    std::mt19937_64 engine(
+        (static_cast<uint64_t>(seed()) << 32) | seed());
+    std::shuffle(begin, order.end(), engine);
+}
+
 void Generator::assignAddresses(Module *module) {
+    // generateCode() picks the order again from the assigned addresses,
+    // so a shuffled order is only needed here
     auto order = pickFunctionOrder(module);
-    for(auto f : order) {
-        auto slot = sandbox->allocate(f->getSize());
-        LOG(2, "    alloc 0x" << std::hex << slot.getAddress()
-            << " for [" << f->getName()
-            << "] size " << std::dec << f->getSize());
-        GeneratorHelper<Function>().assignAddress(f, slot);
-    }
+    if(shuffleFunctions) shuffleFunctionOrder(order);
+    assignFunctionAddresses(order);
 
     if(module->getPLTList()) {
         // these don't have to be contiguous
         //const size_t pltSize = PLTList::getPLTTrampolineSize();
-        for(auto plt : CIter::plts(module)) {
+        for(auto plt : pickPLTOrder(module)) {
             auto slot = sandbox->allocate(plt->getSize());
             LOG(2, "    alloc 0x" << std::hex << slot.getAddress()
                 << " for [" << plt->getName()
@@ -219,37 +320,54 @@ void Generator::assignAddresses(Module *module) {
     module->accept(&clearSpatial);
 }
 
-void Generator::generateCode(Module *module) {
-    LOG(1, "Copying code into sandbox");
-    auto order = pickFunctionOrder(module);
-    for(auto f : order) {
-        LOG(2, "    writing out [" << f->getName() << "] at 0x"
-            << std::hex << f->getAddress());
+void Generator::assignFunctionAddresses(const std::vector<Function *> &order) {
+    for(size_t i = 0; i < order.size(); i ++) {
+        auto f = order[i];
+        size_t size = f->getSize();
+
+        // The gap before an aligned function is part of the slot of the
+        // one before it, so that it gets filled with padding bytes in
+        // either kind of sandbox.
+        auto next = (i + 1 < order.size()) ? order[i + 1] : nullptr;
+        if(next && next->getAlignment() > 1) {
+            auto alignment = next->getAlignment();
+            address_t start = sandbox->getWatermark();
+            address_t end = (start + size + alignment - 1) & ~(alignment - 1);
+            size = end - start;
+        }
 
-        GeneratorHelper<Function>().copyToSandbox(f, sandbox);
+        auto slot = sandbox->allocate(size);
+        LOG(2, "    alloc 0x" << std::hex << slot.getAddress()
+            << " for [" << f->getName()
+            << "] size " << std::dec << f->getSize());
+        GeneratorHelper<Function>().assignAddress(f, slot);
+
+        if(f->getAlignment() > 1
+            && (slot.getAddress() & (f->getAlignment() - 1))) {
+
+            LOG(1, "    [" << f->getName() << "] could not be aligned to "
+                << f->getAlignment() << " bytes");
+        }
     }
+}
+
+void Generator::generateCode(Module *module) {
+    LOG(1, "Copying code into sandbox");
+    copyFunctionsToSandbox(pickFunctionOrder(module));
 
     if(module->getPLTList()) {
         LOG(1, "Copying PLT entries into sandbox");
-        for(auto plt : CIter::plts(module)) {
-            GeneratorHelper<PLTTrampoline>().copyToSandbox(plt, sandbox);
-        }
+        copyPLTsToSandbox(module);
     }
 }
 
 void Generator::assignAddresses(Module *module, const std::vector<Function *> &order) {
-    for(auto f : order) {
-        auto slot = sandbox->allocate(f->getSize());
-        LOG(2, "    alloc 0x" << std::hex << slot.getAddress()
-            << " for [" << f->getName()
-            << "] size " << std::dec << f->getSize());
-        GeneratorHelper<Function>().assignAddress(f, slot);
-    }
+    assignFunctionAddresses(order);
 
     if(module->getPLTList()) {
         // these don't have to be contiguous
         //const size_t pltSize = PLTList::getPLTTrampolineSize();
-        for(auto plt : CIter::plts(module)) {
+        for(auto plt : pickPLTOrder(module)) {
             auto slot = sandbox->allocate(plt->getSize());
             LOG(2, "    alloc 0x" << std::hex << slot.getAddress()
                 << " for [" << plt->getName()
@@ -264,17 +382,77 @@ void Generator::assignAddresses(Module *module, const std::vector<Function *> &o
 
 void Generator::generateCode(Module *module, const std::vector<Function *> &order) {
     LOG(1, "Copying code into sandbox");
-    for(auto f : order) {
-        LOG(2, "    writing out [" << f->getName() << "] at 0x"
-            << std::hex << f->getAddress());
-
-        GeneratorHelper<Function>().copyToSandbox(f, sandbox);
-    }
+    copyFunctionsToSandbox(order);
 
     if(module->getPLTList()) {
         LOG(1, "Copying PLT entries into sandbox");
-        for(auto plt : CIter::plts(module)) {
-            GeneratorHelper<PLTTrampoline>().copyToSandbox(plt, sandbox);
+        copyPLTsToSandbox(module);
+    }
+}
+
+void Generator::copyFunctionsToSandbox(const std::vector<Function *> &order) {
+    ThreadPool pool;
+    if(!pool.isParallel()) {
+        for(auto f : order) {
+            LOG(2, "    writing out [" << f->getName() << "] at 0x"
+                << std::hex << f->getAddress());
+
+            GeneratorHelper<Function>().copyToSandbox(f, sandbox);
+        }
+        return;
+    }
+
+    // Addresses are already assigned, so each function's code only depends
+    // on the function itself.
+    if(sandbox->supportsDirectWrites()) {
+        // every function writes to its own slot
+        pool.parallelFor(order.size(), [&] (size_t i) {
+            GeneratorHelper<Function>().copyToSandbox(order[i], sandbox);
+        });
+    }
+    else {
+        // the buffer is appended to in order, so encode into separate
+        // strings first and concatenate them afterwards
+        std::vector<std::string> codeList(order.size());
+        pool.parallelFor(order.size(), [&] (size_t i) {
+            GeneratorHelper<Function>().copyToBuffer(order[i], codeList[i]);
+        });
+
+        auto backing = static_cast<MemoryBufferBacking *>(sandbox->getBacking());
+        for(auto &code : codeList) {
+            backing->getBuffer().append(code);
+        }
+    }
+}
+
+void Generator::copyPLTsToSandbox(Module *module) {
+    // entries go out in address order, which may not be list order if
+    // hot entries were packed together
+    std::vector<PLTTrampoline *> order;
+    for(auto plt : CIter::plts(module)) {
+        order.push_back(plt);
+    }
+    std::stable_sort(order.begin(), order.end(),
+        [] (PLTTrampoline *a, PLTTrampoline *b)
+            { return a->getAddress() < b->getAddress(); });
+
+    // each entry only depends on itself, as for functions
+    ThreadPool pool;
+    if(sandbox->supportsDirectWrites()) {
+        pool.parallelFor(order.size(), [&] (size_t i) {
+            GeneratorHelper<PLTTrampoline>().copyToSandbox(order[i], sandbox);
+        });
+    }
+    else {
+        std::vector<std::string> codeList(order.size());
+        pool.parallelFor(order.size(), [&] (size_t i) {
+            GeneratorHelper<PLTTrampoline>().copyToBuffer(order[i],
+                codeList[i]);
+        });
+
+        auto backing = static_cast<MemoryBufferBacking *>(sandbox->getBacking());
+        for(auto &code : codeList) {
+            backing->getBuffer().append(code);
         }
     }
 }
@@ -309,11 +487,20 @@ void Generator::pickPLTAddressInSandbox(PLTTrampoline *trampoline) {
 void Generator::assignAndGenerate(Function *function) {
     pickFunctionAddressInSandbox(function);
     GeneratorHelper<Function>().copyToSandbox(function, sandbox);
+    if(auto perfMap = PerfMap::getInstance()) {
+        if(sandbox->supportsDirectWrites()) perfMap->add(function);
+    }
+    if(auto debugElf = DebugElfWriter::getInstance()) {
+        if(sandbox->supportsDirectWrites()) debugElf->add(function);
+    }
 }
 
 void Generator::assignAndGenerate(PLTTrampoline *trampoline) {
     pickPLTAddressInSandbox(trampoline);
     GeneratorHelper<PLTTrampoline>().copyToSandbox(trampoline, sandbox);
+    if(auto perfMap = PerfMap::getInstance()) {
+        if(sandbox->supportsDirectWrites()) perfMap->add(trampoline);
+    }
 }
 
 void Generator::jumpToSandbox(Module *module, const char *function) {
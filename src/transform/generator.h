@@ -10,9 +10,19 @@ class Generator {
 private:
     Sandbox *sandbox;
     bool useDisps;
+    bool packHotPLTs;
+    bool shuffleFunctions;
 public:
     Generator(Sandbox *sandbox, bool useDisps = true)
-        : sandbox(sandbox), useDisps(useDisps) {}
+        : sandbox(sandbox), useDisps(useDisps), packHotPLTs(false),
+        shuffleFunctions(false) {}
+
+    /** Places the PLT entries with the most call sites first. */
+    void setPackHotPLTs(bool pack) { packHotPLTs = pack; }
+    /** Places each module's functions in a random order. Addresses are
+        still assigned in one pass over the sizes, and generateCode()
+        writes the functions out in parallel as usual. */
+    void setShuffleFunctions(bool shuffle) { shuffleFunctions = shuffle; }
 
     void assignAddresses(Program *program);
     void generateCode(Program *program);
@@ -38,6 +48,11 @@ public:
     void jumpToSandbox(Module *module, const char *function = "main");
 private:
     std::vector<Function *> pickFunctionOrder(Module *module);
+    void shuffleFunctionOrder(std::vector<Function *> &order);
+    std::vector<PLTTrampoline *> pickPLTOrder(Module *module);
+    void assignFunctionAddresses(const std::vector<Function *> &order);
+    void copyFunctionsToSandbox(const std::vector<Function *> &order);
+    void copyPLTsToSandbox(Module *module);
     void pickFunctionAddressInSandbox(Function *function);
     void pickPLTAddressInSandbox(PLTTrampoline *trampoline);
 };
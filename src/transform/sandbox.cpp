@@ -1,12 +1,17 @@
 #include <iostream>
+#include <algorithm>
 #include <cstring>
 #include <sys/mman.h>
 #include "sandbox.h"
 #include "chunk/module.h"
 #include "config.h"
 
+#define PAGE_SIZE_MASK      (0x1000 - 1)
+#define WRITE_BATCH_SIZE    0x10000
+
 MemoryBacking::MemoryBacking(address_t address, size_t size)
-    : SandboxBackingImpl(address, size) {
+    : SandboxBackingImpl(address, size), writable(true),
+    windowBegin(address), windowEnd(address + size) {
 
     address_t base = (address_t) mmap((void *)address, size,
         PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS
@@ -21,17 +26,83 @@ MemoryBacking::MemoryBacking(address_t address, size_t size)
     setBase(base);
 }
 
+void MemoryBacking::protect(address_t begin, address_t end, int prot) {
+    if(begin < end) mprotect((void *)begin, end - begin, prot);
+}
+
+void MemoryBacking::prepareWrite(address_t address, size_t size) {
+    address_t begin = address & ~PAGE_SIZE_MASK;
+    address_t end = (address + size + PAGE_SIZE_MASK) & ~PAGE_SIZE_MASK;
+    if(begin >= windowBegin && end <= windowEnd) return;
+
+    // widen ahead of the allocation; those pages hold no code yet
+    end = (end + WRITE_BATCH_SIZE - 1) & ~(WRITE_BATCH_SIZE - 1);
+    end = std::min(end, getBase() + getSize());
+
+    if(windowBegin == windowEnd) {
+        windowBegin = begin;
+        windowEnd = begin;
+    }
+    address_t newBegin = std::min(begin, windowBegin);
+    address_t newEnd = std::max(end, windowEnd);
+    if(writable) {
+        protect(newBegin, windowBegin, PROT_READ | PROT_WRITE);
+        protect(windowEnd, newEnd, PROT_READ | PROT_WRITE);
+    }
+    windowBegin = newBegin;
+    windowEnd = newEnd;
+}
+
+MemoryBacking SandboxRegionPool::acquire() {
+    std::lock_guard<std::mutex> lock(mutex);
+    address_t address;
+    if(!freeList.empty()) {
+        address = freeList.back();
+        freeList.pop_back();
+        stats.free --;
+    }
+    else {
+        address = *cursor;
+        *cursor += stride;
+    }
+
+    MemoryBacking backing(address, regionSize);  // maps it again
+    stats.inUse ++;
+    if(stats.inUse > stats.peak) stats.peak = stats.inUse;
+    return backing;
+}
+
+void SandboxRegionPool::release(MemoryBacking *backing) {
+    munmap((void *)backing->getBase(), backing->getSize());
+
+    std::lock_guard<std::mutex> lock(mutex);
+    freeList.push_back(backing->getBase());
+    stats.inUse --;
+    stats.free ++;
+}
+
+SandboxRegionPool::Stats SandboxRegionPool::getStats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
 void MemoryBacking::finalize() {
-    mprotect((void *)getBase(), getSize(), PROT_READ | PROT_EXEC);
+    if(writable) protect(windowBegin, windowEnd, PROT_READ | PROT_EXEC);
+    writable = false;
+    windowBegin = windowEnd = 0;
 }
 
 bool MemoryBacking::reopen() {
-    mprotect((void *)getBase(), getSize(), PROT_READ | PROT_WRITE);
+    // slots allocated since the last batch were only recorded
+    if(!writable) protect(windowBegin, windowEnd, PROT_READ | PROT_WRITE);
+    writable = true;
     return true;
 }
 
 void MemoryBacking::recreate() {
-    std::memset((void *)getBase(), 0, getSize());
+    // drops the pages instead of writing 16MB of zeroes; anonymous private
+    // memory reads back as zero, and protections are left as they are
+    madvise((void *)getBase(), getSize(), MADV_DONTNEED);
 }
 
 MemoryBufferBacking::MemoryBufferBacking(address_t address, size_t size)
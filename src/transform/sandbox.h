@@ -4,6 +4,7 @@
 #include <vector>
 #include <new>
 #include <string>
+#include <mutex>
 #include "slot.h"
 #include "types.h"
 #include "elf/elfspace.h"
@@ -40,8 +41,21 @@ protected:
     void setBase(address_t base) { this->base = base; }
 };
 
-// Mapped at final base address, can directly write to mem addresses.
+/** Mapped at final base address, can directly write to mem addresses.
+
+    Protections are changed in batches. Only the pages that allocated
+    slots fall in are ever made writable: reopen() just starts a batch,
+    each allocation widens one contiguous writable window (in
+    WRITE_BATCH_SIZE steps, since bump allocation grows it upward), and
+    finalize() makes the window executable again with one mprotect.
+    Generating one function thus costs two small mprotects instead of two
+    over the whole sandbox, and a loop over many functions only a few.
+*/
 class MemoryBacking : public SandboxBackingImpl {
+private:
+    bool writable;          // between reopen() and finalize()
+    address_t windowBegin;  // page-aligned range that is (or will be) RW
+    address_t windowEnd;
 public:
     /** May throw std::bad_alloc. */
     MemoryBacking(address_t address, size_t size);
@@ -51,17 +65,25 @@ public:
     virtual void finalize();
     virtual bool reopen();
     virtual void recreate();
+
+    /** Makes [address, address+size) writable in the current batch. */
+    void prepareWrite(address_t address, size_t size);
+private:
+    void protect(address_t begin, address_t end, int prot);
 };
 
 // Not mapped at final address, please write into the buffer instead.
 class MemoryBufferBacking : public SandboxBackingImpl {
 private:
     std::string buffer;
+    std::string image;
 public:
     // Ensure that address is already mapped before calling this function
     MemoryBufferBacking(address_t address, size_t size);
 
     virtual std::string &getBuffer() { return buffer; }
+    /** The whole output ELF, when it is generated without a filename. */
+    std::string &getImage() { return image; }
     virtual bool supportsDirectWrites() const { return false; }
 
     virtual void finalize();
@@ -156,6 +178,9 @@ public:
 
     virtual SandboxBacking *getBacking() = 0;
     virtual bool supportsDirectWrites() const = 0;
+
+    /** End of the space allocated so far. */
+    virtual address_t getWatermark() const = 0;
 };
 
 template <typename T> struct id { typedef T type; };
@@ -169,8 +194,7 @@ public:
     SandboxImpl(const Backing &backing)
         : backing(backing), alloc(Allocator(&this->backing)) {}
 
-    virtual Slot allocate(size_t request)
-        { return alloc.allocate(request); }
+    virtual Slot allocate(size_t request);
     virtual void finalize() { backing.finalize(); }
     virtual bool reopen() { return backing.reopen(); }
 
@@ -178,17 +202,61 @@ public:
     virtual SandboxBacking *getBacking() { return &backing; }
     virtual bool supportsDirectWrites() const
         { return backing.supportsDirectWrites(); }
+    virtual address_t getWatermark() const { return alloc.getCurrent(); }
 
 private:
     void recreate(id<MemoryBacking>);
+    void prepareWrite(id<MemoryBacking>, const Slot &slot)
+        { backing.prepareWrite(slot.getAddress(), slot.getSize()); }
+    template <typename OtherBacking>
+    void prepareWrite(id<OtherBacking>, const Slot &slot) {}
 };
 
+template <typename Backing, typename Allocator>
+Slot SandboxImpl<Backing, Allocator>::allocate(size_t request) {
+    auto slot = alloc.allocate(request);
+    prepareWrite(id<Backing>(), slot);
+    return slot;
+}
+
 template <typename Backing, typename Allocator>
 void SandboxImpl<Backing, Allocator>::recreate(id<MemoryBacking>) {
     backing.recreate(/*alloc.getCurrent()*/);
     alloc.reset();
 }
 
+/** Recycles fixed-size MemoryBacking regions, such as the halves of a
+    ShufflingSandbox. A released region is unmapped and its address goes on
+    a free list. Threads that come and go then reuse the same part of the
+    sandbox address space (32-bit on x86_64) instead of consuming more.
+    Safe to call from any thread.
+*/
+class SandboxRegionPool {
+public:
+    struct Stats {
+        size_t inUse;   // regions handed out
+        size_t free;    // unmapped holes waiting for reuse
+        size_t peak;    // most regions ever in use at once
+    };
+private:
+    address_t *cursor;  // next unused address, shared with other sandboxes
+    size_t regionSize;
+    size_t stride;
+    std::vector<address_t> freeList;
+    Stats stats;
+    std::mutex mutex;
+public:
+    SandboxRegionPool(address_t *cursor, size_t regionSize, size_t stride)
+        : cursor(cursor), regionSize(regionSize), stride(stride),
+        stats{0, 0, 0} {}
+
+    /** May throw std::bad_alloc. */
+    MemoryBacking acquire();
+    void release(MemoryBacking *backing);
+
+    Stats getStats();
+};
+
 template <typename SandboxImplType>
 class DualSandbox : public Sandbox {
 private:
@@ -200,6 +268,7 @@ public:
         : sandbox{one, other}, i(0) {}
     void flip() { i^= 1; }
     //Sandbox *get() const { return sandbox[i]; }
+    SandboxImplType *getHalf(size_t which) const { return sandbox[which]; }
 
     virtual Slot allocate(size_t request)
         { return sandbox[i]->allocate(request); }
@@ -209,6 +278,8 @@ public:
     virtual SandboxBacking *getBacking() { return sandbox[i]->getBacking(); }
     virtual bool supportsDirectWrites() const
         { return sandbox[i]->supportsDirectWrites(); }
+    virtual address_t getWatermark() const
+        { return sandbox[i]->getWatermark(); }
 };
 
 using ShufflingSandbox = DualSandbox<
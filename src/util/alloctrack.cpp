@@ -0,0 +1,131 @@
+#include "alloctrack.h"
+
+#ifdef EGALITO_ALLOC_TRACKING
+
+#include <algorithm>
+#include <vector>
+#include <new>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <malloc.h>  // for malloc_usable_size
+
+AllocationTracker::Entry AllocationTracker::entryList[MAX_ENTRIES];
+std::atomic<size_t> AllocationTracker::entryCount(0);
+std::atomic<AllocationTracker::Entry *> AllocationTracker::current(nullptr);
+
+// allocations made outside of any pass
+static const char *OUTSIDE_NAME = "(no pass)";
+
+void AllocationTracker::recordAllocation(void *pointer) {
+    auto entry = current.load(std::memory_order_relaxed);
+    if(!entry) entry = &entryList[0];
+    entry->allocations.fetch_add(1, std::memory_order_relaxed);
+    entry->bytes.fetch_add(malloc_usable_size(pointer),
+        std::memory_order_relaxed);
+}
+
+void AllocationTracker::recordFree(void *pointer) {
+    if(!pointer) return;
+    auto entry = current.load(std::memory_order_relaxed);
+    if(!entry) entry = &entryList[0];
+    entry->frees.fetch_add(1, std::memory_order_relaxed);
+    entry->freedBytes.fetch_add(malloc_usable_size(pointer),
+        std::memory_order_relaxed);
+}
+
+AllocationTracker::Entry *AllocationTracker::getEntry(const char *name) {
+    // entries are only added here, while holding this spinlock
+    static std::atomic_flag lock = ATOMIC_FLAG_INIT;
+    while(lock.test_and_set(std::memory_order_acquire)) {}
+
+    if(entryCount.load() == 0) {
+        entryList[0].name = OUTSIDE_NAME;
+        entryCount.store(1);
+        std::atexit(&AllocationTracker::dump);
+    }
+
+    Entry *found = nullptr;
+    size_t count = entryCount.load();
+    for(size_t i = 0; i < count; i ++) {
+        if(entryList[i].name == name
+            || std::strcmp(entryList[i].name, name) == 0) {
+
+            found = &entryList[i];
+            break;
+        }
+    }
+    if(!found) {
+        // the last entry collects all passes past MAX_ENTRIES
+        found = &entryList[count < MAX_ENTRIES ? count : MAX_ENTRIES - 1];
+        if(count < MAX_ENTRIES) {
+            found->name = name;
+            entryCount.store(count + 1);
+        }
+    }
+
+    lock.clear(std::memory_order_release);
+    return found;
+}
+
+void AllocationTracker::dump() {
+    std::vector<Entry *> sorted;
+    for(size_t i = 0; i < entryCount.load(); i ++) {
+        sorted.push_back(&entryList[i]);
+    }
+    std::sort(sorted.begin(), sorted.end(), [] (Entry *a, Entry *b) {
+        return a->bytes.load() > b->bytes.load();
+    });
+
+    FILE *file = stderr;
+    if(const char *filename = getenv("EGALITO_ALLOC_FILE")) {
+        if(FILE *f = std::fopen(filename, "w")) file = f;
+    }
+
+    std::fprintf(file, "=== allocations by pass ===\n");
+    std::fprintf(file, "%12s %12s %12s %12s  %s\n",
+        "allocations", "KiB", "frees", "KiB kept", "pass");
+    for(auto entry : sorted) {
+        long kept = static_cast<long>(entry->bytes.load())
+            - static_cast<long>(entry->freedBytes.load());
+        std::fprintf(file, "%12lu %12lu %12lu %12ld  %s\n",
+            entry->allocations.load(), entry->bytes.load() / 1024,
+            entry->frees.load(), kept / 1024, entry->name);
+    }
+    if(file != stderr) std::fclose(file);
+}
+
+AllocationScope::AllocationScope(const char *pass)
+    : previous(AllocationTracker::getCurrent()) {
+
+    AllocationTracker::setCurrent(AllocationTracker::getEntry(pass));
+}
+
+static void *allocate(size_t size) {
+    void *pointer = std::malloc(size ? size : 1);
+    if(!pointer) throw std::bad_alloc();
+    AllocationTracker::recordAllocation(pointer);
+    return pointer;
+}
+
+static void release(void *pointer) {
+    AllocationTracker::recordFree(pointer);
+    std::free(pointer);
+}
+
+void *operator new(size_t size) { return allocate(size); }
+void *operator new[](size_t size) { return allocate(size); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    void *pointer = std::malloc(size ? size : 1);
+    if(pointer) AllocationTracker::recordAllocation(pointer);
+    return pointer;
+}
+void *operator new[](size_t size, const std::nothrow_t &tag) noexcept {
+    return operator new(size, tag);
+}
+void operator delete(void *pointer) noexcept { release(pointer); }
+void operator delete[](void *pointer) noexcept { release(pointer); }
+void operator delete(void *pointer, size_t) noexcept { release(pointer); }
+void operator delete[](void *pointer, size_t) noexcept { release(pointer); }
+
+#endif
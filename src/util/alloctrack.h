@@ -0,0 +1,60 @@
+#ifndef EGALITO_UTIL_ALLOC_TRACK_H
+#define EGALITO_UTIL_ALLOC_TRACK_H
+
+#include <atomic>
+#include <cstddef>
+
+/** Counts heap allocations made through operator new, by pass.
+
+    Only compiled in when EGALITO_ALLOC_TRACKING is defined (build with
+    ALLOC_TRACKING=1), since it replaces the global operator new and
+    delete. Every RUN_PASS opens an AllocationScope; allocations and frees
+    made by any thread while it is the innermost scope are charged to that
+    pass, so passes run with RUN_PASS_PARALLEL include their workers. At
+    exit, totals by pass are written to EGALITO_ALLOC_FILE, or to stderr.
+    Slab-allocated chunks show up as whole slabs (see SlabAllocator).
+    test/bench replaces operator new itself, so don't combine the two.
+*/
+class AllocationTracker {
+public:
+    struct Entry {
+        const char *name;
+        std::atomic<unsigned long> allocations;
+        std::atomic<unsigned long> bytes;
+        std::atomic<unsigned long> frees;
+        std::atomic<unsigned long> freedBytes;
+    };
+private:
+    // Entries are never freed, so that late destructors can still count.
+    static const size_t MAX_ENTRIES = 512;
+    static Entry entryList[MAX_ENTRIES];
+    static std::atomic<size_t> entryCount;
+    static std::atomic<Entry *> current;
+public:
+    static void recordAllocation(void *pointer);
+    static void recordFree(void *pointer);
+
+    /** Finds or adds the entry for a pass name with static storage. */
+    static Entry *getEntry(const char *name);
+    static Entry *getCurrent() { return current.load(); }
+    static void setCurrent(Entry *entry) { current.store(entry); }
+
+    static void dump();
+};
+
+/** Charges allocations to a pass for the lifetime of this object. */
+class AllocationScope {
+private:
+    AllocationTracker::Entry *previous;
+public:
+    AllocationScope(const char *pass);
+    ~AllocationScope() { AllocationTracker::setCurrent(previous); }
+};
+
+#ifdef EGALITO_ALLOC_TRACKING
+    #define ALLOCATION_SCOPE(pass)  AllocationScope _allocationScope(pass)
+#else
+    #define ALLOCATION_SCOPE(pass)  do {} while(0)
+#endif
+
+#endif
@@ -0,0 +1,114 @@
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include "bufferedfile.h"
+#include "log/log.h"
+
+BufferedFileBuf::BufferedFileBuf(size_t bufferSize)
+    : fd(-1), ownFd(false), failed(false), buffer(bufferSize) {
+
+    setp(buffer.data(), buffer.data() + buffer.size());
+}
+
+BufferedFileBuf::~BufferedFileBuf() {
+    close();
+}
+
+bool BufferedFileBuf::open(const std::string &filename) {
+    close();
+    fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+        0644);
+    if(fd < 0) {
+        LOG(1, "can't open [" << filename << "] for writing: "
+            << std::strerror(errno));
+        return false;
+    }
+    ownFd = true;
+    failed = false;
+    return true;
+}
+
+void BufferedFileBuf::attach(int fd) {
+    close();
+    this->fd = fd;
+    this->ownFd = false;
+    this->failed = false;
+}
+
+void BufferedFileBuf::close() {
+    if(fd < 0) return;
+    flushBuffer();
+    if(ownFd) ::close(fd);
+    fd = -1;
+    ownFd = false;
+}
+
+BufferedFileBuf::int_type BufferedFileBuf::overflow(int_type c) {
+    if(!flushBuffer()) return traits_type::eof();
+    if(!traits_type::eq_int_type(c, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+std::streamsize BufferedFileBuf::xsputn(const char *s, std::streamsize n) {
+    size_t size = static_cast<size_t>(n);
+    size_t room = epptr() - pptr();
+    if(size <= room) {
+        std::memcpy(pptr(), s, size);
+        pbump(static_cast<int>(size));
+        return n;
+    }
+
+    // too large to buffer: flush what we have, then write directly
+    if(!flushBuffer()) return 0;
+    if(size < buffer.size()) {
+        std::memcpy(pptr(), s, size);
+        pbump(static_cast<int>(size));
+        return n;
+    }
+    return writeAll(s, size) ? n : 0;
+}
+
+int BufferedFileBuf::sync() {
+    return flushBuffer() ? 0 : -1;
+}
+
+bool BufferedFileBuf::flushBuffer() {
+    size_t size = pptr() - pbase();
+    bool ok = writeAll(pbase(), size);
+    setp(buffer.data(), buffer.data() + buffer.size());
+    return ok;
+}
+
+bool BufferedFileBuf::writeAll(const char *data, size_t size) {
+    if(fd < 0 || failed) return size == 0;
+
+    while(size > 0) {
+        ssize_t n = ::write(fd, data, size);
+        if(n < 0) {
+            if(errno == EINTR) continue;
+            LOG(1, "write failed: " << std::strerror(errno));
+            failed = true;
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool BufferedFileStream::open(const std::string &filename) {
+    clear();
+    if(!buf.open(filename)) {
+        setstate(std::ios::failbit);
+        return false;
+    }
+    return true;
+}
+
+void BufferedFileStream::close() {
+    buf.close();
+}
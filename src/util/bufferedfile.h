@@ -0,0 +1,54 @@
+#ifndef EGALITO_UTIL_BUFFERED_FILE_H
+#define EGALITO_UTIL_BUFFERED_FILE_H
+
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+/** Stream buffer that collects output in one large block and hands it to
+    write(2) only when the block fills up (or on flush), instead of going
+    through stdio for every line.
+*/
+class BufferedFileBuf : public std::streambuf {
+public:
+    enum { DEFAULT_BUFFER_SIZE = 1 << 20 };
+private:
+    int fd;
+    bool ownFd;
+    bool failed;
+    std::vector<char> buffer;
+public:
+    BufferedFileBuf(size_t bufferSize = DEFAULT_BUFFER_SIZE);
+    virtual ~BufferedFileBuf();
+
+    bool open(const std::string &filename);
+    void attach(int fd);  // not closed by this object
+    void close();
+    bool isOpen() const { return fd >= 0; }
+    bool hasFailed() const { return failed; }
+protected:
+    virtual int_type overflow(int_type c);
+    virtual std::streamsize xsputn(const char *s, std::streamsize n);
+    virtual int sync();
+private:
+    bool flushBuffer();
+    bool writeAll(const char *data, size_t size);
+};
+
+/** Output file stream backed by a BufferedFileBuf. */
+class BufferedFileStream : public std::ostream {
+private:
+    BufferedFileBuf buf;
+public:
+    BufferedFileStream() : std::ostream(&buf) {}
+    BufferedFileStream(const std::string &filename)
+        : std::ostream(&buf) { open(filename); }
+    virtual ~BufferedFileStream() { close(); }
+
+    bool open(const std::string &filename);
+    void close();
+    bool isOpen() const { return buf.isOpen(); }
+};
+
+#endif
@@ -0,0 +1,100 @@
+#include <cstring>  // for std::memcmp
+#include <cstdint>
+#include "bytescan.h"
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#elif defined(__ARM_NEON)
+    #include <arm_neon.h>
+#endif
+
+#define VECTOR_SIZE     16
+
+// one bit per byte position whose first and last pattern bytes both match
+static uint32_t candidateMask(const char *first, const char *last,
+    char firstByte, char lastByte) {
+
+#if defined(__SSE2__)
+    auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+    auto b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(last));
+    auto eq = _mm_and_si128(
+        _mm_cmpeq_epi8(a, _mm_set1_epi8(firstByte)),
+        _mm_cmpeq_epi8(b, _mm_set1_epi8(lastByte)));
+    return static_cast<uint32_t>(_mm_movemask_epi8(eq));
+#elif defined(__ARM_NEON)
+    auto a = vld1q_u8(reinterpret_cast<const uint8_t *>(first));
+    auto b = vld1q_u8(reinterpret_cast<const uint8_t *>(last));
+    auto eq = vandq_u8(
+        vceqq_u8(a, vdupq_n_u8(static_cast<uint8_t>(firstByte))),
+        vceqq_u8(b, vdupq_n_u8(static_cast<uint8_t>(lastByte))));
+    // NEON has no movemask; narrow each byte to a nibble instead
+    uint64_t nibbles = vget_lane_u64(vreinterpret_u64_u8(
+        vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+    uint32_t mask = 0;
+    for(int i = 0; nibbles; i ++, nibbles >>= 4) {
+        if(nibbles & 0xf) mask |= 1u << i;
+    }
+    return mask;
+#else
+    uint32_t mask = 0;
+    for(int i = 0; i < VECTOR_SIZE; i ++) {
+        if(first[i] == firstByte && last[i] == lastByte) mask |= 1u << i;
+    }
+    return mask;
+#endif
+}
+
+template <typename FoundType>
+void BytePattern::scan(const char *data, size_t size, FoundType found) const {
+    const size_t length = pattern.length();
+    if(length == 0 || size < length) return;
+
+    const char *p = pattern.data();
+    const size_t end = size - length + 1;  // one past the last start offset
+    size_t i = 0;
+    for(; i + VECTOR_SIZE <= end; i += VECTOR_SIZE) {
+        uint32_t mask = candidateMask(data + i, data + i + length - 1,
+            p[0], p[length - 1]);
+        while(mask) {
+            size_t offset = i + __builtin_ctz(mask);
+            mask &= mask - 1;
+            if(length <= 2
+                || !std::memcmp(data + offset + 1, p + 1, length - 2)) {
+
+                if(found(offset)) return;
+            }
+        }
+    }
+    for(; i < end; i ++) {
+        if(!std::memcmp(data + i, p, length)) {
+            if(found(i)) return;
+        }
+    }
+}
+
+std::vector<size_t> BytePattern::findAll(const char *data, size_t size,
+    size_t stride) const {
+
+    std::vector<size_t> offsetList;
+    scan(data, size, [&] (size_t offset) {
+        if(offset % stride == 0) offsetList.push_back(offset);
+        return false;
+    });
+    return offsetList;
+}
+
+bool BytePattern::occursIn(const char *data, size_t size) const {
+    bool result = false;
+    scan(data, size, [&] (size_t offset) { return result = true; });
+    return result;
+}
+
+const BytePattern &BytePattern::getEndbr64() {
+    static const BytePattern endbr64("\xf3\x0f\x1e\xfa", 4);
+    return endbr64;
+}
+
+const BytePattern &BytePattern::getSyscall() {
+    static const BytePattern syscall("\x0f\x05", 2);
+    return syscall;
+}
@@ -0,0 +1,45 @@
+#ifndef EGALITO_UTIL_BYTESCAN_H
+#define EGALITO_UTIL_BYTESCAN_H
+
+#include <string>
+#include <vector>
+#include <cstddef>  // for size_t
+
+/** Finds a fixed byte sequence (an endbr64, a syscall, a PLT jmp) in raw
+    code without decoding it.
+
+    Candidates are found 16 bytes at a time by comparing the first and last
+    byte of the pattern in vector registers (SSE2 on x86_64, NEON on
+    aarch64), and only those positions are compared in full. Other targets
+    use a plain byte loop. An occurrence says nothing about instruction
+    boundaries; callers still have to check that a candidate is where an
+    instruction starts.
+*/
+class BytePattern {
+private:
+    std::string pattern;
+public:
+    BytePattern(const char *bytes, size_t length) : pattern(bytes, length) {}
+
+    /** Offsets of all occurrences in data[0, size) that are multiples of
+        stride, in increasing order. Occurrences may overlap.
+    */
+    std::vector<size_t> findAll(const char *data, size_t size,
+        size_t stride = 1) const;
+
+    /** True if the pattern occurs anywhere in data[0, size). */
+    bool occursIn(const char *data, size_t size) const;
+
+    /** True if data is exactly the pattern, e.g. one whole instruction. */
+    bool isExactly(const std::string &data) const { return data == pattern; }
+
+    size_t getLength() const { return pattern.length(); }
+
+    static const BytePattern &getEndbr64();
+    static const BytePattern &getSyscall();
+private:
+    template <typename FoundType>
+    void scan(const char *data, size_t size, FoundType found) const;
+};
+
+#endif
@@ -0,0 +1,133 @@
+#include <cstring>  // for std::memcpy
+#include <cstdint>
+#include <vector>
+#include "compress.h"
+
+#define MIN_MATCH       4
+#define HASH_BITS       12
+#define MAX_OFFSET      0xffff
+
+static uint32_t read32(const char *p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint32_t hashSequence(uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+static void writeLength(std::string &out, size_t length) {
+    while(length >= 255) {
+        out.push_back(static_cast<char>(255));
+        length -= 255;
+    }
+    out.push_back(static_cast<char>(length));
+}
+
+static void writeSequence(std::string &out, const char *literals,
+    size_t literalLength, size_t offset, size_t matchLength) {
+
+    size_t matchCode = matchLength ? matchLength - MIN_MATCH : 0;
+    unsigned char token = (literalLength < 15 ? literalLength : 15) << 4
+        | (matchCode < 15 ? matchCode : 15);
+    out.push_back(static_cast<char>(token));
+    if(literalLength >= 15) writeLength(out, literalLength - 15);
+    out.append(literals, literalLength);
+
+    if(matchLength) {
+        out.push_back(static_cast<char>(offset & 0xff));
+        out.push_back(static_cast<char>(offset >> 8));
+        if(matchCode >= 15) writeLength(out, matchCode - 15);
+    }
+}
+
+std::string BlockCompressor::compress(const char *data, size_t size) {
+    std::string out;
+    out.reserve(size / 2 + 16);
+
+    const size_t none = static_cast<size_t>(-1);
+    std::vector<size_t> table(1 << HASH_BITS, none);
+
+    size_t anchor = 0;
+    size_t i = 0;
+    while(i + MIN_MATCH <= size) {
+        uint32_t sequence = read32(data + i);
+        auto &slot = table[hashSequence(sequence)];
+        size_t candidate = slot;
+        slot = i;
+
+        if(candidate != none && i - candidate <= MAX_OFFSET
+            && read32(data + candidate) == sequence) {
+
+            size_t length = MIN_MATCH;
+            while(i + length < size
+                && data[candidate + length] == data[i + length]) {
+
+                length ++;
+            }
+            writeSequence(out, data + anchor, i - anchor, i - candidate,
+                length);
+            i += length;
+            anchor = i;
+        }
+        else i ++;
+    }
+    writeSequence(out, data + anchor, size - anchor, 0, 0);
+
+    return out;
+}
+
+static bool readLength(const unsigned char *&in, const unsigned char *end,
+    size_t &length) {
+
+    for(;;) {
+        if(in >= end) return false;
+        unsigned char byte = *in++;
+        length += byte;
+        if(byte != 255) return true;
+    }
+}
+
+bool BlockCompressor::decompress(const char *data, size_t size,
+    char *out, size_t outSize) {
+
+    auto in = reinterpret_cast<const unsigned char *>(data);
+    auto inEnd = in + size;
+    size_t position = 0;
+
+    while(in < inEnd) {
+        unsigned char token = *in++;
+
+        size_t literalLength = token >> 4;
+        if(literalLength == 15 && !readLength(in, inEnd, literalLength)) {
+            return false;
+        }
+        if(size_t(inEnd - in) < literalLength
+            || outSize - position < literalLength) return false;
+        std::memcpy(out + position, in, literalLength);
+        in += literalLength;
+        position += literalLength;
+
+        if(in == inEnd) break;  // final sequence has no match
+
+        if(inEnd - in < 2) return false;
+        size_t offset = in[0] | (in[1] << 8);
+        in += 2;
+        size_t matchLength = token & 0xf;
+        if(matchLength == 15 && !readLength(in, inEnd, matchLength)) {
+            return false;
+        }
+        matchLength += MIN_MATCH;
+
+        if(offset == 0 || offset > position
+            || outSize - position < matchLength) return false;
+        // byte by byte, since the match may overlap its own output
+        for(size_t i = 0; i < matchLength; i ++) {
+            out[position + i] = out[position - offset + i];
+        }
+        position += matchLength;
+    }
+
+    return position == outSize;
+}
@@ -0,0 +1,27 @@
+#ifndef EGALITO_UTIL_COMPRESS_H
+#define EGALITO_UTIL_COMPRESS_H
+
+#include <string>
+#include <cstddef>  // for size_t
+
+/** Small LZ77 block compressor in the style of LZ4, so that archives can
+    be compressed without linking an external library into the loader.
+
+    Each sequence is a token byte (literal length in the high nibble and
+    match length - 4 in the low nibble, with 15 meaning more length bytes
+    follow), the literals, then a 16-bit little-endian match offset. The
+    final sequence has no match.
+*/
+class BlockCompressor {
+public:
+    /** Returns the compressed form of data[0, size). */
+    static std::string compress(const char *data, size_t size);
+
+    /** Decompresses exactly outSize bytes into out. Returns false if the
+        input is malformed or does not decode to outSize bytes.
+    */
+    static bool decompress(const char *data, size_t size,
+        char *out, size_t outSize);
+};
+
+#endif
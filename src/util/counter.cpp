@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <cstdlib>  // for getenv
+#include "counter.h"
+#include "chunk/function.h"
+
+static thread_local CounterRegistry::FunctionRecord *currentRecord = nullptr;
+
+CounterRegistry *CounterRegistry::getInstance() {
+    static CounterRegistry instance;
+    return &instance;
+}
+
+CounterRegistry::CounterRegistry() : allGroups(false), topCount(10) {
+    if(const char *groups = getenv("EGALITO_COUNTERS")) {
+        std::istringstream stream(groups);
+        std::string group;
+        while(std::getline(stream, group, ',')) {
+            if(!group.empty()) enableGroup(group);
+        }
+    }
+    if(const char *top = getenv("EGALITO_COUNTERS_TOP")) {
+        topCount = std::strtoul(top, nullptr, 0);
+    }
+    if(const char *file = getenv("EGALITO_COUNTERS_FILE")) {
+        outputFile = file;
+    }
+}
+
+CounterRegistry::~CounterRegistry() {
+    if(isEnabled() && !counterList.empty()) {
+        if(outputFile.empty()) dump(std::cerr);
+        else {
+            std::ofstream file(outputFile.c_str());
+            dump(file);
+        }
+    }
+    for(auto counter : counterList) delete counter;
+}
+
+void CounterRegistry::enableGroup(const std::string &group) {
+    if(group == "all") allGroups = true;
+    else enabledGroups.push_back(group);
+}
+
+CounterRegistry::Counter *CounterRegistry::add(const char *group,
+    const char *name) {
+
+    if(!allGroups && std::find(enabledGroups.begin(), enabledGroups.end(),
+        group) == enabledGroups.end()) {
+
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    // templates in headers can define the same counter more than once
+    for(auto counter : counterList) {
+        if(counter->group == group && counter->name == name) return counter;
+    }
+    auto counter = new Counter(group, name, counterList.size());
+    counterList.push_back(counter);
+    return counter;
+}
+
+void CounterRegistry::bump(Counter *counter, unsigned long count) {
+    counter->total.fetch_add(count, std::memory_order_relaxed);
+    if(auto record = currentRecord) {
+        if(record->counts.size() <= counter->index) {
+            record->counts.resize(counter->index + 1);
+        }
+        record->counts[counter->index] += count;
+    }
+}
+
+void CounterRegistry::addFunction(const std::string &name,
+    const FunctionRecord &record) {
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto &total = functionMap[name];
+    total.wallUS += record.wallUS;
+    total.scopes += record.scopes;
+    if(total.counts.size() < record.counts.size()) {
+        total.counts.resize(record.counts.size());
+    }
+    for(size_t i = 0; i < record.counts.size(); i ++) {
+        total.counts[i] += record.counts[i];
+    }
+}
+
+void CounterRegistry::dump(std::ostream &stream) {
+    std::lock_guard<std::mutex> lock(mutex);
+    stream << "=== analysis counters ===\n";
+    for(auto counter : counterList) {
+        stream << std::setw(14) << counter->total.load() << "  "
+            << counter->group << ": " << counter->name << "\n";
+    }
+
+    std::vector<std::pair<std::string, const FunctionRecord *>> sorted;
+    for(const auto &kv : functionMap) {
+        sorted.push_back(std::make_pair(kv.first, &kv.second));
+    }
+    std::sort(sorted.begin(), sorted.end(),
+        [] (const std::pair<std::string, const FunctionRecord *> &a,
+            const std::pair<std::string, const FunctionRecord *> &b) {
+            return a.second->wallUS > b.second->wallUS;
+        });
+    if(sorted.size() > topCount) sorted.resize(topCount);
+
+    stream << "=== " << sorted.size() << " slowest functions ===\n";
+    for(const auto &entry : sorted) {
+        const auto &record = *entry.second;
+        stream << std::fixed << std::setprecision(3)
+            << std::setw(10) << record.wallUS / 1000.0 << " ms  "
+            << entry.first << " (" << record.scopes << " scopes)\n";
+        for(size_t i = 0; i < record.counts.size(); i ++) {
+            if(!record.counts[i]) continue;
+            stream << std::setw(26) << record.counts[i] << "  "
+                << counterList[i]->group << ": "
+                << counterList[i]->name << "\n";
+        }
+    }
+    stream.unsetf(std::ios::floatfield);
+}
+
+CounterScope::CounterScope(Function *function) : function(nullptr) {
+    if(currentRecord || !CounterRegistry::getInstance()->isEnabled()) return;
+
+    this->function = function;
+    currentRecord = new CounterRegistry::FunctionRecord();
+    start = std::chrono::steady_clock::now();
+}
+
+CounterScope::~CounterScope() {
+    if(!function) return;
+
+    auto record = currentRecord;
+    currentRecord = nullptr;
+    record->wallUS = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    record->scopes = 1;
+    CounterRegistry::getInstance()->addFunction(function->getName(), *record);
+    delete record;
+}
+
+CounterRegistry::FunctionRecord *CounterScope::getCurrent() {
+    return currentRecord;
+}
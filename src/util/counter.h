@@ -0,0 +1,117 @@
+#ifndef EGALITO_UTIL_COUNTER_H
+#define EGALITO_UTIL_COUNTER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <iosfwd>
+
+class Function;
+
+/** Named event counters for the inner loops of analyses, e.g. how many
+    UDStates use-def visited or how many tree patterns were tried, so that
+    a pathological function can be told apart from a slow pass.
+
+    Counters are only compiled in when EGALITO_COUNTERS is defined (build
+    with COUNTERS=1). Like log messages, each counter belongs to the
+    DEBUG_GROUP of the file that bumps it; at runtime, EGALITO_COUNTERS
+    lists the groups to count ("all", or e.g. "analysis,djumptable").
+    Counts are attributed to the Function of the enclosing CounterScope.
+    At exit, totals and the EGALITO_COUNTERS_TOP (default 10) slowest
+    functions are written to EGALITO_COUNTERS_FILE, or to stderr.
+*/
+class CounterRegistry {
+public:
+    struct FunctionRecord {
+        unsigned long wallUS;
+        unsigned long scopes;
+        std::vector<unsigned long> counts;  // by counter index
+        FunctionRecord() : wallUS(0), scopes(0) {}
+    };
+    struct Counter {
+        std::string group;
+        std::string name;
+        size_t index;
+        std::atomic<unsigned long> total;
+        Counter(const std::string &group, const std::string &name,
+            size_t index) : group(group), name(name), index(index), total(0) {}
+    };
+private:
+    std::mutex mutex;
+    std::vector<Counter *> counterList;
+    std::map<std::string, FunctionRecord> functionMap;
+    std::vector<std::string> enabledGroups;  // empty means none
+    bool allGroups;
+    size_t topCount;
+    std::string outputFile;
+public:
+    static CounterRegistry *getInstance();
+
+    CounterRegistry();
+    ~CounterRegistry();
+
+    bool isEnabled() const { return allGroups || !enabledGroups.empty(); }
+    void enableGroup(const std::string &group);
+    void setOutputFile(const std::string &file) { outputFile = file; }
+
+    /** Returns nullptr if the counter's group isn't counted. */
+    Counter *add(const char *group, const char *name);
+    void bump(Counter *counter, unsigned long count);
+    void addFunction(const std::string &name, const FunctionRecord &record);
+
+    void dump(std::ostream &stream);
+};
+
+/** One counter; defined by the COUNTER_ADD macro. */
+class CounterSetting {
+private:
+    CounterRegistry::Counter *counter;
+public:
+    CounterSetting(const char *group, const char *name)
+        : counter(CounterRegistry::getInstance()->add(group, name)) {}
+    void add(unsigned long count)
+        { if(counter) CounterRegistry::getInstance()->bump(counter, count); }
+};
+
+/** Attributes counts made by this thread to function, and times it.
+    Nested scopes are folded into the outermost one.
+*/
+class CounterScope {
+private:
+    Function *function;
+    std::chrono::steady_clock::time_point start;
+public:
+    CounterScope(Function *function);
+    ~CounterScope();
+
+    /** Counts for the current scope of this thread; nullptr if none. */
+    static CounterRegistry::FunctionRecord *getCurrent();
+};
+
+#define _COUNTER_STRINGIZE(x) # x
+#define _COUNTER_STRINGIZE2(x) _COUNTER_STRINGIZE(x)
+#ifdef DEBUG_GROUP
+    #define _COUNTER_GROUP _COUNTER_STRINGIZE2(DEBUG_GROUP)
+#else
+    #define _COUNTER_GROUP "default"
+#endif
+
+#ifdef EGALITO_COUNTERS
+    #define COUNTER_ADD(name, count) \
+        do { \
+            static CounterSetting _counter(_COUNTER_GROUP, name); \
+            _counter.add(count); \
+        } while(0)
+    #define COUNTER_SCOPE(function) \
+        CounterScope _counterScope(function)
+#else
+    #define COUNTER_ADD(name, count)    do {} while(0)
+    #define COUNTER_SCOPE(function)     do {} while(0)
+#endif
+
+#define COUNTER_INC(name) COUNTER_ADD(name, 1)
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef EGALITO_UTIL_CPUSIG_H
+#define EGALITO_UTIL_CPUSIG_H
+
+/* Plain C, since dep/ifunc/determine.c records the same signature. */
+
+#include <stdint.h>
+#if defined(__x86_64__)
+    #include <cpuid.h>
+#elif defined(__aarch64__)
+    #include <sys/auxv.h>
+#endif
+
+/** A hash of the CPU features that glibc's ifunc resolvers select on.
+    Two machines with the same signature pick the same implementations;
+    0 means the features could not be read.
+*/
+static inline uint64_t egalito_cpu_signature(void) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+#define EGALITO_CPU_SIGNATURE_MIX(value) \
+    hash = (hash ^ (uint32_t)(value)) * 0x100000001b3ull
+
+#if defined(__x86_64__)
+    unsigned int eax, ebx, ecx, edx;
+    if(!__get_cpuid(0, &eax, &ebx, &ecx, &edx)) return 0;
+    unsigned int maxLeaf = eax;
+    EGALITO_CPU_SIGNATURE_MIX(ebx);     // vendor; AMD and Intel differ
+    EGALITO_CPU_SIGNATURE_MIX(edx);
+    EGALITO_CPU_SIGNATURE_MIX(ecx);
+
+    __get_cpuid(1, &eax, &ebx, &ecx, &edx);
+    EGALITO_CPU_SIGNATURE_MIX(eax);     // family and model, for tunings
+    EGALITO_CPU_SIGNATURE_MIX(ecx);
+    EGALITO_CPU_SIGNATURE_MIX(edx);
+    if(maxLeaf >= 7) {
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        EGALITO_CPU_SIGNATURE_MIX(ebx);
+        EGALITO_CPU_SIGNATURE_MIX(ecx);
+        EGALITO_CPU_SIGNATURE_MIX(edx);
+    }
+#elif defined(__aarch64__)
+    unsigned long hwcap = getauxval(AT_HWCAP);
+    EGALITO_CPU_SIGNATURE_MIX(hwcap);
+    EGALITO_CPU_SIGNATURE_MIX(hwcap >> 32);
+    EGALITO_CPU_SIGNATURE_MIX(getauxval(AT_HWCAP2));
+#else
+    return 0;
+#endif
+
+#undef EGALITO_CPU_SIGNATURE_MIX
+    return hash;
+}
+
+#endif
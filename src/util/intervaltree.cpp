@@ -1,213 +1,164 @@
 #include <cassert>
 #include <algorithm>
+#include <iterator>
 #include "intervaltree.h"
 #include "log/log.h"
 
-IntervalTreeNode::~IntervalTreeNode() {
-    delete lower;
-    delete higher;
-}
-
-bool IntervalTreeNode::add(Range range) {
-    if(!totalRange.contains(range)) return false;
-
-    /*LOG(1, "adding " << range << " to " << totalRange
-        << " with midpoint " << midpoint);*/
-
-    if(range < midpoint) {
-        if(!lower) {
-            lower = new IntervalTreeNode(
-                Range::fromEndpoints(totalRange.getStart(), midpoint));
-        }
-        return lower->add(range);
+int IntervalTree::makeNode(const Range &range) {
+    Node node = {range, range.getEnd(), range.getEnd(), -1, -1, 1};
+    if(!freeList.empty()) {
+        int n = freeList.back();
+        freeList.pop_back();
+        nodes[n] = node;
+        return n;
     }
-    else if(range.contains(midpoint)) {
-        overlapStart.push_back(range);
-        std::sort(overlapStart.begin(), overlapStart.end());
-        overlapEnd.push_back(range);
-        std::sort(overlapEnd.begin(), overlapEnd.end(),
-            [] (const Range &a, const Range &b) {
-                if(b.getEnd() < a.getEnd()) return true;
-                else if(b.getEnd() == a.getEnd()) {
-                    if(b.getStart() < a.getStart()) return true;
-                }
-                return false;
-            });
-    }
-    else {
-        if(!higher) {
-            higher = new IntervalTreeNode(
-                Range::fromEndpoints(midpoint, totalRange.getEnd()));
-        }
-        return higher->add(range);
-    }
-
-    return true;
+    nodes.push_back(node);
+    return static_cast<int>(nodes.size() - 1);
 }
 
-bool IntervalTreeNode::remove(Range range) {
-    if(range < midpoint) {
-        if(lower) return lower->remove(range);
-    }
-    else if(midpoint < range) {
-        if(higher) return higher->remove(range);
-    }
-    else {
-        bool removed1 = false;
-        bool removed2 = false;
-
-        auto it1 = std::find(overlapStart.begin(), overlapStart.end(), range);
-        if(it1 != overlapStart.end()) {
-            overlapStart.erase(it1);
-            removed1 = true;
-        }
-
-        auto it2 = std::find(overlapEnd.begin(), overlapEnd.end(), range);
-        if(it2 != overlapEnd.end()) {
-            overlapEnd.erase(it2);
-            removed2 = true;
-        }
+void IntervalTree::freeNode(int n) {
+    freeList.push_back(n);
+}
 
-        assert((removed1 && removed2) || (!removed1 && !removed2));
-        return removed1 && removed2;
+void IntervalTree::update(int n) {
+    Node &node = nodes[n];
+    node.minEnd = node.maxEnd = node.range.getEnd();
+    node.height = 1;
+    for(int child : {node.left, node.right}) {
+        if(child < 0) continue;
+        node.minEnd = std::min(node.minEnd, nodes[child].minEnd);
+        node.maxEnd = std::max(node.maxEnd, nodes[child].maxEnd);
+        node.height = std::max(node.height, nodes[child].height + 1);
     }
+}
 
-    return false;
+int IntervalTree::rotateLeft(int n) {
+    int r = nodes[n].right;
+    nodes[n].right = nodes[r].left;
+    nodes[r].left = n;
+    update(n);
+    update(r);
+    return r;
 }
 
-void IntervalTreeNode::findOverlapping(address_t point,
-    std::vector<Range> &found) {
+int IntervalTree::rotateRight(int n) {
+    int l = nodes[n].left;
+    nodes[n].left = nodes[l].right;
+    nodes[l].right = n;
+    update(n);
+    update(l);
+    return l;
+}
 
-    if(point < midpoint) {
-        if(lower) lower->findOverlapping(point, found);
-        for(const auto &r : overlapStart) {
-            if(r.contains(point)) found.push_back(r);
-            if(point < r) break;
+int IntervalTree::rebalance(int n) {
+    update(n);
+    int balance = heightOf(nodes[n].left) - heightOf(nodes[n].right);
+    if(balance > 1) {
+        int l = nodes[n].left;
+        if(heightOf(nodes[l].left) < heightOf(nodes[l].right)) {
+            nodes[n].left = rotateLeft(l);
         }
+        return rotateRight(n);
     }
-    if(point >= midpoint) {
-        for(const auto &r : overlapEnd) {
-            if(r.contains(point)) found.push_back(r);
-            if(r < point) break;
+    if(balance < -1) {
+        int r = nodes[n].right;
+        if(heightOf(nodes[r].right) < heightOf(nodes[r].left)) {
+            nodes[n].right = rotateRight(r);
         }
-        if(higher) higher->findOverlapping(point, found);
+        return rotateLeft(n);
     }
+    return n;
 }
 
-void IntervalTreeNode::findOverlapping(Range range, std::vector<Range> &found) {
-    bool searchLower = true, searchHigher = true;
-
-    if(range < midpoint) searchHigher = false;
-    if(midpoint < range || midpoint == range.getStart()) searchLower = false;
-
-    if(searchLower && lower) {
-        lower->findOverlapping(range, found);
-    }
+int IntervalTree::insert(int n, const Range &range) {
+    if(n < 0) return makeNode(range);
 
-    // !!! inefficient compared to the above
-    for(const auto &r : overlapStart) {
-        if(r.overlaps(range)) found.push_back(r);
+    // makeNode() may reallocate nodes, so never hold a reference across it
+    if(range < nodes[n].range) {
+        int child = insert(nodes[n].left, range);
+        nodes[n].left = child;
     }
-
-    if(searchHigher && higher) {
-        higher->findOverlapping(range, found);
+    else {
+        int child = insert(nodes[n].right, range);
+        nodes[n].right = child;
     }
+    return rebalance(n);
 }
 
-bool IntervalTreeNode::findLowerBound(address_t point, Range *bound) {
-    if(point >= midpoint) {
-        if(higher && higher->findLowerBound(point, bound)) return true;
-    }
-
-    for(RangeList::reverse_iterator it = overlapEnd.rbegin();
-        it != overlapEnd.rend(); it ++) {
-
-        Range r = *it;
-
-        if(r < point) {
-            *bound = r;
-            return true;
-        }
+int IntervalTree::eraseMin(int n, int *minNode) {
+    if(nodes[n].left < 0) {
+        *minNode = n;
+        return nodes[n].right;
     }
-
-    if(lower && lower->findLowerBound(point, bound)) return true;
-
-    return false;
+    nodes[n].left = eraseMin(nodes[n].left, minNode);
+    return rebalance(n);
 }
 
-bool IntervalTreeNode::findLowerBoundOrOverlapping(address_t point, Range *bound) {
-    if(point >= midpoint) {
-        if(higher && higher->findLowerBoundOrOverlapping(point, bound)) return true;
-    }
-
-    for(RangeList::reverse_iterator it = overlapEnd.rbegin();
-        it != overlapEnd.rend(); it ++) {
+int IntervalTree::erase(int n, const Range &range, bool *removed) {
+    if(n < 0) return n;
 
-        Range r = *it;
-
-        if(r < point || r.contains(point)) {
-            *bound = r;
-            return true;
-        }
+    if(range < nodes[n].range) {
+        nodes[n].left = erase(nodes[n].left, range, removed);
     }
-
-    if(lower && lower->findLowerBoundOrOverlapping(point, bound)) return true;
-
-    return false;
-}
-
-bool IntervalTreeNode::findUpperBound(address_t point, Range *bound) {
-    if(point < midpoint) {
-        if(lower && lower->findUpperBound(point, bound)) return true;
+    else if(nodes[n].range < range) {
+        nodes[n].right = erase(nodes[n].right, range, removed);
     }
-
-    for(const auto &r : overlapStart) {
-        if(point < r) {
-            *bound = r;
-            return true;
-        }
+    else {
+        *removed = true;
+        int left = nodes[n].left;
+        int right = nodes[n].right;
+        freeNode(n);
+        if(right < 0) return left;
+
+        int successor;
+        right = eraseMin(right, &successor);
+        nodes[successor].left = left;
+        nodes[successor].right = right;
+        return rebalance(successor);
     }
-
-    if(higher && higher->findUpperBound(point, bound)) return true;
-
-    return false;
+    return rebalance(n);
 }
 
-bool IntervalTreeNode::findUpperBoundOrOverlapping(
-    address_t point, Range *bound) {
-
-    if(point < midpoint) {
-        if(lower && lower->findUpperBoundOrOverlapping(point, bound)) return true;
-    }
+void IntervalTree::rebuild(const std::vector<Range> &sortedList) {
+    nodes.clear();
+    freeList.clear();
+    nodes.reserve(sortedList.size());
+    count = sortedList.size();
+    root = build(sortedList, 0, sortedList.size());
+}
 
-    for(const auto &r : overlapStart) {
-        if(point < r || r.contains(point)) {
-            *bound = r;
-            return true;
-        }
-    }
+int IntervalTree::build(const std::vector<Range> &sortedList,
+    size_t begin, size_t end) {
 
-    if(higher && higher->findUpperBoundOrOverlapping(point, bound)) return true;
+    if(begin == end) return -1;
 
-    return false;
+    size_t middle = begin + (end - begin) / 2;
+    int n = makeNode(sortedList[middle]);
+    int left = build(sortedList, begin, middle);
+    int right = build(sortedList, middle + 1, end);
+    nodes[n].left = left;
+    nodes[n].right = right;
+    update(n);
+    return n;
 }
 
-void IntervalTreeNode::inStartOrderTraversal(std::function<void (Range)> callback) {
-    if(lower) lower->inStartOrderTraversal(callback);
-
-    for(const auto &r : overlapStart) {
-        callback(r);
-    }
+bool IntervalTree::add(Range range) {
+    if(!totalRange.contains(range)) return false;
 
-    if(higher) higher->inStartOrderTraversal(callback);
+    root = insert(root, range);
+    count ++;
+    return true;
 }
 
-IntervalTree::~IntervalTree() {
-    delete tree;
+bool IntervalTree::remove(Range range) {
+    bool removed = false;
+    root = erase(root, range, &removed);
+    if(removed) count --;
+    return removed;
 }
 
 bool IntervalTree::splitAt(address_t point) {
-    if(!tree->getTotalRange().contains(point)) return false;
+    if(!totalRange.contains(point)) return false;
 
     std::vector<Range> found = findOverlapping(point);
 
@@ -225,34 +176,118 @@ bool IntervalTree::splitAt(address_t point) {
     return false;
 }
 
+void IntervalTree::collectOverlapping(int n, address_t point,
+    std::vector<Range> &found) const {
+
+    if(n < 0 || nodes[n].maxEnd <= point) return;
+
+    const Node &node = nodes[n];
+    collectOverlapping(node.left, point, found);
+    if(node.range.getStart() > point) return;
+    if(node.range.contains(point)) found.push_back(node.range);
+    collectOverlapping(node.right, point, found);
+}
+
+void IntervalTree::collectOverlapping(int n, const Range &range,
+    std::vector<Range> &found) const {
+
+    if(n < 0 || nodes[n].maxEnd <= range.getStart()) return;
+
+    const Node &node = nodes[n];
+    collectOverlapping(node.left, range, found);
+    if(node.range.getStart() >= range.getEnd()) return;
+    if(node.range.overlaps(range)) found.push_back(node.range);
+    collectOverlapping(node.right, range, found);
+}
+
 std::vector<Range> IntervalTree::findOverlapping(address_t point) {
     std::vector<Range> found;
-    tree->findOverlapping(point, found);
+    collectOverlapping(root, point, found);
     return std::move(found);
 }
 
 std::vector<Range> IntervalTree::findOverlapping(Range range) {
     std::vector<Range> found;
-    tree->findOverlapping(range, found);
+    collectOverlapping(root, range, found);
     return std::move(found);
 }
 
 bool IntervalTree::findLowerBound(address_t point, Range *lowerBound) {
-    return tree->findLowerBound(point, lowerBound);
+    // last range (in start order) that ends at or before point
+    int n = root;
+    while(n >= 0 && nodes[n].minEnd <= point) {
+        const Node &node = nodes[n];
+        if(node.right >= 0 && nodes[node.right].minEnd <= point) {
+            n = node.right;
+        }
+        else if(node.range.getEnd() <= point) {
+            *lowerBound = node.range;
+            return true;
+        }
+        else {
+            n = node.left;
+        }
+    }
+
+    return false;
 }
 
 bool IntervalTree::findLowerBoundOrOverlapping(address_t point,
     Range *lowerBound) {
 
-    return tree->findLowerBoundOrOverlapping(point, lowerBound);
+    // last range (in start order) that starts at or before point
+    bool found = false;
+    for(int n = root; n >= 0; ) {
+        if(nodes[n].range.getStart() <= point) {
+            *lowerBound = nodes[n].range;
+            found = true;
+            n = nodes[n].right;
+        }
+        else {
+            n = nodes[n].left;
+        }
+    }
+
+    return found;
 }
 
 bool IntervalTree::findUpperBound(address_t point, Range *upperBound) {
-    return tree->findUpperBound(point, upperBound);
+    // first range that starts after point
+    bool found = false;
+    for(int n = root; n >= 0; ) {
+        if(point < nodes[n].range.getStart()) {
+            *upperBound = nodes[n].range;
+            found = true;
+            n = nodes[n].left;
+        }
+        else {
+            n = nodes[n].right;
+        }
+    }
+
+    return found;
 }
 
-bool IntervalTree::findUpperBoundOrOverlapping(address_t point, Range *upperBound) {
-    return tree->findUpperBoundOrOverlapping(point, upperBound);
+bool IntervalTree::findUpperBoundOrOverlapping(address_t point,
+    Range *upperBound) {
+
+    // first range (in start order) that ends after point
+    int n = root;
+    while(n >= 0 && nodes[n].maxEnd > point) {
+        const Node &node = nodes[n];
+        if(node.left >= 0 && nodes[node.left].maxEnd > point) {
+            n = node.left;
+        }
+        else if(node.range.getEnd() > point) {
+            *upperBound = node.range;
+            return true;
+        }
+        else {
+            n = node.right;
+        }
+    }
+
+    return false;
 }
 
 void IntervalTree::subtract(Range range) {
@@ -284,35 +319,112 @@ void IntervalTree::subtractWithAddendum(Range range, Range addendum) {
 }
 
 IntervalTree IntervalTree::complement() {
-    Range bounds = tree->getTotalRange();
-    IntervalTree newTree(bounds);
-    address_t lastPoint = bounds.getStart();
+    IntervalTree newTree(totalRange);
+    std::vector<Range> gapList;
+    address_t lastPoint = totalRange.getStart();
 
-    tree->inStartOrderTraversal([&] (Range r) {
+    inStartOrderTraversal([&] (Range r) {
         address_t end = r.getStart();
         if(end > lastPoint) {
-            newTree.add(Range::fromEndpoints(lastPoint, end));
+            gapList.push_back(Range::fromEndpoints(lastPoint, end));
         }
 
         lastPoint = std::max(lastPoint, r.getEnd());
     });
 
-    if(lastPoint < bounds.getEnd()) {
-        newTree.add(Range::fromEndpoints(lastPoint, bounds.getEnd()));
+    if(lastPoint < totalRange.getEnd()) {
+        gapList.push_back(Range::fromEndpoints(lastPoint, totalRange.getEnd()));
     }
 
+    newTree.rebuild(gapList);
     return std::move(newTree);
 }
 
 void IntervalTree::unionWith(IntervalTree &otherTree) {
-    otherTree.getRoot()->inStartOrderTraversal([&] (Range range) {
-        add(range);
+    addAll(otherTree.getAllData());
+}
+
+size_t IntervalTree::addAll(std::vector<Range> rangeList) {
+    rangeList.erase(std::remove_if(rangeList.begin(), rangeList.end(),
+        [this] (const Range &r) { return !totalRange.contains(r); }),
+        rangeList.end());
+    std::stable_sort(rangeList.begin(), rangeList.end());
+
+    std::vector<Range> existing = getAllData();
+    std::vector<Range> merged;
+    merged.reserve(existing.size() + rangeList.size());
+    std::merge(existing.begin(), existing.end(),
+        rangeList.begin(), rangeList.end(), std::back_inserter(merged));
+    rebuild(merged);
+
+    return rangeList.size();
+}
+
+void IntervalTree::splitAtAll(std::vector<address_t> pointList) {
+    std::sort(pointList.begin(), pointList.end());
+    pointList.erase(std::unique(pointList.begin(), pointList.end()),
+        pointList.end());
+
+    // Splitting one range never changes how many ranges contain some other
+    // point, so each point can be checked against the unsplit tree.
+    std::vector<std::pair<Range, address_t>> splitList;
+    for(address_t point : pointList) {
+        if(!totalRange.contains(point)) continue;
+
+        std::vector<Range> found = findOverlapping(point);
+        if(found.size() == 1 && point != found[0].getStart()) {
+            splitList.push_back(std::make_pair(found[0], point));
+        }
+    }
+    if(splitList.empty()) return;
+
+    std::stable_sort(splitList.begin(), splitList.end(),
+        [] (const std::pair<Range, address_t> &a,
+            const std::pair<Range, address_t> &b) {
+            return a.first < b.first;
+        });
+
+    std::vector<Range> result;
+    result.reserve(count + splitList.size());
+    auto split = splitList.begin();
+    inStartOrderTraversal([&] (Range r) {
+        if(split == splitList.end() || split->first != r) {
+            result.push_back(r);
+            return;
+        }
+
+        address_t start = r.getStart();
+        for( ; split != splitList.end() && split->first == r; ++split) {
+            result.push_back(Range::fromEndpoints(start, split->second));
+            start = split->second;
+        }
+        result.push_back(Range::fromEndpoints(start, r.getEnd()));
     });
+
+    // pieces of one range sort before the next range that starts later
+    std::sort(result.begin(), result.end());
+    rebuild(result);
+}
+
+void IntervalTree::traverse(int n,
+    const std::function<void (Range)> &callback) const {
+
+    if(n < 0) return;
+    traverse(nodes[n].left, callback);
+    callback(nodes[n].range);
+    traverse(nodes[n].right, callback);
+}
+
+void IntervalTree::inStartOrderTraversal(
+    std::function<void (Range)> callback) const {
+
+    traverse(root, callback);
 }
 
 std::vector<Range> IntervalTree::getAllData() const {
     std::vector<Range> output;
-    tree->inStartOrderTraversal([&] (const Range &r) {
+    output.reserve(count);
+    inStartOrderTraversal([&] (const Range &r) {
         output.push_back(r);
     });
     return std::move(output);
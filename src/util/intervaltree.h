@@ -5,55 +5,41 @@
 #include <functional>
 #include "range.h"
 
-class IntervalTreeNode {
-private:
-    typedef std::vector<Range> RangeList;
+/** Set of (possibly overlapping, possibly duplicate) ranges inside a fixed
+    total range. Stored as an AVL tree ordered by Range::operator <, where
+    each node is augmented with the min and max end of its subtree. Nodes
+    live in one vector and link by index, so traversals stay within a
+    contiguous allocation and bulk loads lay nodes out in pre-order.
+
+    add/remove/splitAt are O(log n). The batch operations (addAll,
+    splitAtAll, unionWith, complement) work on the sorted range list and
+    rebuild the tree in O(n) rather than doing n separate updates.
+*/
+class IntervalTree {
 private:
+    struct Node {
+        Range range;
+        address_t minEnd, maxEnd;
+        int left, right;
+        int height;
+    };
     Range totalRange;
-    address_t midpoint;
-    IntervalTreeNode *lower, *higher;
-    RangeList overlapStart, overlapEnd;
+    std::vector<Node> nodes;
+    std::vector<int> freeList;
+    int root;
+    size_t count;
 private:
-    IntervalTreeNode(const IntervalTreeNode &other) {}
+    IntervalTree(const IntervalTree &other) {}
 public:
-    IntervalTreeNode(Range totalRange) : totalRange(totalRange),
-        midpoint(totalRange.getStart() + (totalRange.getSize()/2)),
-        lower(nullptr), higher(nullptr) {}
-    IntervalTreeNode(IntervalTreeNode &&other) : totalRange(other.totalRange),
-        midpoint(other.midpoint), lower(other.lower), higher(other.higher),
-        overlapStart(std::move(other.overlapStart)),
-        overlapEnd(std::move(other.overlapEnd))
-        { other.lower = nullptr, other.higher = nullptr; }
-    ~IntervalTreeNode();
+    IntervalTree(Range totalRange) : totalRange(totalRange), root(-1),
+        count(0) {}
+    IntervalTree(IntervalTree &&other) = default;
 
     Range getTotalRange() const { return totalRange; }
+    size_t getCount() const { return count; }
 
     bool add(Range range);
     bool remove(Range range);
-    void findOverlapping(address_t point, std::vector<Range> &found);
-    void findOverlapping(Range range, std::vector<Range> &found);
-    bool findLowerBound(address_t point, Range *bound);
-    bool findLowerBoundOrOverlapping(address_t point, Range *bound);
-    bool findUpperBound(address_t point, Range *bound);
-    bool findUpperBoundOrOverlapping(address_t point, Range *bound);
-    Range upperBound(address_t point);
-
-    void inStartOrderTraversal(std::function<void (Range)> callback);
-};
-
-class IntervalTree {
-private:
-    IntervalTreeNode *tree;
-private:
-    IntervalTree(const IntervalTree &other) {}
-public:
-    IntervalTree(Range totalRange) : tree(new IntervalTreeNode(totalRange)) {}
-    IntervalTree(IntervalTree &&other) : tree(other.tree)
-        { other.tree = nullptr; }
-    ~IntervalTree();
-
-    bool add(Range range) { return tree->add(range); }
-    bool remove(Range range) { return tree->remove(range); }
     bool splitAt(address_t point);
     std::vector<Range> findOverlapping(address_t point);
     std::vector<Range> findOverlapping(Range range);
@@ -66,10 +52,33 @@ public:
     IntervalTree complement();
     void unionWith(IntervalTree &otherTree);
 
-    IntervalTreeNode *getRoot() const { return tree; }
+    /** Adds every range that fits in the total range; returns how many. */
+    size_t addAll(std::vector<Range> rangeList);
+    /** Same result as calling splitAt() on each point, in any order. */
+    void splitAtAll(std::vector<address_t> pointList);
+
+    void inStartOrderTraversal(std::function<void (Range)> callback) const;
     std::vector<Range> getAllData() const;
 
     void dump() const;
+private:
+    int makeNode(const Range &range);
+    void freeNode(int n);
+    int heightOf(int n) const { return n < 0 ? 0 : nodes[n].height; }
+    void update(int n);
+    int rotateLeft(int n);
+    int rotateRight(int n);
+    int rebalance(int n);
+    int insert(int n, const Range &range);
+    int erase(int n, const Range &range, bool *removed);
+    int eraseMin(int n, int *minNode);
+    void rebuild(const std::vector<Range> &sortedList);
+    int build(const std::vector<Range> &sortedList, size_t begin, size_t end);
+    void collectOverlapping(int n, address_t point,
+        std::vector<Range> &found) const;
+    void collectOverlapping(int n, const Range &range,
+        std::vector<Range> &found) const;
+    void traverse(int n, const std::function<void (Range)> &callback) const;
 };
 
 #endif
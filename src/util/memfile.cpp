@@ -0,0 +1,45 @@
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "memfile.h"
+#include "log/log.h"
+
+MemoryFile::MemoryFile(const char *name) {
+    // close-on-exec: fexecve() has opened the file by the time it closes
+    fd = memfd_create(name, MFD_CLOEXEC);
+    if(fd < 0) {
+        LOG(0, "can't create memory file: " << std::strerror(errno));
+    }
+}
+
+MemoryFile::~MemoryFile() {
+    if(fd >= 0) close(fd);
+}
+
+std::string MemoryFile::getPath() const {
+    return "/proc/self/fd/" + std::to_string(fd);
+}
+
+bool MemoryFile::write(const std::string &data) {
+    if(fd < 0) return false;
+    if(ftruncate(fd, 0) < 0 || lseek(fd, 0, SEEK_SET) < 0) return false;
+
+    for(size_t done = 0; done < data.length(); ) {
+        auto size = ::write(fd, data.data() + done, data.length() - done);
+        if(size < 0) {
+            if(errno == EINTR) continue;
+            LOG(0, "can't write memory file: " << std::strerror(errno));
+            return false;
+        }
+        done += size;
+    }
+    return fchmod(fd, 0755) == 0;
+}
+
+void MemoryFile::exec(char *const argv[], char *const envp[]) {
+    if(fd < 0) return;
+    fexecve(fd, argv, envp);
+    LOG(0, "can't execute memory file: " << std::strerror(errno));
+}
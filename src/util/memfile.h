@@ -0,0 +1,29 @@
+#ifndef EGALITO_UTIL_MEM_FILE_H
+#define EGALITO_UTIL_MEM_FILE_H
+
+#include <string>
+
+/** An anonymous file in memory (memfd), so that a generated ELF can be
+    executed without going through the filesystem.
+*/
+class MemoryFile {
+private:
+    int fd;
+public:
+    /** The name only shows up in /proc/self/fd. */
+    MemoryFile(const char *name = "egalito-output");
+    ~MemoryFile();
+
+    bool isOpen() const { return fd >= 0; }
+    int getFD() const { return fd; }
+    /** A path that opens this file, while this object exists. */
+    std::string getPath() const;
+
+    /** Replaces the contents with data, and makes the file executable. */
+    bool write(const std::string &data);
+
+    /** Executes the file with fexecve(); returns only on failure. */
+    void exec(char *const argv[], char *const envp[]);
+};
+
+#endif
@@ -0,0 +1,180 @@
+#include <fstream>
+#include <map>
+#include <cstdlib>  // for getenv
+#include <ctime>
+#include <sys/resource.h>
+#include "passprofile.h"
+#include "slab.h"
+#include "chunk/concrete.h"
+
+#undef DEBUG_GROUP
+#define DEBUG_GROUP dtiming
+#include "log/log.h"
+
+PassProfiler PassProfiler::instance;
+
+static unsigned long getProcessCPUTime() {
+    struct timespec ts;
+    if(clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts) != 0) return 0;
+    return ts.tv_sec * 1000000ul + ts.tv_nsec / 1000;
+}
+
+static long getPeakRSS() {
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return usage.ru_maxrss;
+}
+
+static size_t countFunctions(Chunk *chunk) {
+    if(dynamic_cast<Function *>(chunk)) return 1;
+    if(dynamic_cast<Block *>(chunk) || !chunk->getChildren()) return 0;
+
+    size_t count = 0;
+    for(auto child : chunk->getChildren()->genericIterable()) {
+        count += countFunctions(child);
+    }
+    return count;
+}
+
+static void writeString(std::ostream &stream, const std::string &str) {
+    stream << '"';
+    for(char c : str) {
+        if(c == '"' || c == '\\') stream << '\\' << c;
+        else if(c >= 0 && c < 0x20) stream << ' ';
+        else stream << c;
+    }
+    stream << '"';
+}
+
+PassProfiler::PassProfiler() : origin(std::chrono::steady_clock::now()) {
+    if(const char *file = getenv("EGALITO_PASS_PROFILE")) profileFile = file;
+    if(const char *file = getenv("EGALITO_PASS_TRACE")) traceFile = file;
+}
+
+PassProfiler::~PassProfiler() {
+    if(!profileFile.empty()) {
+        std::ofstream file(profileFile.c_str());
+        writeJSON(file);
+    }
+    if(!traceFile.empty()) {
+        std::ofstream file(traceFile.c_str());
+        writeChromeTrace(file);
+    }
+}
+
+unsigned long PassProfiler::getElapsedUS() const {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - origin).count();
+}
+
+void PassProfiler::add(const Record &record) {
+    std::lock_guard<std::mutex> lock(recordMutex);
+    recordList.push_back(record);
+}
+
+void PassProfiler::writeJSON(std::ostream &stream) {
+    struct Total {
+        unsigned long count, wallUS, cpuUS, allocations;
+        long rssDeltaKB;
+        size_t functions;
+        Total() : count(0), wallUS(0), cpuUS(0), allocations(0),
+            rssDeltaKB(0), functions(0) {}
+        void add(const Record &record) {
+            count ++;
+            wallUS += record.wallUS;
+            cpuUS += record.cpuUS;
+            allocations += record.allocations;
+            rssDeltaKB += record.rssDeltaKB;
+            functions += record.functions;
+        }
+    };
+
+    std::map<std::string, Total> byPass;
+    std::map<std::pair<std::string, std::string>, Total> byModule;
+    {
+        std::lock_guard<std::mutex> lock(recordMutex);
+        for(const auto &record : recordList) {
+            byPass[record.pass].add(record);
+            byModule[std::make_pair(record.pass, record.scope)].add(record);
+        }
+    }
+
+    auto writeTotal = [&stream] (const Total &total) {
+        stream << "\"count\": " << total.count
+            << ", \"wall_us\": " << total.wallUS
+            << ", \"cpu_us\": " << total.cpuUS
+            << ", \"rss_delta_kb\": " << total.rssDeltaKB
+            << ", \"allocations\": " << total.allocations
+            << ", \"functions\": " << total.functions;
+    };
+
+    stream << "{\n  \"passes\": [";
+    bool first = true;
+    for(const auto &kv : byPass) {
+        stream << (first ? "\n" : ",\n") << "    {\"pass\": ";
+        writeString(stream, kv.first);
+        stream << ", ";
+        writeTotal(kv.second);
+        stream << "}";
+        first = false;
+    }
+    stream << "\n  ],\n  \"modules\": [";
+    first = true;
+    for(const auto &kv : byModule) {
+        stream << (first ? "\n" : ",\n") << "    {\"pass\": ";
+        writeString(stream, kv.first.first);
+        stream << ", \"module\": ";
+        writeString(stream, kv.first.second);
+        stream << ", ";
+        writeTotal(kv.second);
+        stream << "}";
+        first = false;
+    }
+    stream << "\n  ]\n}\n";
+}
+
+void PassProfiler::writeChromeTrace(std::ostream &stream) {
+    std::lock_guard<std::mutex> lock(recordMutex);
+    stream << "{\"traceEvents\": [";
+    bool first = true;
+    for(const auto &record : recordList) {
+        stream << (first ? "\n" : ",\n") << "  {\"name\": ";
+        writeString(stream, record.pass);
+        stream << ", \"cat\": \"pass\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1"
+            << ", \"ts\": " << record.startUS
+            << ", \"dur\": " << record.wallUS
+            << ", \"args\": {\"module\": ";
+        writeString(stream, record.scope);
+        stream << ", \"cpu_us\": " << record.cpuUS
+            << ", \"rss_delta_kb\": " << record.rssDeltaKB
+            << ", \"allocations\": " << record.allocations
+            << ", \"functions\": " << record.functions << "}}";
+        first = false;
+    }
+    stream << "\n]}\n";
+}
+
+PassProfileScope::PassProfileScope(const char *pass, Chunk *chunk)
+    : enabled(PassProfiler::getInstance()->isEnabled()) {
+
+    if(!enabled) return;
+    record.pass = pass;
+    record.scope = chunk ? chunk->getName() : "";
+    record.functions = chunk ? countFunctions(chunk) : 0;
+    record.startUS = PassProfiler::getInstance()->getElapsedUS();
+    startCPU = getProcessCPUTime();
+    startRSS = getPeakRSS();
+    startAllocations = SlabAllocator::getAllocationCount();
+}
+
+PassProfileScope::~PassProfileScope() {
+    if(!enabled) return;
+    auto profiler = PassProfiler::getInstance();
+    record.wallUS = profiler->getElapsedUS() - record.startUS;
+    record.cpuUS = getProcessCPUTime() - startCPU;
+    record.rssDeltaKB = getPeakRSS() - startRSS;
+    record.allocations = SlabAllocator::getAllocationCount()
+        - startAllocations;
+    profiler->add(record);
+    LOG(10, "profiled " << record.pass << " on " << record.scope);
+}
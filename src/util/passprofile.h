@@ -0,0 +1,69 @@
+#ifndef EGALITO_UTIL_PASS_PROFILE_H
+#define EGALITO_UTIL_PASS_PROFILE_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <iosfwd>
+
+class Chunk;
+
+/** Collects resource usage for every RUN_PASS invocation.
+
+    Profiling is off unless EGALITO_PASS_PROFILE (aggregate JSON, per pass
+    and per pass/module) or EGALITO_PASS_TRACE (Chrome trace event format,
+    one event per invocation) names an output file. Files are written at
+    exit. CPU time covers all threads of the process; the allocation count
+    covers slab-allocated code tree objects made by the calling thread.
+*/
+class PassProfiler {
+public:
+    struct Record {
+        std::string pass;
+        std::string scope;          // name of the chunk the pass ran on
+        unsigned long startUS;      // since the profiler was created
+        unsigned long wallUS;
+        unsigned long cpuUS;
+        long rssDeltaKB;            // growth of peak RSS
+        unsigned long allocations;
+        size_t functions;           // Functions under the visited chunk
+    };
+private:
+    static PassProfiler instance;
+public:
+    static PassProfiler *getInstance() { return &instance; }
+private:
+    std::mutex recordMutex;
+    std::vector<Record> recordList;
+    std::chrono::steady_clock::time_point origin;
+    std::string profileFile, traceFile;
+public:
+    PassProfiler();
+    ~PassProfiler();
+
+    bool isEnabled() const
+        { return !profileFile.empty() || !traceFile.empty(); }
+    void setProfileFile(const std::string &file) { profileFile = file; }
+    void setTraceFile(const std::string &file) { traceFile = file; }
+    unsigned long getElapsedUS() const;
+
+    void add(const Record &record);
+    void writeJSON(std::ostream &stream);
+    void writeChromeTrace(std::ostream &stream);
+};
+
+/** Measures one pass invocation and reports it to PassProfiler. */
+class PassProfileScope {
+private:
+    PassProfiler::Record record;
+    bool enabled;
+    unsigned long startCPU;
+    long startRSS;
+    unsigned long startAllocations;
+public:
+    PassProfileScope(const char *pass, Chunk *chunk);
+    ~PassProfileScope();
+};
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef EGALITO_UTIL_PERFECT_HASH_H
+#define EGALITO_UTIL_PERFECT_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/** Gives each of a fixed set of N names its own slot, by searching for a
+    hash seed with no collisions when constructed. Declare it constexpr so
+    the search happens at compile time:
+
+        static constexpr const char *names[] = {"a", "b"};
+        static constexpr PerfectHash<2> hash(names);
+        static_assert(hash.isValid(), "no perfect hash seed");
+
+    indexOf() hashes its argument once and compares it only with the name
+    in that slot, so it also rejects strings outside the set.
+*/
+template <size_t N>
+class PerfectHash {
+public:
+    /** A power of two, at most half full. */
+    static constexpr size_t SLOTS = (N < 4 ? 8 : 1u << (64 - __builtin_clzll(
+        static_cast<unsigned long long>(2 * N - 1))));
+private:
+    static const uint32_t MAX_SEED = 0x10000;
+
+    const char *names[N];
+    int slot[SLOTS];  // index into names, or -1
+    uint32_t seed;
+    bool valid;
+public:
+    constexpr PerfectHash(const char *const (&list)[N])
+        : names{}, slot{}, seed(0), valid(false) {
+
+        for(size_t i = 0; i < N; i ++) names[i] = list[i];
+        for(seed = 0; seed < MAX_SEED && !valid; ) {
+            valid = place();
+            if(!valid) seed ++;
+        }
+    }
+
+    constexpr bool isValid() const { return valid; }
+    constexpr const char *getName(size_t index) const { return names[index]; }
+
+    /** The position of name in the original list, or -1. */
+    constexpr int indexOf(const char *name) const {
+        int index = slot[hash(name, seed) & (SLOTS - 1)];
+        return (index >= 0 && equals(names[index], name)) ? index : -1;
+    }
+    int indexOf(const std::string &name) const
+        { return indexOf(name.c_str()); }
+private:
+    constexpr bool place() {
+        for(size_t s = 0; s < SLOTS; s ++) slot[s] = -1;
+        for(size_t i = 0; i < N; i ++) {
+            auto &entry = slot[hash(names[i], seed) & (SLOTS - 1)];
+            if(entry >= 0) return false;
+            entry = static_cast<int>(i);
+        }
+        return true;
+    }
+
+    // FNV-1a
+    static constexpr uint32_t hash(const char *s, uint32_t seed) {
+        uint32_t h = 2166136261u ^ (seed * 0x9e3779b9u);
+        for(; *s; s ++) {
+            h ^= static_cast<unsigned char>(*s);
+            h *= 16777619u;
+        }
+        return h ^ (h >> 16);
+    }
+    static constexpr bool equals(const char *a, const char *b) {
+        for(; *a && *a == *b; a ++, b ++) {}
+        return *a == *b;
+    }
+};
+
+template <size_t N>
+constexpr size_t PerfectHash<N>::SLOTS;
+
+#endif
@@ -0,0 +1,66 @@
+#include <new>
+#include "slab.h"
+
+#define SLAB_GRANULE    16
+#define SLAB_CLASSES    16      // up to 256 bytes
+#define SLAB_SIZE       (64 * 1024)
+
+namespace {
+    struct FreeBlock {
+        FreeBlock *next;
+    };
+
+    // trivially constructible, so no thread-exit destructor is needed
+    struct SlabState {
+        FreeBlock *freeList[SLAB_CLASSES];
+        char *cursor;
+        char *end;
+        unsigned long allocations;
+    };
+
+    thread_local SlabState state;
+}
+
+static size_t sizeClassOf(size_t size) {
+    return (size + SLAB_GRANULE - 1) / SLAB_GRANULE - 1;
+}
+
+void *SlabAllocator::allocate(size_t size) {
+    if(size == 0) size = 1;
+    state.allocations ++;
+    size_t sizeClass = sizeClassOf(size);
+    if(sizeClass >= SLAB_CLASSES) return ::operator new(size);
+
+    if(auto block = state.freeList[sizeClass]) {
+        state.freeList[sizeClass] = block->next;
+        return block;
+    }
+
+    size_t rounded = (sizeClass + 1) * SLAB_GRANULE;
+    if(state.cursor + rounded > state.end) {
+        // the unused tail of the old slab is abandoned
+        state.cursor = static_cast<char *>(::operator new(SLAB_SIZE));
+        state.end = state.cursor + SLAB_SIZE;
+    }
+    void *result = state.cursor;
+    state.cursor += rounded;
+    return result;
+}
+
+void SlabAllocator::deallocate(void *pointer, size_t size) {
+    if(!pointer) return;
+    if(size == 0) size = 1;
+    size_t sizeClass = sizeClassOf(size);
+    if(sizeClass >= SLAB_CLASSES) {
+        ::operator delete(pointer);
+        return;
+    }
+
+    auto block = static_cast<FreeBlock *>(pointer);
+    block->next = state.freeList[sizeClass];
+    state.freeList[sizeClass] = block;
+}
+
+unsigned long SlabAllocator::getAllocationCount() {
+    return state.allocations;
+}
@@ -0,0 +1,38 @@
+#ifndef EGALITO_UTIL_SLAB_H
+#define EGALITO_UTIL_SLAB_H
+
+#include <cstddef>  // for size_t
+
+/** Size-class allocator for the many small objects that make up the code
+    tree (Instructions and their semantics, mainly).
+
+    Objects are carved out of large contiguous slabs instead of individual
+    heap blocks, so instructions created together end up next to each other
+    in memory and carry no per-allocation malloc header. Freed blocks go
+    onto a free list for reuse; slabs themselves are never returned.
+
+    All state is thread-local, so no locking is needed; a block freed on a
+    different thread than it was allocated on simply joins that thread's
+    free list. Requests too large for any size class go to operator new.
+*/
+class SlabAllocator {
+public:
+    static void *allocate(size_t size);
+    static void deallocate(void *pointer, size_t size);
+
+    /** Number of allocate() calls made so far by the calling thread. */
+    static unsigned long getAllocationCount();
+};
+
+/** Derive from this to place objects of a polymorphic hierarchy in slabs. The base must have a virtual
+    destructor so that the sized delete sees the dynamic type's size.
+*/
+class SlabAllocated {
+public:
+    static void *operator new(size_t size)
+        { return SlabAllocator::allocate(size); }
+    static void operator delete(void *pointer, size_t size)
+        { SlabAllocator::deallocate(pointer, size); }
+};
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef EGALITO_UTIL_SMALL_VECTOR_H
+#define EGALITO_UTIL_SMALL_VECTOR_H
+
+#include <cstddef>  // for size_t
+#include <cstring>  // for memcpy, memmove
+#include <type_traits>
+
+/** Vector that keeps up to InlineCount elements inside the object itself,
+    and only allocates once it grows past that. Most Blocks hold a handful
+    of Instructions, so their child lists never touch the heap.
+
+    Only trivially copyable values (i.e. Chunk pointers) are supported, so
+    elements are moved with memmove. Iterators are plain pointers and, as
+    with std::vector, are invalidated by any insertion or removal.
+*/
+template <typename T, size_t InlineCount>
+class SmallVector {
+    static_assert(std::is_trivially_copyable<T>::value,
+        "SmallVector only holds trivially copyable values");
+public:
+    typedef T value_type;
+    typedef T *iterator;
+    typedef const T *const_iterator;
+private:
+    T *array;
+    size_t count;
+    size_t capacity;
+    T inlineArray[InlineCount];
+public:
+    SmallVector() : array(inlineArray), count(0), capacity(InlineCount) {}
+    SmallVector(const SmallVector &other)
+        : array(inlineArray), count(0), capacity(InlineCount)
+        { *this = other; }
+    ~SmallVector() { if(!isInline()) delete[] array; }
+
+    SmallVector &operator = (const SmallVector &other);
+
+    iterator begin() { return array; }
+    iterator end() { return array + count; }
+    const_iterator begin() const { return array; }
+    const_iterator end() const { return array + count; }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    bool isInline() const { return array == inlineArray; }
+    T *data() { return array; }
+
+    T &operator [] (size_t index) { return array[index]; }
+    const T &operator [] (size_t index) const { return array[index]; }
+    T &back() { return array[count - 1]; }
+
+    void push_back(const T &value)
+        { if(count == capacity) grow(count + 1); array[count ++] = value; }
+    void pop_back() { count --; }
+    iterator insert(iterator position, const T &value);
+    iterator erase(iterator position);
+    void clear() { count = 0; }
+    void reserve(size_t n) { if(n > capacity) grow(n); }
+private:
+    void grow(size_t minimum);
+};
+
+template <typename T, size_t InlineCount>
+SmallVector<T, InlineCount> &SmallVector<T, InlineCount>::operator = (
+    const SmallVector &other) {
+
+    if(this == &other) return *this;
+    count = 0;
+    reserve(other.count);
+    std::memcpy(array, other.array, other.count * sizeof(T));
+    count = other.count;
+    return *this;
+}
+
+template <typename T, size_t InlineCount>
+typename SmallVector<T, InlineCount>::iterator
+    SmallVector<T, InlineCount>::insert(iterator position, const T &value) {
+
+    size_t index = position - array;
+    T copy = value;  // value may point into this vector
+    if(count == capacity) grow(count + 1);
+    std::memmove(array + index + 1, array + index,
+        (count - index) * sizeof(T));
+    array[index] = copy;
+    count ++;
+    return array + index;
+}
+
+template <typename T, size_t InlineCount>
+typename SmallVector<T, InlineCount>::iterator
+    SmallVector<T, InlineCount>::erase(iterator position) {
+
+    size_t index = position - array;
+    std::memmove(array + index, array + index + 1,
+        (count - index - 1) * sizeof(T));
+    count --;
+    return array + index;
+}
+
+template <typename T, size_t InlineCount>
+void SmallVector<T, InlineCount>::grow(size_t minimum) {
+    size_t newCapacity = capacity * 2;
+    if(newCapacity < minimum) newCapacity = minimum;
+
+    T *newArray = new T[newCapacity];
+    std::memcpy(newArray, array, count * sizeof(T));
+    if(!isInline()) delete[] array;
+    array = newArray;
+    capacity = newCapacity;
+}
+
+#endif
@@ -0,0 +1,107 @@
+#include <cstdlib>  // for getenv, strtoul
+#include "threadpool.h"
+
+// set while a thread runs work items, so nested pools stay serial
+static thread_local bool insidePoolWork = false;
+
+ThreadPool::ThreadPool(size_t threads) : work(nullptr), workCount(0),
+    nextIndex(0), busyWorkers(0), generation(0), stopping(false) {
+
+    for(size_t i = 1; i < threads; i ++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    workReady.notify_all();
+    for(auto &thread : workers) {
+        thread.join();
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, const WorkFunction &work) {
+    if(workers.empty() || count <= 1) {
+        for(size_t i = 0; i < count; i ++) work(i);
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        this->work = &work;
+        this->workCount = count;
+        this->nextIndex = 0;
+        this->busyWorkers = workers.size();
+        this->firstError = nullptr;
+        generation ++;
+    }
+    workReady.notify_all();
+
+    runItems();
+
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        workDone.wait(lock, [this] () { return busyWorkers == 0; });
+        this->work = nullptr;
+        error = firstError;
+        firstError = nullptr;
+    }
+    if(error) std::rethrow_exception(error);
+}
+
+size_t ThreadPool::getDefaultThreadCount() {
+    if(insidePoolWork) return 1;
+
+    const char *variable = getenv("EGALITO_THREADS");
+    if(!variable || !*variable) return 1;
+
+    size_t count = std::strtoul(variable, nullptr, 0);
+    if(count == 0) {
+        count = std::thread::hardware_concurrency();
+        if(count == 0) count = 1;
+    }
+    return count;
+}
+
+void ThreadPool::workerLoop() {
+    unsigned long seen = 0;
+    for(;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            workReady.wait(lock,
+                [this, seen] () { return stopping || generation != seen; });
+            if(stopping) return;
+            seen = generation;
+        }
+
+        runItems();
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            busyWorkers --;
+        }
+        workDone.notify_one();
+    }
+}
+
+void ThreadPool::runItems() {
+    bool wasInside = insidePoolWork;
+    insidePoolWork = true;
+    for(;;) {
+        size_t i = nextIndex.fetch_add(1);
+        if(i >= workCount) break;
+
+        try {
+            (*work)(i);
+        }
+        catch(...) {
+            std::unique_lock<std::mutex> lock(mutex);
+            if(!firstError) firstError = std::current_exception();
+        }
+    }
+    insidePoolWork = wasInside;
+}
@@ -0,0 +1,53 @@
+#ifndef EGALITO_UTIL_THREAD_POOL_H
+#define EGALITO_UTIL_THREAD_POOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+#include <functional>
+
+/** Fixed-size pool of worker threads for data-parallel loops.
+
+    The calling thread always participates in parallelFor(), so a pool of
+    size 1 has no worker threads and simply runs the loop serially. The
+    default size comes from the EGALITO_THREADS environment variable (0
+    means one thread per core); if it is unset, everything stays serial.
+    Pools created from inside a work item default to a single thread.
+
+    Any exception thrown by a work item is rethrown from parallelFor() once
+    all other items have finished.
+*/
+class ThreadPool {
+public:
+    typedef std::function<void (size_t)> WorkFunction;
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable workReady, workDone;
+    const WorkFunction *work;
+    size_t workCount;
+    std::atomic<size_t> nextIndex;
+    size_t busyWorkers;
+    unsigned long generation;
+    bool stopping;
+    std::exception_ptr firstError;
+public:
+    ThreadPool(size_t threads = getDefaultThreadCount());
+    ~ThreadPool();
+
+    size_t getThreadCount() const { return workers.size() + 1; }
+    bool isParallel() const { return !workers.empty(); }
+
+    /** Calls work(i) for every i in [0, count). Returns when all are done. */
+    void parallelFor(size_t count, const WorkFunction &work);
+
+    static size_t getDefaultThreadCount();
+private:
+    void workerLoop();
+    void runItems();
+};
+
+#endif
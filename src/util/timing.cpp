@@ -1,4 +1,8 @@
 #include <iomanip>
+#include <fstream>
+#include <cstdlib>  // for getenv
+#include <unistd.h>
+#include <sys/syscall.h>
 #include "timing.h"
 
 #undef DEBUG_GROUP
@@ -7,9 +11,125 @@
 
 #include "cminus/print.h"
 
+EgalitoTracer EgalitoTracer::instance;
+
+static thread_local unsigned traceDepth = 0;
+
+static void writeString(std::ostream &stream, const std::string &str) {
+    stream << '"';
+    for(char c : str) {
+        if(c == '"' || c == '\\') stream << '\\' << c;
+        else if(c >= 0 && c < 0x20) stream << ' ';
+        else stream << c;
+    }
+    stream << '"';
+}
+
+EgalitoTracer::EgalitoTracer() : origin(std::chrono::steady_clock::now()) {
+    if(const char *file = getenv("EGALITO_TRACE")) traceFile = file;
+}
+
+unsigned long EgalitoTracer::getElapsedUS() const {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - origin).count();
+}
+
+void EgalitoTracer::add(const Event &event) {
+    std::lock_guard<std::mutex> lock(eventMutex);
+    eventList.push_back(event);
+}
+
+void EgalitoTracer::counter(const char *name, long value) {
+    if(!isEnabled()) return;
+
+    Event event;
+    event.name = name;
+    event.phase = 'C';
+    event.tid = getThreadID();
+    event.depth = 0;
+    event.startUS = getElapsedUS();
+    event.durationUS = 0;
+    event.value = value;
+    add(event);
+}
+
+void EgalitoTracer::flush() {
+    if(!isEnabled()) return;
+
+    std::ofstream file(traceFile.c_str());
+    writeChromeTrace(file);
+    LOG(1, "wrote " << std::dec << eventList.size() << " trace events to "
+        << traceFile);
+    traceFile.clear();
+}
+
+void EgalitoTracer::writeChromeTrace(std::ostream &stream) {
+    std::lock_guard<std::mutex> lock(eventMutex);
+    int pid = getpid();
+    stream << "{\"traceEvents\": [";
+    bool first = true;
+    for(const auto &event : eventList) {
+        stream << (first ? "\n" : ",\n") << "  {\"name\": ";
+        writeString(stream, event.name);
+        stream << ", \"ph\": \"" << event.phase << "\""
+            << ", \"pid\": " << pid << ", \"tid\": " << event.tid
+            << ", \"ts\": " << event.startUS;
+        if(event.phase == 'X') {
+            stream << ", \"cat\": \"egalito\", \"dur\": " << event.durationUS
+                << ", \"args\": {\"depth\": " << event.depth << "}}";
+        }
+        else {
+            stream << ", \"args\": {\"value\": " << event.value << "}}";
+        }
+        first = false;
+    }
+    stream << "\n]}\n";
+}
+
+int EgalitoTracer::getThreadID() {
+    static thread_local int tid = 0;
+    if(!tid) tid = static_cast<int>(syscall(SYS_gettid));
+    return tid;
+}
+
+EgalitoTraceSpan::EgalitoTraceSpan(const char *name)
+    : enabled(EgalitoTracer::getInstance()->isEnabled()) {
+
+    if(!enabled) return;
+    event.name = name;
+    begin();
+}
+
+EgalitoTraceSpan::EgalitoTraceSpan(const std::string &name)
+    : enabled(EgalitoTracer::getInstance()->isEnabled()) {
+
+    if(!enabled) return;
+    event.name = name;
+    begin();
+}
+
+void EgalitoTraceSpan::begin() {
+    event.phase = 'X';
+    event.tid = EgalitoTracer::getThreadID();
+    event.depth = traceDepth ++;
+    event.value = 0;
+    event.startUS = EgalitoTracer::getInstance()->getElapsedUS();
+}
+
+EgalitoTraceSpan::~EgalitoTraceSpan() {
+    if(!enabled) return;
+    traceDepth --;
+
+    auto tracer = EgalitoTracer::getInstance();
+    // the trace may have been flushed while this span was open
+    if(!tracer->isEnabled()) return;
+    event.durationUS = tracer->getElapsedUS() - event.startUS;
+    tracer->add(event);
+}
+
 extern bool egalito_init_done;
 EgalitoTiming::EgalitoTiming(const char *message, unsigned long printThresholdMS)
-    : message(message), printThresholdMS(printThresholdMS) {
+    : message(message), printThresholdMS(printThresholdMS), span(message) {
 
     startTime = std::chrono::high_resolution_clock::now();
 }
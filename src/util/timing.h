@@ -2,12 +2,76 @@
 #define EGALITO_UTIL_TIMING_H
 
 #include <chrono>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <iosfwd>
 
+/** Records scoped spans and counters for a startup timeline.
+
+    Tracing is off unless EGALITO_TRACE names an output file, which gets
+    Chrome trace event JSON (also read by Perfetto). Spans nest per thread
+    and carry the kernel thread id, so work done on ThreadPool workers shows
+    up on its own track. The file is written by flush(), or at exit.
+*/
+class EgalitoTracer {
+public:
+    struct Event {
+        std::string name;
+        char phase;                 // 'X' for a span, 'C' for a counter
+        int tid;
+        unsigned depth;             // nesting level of a span on its thread
+        unsigned long startUS;      // since the tracer was created
+        unsigned long durationUS;
+        long value;                 // counter value
+    };
+private:
+    static EgalitoTracer instance;
+public:
+    static EgalitoTracer *getInstance() { return &instance; }
+private:
+    std::mutex eventMutex;
+    std::vector<Event> eventList;
+    std::chrono::steady_clock::time_point origin;
+    std::string traceFile;
+public:
+    EgalitoTracer();
+    ~EgalitoTracer() { flush(); }
+
+    bool isEnabled() const { return !traceFile.empty(); }
+    void setTraceFile(const std::string &file) { traceFile = file; }
+    unsigned long getElapsedUS() const;
+
+    void add(const Event &event);
+    void counter(const char *name, long value);
+
+    /** Writes the trace file, and stops tracing. */
+    void flush();
+    void writeChromeTrace(std::ostream &stream);
+
+    static int getThreadID();
+};
+
+/** Adds one span to the EgalitoTracer timeline, if tracing is enabled. */
+class EgalitoTraceSpan {
+private:
+    EgalitoTracer::Event event;
+    bool enabled;
+public:
+    EgalitoTraceSpan(const char *name);
+    EgalitoTraceSpan(const std::string &name);
+    ~EgalitoTraceSpan();
+private:
+    void begin();
+};
+
+/** Prints the time taken by a scope, and adds it to the trace timeline. */
 class EgalitoTiming {
 private:
     std::chrono::high_resolution_clock::time_point startTime;
     const char *message;
     unsigned long printThresholdMS;
+    EgalitoTraceSpan span;
 public:
     EgalitoTiming(const char *message, unsigned long printThresholdMS = 0);
     ~EgalitoTiming();
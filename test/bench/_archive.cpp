@@ -0,0 +1,33 @@
+#include <cstdio>  // for std::remove
+#include "bench.h"
+#include "fixture.h"
+#include "chunk/serializer.h"
+#include "chunk/concrete.h"
+
+static const char *ARCHIVE_FILE = "/tmp/egalito-bench.archive";
+
+BENCHMARK("archive/write-hello") {
+    state.pause();
+    static BenchFixture fixture(TESTDIR "hello");
+    state.resume();
+
+    for(size_t i = 0; i < state.getIterations(); i ++) {
+        ChunkSerializer().serialize(fixture.getModule(), ARCHIVE_FILE);
+    }
+    state.pause();
+    std::remove(ARCHIVE_FILE);
+}
+
+BENCHMARK("archive/read-hello") {
+    state.pause();
+    static BenchFixture fixture(TESTDIR "hello");
+    ChunkSerializer().serialize(fixture.getModule(), ARCHIVE_FILE);
+    state.resume();
+
+    for(size_t i = 0; i < state.getIterations(); i ++) {
+        auto chunk = ChunkSerializer().deserialize(ARCHIVE_FILE);
+        benchKeep(chunk);
+    }
+    state.pause();
+    std::remove(ARCHIVE_FILE);
+}
@@ -0,0 +1,37 @@
+#include <vector>
+#include "bench.h"
+#include "disasm/disassemble.h"
+#include "chunk/concrete.h"
+
+BENCHMARK("disassemble/instruction") {
+#ifdef ARCH_X86_64
+    // a mix of common encodings: add, mov, lea rip, call, ret
+    const std::vector<std::vector<unsigned char>> bytesList = {
+        {0x83, 0xc0, 0x01},
+        {0x48, 0x89, 0xe5},
+        {0x48, 0x8d, 0x05, 0x10, 0x00, 0x00, 0x00},
+        {0xe8, 0x00, 0x00, 0x00, 0x00},
+        {0xc3},
+    };
+#elif defined(ARCH_AARCH64)
+    const std::vector<std::vector<unsigned char>> bytesList = {
+        {0x00, 0x00, 0x00, 0x91},
+        {0xfd, 0x7b, 0xbf, 0xa9},
+        {0x00, 0x00, 0x00, 0x94},
+        {0xc0, 0x03, 0x5f, 0xd6},
+    };
+#else
+    const std::vector<std::vector<unsigned char>> bytesList = {
+        {0x93, 0x80, 0x10, 0x00},
+    };
+#endif
+    DisasmHandle handle(true);
+    for(size_t i = 0; i < state.getIterations(); i ++) {
+        auto instr = Disassemble::instruction(handle,
+            bytesList[i % bytesList.size()], true, 0x1000);
+        benchKeep(instr);
+        state.pause();
+        delete instr;
+        state.resume();
+    }
+}
@@ -0,0 +1,28 @@
+#include "bench.h"
+#include "fixture.h"
+#include "conductor/setup.h"
+#include "transform/generator.h"
+#include "transform/sandbox.h"
+#include "chunk/concrete.h"
+
+BENCHMARK("generator/generate-code-hello") {
+    // assigning addresses moves the code, so this has its own fixture
+    state.pause();
+    static BenchFixture fixture(TESTDIR "hello");
+    static Sandbox *sandbox = nullptr;
+    if(!sandbox) {
+        sandbox = fixture.getSetup()->makeStaticExecutableSandbox(nullptr);
+        Generator(sandbox).assignAddresses(fixture.getModule());
+    }
+    auto backing = static_cast<MemoryBufferBacking *>(sandbox->getBacking());
+    state.resume();
+
+    Generator generator(sandbox);
+    for(size_t i = 0; i < state.getIterations(); i ++) {
+        state.pause();
+        backing->recreate();
+        state.resume();
+
+        generator.generateCode(fixture.getModule());
+    }
+}
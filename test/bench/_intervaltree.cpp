@@ -0,0 +1,55 @@
+#include "bench.h"
+#include "util/intervaltree.h"
+
+static const size_t RANGE_COUNT = 4096;
+
+static void fillTree(IntervalTree &tree) {
+    for(size_t i = 0; i < RANGE_COUNT; i ++) {
+        tree.add(Range(i * 0x20, 0x10));
+    }
+}
+
+BENCHMARK("intervaltree/add-4096") {
+    for(size_t i = 0; i < state.getIterations(); i ++) {
+        IntervalTree tree(Range(0, RANGE_COUNT * 0x20));
+        fillTree(tree);
+        benchKeep(tree);
+    }
+}
+
+BENCHMARK("intervaltree/find-overlapping") {
+    state.pause();
+    IntervalTree tree(Range(0, RANGE_COUNT * 0x20));
+    fillTree(tree);
+    state.resume();
+
+    for(size_t i = 0; i < state.getIterations(); i ++) {
+        auto found = tree.findOverlapping((i * 0x2f) % (RANGE_COUNT * 0x20));
+        benchKeep(found);
+    }
+}
+
+BENCHMARK("intervaltree/find-lower-bound") {
+    state.pause();
+    IntervalTree tree(Range(0, RANGE_COUNT * 0x20));
+    fillTree(tree);
+    state.resume();
+
+    Range bound;
+    for(size_t i = 0; i < state.getIterations(); i ++) {
+        tree.findLowerBound((i * 0x2f) % (RANGE_COUNT * 0x20), &bound);
+        benchKeep(bound);
+    }
+}
+
+BENCHMARK("intervaltree/complement") {
+    state.pause();
+    IntervalTree tree(Range(0, RANGE_COUNT * 0x20));
+    fillTree(tree);
+    state.resume();
+
+    for(size_t i = 0; i < state.getIterations(); i ++) {
+        auto complement = tree.complement();
+        benchKeep(complement);
+    }
+}
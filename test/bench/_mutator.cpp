@@ -0,0 +1,83 @@
+#include <vector>
+#include "bench.h"
+#include "chunk/concrete.h"
+#include "disasm/disassemble.h"
+#include "operation/mutator.h"
+
+static Instruction *makeInstruction() {
+#ifdef ARCH_X86_64
+    // add $1, %eax
+    std::vector<unsigned char> bytes = {0x83, 0xc0, 0x01};
+#else
+    // add X0, X0, #1
+    std::vector<unsigned char> bytes = {0x00, 0x04, 0x00, 0x91};
+#endif
+    return Disassemble::instruction(bytes, true, 0);
+}
+
+static Block *makeBlock(size_t count) {
+    auto block = new Block();
+    block->setPosition(
+        PositionFactory::getInstance()->makePosition(nullptr, block, 0));
+    for(size_t i = 0; i < count; i ++) {
+        ChunkMutator(block).append(makeInstruction());
+    }
+    return block;
+}
+
+BENCHMARK("mutator/append") {
+    state.pause();
+    std::vector<Instruction *> instrList;
+    for(size_t i = 0; i < state.getIterations(); i ++) {
+        instrList.push_back(makeInstruction());
+    }
+    auto block = makeBlock(0);
+    state.resume();
+
+    for(auto instr : instrList) {
+        ChunkMutator(block).append(instr);
+    }
+
+    state.pause();
+    delete block;
+}
+
+BENCHMARK("mutator/insert-before-256") {
+    // inserting into the middle of a block moves every later instruction
+    state.pause();
+    std::vector<Instruction *> instrList;
+    for(size_t i = 0; i < state.getIterations(); i ++) {
+        instrList.push_back(makeInstruction());
+    }
+    auto block = makeBlock(256);
+    auto middle = block->getChildren()->getIterable()->get(128);
+    state.resume();
+
+    for(auto instr : instrList) {
+        ChunkMutator(block).insertBefore(middle, instr);
+    }
+
+    state.pause();
+    delete block;
+}
+
+BENCHMARK("mutator/batch-insert-256") {
+    state.pause();
+    std::vector<Instruction *> instrList;
+    for(size_t i = 0; i < state.getIterations(); i ++) {
+        instrList.push_back(makeInstruction());
+    }
+    auto block = makeBlock(256);
+    auto middle = block->getChildren()->getIterable()->get(128);
+    state.resume();
+
+    {
+        ChunkMutator::Batch batch;
+        for(auto instr : instrList) {
+            ChunkMutator(block).insertBefore(middle, instr);
+        }
+    }
+
+    state.pause();
+    delete block;
+}
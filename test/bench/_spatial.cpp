@@ -0,0 +1,53 @@
+#include <vector>
+#include "bench.h"
+#include "chunk/chunklist.h"
+
+namespace {
+    class FakeChunk {
+    private:
+        Range range;
+    public:
+        FakeChunk(address_t address, size_t size) : range(address, size) {}
+        address_t getAddress() const { return range.getStart(); }
+        Range getRange() const { return range; }
+    };
+}
+
+static const size_t CHUNK_COUNT = 8192;
+
+BENCHMARK("spatial/find-containing") {
+    state.pause();
+    std::vector<FakeChunk> chunkList;
+    chunkList.reserve(CHUNK_COUNT);
+    SpatialChunkList<FakeChunk> spatial;
+    for(size_t i = 0; i < CHUNK_COUNT; i ++) {
+        chunkList.emplace_back(0x1000 + i * 0x40, 0x30);
+        spatial.add(&chunkList.back());
+    }
+    spatial.findContaining(0);  // builds the lookup structure
+    state.resume();
+
+    for(size_t i = 0; i < state.getIterations(); i ++) {
+        auto found = spatial.findContaining(
+            0x1000 + (i * 0x3b) % (CHUNK_COUNT * 0x40));
+        benchKeep(found);
+    }
+}
+
+BENCHMARK("spatial/find-exact") {
+    state.pause();
+    std::vector<FakeChunk> chunkList;
+    chunkList.reserve(CHUNK_COUNT);
+    SpatialChunkList<FakeChunk> spatial;
+    for(size_t i = 0; i < CHUNK_COUNT; i ++) {
+        chunkList.emplace_back(0x1000 + i * 0x40, 0x30);
+        spatial.add(&chunkList.back());
+    }
+    spatial.find(0);
+    state.resume();
+
+    for(size_t i = 0; i < state.getIterations(); i ++) {
+        auto found = spatial.find(0x1000 + (i % CHUNK_COUNT) * 0x40);
+        benchKeep(found);
+    }
+}
@@ -0,0 +1,42 @@
+#include "bench.h"
+#include "fixture.h"
+#include "analysis/controlflow.h"
+#include "analysis/usedef.h"
+#include "analysis/walker.h"
+#include "chunk/concrete.h"
+
+static void analyzeFunction(Function *function) {
+    ControlFlowGraph cfg(function);
+    UDConfiguration config(&cfg);
+    UDRegMemWorkingSet working(function, &cfg);
+    UseDef usedef(&config, &working);
+
+    SccOrder order(&cfg);
+    order.genFull(0);
+    usedef.analyze(order.get());
+}
+
+BENCHMARK("usedef/hello-main") {
+    state.pause();
+    static BenchFixture fixture(TESTDIR "hello");
+    auto function = fixture.getFunction("main");
+    state.resume();
+
+    for(size_t i = 0; i < state.getIterations(); i ++) {
+        analyzeFunction(function);
+    }
+}
+
+BENCHMARK("usedef/jumptable-all") {
+    // every function in a binary with switch statements, as the jump
+    // table and pointer detection passes do
+    state.pause();
+    static BenchFixture fixture(TESTDIR "jumptable");
+    state.resume();
+
+    for(size_t i = 0; i < state.getIterations(); i ++) {
+        for(auto function : CIter::functions(fixture.getModule())) {
+            analyzeFunction(function);
+        }
+    }
+}
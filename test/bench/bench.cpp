@@ -0,0 +1,268 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <new>
+#include <sstream>
+#include "bench.h"
+#include "log/registry.h"
+
+// Every allocation made while a benchmark is running is counted here.
+static std::atomic<size_t> allocCount(0);
+static std::atomic<size_t> allocBytes(0);
+
+void *operator new(size_t size) {
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    allocBytes.fetch_add(size, std::memory_order_relaxed);
+    if(void *p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void *operator new[](size_t size) { return operator new(size); }
+
+// not inlined, so gcc doesn't pair a new expression with free()
+__attribute__((noinline)) static void release(void *p) { std::free(p); }
+void operator delete(void *p) noexcept { release(p); }
+void operator delete[](void *p) noexcept { release(p); }
+void operator delete(void *p, size_t) noexcept { release(p); }
+void operator delete[](void *p, size_t) noexcept { release(p); }
+
+static unsigned long nowNS() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+BenchState::BenchState(size_t iterations) : iterations(iterations),
+    running(false), startNS(0), elapsedNS(0), startAllocs(0), startBytes(0),
+    allocs(0), bytes(0) {
+
+    resume();
+}
+
+void BenchState::pause() {
+    elapsedNS += nowNS() - startNS;
+    allocs += allocCount - startAllocs;
+    bytes += allocBytes - startBytes;
+    running = false;
+}
+
+void BenchState::resume() {
+    running = true;
+    startAllocs = allocCount;
+    startBytes = allocBytes;
+    startNS = nowNS();
+}
+
+BenchRegistry *BenchRegistry::getInstance() {
+    static BenchRegistry instance;
+    return &instance;
+}
+
+namespace {
+    struct Result {
+        std::string name;
+        size_t iterations;
+        double nsPerOp;
+        double allocsPerOp;
+        double bytesPerOp;
+    };
+
+    struct Options {
+        std::string filter;
+        std::string outputFile;
+        std::string baselineFile;
+        double minTimeMS = 200;
+        double tolerance = 0.10;
+    };
+}
+
+static Result runOne(const BenchRegistry::Entry &entry, double minTimeMS) {
+    // grow the iteration count until one run takes at least minTimeMS
+    size_t iterations = 1;
+    for(;;) {
+        BenchState state(iterations);
+        entry.function(state);
+        state.stop();
+
+        double ns = static_cast<double>(state.getElapsedNS());
+        if(ns >= minTimeMS * 1e6 || iterations >= (1ul << 30)) {
+            return Result{entry.name, iterations, ns / iterations,
+                static_cast<double>(state.getAllocs()) / iterations,
+                static_cast<double>(state.getBytes()) / iterations};
+        }
+
+        double scale = ns > 0 ? (minTimeMS * 1e6 * 1.2) / ns : 100;
+        if(scale > 100) scale = 100;
+        if(scale < 2) scale = 2;
+        iterations = static_cast<size_t>(iterations * scale);
+    }
+}
+
+static void writeJSON(std::ostream &stream, const std::vector<Result> &list) {
+    stream << "{\n  \"benchmarks\": [";
+    bool first = true;
+    for(const auto &result : list) {
+        stream << (first ? "\n" : ",\n")
+            << "    {\"name\": \"" << result.name << "\""
+            << ", \"iterations\": " << result.iterations
+            << std::fixed << std::setprecision(2)
+            << ", \"ns_per_op\": " << result.nsPerOp
+            << ", \"allocs_per_op\": " << result.allocsPerOp
+            << ", \"bytes_per_op\": " << result.bytesPerOp << "}";
+        stream.unsetf(std::ios::floatfield);
+        first = false;
+    }
+    stream << "\n  ]\n}\n";
+}
+
+static bool readNumber(const std::string &text, size_t from, size_t to,
+    const char *key, double *value) {
+
+    auto pos = text.find(key, from);
+    if(pos == std::string::npos || pos >= to) return false;
+    pos = text.find(':', pos);
+    if(pos == std::string::npos) return false;
+    *value = std::strtod(text.c_str() + pos + 1, nullptr);
+    return true;
+}
+
+/** Reads back the file written by writeJSON(); not a general JSON parser. */
+static bool readBaseline(const std::string &filename,
+    std::map<std::string, Result> &baseline) {
+
+    std::ifstream file(filename.c_str());
+    if(!file) return false;
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    std::string text = buffer.str();
+
+    size_t pos = 0;
+    while((pos = text.find("\"name\"", pos)) != std::string::npos) {
+        auto end = text.find('}', pos);
+        if(end == std::string::npos) break;
+        auto open = text.find('"', text.find(':', pos));
+        auto close = text.find('"', open + 1);
+
+        Result result;
+        result.name = text.substr(open + 1, close - open - 1);
+        result.iterations = 0;
+        result.allocsPerOp = result.bytesPerOp = 0;
+        if(readNumber(text, pos, end, "\"ns_per_op\"", &result.nsPerOp)) {
+            readNumber(text, pos, end, "\"allocs_per_op\"",
+                &result.allocsPerOp);
+            readNumber(text, pos, end, "\"bytes_per_op\"",
+                &result.bytesPerOp);
+            baseline[result.name] = result;
+        }
+        pos = end;
+    }
+    return true;
+}
+
+/** Prints each result against the baseline; returns the regression count. */
+static int compare(const std::vector<Result> &list,
+    const std::map<std::string, Result> &baseline, double tolerance) {
+
+    int regressions = 0;
+    std::printf("\n%-36s %12s %12s %8s %10s\n",
+        "benchmark", "base ns/op", "ns/op", "change", "allocs");
+    for(const auto &result : list) {
+        auto it = baseline.find(result.name);
+        if(it == baseline.end()) {
+            std::printf("%-36s %12s %12.1f %8s\n", result.name.c_str(),
+                "-", result.nsPerOp, "new");
+            continue;
+        }
+        const auto &base = it->second;
+        double change = base.nsPerOp > 0
+            ? (result.nsPerOp - base.nsPerOp) / base.nsPerOp : 0;
+        bool slower = change > tolerance;
+        // allocation counts are deterministic, so any growth is reported
+        bool moreAllocs = result.allocsPerOp > base.allocsPerOp + 0.5;
+        std::printf("%-36s %12.1f %12.1f %+7.1f%% %10s%s\n",
+            result.name.c_str(), base.nsPerOp, result.nsPerOp, change * 100,
+            moreAllocs ? "MORE" : "ok",
+            slower ? "  REGRESSION" : "");
+        if(slower || moreAllocs) regressions ++;
+    }
+    return regressions;
+}
+
+static void usage(const char *program) {
+    std::printf("Usage: %s [options]\n"
+        "    -f substring   only run benchmarks whose name contains this\n"
+        "    -o file.json   write results to this file (e.g. a new baseline)\n"
+        "    -b file.json   compare against this baseline; exits with 1 on\n"
+        "                   a regression\n"
+        "    -t percent     allowed slowdown before a regression (default 10)\n"
+        "    -m ms          minimum measured time per benchmark (default 200)\n"
+        "    -l             list benchmarks\n",
+        program);
+}
+
+int main(int argc, char *argv[]) {
+    Options options;
+    for(int i = 1; i < argc; i ++) {
+        std::string arg = argv[i];
+        bool hasValue = (i + 1 < argc);
+        if(arg == "-f" && hasValue) options.filter = argv[++ i];
+        else if(arg == "-o" && hasValue) options.outputFile = argv[++ i];
+        else if(arg == "-b" && hasValue) options.baselineFile = argv[++ i];
+        else if(arg == "-t" && hasValue) {
+            options.tolerance = std::strtod(argv[++ i], nullptr) / 100;
+        }
+        else if(arg == "-m" && hasValue) {
+            options.minTimeMS = std::strtod(argv[++ i], nullptr);
+        }
+        else if(arg == "-l") {
+            for(const auto &entry : BenchRegistry::getInstance()->getEntryList()) {
+                std::printf("%s\n", entry.name.c_str());
+            }
+            return 0;
+        }
+        else {
+            usage(argv[0]);
+            return arg == "-h" ? 0 : 2;
+        }
+    }
+
+    GroupRegistry::getInstance()->muteAllSettings();
+
+    std::vector<Result> resultList;
+    std::printf("%-36s %12s %12s %12s %12s\n",
+        "benchmark", "iterations", "ns/op", "allocs/op", "bytes/op");
+    for(const auto &entry : BenchRegistry::getInstance()->getEntryList()) {
+        if(entry.name.find(options.filter) == std::string::npos) continue;
+
+        auto result = runOne(entry, options.minTimeMS);
+        std::printf("%-36s %12zu %12.1f %12.2f %12.1f\n", result.name.c_str(),
+            result.iterations, result.nsPerOp, result.allocsPerOp,
+            result.bytesPerOp);
+        std::fflush(stdout);
+        resultList.push_back(result);
+    }
+
+    if(!options.outputFile.empty()) {
+        std::ofstream file(options.outputFile.c_str());
+        writeJSON(file, resultList);
+    }
+
+    if(!options.baselineFile.empty()) {
+        std::map<std::string, Result> baseline;
+        if(!readBaseline(options.baselineFile, baseline)) {
+            std::fprintf(stderr, "can't read baseline [%s]\n",
+                options.baselineFile.c_str());
+            return 2;
+        }
+        int regressions = compare(resultList, baseline, options.tolerance);
+        if(regressions) {
+            std::printf("%d benchmark(s) regressed\n", regressions);
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,75 @@
+#ifndef EGALITO_TEST_BENCH_BENCH_H
+#define EGALITO_TEST_BENCH_BENCH_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+/** Passed to each benchmark body, which must run its operation
+    getIterations() times. Setup that should not be measured goes between
+    pause() and resume(); time and allocations are only counted while the
+    state is running.
+*/
+class BenchState {
+private:
+    size_t iterations;
+    bool running;
+    unsigned long startNS;
+    unsigned long elapsedNS;
+    size_t startAllocs, startBytes;
+    size_t allocs, bytes;
+public:
+    BenchState(size_t iterations);
+
+    size_t getIterations() const { return iterations; }
+
+    void pause();
+    void resume();
+    void stop() { if(running) pause(); }
+
+    unsigned long getElapsedNS() const { return elapsedNS; }
+    size_t getAllocs() const { return allocs; }
+    size_t getBytes() const { return bytes; }
+};
+
+typedef void (*BenchFunction)(BenchState &state);
+
+class BenchRegistry {
+public:
+    struct Entry {
+        std::string name;
+        BenchFunction function;
+    };
+private:
+    std::vector<Entry> entryList;
+public:
+    static BenchRegistry *getInstance();
+
+    void add(const char *name, BenchFunction function)
+        { entryList.push_back(Entry{name, function}); }
+    const std::vector<Entry> &getEntryList() const { return entryList; }
+};
+
+class BenchRegistrar {
+public:
+    BenchRegistrar(const char *name, BenchFunction function)
+        { BenchRegistry::getInstance()->add(name, function); }
+};
+
+#define BENCH_CONCAT2(a, b) a ## b
+#define BENCH_CONCAT(a, b) BENCH_CONCAT2(a, b)
+
+/** Defines a benchmark. The body sees a BenchState named state. */
+#define BENCHMARK(name) \
+    static void BENCH_CONCAT(bench_, __LINE__)(BenchState &state); \
+    static BenchRegistrar BENCH_CONCAT(registrar_, __LINE__)( \
+        name, BENCH_CONCAT(bench_, __LINE__)); \
+    static void BENCH_CONCAT(bench_, __LINE__)(BenchState &state)
+
+/** Keeps the compiler from discarding a value computed by a benchmark. */
+template <typename T>
+inline void benchKeep(const T &value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+#endif
@@ -0,0 +1,13 @@
+#include "fixture.h"
+#include "conductor/setup.h"
+#include "chunk/concrete.h"
+
+BenchFixture::BenchFixture(const char *filename)
+    : setup(new ConductorSetup()) {
+
+    module = setup->parseElfFiles(filename, false, false);
+}
+
+Function *BenchFixture::getFunction(const char *name) const {
+    return CIter::named(module->getFunctionList())->find(name);
+}
@@ -0,0 +1,24 @@
+#ifndef EGALITO_TEST_BENCH_FIXTURE_H
+#define EGALITO_TEST_BENCH_FIXTURE_H
+
+class ConductorSetup;
+class Module;
+class Function;
+
+/** A test binary parsed once and kept for the whole benchmark run. Each
+    benchmark that changes the code (e.g. by assigning new addresses) should
+    use its own fixture.
+*/
+class BenchFixture {
+private:
+    ConductorSetup *setup;
+    Module *module;
+public:
+    BenchFixture(const char *filename);
+
+    ConductorSetup *getSetup() const { return setup; }
+    Module *getModule() const { return module; }
+    Function *getFunction(const char *name) const;
+};
+
+#endif
@@ -0,0 +1,253 @@
+#!/usr/bin/env python3
+#
+# Measures what each etharden transformation costs. Every binary of the
+# corpus is transformed once per configuration (a single pass, or a
+# combination), and each output is run under the binary's workload. The
+# report gives, relative to an untransformed --nop output:
+#
+#   - slowdown of the median wall time,
+#   - growth of executable code (SHF_EXECINSTR sections),
+#   - growth of user-space instructions executed, from perf stat.
+#
+# Corpus files use the same format as pipeline-bench.py: a binary,
+# optionally followed by "|" and its workload arguments. A workload of the
+# form "!script" runs "script <binary>" instead, e.g. to start a server and
+# drive it with wrk; the script's wall time is what gets measured.
+#
+# Usage:
+#     ./harden-bench.py [-c corpus.txt] [-o report.json] [-b baseline.json]
+
+import argparse
+import json
+import os
+import shutil
+import statistics
+import struct
+import subprocess
+import sys
+import time
+
+ETHARDEN = '../../app/etharden'
+
+# name -> etharden mode flags; 'nop' is the reference for the others
+CONFIGS = [
+    ('nop', ['--nop']),
+    ('retpolines', ['--retpolines']),
+    ('cfi', ['--cfi']),
+    ('ss-const', ['--ss-const']),
+    ('ss-gs', ['--ss-gs']),
+    ('ss-xor', ['--ss-xor']),
+    ('cancel-push', ['--cancel-push']),
+    ('cet-const', ['--cet-const']),
+    ('ss-const+retpolines', ['--ss-const', '--retpolines']),
+    ('cet-const+retpolines', ['--cet-const', '--retpolines']),
+]
+
+SHF_EXECINSTR = 0x4
+
+
+def read_corpus(filename):
+    corpus = []
+    with open(filename) as f:
+        for line in f:
+            line = line.strip()
+            if not line or line.startswith('#'):
+                continue
+            binary, _, workload = line.partition('|')
+            corpus.append((binary.strip(), workload.split()))
+    return corpus
+
+
+def code_size(filename):
+    """Sums the sizes of executable sections of a 64-bit ELF file."""
+    with open(filename, 'rb') as f:
+        data = f.read()
+    if data[:4] != b'\x7fELF' or data[4] != 2:
+        return 0
+    endian = '<' if data[5] == 1 else '>'
+    shoff, = struct.unpack_from(endian + 'Q', data, 0x28)
+    shentsize, shnum = struct.unpack_from(endian + 'HH', data, 0x3a)
+    total = 0
+    for i in range(shnum):
+        base = shoff + i * shentsize
+        flags, = struct.unpack_from(endian + 'Q', data, base + 8)
+        size, = struct.unpack_from(endian + 'Q', data, base + 32)
+        if flags & SHF_EXECINSTR:
+            total += size
+    return total
+
+
+def workload_argv(binary, workload):
+    if workload and workload[0].startswith('!'):
+        return [workload[0][1:], binary] + workload[1:]
+    return [binary] + workload
+
+
+def time_workload(argv, repeat):
+    """Median wall time in ms over repeat runs, or None if any run fails."""
+    times = []
+    for _ in range(repeat):
+        start = time.monotonic()
+        status = subprocess.call(argv, stdout=subprocess.DEVNULL,
+                                 stderr=subprocess.DEVNULL)
+        if status != 0:
+            return None
+        times.append((time.monotonic() - start) * 1000.0)
+    return statistics.median(times)
+
+
+def count_instructions(argv):
+    """User-space instructions retired for one run, or None without perf."""
+    if not shutil.which('perf'):
+        return None
+    proc = subprocess.run(
+        ['perf', 'stat', '-x', ',', '-e', 'instructions:u', '--'] + argv,
+        stdout=subprocess.DEVNULL, stderr=subprocess.PIPE,
+        universal_newlines=True)
+    if proc.returncode != 0:
+        return None
+    for line in proc.stderr.splitlines():
+        fields = line.split(',')
+        if len(fields) > 2 and fields[2].startswith('instructions'):
+            try:
+                return int(fields[0])
+            except ValueError:
+                return None  # "<not supported>" or "<not counted>"
+    return None
+
+
+def measure(binary, workload, repeat):
+    argv = workload_argv(binary, workload)
+    return {'code_bytes': code_size(binary),
+            'wall_ms': time_workload(argv, repeat),
+            'instructions': count_instructions(argv)}
+
+
+def relative(result, reference):
+    """Adds growth ratios of result against the reference measurement."""
+    for key, name in [('wall_ms', 'slowdown'), ('code_bytes', 'code_growth'),
+                      ('instructions', 'instruction_growth')]:
+        if result.get(key) and reference.get(key):
+            result[name] = result[key] / reference[key] - 1.0
+        else:
+            result[name] = None
+
+
+def bench_binary(binary, workload, args):
+    name = os.path.basename(binary)
+    results = {'original': measure(binary, workload, args.repeat)}
+    for config, flags in CONFIGS:
+        if args.only and config not in args.only and config != 'nop':
+            continue
+        output = os.path.join(args.tmpdir, '%s.%s' % (name, config))
+        log = os.path.join(args.tmpdir, '%s.%s.log' % (name, config))
+        with open(log, 'w') as logfile:
+            status = subprocess.call(
+                [args.etharden, args.mode] + flags + [binary, output],
+                stdout=logfile, stderr=subprocess.STDOUT)
+        if status != 0 or not os.path.exists(output):
+            results[config] = {'status': 'transform failed (see %s)' % log}
+            continue
+        result = measure(output, workload, args.repeat)
+        result['status'] = 'ok' if result['wall_ms'] is not None \
+            else 'workload failed'
+        results[config] = result
+
+    reference = results.get('nop', {})
+    for config, result in results.items():
+        if config not in ('original', 'nop') and result.get('status') == 'ok':
+            relative(result, reference)
+    return name, results
+
+
+def percent(value):
+    return '%+7.1f%%' % (value * 100) if value is not None else '       -'
+
+
+def print_results(name, results):
+    print('%s' % name)
+    for config, result in results.items():
+        if config in ('original', 'nop'):
+            continue
+        if result.get('status') != 'ok':
+            print('    %-24s %s' % (config, result.get('status')))
+            continue
+        print('    %-24s slowdown %s  code %s  instructions %s' % (
+            config, percent(result['slowdown']),
+            percent(result['code_growth']),
+            percent(result['instruction_growth'])))
+
+
+def compare(report, baseline, tolerance):
+    """Flags configs whose cost grew by more than tolerance (absolute)."""
+    regressions = 0
+    print('\n%-20s %-24s %-18s %9s %9s' % (
+        'binary', 'config', 'metric', 'baseline', 'current'))
+    for name, results in sorted(report['binaries'].items()):
+        base_results = baseline.get('binaries', {}).get(name, {})
+        for config, result in results.items():
+            base = base_results.get(config)
+            if not base or result.get('status') != 'ok' \
+                    or base.get('status') != 'ok':
+                continue
+            for metric in ['slowdown', 'code_growth', 'instruction_growth']:
+                current, old = result.get(metric), base.get(metric)
+                if current is None or old is None:
+                    continue
+                flag = '  REGRESSION' if current - old > tolerance else ''
+                if flag:
+                    regressions += 1
+                print('%-20s %-24s %-18s %s %s%s' % (
+                    name, config, metric, percent(old), percent(current),
+                    flag))
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Measure the runtime cost of etharden transformations.')
+    parser.add_argument('-c', '--corpus', default='pipeline-corpus.txt')
+    parser.add_argument('-o', '--output', default='tmp/harden-bench.json')
+    parser.add_argument('-b', '--baseline',
+                        help='compare against this report; exits with 1 '
+                             'on a regression')
+    parser.add_argument('-t', '--tolerance', type=float, default=3.0,
+                        help='allowed growth of any cost, in percentage '
+                             'points (default 3)')
+    parser.add_argument('-r', '--repeat', type=int, default=5,
+                        help='workload runs per output')
+    parser.add_argument('-m', '--mode', default='-m', choices=['-m', '-u'],
+                        help='etharden generation mode (mirror or union)')
+    parser.add_argument('--only', nargs='+', metavar='CONFIG',
+                        choices=[c for c, _ in CONFIGS],
+                        help='only run these configurations')
+    parser.add_argument('--etharden', default=ETHARDEN)
+    parser.add_argument('--tmpdir', default='tmp/harden-bench')
+    args = parser.parse_args()
+
+    os.makedirs(args.tmpdir, exist_ok=True)
+    report = {'etharden': os.path.realpath(args.etharden),
+              'mode': args.mode, 'time': time.strftime('%Y-%m-%dT%H:%M:%S'),
+              'binaries': {}}
+    for binary, workload in read_corpus(args.corpus):
+        name, results = bench_binary(binary, workload, args)
+        report['binaries'][name] = results
+        print_results(name, results)
+
+    output_dir = os.path.dirname(args.output)
+    if output_dir:
+        os.makedirs(output_dir, exist_ok=True)
+    with open(args.output, 'w') as f:
+        json.dump(report, f, indent=2, sort_keys=True)
+    print('wrote ' + args.output)
+
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+        if compare(report, baseline, args.tolerance / 100.0):
+            return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,221 @@
+#!/usr/bin/env python3
+#
+# End-to-end benchmark: transforms every binary of a corpus with etelf,
+# timing each pipeline stage and recording peak RSS, then runs the original
+# and rewritten binaries under a workload to measure the overhead of the
+# rewritten code. Results are written as JSON, and can be compared against
+# a stored baseline.
+#
+# Corpus files have one binary per line, optionally followed by "|" and the
+# arguments of its workload; blank lines and lines starting with # are
+# ignored. Example:
+#
+#     ../binary/build/hello
+#     ../binary/target/coreutils/install/bin/sort | -n tmp/numbers.txt
+#
+# Usage:
+#     ./pipeline-bench.py [-c corpus.txt] [-o report.json] [-b baseline.json]
+
+import argparse
+import json
+import os
+import statistics
+import subprocess
+import sys
+import time
+
+ETELF = '../../app/etelf'
+
+# top-level stages, by trace span name (see EGALITO_TRACE in app/elf)
+STAGES = {
+    'parse': ['ConductorPasses::newElfPasses'],
+    'resolve': ['Conductor::resolvePLTLinks', 'Conductor::resolveData'],
+    'generate': ['ConductorSetup::generate'],
+}
+# spans nested inside newElfPasses that are reported one by one
+PASS_PARENT = 'ConductorPasses::newElfPasses'
+
+
+def read_corpus(filename):
+    corpus = []
+    with open(filename) as f:
+        for line in f:
+            line = line.strip()
+            if not line or line.startswith('#'):
+                continue
+            binary, _, workload = line.partition('|')
+            corpus.append((binary.strip(), workload.split()))
+    return corpus
+
+
+def run_measured(argv, env=None, stdout=subprocess.DEVNULL):
+    """Runs argv; returns (exit status, wall seconds, peak RSS in KiB)."""
+    start = time.monotonic()
+    proc = subprocess.Popen(argv, env=env, stdout=stdout,
+                            stderr=subprocess.STDOUT)
+    _, status, usage = os.wait4(proc.pid, 0)
+    elapsed = time.monotonic() - start
+    proc.returncode = os.waitstatus_to_exitcode(status) \
+        if hasattr(os, 'waitstatus_to_exitcode') else status >> 8
+    return proc.returncode, elapsed, usage.ru_maxrss
+
+
+def summarize_trace(filename):
+    """Sums span durations (in ms) into stages and individual passes."""
+    with open(filename) as f:
+        events = json.load(f)['traceEvents']
+
+    spans = [e for e in events if e.get('ph') == 'X']
+    stages = {stage: 0.0 for stage in STAGES}
+    for event in spans:
+        for stage, names in STAGES.items():
+            if event['name'] in names:
+                stages[stage] += event['dur'] / 1000.0
+
+    # a pass span is one that lies within a newElfPasses span on its thread
+    parents = [e for e in spans if e['name'] == PASS_PARENT]
+    passes = {}
+    for event in spans:
+        if event['name'] == PASS_PARENT:
+            continue
+        for parent in parents:
+            if (event['tid'] == parent['tid']
+                    and event['args']['depth'] == parent['args']['depth'] + 1
+                    and parent['ts'] <= event['ts']
+                    and event['ts'] + event['dur']
+                        <= parent['ts'] + parent['dur']):
+                passes[event['name']] = passes.get(event['name'], 0.0) \
+                    + event['dur'] / 1000.0
+                break
+    return stages, passes
+
+
+def time_workload(argv, repeat):
+    """Median wall time in ms over repeat runs, or None if any run fails."""
+    times = []
+    for _ in range(repeat):
+        status, elapsed, _ = run_measured(argv)
+        if status != 0:
+            return None
+        times.append(elapsed * 1000.0)
+    return statistics.median(times)
+
+
+def bench_binary(binary, workload, args):
+    name = os.path.basename(binary)
+    output = os.path.join(args.tmpdir, name + '.egalito')
+    trace = os.path.join(args.tmpdir, name + '.trace.json')
+    log = os.path.join(args.tmpdir, name + '.etelf.log')
+
+    env = dict(os.environ)
+    env['EGALITO_TRACE'] = trace
+    env.setdefault('EGALITO_DEBUG', '/dev/null')
+    with open(log, 'w') as logfile:
+        status, elapsed, rss = run_measured(
+            [args.etelf, args.mode, binary, output], env=env, stdout=logfile)
+
+    result = {'binary': binary, 'transform_ms': elapsed * 1000.0,
+              'peak_rss_kb': rss}
+    if status != 0 or not os.path.exists(output) \
+            or not os.path.exists(trace):
+        result['status'] = 'transform failed (see %s)' % log
+        return name, result
+    result['stages'], result['passes'] = summarize_trace(trace)
+
+    if args.repeat > 0:
+        original = time_workload([binary] + workload, args.repeat)
+        rewritten = time_workload([output] + workload, args.repeat)
+        result['workload'] = {'args': workload, 'original_ms': original,
+                              'rewritten_ms': rewritten}
+        if original is None or rewritten is None:
+            result['status'] = 'workload failed'
+            return name, result
+        result['workload']['overhead'] = rewritten / original - 1.0
+    result['status'] = 'ok'
+    return name, result
+
+
+def compare(report, baseline, tolerance):
+    """Prints each metric against the baseline; returns regression count."""
+    regressions = 0
+    print('\n%-20s %-28s %12s %12s %8s' % (
+        'binary', 'metric', 'baseline', 'current', 'change'))
+    for name, result in sorted(report['binaries'].items()):
+        base = baseline.get('binaries', {}).get(name)
+        if base is None or result['status'] != 'ok' \
+                or base.get('status') != 'ok':
+            print('%-20s %s' % (name, 'no baseline' if base is None
+                                else result['status']))
+            continue
+
+        metrics = [('transform_ms', result['transform_ms'],
+                    base['transform_ms']),
+                   ('peak_rss_kb', result['peak_rss_kb'], base['peak_rss_kb'])]
+        for stage in STAGES:
+            metrics.append(('stage ' + stage, result['stages'][stage],
+                            base['stages'].get(stage, 0.0)))
+        if 'workload' in result and 'workload' in base:
+            metrics.append(('workload rewritten_ms',
+                            result['workload']['rewritten_ms'],
+                            base['workload']['rewritten_ms']))
+
+        for metric, current, old in metrics:
+            change = (current - old) / old if old else 0.0
+            flag = '  REGRESSION' if change > tolerance else ''
+            if flag:
+                regressions += 1
+            print('%-20s %-28s %12.1f %12.1f %+7.1f%%%s' % (
+                name, metric, old, current, change * 100, flag))
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Time the egalito pipeline over a corpus of binaries.')
+    parser.add_argument('-c', '--corpus', default='pipeline-corpus.txt')
+    parser.add_argument('-o', '--output', default='tmp/pipeline-bench.json')
+    parser.add_argument('-b', '--baseline',
+                        help='compare against this report; exits with 1 '
+                             'on a regression')
+    parser.add_argument('-t', '--tolerance', type=float, default=10.0,
+                        help='allowed slowdown in percent (default 10)')
+    parser.add_argument('-r', '--repeat', type=int, default=5,
+                        help='workload runs per binary; 0 to skip')
+    parser.add_argument('-m', '--mode', default='-m', choices=['-m', '-u'],
+                        help='etelf generation mode (mirror or union)')
+    parser.add_argument('--etelf', default=ETELF)
+    parser.add_argument('--tmpdir', default='tmp/pipeline-bench')
+    args = parser.parse_args()
+
+    os.makedirs(args.tmpdir, exist_ok=True)
+    report = {'etelf': os.path.realpath(args.etelf), 'mode': args.mode,
+              'time': time.strftime('%Y-%m-%dT%H:%M:%S'), 'binaries': {}}
+    for binary, workload in read_corpus(args.corpus):
+        name, result = bench_binary(binary, workload, args)
+        report['binaries'][name] = result
+        summary = ', '.join('%s %.1f ms' % (stage, ms)
+                            for stage, ms in result.get('stages', {}).items())
+        print('%-20s %-8s rss %7d KiB  %s' % (
+            name, result['status'], result['peak_rss_kb'], summary))
+        if 'overhead' in result.get('workload', {}):
+            print('%-20s workload overhead %+.1f%%' % (
+                '', result['workload']['overhead'] * 100))
+
+    output_dir = os.path.dirname(args.output)
+    if output_dir:
+        os.makedirs(output_dir, exist_ok=True)
+    with open(args.output, 'w') as f:
+        json.dump(report, f, indent=2, sort_keys=True)
+    print('wrote ' + args.output)
+
+    failed = [n for n, r in report['binaries'].items() if r['status'] != 'ok']
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+        if compare(report, baseline, args.tolerance / 100.0):
+            return 1
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
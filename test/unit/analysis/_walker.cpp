@@ -2,6 +2,8 @@
 #include "elf/elfmap.h"
 #include "elf/elfspace.h"
 #include "analysis/walker.h"
+#include "analysis/worklist.h"
+#include "analysis/dominance.h"
 #include "analysis/controlflow.h"
 #include "conductor/conductor.h"
 #include "log/registry.h"
@@ -115,4 +117,69 @@ TEST_CASE("CFG walker", "[analysis][fast][.]") {
         CHECK(order.get()[1][0] == 4);
         CHECK(order.get()[1][1] == 3);
     }
+
+    SECTION("worklist") {
+        SccOrder order(&cfg);
+        order.gen(0);
+
+        // shortest distance from the entry, relaxed along forward links
+        const int unknown = 1000;
+        std::vector<int> distance(cfg.getCount(), unknown);
+        WorklistSolver<> solver(&cfg, order.get());
+        auto visits = solver.solve([&] (int id) {
+            int d = (id == 0 ? 0 : unknown);
+            for(auto link : cfg.get(id)->backwardLinks()) {
+                d = std::min(d, distance[link->getTargetID()] + 1);
+            }
+            bool changed = (d != distance[id]);
+            distance[id] = d;
+            return changed;
+        });
+        LOG(1, "worklist converged after " << visits << " visits");
+
+        CHECK(distance[0] == 0);
+        CHECK(distance[1] == 1);
+        CHECK(distance[6] == 1);
+        CHECK(distance[4] == 4);
+        CHECK(distance[5] == 5);
+        CHECK(visits < 2 * cfg.getCount());
+    }
+
+    SECTION("adjacency") {
+        for(size_t id = 0; id < cfg.getCount(); id ++) {
+            std::vector<int> forward, backward;
+            for(auto link : cfg.get(id)->forwardLinks()) {
+                forward.push_back(link->getTargetID());
+            }
+            for(auto link : cfg.get(id)->backwardLinks()) {
+                backward.push_back(link->getTargetID());
+            }
+            auto successors = cfg.getSuccessors(id);
+            auto predecessors = cfg.getPredecessors(id);
+            CHECK(std::vector<int>(successors.begin(), successors.end())
+                == forward);
+            CHECK(std::vector<int>(predecessors.begin(), predecessors.end())
+                == backward);
+        }
+        CHECK(cfg.getSuccessors(3).size() == 1);
+        CHECK(cfg.getPredecessors(3).size() == 2);
+    }
+
+    SECTION("dominance") {
+        Dominance dominance(&cfg);
+        CHECK(dominance.getImmediateDominator(0) == -1);
+        CHECK(dominance.getImmediateDominator(1) == 0);
+        CHECK(dominance.getImmediateDominator(6) == 0);
+        CHECK(dominance.getImmediateDominator(4) == 3);
+        CHECK(dominance.dominates(1, 5));
+        CHECK(!dominance.dominates(6, 2));
+        CHECK(dominance.getDominators(5).size() == 6);
+
+        // exits are 5 and 6
+        CHECK(dominance.getImmediatePostDominator(3) == 4);
+        CHECK(dominance.getImmediatePostDominator(5) == -1);
+        CHECK(dominance.postDominates(5, 2));
+        CHECK(!dominance.postDominates(6, 1));
+        CHECK(dominance.getPostDominators(0).size() == 1);
+    }
 }
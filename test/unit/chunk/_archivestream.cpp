@@ -0,0 +1,49 @@
+#include <sstream>
+#include "framework/include.h"
+#include "archive/stream.h"
+
+TEST_CASE("compact archive values round-trip", "[chunk][fast]") {
+    std::ostringstream output;
+    ArchiveStreamWriter writer(output);
+    writer.writeVarint(0);
+    writer.writeVarint(127);
+    writer.writeVarint(128);
+    writer.writeVarint(~0ull);
+    writer.writeID(FlatChunk::NoneID);
+    writer.writeID(5);
+    writer.writeID(6, 5);
+    writer.writeID(2, 6);
+
+    auto data = output.str();
+    // 1 + 1 + 2 + 10 bytes of varints, then one byte per ID
+    CHECK(data.length() == 18);
+    CHECK(data[14] == 0);  // NoneID
+
+    ArchiveStreamReader reader(data.data(), data.length());
+    reader.setCompact(true);
+    CHECK(reader.readVarint<uint32_t>() == 0);
+    CHECK(reader.readVarint<uint32_t>() == 127);
+    CHECK(reader.readVarint<uint64_t>() == 128);
+    CHECK(reader.readVarint<uint64_t>() == ~0ull);
+    CHECK(reader.readID() == FlatChunk::NoneID);
+    CHECK(reader.readID() == 5);
+    CHECK(reader.readID(5) == 6);
+    CHECK(reader.readID(6) == 2);
+    CHECK(reader.stillGood());
+
+    reader.readVarint<uint32_t>();
+    CHECK(!reader.stillGood());
+}
+
+TEST_CASE("non-compact readers expect fixed-width values", "[chunk][fast]") {
+    std::ostringstream output;
+    ArchiveStreamWriter writer(output);
+    writer.write<uint32_t>(300);
+    writer.write<FlatChunk::IDType>(7);
+
+    auto data = output.str();
+    ArchiveStreamReader reader(data.data(), data.length());
+    CHECK(reader.readVarint<uint32_t>() == 300);
+    CHECK(reader.readID() == 7);
+    CHECK(reader.stillGood());
+}
@@ -0,0 +1,76 @@
+#include "framework/include.h"
+#include "chunk/blocktable.h"
+#include "chunk/concrete.h"
+#include "instr/concrete.h"
+#include "operation/mutator.h"
+
+static Function *makeFunction(address_t address,
+    const std::vector<std::vector<size_t>> &blockSizes) {
+
+    PositionFactory *positionFactory = PositionFactory::getInstance();
+    auto function = new Function(address);
+    function->setPosition(positionFactory->makeAbsolutePosition(address));
+
+    Chunk *prevBlock = nullptr;
+    for(const auto &sizes : blockSizes) {
+        auto block = new Block();
+        block->setPosition(positionFactory->makePosition(
+            prevBlock, block, function->getSize()));
+        ChunkMutator(function).append(block);
+
+        Chunk *prevInstr = nullptr;
+        for(auto size : sizes) {
+            auto semantic = new IsolatedInstruction();
+            semantic->setData(std::string(size, '\x90'));
+            auto instr = new Instruction();
+            instr->setSemantic(semantic);
+            instr->setPosition(positionFactory->makePosition(
+                prevInstr, instr, block->getSize()));
+            ChunkMutator(block).append(instr);
+            prevInstr = instr;
+        }
+        prevBlock = block;
+    }
+    return function;
+}
+
+TEST_CASE("BlockTable finds blocks and instructions by address", "[chunk][fast]") {
+    // added out of address order on purpose
+    auto high = makeFunction(0x2000, {{1, 2}, {4}});
+    auto low = makeFunction(0x1000, {{3}, {1, 1, 5}});
+
+    BlockTable table;
+    table.add(high);
+    table.add(low);
+    table.finish();
+
+    REQUIRE(table.getCount() == 4);
+    CHECK(table.getFunctionCount() == 2);
+    CHECK(table.getTotalSize() == 3 + 4 + 3 + 7);
+    for(size_t i = 1; i < table.getCount(); i ++) {
+        CHECK(table.get(i - 1).getAddress() < table.get(i).getAddress());
+    }
+
+    auto handle = table.findContaining(0x1005);
+    REQUIRE(handle.isValid());
+    CHECK(handle.getAddress() == 0x1003);
+    CHECK(handle.getSize() == 7);
+    CHECK(handle.getFunction() == low);
+    CHECK(handle.getBlock() == low->getChildren()->getIterable()->get(1));
+    CHECK(handle.getInstructionCount() == 3);
+
+    auto lastBlock = low->getChildren()->getIterable()->get(1);
+    CHECK(handle.findInstruction(0x1005)
+        == lastBlock->getChildren()->getIterable()->get(2));
+    CHECK(handle.findInstruction(0x1004)
+        == lastBlock->getChildren()->getIterable()->get(1));
+
+    CHECK(table.find(0x2003).getFunction() == high);
+    CHECK(!table.find(0x2004).isValid());
+    CHECK(!table.findContaining(0x100a).isValid());
+    CHECK(!table.findContaining(0x0fff).isValid());
+    CHECK(!table.findContaining(0x2007).isValid());
+
+    delete high;
+    delete low;
+}
@@ -0,0 +1,35 @@
+#include <vector>
+#include "framework/include.h"
+#include "chunk/gstable.h"
+#include "chunk/concrete.h"
+
+TEST_CASE("GS table lookups by index and by target", "[chunk][fast]") {
+    GSTable gsTable;
+    std::vector<Function *> functions;
+    for(int i = 0; i < 200; i ++) {
+        functions.push_back(new Function(0x1000 + i));
+    }
+
+    for(int i = 0; i < 10; i ++) gsTable.makeReservedEntryFor(functions[i]);
+    gsTable.finishReservation();
+    for(int i = 10; i < 200; i ++) gsTable.makeJITEntryFor(functions[i]);
+    CHECK(gsTable.getJITStartIndex() == 10);
+
+    // making an entry twice returns the first one
+    CHECK(gsTable.makeJITEntryFor(functions[42])->getIndex() == 42);
+
+    for(int i = 0; i < 200; i ++) {
+        auto entry = gsTable.getEntryFor(functions[i]);
+        REQUIRE(entry != nullptr);
+        CHECK(entry->getIndex() == static_cast<GSTableEntry::IndexType>(i));
+        CHECK(gsTable.getAtIndex(i) == entry);
+        CHECK(gsTable.getAtValidIndex(i) == entry);
+        CHECK(gsTable.offsetToIndex(entry->getOffset()) == entry->getIndex());
+    }
+
+    Function other(0x9000);
+    CHECK(gsTable.getEntryFor(&other) == nullptr);
+    CHECK(gsTable.getAtIndex(200) == nullptr);
+
+    for(auto f : functions) delete f;
+}
@@ -0,0 +1,42 @@
+#include "framework/include.h"
+#include "chunk/linkindex.h"
+#include "chunk/concrete.h"
+#include "chunk/link.h"
+#include "instr/concrete.h"
+
+#ifdef ARCH_X86_64
+TEST_CASE("Link index follows setLink and semantic deletion", "[chunk][fast]") {
+    Program program;
+    LinkIndex::enable(&program);
+    auto index = LinkIndex::getInstance();
+    REQUIRE(index != nullptr);
+
+    Function first(0x1000), second(0x2000);
+    auto jump1 = new ControlFlowInstruction(X86_INS_JMP, nullptr,
+        "\xe9", "jmp", 4);
+    auto jump2 = new ControlFlowInstruction(X86_INS_JMP, nullptr,
+        "\xe9", "jmp", 4);
+
+    auto link1 = new NormalLink(&first, Link::SCOPE_EXTERNAL_JUMP);
+    jump1->setLink(link1);
+    jump2->setLink(new NormalLink(&first, Link::SCOPE_EXTERNAL_JUMP));
+    CHECK(index->getReferenceCount(&first) == 2);
+    CHECK(index->getReferenceCount(&second) == 0);
+
+    // redirect one reference; the old Link may be deleted first
+    delete link1;
+    jump1->setLink(new NormalLink(&second, Link::SCOPE_EXTERNAL_JUMP));
+    CHECK(index->getReferenceCount(&first) == 1);
+    REQUIRE(index->getReferenceCount(&second) == 1);
+    CHECK(index->getReferences(&second)[0].getSemantic() == jump1);
+
+    delete jump1->getLink();
+    delete jump1;
+    CHECK(index->getReferenceCount(&second) == 0);
+
+    delete jump2->getLink();
+    delete jump2;
+    LinkIndex::disable();
+    CHECK(LinkIndex::getInstance() == nullptr);
+}
+#endif
@@ -104,6 +104,26 @@ TEST_CASE("position validation for simple main with default Position type", "[ch
         CheckAddressIntegrity pass;
         func->accept(&pass);
     }
+
+    SECTION("position validation with a frozen layout") {
+        ChunkMutator(func).setPosition(0x4000000);
+        auto block = func->getChildren()->getIterable()->get(0);
+        auto before = block->getAddress();
+
+        PositionManager::freeze(module);
+        REQUIRE(PositionManager::isFrozen());
+        CHECK(func->getPositionIndex() == Chunk::POSITION_FROZEN);
+        CHECK(block->getAddress() == before);
+
+        CheckAddressIntegrity pass;
+        func->accept(&pass);
+
+        // a mutation ends the frozen layout
+        ChunkMutator(func).setPosition(0x5000000);
+        CHECK(!PositionManager::isFrozen());
+        CHECK(func->getPositionIndex() == Chunk::POSITION_OLD);
+        CHECK(block->getAddress() == before + 0x1000000);
+    }
 }
 
 TEST_CASE("position validation for simple main over each Position type", "[chunk][normal]") {
@@ -202,6 +222,21 @@ TEST_CASE("position validation for simple main over each Position type", "[chunk
                 func->accept(&pass);
             }
 
+            SECTION("position validation after a batch of insertions") {
+                {
+                    ChunkMutator::Batch batch;
+                    ChunkMutator(firstBlock).insertAfter(firstInstr, breakInstr);
+                    ChunkMutator(firstBlock).insertBefore(secondInstr,
+                        makeBreakInstr());
+                    ChunkMutator(secondBlock).prepend(makeBreakInstr());
+                }
+
+                CheckAddressIntegrity pass;
+                func->accept(&pass);
+                CheckPrevNextIntegrity pass2;
+                func->accept(&pass2);
+            }
+
             PositionFactory::setInstance(PositionFactory());
         }
     }
@@ -0,0 +1,54 @@
+#include <algorithm>
+#include "framework/include.h"
+#include "chunk/chunklist.h"
+
+namespace {
+    class FakeChunk {
+    private:
+        Range range;
+    public:
+        FakeChunk(address_t address, size_t size) : range(address, size) {}
+        address_t getAddress() const { return range.getStart(); }
+        Range getRange() const { return range; }
+    };
+}
+
+TEST_CASE("spatial list lookups", "[chunk][fast]") {
+    FakeChunk a(0x100, 0x10), b(0x110, 0x20), c(0x200, 0x8);
+    SpatialChunkList<FakeChunk> spatial;
+    spatial.add(&c);
+    spatial.add(&a);
+    spatial.add(&b);
+
+    CHECK(spatial.find(0x110) == &b);
+    CHECK(spatial.find(0x111) == nullptr);
+    CHECK(spatial.findContaining(0x0ff) == nullptr);
+    CHECK(spatial.findContaining(0x100) == &a);
+    CHECK(spatial.findContaining(0x12f) == &b);
+    CHECK(spatial.findContaining(0x130) == nullptr);
+    CHECK(spatial.findContaining(0x207) == &c);
+    CHECK(spatial.findContaining(0x208) == nullptr);
+
+    spatial.remove(&b);
+    CHECK(spatial.findContaining(0x110) == nullptr);
+    CHECK(spatial.findAllWithin(Range(0x0, 0x300)).size() == 2);
+}
+
+TEST_CASE("spatial list finds deeply nested overlaps", "[chunk][fast]") {
+    // one large chunk followed by more small ones than the old scan covered
+    FakeChunk outer(0x1000, 0x1000);
+    std::vector<FakeChunk> inner;
+    for(int i = 0; i < 10; i ++) inner.emplace_back(0x1100 + i * 0x10, 0x8);
+
+    SpatialChunkList<FakeChunk> spatial;
+    spatial.add(&outer);
+    for(auto &chunk : inner) spatial.add(&chunk);
+
+    auto found = spatial.findAllContaining(0x1194);
+    REQUIRE(found.size() == 2);
+    CHECK(std::find(found.begin(), found.end(), &outer) != found.end());
+    CHECK(std::find(found.begin(), found.end(), &inner[9]) != found.end());
+
+    CHECK(spatial.findAllContaining(0x1800).size() == 1);
+    CHECK(spatial.findAllContaining(0x2000).empty());
+}
@@ -3,6 +3,7 @@
 
 #include "framework/include.h"
 #include "disasm/disassemble.h"
+#include "disasm/quickdecode.h"
 #include "dwarf/parser.h"
 #include "chunk/module.h"
 #include "chunk/dump.h"
@@ -10,6 +11,9 @@
 #include "elf/elfspace.h"
 #include "elf/elfmap.h"
 #include "instr/isolated.h"
+#include "instr/template.h"
+#include "instr/concrete.h"
+#include "instr/register.h"
 
 TEST_CASE("Disassemble Instructions", "[disasm][ins]") {
     Instruction *ins = nullptr;
@@ -95,3 +99,96 @@ TEST_CASE("Fuzzy-function disassemble", "[disasm]") {
 
     CHECK(mainSymbol->getSize() == fuzzy->getSize());
 }
+
+#ifdef ARCH_X86_64
+TEST_CASE("Instruction templates decode like capstone", "[disasm][ins]") {
+    struct {
+        InstrEncoding encoding;
+        unsigned int id;
+    } cases[] = {
+        {InstrTemplate::push(X86Register::R11), X86_INS_PUSH},
+        {InstrTemplate::pop(X86Register::R3), X86_INS_POP},
+        {InstrTemplate::movImm(X86Register::R6, 0x441), X86_INS_MOV},
+        {InstrTemplate::movReg(X86Register::R3, X86Register::R0), X86_INS_MOV},
+        {InstrTemplate::leaStack(-0x80), X86_INS_LEA},
+        {InstrTemplate::leaStack(0x80), X86_INS_LEA},
+        {InstrTemplate::subStack(0x200), X86_INS_SUB},
+        {InstrTemplate::leaRip(X86Register::R10), X86_INS_LEA},
+        {InstrTemplate::cmpMem(X86Register::R11, X86Register::R0, 0x18),
+            X86_INS_CMP},
+        {InstrTemplate::cmpMem(X86Register::R11, X86Register::R12, 0),
+            X86_INS_CMP},
+        {InstrTemplate::cmpMem(X86Register::R11, X86Register::R13, 0x400),
+            X86_INS_CMP},
+    };
+
+    for(auto &c : cases) {
+        auto ins = InstrTemplate::make(c.encoding);
+        const auto &data = ins->getSemantic()->getData();
+        auto assembly = Disassemble::makeAssembly(
+            std::vector<uint8_t>(data.begin(), data.end()), 0);
+        CHECK(assembly.getId() == c.id);
+        CHECK(assembly.getSize() == c.encoding.getSize());
+    }
+
+    // the register operands come out where the templates put them
+    auto mov = Disassemble::makeAssembly(std::vector<uint8_t>{
+        InstrTemplate::movReg(X86Register::R3, X86Register::R0)[0],
+        InstrTemplate::movReg(X86Register::R3, X86Register::R0)[1],
+        InstrTemplate::movReg(X86Register::R3, X86Register::R0)[2]}, 0);
+    auto ops = mov.getAsmOperands()->getOperands();
+    CHECK(ops[0].reg == X86_REG_RAX);
+    CHECK(ops[1].reg == X86_REG_RBX);
+
+    CHECK(dynamic_cast<ReturnInstruction *>(
+        InstrTemplate::make(InstrTemplate::ret())->getSemantic()));
+}
+#endif
+
+#ifdef ARCH_X86_64
+TEST_CASE("Quick decoding agrees with capstone", "[disasm][ins]") {
+    std::vector<unsigned char> code = {
+        0x55,                                       // push %rbp
+        0x48, 0x89, 0xe5,                           // mov %rsp,%rbp
+        0x48, 0x8b, 0x05, 0x10, 0x00, 0x00, 0x00,   // mov 0x10(%rip),%rax
+        0x48, 0xb8, 1, 2, 3, 4, 5, 6, 7, 8,         // movabs $..., %rax
+        0xf7, 0x05, 0, 0, 0, 0, 1, 0, 0, 0,         // testl $1, 0(%rip)
+        0xc5, 0xf8, 0x77,                           // vzeroupper
+        0x74, 0x05,                                 // je +5
+        0xe8, 0xf0, 0xff, 0xff, 0xff,               // callq -0x10
+        0xff, 0xd0,                                 // callq *%rax
+        0x5d,                                       // pop %rbp
+        0xc3,                                       // retq
+        0x66, 0x2e, 0x0f, 0x1f, 0x84, 0, 0, 0, 0, 0,  // nopw
+        0x0f, 0x1f, 0x40, 0x00,                     // nopl 0(%rax)
+    };
+    const address_t base = 0x1000;
+    auto list = QuickDecode::instructions(code.data(), code.size(), base);
+    REQUIRE(list.size() == 13);
+
+    size_t offset = 0;
+    for(const auto &ins : list) {
+        CHECK(ins.address == base + offset);
+        auto assembly = Disassemble::makeAssembly(std::vector<unsigned char>(
+            code.begin() + offset, code.begin() + offset + ins.size),
+            base + offset);
+        CHECK(assembly.getSize() == ins.size);
+        CHECK((assembly.getId() == X86_INS_NOP)
+            == (ins.kind == QuickInstruction::KIND_NOP));
+        offset += ins.size;
+    }
+    CHECK(offset == code.size());
+
+    CHECK(list[2].ripRelative);
+    CHECK(list[4].ripRelative);
+    CHECK(list[6].kind == QuickInstruction::KIND_COND_JUMP);
+    CHECK(list[6].target == list[7].address + 5);
+    CHECK(list[7].kind == QuickInstruction::KIND_CALL);
+    CHECK(list[7].target == list[8].address - 0x10);
+    CHECK(list[8].kind == QuickInstruction::KIND_INDIRECT_CALL);
+    CHECK(list[10].kind == QuickInstruction::KIND_RET);
+
+    CHECK(QuickDecode::isNop(std::string("\x90")));
+    CHECK(!QuickDecode::isNop(std::string("\xf3\x90")));  // pause
+}
+#endif
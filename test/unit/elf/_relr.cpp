@@ -0,0 +1,49 @@
+#include <vector>
+#include "framework/include.h"
+#include "generate/concretedeferred.h"
+
+// applies an encoded RELR table the way ld.so does
+static std::vector<address_t> decode(const std::vector<address_t> &encoded) {
+    std::vector<address_t> addressList;
+    address_t base = 0;
+    for(auto word : encoded) {
+        if((word & 1) == 0) {
+            addressList.push_back(word);
+            base = word + sizeof(address_t);
+        }
+        else {
+            for(size_t bit = 1; bit < 64; bit ++) {
+                if(word & (address_t(1) << bit)) {
+                    addressList.push_back(base + (bit - 1) * sizeof(address_t));
+                }
+            }
+            base += 63 * sizeof(address_t);
+        }
+    }
+    return addressList;
+}
+
+TEST_CASE("RELR encoding packs nearby relative relocations", "[elf][fast]") {
+    std::vector<address_t> addressList;
+    for(address_t a = 0x401000; a < 0x401000 + 200 * 8; a += 8) {
+        addressList.push_back(a);
+    }
+    addressList.push_back(0x500010);
+    addressList.push_back(0x500020);
+
+    auto encoded = RelrSectionContent::encode(addressList);
+    // one address and four bitmaps, then one address and one bitmap
+    CHECK(encoded.size() == 7);
+    CHECK(decode(encoded) == addressList);
+}
+
+TEST_CASE("RELR encoding sorts and skips duplicates", "[elf][fast]") {
+    std::vector<address_t> addressList = {0x2018, 0x1000, 0x2000, 0x1000};
+    auto encoded = RelrSectionContent::encode(addressList);
+    CHECK(decode(encoded) == std::vector<address_t>({0x1000, 0x2000, 0x2018}));
+
+    RelrSectionContent content;
+    CHECK(!content.add(0x1004));
+    CHECK(content.add(0x1008));
+    CHECK(content.getSize() == sizeof(address_t));
+}
@@ -21,3 +21,58 @@ TEST_CASE("Mapping Symbol List ", "[elf][mappingsym]") {
     CHECK(mappingSymbolList->getCount() > 0);
 }
 #endif
+
+TEST_CASE("Find Dynamic Symbol By Name", "[elf][symbollist]") {
+    ElfMap *elf = new ElfMap(TESTDIR "hello");
+
+    SymbolList *symbolList = SymbolList::buildDynamicSymbolList(elf);
+    for(auto sym : *symbolList) {
+        if(!*sym->getName()) continue;
+        auto found = symbolList->find(sym->getName());
+        CHECK(found != nullptr);
+    }
+    CHECK(symbolList->find("no_such_symbol_name") == nullptr);
+}
+
+TEST_CASE("Walk Mapping Symbols In Order", "[elf][mappingsym]") {
+    SymbolListWithMapping list;
+    std::vector<Symbol> symbols = {
+        Symbol(0x100, 0, "$x", Symbol::TYPE_NOTYPE, Symbol::BIND_LOCAL, 0, 1),
+        Symbol(0x180, 0, "$d", Symbol::TYPE_NOTYPE, Symbol::BIND_LOCAL, 1, 1),
+        Symbol(0x100, 0, "$d", Symbol::TYPE_NOTYPE, Symbol::BIND_LOCAL, 2, 2),
+        Symbol(0x1c0, 0, "$x", Symbol::TYPE_NOTYPE, Symbol::BIND_LOCAL, 3, 1),
+        Symbol(0x120, 0x80, "func", Symbol::TYPE_FUNC, Symbol::BIND_GLOBAL, 4, 1),
+        Symbol(0x180, 0x40, "other", Symbol::TYPE_FUNC, Symbol::BIND_GLOBAL, 5, 1),
+    };
+    for(size_t i = 0; i < symbols.size(); i ++) list.add(&symbols[i], i);
+    list.buildMappingList();
+
+    auto cursor = list.findMappings(&symbols[4]);
+    CHECK(cursor.get() == &symbols[0]);
+    CHECK(cursor.next() == &symbols[1]);
+    CHECK(cursor.next() == &symbols[3]);
+    CHECK(cursor.next() == nullptr);  // section 2's $d is never visited
+
+    CHECK(list.findMappings(&symbols[5]).get() == &symbols[1]);
+}
+
+TEST_CASE("Find Symbol By Address After Compacting", "[elf][symbollist]") {
+    SymbolList list;
+    std::vector<Symbol> symbols = {
+        Symbol(0x100, 0x20, "first", Symbol::TYPE_FUNC, Symbol::BIND_GLOBAL, 0, 1),
+        Symbol(0x120, 0x20, "second", Symbol::TYPE_FUNC, Symbol::BIND_GLOBAL, 1, 1),
+        Symbol(0x120, 0, "$x", Symbol::TYPE_NOTYPE, Symbol::BIND_LOCAL, 2, 1),
+        Symbol(0x140, 0x20, "third", Symbol::TYPE_FUNC, Symbol::BIND_GLOBAL, 3, 1),
+    };
+    for(size_t i = 0; i < 3; i ++) list.add(&symbols[i], i);
+    CHECK(list.find(0x120) == &symbols[1]);
+
+    list.compact();
+    list.add(&symbols[3], 3);  // added while the index is released
+
+    CHECK(list.find(0x100) == &symbols[0]);
+    CHECK(list.find(0x120) == &symbols[1]);
+    CHECK(list.find(0x140) == &symbols[3]);
+    CHECK(list.find("second") == &symbols[1]);
+    CHECK(list.estimateSizeOf(&symbols[0]) == 0x20);
+}
@@ -0,0 +1,40 @@
+#include <sstream>
+#include "framework/include.h"
+
+#undef DEBUG_GROUP
+#define DEBUG_GROUP log
+#include "log/log.h"
+
+TEST_CASE("messages above the ceiling are compiled out", "[log][fast]") {
+    std::ostringstream out;
+    LogStream::overrideThreadStream(&out);
+    _logLevel.setBound(LOG_CEILING + 10);
+
+    LOG(1, "shown");
+    LOG(LOG_CEILING, "at ceiling");
+    LOG(LOG_CEILING + 1, "above ceiling");
+    bool ran = false;
+    IF_LOG(LOG_CEILING + 1) ran = true;
+
+    _logLevel.setBound(D_log);
+    LogStream::overrideThreadStream(nullptr);
+
+    CHECK(out.str() == "shown\nat ceiling\n");
+    CHECK(!ran);
+}
+
+TEST_CASE("the runtime level still filters messages", "[log][fast]") {
+    std::ostringstream out;
+    LogStream::overrideThreadStream(&out);
+    _logLevel.setBound(1);
+
+    LOG(1, "one " << 1);
+    LOG(2, "two");
+    LOG0(1, "partial");
+    CLOG(1, "c %d", 3);
+
+    _logLevel.setBound(D_log);
+    LogStream::overrideThreadStream(nullptr);
+
+    CHECK(out.str() == "one 1\npartialc 3\n");
+}
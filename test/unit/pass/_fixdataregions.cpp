@@ -0,0 +1,33 @@
+#include <cstdint>
+#include "framework/include.h"
+#include "pass/fixdataregions.h"
+
+TEST_CASE("data fix-ups are applied at every size", "[pass][fast]") {
+    union {
+        uint64_t words[64];
+        uint8_t bytes[64 * 8];
+    } memory = {};
+    auto at = [&] (size_t offset)
+        { return reinterpret_cast<address_t>(&memory.bytes[offset]); };
+
+    DataFixupList list;
+    // added out of order, as DataVariables may be
+    for(size_t i = 32; i > 0; i --) {
+        list.add(at((i - 1) * 8), 0x1000 + i, sizeof(address_t));
+    }
+    list.add(at(300), 0x12345678, 4);
+    list.add(at(310), 0xbeef, 2);
+    list.add(at(320), 0x7f, 1);
+    CHECK(list.getCount() == 35);
+
+    list.sort();
+    list.apply();
+
+    for(size_t i = 0; i < 32; i ++) {
+        CHECK(memory.words[i] == 0x1000 + i + 1);
+    }
+    CHECK(*reinterpret_cast<uint32_t *>(&memory.bytes[300]) == 0x12345678);
+    CHECK(*reinterpret_cast<uint16_t *>(&memory.bytes[310]) == 0xbeef);
+    CHECK(memory.bytes[320] == 0x7f);
+    CHECK(memory.bytes[321] == 0);
+}
@@ -0,0 +1,96 @@
+#include <capstone/x86.h>
+#include "framework/include.h"
+#include "pass/hardencleanup.h"
+#include "chunk/concrete.h"
+#include "chunk/link.h"
+#include "instr/concrete.h"
+#include "instr/register.h"
+#include "instr/template.h"
+#include "operation/mutator.h"
+
+#ifdef ARCH_X86_64
+static Function *makeFunction(const std::vector<InstrEncoding> &code) {
+    auto function = new Function(0x1000);
+    function->setPosition(
+        PositionFactory::getInstance()->makeAbsolutePosition(0x1000));
+    auto block = new Block();
+    ChunkMutator(function).append(block);
+
+    ChunkMutator mutator(block);
+    for(const auto &encoding : code) {
+        mutator.append(InstrTemplate::make(encoding));
+    }
+    return function;
+}
+
+static std::string getCode(Function *function) {
+    std::string code;
+    for(auto block : CIter::children(function)) {
+        for(auto instr : CIter::children(block)) {
+            code += instr->getSemantic()->getData();
+        }
+    }
+    return code;
+}
+#endif
+
+TEST_CASE("hardening cleanup merges back-to-back restores and saves",
+    "[pass][fast][x86_64]") {
+#ifdef ARCH_X86_64
+    typedef InstrTemplate T;
+    const int r11 = X86Register::R11;
+
+    SECTION("dead register") {
+        auto function = makeFunction({T::nop(), T::pop(r11),
+            T::leaStack(0x80), T::leaStack(-0x80), T::push(r11),
+            T::movImm(r11, 1), T::pop(r11), T::ret()});
+        HardenCleanupPass cleanup;
+        function->accept(&cleanup);
+        CHECK(getCode(function) == T::nop().toString()
+            + T::movImm(r11, 1).toString() + T::pop(r11).toString()
+            + T::ret().toString());
+    }
+
+    SECTION("live register") {
+        // %rbx is callee-saved, so it is live at the ret
+        const int rbx = X86Register::R3;
+        auto function = makeFunction({T::nop(), T::pop(rbx),
+            T::leaStack(0x80), T::leaStack(-0x80), T::push(rbx),
+            T::leaStack(8), T::leaStack(-0x10), T::ret()});
+        HardenCleanupPass cleanup;
+        function->accept(&cleanup);
+        CHECK(getCode(function) == T::nop().toString()
+            + T::pop(rbx).toString() + T::push(rbx).toString()
+            + T::leaStack(-8).toString() + T::ret().toString());
+    }
+
+    SECTION("repeated check") {
+        auto violation = makeFunction({T::int3()});
+        auto makeCheck = [violation] () {
+            auto jne = new Instruction();
+            auto semantic = new ControlFlowInstruction(
+                X86_INS_JNE, jne, "\x0f\x85", "jnz", 4);
+            semantic->setLink(new NormalLink(violation,
+                Link::SCOPE_EXTERNAL_JUMP));
+            jne->setSemantic(semantic);
+            return jne;
+        };
+
+        // as from EndbrEnforcePass twice: mov %rax,%r11 / mov %r11,%r11
+        auto function = makeFunction({T::nop(), T::movReg(r11, 0),
+            T::cmpMem(0, r11, 0), T::movReg(r11, r11),
+            T::cmpMem(0, r11, 0), T::ret()});
+        auto block = function->getChildren()->getIterable()->get(0);
+        auto list = block->getChildren()->getIterable();
+        ChunkMutator(block).insertAfter(list->get(2), makeCheck());
+        ChunkMutator(block).insertAfter(list->get(5), makeCheck());
+        REQUIRE(list->getCount() == 8);
+
+        HardenCleanupPass cleanup;
+        function->accept(&cleanup);
+        CHECK(list->getCount() == 5);
+        CHECK(dynamic_cast<ReturnInstruction *>(
+            list->get(4)->getSemantic()) != nullptr);
+    }
+#endif
+}
@@ -0,0 +1,45 @@
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include "framework/include.h"
+#include "util/bufferedfile.h"
+
+static std::string readBack(const std::string &filename) {
+    std::ifstream in(filename);
+    std::ostringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+}
+
+TEST_CASE("Buffered file stream writes everything on close", "[util][fast]") {
+    std::string filename = "/tmp/egalito-bufferedfile-test";
+    std::string expected;
+
+    {
+        BufferedFileStream out(filename);
+        REQUIRE(out.isOpen());
+
+        out << "line " << 1 << '\n';
+        expected += "line 1\n";
+
+        // larger than the buffer, written around it
+        std::string big((BufferedFileBuf::DEFAULT_BUFFER_SIZE * 3) / 2, 'x');
+        out << big;
+        expected += big;
+
+        for(int i = 0; i < 100000; i ++) {
+            out << i << ',';
+            expected += std::to_string(i) + ",";
+        }
+    }
+
+    CHECK(readBack(filename) == expected);
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("Buffered file stream reports open failure", "[util][fast]") {
+    BufferedFileStream out("/nonexistent-directory/file");
+    CHECK(!out.isOpen());
+    CHECK(!out);
+}
@@ -0,0 +1,48 @@
+#include <string>
+#include <vector>
+#include "framework/include.h"
+#include "util/bytescan.h"
+
+static std::vector<size_t> naiveFind(const std::string &data,
+    const std::string &pattern, size_t stride) {
+
+    std::vector<size_t> offsetList;
+    for(size_t i = 0; i + pattern.size() <= data.size(); i ++) {
+        if(i % stride == 0 && !data.compare(i, pattern.size(), pattern)) {
+            offsetList.push_back(i);
+        }
+    }
+    return offsetList;
+}
+
+TEST_CASE("Byte pattern scanning", "[util][fast]") {
+    std::string code;
+    for(int i = 0; i < 5000; i ++) code.push_back(char((i * 7919) % 251));
+    for(size_t at : {0, 17, 32, 47, 1000, 4093}) {
+        code.replace(at, 4, "\xf3\x0f\x1e\xfa");
+    }
+    code += "\x0f\x05";
+
+    const auto &endbr = BytePattern::getEndbr64();
+    const std::string endbrBytes("\xf3\x0f\x1e\xfa");
+    CHECK(endbr.findAll(code.data(), code.size())
+        == naiveFind(code, endbrBytes, 1));
+    CHECK(endbr.findAll(code.data(), code.size(), 16)
+        == naiveFind(code, endbrBytes, 16));
+    CHECK(endbr.findAll(code.data(), code.size()).size() >= 6);
+
+    const auto &syscall = BytePattern::getSyscall();
+    CHECK(syscall.findAll(code.data(), code.size())
+        == naiveFind(code, "\x0f\x05", 1));
+    CHECK(syscall.occursIn(code.data(), code.size()));
+    CHECK(syscall.occursIn(code.data(), code.size() - 1)
+        == !naiveFind(code.substr(0, code.size() - 1), "\x0f\x05", 1).empty());
+
+    // overlapping occurrences and short inputs
+    BytePattern nops("\x90\x90", 2);
+    std::string run(40, '\x90');
+    CHECK(nops.findAll(run.data(), run.size()).size() == 39);
+    CHECK(nops.findAll(run.data(), 1).empty());
+    CHECK(endbr.isExactly(endbrBytes));
+    CHECK(!endbr.isExactly(code.substr(0, 5)));
+}
@@ -0,0 +1,41 @@
+#include <string>
+#include <vector>
+#include "framework/include.h"
+#include "util/compress.h"
+
+static bool roundTrip(const std::string &input) {
+    auto packed = BlockCompressor::compress(input.data(), input.size());
+    std::vector<char> output(input.size() + 1);
+    return BlockCompressor::decompress(packed.data(), packed.size(),
+            output.data(), input.size())
+        && std::string(output.data(), input.size()) == input;
+}
+
+TEST_CASE("Block compressor round trips", "[util][fast]") {
+    CHECK(roundTrip(""));
+    CHECK(roundTrip("abc"));
+    CHECK(roundTrip(std::string(1000, 'x')));
+
+    std::string mixed;
+    for(int i = 0; i < 20000; i ++) mixed.push_back(char((i * 7919) % 251));
+    CHECK(roundTrip(mixed));
+
+    std::string repetitive;
+    for(int i = 0; i < 5000; i ++) repetitive += "mov %rax, %rbx;";
+    CHECK(roundTrip(repetitive));
+    CHECK(BlockCompressor::compress(repetitive.data(), repetitive.size())
+        .size() < repetitive.size() / 10);
+}
+
+TEST_CASE("Block compressor rejects bad input", "[util][fast]") {
+    std::string input(100, 'y');
+    auto packed = BlockCompressor::compress(input.data(), input.size());
+    std::vector<char> output(200);
+
+    // wrong expected size
+    CHECK(!BlockCompressor::decompress(packed.data(), packed.size(),
+        output.data(), 99));
+    // truncated
+    CHECK(!BlockCompressor::decompress(packed.data(), 3,
+        output.data(), 100));
+}
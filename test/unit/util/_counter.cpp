@@ -0,0 +1,48 @@
+#include <sstream>
+#include "framework/include.h"
+#include "util/counter.h"
+
+TEST_CASE("counters are only created for enabled groups", "[util][fast]") {
+    CounterRegistry registry;
+    registry.setOutputFile("/dev/null");
+    registry.enableGroup("analysis");
+
+    CHECK(registry.add("analysis", "visits") != nullptr);
+    CHECK(registry.add("pass", "visits") == nullptr);
+    CHECK(registry.add("analysis", "visits")
+        == registry.add("analysis", "visits"));
+}
+
+TEST_CASE("counter totals and function records are dumped", "[util][fast]") {
+    CounterRegistry registry;
+    registry.setOutputFile("/dev/null");
+    registry.enableGroup("all");
+
+    auto visits = registry.add("analysis", "visits");
+    auto steps = registry.add("slicing", "steps");
+    registry.bump(visits, 3);
+    registry.bump(visits, 4);
+    registry.bump(steps, 1);
+
+    CounterRegistry::FunctionRecord slow, fast;
+    slow.wallUS = 5000;
+    slow.scopes = 1;
+    slow.counts = {100, 0};
+    fast.wallUS = 10;
+    fast.scopes = 1;
+    fast.counts = {0, 2};
+    registry.addFunction("fast", fast);
+    registry.addFunction("slow", slow);
+    registry.addFunction("slow", slow);
+
+    std::ostringstream stream;
+    registry.dump(stream);
+    auto output = stream.str();
+    CAPTURE(output);
+    CHECK(output.find("7  analysis: visits") != std::string::npos);
+    CHECK(output.find("1  slicing: steps") != std::string::npos);
+    CHECK(output.find("10.000 ms  slow (2 scopes)") != std::string::npos);
+    CHECK(output.find("200  analysis: visits") != std::string::npos);
+    // the slowest function is listed first
+    CHECK(output.find("slow (") < output.find("fast ("));
+}
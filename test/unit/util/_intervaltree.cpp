@@ -173,3 +173,58 @@ TEST_CASE("Interval tree complement", "[util][fast]") {
     CHECK(newTree.getAllData() == std::vector<Range>(
         { Range(0x0, 0x10), Range(0x1e, 0x2), Range(0x3e, 0x2) }));
 }
+
+TEST_CASE("Interval tree stays ordered over many small ranges", "[util][fast]") {
+    IntervalTree tree(Range(0, 0x10000));
+
+    // insert in an order that would degenerate an unbalanced tree
+    for(address_t i = 0; i < 0x1000; i ++) {
+        REQUIRE(tree.add(Range(0x10000 - 0x10 * (i + 1), 0x8)));
+    }
+    CHECK(tree.getCount() == 0x1000);
+
+    auto data = tree.getAllData();
+    CHECK(std::is_sorted(data.begin(), data.end()));
+
+    for(address_t i = 0; i < 0x1000; i += 2) {
+        REQUIRE(tree.remove(Range(0x10 * i, 0x8)));
+    }
+    CHECK(tree.getCount() == 0x800);
+
+    Range output;
+    REQUIRE(tree.findLowerBound(0x25, &output));
+    CHECK(output == Range(0x10, 0x8));
+    REQUIRE(tree.findUpperBoundOrOverlapping(0x14, &output));
+    CHECK(output == Range(0x10, 0x8));
+    REQUIRE(tree.findUpperBoundOrOverlapping(0x18, &output));
+    CHECK(output == Range(0x30, 0x8));
+}
+
+TEST_CASE("Interval tree batch split matches single splits", "[util][fast]") {
+    IntervalTree single(Range(0, 0x100));
+    IntervalTree batch(Range(0, 0x100));
+    for(auto tree : {&single, &batch}) {
+        tree->add(Range(0, 0x100));
+        tree->add(Range(0x80, 0x10));  // overlap blocks splits inside it
+    }
+
+    std::vector<address_t> points = { 0x40, 0x10, 0x84, 0x90, 0x10, 0xf0 };
+    for(auto point : points) single.splitAt(point);
+    batch.splitAtAll(points);
+
+    CHECK(batch.getAllData() == single.getAllData());
+    CHECK(batch.getAllData() == std::vector<Range>({
+        Range(0, 0x10), Range(0x10, 0x30), Range(0x40, 0x50),
+        Range(0x80, 0x10), Range(0x90, 0x60), Range(0xf0, 0x10) }));
+}
+
+TEST_CASE("Interval tree batch add", "[util][fast]") {
+    IntervalTree tree(Range(0, 0x40));
+    tree.add(Range(0x10, 0x4));
+
+    CHECK(tree.addAll({ Range(0x30, 0x4), Range(0x3e, 0x4), Range(0x0, 0x4),
+        Range(0x10, 0x4) }) == 3);
+    CHECK(tree.getAllData() == std::vector<Range>({
+        Range(0x0, 0x4), Range(0x10, 0x4), Range(0x10, 0x4),
+        Range(0x30, 0x4) }));
+}
@@ -0,0 +1,41 @@
+#include <set>
+#include <vector>
+#include <cstring>
+#include "framework/include.h"
+#include "util/slab.h"
+#include "chunk/link.h"
+
+TEST_CASE("Slab allocator reuses freed blocks", "[util][fast]") {
+    void *a = SlabAllocator::allocate(40);
+    SlabAllocator::deallocate(a, 40);
+    void *b = SlabAllocator::allocate(48);  // same 16-byte size class
+    CHECK(a == b);
+    SlabAllocator::deallocate(b, 48);
+}
+
+TEST_CASE("Slab allocator hands out distinct blocks", "[util][fast]") {
+    std::vector<std::pair<char *, size_t>> blocks;
+    std::set<char *> distinct;
+    for(int i = 0; i < 10000; i ++) {
+        size_t size = 1 + (i % 300);  // includes sizes beyond the classes
+        auto block = static_cast<char *>(SlabAllocator::allocate(size));
+        std::memset(block, 0xab, size);
+        blocks.push_back(std::make_pair(block, size));
+        distinct.insert(block);
+    }
+    CHECK(distinct.size() == blocks.size());
+
+    for(auto pair : blocks) SlabAllocator::deallocate(pair.first, pair.second);
+}
+
+TEST_CASE("Links are slab-allocated", "[util][fast]") {
+    auto before = SlabAllocator::getAllocationCount();
+    Link *link = new UnresolvedLink(0x1000);
+    CHECK(SlabAllocator::getAllocationCount() == before + 1);
+    delete link;
+
+    // the sized delete returned the block to its size class
+    Link *other = new UnresolvedRelativeLink(0x2000);
+    CHECK(other == link);
+    delete other;
+}
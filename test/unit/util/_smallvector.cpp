@@ -0,0 +1,39 @@
+#include <algorithm>
+#include <vector>
+#include "framework/include.h"
+#include "util/smallvector.h"
+
+TEST_CASE("SmallVector stays inline until it outgrows its buffer", "[util][fast]") {
+    int values[8];
+    SmallVector<int *, 4> list;
+    for(int i = 0; i < 4; i ++) list.push_back(&values[i]);
+    CHECK(list.isInline());
+
+    list.push_back(&values[4]);
+    CHECK(!list.isInline());
+    REQUIRE(list.size() == 5);
+    for(int i = 0; i < 5; i ++) CHECK(list[i] == &values[i]);
+}
+
+TEST_CASE("SmallVector insert and erase match std::vector", "[util][fast]") {
+    int values[64];
+    SmallVector<int *, 4> list;
+    std::vector<int *> expected;
+
+    for(int i = 0; i < 64; i ++) {
+        size_t at = (i * 7) % (expected.size() + 1);
+        list.insert(list.begin() + at, &values[i]);
+        expected.insert(expected.begin() + at, &values[i]);
+        if(i % 3 == 2) {
+            size_t gone = (i * 5) % expected.size();
+            list.erase(list.begin() + gone);
+            expected.erase(expected.begin() + gone);
+        }
+    }
+
+    REQUIRE(list.size() == expected.size());
+    CHECK(std::equal(list.begin(), list.end(), expected.begin()));
+
+    SmallVector<int *, 4> copy(list);
+    CHECK(std::equal(copy.begin(), copy.end(), expected.begin()));
+}
@@ -0,0 +1,35 @@
+#include <vector>
+#include <atomic>
+#include "framework/include.h"
+#include "util/threadpool.h"
+
+TEST_CASE("Thread pool visits every index once", "[util][fast]") {
+    for(size_t threads : {1, 4}) {
+        ThreadPool pool(threads);
+        CHECK(pool.getThreadCount() == threads);
+
+        std::vector<int> visited(1000, 0);
+        pool.parallelFor(visited.size(), [&] (size_t i) { visited[i] ++; });
+
+        CHECK(visited == std::vector<int>(1000, 1));
+    }
+}
+
+TEST_CASE("Thread pool can be reused", "[util][fast]") {
+    ThreadPool pool(3);
+    std::atomic<size_t> sum(0);
+    for(int round = 0; round < 10; round ++) {
+        pool.parallelFor(100, [&] (size_t i) { sum += i; });
+    }
+    CHECK(sum == 10 * (99 * 100 / 2));
+}
+
+TEST_CASE("Thread pool rethrows work exceptions", "[util][fast]") {
+    ThreadPool pool(4);
+    std::atomic<int> count(0);
+    CHECK_THROWS(pool.parallelFor(50, [&] (size_t i) {
+        count ++;
+        if(i == 17) throw "failure in work item";
+    }));
+    CHECK(count == 50);
+}
@@ -0,0 +1,55 @@
+#include <sstream>
+#include <string>
+#include "framework/include.h"
+#include "util/timing.h"
+#include "util/threadpool.h"
+
+static size_t countOf(const std::string &haystack, const std::string &needle) {
+    size_t count = 0;
+    for(auto pos = haystack.find(needle); pos != std::string::npos;
+        pos = haystack.find(needle, pos + 1)) {
+
+        count ++;
+    }
+    return count;
+}
+
+TEST_CASE("Trace spans nest and record counters", "[util][fast]") {
+    auto tracer = EgalitoTracer::getInstance();
+    tracer->setTraceFile("unused.json");
+    {
+        EgalitoTraceSpan outer("outer span");
+        {
+            EgalitoTraceSpan inner(std::string("inner span"));
+        }
+        tracer->counter("modules", 42);
+    }
+    ThreadPool pool(2);
+    pool.parallelFor(4, [] (size_t i) { EgalitoTraceSpan span("worker"); });
+
+    std::ostringstream stream;
+    tracer->writeChromeTrace(stream);
+    tracer->setTraceFile("");
+    auto trace = stream.str();
+
+    CHECK(trace.find("\"traceEvents\"") != std::string::npos);
+    CHECK(trace.find("{\"name\": \"outer span\", \"ph\": \"X\"")
+        != std::string::npos);
+    CHECK(countOf(trace, "\"depth\": 1") == 1);
+    CHECK(trace.find("\"ph\": \"C\"") != std::string::npos);
+    CHECK(trace.find("\"value\": 42") != std::string::npos);
+    CHECK(countOf(trace, "\"name\": \"worker\"") == 4);
+}
+
+TEST_CASE("Trace spans are not recorded when tracing is off", "[util][fast]") {
+    auto tracer = EgalitoTracer::getInstance();
+    std::ostringstream before;
+    tracer->writeChromeTrace(before);
+    {
+        EgalitoTraceSpan span("ignored");
+        tracer->counter("ignored", 1);
+    }
+    std::ostringstream after;
+    tracer->writeChromeTrace(after);
+    CHECK(before.str() == after.str());
+}